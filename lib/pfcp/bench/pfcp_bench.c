@@ -0,0 +1,821 @@
+#define TRACE_MODULE _pfcp_bench
+
+/*
+ * pfcp-bench - a stand-in SMF loading N4 of UPF
+ *
+ * After an Association Setup, requests are sent in the mix of procedures given
+ * by -m at the rate given by -r. Sessions are established with -p PDR/FAR/QER,
+ * then modified and deleted in turn, and each session has at most one request
+ * in flight. Throughput and latency of responses are reported per procedure.
+ * It exits with failure if any request is rejected or timeout.
+ *
+ * UPF answers to the PFCP port of SMF, so the bench binds port 8805 on another
+ * address than the one of UPF, e.g. 127.0.0.1 for UPF on 127.0.0.8. Without
+ * gtp5g, build UPF with UPDK_PKTPROC_MODULE "inmem" to load N4 only.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <poll.h>
+#include <getopt.h>
+#include <endian.h>
+#include <arpa/inet.h>
+
+#include "utlt_debug.h"
+#include "utlt_buff.h"
+#include "utlt_network.h"
+
+#include "pfcp_types.h"
+#include "pfcp_message.h"
+#include "pfcp_node.h"
+#include "pfcp_path.h"
+#include "pfcp_xact.h"
+
+#define PFCP_BENCH_PORT             8805
+#define PFCP_BENCH_MAX_RULE         4       // Create PDR/FAR/QER in a message
+#define PFCP_BENCH_MAX_RECV_BATCH   64
+#define PFCP_BENCH_CHECK_MSEC       100     // Interval of timeout check
+#define PFCP_BENCH_MAX_WINDOW       32      // Requests in flight hold buffers of the Bufblk pool
+#define PFCP_BENCH_UE_IP_BASE       0x3c000000  // 60.0.0.0/8, one address per session
+#define PFCP_OUTER_HDR_IPV4_LEN     10
+#define NTP_UNIX_EPOCH_OFFSET       2208988800UL
+
+#define NSEC_PER_MSEC               1000000ULL
+#define NSEC_PER_SEC                1000000000ULL
+
+#define BenchSetIe(__ie, __value, __len) do { \
+    (__ie).presence = 1; \
+    (__ie).len = (__len); \
+    (__ie).value = (void *) &(__value); \
+} while (0)
+
+enum {
+    BENCH_ASSOCIATION = 0,
+    BENCH_ESTABLISHMENT,
+    BENCH_MODIFICATION,
+    BENCH_DELETION,
+
+    BENCH_PROCEDURE_NUM,
+};
+
+static const char *benchProcedureName[BENCH_PROCEDURE_NUM] = {
+    "Association", "Establishment", "Modification", "Deletion",
+};
+
+typedef struct _BenchSession {
+    uint32_t    index;
+    uint64_t    upfSeid;        // 0 if it is not established
+    PfcpXact    *xact;          // Request in flight
+    int         procedure;      // of the request in flight
+    uint64_t    sentTime;
+} BenchSession;
+
+// FIFO of session index
+typedef struct _BenchRing {
+    uint32_t    *index;
+    uint32_t    size;
+    uint32_t    head;
+    uint32_t    num;
+} BenchRing;
+
+typedef struct _BenchStat {
+    uint64_t    sent;
+    uint64_t    accepted;
+    uint64_t    rejected;
+    uint64_t    timeout;
+    uint64_t    *latency;       // nsec of each response
+    uint64_t    numOfLatency;
+    uint64_t    sizeOfLatency;
+} BenchStat;
+
+static struct {
+    // Options
+    const char  *upfAddr;
+    const char  *localAddr;
+    const char  *dnn;
+    const char  *logLevel;
+    uint64_t    numOfRequest;
+    uint32_t    numOfSession;
+    int         numOfRule;
+    uint64_t    rate;
+    uint32_t    window;
+    uint32_t    weight[BENCH_PROCEDURE_NUM];
+    uint32_t    timeout;        // msec
+    int         keepSession;
+
+    PfcpNode    upf;
+    SockAddr    upfSockAddr;
+    struct in_addr localIp;
+
+    BenchSession *session;
+    BenchSession nodeSession;   // Association is not in any session
+    int         associated;
+    BenchRing   freeRing;       // Sessions not established
+    BenchRing   readyRing;      // Sessions established and not in flight
+    uint32_t    numOfInFlight;
+
+    int         record;         // Responses are counted in stat
+    int32_t     credit[BENCH_PROCEDURE_NUM];
+    BenchStat   stat[BENCH_PROCEDURE_NUM];
+    uint64_t    failed;         // Requests rejected or timeout, counted or not
+    uint64_t    unexpected;
+} bench;
+
+static uint64_t BenchNow() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static Status BenchRingInit(BenchRing *ring, uint32_t size) {
+    ring->index = malloc(sizeof(uint32_t) * size);
+    UTLT_Assert(ring->index, return STATUS_ERROR, "Ring of %u sessions alloc fail", size);
+    ring->size = size;
+    ring->head = ring->num = 0;
+
+    return STATUS_OK;
+}
+
+static void BenchRingPush(BenchRing *ring, uint32_t index) {
+    ring->index[(ring->head + ring->num++) % ring->size] = index;
+}
+
+static uint32_t BenchRingPop(BenchRing *ring) {
+    uint32_t index = ring->index[ring->head];
+    ring->head = (ring->head + 1) % ring->size;
+    ring->num--;
+
+    return index;
+}
+
+static Status BenchBuildAssociation(Bufblk **bufBlk) {
+    PfcpMessage pfcpMessage;
+    PFCPAssociationSetupRequest *request = &pfcpMessage.pFCPAssociationSetupRequest;
+    PfcpNodeId nodeId = {.type = PFCP_NODE_ID_IPV4, .addr4 = bench.localIp};
+    uint32_t recoveryTime = htonl(time(NULL) + NTP_UNIX_EPOCH_OFFSET);
+
+    memset(&pfcpMessage, 0, sizeof(PfcpMessage));
+    pfcpMessage.header.type = PFCP_ASSOCIATION_SETUP_REQUEST;
+    request->presence = 1;
+    BenchSetIe(request->nodeID, nodeId, 1 + IPV4_LEN);
+    BenchSetIe(request->recoveryTimeStamp, recoveryTime, sizeof(recoveryTime));
+
+    return PfcpBuildMessage(bufBlk, &pfcpMessage);
+}
+
+/*
+ * Rules of even index are uplink, GTP-U from access to core,
+ * and the others are downlink, whose FAR drops until it is modified
+ */
+static Status BenchBuildEstablishment(Bufblk **bufBlk, BenchSession *session) {
+    PfcpMessage pfcpMessage;
+    PFCPSessionEstablishmentRequest *request = &pfcpMessage.pFCPSessionEstablishmentRequest;
+    PfcpNodeId nodeId = {.type = PFCP_NODE_ID_IPV4, .addr4 = bench.localIp};
+    PfcpFSeid cpFSeid = {.v4 = 1, .seid = htobe64(session->index + 1), .addr4 = bench.localIp};
+    PfcpUeIpAddr ueIp[2] = {
+        {.v4 = 1, .sd = PFCP_UE_IP_ADDR_SOURCE, .addr4.s_addr = htonl(PFCP_BENCH_UE_IP_BASE + session->index + 1)},
+        {.v4 = 1, .sd = PFCP_UE_IP_ADDR_DESITINATION, .addr4.s_addr = htonl(PFCP_BENCH_UE_IP_BASE + session->index + 1)},
+    };
+    uint8_t sourceInterface[2] = {PFCP_SRC_INTF_ACCESS, PFCP_SRC_INTF_CORE};
+    uint8_t destinationInterface[2] = {PFCP_FAR_DEST_INTF_CORE, PFCP_FAR_DEST_INTF_ACCESS};
+    uint8_t applyAction[2] = {PFCP_FAR_APPLY_ACTION_FORW, PFCP_FAR_APPLY_ACTION_DROP};
+    uint8_t outerHeaderRemoval = PFCP_OUTER_HDR_RMV_DESC_GTPU_IP4;
+    uint8_t gateStatus = 0;
+    uint8_t pdnType = PFCP_PDN_TYPE_IPV4;
+    uint16_t pdrId[PFCP_BENCH_MAX_RULE];
+    uint32_t ruleId[PFCP_BENCH_MAX_RULE];
+    uint32_t precedence[PFCP_BENCH_MAX_RULE];
+    PfcpFTeid fTeid[PFCP_BENCH_MAX_RULE];
+
+    memset(&pfcpMessage, 0, sizeof(PfcpMessage));
+    pfcpMessage.header.type = PFCP_SESSION_ESTABLISHMENT_REQUEST;
+    request->presence = 1;
+    BenchSetIe(request->nodeID, nodeId, 1 + IPV4_LEN);
+    BenchSetIe(request->cPFSEID, cpFSeid, PFCP_F_SEID_IPV4_LEN);
+    BenchSetIe(request->pDNType, pdnType, sizeof(pdnType));
+
+    for (int i = 0; i < bench.numOfRule; i++) {
+        int dl = i % 2;
+
+        // Rule IDs are only unique in a session, as SMF allocates them
+        pdrId[i] = htons(i + 1);
+        ruleId[i] = htonl(i + 1);
+        precedence[i] = htonl(PFCP_BENCH_MAX_RULE - i);
+
+        CreatePDR *pdr = &request->createPDR[i];
+        pdr->presence = 1;
+        BenchSetIe(pdr->pDRID, pdrId[i], sizeof(uint16_t));
+        BenchSetIe(pdr->precedence, precedence[i], sizeof(uint32_t));
+        pdr->pDI.presence = 1;
+        BenchSetIe(pdr->pDI.sourceInterface, sourceInterface[dl], sizeof(uint8_t));
+        BenchSetIe(pdr->pDI.networkInstance, *bench.dnn, strlen(bench.dnn));
+        BenchSetIe(pdr->pDI.uEIPAddress, ueIp[dl], PFCP_UE_IP_ADDR_IPV4_LEN);
+        if (!dl) {
+            memset(&fTeid[i], 0, sizeof(PfcpFTeid));
+            fTeid[i].v4 = 1;
+            fTeid[i].teid = htonl(session->index * PFCP_BENCH_MAX_RULE + i + 1);
+            fTeid[i].addr4 = bench.upfSockAddr.s4.sin_addr;
+            BenchSetIe(pdr->pDI.localFTEID, fTeid[i], PFCP_F_TEID_IPV4_LEN);
+            BenchSetIe(pdr->outerHeaderRemoval, outerHeaderRemoval, sizeof(uint8_t));
+        }
+        BenchSetIe(pdr->fARID, ruleId[i], sizeof(uint32_t));
+        BenchSetIe(pdr->qERID[0], ruleId[i], sizeof(uint32_t));
+
+        CreateFAR *far = &request->createFAR[i];
+        far->presence = 1;
+        BenchSetIe(far->fARID, ruleId[i], sizeof(uint32_t));
+        BenchSetIe(far->applyAction, applyAction[dl], sizeof(uint8_t));
+        far->forwardingParameters.presence = 1;
+        BenchSetIe(far->forwardingParameters.destinationInterface, destinationInterface[dl], sizeof(uint8_t));
+
+        CreateQER *qer = &request->createQER[i];
+        qer->presence = 1;
+        BenchSetIe(qer->qERID, ruleId[i], sizeof(uint32_t));
+        BenchSetIe(qer->gateStatus, gateStatus, sizeof(uint8_t));
+    }
+
+    return PfcpBuildMessage(bufBlk, &pfcpMessage);
+}
+
+// Downlink FARs forward to the access network, as after the N2 path switch
+static Status BenchBuildModification(Bufblk **bufBlk, BenchSession *session) {
+    PfcpMessage pfcpMessage;
+    PFCPSessionModificationRequest *request = &pfcpMessage.pFCPSessionModificationRequest;
+    uint8_t applyAction = PFCP_FAR_APPLY_ACTION_FORW;
+    uint8_t destinationInterface = PFCP_FAR_DEST_INTF_ACCESS;
+    uint32_t ruleId[PFCP_BENCH_MAX_RULE];
+    PfcpOuterHdr outerHdr[PFCP_BENCH_MAX_RULE];
+
+    memset(&pfcpMessage, 0, sizeof(PfcpMessage));
+    pfcpMessage.header.type = PFCP_SESSION_MODIFICATION_REQUEST;
+    request->presence = 1;
+
+    for (int i = (bench.numOfRule > 1 ? 1 : 0), j = 0; i < bench.numOfRule; i += 2, j++) {
+        ruleId[i] = htonl(i + 1);
+
+        UpdateFAR *far = &request->updateFAR[j];
+        far->presence = 1;
+        BenchSetIe(far->fARID, ruleId[i], sizeof(uint32_t));
+        BenchSetIe(far->applyAction, applyAction, sizeof(uint8_t));
+        if (i % 2) {
+            memset(&outerHdr[i], 0, sizeof(PfcpOuterHdr));
+            outerHdr[i].gtpuIpv4 = 1;
+            outerHdr[i].teid = htonl(session->index * PFCP_BENCH_MAX_RULE + i + 1);
+            outerHdr[i].addr4 = bench.localIp;
+
+            far->updateForwardingParameters.presence = 1;
+            BenchSetIe(far->updateForwardingParameters.destinationInterface,
+                       destinationInterface, sizeof(uint8_t));
+            BenchSetIe(far->updateForwardingParameters.outerHeaderCreation,
+                       outerHdr[i], PFCP_OUTER_HDR_IPV4_LEN);
+        }
+    }
+
+    return PfcpBuildMessage(bufBlk, &pfcpMessage);
+}
+
+static Status BenchBuildDeletion(Bufblk **bufBlk) {
+    PfcpMessage pfcpMessage;
+
+    memset(&pfcpMessage, 0, sizeof(PfcpMessage));
+    pfcpMessage.header.type = PFCP_SESSION_DELETION_REQUEST;
+    pfcpMessage.pFCPSessionDeletionRequest.presence = 1;
+
+    return PfcpBuildMessage(bufBlk, &pfcpMessage);
+}
+
+static Status BenchSend(BenchSession *session, int procedure) {
+    Status status = STATUS_ERROR;
+    PfcpHeader header;
+    Bufblk *bufBlk = NULL;
+
+    memset(&header, 0, sizeof(PfcpHeader));
+    switch (procedure) {
+        case BENCH_ASSOCIATION:
+            header.type = PFCP_ASSOCIATION_SETUP_REQUEST;
+            status = BenchBuildAssociation(&bufBlk);
+            break;
+        case BENCH_ESTABLISHMENT:
+            header.type = PFCP_SESSION_ESTABLISHMENT_REQUEST;
+            status = BenchBuildEstablishment(&bufBlk, session);
+            break;
+        case BENCH_MODIFICATION:
+            header.type = PFCP_SESSION_MODIFICATION_REQUEST;
+            header.seid = session->upfSeid;
+            status = BenchBuildModification(&bufBlk, session);
+            break;
+        case BENCH_DELETION:
+            header.type = PFCP_SESSION_DELETION_REQUEST;
+            header.seid = session->upfSeid;
+            status = BenchBuildDeletion(&bufBlk);
+            break;
+    }
+    UTLT_Assert(status == STATUS_OK && bufBlk, return STATUS_ERROR,
+                "Build %s request fail", benchProcedureName[procedure]);
+
+    session->xact = PfcpXactLocalCreate(&bench.upf, &header, bufBlk);
+    UTLT_Assert(session->xact, return STATUS_ERROR, "Create xact fail");
+    PfcpXactStoreSession(session->xact, session);
+    session->procedure = procedure;
+    session->sentTime = BenchNow();
+
+    // Receiving a message overwrites the remote address
+    bench.upf.sock->remoteAddr = bench.upfSockAddr;
+    status = PfcpXactCommit(session->xact);
+    UTLT_Assert(status == STATUS_OK, PfcpXactDelete(session->xact); session->xact = NULL; return STATUS_ERROR,
+                "Send %s request fail", benchProcedureName[procedure]);
+
+    bench.numOfInFlight++;
+    if (bench.record)
+        bench.stat[procedure].sent++;
+
+    return STATUS_OK;
+}
+
+// Put the session back after its request is answered or timed out
+static void BenchComplete(BenchSession *session, int accepted) {
+    session->xact = NULL;
+    bench.numOfInFlight--;
+
+    if (session == &bench.nodeSession) {
+        bench.associated = accepted;
+        return;
+    }
+
+    switch (session->procedure) {
+        case BENCH_ESTABLISHMENT:
+            if (accepted) {
+                BenchRingPush(&bench.readyRing, session->index);
+            } else {
+                session->upfSeid = 0;
+                BenchRingPush(&bench.freeRing, session->index);
+            }
+            break;
+        case BENCH_MODIFICATION:
+            BenchRingPush(&bench.readyRing, session->index);
+            break;
+        case BENCH_DELETION:
+            // UPF may have removed the session even if the response is lost
+            session->upfSeid = 0;
+            BenchRingPush(&bench.freeRing, session->index);
+            break;
+    }
+}
+
+static void BenchLatencyAdd(BenchStat *stat, uint64_t latency) {
+    if (stat->numOfLatency == stat->sizeOfLatency) {
+        uint64_t size = (stat->sizeOfLatency ? stat->sizeOfLatency * 2 : 1024);
+        uint64_t *buf = realloc(stat->latency, sizeof(uint64_t) * size);
+        UTLT_Assert(buf, return, "Latency of %lu responses alloc fail", size);
+        stat->latency = buf;
+        stat->sizeOfLatency = size;
+    }
+    stat->latency[stat->numOfLatency++] = latency;
+}
+
+static uint8_t BenchResponseCause(PfcpMessage *pfcpMessage) {
+    TlvOctet *cause = NULL;
+
+    switch (pfcpMessage->header.type) {
+        case PFCP_ASSOCIATION_SETUP_RESPONSE:
+            cause = &pfcpMessage->pFCPAssociationSetupResponse.cause;
+            break;
+        case PFCP_SESSION_ESTABLISHMENT_RESPONSE:
+            cause = &pfcpMessage->pFCPSessionEstablishmentResponse.cause;
+            break;
+        case PFCP_SESSION_MODIFICATION_RESPONSE:
+            cause = &pfcpMessage->pFCPSessionModificationResponse.cause;
+            break;
+        case PFCP_SESSION_DELETION_RESPONSE:
+            cause = &pfcpMessage->pFCPSessionDeletionResponse.cause;
+            break;
+    }
+
+    if (!cause || !cause->presence || !cause->len)
+        return 0;
+
+    return *(uint8_t *) cause->value;
+}
+
+static Status BenchReceive() {
+    Status status;
+    Bufblk *bufBlk = NULL;
+    SockAddr from;
+    PfcpMessage pfcpMessage;
+    PfcpXact *xact;
+    BenchSession *session;
+
+    status = PfcpReceiveFrom(bench.upf.sock, &bufBlk, &from);
+    UTLT_Assert(status == STATUS_OK, return STATUS_ERROR, "Receive fail");
+    uint64_t now = BenchNow();
+
+    status = PfcpParseMessageInPlace(&pfcpMessage, bufBlk);
+    UTLT_Assert(status == STATUS_OK, bench.unexpected++; BufblkFree(bufBlk); return STATUS_OK,
+                "Parse message from %s fail", GetIP(&from));
+
+    // Requests of UPF and responses after timeout
+    xact = PfcpXactFindByTransactionId(&bench.upf, pfcpMessage.header.type,
+                                       PfcpSqn2TransactionId(pfcpMessage.header.sqn));
+    if (!xact || pfcpMessage.header.type != xact->seq[0].type + 1 ||
+        PfcpXactUpdateRx(xact, pfcpMessage.header.type) != STATUS_OK) {
+        UTLT_Debug("Unexpected message type %d from %s", pfcpMessage.header.type, GetIP(&from));
+        bench.unexpected++;
+        goto out;
+    }
+
+    session = xact->session;
+    uint8_t cause = BenchResponseCause(&pfcpMessage);
+    int accepted = (cause == PFCP_CAUSE_REQUEST_ACCEPTED);
+
+    if (accepted && session->procedure == BENCH_ESTABLISHMENT) {
+        FSEID *upFSeid = &pfcpMessage.pFCPSessionEstablishmentResponse.uPFSEID;
+        if (upFSeid->presence && upFSeid->len >= PFCP_F_SEID_HDR_LEN)
+            session->upfSeid = be64toh(((PfcpFSeid *) upFSeid->value)->seid);
+        else
+            accepted = 0;
+    }
+
+    if (!accepted)
+        bench.failed++;
+    if (bench.record) {
+        BenchStat *stat = &bench.stat[session->procedure];
+        if (accepted) {
+            stat->accepted++;
+        } else {
+            stat->rejected++;
+            UTLT_Debug("%s request is rejected: %s", benchProcedureName[session->procedure],
+                       PfcpCauseGetName(cause));
+        }
+        BenchLatencyAdd(stat, now - session->sentTime);
+    }
+
+    // The xact of a local request is deleted by the commit after its response
+    PfcpXactCommit(xact);
+    BenchComplete(session, accepted);
+
+out:
+    PfcpStructFree(&pfcpMessage);
+    BufblkFree(bufBlk);
+
+    return STATUS_OK;
+}
+
+static void BenchTimeoutCheck(uint64_t now) {
+    uint64_t timeout = bench.timeout * NSEC_PER_MSEC;
+
+    for (uint32_t i = 0; i <= bench.numOfSession; i++) {
+        BenchSession *session = (i < bench.numOfSession ? &bench.session[i] : &bench.nodeSession);
+
+        if (!session->xact || now - session->sentTime < timeout)
+            continue;
+
+        UTLT_Debug("%s request of session %u timeout", benchProcedureName[session->procedure], i);
+        bench.failed++;
+        if (bench.record)
+            bench.stat[session->procedure].timeout++;
+        PfcpXactDelete(session->xact);
+        BenchComplete(session, 0);
+    }
+}
+
+// Whether a request of the procedure can be sent now
+static int BenchProcedureReady(int procedure) {
+    switch (procedure) {
+        case BENCH_ASSOCIATION:
+            return !bench.nodeSession.xact;
+        case BENCH_ESTABLISHMENT:
+            return bench.freeRing.num > 0;
+        default:
+            return bench.readyRing.num > 0;
+    }
+}
+
+// Smooth weighted round robin over the procedures ready to send, or -1 if none
+static int BenchNextProcedure(const uint32_t weight[]) {
+    int32_t total = 0;
+    int next = -1;
+
+    for (int i = 0; i < BENCH_PROCEDURE_NUM; i++) {
+        if (!weight[i] || !BenchProcedureReady(i))
+            continue;
+
+        bench.credit[i] += weight[i];
+        total += weight[i];
+        if (next < 0 || bench.credit[i] > bench.credit[next])
+            next = i;
+    }
+    if (next >= 0)
+        bench.credit[next] -= total;
+
+    return next;
+}
+
+static BenchSession *BenchSessionTake(int procedure) {
+    switch (procedure) {
+        case BENCH_ASSOCIATION:
+            return &bench.nodeSession;
+        case BENCH_ESTABLISHMENT:
+            return &bench.session[BenchRingPop(&bench.freeRing)];
+        default:
+            return &bench.session[BenchRingPop(&bench.readyRing)];
+    }
+}
+
+/*
+ * Send @numOfRequest requests in the mix of @weight at @rate per second,
+ * or as fast as the window allows if @rate is 0, and wait for their responses
+ */
+static Status BenchRun(uint64_t numOfRequest, uint64_t rate, const uint32_t weight[], uint64_t *elapsed) {
+    struct pollfd pfd = {.fd = bench.upf.sock->fd, .events = POLLIN};
+    uint64_t start = BenchNow(), lastCheck = start, sent = 0;
+
+    memset(bench.credit, 0, sizeof(bench.credit));
+
+    while (sent < numOfRequest || bench.numOfInFlight) {
+        uint64_t now = BenchNow();
+        int procedure = 0, wait = PFCP_BENCH_CHECK_MSEC;
+
+        while (sent < numOfRequest && bench.numOfInFlight < bench.window) {
+            uint64_t due = (rate ? sent * NSEC_PER_SEC / rate : 0);
+            if (due > now - start) {
+                wait = (due - (now - start)) / NSEC_PER_MSEC;
+                break;
+            }
+
+            procedure = BenchNextProcedure(weight);
+            if (procedure < 0)
+                break;
+
+            UTLT_Assert(BenchSend(BenchSessionTake(procedure), procedure) == STATUS_OK,
+                        return STATUS_ERROR, "");
+            sent++;
+        }
+
+        if (procedure < 0 && !bench.numOfInFlight && sent < numOfRequest) {
+            UTLT_Warning("No request of the mix can be sent, stop after %lu requests", sent);
+            break;
+        }
+
+        if (poll(&pfd, 1, wait) > 0) {
+            for (int i = 0; i < PFCP_BENCH_MAX_RECV_BATCH; i++) {
+                UTLT_Assert(BenchReceive() == STATUS_OK, return STATUS_ERROR, "");
+                if (poll(&pfd, 1, 0) <= 0)
+                    break;
+            }
+        }
+
+        now = BenchNow();
+        if (now - lastCheck >= PFCP_BENCH_CHECK_MSEC * NSEC_PER_MSEC) {
+            BenchTimeoutCheck(now);
+            lastCheck = now;
+        }
+    }
+
+    if (elapsed)
+        *elapsed = BenchNow() - start;
+
+    return STATUS_OK;
+}
+
+static int BenchLatencyCompare(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+    return (x > y) - (x < y);
+}
+
+// Nearest rank of sorted latency in usec
+static double BenchPercentile(const uint64_t *latency, uint64_t num, double percent) {
+    if (!num)
+        return 0;
+
+    uint64_t rank = (uint64_t) (percent / 100 * num + 0.999999);
+    return (double) latency[(rank ? rank - 1 : 0)] / 1000;
+}
+
+static void BenchReportLine(const char *name, BenchStat *stat, uint64_t elapsed) {
+    uint64_t *latency = stat->latency;
+    uint64_t num = stat->numOfLatency;
+
+    qsort(latency, num, sizeof(uint64_t), BenchLatencyCompare);
+    printf("%-14s %10lu %10lu %10lu %8lu %12.1f %10.1f %10.1f %10.1f %10.1f\n",
+           name, stat->sent, stat->accepted, stat->rejected, stat->timeout,
+           (double) (stat->accepted + stat->rejected) * NSEC_PER_SEC / (elapsed ? elapsed : 1),
+           BenchPercentile(latency, num, 50), BenchPercentile(latency, num, 99),
+           BenchPercentile(latency, num, 99.9), BenchPercentile(latency, num, 100));
+}
+
+static void BenchReport(uint64_t elapsed) {
+    BenchStat total;
+
+    memset(&total, 0, sizeof(BenchStat));
+    printf("\nUPF %s, %u sessions with %d PDR/FAR/QER, window %u, %.3f s\n\n",
+           bench.upfAddr, bench.numOfSession, bench.numOfRule, bench.window,
+           (double) elapsed / NSEC_PER_SEC);
+    printf("%-14s %10s %10s %10s %8s %12s %10s %10s %10s %10s\n",
+           "Procedure", "Sent", "Accepted", "Rejected", "Timeout", "Resp/s",
+           "p50(us)", "p99(us)", "p99.9(us)", "max(us)");
+
+    for (int i = 0; i < BENCH_PROCEDURE_NUM; i++) {
+        BenchStat *stat = &bench.stat[i];
+        if (!stat->sent)
+            continue;
+
+        BenchReportLine(benchProcedureName[i], stat, elapsed);
+
+        total.sent += stat->sent;
+        total.accepted += stat->accepted;
+        total.rejected += stat->rejected;
+        total.timeout += stat->timeout;
+        for (uint64_t j = 0; j < stat->numOfLatency; j++)
+            BenchLatencyAdd(&total, stat->latency[j]);
+    }
+
+    BenchReportLine("Total", &total, elapsed);
+    if (bench.unexpected)
+        printf("\n%lu unexpected messages are dropped\n", bench.unexpected);
+
+    free(total.latency);
+}
+
+static void BenchUsage(const char *name) {
+    printf("Usage: %s [options]\n"
+           "  -u addr     PFCP address of UPF (default: %s)\n"
+           "  -l addr     Local address to bind PFCP port %d (default: %s)\n"
+           "  -n num      Requests to send after association (default: %lu)\n"
+           "  -s num      Sessions at most (default: %u)\n"
+           "  -p num      PDR/FAR/QER per session, 1 to %d (default: %d)\n"
+           "  -m a:e:m:d  Weights of association, establishment, modification\n"
+           "              and deletion in the mix (default: %u:%u:%u:%u)\n"
+           "  -r rate     Requests per second, 0 as fast as the window allows (default: %lu)\n"
+           "  -w num      Requests in flight at most (default: %u)\n"
+           "  -t msec     Response timeout (default: %u)\n"
+           "  -d dnn      Network instance of PDI (default: %s)\n"
+           "  -k          Keep established sessions at exit\n"
+           "  -v level    Log level (default: %s)\n"
+           "  -h          Show this help\n",
+           name, bench.upfAddr, PFCP_BENCH_PORT, bench.localAddr, bench.numOfRequest,
+           bench.numOfSession, PFCP_BENCH_MAX_RULE, bench.numOfRule,
+           bench.weight[BENCH_ASSOCIATION], bench.weight[BENCH_ESTABLISHMENT],
+           bench.weight[BENCH_MODIFICATION], bench.weight[BENCH_DELETION],
+           bench.rate, bench.window, bench.timeout, bench.dnn, bench.logLevel);
+}
+
+static Status BenchParseArgs(int argc, char *argv[]) {
+    int opt;
+
+    bench.upfAddr = "127.0.0.8";
+    bench.localAddr = "127.0.0.1";
+    bench.dnn = "internet";
+    bench.logLevel = "warning";
+    bench.numOfRequest = 100000;
+    bench.numOfSession = 1024;
+    bench.numOfRule = 2;
+    bench.rate = 0;
+    bench.window = PFCP_BENCH_MAX_WINDOW;
+    bench.timeout = 3000;
+    bench.weight[BENCH_ASSOCIATION] = 0;
+    bench.weight[BENCH_ESTABLISHMENT] = 1;
+    bench.weight[BENCH_MODIFICATION] = 1;
+    bench.weight[BENCH_DELETION] = 1;
+
+    while ((opt = getopt(argc, argv, "u:l:n:s:p:m:r:w:t:d:kv:h")) != -1) {
+        switch (opt) {
+            case 'u':
+                bench.upfAddr = optarg;
+                break;
+            case 'l':
+                bench.localAddr = optarg;
+                break;
+            case 'n':
+                bench.numOfRequest = strtoull(optarg, NULL, 0);
+                break;
+            case 's':
+                bench.numOfSession = strtoul(optarg, NULL, 0);
+                break;
+            case 'p':
+                bench.numOfRule = atoi(optarg);
+                break;
+            case 'm':
+                UTLT_Assert(sscanf(optarg, "%u:%u:%u:%u", &bench.weight[BENCH_ASSOCIATION],
+                                   &bench.weight[BENCH_ESTABLISHMENT], &bench.weight[BENCH_MODIFICATION],
+                                   &bench.weight[BENCH_DELETION]) == BENCH_PROCEDURE_NUM,
+                            return STATUS_ERROR, "Mix should be 4 weights like 0:1:1:1");
+                break;
+            case 'r':
+                bench.rate = strtoull(optarg, NULL, 0);
+                break;
+            case 'w':
+                bench.window = strtoul(optarg, NULL, 0);
+                break;
+            case 't':
+                bench.timeout = strtoul(optarg, NULL, 0);
+                break;
+            case 'd':
+                bench.dnn = optarg;
+                break;
+            case 'k':
+                bench.keepSession = 1;
+                break;
+            case 'v':
+                bench.logLevel = optarg;
+                break;
+            case 'h':
+            default:
+                BenchUsage(argv[0]);
+                return STATUS_ERROR;
+        }
+    }
+
+    UTLT_Assert(bench.numOfSession > 0, return STATUS_ERROR, "Number of sessions should be positive");
+    UTLT_Assert(bench.numOfRule > 0 && bench.numOfRule <= PFCP_BENCH_MAX_RULE, return STATUS_ERROR,
+                "PDR/FAR/QER per session should be 1 to %d", PFCP_BENCH_MAX_RULE);
+    UTLT_Assert(bench.window > 0 && bench.window <= PFCP_BENCH_MAX_WINDOW, return STATUS_ERROR,
+                "Window should be 1 to %d", PFCP_BENCH_MAX_WINDOW);
+    UTLT_Assert(bench.timeout > 0, return STATUS_ERROR, "Timeout should be positive");
+
+    return STATUS_OK;
+}
+
+static Status BenchInit() {
+    Sock *sock;
+
+    UTLT_Assert(BufblkPoolInit() == STATUS_OK, return STATUS_ERROR, "");
+    UTLT_Assert(SockPoolInit() == STATUS_OK, return STATUS_ERROR, "");
+    // Local xacts have no timer, the bench times out requests itself
+    UTLT_Assert(PfcpXactInit(NULL, 0, 0, 0) == STATUS_OK, return STATUS_ERROR, "");
+
+    sock = UdpServerCreate(AF_INET, bench.localAddr, PFCP_BENCH_PORT);
+    UTLT_Assert(sock && sock->fd >= 0, return STATUS_ERROR,
+                "Bind %s:%d fail", bench.localAddr, PFCP_BENCH_PORT);
+    UTLT_Assert(SockSetAddr(&bench.upfSockAddr, AF_INET, bench.upfAddr, PFCP_BENCH_PORT) == STATUS_OK,
+                return STATUS_ERROR, "UPF address %s is not IPv4", bench.upfAddr);
+    bench.localIp = sock->localAddr.s4.sin_addr;
+
+    memset(&bench.upf, 0, sizeof(PfcpNode));
+    ListHeadInit(&bench.upf.localList);
+    ListHeadInit(&bench.upf.remoteList);
+    bench.upf.sock = sock;
+    sock->remoteAddr = bench.upfSockAddr;
+
+    bench.session = calloc(bench.numOfSession, sizeof(BenchSession));
+    UTLT_Assert(bench.session, return STATUS_ERROR, "%u sessions alloc fail", bench.numOfSession);
+    UTLT_Assert(BenchRingInit(&bench.freeRing, bench.numOfSession) == STATUS_OK, return STATUS_ERROR, "");
+    UTLT_Assert(BenchRingInit(&bench.readyRing, bench.numOfSession) == STATUS_OK, return STATUS_ERROR, "");
+    for (uint32_t i = 0; i < bench.numOfSession; i++) {
+        bench.session[i].index = i;
+        BenchRingPush(&bench.freeRing, i);
+    }
+
+    return STATUS_OK;
+}
+
+static void BenchTerm() {
+    if (bench.upf.sock) {
+        PfcpXactDeleteAll(&bench.upf);
+        SockFree(bench.upf.sock);
+    }
+    PfcpXactTerminate();
+    SockPoolFinal();
+    BufblkPoolFinal();
+
+    for (int i = 0; i < BENCH_PROCEDURE_NUM; i++)
+        free(bench.stat[i].latency);
+    free(bench.freeRing.index);
+    free(bench.readyRing.index);
+    free(bench.session);
+}
+
+int main(int argc, char *argv[]) {
+    const uint32_t association[BENCH_PROCEDURE_NUM] = {[BENCH_ASSOCIATION] = 1};
+    const uint32_t deletion[BENCH_PROCEDURE_NUM] = {[BENCH_DELETION] = 1};
+    uint64_t elapsed = 0;
+    int ret = EXIT_FAILURE;
+
+    if (BenchParseArgs(argc, argv) != STATUS_OK)
+        return EXIT_FAILURE;
+    UTLT_Assert(UTLT_SetLogLevel(bench.logLevel) == STATUS_OK, return EXIT_FAILURE,
+                "Log level %s is not supported", bench.logLevel);
+    UTLT_Assert(BenchInit() == STATUS_OK, goto term, "Init fail");
+
+    UTLT_Assert(BenchRun(1, 0, association, NULL) == STATUS_OK && bench.associated,
+                goto term, "Association Setup with UPF %s fail", bench.upfAddr);
+
+    bench.record = 1;
+    UTLT_Assert(BenchRun(bench.numOfRequest, bench.rate, bench.weight, &elapsed) == STATUS_OK,
+                goto term, "Benchmark fail");
+    bench.record = 0;
+
+    if (!bench.keepSession)
+        UTLT_Assert(BenchRun(bench.readyRing.num, 0, deletion, NULL) == STATUS_OK, ,
+                    "Delete %u sessions fail", bench.readyRing.num);
+
+    BenchReport(elapsed);
+    UTLT_Assert(!bench.failed, goto term, "%lu requests are rejected or timeout", bench.failed);
+    ret = EXIT_SUCCESS;
+
+term:
+    BenchTerm();
+
+    return ret;
+}
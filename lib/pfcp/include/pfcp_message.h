@@ -986,6 +986,7 @@ typedef struct _PFCPSessionEstablishmentRequest {
 
 typedef struct _PfcpMessage {
     PfcpHeader header;
+    _Bool ieInPlace; // IE values point into the parsed buffer, see PfcpParseMessageInPlace()
     union {
         HeartbeatRequest heartbeatRequest;
         HeartbeatResponse heartbeatResponse;
@@ -1014,6 +1015,13 @@ typedef struct _PfcpMessage {
 
 Status PfcpParseMessage(PfcpMessage *pfcpMessage, Bufblk *buf);
 
+/*
+ * Parse without any allocation, the value of each TlvOctet points into @buf
+ * instead of a copy. @buf must be kept and unchanged until @pfcpMessage is
+ * done, and PfcpStructFree() has nothing to free for such a message.
+ */
+Status PfcpParseMessageInPlace(PfcpMessage *pfcpMessage, Bufblk *buf);
+
 Status PfcpBuildMessage(Bufblk **bufBlkPtr, PfcpMessage *pfcpMessage);
 
   Status PfcpStructFree(PfcpMessage *pfcpMessage);
@@ -7,6 +7,8 @@
 #include "utlt_list.h"
 #include "utlt_index.h"
 #include "utlt_buff.h"
+#include "utlt_hash.h"
+#include "utlt_event.h"
 
 #include "pfcp_message.h"
 
@@ -16,6 +18,18 @@
 extern "C" {
 #endif /* __cplusplus */
 
+/*
+ * Remote xacts are held for the duplicated duration to answer retransmissions,
+ * so the pool also bounds the sustained rate of N4 requests
+ */
+#define SIZE_OF_PFCP_XACT_POOL          65536
+
+typedef struct _PfcpXactKey {
+    PfcpNode    *gnode;
+    uint32_t    transactionId;
+    uint8_t     origin;
+} __attribute__ ((packed)) PfcpXactKey;
+
 typedef struct _PfcpXact {
     ListHead    node;
     uint32_t    index;
@@ -25,6 +39,8 @@ typedef struct _PfcpXact {
     uint8_t     origin;
     uint32_t    transactionId;
     PfcpNode    *gnode;
+    PfcpXactKey key;                // Key in the xact table of the thread handling it
+    Hash        *ownerTable;        // That table, only its thread deletes the xact
 
     int         step;               // 1: Init, 2: Trigger, 3: Trigger Reply
     struct {
@@ -58,8 +74,23 @@ typedef enum {
     PFCP_XACT_FINAL_STAGE,
 } PfcpXactStage;
 
-Status PfcpXactInit(TimerList *timerList, uintptr_t responseEvent, uintptr_t holdingEvent);
+// Xacts are taken on demand up to @capacity, 0 is SIZE_OF_PFCP_XACT_POOL
+Status PfcpXactInit(TimerList *timerList, uintptr_t responseEvent, uintptr_t holdingEvent,
+                    uint32_t capacity);
 Status PfcpXactTerminate();
+/**
+ * Xacts are found in the table of the thread handling them, so all messages
+ * of a transaction must be handled by the same thread, which is also the only
+ * one deleting them. Timer events of xacts created by the thread are sent to
+ * @eventQ.
+ *
+ * PfcpXactInit() does it for the calling thread with no @eventQ, whose timer
+ * events go to the queue passed to TimerExpireCheck(), so that thread must be
+ * the receiver of that queue.
+ */
+Status PfcpXactThreadInit(EvtQId eventQ);
+// Delete the xacts of the calling thread, before the queue of their timer events is gone
+void PfcpXactThreadTerm();
 PfcpXact *PfcpXactLocalCreate(PfcpNode *gnode, PfcpHeader *header, Bufblk *bufBlk);
 PfcpXact *PfcpXactRemoteCreate(PfcpNode *gnode, uint32_t sqn);
 Status PfcpXactUpdateTx(PfcpXact *xact, PfcpHeader *header, Bufblk *bufBlk);
@@ -67,7 +98,7 @@ Status PfcpXactUpdateRx(PfcpXact *xact, uint8_t type);
 Status PfcpXactCommit(PfcpXact *xact);
 Status PfcpXactTimeout(uint32_t index, uint32_t event, uint8_t *type);
 Status PfcpXactReceive(PfcpNode *gnode, PfcpHeader *header, PfcpXact **xact);
-// Used by local only
+// Used by local only, after PfcpXactThreadTerm() of the other threads handling the node
 void PfcpXactDeleteAll(PfcpNode *gnode);
 PfcpXact *PfcpXactFind(uint32_t index);
 //static PfcpXactStage PfcpXactGetStage(uint8_t type, uint32_t transactionId);
@@ -2,6 +2,7 @@
 
 #include <endian.h>
 #include <string.h>
+#include <pthread.h>
 #include <netinet/in.h>
 
 #include "utlt_debug.h"
@@ -191,16 +192,54 @@ static IeDescription ieDescriptionTable[] = {\
 
 _Bool dbf = 0;
 
-int _TlvParseMessage(void * msg, IeDescription * msgDes, void * buff, int buffLen) {
-    int msgPivot = 0; // msg (struct) offset
-    //void *root = buff;
+#define TLV_HEADER_LEN (sizeof(uint16_t) * 2)
+
+#define NUM_OF_IE_DESCRIPTION (sizeof(ieDescriptionTable) / sizeof(IeDescription))
+#define SIZE_OF_IE_TYPE_INDEX 256 // All IE types in ieDescriptionTable are less than it
+
+/*
+ * Index of the members of each message and grouped IE by IE type, built once.
+ * ieTypeIndex has 1 + the first member index with the type, ieNextSameType
+ * chains the members with the same type, e.g. createPDR[0..3], and
+ * ieMemberOffset is the offset of the member behind the presence.
+ */
+static uint8_t ieTypeIndex[NUM_OF_IE_DESCRIPTION][SIZE_OF_IE_TYPE_INDEX];
+static uint8_t ieNextSameType[NUM_OF_IE_DESCRIPTION][80];
+static uint16_t ieMemberOffset[NUM_OF_IE_DESCRIPTION][80];
+static pthread_once_t ieIndexOnce = PTHREAD_ONCE_INIT;
+
+static void _PfcpIeIndexInit() {
+    for (int des = 0; des < NUM_OF_IE_DESCRIPTION; des++) {
+        uint8_t *lastSameType[SIZE_OF_IE_TYPE_INDEX] = {0};
+        int msgPivot = 0;
+
+        for (int idx = 0; idx < ieDescriptionTable[des].numToParse; idx++) {
+            IeDescription *ieDes = &ieDescriptionTable[ieDescriptionTable[des].next[idx]];
+
+            ieMemberOffset[des][idx] = msgPivot;
+            msgPivot += ieDes->msgLen;
+
+            if (lastSameType[ieDes->msgType])
+                *lastSameType[ieDes->msgType] = idx + 1;
+            else
+                ieTypeIndex[des][ieDes->msgType] = idx + 1;
+            lastSameType[ieDes->msgType] = &ieNextSameType[des][idx];
+        }
+    }
+}
+
+/*
+ * Decode the IEs in buff into msg, which is the struct behind the presence,
+ * in a single scan. IEs may come in any order, repeated IEs fill the array
+ * in the order they arrive, and unknown or extra IEs are skipped. msg must be
+ * zeroed before. With inPlace, the value of each TlvOctet points into buff
+ * instead of a copy.
+ */
+static int _TlvParseMessageMode(void * msg, IeDescription * msgDes, void * buff, int buffLen, _Bool inPlace) {
+    int des = msgDes - ieDescriptionTable;
     int buffOffset = 0; // buff offset
-    int idx;
-    for (idx = 0; idx < msgDes->numToParse; ++idx) {
-        if (dbf) { if (ieDescriptionTable[msgDes->next[idx]].msgType == 57) {
-                UTLT_Warning("Get F-SEID");
-            } }
-        IeDescription *ieDes = &ieDescriptionTable[msgDes->next[idx]];
+
+    while (buffOffset + TLV_HEADER_LEN <= buffLen) {
         uint16_t type;
         uint16_t length;
         memcpy(&type, buff + buffOffset, sizeof(uint16_t));
@@ -208,39 +247,50 @@ int _TlvParseMessage(void * msg, IeDescription * msgDes, void * buff, int buffLe
         type = ntohs(type);
         length = ntohs(length);
         if (dbf) { UTLT_Info("type: %d, len: %d", type, length); }
-        if (type != ieDes->msgType) {
-            if (dbf) { UTLT_Warning("%d not present, type: %d", ieDes->msgType, type); }
-            // not present
-            (*(unsigned long*)(msg + msgPivot)) = 0; // presence
-            msgPivot += ieDes->msgLen;
+        if (length > buffLen - buffOffset - TLV_HEADER_LEN) {
+            UTLT_Warning("IE type %d length %d exceeds the message", type, length);
+            break;
+        }
+
+        // The first member of this type which is not filled yet
+        int idx = (type < SIZE_OF_IE_TYPE_INDEX ? ieTypeIndex[des][type] : 0);
+        while (idx && *(unsigned long *)(msg + ieMemberOffset[des][idx - 1]))
+            idx = ieNextSameType[des][idx - 1];
+        if (!idx) {
+            UTLT_Debug("IE type %d is skipped in message type %d", type, msgDes->msgType);
+            buffOffset += TLV_HEADER_LEN + length;
             continue;
         }
 
+        IeDescription *ieDes = &ieDescriptionTable[msgDes->next[idx - 1]];
+        void *member = msg + ieMemberOffset[des][idx - 1];
+        void *value = buff + buffOffset + TLV_HEADER_LEN;
+
         if (ieDes->isTlvObj) {
-            if (dbf) { UTLT_Info("is TLV: %p", msg+msgPivot); }
-            ((TlvOctet*)(msg+msgPivot))->presence = 1;
-            ((TlvOctet*)(msg+msgPivot))->type = type;
-            void *newBuf = UTLT_Malloc(length);
-            memcpy(newBuf, buff + buffOffset + 2*sizeof(uint16_t), length);
-            ((TlvOctet*)(msg+msgPivot))->len = length;
-            ((TlvOctet*)(msg+msgPivot))->value = newBuf;
-            buffOffset += sizeof(uint16_t)*2 + length;
-            msgPivot += sizeof(TlvOctet);
-            continue;
+            if (dbf) { UTLT_Info("is TLV: %p", member); }
+            ((TlvOctet*)member)->presence = 1;
+            ((TlvOctet*)member)->type = type;
+            if (inPlace) {
+                ((TlvOctet*)member)->value = value;
+            } else {
+                void *newBuf = UTLT_Malloc(length);
+                memcpy(newBuf, value, length);
+                ((TlvOctet*)member)->value = newBuf;
+            }
+            ((TlvOctet*)member)->len = length;
         } else {
             if (dbf) { UTLT_Info("not TLV, desTB mstype: %d", ieDes->msgType); }
             // recursive
-            *((unsigned long*)(msg+msgPivot)) = 1; // presence
-            _TlvParseMessage(msg+msgPivot+sizeof(unsigned long), ieDes, buff + buffOffset + sizeof(uint16_t)*2, buffLen - buffOffset);
-            //int size = _TlvParseMessage(msg+msgPivot, ieDes, buff + buffOffset, buffLen - buffOffset);
-            buffOffset += length + sizeof(uint16_t)*2;
-            msgPivot += ieDes->msgLen;
+            *((unsigned long*)member) = 1; // presence
+            _TlvParseMessageMode(member + sizeof(unsigned long), ieDes, value, length, inPlace);
         }
+        buffOffset += TLV_HEADER_LEN + length;
     }
+
     return buffOffset;
 }
 
-Status PfcpParseMessage(PfcpMessage *pfcpMessage, Bufblk *bufBlk) {
+static Status _PfcpParseMessage(PfcpMessage *pfcpMessage, Bufblk *bufBlk, _Bool inPlace) {
     Status status = STATUS_OK;
     PfcpHeader *header = NULL;
     uint16_t size = 0;
@@ -255,6 +305,8 @@ Status PfcpParseMessage(PfcpMessage *pfcpMessage, Bufblk *bufBlk) {
     UTLT_Assert(header, return STATUS_ERROR, "header hasn't get pointer");
 
     memset(pfcpMessage, 0, sizeof(PfcpMessage)); // clear pfcpMessage
+    pfcpMessage->ieInPlace = inPlace;
+    pthread_once(&ieIndexOnce, _PfcpIeIndexInit);
 
     if (header->seidP) {
         size = PFCP_HEADER_LEN;
@@ -280,93 +332,93 @@ Status PfcpParseMessage(PfcpMessage *pfcpMessage, Bufblk *bufBlk) {
     switch(pfcpMessage->header.type) {
         case PFCP_HEARTBEAT_REQUEST:
             pfcpMessage->heartbeatRequest.presence = 1;
-            _TlvParseMessage((unsigned long *)&pfcpMessage->heartbeatRequest + 1, &ieDescriptionTable[PFCP_HEARTBEAT_REQUEST + 155], body, bodyLen);
+            _TlvParseMessageMode((unsigned long *)&pfcpMessage->heartbeatRequest + 1, &ieDescriptionTable[PFCP_HEARTBEAT_REQUEST + 155], body, bodyLen, inPlace);
             break;
         case PFCP_HEARTBEAT_RESPONSE:
             pfcpMessage->heartbeatResponse.presence = 1;
-            _TlvParseMessage((unsigned long *)&pfcpMessage->heartbeatResponse + 1, &ieDescriptionTable[PFCP_HEARTBEAT_RESPONSE + 155], body, bodyLen);
+            _TlvParseMessageMode((unsigned long *)&pfcpMessage->heartbeatResponse + 1, &ieDescriptionTable[PFCP_HEARTBEAT_RESPONSE + 155], body, bodyLen, inPlace);
             break;
         case PFCPPFD_MANAGEMENT_REQUEST:
             pfcpMessage->pFCPPFDManagementRequest.presence = 1;
-            _TlvParseMessage((unsigned long *)&pfcpMessage->pFCPPFDManagementRequest + 1, &ieDescriptionTable[PFCPPFD_MANAGEMENT_REQUEST + 155], body, bodyLen);
+            _TlvParseMessageMode((unsigned long *)&pfcpMessage->pFCPPFDManagementRequest + 1, &ieDescriptionTable[PFCPPFD_MANAGEMENT_REQUEST + 155], body, bodyLen, inPlace);
             break;
         case PFCPPFD_MANAGEMENT_RESPONSE:
             pfcpMessage->pFCPPFDManagementResponse.presence = 1;
-            _TlvParseMessage((unsigned long *)&pfcpMessage->pFCPPFDManagementResponse + 1, &ieDescriptionTable[PFCPPFD_MANAGEMENT_RESPONSE + 155], body, bodyLen);
+            _TlvParseMessageMode((unsigned long *)&pfcpMessage->pFCPPFDManagementResponse + 1, &ieDescriptionTable[PFCPPFD_MANAGEMENT_RESPONSE + 155], body, bodyLen, inPlace);
             break;
         case PFCP_ASSOCIATION_SETUP_REQUEST:
             pfcpMessage->pFCPAssociationSetupRequest.presence = 1;
-            _TlvParseMessage((unsigned long *)&pfcpMessage->pFCPAssociationSetupRequest + 1, &ieDescriptionTable[PFCP_ASSOCIATION_SETUP_REQUEST+155], body, bodyLen);
+            _TlvParseMessageMode((unsigned long *)&pfcpMessage->pFCPAssociationSetupRequest + 1, &ieDescriptionTable[PFCP_ASSOCIATION_SETUP_REQUEST+155], body, bodyLen, inPlace);
             break;
         case PFCP_ASSOCIATION_SETUP_RESPONSE:
             pfcpMessage->pFCPAssociationSetupResponse.presence = 1;
-            _TlvParseMessage((unsigned long *)&pfcpMessage->pFCPAssociationSetupResponse + 1, &ieDescriptionTable[PFCP_ASSOCIATION_SETUP_RESPONSE+155], body, bodyLen);
+            _TlvParseMessageMode((unsigned long *)&pfcpMessage->pFCPAssociationSetupResponse + 1, &ieDescriptionTable[PFCP_ASSOCIATION_SETUP_RESPONSE+155], body, bodyLen, inPlace);
             break;
         case PFCP_ASSOCIATION_UPDATE_REQUEST:
             pfcpMessage->pFCPAssociationUpdateRequest.presence = 1;
-            _TlvParseMessage((unsigned long *)&pfcpMessage->pFCPAssociationUpdateRequest + 1, &ieDescriptionTable[PFCP_ASSOCIATION_UPDATE_REQUEST+155], body, bodyLen);
+            _TlvParseMessageMode((unsigned long *)&pfcpMessage->pFCPAssociationUpdateRequest + 1, &ieDescriptionTable[PFCP_ASSOCIATION_UPDATE_REQUEST+155], body, bodyLen, inPlace);
             break;
         case PFCP_ASSOCIATION_UPDATE_RESPONSE:
             pfcpMessage->pFCPAssociationUpdateResponse.presence = 1;
-            _TlvParseMessage((unsigned long *)&pfcpMessage->pFCPAssociationUpdateResponse + 1, &ieDescriptionTable[PFCP_ASSOCIATION_UPDATE_RESPONSE+155], body, bodyLen);
+            _TlvParseMessageMode((unsigned long *)&pfcpMessage->pFCPAssociationUpdateResponse + 1, &ieDescriptionTable[PFCP_ASSOCIATION_UPDATE_RESPONSE+155], body, bodyLen, inPlace);
             break;
         case PFCP_ASSOCIATION_RELEASE_REQUEST:
             pfcpMessage->pFCPAssociationReleaseRequest.presence = 1;
-            _TlvParseMessage((unsigned long *)&pfcpMessage->pFCPAssociationReleaseRequest + 1, &ieDescriptionTable[PFCP_ASSOCIATION_RELEASE_REQUEST+155], body, bodyLen);
+            _TlvParseMessageMode((unsigned long *)&pfcpMessage->pFCPAssociationReleaseRequest + 1, &ieDescriptionTable[PFCP_ASSOCIATION_RELEASE_REQUEST+155], body, bodyLen, inPlace);
             break;
         case PFCP_ASSOCIATION_RELEASE_RESPONSE:
             pfcpMessage->pFCPAssociationReleaseResponse.presence = 1;
-            _TlvParseMessage((unsigned long *)&pfcpMessage->pFCPAssociationReleaseResponse + 1, &ieDescriptionTable[PFCP_ASSOCIATION_RELEASE_RESPONSE+155], body, bodyLen);
+            _TlvParseMessageMode((unsigned long *)&pfcpMessage->pFCPAssociationReleaseResponse + 1, &ieDescriptionTable[PFCP_ASSOCIATION_RELEASE_RESPONSE+155], body, bodyLen, inPlace);
             break;
         case PFCP_VERSION_NOT_SUPPORTED_RESPONSE:
             break;
         case PFCP_NODE_REPORT_REQUEST:
             pfcpMessage->pFCPNodeReportRequest.presence = 1;
-            _TlvParseMessage((unsigned long *)&pfcpMessage->pFCPNodeReportRequest + 1, &ieDescriptionTable[PFCP_NODE_REPORT_REQUEST + 155 - 1], body, bodyLen);
+            _TlvParseMessageMode((unsigned long *)&pfcpMessage->pFCPNodeReportRequest + 1, &ieDescriptionTable[PFCP_NODE_REPORT_REQUEST + 155 - 1], body, bodyLen, inPlace);
             break;
         case PFCP_NODE_REPORT_RESPONSE:
             pfcpMessage->pFCPNodeReportResponse.presence = 1;
-            _TlvParseMessage((unsigned long *)&pfcpMessage->pFCPNodeReportResponse + 1, &ieDescriptionTable[PFCP_NODE_REPORT_RESPONSE + 155 - 1], body, bodyLen);
+            _TlvParseMessageMode((unsigned long *)&pfcpMessage->pFCPNodeReportResponse + 1, &ieDescriptionTable[PFCP_NODE_REPORT_RESPONSE + 155 - 1], body, bodyLen, inPlace);
             break;
         case PFCP_SESSION_SET_DELETION_REQUEST:
             pfcpMessage->pFCPSessionSetDeletionRequest.presence = 1;
-            _TlvParseMessage((unsigned long *)&pfcpMessage->pFCPSessionSetDeletionRequest + 1, &ieDescriptionTable[PFCP_SESSION_SET_DELETION_REQUEST + 155 - 1], body, bodyLen);
+            _TlvParseMessageMode((unsigned long *)&pfcpMessage->pFCPSessionSetDeletionRequest + 1, &ieDescriptionTable[PFCP_SESSION_SET_DELETION_REQUEST + 155 - 1], body, bodyLen, inPlace);
             break;
         case PFCP_SESSION_SET_DELETION_RESPONSE:
             pfcpMessage->pFCPSessionSetDeletionResponse.presence = 1;
-            _TlvParseMessage((unsigned long *)&pfcpMessage->pFCPSessionSetDeletionResponse + 1, &ieDescriptionTable[PFCP_SESSION_SET_DELETION_RESPONSE + 155 - 1], body, bodyLen);
+            _TlvParseMessageMode((unsigned long *)&pfcpMessage->pFCPSessionSetDeletionResponse + 1, &ieDescriptionTable[PFCP_SESSION_SET_DELETION_RESPONSE + 155 - 1], body, bodyLen, inPlace);
             break;
         case PFCP_SESSION_ESTABLISHMENT_REQUEST:
             pfcpMessage->pFCPSessionEstablishmentRequest.presence = 1;
-            _TlvParseMessage((unsigned long *)&pfcpMessage->pFCPSessionEstablishmentRequest + 1, &ieDescriptionTable[PFCP_SESSION_ESTABLISHMENT_REQUEST + 155 - (50-15) - 1], body, bodyLen);
+            _TlvParseMessageMode((unsigned long *)&pfcpMessage->pFCPSessionEstablishmentRequest + 1, &ieDescriptionTable[PFCP_SESSION_ESTABLISHMENT_REQUEST + 155 - (50-15) - 1], body, bodyLen, inPlace);
             break;
         case PFCP_SESSION_ESTABLISHMENT_RESPONSE:
             pfcpMessage->pFCPSessionEstablishmentResponse.presence = 1;
-            _TlvParseMessage((unsigned long *)&pfcpMessage->pFCPSessionEstablishmentResponse + 1, &ieDescriptionTable[PFCP_SESSION_ESTABLISHMENT_RESPONSE + 155 - (50-15) - 1], body, bodyLen);
+            _TlvParseMessageMode((unsigned long *)&pfcpMessage->pFCPSessionEstablishmentResponse + 1, &ieDescriptionTable[PFCP_SESSION_ESTABLISHMENT_RESPONSE + 155 - (50-15) - 1], body, bodyLen, inPlace);
             break;
         case PFCP_SESSION_MODIFICATION_REQUEST:
             pfcpMessage->pFCPSessionModificationRequest.presence = 1;
-            _TlvParseMessage((unsigned long *)&pfcpMessage->pFCPSessionModificationRequest + 1, &ieDescriptionTable[PFCP_SESSION_MODIFICATION_REQUEST + 155 - (50-15) - 1], body, bodyLen);
+            _TlvParseMessageMode((unsigned long *)&pfcpMessage->pFCPSessionModificationRequest + 1, &ieDescriptionTable[PFCP_SESSION_MODIFICATION_REQUEST + 155 - (50-15) - 1], body, bodyLen, inPlace);
             break;
         case PFCP_SESSION_MODIFICATION_RESPONSE:
             pfcpMessage->pFCPSessionModificationResponse.presence = 1;
-            _TlvParseMessage((unsigned long *)&pfcpMessage->pFCPSessionModificationResponse + 1, &ieDescriptionTable[PFCP_SESSION_MODIFICATION_RESPONSE + 155 - (50-15) - 1], body, bodyLen);
+            _TlvParseMessageMode((unsigned long *)&pfcpMessage->pFCPSessionModificationResponse + 1, &ieDescriptionTable[PFCP_SESSION_MODIFICATION_RESPONSE + 155 - (50-15) - 1], body, bodyLen, inPlace);
             break;
         case PFCP_SESSION_DELETION_REQUEST:
             pfcpMessage->pFCPSessionDeletionRequest.presence = 1;
-            _TlvParseMessage((unsigned long *)&pfcpMessage->pFCPSessionDeletionRequest + 1, &ieDescriptionTable[PFCP_SESSION_DELETION_REQUEST + 155 - (50-15) - 1], body, bodyLen);
+            _TlvParseMessageMode((unsigned long *)&pfcpMessage->pFCPSessionDeletionRequest + 1, &ieDescriptionTable[PFCP_SESSION_DELETION_REQUEST + 155 - (50-15) - 1], body, bodyLen, inPlace);
             break;
         case PFCP_SESSION_DELETION_RESPONSE:
             pfcpMessage->pFCPSessionDeletionResponse.presence = 1;
-            _TlvParseMessage((unsigned long *)&pfcpMessage->pFCPSessionDeletionResponse + 1, &ieDescriptionTable[PFCP_SESSION_DELETION_RESPONSE + 155 - (50-15) - 1], body, bodyLen);
+            _TlvParseMessageMode((unsigned long *)&pfcpMessage->pFCPSessionDeletionResponse + 1, &ieDescriptionTable[PFCP_SESSION_DELETION_RESPONSE + 155 - (50-15) - 1], body, bodyLen, inPlace);
             break;
         case PFCP_SESSION_REPORT_REQUEST:
             pfcpMessage->pFCPSessionReportRequest.presence = 1;
-            _TlvParseMessage((unsigned long *)&pfcpMessage->pFCPSessionReportRequest + 1, &ieDescriptionTable[PFCP_SESSION_REPORT_REQUEST + 155 - (50-15) - 1], body, bodyLen);
+            _TlvParseMessageMode((unsigned long *)&pfcpMessage->pFCPSessionReportRequest + 1, &ieDescriptionTable[PFCP_SESSION_REPORT_REQUEST + 155 - (50-15) - 1], body, bodyLen, inPlace);
             break;
         case PFCP_SESSION_REPORT_RESPONSE:
             pfcpMessage->pFCPSessionReportResponse.presence = 1;
-            _TlvParseMessage((unsigned long *)&pfcpMessage->pFCPSessionReportResponse + 1, &ieDescriptionTable[PFCP_SESSION_REPORT_RESPONSE + 155 - (50-15) - 1], body, bodyLen);
+            _TlvParseMessageMode((unsigned long *)&pfcpMessage->pFCPSessionReportResponse + 1, &ieDescriptionTable[PFCP_SESSION_REPORT_RESPONSE + 155 - (50-15) - 1], body, bodyLen, inPlace);
             break;
         default:
             UTLT_Warning("Not implmented(type:%d)", &pfcpMessage->header.type);
@@ -375,86 +427,86 @@ Status PfcpParseMessage(PfcpMessage *pfcpMessage, Bufblk *bufBlk) {
     return status;
 }
 
-int _TlvBuildMessage(Bufblk **bufBlkPtr, void *msg, IeDescription *ieDescription) {
-    //UTLT_Warning("Addr : %p", msg);
-    UTLT_Assert(bufBlkPtr, return 0, "buffer error");
-    UTLT_Assert(msg, return 0, "message error");
+Status PfcpParseMessage(PfcpMessage *pfcpMessage, Bufblk *bufBlk) {
+    return _PfcpParseMessage(pfcpMessage, bufBlk, 0);
+}
+
+Status PfcpParseMessageInPlace(PfcpMessage *pfcpMessage, Bufblk *bufBlk) {
+    return _PfcpParseMessage(pfcpMessage, bufBlk, 1);
+}
+
+// Length of the IE with its type and length, 0 if it is not present
+static int _TlvBuildLen(void *msg, IeDescription *ieDescription) {
+    if (*(unsigned long *)msg == 0) {
+        // present bit
+        return 0;
+    }
+
+    if (ieDescription->isTlvObj)
+        return TLV_HEADER_LEN + ((TlvOctet *)msg)->len;
+
+    int len = TLV_HEADER_LEN;
+    void *root = msg + sizeof(unsigned long);
+    for (int idx = 0; idx < ieDescription->numToParse; ++idx) {
+        len += _TlvBuildLen(root, &ieDescriptionTable[ieDescription->next[idx]]);
+        root += ieDescriptionTable[ieDescription->next[idx]].msgLen;
+    }
+
+    return len;
+}
+
+// Serialize the IE at buff, which has room for _TlvBuildLen() bytes, and return the bytes written
+static int _TlvBuildMessage(uint8_t *buff, void *msg, IeDescription *ieDescription) {
     if (*(unsigned long *)msg == 0) {
         // present bit
-        //UTLT_Warning("no ie");
         return 0;
     }
 
+    uint16_t type = htons(ieDescription->msgType);
+    uint16_t len = 0;
+    memcpy(buff, &type, sizeof(uint16_t));
+
     if (ieDescription->isTlvObj) {
       if (dbf) { UTLT_Info("TLV: type: %d, %d, len: %d, presence: %d",
                            ieDescription->msgType, ((TlvOctet*)msg)->type, ((TlvOctet *)msg)->len, ((unsigned long*)msg)[0]); }
-        //UTLT_Info("msgType: %d, msgLen: %d", ieDescription->msgType, ((TlvOctet *)msg)->len);
-        int buffLen = sizeof(uint16_t) * 2 + ((TlvOctet *)msg)->len;
-        *bufBlkPtr = BufblkAlloc(1, buffLen);
-        uint16_t *tagPtr = (uint16_t *) ((*bufBlkPtr)->buf);
-        uint16_t *lenPtr = &tagPtr[1];
-
-        (*bufBlkPtr)->len = buffLen;
-        *tagPtr = htons(ieDescription->msgType);
-        *lenPtr = htons(buffLen - sizeof(uint16_t) * 2);
-        memcpy((void *) &tagPtr[2], ((TlvOctet *)msg)->value, ((TlvOctet *)msg)->len);
+        len = ((TlvOctet *)msg)->len;
+        memcpy(buff + TLV_HEADER_LEN, ((TlvOctet *)msg)->value, len);
     } else {
       if (dbf) { UTLT_Info("not TLV"); }
-        size_t idx;
-        int msgPivot = 0;
-        *bufBlkPtr = BufblkAlloc(1, sizeof(uint16_t) * 2);
-        uint16_t *tagPtr = (*bufBlkPtr)->buf;
-        uint16_t *lenPtr = &tagPtr[1];
-        (*bufBlkPtr)->len = sizeof(uint16_t) * 2;
-
-        *tagPtr = htons(ieDescription->msgType);
-        if (dbf) { UTLT_Warning("Check addr: tag: %p, buf: %p", tagPtr, (*bufBlkPtr)->buf); }
-        if (dbf) { UTLT_Info("msgType: %u, tagPtr value: %u, first type: %u", ieDescription->msgType, ((uint16_t*)tagPtr)[0],ntohs(((uint16_t*)(*bufBlkPtr)->buf)[0])); }
-        *lenPtr = htons(0);
-
-        int bufOffset = 0;
-        void *msgNoPresentPtr = &((unsigned long*)msg)[1];
-        for (idx = 0; idx < ieDescription->numToParse; ++idx) {
-            Bufblk *tmpBufBlkPtr = NULL;
-            bufOffset += _TlvBuildMessage(&tmpBufBlkPtr, &((uint8_t *)msgNoPresentPtr)[msgPivot], &ieDescriptionTable[ieDescription->next[idx]]);
-            if (tmpBufBlkPtr == NULL) {
-                msgPivot += ieDescriptionTable[ieDescription->next[idx]].msgLen;
-                //UTLT_Info("TL type[%d], pivot %d", ieDescriptionTable[ieDescription->next[idx]].msgType, msgPivot);
-                continue;
-            }
-            if (dbf) {
-                    UTLT_Warning("tmpBuf T: %u, L: %d", ntohs(((uint16_t *)tmpBufBlkPtr->buf)[0]), ntohs(((uint16_t *)tmpBufBlkPtr->buf)[1]));
-            }
-            BufblkBuf(*bufBlkPtr, tmpBufBlkPtr);
-            //UTLT_Warning("bufBlk len %d", (*bufBlkPtr)->buf);
-            BufblkFree(tmpBufBlkPtr);
-            msgPivot += ieDescriptionTable[ieDescription->next[idx]].msgLen;
-            if (dbf) { UTLT_Info("buff offset: %d, buff Len: %d", bufOffset, (*bufBlkPtr)->len); }
+        void *root = msg + sizeof(unsigned long);
+        for (int idx = 0; idx < ieDescription->numToParse; ++idx) {
+            len += _TlvBuildMessage(buff + TLV_HEADER_LEN + len, root, &ieDescriptionTable[ieDescription->next[idx]]);
+            root += ieDescriptionTable[ieDescription->next[idx]].msgLen;
         }
-
-        *(((uint16_t *) (*bufBlkPtr)->buf) + 1) = htons(bufOffset);
     }
 
-    //UTLT_Warning("buf len: %d, first type: %d", (*bufBlkPtr)->len, ((uint16_t*)(*bufBlkPtr)->buf)[0]);
-    return (*bufBlkPtr)->len;
+    // Length of grouped IE is known after its children are written
+    uint16_t netLen = htons(len);
+    memcpy(buff + sizeof(uint16_t), &netLen, sizeof(uint16_t));
+
+    return TLV_HEADER_LEN + len;
 }
 
+// Build the whole body into one buffer, the lengths are counted first so nothing is copied twice
 void _PfcpBuildBody(Bufblk **bufBlkPtr, void *msg, IeDescription *ieDescription) {
     UTLT_Assert(bufBlkPtr, return, "buffer error");
     UTLT_Assert(msg, return, "message error");
 
     int idx;
+    int bodyLen = 0;
     void *root = msg + sizeof(unsigned long);
-    (*bufBlkPtr) = BufblkAlloc(1, 0);
     for (idx = 0; idx < ieDescription->numToParse; ++idx) {
-        Bufblk *tmpBufBlkPtr;
-        int rt = _TlvBuildMessage(&tmpBufBlkPtr, root, &ieDescriptionTable[ieDescription->next[idx]]);
-        if (rt == 0) {
-            root += ieDescriptionTable[ieDescription->next[idx]].msgLen;
-            continue;
-        }
-        BufblkBuf(*bufBlkPtr, tmpBufBlkPtr);
-        BufblkFree(tmpBufBlkPtr);
+        bodyLen += _TlvBuildLen(root, &ieDescriptionTable[ieDescription->next[idx]]);
+        root += ieDescriptionTable[ieDescription->next[idx]].msgLen;
+    }
+
+    (*bufBlkPtr) = BufblkAlloc(1, bodyLen);
+    UTLT_Assert(*bufBlkPtr, return, "PFCP body buffer alloc fail");
+
+    root = msg + sizeof(unsigned long);
+    for (idx = 0; idx < ieDescription->numToParse; ++idx) {
+        (*bufBlkPtr)->len += _TlvBuildMessage((*bufBlkPtr)->buf + (*bufBlkPtr)->len, root,
+                                              &ieDescriptionTable[ieDescription->next[idx]]);
         root += ieDescriptionTable[ieDescription->next[idx]].msgLen;
     }
 }
@@ -568,6 +620,11 @@ Status PfcpStructFree(PfcpMessage *pfcpMessage) {
     Status status = STATUS_OK;
     UTLT_Assert(pfcpMessage, return STATUS_ERROR, "pfcpMessage error");
 
+    if (pfcpMessage->ieInPlace) {
+        // IE values belong to the parsed buffer
+        return STATUS_OK;
+    }
+
     switch(pfcpMessage->header.type) {
         case PFCP_HEARTBEAT_REQUEST:
             status = _PfcpFreeIe(&pfcpMessage->heartbeatRequest, &ieDescriptionTable[PFCP_HEARTBEAT_REQUEST + 155]);
@@ -11,7 +11,7 @@
 
 #define MAX_PFCP_NODE_POOL_SIZE 512
 
-PoolDeclare(pfcpNodePool, PfcpNode, MAX_PFCP_NODE_POOL_SIZE);
+PoolDeclare(pfcpNodePool, PfcpNode);
 
 Status PfcpNodeInit() {
     PoolInit(&pfcpNodePool, MAX_PFCP_NODE_POOL_SIZE);
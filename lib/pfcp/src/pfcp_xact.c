@@ -1,6 +1,7 @@
 #define TRACE_MODULE _pfcp_xact
 
 #include <endian.h>
+#include <pthread.h>
 
 #include "utlt_debug.h"
 #include "utlt_pool.h"
@@ -8,6 +9,7 @@
 #include "utlt_index.h"
 #include "utlt_timer.h"
 #include "utlt_event.h"
+#include "utlt_hash.h"
 
 #include "pfcp_types.h"
 #include "pfcp_message.h"
@@ -15,7 +17,6 @@
 
 #include "pfcp_xact.h"
 
-#define SIZE_OF_PFCP_XACT_POOL          64
 #define PFCP_MIN_XACT_ID                1
 #define PFCP_MAX_XACT_ID                0x800000
 
@@ -32,17 +33,88 @@ static uintptr_t globalResponseEvent = 0;
 static uintptr_t globalHoldingEvent = 0;
 static uint32_t globalXactId = 0;
 
-IndexDeclare(pfcpXactPool, PfcpXact, SIZE_OF_PFCP_XACT_POOL);
+/*
+ * Xacts of a node may be handled by different threads (N4 workers), but each
+ * xact is only touched by the thread its messages are sent to, and deleted by
+ * it too, since xactTable keeps a pointer to its key. The lock only guards the
+ * localList and remoteList of nodes.
+ */
+static pthread_mutex_t xactListLock = PTHREAD_MUTEX_INITIALIZER;
+static __thread Hash *xactTable = NULL;
+static __thread EvtQId xactEventQ = 0;
 
-Status PfcpXactInit(TimerList *timerList, uintptr_t responseEvent, uintptr_t holdingEvent) {
+IndexDeclare(pfcpXactPool, PfcpXact);
+
+Status PfcpXactThreadInit(EvtQId eventQ) {
+    UTLT_Assert(!xactTable, return STATUS_ERROR, "PFCP Xact of this thread have alread initialized");
+
+    xactTable = HashMake();
+    UTLT_Assert(xactTable, return STATUS_ERROR, "PFCP Xact table create failed");
+    xactEventQ = eventQ;
+
+    return STATUS_OK;
+}
+
+void PfcpXactThreadTerm() {
+    if (xactTable) {
+        // Removing the current entry keeps the iterator valid
+        for (HashIndex *hi = HashFirst(xactTable); hi; hi = HashNext(hi)) {
+            PfcpXactDelete(HashThisVal(hi));
+        }
+        HashDestroy(xactTable);
+    }
+    xactTable = NULL;
+    xactEventQ = 0;
+}
+
+static void PfcpXactTimerExpire(uintptr_t data, uintptr_t param[]) {
+    // Fall back to the queue of the timer checker if the creator has no queue
+    EvtQId eventQ = param[PARAM3] ? param[PARAM3] : data;
+
+    Status status = EventSend(eventQ, param[PARAM1], 1, param[PARAM2]);
+    UTLT_Assert(status == STATUS_OK, , "PFCP xact timer event send error: %d", status);
+}
+
+static TimerBlkID PfcpXactTimerCreate(PfcpXact *xact, uint32_t duration, uintptr_t event) {
+    TimerBlkID id = TimerCreate(globalTimerList, TIMER_TYPE_ONCE, duration, PfcpXactTimerExpire);
+    UTLT_Assert(id, return id, "Timer allocation failed");
+
+    TimerSet(PARAM1, id, event);
+    TimerSet(PARAM2, id, xact->index);
+    TimerSet(PARAM3, id, xactEventQ);
+
+    return id;
+}
+
+static void PfcpXactListInsert(PfcpXact *xact) {
+    xact->key.gnode = xact->gnode;
+    xact->key.transactionId = xact->transactionId;
+    xact->key.origin = xact->origin;
+    xact->ownerTable = xactTable;
+    HashSet(xactTable, &xact->key, sizeof(xact->key), xact);
+
+    pthread_mutex_lock(&xactListLock);
+    if (xact->origin == PFCP_LOCAL_ORIGINATOR) {
+        ListInsert(xact, &xact->gnode->localList);
+    } else {
+        ListInsert(xact, &xact->gnode->remoteList);
+    }
+    pthread_mutex_unlock(&xactListLock);
+}
+
+Status PfcpXactInit(TimerList *timerList, uintptr_t responseEvent, uintptr_t holdingEvent,
+                    uint32_t capacity) {
     UTLT_Assert(pfcpXactInitialized == 0, return STATUS_ERROR, "PFCP Xact have alread initialized");
-    IndexInit(&pfcpXactPool, SIZE_OF_PFCP_XACT_POOL);
+    UTLT_Assert(IndexInit(&pfcpXactPool, (capacity ? capacity : SIZE_OF_PFCP_XACT_POOL)) == STATUS_OK,
+        return STATUS_ERROR, "pfcpXactPool init failed");
 
     globalXactId = 0;
     globalTimerList = timerList;
     globalResponseEvent = responseEvent;
     globalHoldingEvent = holdingEvent;
 
+    UTLT_Assert(PfcpXactThreadInit(0) == STATUS_OK, return STATUS_ERROR, "");
+
     pfcpXactInitialized = 1;
 
     return STATUS_OK;
@@ -59,6 +131,7 @@ Status PfcpXactTerminate() {
     UTLT_Trace("%d freed in pfcpXactPool[%d] of PFCP Transaction",
                PoolUsedCheck(&pfcpXactPool), PoolSize(&pfcpXactPool));
 
+    PfcpXactThreadTerm();
     IndexTerminate(&pfcpXactPool);
     pfcpXactInitialized = 0;
 
@@ -70,6 +143,7 @@ PfcpXact *PfcpXactLocalCreate(PfcpNode *gnode, PfcpHeader *header, Bufblk *bufBl
     PfcpXact *xact = NULL;
 
     UTLT_Assert(gnode, return NULL, "node error");
+    UTLT_Assert(xactTable, return NULL, "PFCP Xact of this thread is not initialized");
 
     IndexAlloc(&pfcpXactPool, xact);
     // TODO: drop transaction allocation failed
@@ -79,7 +153,8 @@ PfcpXact *PfcpXactLocalCreate(PfcpNode *gnode, PfcpHeader *header, Bufblk *bufBl
     UTLT_Assert(xact, return NULL, "Transaction allocation failed");
 
     xact->origin = PFCP_LOCAL_ORIGINATOR;
-    xact->transactionId = (globalXactId == PFCP_MAX_XACT_ID ? PFCP_MIN_XACT_ID : ++globalXactId);
+    xact->transactionId = (__atomic_fetch_add(&globalXactId, 1, __ATOMIC_RELAXED)
+                            % (PFCP_MAX_XACT_ID - PFCP_MIN_XACT_ID)) + PFCP_MIN_XACT_ID;
 
     xact->gnode = gnode;
     /*TODO: fix this
@@ -97,13 +172,7 @@ PfcpXact *PfcpXactLocalCreate(PfcpNode *gnode, PfcpHeader *header, Bufblk *bufBl
     }
     */
 
-    if (xact->origin == PFCP_LOCAL_ORIGINATOR) {
-        ListHeadInit(&xact->gnode->localList);
-        ListInsert(xact, &xact->gnode->localList);
-    } else {
-        ListHeadInit(&xact->gnode->remoteList);
-        ListInsert(xact, &xact->gnode->remoteList);
-    }
+    PfcpXactListInsert(xact);
 
     status = PfcpXactUpdateTx(xact, header, bufBlk);
     UTLT_Assert(status == STATUS_OK, goto err, "Update Tx failed");
@@ -115,7 +184,7 @@ PfcpXact *PfcpXactLocalCreate(PfcpNode *gnode, PfcpHeader *header, Bufblk *bufBl
     return xact;
 
 err:
-    IndexFree(&pfcpXactPool, xact);
+    PfcpXactDelete(xact);
     return NULL;
 }
 
@@ -123,6 +192,7 @@ PfcpXact *PfcpXactRemoteCreate(PfcpNode *gnode, uint32_t sqn) {
     PfcpXact *xact = NULL;
 
     UTLT_Assert(gnode, return NULL, "node error");
+    UTLT_Assert(xactTable, return NULL, "PFCP Xact of this thread is not initialized");
 
     IndexAlloc(&pfcpXactPool, xact);
     // TODO: drop transaction allocation failed
@@ -133,31 +203,20 @@ PfcpXact *PfcpXactRemoteCreate(PfcpNode *gnode, uint32_t sqn) {
     xact->gnode = gnode;
 
     if (globalResponseEvent) {
-        xact->timerResponse = EventTimerCreate(
-                                globalTimerList, TIMER_TYPE_ONCE,
-                                PFCP_T3_RESPONSE_DURATION,
-                                globalResponseEvent);
+        xact->timerResponse = PfcpXactTimerCreate(xact, PFCP_T3_RESPONSE_DURATION,
+                                                  globalResponseEvent);
         UTLT_Assert(xact->timerResponse, goto err, "Timer allocation failed");
-        TimerSet(PARAM2, xact->timerResponse, xact->index);
         xact->responseReCount = PFCP_T3_RESPONSE_RETRY_COUNT;
     }
 
     if (globalHoldingEvent) {
-        xact->timerHolding = EventTimerCreate(globalTimerList,
-                               TIMER_TYPE_ONCE, PFCP_T3_RESPONSE_DURATION,
-                               globalHoldingEvent);
+        xact->timerHolding = PfcpXactTimerCreate(xact, PFCP_T3_RESPONSE_DURATION,
+                                                 globalHoldingEvent);
         UTLT_Assert(xact->timerHolding, goto err, "Timer allocation failed");
-        TimerSet(PARAM2, xact->timerHolding, xact->index);
         xact->holdingReCount = PFCP_T3_DUPLICATED_RETRY_COUNT;
     }
 
-    if (xact->origin == PFCP_LOCAL_ORIGINATOR) {
-        ListHeadInit(&xact->gnode->localList);
-        ListInsert(xact, &xact->gnode->localList);
-    } else {
-        ListHeadInit(&xact->gnode->remoteList);
-        ListInsert(xact, &xact->gnode->remoteList);
-    }
+    PfcpXactListInsert(xact);
 
     UTLT_Trace("[%d] %s Create  peer [%s]:%d\n", xact->transactionId,
                xact->origin == PFCP_LOCAL_ORIGINATOR ? "local " : "remote",
@@ -166,6 +225,10 @@ PfcpXact *PfcpXactRemoteCreate(PfcpNode *gnode, uint32_t sqn) {
     return xact;
 
 err:
+    // Not in the list of node yet
+    if (xact->timerResponse) {
+        TimerDelete(xact->timerResponse);
+    }
     IndexFree(&pfcpXactPool, xact);
     return NULL;
 }
@@ -185,17 +248,22 @@ void PfcpXactDeassociate(PfcpXact *xact1, PfcpXact *xact2) {
 
 Status PfcpXactDelete(PfcpXact *xact) {
 
-    UTLT_Assert(xact, , "xact error");
-    UTLT_Assert(xact->gnode, , "node of xact error");
+    UTLT_Assert(xact, return STATUS_ERROR, "xact error");
+    UTLT_Assert(xact->gnode, return STATUS_ERROR, "node of xact error");
+    // Freeing it here would leave its key in the table of the owner
+    UTLT_Assert(!xact->ownerTable || xact->ownerTable == xactTable, return STATUS_ERROR,
+                "[%d] xact can only be deleted by the thread handling it", xact->transactionId);
 
     UTLT_Trace("[%d] %s Delete  peer [%s]:%d\n", xact->transactionId,
             xact->origin == PFCP_LOCAL_ORIGINATOR ? "local" : "remote",
             GetIP(&xact->gnode->sock->remoteAddr), GetPort(&xact->gnode->sock->remoteAddr));
-    if (xact->origin == PFCP_LOCAL_ORIGINATOR) {
-        ListRemove(xact);
-    } else if (xact->origin == PFCP_REMOTE_ORIGINATOR) {
-        ListRemove(xact);
+    if (xact->ownerTable && HashGet(xactTable, &xact->key, sizeof(xact->key)) == xact) {
+        HashSet(xactTable, &xact->key, sizeof(xact->key), NULL);
     }
+    xact->ownerTable = NULL;
+    pthread_mutex_lock(&xactListLock);
+    ListRemove(xact);
+    pthread_mutex_unlock(&xactListLock);
 
     xact->origin = 0;
     xact->transactionId = 0;
@@ -229,15 +297,24 @@ Status PfcpXactDelete(PfcpXact *xact) {
     return STATUS_OK;
 }
 
+static PfcpXact *PfcpXactListFirst(ListHead *list) {
+    pthread_mutex_lock(&xactListLock);
+    PfcpXact *xact = ListFirst(list);
+    pthread_mutex_unlock(&xactListLock);
+
+    return (xact == (PfcpXact *) list ? NULL : xact);
+}
+
 void PfcpXactDeleteAll(PfcpNode *gnode) {
-    PfcpXact *xact, *nextNode = NULL;
-    
-    ListForEachSafe(xact, nextNode, &gnode->localList) {
-        PfcpXactDelete(xact);
+    PfcpXact *xact = NULL;
+
+    // Stop at the xact of another thread, which is still running
+    while ((xact = PfcpXactListFirst(&gnode->localList))) {
+        UTLT_Assert(PfcpXactDelete(xact) == STATUS_OK, return, "Xacts of node are not deleted");
     }
 
-    ListForEachSafe(xact, nextNode, &gnode->remoteList) {
-        PfcpXactDelete(xact);
+    while ((xact = PfcpXactListFirst(&gnode->remoteList))) {
+        UTLT_Assert(PfcpXactDelete(xact) == STATUS_OK, return, "Xacts of node are not deleted");
     }
 
     return;
@@ -346,7 +423,7 @@ Status PfcpXactUpdateTx(PfcpXact *xact, PfcpHeader *header, Bufblk *bufBlk) {
         headerLen = PFCP_HEADER_LEN - PFCP_SEID_LEN;
     }
 
-    fullPacket = BufblkAlloc(1, headerLen);
+    fullPacket = BufblkAlloc(1, headerLen + bufBlk->len);
     localHeader = fullPacket->buf;
     fullPacket->len = headerLen;
 
@@ -633,7 +710,12 @@ Status PfcpXactTimeout(uint32_t index, uint32_t event, uint8_t *type) {
     PfcpXact *xact = NULL;
     
     xact = IndexFind(&pfcpXactPool, index);
-    UTLT_Assert(xact, goto out, "index find from pool error");
+    UTLT_Assert(xact, return STATUS_ERROR, "index find from pool error");
+    // The event was sent before the xact was deleted, its index may even be taken by another thread
+    if (!xact->ownerTable || xact->ownerTable != xactTable) {
+        UTLT_Trace("[Timer Debug] PfcpXactTimeout of deleted xact index %d", index);
+        return STATUS_ERROR;
+    }
     UTLT_Assert(xact->gnode, goto out, "node of xact error");
 
     UTLT_Assert(type, goto out, "type error");
@@ -698,9 +780,12 @@ Status PfcpXactReceive(PfcpNode *gnode, PfcpHeader *header, PfcpXact **xact) {
     UTLT_Assert(gnode, return STATUS_ERROR, "node error");
     UTLT_Assert(header, return STATUS_ERROR, "header error");
 
+    _Bool created = 0;
+
     newXact = PfcpXactFindByTransactionId(gnode, header->type, PfcpSqn2TransactionId(header->sqn));
     if (!newXact) {
         newXact = PfcpXactRemoteCreate(gnode, header->sqn);
+        created = 1;
     }
     UTLT_Assert(newXact, return STATUS_ERROR, "new Xact error");
 
@@ -710,7 +795,10 @@ Status PfcpXactReceive(PfcpNode *gnode, PfcpHeader *header, PfcpXact **xact) {
 
     status = PfcpXactUpdateRx(newXact, header->type);
     if (status != STATUS_OK) {
-        IndexFree(&pfcpXactPool, newXact);
+        // A duplicated request keeps its xact to answer retransmissions
+        if (created) {
+            PfcpXactDelete(newXact);
+        }
         return status;
     }
 
@@ -725,43 +813,34 @@ PfcpXact *PfcpXactFind(uint32_t index) {
 
 PfcpXact *PfcpXactFindByTransactionId(PfcpNode *gnode, uint8_t type, uint32_t transactionId) {
     PfcpXact *xact = NULL;
-    PfcpXact *nextNode = NULL;
-    ListHead *list = NULL; 
     UTLT_Assert(gnode, return NULL, "node error");
+    UTLT_Assert(xactTable, return NULL, "PFCP Xact of this thread is not initialized");
+
+    PfcpXactKey key = {
+        .gnode = gnode,
+        .transactionId = transactionId,
+    };
 
     switch (PfcpXactGetStage(type, transactionId)) {
         case PFCP_XACT_INITIAL_STAGE:
-            list = &gnode->remoteList;
-            xact = ListFirst(&gnode->remoteList);
+            key.origin = PFCP_REMOTE_ORIGINATOR;
             break;
         case PFCP_XACT_INTERMEDIATE_STAGE:
-            list = &gnode->localList;
-            xact = ListFirst(&gnode->localList);
+            key.origin = PFCP_LOCAL_ORIGINATOR;
             break;
         case PFCP_XACT_FINAL_STAGE:
             if (transactionId & PFCP_MAX_XACT_ID) {
-                list = &gnode->remoteList;
-                xact = ListFirst(&gnode->remoteList);
+                key.origin = PFCP_REMOTE_ORIGINATOR;
             }  else {
-                list = &gnode->localList;
-                xact = ListFirst(&gnode->localList);
+                key.origin = PFCP_LOCAL_ORIGINATOR;
             }
-
-                
             break;
 
         default:
             UTLT_Assert(0, return NULL, "Unknown stage");
     }
-    
-    ListForEachSafe(xact, nextNode, list) {
-        if (xact->transactionId == transactionId)
-            break;
-    }
 
-    if (xact == (PfcpXact *) list) {
-        return NULL;
-    }
+    xact = HashGet(xactTable, &key, sizeof(key));
 
     if (xact) {
         UTLT_Trace("[%d] %s Find peer [%s]:%d\n",
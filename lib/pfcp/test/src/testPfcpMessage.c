@@ -0,0 +1,308 @@
+#include <string.h>
+#include <endian.h>
+#include <netinet/in.h>
+
+#include "utlt_debug.h"
+#include "utlt_buff.h"
+#include "utlt_time.h"
+#include "pfcp_message.h"
+
+#define TEST_PFCP_NUM_OF_RULE   4
+#define TEST_PFCP_NUM_OF_PARSE  100000
+#define TEST_PFCP_NUM_OF_BUILD  100000
+
+#define TestPfcpSetIe(__ie, __value) do { \
+    (__ie).presence = 1; \
+    (__ie).len = sizeof(__value); \
+    (__ie).value = &(__value); \
+} while (0)
+
+static uint8_t nodeId[5] = {0, 10, 0, 0, 1};
+static uint8_t fSeid[13] = {0x02, 0, 0, 0, 0, 0, 0, 0, 0x87, 10, 0, 0, 1};
+static uint16_t ruleId[TEST_PFCP_NUM_OF_RULE];
+static uint32_t precedence = 0xff000000;
+static uint8_t sourceInterface = 1;
+static uint8_t fTeid[9] = {0x01, 0, 0, 0, 1, 10, 0, 0, 2};
+static uint8_t ueIp[5] = {0x02, 60, 60, 0, 1};
+static char sdfFilter[] = "\x01\x00\x00\x24permit out ip from any to 60.60.0.1";
+static uint8_t applyAction = 0x02;
+static uint8_t gateStatus = 0;
+
+static void TestPfcpSetEstablishmentRequest(PfcpMessage *pfcpMessage) {
+    PFCPSessionEstablishmentRequest *request = &pfcpMessage->pFCPSessionEstablishmentRequest;
+
+    memset(pfcpMessage, 0, sizeof(PfcpMessage));
+    pfcpMessage->header.type = PFCP_SESSION_ESTABLISHMENT_REQUEST;
+
+    request->presence = 1;
+    TestPfcpSetIe(request->nodeID, nodeId);
+    TestPfcpSetIe(request->cPFSEID, fSeid);
+    for (int i = 0; i < TEST_PFCP_NUM_OF_RULE; i++) {
+        ruleId[i] = htons(i + 1);
+
+        CreatePDR *pdr = &request->createPDR[i];
+        pdr->presence = 1;
+        TestPfcpSetIe(pdr->pDRID, ruleId[i]);
+        TestPfcpSetIe(pdr->precedence, precedence);
+        pdr->pDI.presence = 1;
+        TestPfcpSetIe(pdr->pDI.sourceInterface, sourceInterface);
+        TestPfcpSetIe(pdr->pDI.localFTEID, fTeid);
+        TestPfcpSetIe(pdr->pDI.uEIPAddress, ueIp);
+        TestPfcpSetIe(pdr->pDI.sDFFilter, sdfFilter);
+        TestPfcpSetIe(pdr->fARID, ruleId[i]);
+        TestPfcpSetIe(pdr->qERID[0], ruleId[i]);
+
+        CreateFAR *far = &request->createFAR[i];
+        far->presence = 1;
+        TestPfcpSetIe(far->fARID, ruleId[i]);
+        TestPfcpSetIe(far->applyAction, applyAction);
+
+        CreateQER *qer = &request->createQER[i];
+        qer->presence = 1;
+        TestPfcpSetIe(qer->qERID, ruleId[i]);
+        TestPfcpSetIe(qer->gateStatus, gateStatus);
+    }
+}
+
+// Session Establishment Request as the SMF sends, with a header in front of the body
+static Bufblk *TestPfcpBuildEstablishmentRequest() {
+    PfcpMessage pfcpMessage;
+    Bufblk *body = NULL;
+
+    TestPfcpSetEstablishmentRequest(&pfcpMessage);
+    UTLT_Assert(PfcpBuildMessage(&body, &pfcpMessage) == STATUS_OK, return NULL, "PfcpBuildMessage fail");
+
+    Bufblk *bufBlk = BufblkAlloc(1, PFCP_HEADER_LEN + body->len);
+    PfcpHeader header = {
+        .version = 1,
+        .seidP = 1,
+        .type = PFCP_SESSION_ESTABLISHMENT_REQUEST,
+        .length = htons(PFCP_HEADER_LEN - 4 + body->len),
+        .seid = htobe64(0),
+        .sqn = PfcpTransactionId2Sqn(1),
+    };
+    BufblkBytes(bufBlk, (const char *) &header, PFCP_HEADER_LEN);
+    BufblkBuf(bufBlk, body);
+    BufblkFree(body);
+
+    return bufBlk;
+}
+
+static Status TestPfcpIeCheck(TlvOctet *ie, const void *value, int len, const char *name) {
+    UTLT_Assert(ie->presence && ie->len == len && memcmp(ie->value, value, len) == 0,
+        return STATUS_ERROR, "%s is not correct: presence %lu, len %u", name, ie->presence, ie->len);
+
+    return STATUS_OK;
+}
+
+static Status TestPfcpEstablishmentRequestCheck(PfcpMessage *pfcpMessage) {
+    PFCPSessionEstablishmentRequest *request = &pfcpMessage->pFCPSessionEstablishmentRequest;
+
+    UTLT_Assert(pfcpMessage->header.type == PFCP_SESSION_ESTABLISHMENT_REQUEST, return STATUS_ERROR, "");
+    UTLT_Assert(TestPfcpIeCheck(&request->nodeID, nodeId, sizeof(nodeId), "Node ID") == STATUS_OK,
+        return STATUS_ERROR, "");
+    UTLT_Assert(TestPfcpIeCheck(&request->cPFSEID, fSeid, sizeof(fSeid), "CP F-SEID") == STATUS_OK,
+        return STATUS_ERROR, "");
+
+    for (int i = 0; i < TEST_PFCP_NUM_OF_RULE; i++) {
+        CreatePDR *pdr = &request->createPDR[i];
+        UTLT_Assert(pdr->presence && pdr->pDI.presence, return STATUS_ERROR, "Create PDR[%d] is not present", i);
+        UTLT_Assert(TestPfcpIeCheck(&pdr->pDRID, &ruleId[i], sizeof(uint16_t), "PDR ID") == STATUS_OK,
+            return STATUS_ERROR, "");
+        UTLT_Assert(TestPfcpIeCheck(&pdr->pDI.localFTEID, fTeid, sizeof(fTeid), "F-TEID") == STATUS_OK,
+            return STATUS_ERROR, "");
+        UTLT_Assert(TestPfcpIeCheck(&pdr->pDI.sDFFilter, sdfFilter, sizeof(sdfFilter), "SDF Filter") == STATUS_OK,
+            return STATUS_ERROR, "");
+        UTLT_Assert(TestPfcpIeCheck(&pdr->qERID[0], &ruleId[i], sizeof(uint16_t), "QER ID") == STATUS_OK,
+            return STATUS_ERROR, "");
+
+        CreateFAR *far = &request->createFAR[i];
+        UTLT_Assert(TestPfcpIeCheck(&far->applyAction, &applyAction, sizeof(applyAction), "Apply Action") == STATUS_OK,
+            return STATUS_ERROR, "");
+
+        CreateQER *qer = &request->createQER[i];
+        UTLT_Assert(TestPfcpIeCheck(&qer->qERID, &ruleId[i], sizeof(uint16_t), "QER ID") == STATUS_OK,
+            return STATUS_ERROR, "");
+    }
+
+    return STATUS_OK;
+}
+
+// Both parse modes give the same message, in place mode points into the buffer
+Status TestPfcpMessage_1() {
+    PfcpMessage pfcpMessage;
+    Bufblk *bufBlk = TestPfcpBuildEstablishmentRequest();
+    UTLT_Assert(bufBlk, return STATUS_ERROR, "");
+
+    UTLT_Assert(PfcpParseMessage(&pfcpMessage, bufBlk) == STATUS_OK, return STATUS_ERROR, "");
+    UTLT_Assert(TestPfcpEstablishmentRequestCheck(&pfcpMessage) == STATUS_OK, return STATUS_ERROR,
+        "PfcpParseMessage result is not correct");
+    UTLT_Assert(PfcpStructFree(&pfcpMessage) == STATUS_OK, return STATUS_ERROR, "");
+
+    UTLT_Assert(PfcpParseMessageInPlace(&pfcpMessage, bufBlk) == STATUS_OK, return STATUS_ERROR, "");
+    UTLT_Assert(TestPfcpEstablishmentRequestCheck(&pfcpMessage) == STATUS_OK, return STATUS_ERROR,
+        "PfcpParseMessageInPlace result is not correct");
+    void *value = pfcpMessage.pFCPSessionEstablishmentRequest.nodeID.value;
+    UTLT_Assert(value > bufBlk->buf && value < bufBlk->buf + bufBlk->len, return STATUS_ERROR,
+        "IE value does not point into the buffer");
+    UTLT_Assert(PfcpStructFree(&pfcpMessage) == STATUS_OK, return STATUS_ERROR, "");
+
+    // IE over the end of a truncated message is not present
+    bufBlk->len -= 4;
+    UTLT_Assert(PfcpParseMessageInPlace(&pfcpMessage, bufBlk) == STATUS_OK, return STATUS_ERROR, "");
+    CreateQER *qer = &pfcpMessage.pFCPSessionEstablishmentRequest.createQER[TEST_PFCP_NUM_OF_RULE - 1];
+    UTLT_Assert(!qer->presence || !qer->gateStatus.presence, return STATUS_ERROR,
+        "Truncated IE should not be present");
+
+    BufblkFree(bufBlk);
+
+    return STATUS_OK;
+}
+
+// Parse throughput of Session Establishment Request with copy and in place
+Status TestPfcpMessage_2() {
+    PfcpMessage pfcpMessage;
+    Bufblk *bufBlk = TestPfcpBuildEstablishmentRequest();
+    UTLT_Assert(bufBlk, return STATUS_ERROR, "");
+
+    utime_t start = TimeNow();
+    for (int i = 0; i < TEST_PFCP_NUM_OF_PARSE; i++) {
+        PfcpParseMessage(&pfcpMessage, bufBlk);
+        PfcpStructFree(&pfcpMessage);
+    }
+    utime_t copyTime = TimeNow() - start + 1;
+
+    start = TimeNow();
+    for (int i = 0; i < TEST_PFCP_NUM_OF_PARSE; i++) {
+        PfcpParseMessageInPlace(&pfcpMessage, bufBlk);
+        PfcpStructFree(&pfcpMessage);
+    }
+    utime_t inPlaceTime = TimeNow() - start + 1;
+
+    UTLT_Info("[PFCP benchmark] Session Establishment Request (%d bytes, %d PDR/FAR/QER): "
+              "copy %lu msg/s, in place %lu msg/s",
+              bufBlk->len, TEST_PFCP_NUM_OF_RULE,
+              (uint64_t) TEST_PFCP_NUM_OF_PARSE * USEC_PER_SEC / copyTime,
+              (uint64_t) TEST_PFCP_NUM_OF_PARSE * USEC_PER_SEC / inPlaceTime);
+
+    BufblkFree(bufBlk);
+
+    return STATUS_OK;
+}
+
+// Build of a parsed message gives the same body, and the build throughput
+Status TestPfcpMessage_3() {
+    PfcpMessage pfcpMessage;
+    Bufblk *body = NULL;
+    Bufblk *bufBlk = TestPfcpBuildEstablishmentRequest();
+    UTLT_Assert(bufBlk, return STATUS_ERROR, "");
+
+    UTLT_Assert(PfcpParseMessageInPlace(&pfcpMessage, bufBlk) == STATUS_OK, return STATUS_ERROR, "");
+    UTLT_Assert(PfcpBuildMessage(&body, &pfcpMessage) == STATUS_OK, return STATUS_ERROR, "");
+    UTLT_Assert(body->len == bufBlk->len - PFCP_HEADER_LEN &&
+        memcmp(body->buf, bufBlk->buf + PFCP_HEADER_LEN, body->len) == 0, return STATUS_ERROR,
+        "Rebuilt body is not the same: len %d, need %d", body->len, bufBlk->len - PFCP_HEADER_LEN);
+    BufblkFree(body);
+
+    TestPfcpSetEstablishmentRequest(&pfcpMessage);
+    utime_t start = TimeNow();
+    for (int i = 0; i < TEST_PFCP_NUM_OF_BUILD; i++) {
+        PfcpBuildMessage(&body, &pfcpMessage);
+        BufblkFree(body);
+    }
+    utime_t buildTime = TimeNow() - start + 1;
+
+    UTLT_Info("[PFCP benchmark] Session Establishment Request (%d bytes, %d PDR/FAR/QER): build %lu msg/s",
+              bufBlk->len, TEST_PFCP_NUM_OF_RULE,
+              (uint64_t) TEST_PFCP_NUM_OF_BUILD * USEC_PER_SEC / buildTime);
+
+    BufblkFree(bufBlk);
+
+    return STATUS_OK;
+}
+
+// Reverse the order of IE types, IEs of the same type keep their order, grouped IEs as well
+static int TestPfcpReorderIe(uint8_t *dst, const uint8_t *src, int len) {
+    uint16_t type[64], ieType, ieLen;
+    int numOfType = 0, dstLen = 0;
+
+    for (int offset = 0; offset < len; offset += 4 + ieLen) {
+        memcpy(&ieType, src + offset, sizeof(uint16_t));
+        memcpy(&ieLen, src + offset + 2, sizeof(uint16_t));
+        ieLen = ntohs(ieLen);
+
+        int i = 0;
+        while (i < numOfType && type[i] != ieType)
+            i++;
+        if (i == numOfType)
+            type[numOfType++] = ieType;
+    }
+
+    for (int i = numOfType - 1; i >= 0; i--) {
+        for (int offset = 0; offset < len; offset += 4 + ieLen) {
+            memcpy(&ieType, src + offset, sizeof(uint16_t));
+            memcpy(&ieLen, src + offset + 2, sizeof(uint16_t));
+            ieLen = ntohs(ieLen);
+            if (ieType != type[i])
+                continue;
+
+            memcpy(dst + dstLen, src + offset, 4);
+            switch (ntohs(ieType)) {
+                case PFCP_CreatePDR_TYPE:
+                case PFCP_PDI_TYPE:
+                case PFCP_CreateFAR_TYPE:
+                case PFCP_CreateQER_TYPE:
+                    TestPfcpReorderIe(dst + dstLen + 4, src + offset + 4, ieLen);
+                    break;
+                default:
+                    memcpy(dst + dstLen + 4, src + offset + 4, ieLen);
+            }
+            dstLen += 4 + ieLen;
+        }
+    }
+
+    return dstLen;
+}
+
+// IEs in any order are decoded, repeated IEs fill the array in arrival order
+Status TestPfcpMessage_4() {
+    PfcpMessage pfcpMessage;
+    Bufblk *bufBlk = TestPfcpBuildEstablishmentRequest();
+    UTLT_Assert(bufBlk, return STATUS_ERROR, "");
+
+    Bufblk *reordered = BufblkAlloc(1, bufBlk->len);
+    memcpy(reordered->buf, bufBlk->buf, PFCP_HEADER_LEN);
+    reordered->len = PFCP_HEADER_LEN + TestPfcpReorderIe(reordered->buf + PFCP_HEADER_LEN,
+        bufBlk->buf + PFCP_HEADER_LEN, bufBlk->len - PFCP_HEADER_LEN);
+    UTLT_Assert(reordered->len == bufBlk->len && memcmp(reordered->buf, bufBlk->buf, bufBlk->len),
+        return STATUS_ERROR, "Message is not reordered");
+
+    UTLT_Assert(PfcpParseMessageInPlace(&pfcpMessage, reordered) == STATUS_OK, return STATUS_ERROR, "");
+    UTLT_Assert(TestPfcpEstablishmentRequestCheck(&pfcpMessage) == STATUS_OK, return STATUS_ERROR,
+        "Reordered message is not decoded correctly");
+
+    // Unknown IE is skipped
+    uint8_t unknownIe[] = {0x00, 0xfe, 0x00, 0x02, 0xde, 0xad};
+    BufblkBytes(reordered, (const char *) unknownIe, sizeof(unknownIe));
+    UTLT_Assert(PfcpParseMessageInPlace(&pfcpMessage, reordered) == STATUS_OK, return STATUS_ERROR, "");
+    UTLT_Assert(TestPfcpEstablishmentRequestCheck(&pfcpMessage) == STATUS_OK, return STATUS_ERROR,
+        "Unknown IE is not skipped");
+
+    BufblkFree(reordered);
+    BufblkFree(bufBlk);
+
+    return STATUS_OK;
+}
+
+int main() {
+    BufblkPoolInit();
+
+    UTLT_Assert(TestPfcpMessage_1() == STATUS_OK, return STATUS_ERROR, "TestPfcpMessage_1 fail");
+    UTLT_Assert(TestPfcpMessage_2() == STATUS_OK, return STATUS_ERROR, "TestPfcpMessage_2 fail");
+    UTLT_Assert(TestPfcpMessage_3() == STATUS_OK, return STATUS_ERROR, "TestPfcpMessage_3 fail");
+    UTLT_Assert(TestPfcpMessage_4() == STATUS_OK, return STATUS_ERROR, "TestPfcpMessage_4 fail");
+
+    BufblkPoolFinal();
+
+    return STATUS_OK;
+}
@@ -10,14 +10,20 @@ extern "C" {
 
 Status _3gppTypesTest(void *data);
 Status BuffTest(void *data);
+Status ClassifierTest(void *data);
 Status DebugTest(void *data);
 Status EventTest(void *data);
 Status HashTest(void *data);
 Status IndexTest(void *data);
+Status IpFilterTest(void *data);
 Status ListTest(void *data);
 Status MqTest(void *data);
+Status NetlinkTest(void *data);
 Status NetworkTest(void *data);
 Status PoolTest(void *data);
+Status RcuTest(void *data);
+Status SlotTableTest(void *data);
+Status SwissTableTest(void *data);
 Status ThreadTest(void *data);
 Status TimeTest(void *data);
 Status TimerTest(void *data);
@@ -1,11 +1,15 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <pthread.h>
+#include <unistd.h>
 
 #include "test_utlt.h"
 #include "utlt_debug.h"
 #include "utlt_pool.h"
 #include "utlt_buff.h"
+#include "utlt_time.h"
 
 Status TestBuff_1() {
     Status status;
@@ -167,6 +171,179 @@ Status TestBuff_5() {
     return STATUS_OK;
 }
 
+#define BUFF_TEST_NUM_OF_GROW      1000
+#define BUFF_TEST_PACKET_SIZE      1500
+#define BUFF_TEST_BURST            32
+#define BUFF_TEST_MAX_THREAD       4
+#define BUFF_TEST_DURATION_USEC    TimeMsecToUsec(300)
+
+static int BuffTestStat(uint32_t size, BufblkPoolStat *stat) {
+    BufblkPoolStat all[MAX_NUM_OF_BUFBLK_CLASS];
+    int num = BufblkPoolStats(all, MAX_NUM_OF_BUFBLK_CLASS);
+
+    for (int i = 0; i < num; i++) {
+        if (all[i].size == size) {
+            *stat = all[i];
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static void *BuffTestFreer(void *data) {
+    Bufblk **buffer = data;
+
+    for (int i = 0; i < BUFF_TEST_NUM_OF_GROW; i++)
+        if (BufblkFree(buffer[i]) != STATUS_OK)
+            return (void *) -1;
+
+    return NULL;
+}
+
+// Pool grows beyond a slab, and buffers are freed by another thread
+Status TestBuff_6() {
+    Bufblk *buffer[BUFF_TEST_NUM_OF_GROW];
+    BufblkPoolStat stat;
+    pthread_t freer;
+    void *result;
+
+    for (int i = 0; i < BUFF_TEST_NUM_OF_GROW; i++) {
+        buffer[i] = BufblkAlloc(1, BUFF_TEST_PACKET_SIZE);
+        UTLT_Assert(buffer[i], return STATUS_ERROR, "BufblkAlloc[%d] fail", i);
+        UTLT_Assert(buffer[i]->size == 1600, return STATUS_ERROR,
+            "Buffer size error : need %d, not %d", 1600, buffer[i]->size);
+        memset(buffer[i]->buf, i & 0xFF, buffer[i]->size);
+    }
+
+    for (int i = 0; i < BUFF_TEST_NUM_OF_GROW; i++)
+        UTLT_Assert(((uint8_t *) buffer[i]->buf)[buffer[i]->size - 1] == (i & 0xFF),
+            return STATUS_ERROR, "Buffer %d is overwritten", i);
+
+    UTLT_Assert(BuffTestStat(1600, &stat), return STATUS_ERROR, "No class of size 1600");
+    UTLT_Assert(stat.grow > 1 && stat.capacity >= BUFF_TEST_NUM_OF_GROW, return STATUS_ERROR,
+        "Pool should grow: %lu slabs, capacity %u", stat.grow, stat.capacity);
+    UTLT_Assert(stat.highWater >= BUFF_TEST_NUM_OF_GROW, return STATUS_ERROR,
+        "High water %u is less than %d", stat.highWater, BUFF_TEST_NUM_OF_GROW);
+
+    UTLT_Assert(pthread_create(&freer, NULL, BuffTestFreer, buffer) == 0,
+        return STATUS_ERROR, "Freer thread create failed");
+    pthread_join(freer, &result);
+    UTLT_Assert(!result, return STATUS_ERROR, "BufblkFree in another thread fail");
+
+    // Objects cached by the freer are given back when it exits, and those of this thread by the check
+    BufblkPoolCheck("TestBuff_6");
+    UTLT_Assert(BuffTestStat(1600, &stat), return STATUS_ERROR, "No class of size 1600");
+    UTLT_Assert(stat.alloc == BUFF_TEST_NUM_OF_GROW && stat.free == BUFF_TEST_NUM_OF_GROW,
+        return STATUS_ERROR, "alloc %lu and free %lu should be %d", stat.alloc, stat.free, BUFF_TEST_NUM_OF_GROW);
+    UTLT_Assert(stat.available == stat.capacity, return STATUS_ERROR,
+        "%u of %u buffers are not given back", stat.capacity - stat.available, stat.capacity);
+
+    return STATUS_OK;
+}
+
+static int useBufblk;
+static volatile int benchStop;
+
+static void *BuffTestWorker(void *data) {
+    uint64_t *opCnt = data;
+    Bufblk *bufblk[BUFF_TEST_BURST];
+    void *buf[BUFF_TEST_BURST];
+
+    while (!benchStop) {
+        if (useBufblk) {
+            for (int i = 0; i < BUFF_TEST_BURST; i++) {
+                bufblk[i] = BufblkAlloc(1, BUFF_TEST_PACKET_SIZE);
+                if (!bufblk[i])
+                    return (void *) -1;
+                ((uint8_t *) bufblk[i]->buf)[0] = i;
+            }
+            for (int i = 0; i < BUFF_TEST_BURST; i++)
+                BufblkFree(bufblk[i]);
+        } else {
+            // The same as Bufblk, a descriptor and a buffer
+            for (int i = 0; i < BUFF_TEST_BURST; i++) {
+                buf[i] = malloc(sizeof(Bufblk));
+                ((Bufblk *) buf[i])->buf = malloc(BUFF_TEST_PACKET_SIZE);
+                if (!buf[i] || !((Bufblk *) buf[i])->buf)
+                    return (void *) -1;
+                ((uint8_t *) ((Bufblk *) buf[i])->buf)[0] = i;
+            }
+            for (int i = 0; i < BUFF_TEST_BURST; i++) {
+                free(((Bufblk *) buf[i])->buf);
+                free(buf[i]);
+            }
+        }
+        *opCnt += BUFF_TEST_BURST;
+    }
+
+    return NULL;
+}
+
+static Status BuffTestContention(int bufblkPool, int numOfThread, uint64_t *opPerSec) {
+    pthread_t worker[BUFF_TEST_MAX_THREAD];
+    uint64_t opCnt[BUFF_TEST_MAX_THREAD];
+    void *result;
+    int failed = 0;
+
+    useBufblk = bufblkPool;
+    benchStop = 0;
+    memset(opCnt, 0, sizeof(opCnt));
+
+    for (int i = 0; i < numOfThread; i++)
+        UTLT_Assert(pthread_create(&worker[i], NULL, BuffTestWorker, &opCnt[i]) == 0,
+            return STATUS_ERROR, "Worker thread create failed");
+
+    utime_t start = TimeNow();
+    while (TimeNow() - start < BUFF_TEST_DURATION_USEC)
+        usleep(10000);
+    benchStop = 1;
+    utime_t elapsed = TimeNow() - start;
+
+    for (int i = 0; i < numOfThread; i++) {
+        pthread_join(worker[i], &result);
+        failed |= (result != NULL);
+    }
+    UTLT_Assert(!failed, return STATUS_ERROR, "Alloc fail in worker thread");
+
+    uint64_t totalOp = 0;
+    for (int i = 0; i < numOfThread; i++)
+        totalOp += opCnt[i];
+    *opPerSec = totalOp * USEC_PER_SEC / elapsed;
+
+    return STATUS_OK;
+}
+
+// Alloc and free a burst of packet buffers in each thread, Bufblk pool vs malloc
+Status TestBuff_7() {
+    uint64_t bufblkOp, mallocOp;
+    BufblkPoolStat before, after;
+
+    for (int num = 1; num <= BUFF_TEST_MAX_THREAD; num <<= 1) {
+        UTLT_Assert(BuffTestStat(1600, &before), return STATUS_ERROR, "No class of size 1600");
+        UTLT_Assert(BuffTestContention(1, num, &bufblkOp) == STATUS_OK, return STATUS_ERROR,
+            "Bufblk contention benchmark failed");
+        UTLT_Assert(BuffTestContention(0, num, &mallocOp) == STATUS_OK, return STATUS_ERROR,
+            "malloc contention benchmark failed");
+        BufblkPoolCheck("TestBuff_7");
+        UTLT_Assert(BuffTestStat(1600, &after), return STATUS_ERROR, "No class of size 1600");
+
+        uint64_t alloc = after.alloc - before.alloc;
+        UTLT_Assert(after.free - before.free == alloc, return STATUS_ERROR,
+            "alloc %lu and free %lu are not the same", alloc, after.free - before.free);
+        UTLT_Assert(after.available == after.capacity, return STATUS_ERROR,
+            "%u of %u buffers are not given back", after.capacity - after.available, after.capacity);
+
+        UTLT_Info("[Bufblk benchmark] %d threads, Bufblk: %lu alloc+free/s, malloc: %lu alloc+free/s",
+            num, bufblkOp, mallocOp);
+        UTLT_Info("[Bufblk benchmark] %d threads, hit rate %.2f%%, %lu refills, %lu flushes, %u slabs",
+            num, (alloc ? 100.0 * (after.hit - before.hit) / alloc : 0),
+            after.refill - before.refill, after.flush - before.flush, after.numOfSlab);
+    }
+
+    return STATUS_OK;
+}
+
 Status BuffTest(void *data) {
     Status status;
 
@@ -188,6 +365,14 @@ Status BuffTest(void *data) {
     status = TestBuff_5();
     UTLT_Assert(status == STATUS_OK, return status, "TestBuff_5 fail");
 
+    status = TestBuff_6();
+    UTLT_Assert(status == STATUS_OK, return status, "TestBuff_6 fail");
+
+    status = TestBuff_7();
+    UTLT_Assert(status == STATUS_OK, return status, "TestBuff_7 fail");
+
+    BufblkPoolCheck("BuffTest");
+
     status = BufblkPoolFinal();
     UTLT_Assert(status == STATUS_OK, return status, "BufblkPoolFinal fail");
 
@@ -0,0 +1,195 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+#include "test_utlt.h"
+#include "utlt_debug.h"
+#include "utlt_classifier.h"
+#include "utlt_time.h"
+
+#define CLASSIFIER_TEST_NUM_OF_KEY      4096
+#define CLASSIFIER_BENCH_NUM_OF_LOOKUP  200000
+
+static uint32_t classifierTestSeed = 5;
+
+static uint32_t ClassifierTestRand() {
+    // xorshift, keep the result the same on every run
+    classifierTestSeed ^= classifierTestSeed << 13;
+    classifierTestSeed ^= classifierTestSeed >> 17;
+    classifierTestSeed ^= classifierTestSeed << 5;
+    return classifierTestSeed;
+}
+
+static uint32_t ClassifierTestMask(int prefix) {
+    return prefix ? htonl(0xFFFFFFFFu << (32 - prefix)) : 0;
+}
+
+// The same semantics as the linear scan of match rules before using classifier
+static void *ClassifierTestLinear(const ClassifierRule *rules, int num, const ClassifierKey *key) {
+    for (int i = 0; i < num; i++) {
+        const ClassifierRule *rule = &rules[i];
+        if (rule->proto && rule->proto != key->proto)
+            continue;
+        if (rule->saddr && rule->smask && ((key->saddr ^ rule->saddr) & rule->smask))
+            continue;
+        if (rule->daddr && rule->dmask && ((key->daddr ^ rule->daddr) & rule->dmask))
+            continue;
+
+        int portMatch = 1;
+        if (rule->sportNum) {
+            portMatch = 0;
+            for (int j = 0; key->hasPort && j < rule->sportNum; j++)
+                if (PortStart(rule->sportList[j]) <= key->sport && PortEnd(rule->sportList[j]) >= key->sport)
+                    portMatch = 1;
+        }
+        if (portMatch && rule->dportNum) {
+            portMatch = 0;
+            for (int j = 0; key->hasPort && j < rule->dportNum; j++)
+                if (PortStart(rule->dportList[j]) <= key->dport && PortEnd(rule->dportList[j]) >= key->dport)
+                    portMatch = 1;
+        }
+        if (portMatch)
+            return rule->data;
+    }
+    return NULL;
+}
+
+static const uint32_t classifierTestPort[] = {
+    (80 << 16) | 80, (443 << 16) | 443, (1000 << 16) | 2000,
+};
+
+/*
+ * Rules of one UE: the UE IP is the destination, SDF filters use a few
+ * different prefixes, protocols and ports, and the last one is a default rule
+ */
+static void ClassifierTestRuleGen(ClassifierRule *rules, int num, uint32_t ueIP) {
+    static const int prefix[] = {16, 24, 32};
+
+    memset(rules, 0, sizeof(ClassifierRule) * num);
+    for (int i = 0; i < num; i++) {
+        ClassifierRule *rule = &rules[i];
+        uint32_t r = ClassifierTestRand();
+
+        rule->daddr = ueIP;
+        rule->dmask = ClassifierTestMask(32);
+        rule->data = (void *) (uintptr_t) (i + 1);
+        if (i == num - 1)
+            break;
+
+        rule->proto = (r & 0x1) ? 6 : 17;
+        rule->smask = ClassifierTestMask(prefix[(r >> 2) % 3]);
+        rule->saddr = htonl(0x0A000000 | (ClassifierTestRand() & 0xFFFFFF)) & rule->smask;
+        if ((r >> 5) % 4 == 0) {
+            rule->dportNum = 1;
+            rule->dportList = &classifierTestPort[(r >> 7) % 3];
+        }
+    }
+}
+
+static void ClassifierTestKeyGen(ClassifierKey *key, const ClassifierRule *rules, int num, uint32_t ueIP) {
+    uint32_t r = ClassifierTestRand();
+
+    // Mostly derived from a rule, so that lookups hit rules in the middle of the list
+    const ClassifierRule *rule = &rules[r % num];
+    key->proto = (r & 0x100) ? 17 : 6;
+    key->saddr = (r & 0x200) ? rule->saddr | (htonl(ClassifierTestRand() & 0xFF) & ~rule->smask) :
+        htonl(0x0A000000 | (ClassifierTestRand() & 0xFFFFFF));
+    key->daddr = ueIP;
+    key->hasPort = !!(r & 0x400);
+    key->sport = ClassifierTestRand() & 0xFFFF;
+    key->dport = (r & 0x800) ? 80 : 1000 + (ClassifierTestRand() % 2000);
+}
+
+// Classifier returns the same rule as linear scan
+Status TestClassifier_1() {
+    static ClassifierRule rules[1000];
+    ClassifierKey key;
+    uint32_t ueIP = htonl(0x3C3C0001);
+
+    int numList[] = {1, 2, 10, 100, 1000};
+    for (int n = 0; n < sizeof(numList) / sizeof(int); n++) {
+        ClassifierTestRuleGen(rules, numList[n], ueIP);
+
+        Classifier *classifier = ClassifierCompile(rules, numList[n]);
+        UTLT_Assert(classifier, return STATUS_ERROR, "ClassifierCompile failed");
+        UTLT_Assert(ClassifierNumOfRule(classifier) == numList[n], return STATUS_ERROR, "");
+
+        for (int i = 0; i < CLASSIFIER_TEST_NUM_OF_KEY; i++) {
+            ClassifierTestKeyGen(&key, rules, numList[n], ueIP);
+            void *expect = ClassifierTestLinear(rules, numList[n], &key);
+            void *result = ClassifierLookup(classifier, &key);
+            UTLT_Assert(expect == result, return STATUS_ERROR,
+                "%d rules: classifier matches rule[%lu], linear scan matches rule[%lu]",
+                numList[n], (uintptr_t) result, (uintptr_t) expect);
+        }
+
+        ClassifierFree(classifier);
+    }
+
+    // Empty classifier and equal keys keep the list order
+    Classifier *classifier = ClassifierCompile(NULL, 0);
+    UTLT_Assert(classifier, return STATUS_ERROR, "ClassifierCompile with 0 rule failed");
+    UTLT_Assert(!ClassifierLookup(classifier, &key), return STATUS_ERROR, "");
+    ClassifierFree(classifier);
+
+    memset(rules, 0, sizeof(ClassifierRule) * 2);
+    rules[0].data = (void *) 1;
+    rules[1].data = (void *) 2;
+    classifier = ClassifierCompile(rules, 2);
+    UTLT_Assert(classifier, return STATUS_ERROR, "");
+    UTLT_Assert(ClassifierLookup(classifier, &key) == (void *) 1, return STATUS_ERROR,
+        "The first rule should win when keys are equal");
+    ClassifierFree(classifier);
+
+    return STATUS_OK;
+}
+
+// Lookup per second of linear scan and classifier, from 1 to 1000 filters per session
+Status TestClassifier_2() {
+    static ClassifierRule rules[1000];
+    static ClassifierKey keys[CLASSIFIER_TEST_NUM_OF_KEY];
+    uint32_t ueIP = htonl(0x3C3C0002);
+    volatile uintptr_t sink = 0;
+
+    int numList[] = {1, 10, 100, 1000};
+    for (int n = 0; n < sizeof(numList) / sizeof(int); n++) {
+        ClassifierTestRuleGen(rules, numList[n], ueIP);
+        for (int i = 0; i < CLASSIFIER_TEST_NUM_OF_KEY; i++)
+            ClassifierTestKeyGen(&keys[i], rules, numList[n], ueIP);
+
+        Classifier *classifier = ClassifierCompile(rules, numList[n]);
+        UTLT_Assert(classifier, return STATUS_ERROR, "ClassifierCompile failed");
+
+        utime_t start = TimeNow();
+        for (int i = 0; i < CLASSIFIER_BENCH_NUM_OF_LOOKUP; i++)
+            sink += (uintptr_t) ClassifierTestLinear(rules, numList[n], &keys[i % CLASSIFIER_TEST_NUM_OF_KEY]);
+        utime_t linearTime = TimeNow() - start + 1;
+
+        start = TimeNow();
+        for (int i = 0; i < CLASSIFIER_BENCH_NUM_OF_LOOKUP; i++)
+            sink += (uintptr_t) ClassifierLookup(classifier, &keys[i % CLASSIFIER_TEST_NUM_OF_KEY]);
+        utime_t classifierTime = TimeNow() - start + 1;
+
+        UTLT_Info("[Classifier benchmark] %4d filters, %d tuples: linear %lu lookup/s, classifier %lu lookup/s",
+            numList[n], ClassifierNumOfTuple(classifier),
+            CLASSIFIER_BENCH_NUM_OF_LOOKUP * USEC_PER_SEC / linearTime,
+            CLASSIFIER_BENCH_NUM_OF_LOOKUP * USEC_PER_SEC / classifierTime);
+
+        ClassifierFree(classifier);
+    }
+
+    return STATUS_OK;
+}
+
+Status ClassifierTest(void *data) {
+    Status status;
+
+    status = TestClassifier_1();
+    UTLT_Assert(status == STATUS_OK, return status, "TestClassifier_1 fail");
+
+    status = TestClassifier_2();
+    UTLT_Assert(status == STATUS_OK, return status, "TestClassifier_2 fail");
+
+    return STATUS_OK;
+}
@@ -1,8 +1,17 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
 
 #include "test_utlt.h"
 #include "utlt_debug.h"
+#include "utlt_time.h"
+
+#define DEBUG_TEST_NUM_OF_THREAD    4
+#define DEBUG_BENCH_NUM_OF_LOG      200000
+#define DEBUG_BURST_NUM_OF_LOG      128     // Of each thread, half of its ring of async log
 
 Status TestDebug_1() {
     /*
@@ -34,6 +43,156 @@ Status TestDebug_2() {
     return STATUS_OK;
 }
 
+static int debugTestEvalCnt = 0;
+
+static const char *DebugTestArg() {
+    debugTestEvalCnt++;
+    return "";
+}
+
+// Arguments of a disabled log are not evaluated
+Status TestDebug_3() {
+    int level = utltLogLevel;
+
+    UTLT_Assert(UTLT_SetLogLevel("info") == STATUS_OK, return STATUS_ERROR, "");
+    UTLT_Assert(utltLogLevel == LOG_INFO, return STATUS_ERROR, "Log level %d should be info", utltLogLevel);
+
+    debugTestEvalCnt = 0;
+    UTLT_Debug("%s", DebugTestArg());
+    UTLT_Trace("%s", DebugTestArg());
+    UTLT_Level_Assert(LOG_DEBUG, 0, , "%s", DebugTestArg());
+    UTLT_Assert(debugTestEvalCnt == 0, return STATUS_ERROR,
+                "Disabled log evaluates its arguments %d times", debugTestEvalCnt);
+
+    UTLT_Assert(UTLT_SetLogLevel("PANIC") == STATUS_OK, return STATUS_ERROR, "");
+    UTLT_Assert(utltLogLevel == LOG_PANIC, return STATUS_ERROR, "Level name should be case insensitive");
+    UTLT_Info("%s", DebugTestArg());
+    UTLT_Assert(debugTestEvalCnt == 0, return STATUS_ERROR, "");
+
+    // Invalid level keeps the current one
+    UTLT_Assert(UTLT_SetLogLevel("verbose") == STATUS_ERROR, return STATUS_ERROR, "");
+    UTLT_Assert(utltLogLevel == LOG_PANIC, return STATUS_ERROR, "");
+
+    utltLogLevel = LOG_TRACE;
+    UTLT_Trace("%s", DebugTestArg());
+    UTLT_Assert(debugTestEvalCnt == (LOG_TRACE <= UTLT_COMPILE_LOG_LEVEL), return STATUS_ERROR,
+                "Enabled log should evaluate its arguments once");
+
+    static const char *levelName[] = {"panic", "fatal", "error", "warning", "info", "debug", "trace"};
+    UTLT_Assert(UTLT_SetLogLevel(levelName[level]) == STATUS_OK, return STATUS_ERROR, "");
+
+    return STATUS_OK;
+}
+
+/*
+ * Output like logrus with a file hook: the entry is written under the lock
+ * of logger, @debugTestSeq keeps the last seq written of each thread
+ */
+static pthread_mutex_t debugTestLock = PTHREAD_MUTEX_INITIALIZER;
+static int debugTestFd = -1;
+static int debugTestSeq[DEBUG_TEST_NUM_OF_THREAD];
+static int debugTestOrderError = 0;
+static int debugTestNumOfLog = 0;           // Of each thread
+
+static void DebugTestOutput(int level, const char *msg) {
+    int thread, seq;
+
+    pthread_mutex_lock(&debugTestLock);
+    if (sscanf(msg, "thread %d seq %d", &thread, &seq) == 2 && thread < DEBUG_TEST_NUM_OF_THREAD) {
+        if (seq <= debugTestSeq[thread])
+            debugTestOrderError++;
+        debugTestSeq[thread] = seq;
+    }
+    if (write(debugTestFd, msg, strlen(msg)) < 0)
+        debugTestOrderError++;
+    pthread_mutex_unlock(&debugTestLock);
+}
+
+static void *DebugTestLogger(void *data) {
+    int thread = (int) (uintptr_t) data;
+
+    for (int i = 1; i <= debugTestNumOfLog; i++)
+        UTLT_Info("thread %d seq %d, a PFCP request or a packet is handled", thread, i);
+
+    return NULL;
+}
+
+// @return: usec until log calls of all threads return
+static utime_t DebugTestLogRun(int numOfLog) {
+    pthread_t tid[DEBUG_TEST_NUM_OF_THREAD];
+
+    memset(debugTestSeq, 0, sizeof(debugTestSeq));
+    debugTestNumOfLog = numOfLog / DEBUG_TEST_NUM_OF_THREAD;
+
+    utime_t start = TimeNow();
+    for (int i = 0; i < DEBUG_TEST_NUM_OF_THREAD; i++)
+        UTLT_Assert(pthread_create(&tid[i], NULL, DebugTestLogger, (void *) (uintptr_t) i) == 0, return 0,
+                    "pthread_create fail");
+    for (int i = 0; i < DEBUG_TEST_NUM_OF_THREAD; i++)
+        pthread_join(tid[i], NULL);
+
+    return TimeNow() - start;
+}
+
+#define DebugTestRate(__num, __usec) ((uint64_t) (__num) * USEC_PER_SEC / ((__usec) + 1))
+
+/*
+ * Logs per second of 4 threads, written by the callers and by the writer thread.
+ * The async rate only counts logs written until the writer is stopped, since
+ * callers may outrun the writer and the dropped ones cost nothing.
+ * A burst which fits in the rings is not dropped at all.
+ */
+Status TestDebug_4() {
+    UTLT_LogStat before, after;
+    int level = utltLogLevel;
+    utime_t start;
+
+    debugTestFd = open("/dev/null", O_WRONLY);
+    UTLT_Assert(debugTestFd >= 0, return STATUS_ERROR, "Open /dev/null fail");
+    utltLogLevel = LOG_INFO;
+    UTLT_SetLogOutput(DebugTestOutput);
+
+    debugTestOrderError = 0;
+    uint64_t syncRate = DebugTestRate(DEBUG_BENCH_NUM_OF_LOG, DebugTestLogRun(DEBUG_BENCH_NUM_OF_LOG));
+
+    UTLT_LogGetStat(&before);
+    start = TimeNow();
+    UTLT_Assert(UTLT_LogAsyncStart() == STATUS_OK, return STATUS_ERROR, "UTLT_LogAsyncStart fail");
+    DebugTestLogRun(DEBUG_BENCH_NUM_OF_LOG);
+    UTLT_Assert(UTLT_LogAsyncStop() == STATUS_OK, return STATUS_ERROR, "UTLT_LogAsyncStop fail");
+    utime_t asyncTime = TimeNow() - start;
+    UTLT_LogGetStat(&after);
+
+    uint64_t written = after.written - before.written;
+    uint64_t dropped = after.dropped - before.dropped;
+    uint64_t asyncRate = DebugTestRate(written, asyncTime);
+
+    UTLT_LogGetStat(&before);
+    UTLT_Assert(UTLT_LogAsyncStart() == STATUS_OK, return STATUS_ERROR, "UTLT_LogAsyncStart fail");
+    utime_t burstTime = DebugTestLogRun(DEBUG_BURST_NUM_OF_LOG * DEBUG_TEST_NUM_OF_THREAD);
+    UTLT_Assert(UTLT_LogAsyncStop() == STATUS_OK, return STATUS_ERROR, "UTLT_LogAsyncStop fail");
+    UTLT_LogGetStat(&after);
+
+    UTLT_SetLogOutput(NULL);
+    utltLogLevel = level;
+    close(debugTestFd);
+
+    UTLT_Assert(!debugTestOrderError, return STATUS_ERROR, "Logs of a thread are out of order");
+    UTLT_Assert(written + dropped == DEBUG_BENCH_NUM_OF_LOG, return STATUS_ERROR,
+                "%lu written and %lu dropped, should be %d in total", written, dropped, DEBUG_BENCH_NUM_OF_LOG);
+    UTLT_Assert(after.dropped == before.dropped &&
+                after.written - before.written == DEBUG_BURST_NUM_OF_LOG * DEBUG_TEST_NUM_OF_THREAD,
+                return STATUS_ERROR, "%lu of the burst of %d logs are dropped",
+                after.dropped - before.dropped, DEBUG_BURST_NUM_OF_LOG * DEBUG_TEST_NUM_OF_THREAD);
+
+    UTLT_Info("[Log benchmark] %d threads: synchronous %lu log/s, asynchronous %lu log/s written "
+              "(%lu written, %lu dropped), burst of %d logs returns in %lu us without drop",
+              DEBUG_TEST_NUM_OF_THREAD, syncRate, asyncRate, written, dropped,
+              DEBUG_BURST_NUM_OF_LOG * DEBUG_TEST_NUM_OF_THREAD, burstTime);
+
+    return STATUS_OK;
+}
+
 Status DebugTest(void *data) {
     Status status;
 
@@ -43,5 +202,11 @@ Status DebugTest(void *data) {
     status = TestDebug_2();
     UTLT_Assert(status == STATUS_OK, return status, "TestDebug_2 fail");
 
+    status = TestDebug_3();
+    UTLT_Assert(status == STATUS_OK, return status, "TestDebug_3 fail");
+
+    status = TestDebug_4();
+    UTLT_Assert(status == STATUS_OK, return status, "TestDebug_4 fail");
+
     return STATUS_OK;
 }
@@ -1,9 +1,12 @@
 #include <stdio.h>
+#include <pthread.h>
 
 #include "test_utlt.h"
 #include "utlt_debug.h"
 #include "utlt_buff.h"
 #include "utlt_event.h"
+#include "utlt_mq.h"
+#include "utlt_time.h"
 
 #define TEST_EVENT_TYPE_A 0x0a
 #define TEST_EVENT_TYPE_B 0x0b
@@ -17,6 +20,11 @@
 #define TEST_EVENT_ARG_6 0x06
 #define TEST_EVENT_ARG_7 0x07
 
+#define TEST_EVENT_NUM_OF_PRODUCER  4
+#define TEST_EVENT_NUM_OF_EVENT     100000
+#define TEST_EVENT_NUM_OF_PINGPONG  10000
+#define TEST_EVENT_BATCH            32
+
 // Single event queue open close
 Status TestEvent_1() {
     Status status;
@@ -103,6 +111,188 @@ Status TestEvent_4() {
     return STATUS_OK;
 }
 
+typedef struct {
+    EvtQId eqId;
+    MQId mqId;
+    int id;
+    int num;
+} TestEventProducer;
+
+static void *TestEventProducerThread(void *data) {
+    TestEventProducer *producer = data;
+
+    for (int i = 1; i <= producer->num; i++)
+        EventSend(producer->eqId, TEST_EVENT_TYPE_A, 2, producer->id, i);
+
+    return NULL;
+}
+
+static void *TestEventMQProducerThread(void *data) {
+    TestEventProducer *producer = data;
+    Event event = {.type = TEST_EVENT_TYPE_A, .argc = 2, .arg0 = producer->id};
+
+    for (int i = 1; i <= producer->num; i++) {
+        event.arg1 = i;
+        MQSend(producer->mqId, (const char *) &event, sizeof(Event));
+    }
+
+    return NULL;
+}
+
+// Events of each producer keep their order, and nonblock queue or EventTrySend returns EAGAIN
+Status TestEvent_5() {
+    pthread_t tid[TEST_EVENT_NUM_OF_PRODUCER];
+    TestEventProducer producer[TEST_EVENT_NUM_OF_PRODUCER];
+    uintptr_t lastSeq[TEST_EVENT_NUM_OF_PRODUCER] = {0};
+    Event event[TEST_EVENT_BATCH];
+
+    EvtQId eqId = EventQueueCreate(EVTQ_O_BLOCK);
+    UTLT_Assert(eqId, return STATUS_ERROR, "");
+
+    for (int i = 0; i < TEST_EVENT_NUM_OF_PRODUCER; i++) {
+        producer[i] = (TestEventProducer) {.eqId = eqId, .id = i, .num = TEST_EVENT_NUM_OF_EVENT / TEST_EVENT_NUM_OF_PRODUCER};
+        UTLT_Assert(pthread_create(&tid[i], NULL, TestEventProducerThread, &producer[i]) == 0,
+            return STATUS_ERROR, "pthread_create fail");
+    }
+
+    for (int recvNum = 0; recvNum < TEST_EVENT_NUM_OF_EVENT; ) {
+        int num = EventRecvBatch(eqId, event, TEST_EVENT_BATCH);
+        UTLT_Assert(num > 0, return STATUS_ERROR, "EventRecvBatch return %d", num);
+
+        for (int i = 0; i < num; i++) {
+            UTLT_Assert(event[i].type == TEST_EVENT_TYPE_A && event[i].argc == 2 &&
+                event[i].arg0 < TEST_EVENT_NUM_OF_PRODUCER, return STATUS_ERROR, "Received event is not correct");
+            UTLT_Assert(event[i].arg1 == lastSeq[event[i].arg0] + 1, return STATUS_ERROR,
+                "Producer %lu: event %lu after %lu", event[i].arg0, event[i].arg1, lastSeq[event[i].arg0]);
+            lastSeq[event[i].arg0] = event[i].arg1;
+        }
+        recvNum += num;
+    }
+
+    for (int i = 0; i < TEST_EVENT_NUM_OF_PRODUCER; i++)
+        pthread_join(tid[i], NULL);
+    UTLT_Assert(EventQueueDelete(eqId) == STATUS_OK, return STATUS_ERROR, "");
+
+    eqId = EventQueueCreate(EVTQ_O_NONBLOCK);
+    UTLT_Assert(eqId, return STATUS_ERROR, "");
+    UTLT_Assert(EventRecv(eqId, &event[0]) == STATUS_EAGAIN, return STATUS_ERROR, "Empty queue should be EAGAIN");
+    for (int i = 0; i < SIZE_OF_EVENT_QUEUE; i++)
+        UTLT_Assert(EventSend(eqId, TEST_EVENT_TYPE_B, 1, i) == STATUS_OK, return STATUS_ERROR, "");
+    UTLT_Assert(EventSend(eqId, TEST_EVENT_TYPE_B, 0) == STATUS_EAGAIN, return STATUS_ERROR, "Full queue should be EAGAIN");
+    UTLT_Assert(EventRecvBatch(eqId, event, TEST_EVENT_BATCH) == TEST_EVENT_BATCH && event[TEST_EVENT_BATCH - 1].arg0 == TEST_EVENT_BATCH - 1,
+        return STATUS_ERROR, "");
+    UTLT_Assert(EventQueueDelete(eqId) == STATUS_OK, return STATUS_ERROR, "");
+
+    // EventTrySend does not wait on a full blocking queue
+    eqId = EventQueueCreate(EVTQ_O_BLOCK);
+    UTLT_Assert(eqId, return STATUS_ERROR, "");
+    for (int i = 0; i < SIZE_OF_EVENT_QUEUE; i++)
+        UTLT_Assert(EventTrySend(eqId, TEST_EVENT_TYPE_B, 1, i) == STATUS_OK, return STATUS_ERROR, "");
+    UTLT_Assert(EventTrySend(eqId, TEST_EVENT_TYPE_B, 0) == STATUS_EAGAIN, return STATUS_ERROR, "Full queue should be EAGAIN");
+    UTLT_Assert(EventRecv(eqId, &event[0]) == STATUS_OK && event[0].arg0 == 0, return STATUS_ERROR, "");
+    UTLT_Assert(EventTrySend(eqId, TEST_EVENT_TYPE_B, 0) == STATUS_OK, return STATUS_ERROR, "");
+    UTLT_Assert(EventQueueDelete(eqId) == STATUS_OK, return STATUS_ERROR, "");
+
+    return STATUS_OK;
+}
+
+static void *TestEventPongThread(void *data) {
+    EvtQId *eqId = data;
+    Event event;
+
+    for (int i = 0; i < TEST_EVENT_NUM_OF_PINGPONG; i++) {
+        EventRecv(eqId[0], &event);
+        EventSend(eqId[1], event.type, 1, event.arg0);
+    }
+
+    return NULL;
+}
+
+static void *TestEventMQPongThread(void *data) {
+    MQId *mqId = data;
+    char buf[8192];
+
+    for (int i = 0; i < TEST_EVENT_NUM_OF_PINGPONG; i++) {
+        MQRecv(mqId[0], buf, MQGetMsgSize(mqId[0]));
+        MQSend(mqId[1], buf, sizeof(Event));
+    }
+
+    return NULL;
+}
+
+// Throughput of producers to one consumer and round trip latency, POSIX MQ and event queue
+Status TestEvent_6() {
+    pthread_t tid[TEST_EVENT_NUM_OF_PRODUCER];
+    TestEventProducer producer[TEST_EVENT_NUM_OF_PRODUCER];
+    Event event[TEST_EVENT_BATCH];
+    char buf[8192];
+
+    // POSIX MQ, as the event queue was
+    MQId mqId[2] = {MQCreate(O_RDWR), MQCreate(O_RDWR)};
+    UTLT_Assert(mqId[0] && mqId[1], return STATUS_ERROR, "MQCreate fail");
+    long msgSize = MQGetMsgSize(mqId[0]);
+
+    utime_t start = TimeNow();
+    for (int i = 0; i < TEST_EVENT_NUM_OF_PRODUCER; i++) {
+        producer[i] = (TestEventProducer) {.mqId = mqId[0], .id = i, .num = TEST_EVENT_NUM_OF_EVENT / TEST_EVENT_NUM_OF_PRODUCER};
+        pthread_create(&tid[i], NULL, TestEventMQProducerThread, &producer[i]);
+    }
+    for (int i = 0; i < TEST_EVENT_NUM_OF_EVENT; i++)
+        UTLT_Assert(MQRecv(mqId[0], buf, msgSize) == STATUS_OK, return STATUS_ERROR, "MQRecv fail");
+    utime_t mqTime = TimeNow() - start + 1;
+    for (int i = 0; i < TEST_EVENT_NUM_OF_PRODUCER; i++)
+        pthread_join(tid[i], NULL);
+
+    pthread_create(&tid[0], NULL, TestEventMQPongThread, mqId);
+    start = TimeNow();
+    for (int i = 0; i < TEST_EVENT_NUM_OF_PINGPONG; i++) {
+        MQSend(mqId[0], (const char *) &event[0], sizeof(Event));
+        MQRecv(mqId[1], buf, msgSize);
+    }
+    utime_t mqRtt = TimeNow() - start;
+    pthread_join(tid[0], NULL);
+    MQDelete(mqId[0]);
+    MQDelete(mqId[1]);
+
+    // Event queue
+    EvtQId eqId[2] = {EventQueueCreate(EVTQ_O_BLOCK), EventQueueCreate(EVTQ_O_BLOCK)};
+    UTLT_Assert(eqId[0] && eqId[1], return STATUS_ERROR, "EventQueueCreate fail");
+
+    start = TimeNow();
+    for (int i = 0; i < TEST_EVENT_NUM_OF_PRODUCER; i++) {
+        producer[i] = (TestEventProducer) {.eqId = eqId[0], .id = i, .num = TEST_EVENT_NUM_OF_EVENT / TEST_EVENT_NUM_OF_PRODUCER};
+        pthread_create(&tid[i], NULL, TestEventProducerThread, &producer[i]);
+    }
+    for (int recvNum = 0; recvNum < TEST_EVENT_NUM_OF_EVENT; ) {
+        int num = EventRecvBatch(eqId[0], event, TEST_EVENT_BATCH);
+        UTLT_Assert(num > 0, return STATUS_ERROR, "EventRecvBatch fail");
+        recvNum += num;
+    }
+    utime_t evtqTime = TimeNow() - start + 1;
+    for (int i = 0; i < TEST_EVENT_NUM_OF_PRODUCER; i++)
+        pthread_join(tid[i], NULL);
+
+    pthread_create(&tid[0], NULL, TestEventPongThread, eqId);
+    start = TimeNow();
+    for (int i = 0; i < TEST_EVENT_NUM_OF_PINGPONG; i++) {
+        EventSend(eqId[0], TEST_EVENT_TYPE_A, 1, i);
+        EventRecv(eqId[1], &event[0]);
+    }
+    utime_t evtqRtt = TimeNow() - start;
+    pthread_join(tid[0], NULL);
+    EventQueueDelete(eqId[0]);
+    EventQueueDelete(eqId[1]);
+
+    UTLT_Info("[Event benchmark] %d producers: MQ %lu event/s, event queue %lu event/s; "
+              "round trip: MQ %.2f us, event queue %.2f us",
+              TEST_EVENT_NUM_OF_PRODUCER,
+              (uint64_t) TEST_EVENT_NUM_OF_EVENT * USEC_PER_SEC / mqTime,
+              (uint64_t) TEST_EVENT_NUM_OF_EVENT * USEC_PER_SEC / evtqTime,
+              (double) mqRtt / TEST_EVENT_NUM_OF_PINGPONG, (double) evtqRtt / TEST_EVENT_NUM_OF_PINGPONG);
+
+    return STATUS_OK;
+}
+
 Status EventTest(void *data) {
     Status status;
     
@@ -121,6 +311,12 @@ Status EventTest(void *data) {
     status = TestEvent_4();
     UTLT_Assert(status == STATUS_OK, return status, "TestEvent_4 fail");
 
+    status = TestEvent_5();
+    UTLT_Assert(status == STATUS_OK, return status, "TestEvent_5 fail");
+
+    status = TestEvent_6();
+    UTLT_Assert(status == STATUS_OK, return status, "TestEvent_6 fail");
+
     status = BufblkPoolFinal();
     UTLT_Assert(status == STATUS_OK, return status, "BufblkPoolFinal fail");
  
@@ -90,6 +90,33 @@ Status TestHash_3() {
     return STATUS_OK;
 }
 
+#define HASH_TEST_NUM_OF_KEY 100000
+
+// More keys than the largest array of UTLT_Malloc() can hold in one chain each
+Status TestHash_4() {
+    static uint32_t key[HASH_TEST_NUM_OF_KEY];
+    Hash *h = HashMake();
+    UTLT_Assert(h, return STATUS_ERROR, "The hash table is NULL");
+
+    for (uint32_t i = 0; i < HASH_TEST_NUM_OF_KEY; i++) {
+        key[i] = i;
+        HashSet(h, &key[i], sizeof(key[i]), &key[i]);
+    }
+    UTLT_Assert(HashCount(h) == HASH_TEST_NUM_OF_KEY, return STATUS_ERROR,
+        "Hash count error: need %d, not %u", HASH_TEST_NUM_OF_KEY, HashCount(h));
+
+    for (uint32_t i = 0; i < HASH_TEST_NUM_OF_KEY; i++) {
+        UTLT_Assert(HashGet(h, &i, sizeof(i)) == &key[i], return STATUS_ERROR,
+            "Hash get error of key %u", i);
+        HashSet(h, &i, sizeof(i), NULL);
+    }
+    UTLT_Assert(HashCount(h) == 0, return STATUS_ERROR, "Hash count error: need 0, not %u", HashCount(h));
+
+    HashDestroy(h);
+
+    return STATUS_OK;
+}
+
 Status HashTest(void *data) {
     Status status;
 
@@ -105,6 +132,9 @@ Status HashTest(void *data) {
     status = TestHash_3();
     UTLT_Assert(status == STATUS_OK, return status, "TestHash_3 fail");
 
+    status = TestHash_4();
+    UTLT_Assert(status == STATUS_OK, return status, "TestHash_4 fail");
+
     status = BufblkPoolFinal();
     UTLT_Assert(status == STATUS_OK, return status, "BufblkPoolFinal fail");
 
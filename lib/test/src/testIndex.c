@@ -1,10 +1,13 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <pthread.h>
+#include <unistd.h>
 
 #include "test_utlt.h"
 #include "utlt_debug.h"
 #include "utlt_index.h"
+#include "utlt_time.h"
 
 /*****************************************************************************
  * Index is similar to Pool, only add some code from "utlt_pool.h".
@@ -20,7 +23,7 @@ typedef struct {
     int x, y;
 } Pos;
 
-IndexDeclare(testPos, Pos, MAX_NUM_OF_CAP);
+IndexDeclare(testPos, Pos);
 
 Status TestIndex_1() {
     UTLT_Assert(IndexSize(&testPos) == MAX_NUM_OF_CAP, return STATUS_ERROR, 
@@ -41,17 +44,247 @@ Status TestIndex_1() {
                 "IndexFind fail, need address[%p] not address[%p]", p1, ptr);
 
     IndexFree(&testPos, p1);
-    int lastQEnd = (MAX_NUM_OF_CAP + globalCnt) % (MAX_NUM_OF_CAP + 1);
-    int lastQFirst = globalCnt % (MAX_NUM_OF_CAP + 1); 
-    UTLT_Assert(testPos.queueAvail[lastQEnd] == testPos.queueAvail[lastQFirst],
-                return STATUS_ERROR, "IndexFree fail, need address[%p] not address[%p]", 
-                testPos.queueAvail[lastQFirst], testPos.queueAvail[lastQEnd]);
+    UTLT_Assert(IndexSize(&testPos) == MAX_NUM_OF_CAP, return STATUS_ERROR, 
+                "The size of index is %d, not %d", MAX_NUM_OF_CAP, IndexSize(&testPos));
+
+    // The freed one is the first to be taken again, with the same index
+    Pos *p2 = NULL;
+    IndexAlloc(&testPos, p2);
+    UTLT_Assert(p2 == p1 && p2->index == 0, return STATUS_ERROR, 
+                "IndexFree fail, need address[%p] not address[%p]", p1, p2);
+    IndexFree(&testPos, p2);
 
     globalCnt++;
 
     return STATUS_OK;
 }
 
+#define INDEX_TEST_NUM_OF_GROW      100000
+#define INDEX_TEST_BURST            32
+#define INDEX_TEST_MAX_THREAD       4
+#define INDEX_TEST_DURATION_USEC    TimeMsecToUsec(300)
+
+typedef struct {
+    int index;
+    uint8_t data[200];
+} Session;
+
+IndexDeclare(testSession, Session);
+
+static int IndexTestStat(IndexPool *pool, IndexPoolStat *stat) {
+    IndexPoolStat all[MAX_NUM_OF_INDEX_POOL];
+    int num = IndexPoolStats(all, MAX_NUM_OF_INDEX_POOL);
+
+    for (int i = 0; i < num; i++) {
+        if (!strcmp(all[i].name, pool->name)) {
+            *stat = all[i];
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static void *IndexTestFreer(void *data) {
+    Session **session = data;
+
+    for (int i = 0; i < INDEX_TEST_NUM_OF_GROW; i += 2)
+        if (IndexFree(&testSession, session[i]) != STATUS_OK)
+            return (void *) -1;
+
+    return NULL;
+}
+
+// Index grows by chunks up to its capacity, indices stay stable, and objects are freed by another thread
+Status TestIndex_2() {
+    Session **session = malloc(sizeof(Session *) * INDEX_TEST_NUM_OF_GROW);
+    UTLT_Assert(session, return STATUS_ERROR, "Session array alloc fail");
+    IndexPoolStat stat;
+    Status status = STATUS_ERROR;
+    pthread_t freer;
+    void *result;
+
+    UTLT_Assert(IndexInit(&testSession, INDEX_TEST_NUM_OF_GROW) == STATUS_OK, goto free, "IndexInit fail");
+    UTLT_Assert(IndexTestStat(&testSession, &stat), goto term, "No statistics of testSession");
+    UTLT_Assert(stat.allocated == 0 && stat.capacity == INDEX_TEST_NUM_OF_GROW, goto term,
+        "Nothing should be allocated before use: %u of %u", stat.allocated, stat.capacity);
+
+    for (int i = 0; i < INDEX_TEST_NUM_OF_GROW; i++) {
+        IndexAlloc(&testSession, session[i]);
+        UTLT_Assert(session[i], goto term, "IndexAlloc[%d] fail", i);
+        UTLT_Assert(session[i]->data[0] == 0, goto term, "Session %d is not cleared", i);
+        memset(session[i]->data, session[i]->index & 0xFF, sizeof(session[i]->data));
+    }
+
+    Session *full = NULL;
+    IndexAlloc(&testSession, full);
+    UTLT_Assert(!full && IndexSize(&testSession) == 0, goto term, "Index should be full");
+
+    for (int i = 0; i < INDEX_TEST_NUM_OF_GROW; i++) {
+        Session *found = IndexFind(&testSession, session[i]->index);
+        UTLT_Assert(found == session[i] && found->data[sizeof(found->data) - 1] == (found->index & 0xFF),
+            goto term, "IndexFind[%d] fail, need address[%p] not address[%p]", i, session[i], found);
+    }
+    UTLT_Assert(!IndexFind(&testSession, INDEX_TEST_NUM_OF_GROW), goto term,
+        "IndexFind should fail beyond capacity");
+
+    UTLT_Assert(IndexTestStat(&testSession, &stat), goto term, "No statistics of testSession");
+    UTLT_Assert(stat.numOfChunk > 1 && stat.allocated == INDEX_TEST_NUM_OF_GROW &&
+                stat.used == INDEX_TEST_NUM_OF_GROW && stat.highWater == INDEX_TEST_NUM_OF_GROW &&
+                stat.fail == 1, goto term,
+        "Statistics error: %u chunks, %u allocated, %u used, %u high water, %lu fail",
+        stat.numOfChunk, stat.allocated, stat.used, stat.highWater, stat.fail);
+
+    UTLT_Assert(pthread_create(&freer, NULL, IndexTestFreer, session) == 0,
+        goto term, "Freer thread create failed");
+    pthread_join(freer, &result);
+    UTLT_Assert(!result, goto term, "IndexFree in another thread fail");
+
+    for (int i = 1; i < INDEX_TEST_NUM_OF_GROW; i += 2)
+        UTLT_Assert(IndexFree(&testSession, session[i]) == STATUS_OK, goto term, "IndexFree[%d] fail", i);
+    UTLT_Assert(IndexFree(&testSession, session[1]) != STATUS_OK, goto term, "Double free should fail");
+    UTLT_Assert(IndexSize(&testSession) == INDEX_TEST_NUM_OF_GROW, goto term,
+        "The size of index is %d, not %d", IndexSize(&testSession), INDEX_TEST_NUM_OF_GROW);
+
+    // Objects cached by the freer are given back when it exits, so all of them can be taken again
+    for (int i = 0; i < INDEX_TEST_NUM_OF_GROW; i++) {
+        IndexAlloc(&testSession, session[i]);
+        UTLT_Assert(session[i], goto term, "IndexAlloc[%d] after free fail", i);
+    }
+    for (int i = 0; i < INDEX_TEST_NUM_OF_GROW; i++)
+        IndexFree(&testSession, session[i]);
+
+    status = STATUS_OK;
+
+term:
+    IndexTerminate(&testSession);
+free:
+    free(session);
+
+    return status;
+}
+
+static int useIndex;
+static volatile int benchStop;
+
+static void *IndexTestWorker(void *data) {
+    uint64_t *opCnt = data;
+    Session *session[INDEX_TEST_BURST];
+
+    while (!benchStop) {
+        for (int i = 0; i < INDEX_TEST_BURST; i++) {
+            if (useIndex)
+                IndexAlloc(&testSession, session[i]);
+            else
+                session[i] = calloc(1, sizeof(Session));
+            if (!session[i])
+                return (void *) -1;
+        }
+        for (int i = 0; i < INDEX_TEST_BURST; i++) {
+            if (useIndex)
+                IndexFree(&testSession, session[i]);
+            else
+                free(session[i]);
+        }
+        *opCnt += INDEX_TEST_BURST;
+    }
+
+    return NULL;
+}
+
+static Status IndexTestContention(int indexPool, int numOfThread, uint64_t *opPerSec) {
+    pthread_t worker[INDEX_TEST_MAX_THREAD];
+    uint64_t opCnt[INDEX_TEST_MAX_THREAD];
+    void *result;
+    int failed = 0;
+
+    useIndex = indexPool;
+    benchStop = 0;
+    memset(opCnt, 0, sizeof(opCnt));
+
+    for (int i = 0; i < numOfThread; i++)
+        UTLT_Assert(pthread_create(&worker[i], NULL, IndexTestWorker, &opCnt[i]) == 0,
+            return STATUS_ERROR, "Worker thread create failed");
+
+    utime_t start = TimeNow();
+    while (TimeNow() - start < INDEX_TEST_DURATION_USEC)
+        usleep(10000);
+    benchStop = 1;
+    utime_t elapsed = TimeNow() - start;
+
+    for (int i = 0; i < numOfThread; i++) {
+        pthread_join(worker[i], &result);
+        failed |= (result != NULL);
+    }
+    UTLT_Assert(!failed, return STATUS_ERROR, "Alloc fail in worker thread");
+
+    uint64_t totalOp = 0;
+    for (int i = 0; i < numOfThread; i++)
+        totalOp += opCnt[i];
+    *opPerSec = totalOp * USEC_PER_SEC / elapsed;
+
+    return STATUS_OK;
+}
+
+// Alloc and free a burst of sessions in each thread, Index vs calloc
+Status TestIndex_3() {
+    uint64_t indexOp, mallocOp;
+    IndexPoolStat stat;
+
+    UTLT_Assert(IndexInit(&testSession, INDEX_TEST_NUM_OF_GROW) == STATUS_OK, return STATUS_ERROR,
+        "IndexInit fail");
+
+    for (int num = 1; num <= INDEX_TEST_MAX_THREAD; num <<= 1) {
+        UTLT_Assert(IndexTestContention(1, num, &indexOp) == STATUS_OK, return STATUS_ERROR,
+            "Index contention benchmark failed");
+        UTLT_Assert(IndexTestContention(0, num, &mallocOp) == STATUS_OK, return STATUS_ERROR,
+            "calloc contention benchmark failed");
+        UTLT_Assert(IndexSize(&testSession) == INDEX_TEST_NUM_OF_GROW, return STATUS_ERROR,
+            "%d sessions are not given back", INDEX_TEST_NUM_OF_GROW - IndexSize(&testSession));
+        UTLT_Assert(IndexTestStat(&testSession, &stat), return STATUS_ERROR, "No statistics of testSession");
+
+        UTLT_Info("[Index benchmark] %d threads, Index: %lu alloc+free/s, calloc: %lu alloc+free/s, "
+            "%u allocated, %u high water", num, indexOp, mallocOp, stat.allocated, stat.highWater);
+    }
+
+    IndexPoolReport();
+
+    return IndexTerminate(&testSession);
+}
+
+#define INDEX_TEST_NUM_OF_RESERVE   1000000
+
+// A large pool on hugepages reserves its capacity, but only takes memory of what is used
+Status TestIndex_4() {
+    Session *session[INDEX_TEST_BURST];
+    IndexPoolStat stat;
+
+    UTLT_Assert(IndexPoolInit(&testSession, INDEX_TEST_NUM_OF_RESERVE, INDEX_POOL_HUGEPAGE) == STATUS_OK,
+        return STATUS_ERROR, "IndexPoolInit with hugepages fail");
+
+    for (int i = 0; i < INDEX_TEST_BURST; i++) {
+        IndexAlloc(&testSession, session[i]);
+        UTLT_Assert(session[i], return STATUS_ERROR, "IndexAlloc[%d] fail", i);
+        memset(session[i]->data, 0x5A, sizeof(session[i]->data));
+    }
+    Session *last = NULL;
+    UTLT_Assert(!IndexFind(&testSession, INDEX_TEST_NUM_OF_RESERVE - 1), return STATUS_ERROR,
+        "The last chunk should not be grown");
+
+    UTLT_Assert(IndexTestStat(&testSession, &stat), return STATUS_ERROR, "No statistics of testSession");
+    UTLT_Assert(stat.reserved >= (uint64_t) INDEX_TEST_NUM_OF_RESERVE * sizeof(Session) &&
+                stat.memory < stat.reserved / 100 && strcmp(stat.backing, "malloc"), return STATUS_ERROR,
+        "%lu bytes reserved by %s, %lu bytes used", stat.reserved, stat.backing, stat.memory);
+
+    for (int i = 0; i < INDEX_TEST_BURST; i++)
+        IndexFree(&testSession, session[i]);
+    IndexAlloc(&testSession, last);
+    UTLT_Assert(last && last->data[0] == 0, return STATUS_ERROR, "IndexAlloc after free fail");
+    IndexFree(&testSession, last);
+
+    return IndexTerminate(&testSession);
+}
+
 Status IndexTest(void *data) {
     Status status;
 
@@ -63,5 +296,14 @@ Status IndexTest(void *data) {
     status = IndexTerminate(&testPos);
     UTLT_Assert(status == STATUS_OK, return status, "IndexTerminate fail");
 
+    status = TestIndex_2();
+    UTLT_Assert(status == STATUS_OK, return status, "TestIndex_2 fail");
+
+    status = TestIndex_3();
+    UTLT_Assert(status == STATUS_OK, return status, "TestIndex_3 fail");
+
+    status = TestIndex_4();
+    UTLT_Assert(status == STATUS_OK, return status, "TestIndex_4 fail");
+
     return STATUS_OK;
 }
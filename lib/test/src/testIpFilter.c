@@ -0,0 +1,334 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <regex.h>
+#include <arpa/inet.h>
+
+#include "test_utlt.h"
+#include "utlt_debug.h"
+#include "utlt_ipfilter.h"
+#include "utlt_time.h"
+
+#define IPFILTER_TEST_NUM_OF_FUZZ       20000
+#define IPFILTER_BENCH_NUM_OF_REGEX     2000
+#define IPFILTER_BENCH_NUM_OF_PARSE     200000
+
+// The same pattern as MatchRuleCompile used before, which is copied from libgtp5gnl
+#define IPFILTER_TEST_ADDR "(any|assigned|[0-9]{1,3}\\.[0-9]{1,3}\\.[0-9]{1,3}\\.[0-9]{1,3}(/[0-9]{1,2})?)"
+#define IPFILTER_TEST_PORT "([ ][0-9]{1,5}([,-][0-9]{1,5})*)?"
+#define IPFILTER_TEST_REGEX "^(permit) (in|out) (ip|[0-9]{1,3}) from " \
+    IPFILTER_TEST_ADDR IPFILTER_TEST_PORT " to " IPFILTER_TEST_ADDR IPFILTER_TEST_PORT "$"
+
+static uint32_t ipFilterTestSeed = 7;
+
+static uint32_t IpFilterTestRand() {
+    // xorshift, keep the result the same on every run
+    ipFilterTestSeed ^= ipFilterTestSeed << 13;
+    ipFilterTestSeed ^= ipFilterTestSeed >> 17;
+    ipFilterTestSeed ^= ipFilterTestSeed << 5;
+    return ipFilterTestSeed;
+}
+
+static Status IpFilterTestRefPorts(const char *str, int len, IPFilterAddr *addr) {
+    char buf[0xff], *savePtr = NULL;
+
+    memcpy(buf, str, len);
+    buf[len] = '\0';
+
+    for (char *tok = strtok_r(buf, ",", &savePtr); tok; tok = strtok_r(NULL, ",", &savePtr)) {
+        char *dash = strchr(tok, '-');
+        uint32_t start = atoi(tok), end = (dash ? atoi(dash + 1) : start);
+
+        if ((dash && strchr(dash + 1, '-')) || start > 0xFFFF || end > 0xFFFF ||
+            addr->portNum == MAX_NUM_OF_IPFILTER_PORT)
+            return STATUS_ERROR;
+
+        if (start > end) {
+            uint32_t tmp = start;
+            start = end;
+            end = tmp;
+        }
+        addr->portList[addr->portNum++] = (start << 16) | end;
+    }
+
+    return STATUS_OK;
+}
+
+static Status IpFilterTestRefAddr(const char *str, const regmatch_t *pmatch, IPFilterAddr *addr) {
+    char buf[0xff];
+    int maskLen = pmatch[1].rm_eo - pmatch[1].rm_so;
+    int len = pmatch[0].rm_eo - pmatch[0].rm_so - maskLen;
+
+    memcpy(buf, str + pmatch[0].rm_so, len);
+    buf[len] = '\0';
+
+    if (!strcasecmp(buf, "any"))
+        addr->type = IPFILTER_ADDR_ANY;
+    else if (!strcasecmp(buf, "assigned"))
+        addr->type = IPFILTER_ADDR_ASSIGNED;
+    else {
+        addr->type = IPFILTER_ADDR_IPV4;
+        addr->prefixLen = 32;
+        if (inet_pton(AF_INET, buf, &addr->ipv4) != 1)
+            return STATUS_ERROR;
+
+        if (maskLen) {
+            memcpy(buf, str + pmatch[1].rm_so + 1, maskLen - 1);
+            buf[maskLen - 1] = '\0';
+            if (atoi(buf) > 32)
+                return STATUS_ERROR;
+            addr->prefixLen = atoi(buf);
+        }
+    }
+
+    len = pmatch[2].rm_eo - pmatch[2].rm_so;
+    if (len)
+        return IpFilterTestRefPorts(str + pmatch[2].rm_so + 1, len - 1, addr);
+
+    return STATUS_OK;
+}
+
+/*
+ * Reference parser: the regex and field extraction of the old MatchRuleCompile.
+ * Besides, "any" and "assigned" are reported instead of failing in inet_pton,
+ * "/0" is allowed, and ports larger than 65535, "a-b-c" or more than
+ * MAX_NUM_OF_IPFILTER_PORT ranges are rejected instead of being truncated
+ */
+static Status IpFilterTestRefParse(regex_t *preg, IPFilterRule *rule, const char *str) {
+    regmatch_t pmatch[0x10];
+    char buf[0xff];
+    int len;
+
+    memset(rule, 0, sizeof(IPFilterRule));
+    if (regexec(preg, str, sizeof(pmatch) / sizeof(regmatch_t), pmatch, 0))
+        return STATUS_ERROR;
+
+    len = pmatch[2].rm_eo - pmatch[2].rm_so;
+    rule->direction = (len == 2 ? IPFILTER_DIRECTION_IN : IPFILTER_DIRECTION_OUT);
+
+    len = pmatch[3].rm_eo - pmatch[3].rm_so;
+    memcpy(buf, str + pmatch[3].rm_so, len);
+    buf[len] = '\0';
+    if (strcasecmp(buf, "ip")) {
+        if (atoi(buf) > 0xFF)
+            return STATUS_ERROR;
+        rule->proto = atoi(buf);
+    }
+
+    if (IpFilterTestRefAddr(str, &pmatch[4], &rule->src) != STATUS_OK)
+        return STATUS_ERROR;
+
+    regmatch_t dstMatch[3] = {pmatch[8], pmatch[9], pmatch[10]};
+    return IpFilterTestRefAddr(str, dstMatch, &rule->dst);
+}
+
+static int IpFilterTestAddrEqual(const IPFilterAddr *a, const IPFilterAddr *b) {
+    if (a->type != b->type || a->portNum != b->portNum ||
+        memcmp(a->portList, b->portList, sizeof(uint32_t) * a->portNum))
+        return 0;
+    if (a->type == IPFILTER_ADDR_IPV4)
+        return a->prefixLen == b->prefixLen && a->ipv4.s_addr == b->ipv4.s_addr;
+    if (a->type == IPFILTER_ADDR_IPV6)
+        return a->prefixLen == b->prefixLen && !memcmp(&a->ipv6, &b->ipv6, sizeof(struct in6_addr));
+    return 1;
+}
+
+static int IpFilterTestRuleEqual(const IPFilterRule *a, const IPFilterRule *b) {
+    return a->direction == b->direction && a->proto == b->proto &&
+        IpFilterTestAddrEqual(&a->src, &b->src) && IpFilterTestAddrEqual(&a->dst, &b->dst);
+}
+
+// Valid choices are in front of each list
+static const char *ipFilterTestAction[] = {"permit", "PERMIT", "deny", "permi", ""};
+static const char *ipFilterTestDirection[] = {"out", "in", "OUT", "inout", ""};
+static const char *ipFilterTestProto[] = {"ip", "17", "6", "IP", "255", "006", "256", "1234", "x", ""};
+static const char *ipFilterTestAddr[] = {
+    "any", "assigned", "10.0.0.1", "10.0.0.0/8", "60.60.0.1/32", "0.0.0.0", "1.2.3.4/0", "ANY",
+    "1.2.3.4/33", "256.1.1.1", "01.2.3.4", "1.2.3", "1.2.3.4.5", "1.2.3.4/", "1.2.3.4/123", "",
+};
+static const char *ipFilterTestPort[] = {
+    "", " 80", " 80,443", " 1000-2000", " 2000-1000", " 80,443-500,8080", " 65535", " 00080",
+    " 65536", " 99999", " 1-2-3", " 80,", " ,80", " 123456", "  80",
+};
+
+#define IpFilterTestPick(__list, __numOfValid) \
+    (__list)[(IpFilterTestRand() % 4) ? IpFilterTestRand() % (__numOfValid) : \
+        IpFilterTestRand() % (sizeof(__list) / sizeof(char *))]
+
+static void IpFilterTestGen(char *buf, int size) {
+    static const char alphabet[] = " 0123456789./-,:abdefilnoprstuIP";
+
+    snprintf(buf, size, "%s %s %s from %s%s to %s%s",
+        IpFilterTestPick(ipFilterTestAction, 2), IpFilterTestPick(ipFilterTestDirection, 3),
+        IpFilterTestPick(ipFilterTestProto, 6),
+        IpFilterTestPick(ipFilterTestAddr, 8), IpFilterTestPick(ipFilterTestPort, 8),
+        IpFilterTestPick(ipFilterTestAddr, 8), IpFilterTestPick(ipFilterTestPort, 8));
+
+    // Replace, insert or delete a few characters
+    int numOfMutation = IpFilterTestRand() % 4;
+    for (int i = 0; i < numOfMutation; i++) {
+        int len = strlen(buf), pos = IpFilterTestRand() % (len + 1);
+        char c = alphabet[IpFilterTestRand() % (sizeof(alphabet) - 1)];
+
+        switch (IpFilterTestRand() % 3) {
+            case 0:
+                if (pos < len)
+                    buf[pos] = c;
+                break;
+            case 1:
+                if (len + 1 < size) {
+                    memmove(buf + pos + 1, buf + pos, len - pos + 1);
+                    buf[pos] = c;
+                }
+                break;
+            default:
+                if (pos < len)
+                    memmove(buf + pos, buf + pos + 1, len - pos);
+        }
+    }
+}
+
+// Tokenizer has the same result as the regex on random IPv4 rules
+Status TestIpFilter_1() {
+    regex_t preg;
+    IPFilterRule expect, result;
+    char buf[0x80];
+    int numOfAccept = 0, numOfReject = 0;
+
+    UTLT_Assert(!regcomp(&preg, IPFILTER_TEST_REGEX, REG_EXTENDED | REG_ICASE), return STATUS_ERROR,
+        "Reference regex compile failed");
+
+    for (int i = 0; i < IPFILTER_TEST_NUM_OF_FUZZ; i++) {
+        IpFilterTestGen(buf, sizeof(buf));
+        // IPv6 is out of the regex grammar
+        if (strchr(buf, ':'))
+            continue;
+
+        Status expectStatus = IpFilterTestRefParse(&preg, &expect, buf);
+        Status resultStatus = IPFilterRuleParse(&result, buf, strlen(buf));
+        UTLT_Assert(expectStatus == resultStatus, regfree(&preg); return STATUS_ERROR,
+            "[%s] regex returns %d, tokenizer returns %d", buf, expectStatus, resultStatus);
+
+        if (resultStatus == STATUS_OK) {
+            UTLT_Assert(IpFilterTestRuleEqual(&expect, &result), regfree(&preg); return STATUS_ERROR,
+                "[%s] tokenizer result is different from regex", buf);
+            numOfAccept++;
+        } else {
+            numOfReject++;
+        }
+    }
+    regfree(&preg);
+
+    UTLT_Assert(numOfAccept > IPFILTER_TEST_NUM_OF_FUZZ / 10 && numOfReject > IPFILTER_TEST_NUM_OF_FUZZ / 10,
+        return STATUS_ERROR, "Fuzz cases are not balanced: %d accepted, %d rejected", numOfAccept, numOfReject);
+
+    return STATUS_OK;
+}
+
+// IPv6, port list limit and the other cases out of the regex grammar
+Status TestIpFilter_2() {
+    IPFilterRule rule;
+    const char *str;
+    struct in6_addr ipv6;
+
+    str = "permit out ip from 2001:db8::1/64 80 to assigned 1000-2000";
+    UTLT_Assert(IPFilterRuleParse(&rule, str, strlen(str)) == STATUS_OK, return STATUS_ERROR, "[%s] should be valid", str);
+    inet_pton(AF_INET6, "2001:db8::1", &ipv6);
+    UTLT_Assert(rule.src.type == IPFILTER_ADDR_IPV6 && rule.src.prefixLen == 64 &&
+        !memcmp(&rule.src.ipv6, &ipv6, sizeof(ipv6)), return STATUS_ERROR, "[%s] src address error", str);
+    UTLT_Assert(rule.src.portNum == 1 && rule.src.portList[0] == ((80 << 16) | 80), return STATUS_ERROR,
+        "[%s] src port error", str);
+    UTLT_Assert(rule.dst.type == IPFILTER_ADDR_ASSIGNED && rule.dst.portNum == 1 &&
+        rule.dst.portList[0] == ((1000 << 16) | 2000), return STATUS_ERROR, "[%s] dst error", str);
+
+    str = "permit in 17 from any to ::ffff:10.0.0.1";
+    UTLT_Assert(IPFilterRuleParse(&rule, str, strlen(str)) == STATUS_OK, return STATUS_ERROR, "[%s] should be valid", str);
+    UTLT_Assert(rule.direction == IPFILTER_DIRECTION_IN && rule.proto == 17 && rule.src.type == IPFILTER_ADDR_ANY &&
+        rule.dst.type == IPFILTER_ADDR_IPV6 && rule.dst.prefixLen == 128, return STATUS_ERROR, "[%s] result error", str);
+
+    str = "permit out ip from 10.0.0.1 to 60.60.0.1";
+    UTLT_Assert(IPFilterRuleParse(&rule, str, strlen(str)) == STATUS_OK, return STATUS_ERROR, "[%s] should be valid", str);
+    UTLT_Assert(rule.src.prefixLen == 32 && IPFilterIPv4Mask(rule.src.prefixLen) == 0xFFFFFFFF,
+        return STATUS_ERROR, "[%s] address without mask should be a host", str);
+    UTLT_Assert(IPFilterIPv4Mask(8) == htonl(0xFF000000) && IPFilterIPv4Mask(0) == 0, return STATUS_ERROR,
+        "IPFilterIPv4Mask error");
+
+    // Not terminated by '\0', only the first len characters are used
+    str = "permit out ip from any to assigned 80xyz";
+    UTLT_Assert(IPFilterRuleParse(&rule, str, strlen(str) - 3) == STATUS_OK, return STATUS_ERROR,
+        "[%s] with length should be valid", str);
+
+    str = "permit out ip from any to any 1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16";
+    UTLT_Assert(IPFilterRuleParse(&rule, str, strlen(str)) == STATUS_OK && rule.dst.portNum == MAX_NUM_OF_IPFILTER_PORT,
+        return STATUS_ERROR, "[%s] should be valid", str);
+
+    const char *invalid[] = {
+        "permit out ip from any to any 1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16,17",
+        "permit out ip from 2001:db8::1/129 to any",
+        "permit out ip from 2001:db8:::1 to any",
+        "permit out ip from 10.0.0.1 to 2001:db8::1",
+        "permit out ip from 2001:db8::1/ to any",
+        "permit out ip from any to any ",
+        "permit out ip from any",
+        "",
+    };
+    for (int i = 0; i < sizeof(invalid) / sizeof(char *); i++)
+        UTLT_Assert(IPFilterRuleParse(&rule, invalid[i], strlen(invalid[i])) == STATUS_ERROR, return STATUS_ERROR,
+            "[%s] should be invalid", invalid[i]);
+
+    return STATUS_OK;
+}
+
+static const char *ipFilterBenchRule[] = {
+    "permit out ip from any to assigned",
+    "permit out 17 from 10.60.0.0/16 to 60.60.0.1 2152",
+    "permit out 6 from 8.8.8.8/32 80,443 to assigned 1000-2000",
+    "permit in ip from 60.60.0.1 to 10.0.0.0/8",
+};
+
+// SDF filter compile per PDR install, regcomp every time as before vs tokenizer
+Status TestIpFilter_3() {
+    int numOfBenchRule = sizeof(ipFilterBenchRule) / sizeof(char *);
+    IPFilterRule rule;
+    regex_t preg;
+
+    utime_t start = TimeNow();
+    for (int i = 0; i < IPFILTER_BENCH_NUM_OF_REGEX; i++) {
+        UTLT_Assert(!regcomp(&preg, IPFILTER_TEST_REGEX, REG_EXTENDED | REG_ICASE), return STATUS_ERROR,
+            "Reference regex compile failed");
+        UTLT_Assert(IpFilterTestRefParse(&preg, &rule, ipFilterBenchRule[i % numOfBenchRule]) == STATUS_OK,
+            regfree(&preg); return STATUS_ERROR, "Regex parse failed");
+        regfree(&preg);
+    }
+    utime_t regexTime = TimeNow() - start + 1;
+
+    start = TimeNow();
+    for (int i = 0; i < IPFILTER_BENCH_NUM_OF_PARSE; i++) {
+        const char *str = ipFilterBenchRule[i % numOfBenchRule];
+        UTLT_Assert(IPFilterRuleParse(&rule, str, strlen(str)) == STATUS_OK, return STATUS_ERROR,
+            "Tokenizer parse failed");
+    }
+    utime_t parseTime = TimeNow() - start + 1;
+
+    UTLT_Info("[IPFilter benchmark] SDF filter per PDR install: regcomp %lu PDR/s, tokenizer %lu PDR/s",
+        (uint64_t) IPFILTER_BENCH_NUM_OF_REGEX * USEC_PER_SEC / regexTime,
+        (uint64_t) IPFILTER_BENCH_NUM_OF_PARSE * USEC_PER_SEC / parseTime);
+
+    return STATUS_OK;
+}
+
+Status IpFilterTest(void *data) {
+    Status status;
+
+    status = TestIpFilter_1();
+    UTLT_Assert(status == STATUS_OK, return status, "TestIpFilter_1 fail");
+
+    status = TestIpFilter_2();
+    UTLT_Assert(status == STATUS_OK, return status, "TestIpFilter_2 fail");
+
+    status = TestIpFilter_3();
+    UTLT_Assert(status == STATUS_OK, return status, "TestIpFilter_3 fail");
+
+    return STATUS_OK;
+}
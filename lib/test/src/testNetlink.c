@@ -0,0 +1,276 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/genetlink.h>
+
+#include "test_utlt.h"
+#include "utlt_debug.h"
+#include "utlt_netlink.h"
+#include "utlt_time.h"
+
+#define NETLINK_TEST_GENL_ID            0x20
+#define NETLINK_TEST_RULE_SIZE          256
+#define NETLINK_TEST_RULE_PER_REQUEST   5
+#define NETLINK_BENCH_NUM_OF_REQUEST    2000
+
+/*
+ * Stub of a genl family: every request of a record is answered by its own
+ * ACK like the kernel does, the seq which is a multiple of failEvery is NACKed
+ */
+typedef struct {
+    int fd;
+    uint32_t failEvery;
+    int numOfRecord;
+    int numOfMsg;
+} NetlinkTestStub;
+
+static void *NetlinkTestStubThread(void *data) {
+    NetlinkTestStub *stub = data;
+    static __thread char buf[SIZE_OF_NETLINK_BATCH] __attribute__((aligned(NLMSG_ALIGNTO)));
+
+    while (1) {
+        ssize_t len = recv(stub->fd, buf, sizeof(buf), 0);
+        if (len <= 0)
+            break;
+        stub->numOfRecord++;
+
+        int remain = len;
+        for (struct nlmsghdr *nlh = (struct nlmsghdr *) buf; NLMSG_OK(nlh, remain); nlh = NLMSG_NEXT(nlh, remain)) {
+            struct {
+                struct nlmsghdr hdr;
+                struct nlmsgerr err;
+            } ack;
+
+            memset(&ack, 0, sizeof(ack));
+            ack.hdr.nlmsg_len = NLMSG_LENGTH(sizeof(struct nlmsgerr));
+            ack.hdr.nlmsg_type = NLMSG_ERROR;
+            ack.hdr.nlmsg_seq = nlh->nlmsg_seq;
+            ack.err.error = (stub->failEvery && !(nlh->nlmsg_seq % stub->failEvery) ? -EEXIST : 0);
+            ack.err.msg = *nlh;
+
+            stub->numOfMsg++;
+            if (send(stub->fd, &ack, ack.hdr.nlmsg_len, 0) < 0)
+                return NULL;
+        }
+    }
+
+    return NULL;
+}
+
+static Status NetlinkTestStubStart(NetlinkTestStub *stub, pthread_t *tid, int *fd, uint32_t failEvery) {
+    int sv[2];
+
+    UTLT_Assert(socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sv) == 0, return STATUS_ERROR,
+        "socketpair fail: %s", strerror(errno));
+
+    memset(stub, 0, sizeof(NetlinkTestStub));
+    stub->fd = sv[1];
+    stub->failEvery = failEvery;
+    *fd = sv[0];
+
+    UTLT_Assert(pthread_create(tid, NULL, NetlinkTestStubThread, stub) == 0, return STATUS_ERROR,
+        "pthread_create fail");
+
+    return STATUS_OK;
+}
+
+static void NetlinkTestStubStop(NetlinkTestStub *stub, pthread_t tid, int fd) {
+    shutdown(fd, SHUT_RDWR);
+    pthread_join(tid, NULL);
+    close(fd);
+    close(stub->fd);
+}
+
+// A genl request of @size bytes, about the size of a PDR with its PDI
+static struct nlmsghdr *NetlinkTestRuleBuild(char *buf, int size) {
+    struct nlmsghdr *nlh = (struct nlmsghdr *) buf;
+    struct genlmsghdr *genl = NLMSG_DATA(nlh);
+
+    memset(buf, 0, size);
+    nlh->nlmsg_len = size;
+    nlh->nlmsg_type = NETLINK_TEST_GENL_ID;
+    nlh->nlmsg_flags = NLM_F_REQUEST | NLM_F_EXCL;
+    genl->cmd = 1;
+    genl->version = 0;
+
+    return nlh;
+}
+
+// Send one message and wait for its ACK, as each rule operation did on its own socket
+static Status NetlinkTestTalk(int fd, char *buf, uint32_t seq) {
+    struct nlmsghdr *nlh = (struct nlmsghdr *) buf;
+    char ack[NLMSG_SPACE(sizeof(struct nlmsgerr)) + 1024];
+
+    nlh->nlmsg_seq = seq;
+    nlh->nlmsg_flags |= NLM_F_ACK;
+    if (send(fd, buf, nlh->nlmsg_len, 0) != nlh->nlmsg_len)
+        return STATUS_ERROR;
+
+    while (1) {
+        ssize_t len = recv(fd, ack, sizeof(ack), 0);
+        if (len <= 0)
+            return STATUS_ERROR;
+
+        int remain = len;
+        for (struct nlmsghdr *reply = (struct nlmsghdr *) ack; NLMSG_OK(reply, remain); reply = NLMSG_NEXT(reply, remain))
+            if (reply->nlmsg_type == NLMSG_ERROR && reply->nlmsg_seq == seq)
+                return (((struct nlmsgerr *) NLMSG_DATA(reply))->error ? STATUS_ERROR : STATUS_OK);
+    }
+}
+
+/*
+ * What NetlinkSockOpen() costs on each rule: a NETLINK_GENERIC socket and a
+ * CTRL_CMD_GETFAMILY round trip to the kernel, "nlctrl" always exists
+ */
+static Status NetlinkTestGenlOpenClose(uint32_t seq) {
+    struct sockaddr_nl addr = {.nl_family = AF_NETLINK};
+    char buf[NLMSG_SPACE(GENL_HDRLEN + NLA_HDRLEN + 16)] __attribute__((aligned(NLMSG_ALIGNTO)));
+    Status status = STATUS_ERROR;
+
+    int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_GENERIC);
+    if (fd < 0)
+        return STATUS_ERROR;
+    if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0)
+        goto CLOSE;
+
+    memset(buf, 0, sizeof(buf));
+    struct nlmsghdr *nlh = (struct nlmsghdr *) buf;
+    struct genlmsghdr *genl = NLMSG_DATA(nlh);
+    struct nlattr *attr = (struct nlattr *) ((char *) genl + GENL_HDRLEN);
+
+    nlh->nlmsg_type = GENL_ID_CTRL;
+    nlh->nlmsg_flags = NLM_F_REQUEST;
+    genl->cmd = CTRL_CMD_GETFAMILY;
+    genl->version = 1;
+    attr->nla_type = CTRL_ATTR_FAMILY_NAME;
+    attr->nla_len = NLA_HDRLEN + sizeof("nlctrl");
+    strcpy((char *) attr + NLA_HDRLEN, "nlctrl");
+    nlh->nlmsg_len = NLMSG_LENGTH(GENL_HDRLEN + NLA_ALIGN(attr->nla_len));
+
+    status = NetlinkTestTalk(fd, buf, seq);
+
+CLOSE:
+    close(fd);
+    return status;
+}
+
+// ACK and NACK of one batch, batch larger than the buffer and socket error
+Status TestNetlink_1() {
+    static NetlinkBatch batch;
+    NetlinkTestStub stub;
+    pthread_t tid;
+    int fd;
+
+    UTLT_Assert(NetlinkTestStubStart(&stub, &tid, &fd, 4) == STATUS_OK, return STATUS_ERROR, "");
+    UTLT_Assert(NetlinkBatchInit(&batch, fd, 1) == STATUS_OK, return STATUS_ERROR, "");
+
+    // Seq 1 to 10, 4 and 8 are NACKed
+    for (int i = 0; i < 10; i++) {
+        struct nlmsghdr *nlh = NetlinkBatchMsgBuf(&batch);
+        UTLT_Assert(nlh, return STATUS_ERROR, "NetlinkBatchMsgBuf fail");
+        UTLT_Assert(NetlinkBatchMsgPut(&batch, NetlinkTestRuleBuild((char *) nlh, NETLINK_TEST_RULE_SIZE)) == STATUS_OK,
+            return STATUS_ERROR, "NetlinkBatchMsgPut fail");
+    }
+    UTLT_Assert(NetlinkBatchNumOfMsg(&batch) == 10, return STATUS_ERROR, "");
+    UTLT_Assert(NetlinkBatchFlush(&batch) == STATUS_ERROR, return STATUS_ERROR, "NACK should fail the batch");
+    UTLT_Assert(batch.numOfFail == 2 && batch.error == EEXIST && !batch.sockError, return STATUS_ERROR,
+        "numOfFail %d, error %d, sockError %d", batch.numOfFail, batch.error, batch.sockError);
+    UTLT_Assert(stub.numOfRecord == 1 && stub.numOfMsg == 10, return STATUS_ERROR,
+        "10 messages should be sent at once, got %d records", stub.numOfRecord);
+
+    // Nothing queued
+    UTLT_Assert(NetlinkBatchFlush(&batch) == STATUS_OK, return STATUS_ERROR, "Empty batch should be OK");
+    UTLT_Assert(stub.numOfRecord == 1, return STATUS_ERROR, "Empty batch should not be sent");
+
+    // 200 messages do not fit into one buffer, NACKs of the earlier flushes are reported at the end
+    stub.numOfRecord = stub.numOfMsg = 0;
+    for (int i = 0; i < 200; i++) {
+        struct nlmsghdr *nlh = NetlinkBatchMsgBuf(&batch);
+        UTLT_Assert(nlh, return STATUS_ERROR, "NetlinkBatchMsgBuf fail");
+        NetlinkBatchMsgPut(&batch, NetlinkTestRuleBuild((char *) nlh, 1000));
+    }
+    UTLT_Assert(NetlinkBatchFlush(&batch) == STATUS_ERROR, return STATUS_ERROR, "");
+    UTLT_Assert(batch.numOfFail == 50, return STATUS_ERROR, "numOfFail %d should be 50", batch.numOfFail);
+    UTLT_Assert(stub.numOfMsg == 200 && stub.numOfRecord > 1 && stub.numOfRecord < 200, return STATUS_ERROR,
+        "%d messages in %d records", stub.numOfMsg, stub.numOfRecord);
+
+    // All ACKed
+    stub.failEvery = 0;
+    for (int i = 0; i < 3; i++)
+        NetlinkBatchMsgPut(&batch, NetlinkTestRuleBuild((char *) NetlinkBatchMsgBuf(&batch), 64));
+    UTLT_Assert(NetlinkBatchFlush(&batch) == STATUS_OK, return STATUS_ERROR, "All messages should be ACKed");
+    UTLT_Assert(!batch.numOfFail && !batch.error, return STATUS_ERROR, "");
+
+    // The peer is gone
+    NetlinkTestStubStop(&stub, tid, fd);
+    UTLT_Assert(NetlinkBatchInit(&batch, fd, 1) == STATUS_OK, return STATUS_ERROR, "");
+    NetlinkBatchMsgPut(&batch, NetlinkTestRuleBuild((char *) NetlinkBatchMsgBuf(&batch), 64));
+    UTLT_Assert(NetlinkBatchFlush(&batch) == STATUS_ERROR && batch.sockError, return STATUS_ERROR,
+        "Socket error should be reported");
+    UTLT_Assert(!NetlinkBatchMsgBuf(&batch), return STATUS_ERROR, "Socket error should be kept");
+    NetlinkBatchTerm(&batch);
+
+    return STATUS_OK;
+}
+
+// Rule install per second: socket per rule as before, and one batch per PFCP request on a kept socket
+Status TestNetlink_2() {
+    static NetlinkBatch batch;
+    static char buf[NETLINK_TEST_RULE_SIZE] __attribute__((aligned(NLMSG_ALIGNTO)));
+    int numOfRule = NETLINK_BENCH_NUM_OF_REQUEST * NETLINK_TEST_RULE_PER_REQUEST;
+    NetlinkTestStub stub;
+    pthread_t tid;
+    uint32_t seq = 1;
+    int fd;
+
+    UTLT_Assert(NetlinkTestStubStart(&stub, &tid, &fd, 0) == STATUS_OK, return STATUS_ERROR, "");
+
+    int hasGenl = (NetlinkTestGenlOpenClose(seq++) == STATUS_OK);
+    if (!hasGenl)
+        UTLT_Warning("NETLINK_GENERIC is not available, socket per rule only counts the stub round trip");
+
+    utime_t start = TimeNow();
+    for (int i = 0; i < numOfRule; i++) {
+        if (hasGenl)
+            UTLT_Assert(NetlinkTestGenlOpenClose(seq++) == STATUS_OK, return STATUS_ERROR, "Family lookup fail");
+        NetlinkTestRuleBuild(buf, NETLINK_TEST_RULE_SIZE);
+        UTLT_Assert(NetlinkTestTalk(fd, buf, seq++) == STATUS_OK, return STATUS_ERROR, "Rule round trip fail");
+    }
+    utime_t perRuleTime = TimeNow() - start + 1;
+
+    UTLT_Assert(NetlinkBatchInit(&batch, fd, seq) == STATUS_OK, return STATUS_ERROR, "");
+    start = TimeNow();
+    for (int i = 0; i < NETLINK_BENCH_NUM_OF_REQUEST; i++) {
+        for (int j = 0; j < NETLINK_TEST_RULE_PER_REQUEST; j++)
+            NetlinkBatchMsgPut(&batch, NetlinkTestRuleBuild((char *) NetlinkBatchMsgBuf(&batch), NETLINK_TEST_RULE_SIZE));
+        UTLT_Assert(NetlinkBatchFlush(&batch) == STATUS_OK, return STATUS_ERROR, "Batch fail");
+    }
+    utime_t batchTime = TimeNow() - start + 1;
+    NetlinkBatchTerm(&batch);
+
+    UTLT_Info("[Netlink benchmark] %d rules in %d requests: socket per rule %lu rule/s, batch per request %lu rule/s",
+        numOfRule, NETLINK_BENCH_NUM_OF_REQUEST,
+        (uint64_t) numOfRule * USEC_PER_SEC / perRuleTime,
+        (uint64_t) numOfRule * USEC_PER_SEC / batchTime);
+
+    NetlinkTestStubStop(&stub, tid, fd);
+
+    return STATUS_OK;
+}
+
+Status NetlinkTest(void *data) {
+    Status status;
+
+    status = TestNetlink_1();
+    UTLT_Assert(status == STATUS_OK, return status, "TestNetlink_1 fail");
+
+    status = TestNetlink_2();
+    UTLT_Assert(status == STATUS_OK, return status, "TestNetlink_2 fail");
+
+    return STATUS_OK;
+}
@@ -9,6 +9,7 @@
 #include "utlt_debug.h"
 #include "utlt_buff.h"
 #include "utlt_network.h"
+#include "utlt_netheader.h"
 
 char tcpServerIP[] = "127.0.0.10";
 int tcpServerPort = 12345;
@@ -207,6 +208,146 @@ Status TestUDP_1() {
     return STATUS_OK;
 }
 
+#define NUM_OF_REUSEPORT_SOCK 4
+#define NUM_OF_REUSEPORT_TEID 16
+const char reusePortIP[] = "127.0.0.128";
+int reusePortPort = 12346;
+
+static Status TestReusePortSend(Sock *client, uint8_t type, uint32_t teid) {
+    uint8_t gtp[GTPV1_HEADER_LEN + 4] = {0x30, type, 0, 4};
+    *((uint32_t *) (gtp + 4)) = htonl(teid);
+
+    return UdpSendTo(client, gtp, sizeof(gtp));
+}
+
+// Return the index of socket which receives the GTP-U, or -1 if no one does
+static int TestReusePortRecv(Sock *sock[], uint32_t *teid) {
+    uint8_t buffer[0x40];
+
+    usleep(1000);
+    for (int i = 0; i < NUM_OF_REUSEPORT_SOCK; i++) {
+        if (recv(sock[i]->fd, buffer, sizeof(buffer), MSG_DONTWAIT) >= GTPV1_HEADER_LEN) {
+            *teid = ntohl(*((uint32_t *) (buffer + 4)));
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+Status TestUDPReusePort_1() {
+    Sock *sock[NUM_OF_REUSEPORT_SOCK];
+    int owner[NUM_OF_REUSEPORT_TEID], used = 0;
+    uint32_t teid;
+
+    for (int i = 0; i < NUM_OF_REUSEPORT_SOCK; i++) {
+        sock[i] = UdpReusePortServerCreate(AF_INET, reusePortIP, reusePortPort);
+        UTLT_Assert(sock[i], return STATUS_ERROR, "UdpReusePortServerCreate[%d] fail", i);
+    }
+    UTLT_Assert(UdpReusePortSteerByTeid(sock[0], NUM_OF_REUSEPORT_SOCK, -1) == STATUS_OK,
+        return STATUS_ERROR, "UdpReusePortSteerByTeid fail");
+
+    Sock *client = UdpClientCreate(AF_INET, reusePortIP, reusePortPort);
+    UTLT_Assert(client, return STATUS_ERROR, "UdpClientCreate fail");
+
+    // TEIDs allocated in sequence shall be spread, and a TEID never moves
+    for (int round = 0; round < 2; round++) {
+        for (int i = 0; i < NUM_OF_REUSEPORT_TEID; i++) {
+            UTLT_Assert(TestReusePortSend(client, GTPV1_T_PDU, i * 4 + 1) == STATUS_OK,
+                return STATUS_ERROR, "UdpSendTo fail");
+
+            int idx = TestReusePortRecv(sock, &teid);
+            UTLT_Assert(idx >= 0 && teid == i * 4 + 1, return STATUS_ERROR, "T-PDU of TEID %u is lost", i * 4 + 1);
+            if (!round) {
+                owner[i] = idx;
+                used |= 1 << idx;
+            }
+            UTLT_Assert(owner[i] == idx, return STATUS_ERROR,
+                "TEID %u moves from socket %d to %d", teid, owner[i], idx);
+        }
+    }
+    UTLT_Assert(__builtin_popcount(used) > 1, return STATUS_ERROR, "All TEIDs go to one socket");
+
+    // Socket 0 takes all T-PDUs, and the others take echo
+    UTLT_Assert(UdpReusePortSteerByTeid(sock[0], NUM_OF_REUSEPORT_SOCK, 0) == STATUS_OK,
+        return STATUS_ERROR, "UdpReusePortSteerByTeid fail");
+    for (int i = 0; i < NUM_OF_REUSEPORT_TEID; i++) {
+        UTLT_Assert(TestReusePortSend(client, GTPV1_T_PDU, i * 4 + 1) == STATUS_OK,
+            return STATUS_ERROR, "UdpSendTo fail");
+        UTLT_Assert(TestReusePortRecv(sock, &teid) == 0, return STATUS_ERROR,
+            "T-PDU of TEID %u is not on socket 0", i * 4 + 1);
+    }
+    UTLT_Assert(TestReusePortSend(client, GTPV1_ECHO_REQUEST, 0) == STATUS_OK,
+        return STATUS_ERROR, "UdpSendTo fail");
+    UTLT_Assert(TestReusePortRecv(sock, &teid) > 0, return STATUS_ERROR, "Echo is not steered");
+
+    UdpFree(client);
+    for (int i = 0; i < NUM_OF_REUSEPORT_SOCK; i++)
+        UdpFree(sock[i]);
+
+    return STATUS_OK;
+}
+
+#define NUM_OF_BATCH_DATAGRAM 100
+const char batchIP[] = "127.0.0.129";
+int batchPort = 12348;
+
+Status TestUDPBatch_1() {
+    Sock *server = UdpServerCreate(AF_INET, batchIP, batchPort);
+    UTLT_Assert(server, return STATUS_ERROR, "UdpServerCreate fail");
+    Sock *client = UdpServerCreate(AF_INET, batchIP, batchPort + 1);
+    UTLT_Assert(client, return STATUS_ERROR, "UdpServerCreate fail");
+    UTLT_Assert(UdpSockSetAddr(&client->remoteAddr, AF_INET, batchIP, batchPort) == STATUS_OK,
+        return STATUS_ERROR, "UdpSockSetAddr fail");
+
+    UdpBatch *txBatch = UdpBatchAlloc(MAX_NUM_OF_UDP_BATCH, 0);
+    UTLT_Assert(txBatch, return STATUS_ERROR, "UdpBatchAlloc fail");
+    UdpBatch *rxBatch = UdpBatchAlloc(MAX_NUM_OF_UDP_BATCH / 2, 0x40);
+    UTLT_Assert(rxBatch, return STATUS_ERROR, "UdpBatchAlloc fail");
+
+    // Header and payload are sent in one datagram, and the batch is sent when it is full
+    uint32_t hdr[NUM_OF_BATCH_DATAGRAM];
+    const char payload[] = "batch";
+    int sent = 0;
+    for (int i = 0; i < NUM_OF_BATCH_DATAGRAM; i++) {
+        hdr[i] = htonl(i);
+        UTLT_Assert(UdpBatchAdd(txBatch, &hdr[i], sizeof(hdr[i]), payload, sizeof(payload),
+            &client->remoteAddr) == STATUS_OK, return STATUS_ERROR, "UdpBatchAdd fail");
+        if (UdpBatchFull(txBatch) || i == NUM_OF_BATCH_DATAGRAM - 1)
+            sent += UdpBatchSend(client, txBatch);
+    }
+    UTLT_Assert(sent == NUM_OF_BATCH_DATAGRAM && UdpBatchCount(txBatch) == 0, return STATUS_ERROR,
+        "UdpBatchSend sent %d of %d datagrams", sent, NUM_OF_BATCH_DATAGRAM);
+
+    // Datagrams are received in order, no more than the batch each time
+    SockAddr from;
+    int received = 0, num, len;
+    uint8_t *data;
+    while ((num = UdpBatchRecv(server, rxBatch)) > 0) {
+        UTLT_Assert(num <= MAX_NUM_OF_UDP_BATCH / 2, return STATUS_ERROR, "Batch overflow: %d", num);
+        for (int i = 0; i < num; i++, received++) {
+            data = UdpBatchGet(rxBatch, i, &len, &from);
+            UTLT_Assert(len == sizeof(uint32_t) + sizeof(payload), return STATUS_ERROR,
+                "Datagram %d length %d is wrong", received, len);
+            UTLT_Assert(ntohl(*((uint32_t *) data)) == received, return STATUS_ERROR,
+                "Datagram %d is out of order", received);
+            UTLT_Assert(!memcmp(data + sizeof(uint32_t), payload, sizeof(payload)), return STATUS_ERROR,
+                "Payload of datagram %d is wrong", received);
+            UTLT_Assert(GetPort(&from) == batchPort + 1, return STATUS_ERROR,
+                "Sender port %d is wrong", GetPort(&from));
+        }
+    }
+    UTLT_Assert(num == 0 && received == NUM_OF_BATCH_DATAGRAM, return STATUS_ERROR,
+        "UdpBatchRecv received %d of %d datagrams", received, NUM_OF_BATCH_DATAGRAM);
+
+    UTLT_Assert(UdpBatchFree(txBatch) == STATUS_OK, return STATUS_ERROR, "UdpBatchFree fail");
+    UTLT_Assert(UdpBatchFree(rxBatch) == STATUS_OK, return STATUS_ERROR, "UdpBatchFree fail");
+    UdpFree(client);
+    UdpFree(server);
+
+    return STATUS_OK;
+}
+
 #define NUM_OF_SOCK 5
 const char epollIP[] = "127.0.0.87";
 int epollPort = 10000;
@@ -401,6 +542,12 @@ Status NetworkTest(void *data) {
     status = TestUDP_1();
     UTLT_Assert(status == STATUS_OK, return status, "TestUDP_1 fail");
     
+    status = TestUDPReusePort_1();
+    UTLT_Assert(status == STATUS_OK, return status, "TestUDPReusePort_1 fail");
+
+    status = TestUDPBatch_1();
+    UTLT_Assert(status == STATUS_OK, return status, "TestUDPBatch_1 fail");
+
     status = TestEpoll_1();
     UTLT_Assert(status == STATUS_OK, return status, "TestEpoll_1 fail");
 
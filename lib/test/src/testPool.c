@@ -12,8 +12,8 @@
 
 typedef uint8_t poolCluster[MAX_NUM_OF_SIZE];
 
-PoolDeclare(testPool, poolCluster, MAX_NUM_OF_CAP);
-PoolDeclare(smallPool, poolCluster, SMALL_NUM_OF_CAP);
+PoolDeclare(testPool, poolCluster);
+PoolDeclare(smallPool, poolCluster);
 
 Status TestPool_1() {
     PoolInit(&testPool, MAX_NUM_OF_CAP);
@@ -37,9 +37,11 @@ Status TestPool_1() {
 //    printf("[Testing] After alloc, get pool Size = %d, Cap = %d\n", PoolSize(&testPool), PoolCap(&testPool));
     UTLT_Assert(PoolSize(&testPool) == MAX_NUM_OF_CAP, return STATUS_ERROR, "The size of pool is %d, not %d", MAX_NUM_OF_CAP, PoolSize(&testPool));
 
-//    printf("[Testing] Free address is %p\n", testPool.queueAvail[MAX_NUM_OF_CAP]);
-    UTLT_Assert(testPool.queueAvail[MAX_NUM_OF_CAP] == testPool.queueAvail[0], return STATUS_ERROR, 
-        "Free error memory address, the address should be %p, not %p", testPool.queueAvail[0], testPool.queueAvail[MAX_NUM_OF_CAP]);
+    poolCluster *freeBuf = poolBuf;
+    PoolAlloc(&testPool, poolBuf);
+    UTLT_Assert(poolBuf == freeBuf, return STATUS_ERROR, 
+        "Free error memory address, the address should be %p, not %p", freeBuf, poolBuf);
+    PoolFree(&testPool, poolBuf);
 
     PoolTerminate(&testPool);
 
@@ -0,0 +1,343 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "test_utlt.h"
+#include "utlt_debug.h"
+#include "utlt_list.h"
+#include "utlt_rcu.h"
+#include "utlt_time.h"
+
+#define RCU_TEST_NODE_MAGIC     0x5a5a5a5a
+#define RCU_TEST_NUM_OF_BUCKET  64
+#define RCU_TEST_NUM_OF_KEY     1024
+#define RCU_TEST_NUM_OF_READER  4
+#define RCU_TEST_DURATION_USEC  TimeMsecToUsec(500)
+#define RCU_TEST_DEFER_BATCH    64
+
+typedef struct {
+    ListHead node;
+    uint32_t magic;
+    uint32_t key;
+} RcuTestNode;
+
+static ListHead bucket[RCU_TEST_NUM_OF_BUCKET];
+static pthread_mutex_t bucketLock;
+
+static int useRcu;              // 0: mutex, 1: RcuSynchronize(), 2: RcuDefer()
+static volatile int benchStop;
+static volatile int readerCorrupted;
+
+static RcuTestNode *RcuTestNodeAlloc(uint32_t key) {
+    RcuTestNode *node = calloc(1, sizeof(RcuTestNode));
+    UTLT_Assert(node, return NULL, "RcuTestNode alloc failed");
+
+    ListHeadInit(&node->node);
+    node->magic = RCU_TEST_NODE_MAGIC;
+    node->key = key;
+
+    return node;
+}
+
+static void RcuTestNodeFree(RcuTestNode *node) {
+    // Poison it, so that a reader still holding it will notice
+    memset(node, 0, sizeof(RcuTestNode));
+    free(node);
+}
+
+static void RcuTestNodeFreeDeferred(void *node) {
+    RcuTestNodeFree(node);
+}
+
+static void RcuTestInsert(RcuTestNode *node) {
+    pthread_mutex_lock(&bucketLock);
+    if (useRcu)
+        ListInsertRcu(node, &bucket[node->key % RCU_TEST_NUM_OF_BUCKET]);
+    else
+        ListInsert(node, &bucket[node->key % RCU_TEST_NUM_OF_BUCKET]);
+    pthread_mutex_unlock(&bucketLock);
+}
+
+static void RcuTestRemove(RcuTestNode *node) {
+    pthread_mutex_lock(&bucketLock);
+    if (useRcu)
+        ListRemoveRcu(node);
+    else
+        ListRemove(node);
+    pthread_mutex_unlock(&bucketLock);
+
+    if (useRcu == 1)
+        RcuSynchronize();
+}
+
+static int RcuTestLookup(uint32_t key) {
+    RcuTestNode *node, *nextNode = NULL;
+    int found = 0;
+
+    if (useRcu) {
+        RcuReadLock();
+        ListForEachRcu(node, &bucket[key % RCU_TEST_NUM_OF_BUCKET]) {
+            if (node->magic != RCU_TEST_NODE_MAGIC)
+                readerCorrupted = 1;
+            if (node->key == key) {
+                found = 1;
+                break;
+            }
+        }
+        RcuReadUnlock();
+    } else {
+        pthread_mutex_lock(&bucketLock);
+        ListForEachSafe(node, nextNode, &bucket[key % RCU_TEST_NUM_OF_BUCKET]) {
+            if (node->key == key) {
+                found = 1;
+                break;
+            }
+        }
+        pthread_mutex_unlock(&bucketLock);
+    }
+
+    return found;
+}
+
+static void *RcuTestReader(void *data) {
+    uint64_t *lookupCnt = data;
+    uint32_t key = 0;
+
+    while (!benchStop) {
+        RcuTestLookup(key);
+        key = (key + 7) % RCU_TEST_NUM_OF_KEY;
+        (*lookupCnt)++;
+    }
+
+    RcuThreadOffline();
+    return NULL;
+}
+
+static void *RcuTestWriter(void *data) {
+    uint64_t *churnCnt = data;
+    uint32_t key = 0;
+
+    while (!benchStop) {
+        RcuTestNode *node = RcuTestNodeAlloc(key);
+        if (!node)
+            break;
+        RcuTestInsert(node);
+        RcuTestRemove(node);
+        if (useRcu == 2) {
+            RcuDefer(RcuTestNodeFreeDeferred, node);
+            if (*churnCnt % RCU_TEST_DEFER_BATCH == 0)
+                RcuDeferPoll();
+        } else {
+            RcuTestNodeFree(node);
+        }
+
+        key = (key + 1) % RCU_TEST_NUM_OF_KEY;
+        (*churnCnt)++;
+    }
+
+    RcuThreadOffline();
+    return NULL;
+}
+
+static void RcuTestTableInit() {
+    for (int i = 0; i < RCU_TEST_NUM_OF_BUCKET; i++)
+        ListHeadInit(&bucket[i]);
+    pthread_mutex_init(&bucketLock, 0);
+}
+
+static void RcuTestTableFinal() {
+    RcuTestNode *node, *nextNode = NULL;
+    for (int i = 0; i < RCU_TEST_NUM_OF_BUCKET; i++) {
+        ListForEachSafe(node, nextNode, &bucket[i]) {
+            ListRemove(node);
+            RcuTestNodeFree(node);
+        }
+    }
+    pthread_mutex_destroy(&bucketLock);
+}
+
+// Lookup sees inserted node and misses removed node
+Status TestRcu_1() {
+    useRcu = 1;
+    RcuTestTableInit();
+
+    RcuTestNode *node[RCU_TEST_NUM_OF_KEY];
+    for (int i = 0; i < RCU_TEST_NUM_OF_KEY; i++) {
+        node[i] = RcuTestNodeAlloc(i);
+        UTLT_Assert(node[i], return STATUS_ERROR, "");
+        RcuTestInsert(node[i]);
+    }
+
+    for (int i = 0; i < RCU_TEST_NUM_OF_KEY; i++)
+        UTLT_Assert(RcuTestLookup(i), return STATUS_ERROR, "Key[%d] should be found", i);
+
+    uint64_t gracePeriod = RcuGracePeriodCount();
+    for (int i = 0; i < RCU_TEST_NUM_OF_KEY; i += 2) {
+        RcuTestRemove(node[i]);
+        ListHeadInit(&node[i]->node);
+        RcuTestNodeFree(node[i]);
+    }
+    UTLT_Assert(RcuGracePeriodCount() - gracePeriod == RCU_TEST_NUM_OF_KEY / 2, return STATUS_ERROR,
+        "Each removal should wait for one grace period");
+
+    for (int i = 0; i < RCU_TEST_NUM_OF_KEY; i++)
+        UTLT_Assert(RcuTestLookup(i) == (i % 2), return STATUS_ERROR, "Key[%d] lookup result error", i);
+
+    // Nested read-side section
+    RcuReadLock();
+    RcuReadLock();
+    UTLT_Assert(RcuTestLookup(1), return STATUS_ERROR, "");
+    RcuReadUnlock();
+    RcuReadUnlock();
+
+    RcuTestTableFinal();
+    RcuThreadOffline();
+
+    return STATUS_OK;
+}
+
+static Status RcuTestContention(int rcu, uint64_t *lookupPerSec, uint64_t *churnPerSec) {
+    pthread_t reader[RCU_TEST_NUM_OF_READER], writer;
+    uint64_t lookupCnt[RCU_TEST_NUM_OF_READER], churnCnt = 0;
+
+    useRcu = rcu;
+    benchStop = 0;
+    readerCorrupted = 0;
+    memset(lookupCnt, 0, sizeof(lookupCnt));
+    RcuTestTableInit();
+
+    // Half of keys are always in the table, the writer churns the others
+    for (int i = 1; i < RCU_TEST_NUM_OF_KEY; i += 2) {
+        RcuTestNode *node = RcuTestNodeAlloc(i);
+        UTLT_Assert(node, return STATUS_ERROR, "");
+        RcuTestInsert(node);
+    }
+
+    for (int i = 0; i < RCU_TEST_NUM_OF_READER; i++)
+        UTLT_Assert(pthread_create(&reader[i], NULL, RcuTestReader, &lookupCnt[i]) == 0,
+            return STATUS_ERROR, "Reader thread create failed");
+    UTLT_Assert(pthread_create(&writer, NULL, RcuTestWriter, &churnCnt) == 0,
+        return STATUS_ERROR, "Writer thread create failed");
+
+    utime_t start = TimeNow();
+    while (TimeNow() - start < RCU_TEST_DURATION_USEC)
+        usleep(10000);
+    benchStop = 1;
+    utime_t elapsed = TimeNow() - start;
+
+    for (int i = 0; i < RCU_TEST_NUM_OF_READER; i++)
+        pthread_join(reader[i], NULL);
+    pthread_join(writer, NULL);
+
+    RcuTestTableFinal();
+    UTLT_Assert(!readerCorrupted, return STATUS_ERROR, "Reader walked on a freed node");
+
+    uint64_t totalLookup = 0;
+    for (int i = 0; i < RCU_TEST_NUM_OF_READER; i++)
+        totalLookup += lookupCnt[i];
+
+    *lookupPerSec = totalLookup * USEC_PER_SEC / elapsed;
+    *churnPerSec = churnCnt * USEC_PER_SEC / elapsed;
+
+    return STATUS_OK;
+}
+
+// Rule churn and lookups at the same time, mutex protected list vs RCU
+Status TestRcu_2() {
+    uint64_t mutexLookup, mutexChurn, rcuLookup, rcuChurn, deferLookup, deferChurn;
+
+    UTLT_Assert(RcuTestContention(0, &mutexLookup, &mutexChurn) == STATUS_OK, return STATUS_ERROR,
+        "Mutex contention benchmark failed");
+    UTLT_Assert(RcuTestContention(1, &rcuLookup, &rcuChurn) == STATUS_OK, return STATUS_ERROR,
+        "RCU contention benchmark failed");
+    UTLT_Assert(RcuTestContention(2, &deferLookup, &deferChurn) == STATUS_OK, return STATUS_ERROR,
+        "RCU defer contention benchmark failed");
+
+    UTLT_Info("[RCU benchmark] %d readers + 1 writer, mutex: %lu lookup/s, %lu churn/s",
+        RCU_TEST_NUM_OF_READER, mutexLookup, mutexChurn);
+    UTLT_Info("[RCU benchmark] %d readers + 1 writer, RCU: %lu lookup/s, %lu churn/s",
+        RCU_TEST_NUM_OF_READER, rcuLookup, rcuChurn);
+    UTLT_Info("[RCU benchmark] %d readers + 1 writer, RCU defer: %lu lookup/s, %lu churn/s",
+        RCU_TEST_NUM_OF_READER, deferLookup, deferChurn);
+
+    return STATUS_OK;
+}
+
+static volatile int deferReaderState;   // 1: in read-side section, 2: leave it, 3: left
+static int deferCalled;
+
+static void RcuTestDeferCount(void *data) {
+    deferCalled++;
+}
+
+static void *RcuTestDeferReader(void *data) {
+    RcuReadLock();
+    deferReaderState = 1;
+    while (deferReaderState != 2)
+        usleep(1000);
+    RcuReadUnlock();
+    deferReaderState = 3;
+
+    RcuThreadOffline();
+    return NULL;
+}
+
+// Deferred callbacks wait for the reader running at the poll, and a batch takes one grace period
+Status TestRcu_3() {
+    pthread_t reader;
+
+    deferCalled = 0;
+    deferReaderState = 0;
+    UTLT_Assert(pthread_create(&reader, NULL, RcuTestDeferReader, NULL) == 0,
+        return STATUS_ERROR, "Reader thread create failed");
+    while (deferReaderState != 1)
+        usleep(1000);
+
+    RcuDefer(RcuTestDeferCount, NULL);
+    UTLT_Assert(RcuDeferPoll() == 1 && !deferCalled, return STATUS_ERROR,
+        "Callback should wait for the reader");
+    UTLT_Assert(RcuDeferPoll() == 1 && !deferCalled, return STATUS_ERROR,
+        "Callback should still wait for the reader");
+
+    deferReaderState = 2;
+    while (deferReaderState != 3)
+        usleep(1000);
+    pthread_join(reader, NULL);
+
+    UTLT_Assert(RcuDeferPoll() == 0 && deferCalled == 1, return STATUS_ERROR,
+        "Callback should be called after the reader left");
+
+    uint64_t gracePeriod = RcuGracePeriodCount();
+    for (int i = 0; i < RCU_TEST_DEFER_BATCH; i++)
+        RcuDefer(RcuTestDeferCount, NULL);
+    UTLT_Assert(RcuDeferPoll() == 0 && deferCalled == 1 + RCU_TEST_DEFER_BATCH, return STATUS_ERROR,
+        "Callbacks should be called without readers");
+    UTLT_Assert(RcuGracePeriodCount() - gracePeriod == 1, return STATUS_ERROR,
+        "Callbacks of one poll should share one grace period");
+
+    RcuDefer(RcuTestDeferCount, NULL);
+    RcuDeferFlush();
+    UTLT_Assert(deferCalled == 2 + RCU_TEST_DEFER_BATCH, return STATUS_ERROR,
+        "Callback should be called by flush");
+
+    RcuThreadOffline();
+
+    return STATUS_OK;
+}
+
+Status RcuTest(void *data) {
+    Status status;
+
+    status = TestRcu_1();
+    UTLT_Assert(status == STATUS_OK, return status, "TestRcu_1 fail");
+
+    status = TestRcu_2();
+    UTLT_Assert(status == STATUS_OK, return status, "TestRcu_2 fail");
+
+    status = TestRcu_3();
+    UTLT_Assert(status == STATUS_OK, return status, "TestRcu_3 fail");
+
+    return STATUS_OK;
+}
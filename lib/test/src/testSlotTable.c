@@ -0,0 +1,232 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test_utlt.h"
+#include "utlt_debug.h"
+#include "utlt_slottable.h"
+
+#define SLOT_TEST_NUM_OF_OBJ        1024
+#define SLOT_TEST_NUM_OF_GENERATION (1 << 16)
+#define SLOT_TEST_NUM_OF_KEY        1000
+#define SLOT_TEST_NUM_OF_OP         200000
+#define SLOT_TEST_CHECK_INTERVAL    1000
+
+static int obj[SLOT_TEST_NUM_OF_OBJ];
+static uint32_t slotKey[SLOT_TEST_NUM_OF_KEY];
+
+static int SlotTestEqual(uint32_t index, const void *key) {
+    return slotKey[index] == *(const uint32_t *) key;
+}
+
+// Handle layout, set and get
+Status TestSlotTable_1() {
+    SlotTable table;
+    uint64_t handle;
+
+    UTLT_Assert(SlotTableInit(&table, SLOT_TEST_NUM_OF_OBJ) == STATUS_OK, return STATUS_ERROR, "");
+
+    handle = SlotTableSet(&table, 0, 3, &obj[0]);
+    UTLT_Assert(handle == ((3ULL << 48) | 1), return STATUS_ERROR, "Handle 0x%lx is wrong", handle);
+    UTLT_Assert(SlotHandleTag(handle) == 3 && SlotHandleGeneration(handle) == 0 &&
+                SlotHandleIndex(handle) == 0, return STATUS_ERROR, "");
+    UTLT_Assert(SlotTableGet(&table, handle) == &obj[0], return STATUS_ERROR, "");
+
+    // The index takes all 32 low bits, the tag all 16 high bits
+    handle = SlotTableSet(&table, SLOT_TEST_NUM_OF_OBJ - 1, 0xFFFF, &obj[SLOT_TEST_NUM_OF_OBJ - 1]);
+    UTLT_Assert(SlotHandleTag(handle) == 0xFFFF && SlotHandleGeneration(handle) == 0 &&
+                SlotHandleIndex(handle) == SLOT_TEST_NUM_OF_OBJ - 1, return STATUS_ERROR, "");
+    UTLT_Assert(SlotTableGet(&table, handle) == &obj[SLOT_TEST_NUM_OF_OBJ - 1],
+                return STATUS_ERROR, "");
+    UTLT_Assert(SlotHandleBuild(0xFFFF, 0xFFFF, 0xFFFFFFFE) == UINT64_MAX, return STATUS_ERROR, "");
+
+    // The tag is left to the caller
+    UTLT_Assert(SlotTableGet(&table, SlotHandleBuild(7, 0, 0)) == &obj[0], return STATUS_ERROR, "");
+
+    // Taken slot, empty slot and out of range
+    UTLT_Assert(SlotTableSet(&table, 0, 0, &obj[1]) == 0, return STATUS_ERROR, "");
+    UTLT_Assert(SlotTableSet(&table, SLOT_TEST_NUM_OF_OBJ, 0, &obj[1]) == 0, return STATUS_ERROR, "");
+    UTLT_Assert(SlotTableGet(&table, SlotHandleBuild(0, 0, 1)) == NULL, return STATUS_ERROR, "");
+    UTLT_Assert(SlotTableGet(&table, SlotHandleBuild(0, 0, SLOT_TEST_NUM_OF_OBJ)) == NULL,
+                return STATUS_ERROR, "");
+    UTLT_Assert(SlotTableGet(&table, 0) == NULL, return STATUS_ERROR, "");
+
+    UTLT_Assert(SlotTableAt(&table, 0) == &obj[0] && SlotTableAt(&table, 1) == NULL,
+                return STATUS_ERROR, "");
+
+    UTLT_Assert(SlotTableFinal(&table) == STATUS_OK, return STATUS_ERROR, "");
+
+    return STATUS_OK;
+}
+
+// Stale handles are rejected by generation
+Status TestSlotTable_2() {
+    SlotTable table;
+    uint64_t handle, stale;
+
+    UTLT_Assert(SlotTableInit(&table, SLOT_TEST_NUM_OF_OBJ) == STATUS_OK, return STATUS_ERROR, "");
+
+    stale = SlotTableSet(&table, 5, 1, &obj[0]);
+    UTLT_Assert(SlotTableClear(&table, 5) == &obj[0], return STATUS_ERROR, "");
+    UTLT_Assert(SlotTableGet(&table, stale) == NULL, return STATUS_ERROR, "");
+
+    // The next object in the same slot is not found by the old handle
+    handle = SlotTableSet(&table, 5, 1, &obj[1]);
+    UTLT_Assert(SlotHandleIndex(handle) == 5 && SlotHandleGeneration(handle) == 1,
+                return STATUS_ERROR, "Handle 0x%lx is wrong", handle);
+    UTLT_Assert(SlotTableGet(&table, stale) == NULL, return STATUS_ERROR, "");
+    UTLT_Assert(SlotTableGet(&table, handle) == &obj[1], return STATUS_ERROR, "");
+
+    // Clearing an empty slot does not bump its generation
+    UTLT_Assert(SlotTableClear(&table, 5) == &obj[1], return STATUS_ERROR, "");
+    UTLT_Assert(SlotTableClear(&table, 5) == NULL, return STATUS_ERROR, "");
+    handle = SlotTableSet(&table, 5, 1, &obj[2]);
+    UTLT_Assert(SlotHandleGeneration(handle) == 2, return STATUS_ERROR, "");
+
+    // Other slots keep their own generation
+    UTLT_Assert(SlotHandleGeneration(SlotTableSet(&table, 6, 1, &obj[3])) == 0,
+                return STATUS_ERROR, "");
+
+    // The 16-bit generation wraps, then the handle of the first one is the same again
+    for (int i = 2; i < SLOT_TEST_NUM_OF_GENERATION; i++) {
+        UTLT_Assert(SlotTableClear(&table, 5), return STATUS_ERROR, "");
+        handle = SlotTableSet(&table, 5, 1, &obj[4]);
+        UTLT_Assert(SlotHandleGeneration(handle) == (uint16_t) (i + 1), return STATUS_ERROR,
+                    "Generation of handle 0x%lx is not %d", handle, i + 1);
+        UTLT_Assert(SlotTableGet(&table, stale) == (i + 1 == SLOT_TEST_NUM_OF_GENERATION ? &obj[4] : NULL),
+                    return STATUS_ERROR, "");
+    }
+    UTLT_Assert(handle == stale, return STATUS_ERROR, "");
+
+    UTLT_Assert(SlotTableFinal(&table) == STATUS_OK, return STATUS_ERROR, "");
+
+    return STATUS_OK;
+}
+
+// Probes wrap at the end of entries, and removal shifts back the cluster
+Status TestSlotIndex_1() {
+    SlotIndex index;
+    SlotIndexEntry *entry;
+
+    // 8 slots take 16 entries
+    UTLT_Assert(SlotIndexInit(&index, 8) == STATUS_OK && index.mask == 15, return STATUS_ERROR, "");
+
+    // Keys 0 to 4 at entries 14, 15, 0, 1 and 2, by the low bits of their hash
+    const uint32_t hash[] = { 0x10E, 0x20E, 0x300, 0x40E, 0x501 };
+    const uint32_t pos[] = { 14, 15, 0, 1, 2 };
+    for (uint32_t k = 0; k < 5; k++) {
+        slotKey[k] = k;
+        entry = SlotIndexProbe(&index, hash[k], SlotTestEqual, &k);
+        UTLT_Assert(!entry->slot && entry == &index.entry[pos[k]], return STATUS_ERROR,
+                    "Key %u is probed at entry %ld", k, entry - index.entry);
+        SlotIndexFill(entry, hash[k], k);
+    }
+    for (uint32_t k = 0; k < 5; k++) {
+        entry = SlotIndexProbe(&index, hash[k], SlotTestEqual, &k);
+        UTLT_Assert(entry == &index.entry[pos[k]] && entry->slot == k + 1, return STATUS_ERROR, "");
+    }
+
+    // The same hash with another key is not found
+    uint32_t other = 5;
+    slotKey[5] = other;
+    entry = SlotIndexProbe(&index, hash[0], SlotTestEqual, &other);
+    UTLT_Assert(!entry->slot && entry == &index.entry[3], return STATUS_ERROR, "");
+
+    /*
+     * Remove key 0 at entry 14. Key 1 and 3 of home 14 and key 4 of home 1 are
+     * shifted back, key 2 of home 0 is not moved before its home.
+     */
+    uint32_t k = 0;
+    SlotIndexRemove(&index, SlotIndexProbe(&index, hash[0], SlotTestEqual, &k));
+    const uint32_t slotAfter[] = { [14] = 2, [15] = 4, [0] = 3, [1] = 5, [2] = 0 };
+    for (uint32_t i = 0; i <= 15; i++) {
+        if (i > 2 && i < 14)
+            continue;
+        UTLT_Assert(index.entry[i].slot == slotAfter[i], return STATUS_ERROR,
+                    "Entry %u has slot %u, not %u", i, index.entry[i].slot, slotAfter[i]);
+    }
+    entry = SlotIndexProbe(&index, hash[0], SlotTestEqual, &k);
+    UTLT_Assert(!entry->slot && entry == &index.entry[2], return STATUS_ERROR, "");
+    for (k = 1; k < 5; k++) {
+        entry = SlotIndexProbe(&index, hash[k], SlotTestEqual, &k);
+        UTLT_Assert(entry->slot == k + 1, return STATUS_ERROR, "Key %u is lost", k);
+    }
+
+    // Remove the rest, no tombstone is left
+    for (k = 1; k < 5; k++)
+        SlotIndexRemove(&index, SlotIndexProbe(&index, hash[k], SlotTestEqual, &k));
+    for (uint32_t i = 0; i <= index.mask; i++)
+        UTLT_Assert(!index.entry[i].slot, return STATUS_ERROR, "Entry %u is not empty", i);
+
+    UTLT_Assert(SlotIndexFinal(&index) == STATUS_OK, return STATUS_ERROR, "");
+
+    return STATUS_OK;
+}
+
+// Random adds and removes of colliding keys, compared with a plain array
+Status TestSlotIndex_2() {
+    SlotIndex index;
+    SlotIndexEntry *entry;
+    uint8_t present[SLOT_TEST_NUM_OF_KEY] = {0};
+    uint32_t numOfPresent = 0, numOfEntry;
+
+    UTLT_Assert(SlotIndexInit(&index, SLOT_TEST_NUM_OF_KEY) == STATUS_OK, return STATUS_ERROR, "");
+
+    // Key k is in slot k, and hashes of 97 homes spread over entries collide in long clusters
+#define SlotTestHash(__key) ((((__key) % 97) * 21 + 2000) + ((__key) << 16))
+    for (uint32_t k = 0; k < SLOT_TEST_NUM_OF_KEY; k++)
+        slotKey[k] = k;
+
+    srand(5);
+    for (int op = 1; op <= SLOT_TEST_NUM_OF_OP; op++) {
+        uint32_t k = rand() % SLOT_TEST_NUM_OF_KEY;
+        entry = SlotIndexProbe(&index, SlotTestHash(k), SlotTestEqual, &k);
+        if (present[k]) {
+            UTLT_Assert(entry->slot == k + 1, return STATUS_ERROR, "Key %u is lost", k);
+            SlotIndexRemove(&index, entry);
+            present[k] = 0;
+            numOfPresent--;
+        } else {
+            UTLT_Assert(!entry->slot, return STATUS_ERROR, "Key %u is found after removed", k);
+            SlotIndexFill(entry, SlotTestHash(k), k);
+            present[k] = 1;
+            numOfPresent++;
+        }
+
+        if (op % SLOT_TEST_CHECK_INTERVAL)
+            continue;
+        for (k = 0; k < SLOT_TEST_NUM_OF_KEY; k++) {
+            entry = SlotIndexProbe(&index, SlotTestHash(k), SlotTestEqual, &k);
+            UTLT_Assert(entry->slot == (present[k] ? k + 1 : 0), return STATUS_ERROR,
+                        "Key %u is %s at op %d", k, present[k] ? "lost" : "found", op);
+        }
+        numOfEntry = 0;
+        for (uint32_t i = 0; i <= index.mask; i++)
+            numOfEntry += (index.entry[i].slot != 0);
+        UTLT_Assert(numOfEntry == numOfPresent, return STATUS_ERROR,
+                    "%u entries for %u keys at op %d", numOfEntry, numOfPresent, op);
+    }
+#undef SlotTestHash
+
+    UTLT_Assert(SlotIndexFinal(&index) == STATUS_OK, return STATUS_ERROR, "");
+
+    return STATUS_OK;
+}
+
+Status SlotTableTest(void *data) {
+    Status status;
+
+    status = TestSlotTable_1();
+    UTLT_Assert(status == STATUS_OK, return status, "TestSlotTable_1 fail");
+
+    status = TestSlotTable_2();
+    UTLT_Assert(status == STATUS_OK, return status, "TestSlotTable_2 fail");
+
+    status = TestSlotIndex_1();
+    UTLT_Assert(status == STATUS_OK, return status, "TestSlotIndex_1 fail");
+
+    status = TestSlotIndex_2();
+    UTLT_Assert(status == STATUS_OK, return status, "TestSlotIndex_2 fail");
+
+    return STATUS_OK;
+}
@@ -0,0 +1,518 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "test_utlt.h"
+#include "utlt_debug.h"
+#include "utlt_buff.h"
+#include "utlt_hash.h"
+#include "utlt_rcu.h"
+#include "utlt_swisstable.h"
+#include "utlt_time.h"
+
+#define SWISS_TEST_MAGIC            0x5a5a5a5a
+#define SWISS_TEST_NUM_OF_SESSION   1024
+#define SWISS_TEST_NUM_OF_RULE      8
+#define SWISS_TEST_NUM_OF_OBJ       (SWISS_TEST_NUM_OF_SESSION * SWISS_TEST_NUM_OF_RULE)
+#define SWISS_BENCH_NUM_OF_LOOKUP   2000000
+#define SWISS_TEST_NUM_OF_READER    4
+#define SWISS_TEST_DURATION_USEC    TimeMsecToUsec(500)
+#define SWISS_TEST_NUM_OF_UE        100000
+#define SWISS_TEST_NUM_OF_REBUILD   100
+#define SWISS_TEST_PARK_USEC        TimeMsecToUsec(500)
+
+// Session index in high 32 bits and rule ID in low 32 bits, as rules of UPF
+#define SwissTestKey(__session, __rule) (((uint64_t) (__session) << 32) | (__rule))
+
+typedef struct {
+    uint32_t magic;
+    uint32_t value;
+    uint64_t key;
+} SwissTestObj;
+
+static SwissTestObj *obj;
+static SwissTable table;
+
+// PDR, FAR or QER of a session, which the PDR links to its FAR and QER as UPF does
+typedef struct _SwissTestRule {
+    uint64_t key;
+    uint32_t session;
+    uint32_t farId;
+    uint32_t qerId;
+    const struct _SwissTestRule *far;
+    const struct _SwissTestRule *qer;
+} SwissTestRule;
+
+static volatile int benchStop;
+static volatile int readerCorrupted;
+static uint32_t readerNumOfObj;         // Looked up by readers, from obj[0]
+static volatile int readerParked;       // 1 in the critical section, 2 after it
+
+static Status SwissTestObjInit() {
+    obj = calloc(SWISS_TEST_NUM_OF_OBJ, sizeof(SwissTestObj));
+    UTLT_Assert(obj, return STATUS_ERROR, "SwissTestObj alloc failed");
+
+    for (int s = 0; s < SWISS_TEST_NUM_OF_SESSION; s++) {
+        for (int r = 0; r < SWISS_TEST_NUM_OF_RULE; r++) {
+            SwissTestObj *o = &obj[s * SWISS_TEST_NUM_OF_RULE + r];
+            o->magic = SWISS_TEST_MAGIC;
+            o->value = s * SWISS_TEST_NUM_OF_RULE + r;
+            // Every session has the same rule IDs
+            o->key = SwissTestKey(s, r + 1);
+        }
+    }
+
+    return STATUS_OK;
+}
+
+// Set, get, replace, delete and walk
+Status TestSwissTable_1() {
+    void *old;
+
+    UTLT_Assert(SwissTestObjInit() == STATUS_OK, return STATUS_ERROR, "");
+    UTLT_Assert(SwissTableInitOf(&table, SWISS_TEST_NUM_OF_OBJ, SwissTestObj, key) == STATUS_OK,
+        return STATUS_ERROR, "SwissTableInit failed");
+
+    for (int i = 0; i < SWISS_TEST_NUM_OF_OBJ; i++) {
+        UTLT_Assert(SwissTableSet(&table, &obj[i], &old) == STATUS_OK, return STATUS_ERROR,
+            "SwissTableSet of obj[%d] failed", i);
+        UTLT_Assert(!old, return STATUS_ERROR, "obj[%d] should be new", i);
+    }
+    UTLT_Assert(SwissTableSize(&table) == SWISS_TEST_NUM_OF_OBJ, return STATUS_ERROR, "");
+
+    // The table is full
+    SwissTestObj extra = { .magic = SWISS_TEST_MAGIC, .key = SwissTestKey(SWISS_TEST_NUM_OF_SESSION, 1) };
+    UTLT_Assert(SwissTableSet(&table, &extra, NULL) == STATUS_ERROR, return STATUS_ERROR,
+        "SwissTableSet should fail when the table is full");
+
+    for (int i = 0; i < SWISS_TEST_NUM_OF_OBJ; i++)
+        UTLT_Assert(SwissTableGet(&table, obj[i].key) == &obj[i], return STATUS_ERROR,
+            "obj[%d] should be found", i);
+    UTLT_Assert(!SwissTableGet(&table, extra.key), return STATUS_ERROR, "");
+    UTLT_Assert(!SwissTableGet(&table, SwissTestKey(0, 0)), return STATUS_ERROR, "");
+
+    // Replace the object of the same key
+    SwissTestObj copy = obj[10];
+    UTLT_Assert(SwissTableSet(&table, &copy, &old) == STATUS_OK && old == &obj[10], return STATUS_ERROR,
+        "Replace should return the old object");
+    UTLT_Assert(SwissTableGet(&table, copy.key) == &copy, return STATUS_ERROR, "");
+    UTLT_Assert(SwissTableSize(&table) == SWISS_TEST_NUM_OF_OBJ, return STATUS_ERROR, "");
+    UTLT_Assert(SwissTableSet(&table, &obj[10], NULL) == STATUS_OK, return STATUS_ERROR, "");
+
+    // Delete the odd ones
+    for (int i = 1; i < SWISS_TEST_NUM_OF_OBJ; i += 2)
+        UTLT_Assert(SwissTableDelete(&table, obj[i].key) == &obj[i], return STATUS_ERROR,
+            "obj[%d] should be deleted", i);
+    UTLT_Assert(!SwissTableDelete(&table, obj[1].key), return STATUS_ERROR, "");
+    UTLT_Assert(SwissTableSize(&table) == SWISS_TEST_NUM_OF_OBJ / 2, return STATUS_ERROR, "");
+    for (int i = 0; i < SWISS_TEST_NUM_OF_OBJ; i++)
+        UTLT_Assert((SwissTableGet(&table, obj[i].key) == &obj[i]) == !(i % 2), return STATUS_ERROR,
+            "obj[%d] lookup result error", i);
+
+    // Walk sees each object once
+    uint32_t pos = 0, cnt = 0;
+    uint64_t sum = 0;
+    for (SwissTestObj *o = SwissTableNext(&table, &pos); o; o = SwissTableNext(&table, &pos)) {
+        UTLT_Assert(o->magic == SWISS_TEST_MAGIC && !(o->value % 2), return STATUS_ERROR, "");
+        cnt++;
+        sum += o->value;
+    }
+    UTLT_Assert(cnt == SWISS_TEST_NUM_OF_OBJ / 2, return STATUS_ERROR, "Walk found %u objects", cnt);
+    UTLT_Assert(sum == (uint64_t) (SWISS_TEST_NUM_OF_OBJ / 2) * (SWISS_TEST_NUM_OF_OBJ / 2 - 1),
+        return STATUS_ERROR, "");
+
+    // Churn of the odd ones keeps room for them
+    for (int round = 0; round < 16; round++) {
+        for (int i = 1; i < SWISS_TEST_NUM_OF_OBJ; i += 2) {
+            obj[i].key = SwissTestKey(SWISS_TEST_NUM_OF_SESSION * (round + 1) + i, 1);
+            UTLT_Assert(SwissTableSet(&table, &obj[i], NULL) == STATUS_OK, return STATUS_ERROR,
+                "SwissTableSet of obj[%d] failed at round %d", i, round);
+        }
+        for (int i = 1; i < SWISS_TEST_NUM_OF_OBJ; i += 2)
+            UTLT_Assert(SwissTableDelete(&table, obj[i].key) == &obj[i], return STATUS_ERROR, "");
+    }
+    for (int i = 0; i < SWISS_TEST_NUM_OF_OBJ; i += 2)
+        UTLT_Assert(SwissTableGet(&table, obj[i].key) == &obj[i], return STATUS_ERROR,
+            "obj[%d] should be found after churn", i);
+    UTLT_Assert(table.growthLeft + SwissTableSize(&table) >= SWISS_TEST_NUM_OF_OBJ, return STATUS_ERROR,
+        "Room should be kept by rebuild");
+    UTLT_Assert(SwissTableFinal(&table) == STATUS_OK, return STATUS_ERROR, "");
+
+    // A small full table leaves deleted slots on churn, until it is rebuilt
+    UTLT_Assert(SwissTableInitOf(&table, SWISS_TEST_NUM_OF_RULE * 3, SwissTestObj, key) == STATUS_OK,
+        return STATUS_ERROR, "");
+    for (int i = 0; i < SWISS_TEST_NUM_OF_RULE * 3; i++)
+        UTLT_Assert(SwissTableSet(&table, &obj[i], NULL) == STATUS_OK, return STATUS_ERROR, "");
+    for (int round = 1; round <= 1000; round++) {
+        int i = round % (SWISS_TEST_NUM_OF_RULE * 3);
+        UTLT_Assert(SwissTableDelete(&table, obj[i].key) == &obj[i], return STATUS_ERROR, "");
+        obj[i].key = SwissTestKey(SWISS_TEST_NUM_OF_SESSION + round, i);
+        UTLT_Assert(SwissTableSet(&table, &obj[i], NULL) == STATUS_OK, return STATUS_ERROR,
+            "SwissTableSet of obj[%d] failed at round %d", i, round);
+    }
+    for (int i = 0; i < SWISS_TEST_NUM_OF_RULE * 3; i++)
+        UTLT_Assert(SwissTableGet(&table, obj[i].key) == &obj[i], return STATUS_ERROR,
+            "obj[%d] should be found after rebuild", i);
+    UTLT_Assert(table.rebuild, return STATUS_ERROR, "Table should be rebuilt");
+    UTLT_Assert(SwissTableFinal(&table) == STATUS_OK, return STATUS_ERROR, "");
+
+    free(obj);
+    RcuThreadOffline();
+
+    return STATUS_OK;
+}
+
+// Lookup per second of Hash with a mutex, as rules used to be, and Swiss table
+Status TestSwissTable_2() {
+    pthread_mutex_t lock;
+    volatile uintptr_t sink = 0;
+
+    UTLT_Assert(SwissTestObjInit() == STATUS_OK, return STATUS_ERROR, "");
+    UTLT_Assert(SwissTableInitOf(&table, SWISS_TEST_NUM_OF_OBJ, SwissTestObj, key) == STATUS_OK,
+        return STATUS_ERROR, "");
+    Hash *hash = HashMake();
+    UTLT_Assert(hash, return STATUS_ERROR, "HashMake failed");
+    pthread_mutex_init(&lock, NULL);
+
+    for (int i = 0; i < SWISS_TEST_NUM_OF_OBJ; i++) {
+        HashSet(hash, &obj[i].key, sizeof(uint64_t), &obj[i]);
+        UTLT_Assert(SwissTableSet(&table, &obj[i], NULL) == STATUS_OK, return STATUS_ERROR, "");
+    }
+
+    // Spread over the table, as packets of many sessions
+    utime_t start = TimeNow();
+    for (uint32_t i = 0; i < SWISS_BENCH_NUM_OF_LOOKUP; i++) {
+        uint64_t key = obj[(i * 7919) % SWISS_TEST_NUM_OF_OBJ].key;
+        pthread_mutex_lock(&lock);
+        sink += (uintptr_t) HashGet(hash, &key, sizeof(uint64_t));
+        pthread_mutex_unlock(&lock);
+    }
+    utime_t hashTime = TimeNow() - start + 1;
+
+    start = TimeNow();
+    for (uint32_t i = 0; i < SWISS_BENCH_NUM_OF_LOOKUP; i++) {
+        uint64_t key = obj[(i * 7919) % SWISS_TEST_NUM_OF_OBJ].key;
+        RcuReadLock();
+        sink += (uintptr_t) SwissTableGet(&table, key);
+        RcuReadUnlock();
+    }
+    utime_t swissTime = TimeNow() - start + 1;
+
+    // Keys which are not there probe to an empty slot
+    start = TimeNow();
+    for (uint32_t i = 0; i < SWISS_BENCH_NUM_OF_LOOKUP; i++) {
+        RcuReadLock();
+        sink += (uintptr_t) SwissTableGet(&table, SwissTestKey(i, SWISS_TEST_NUM_OF_RULE + 1));
+        RcuReadUnlock();
+    }
+    utime_t missTime = TimeNow() - start + 1;
+
+    UTLT_Info("[SwissTable benchmark] %d objects: Hash with mutex %lu lookup/s, "
+        "Swiss table %lu lookup/s, %lu miss/s",
+        SWISS_TEST_NUM_OF_OBJ,
+        (uint64_t) SWISS_BENCH_NUM_OF_LOOKUP * USEC_PER_SEC / hashTime,
+        (uint64_t) SWISS_BENCH_NUM_OF_LOOKUP * USEC_PER_SEC / swissTime,
+        (uint64_t) SWISS_BENCH_NUM_OF_LOOKUP * USEC_PER_SEC / missTime);
+
+    pthread_mutex_destroy(&lock);
+    HashDestroy(hash);
+    UTLT_Assert(SwissTableFinal(&table) == STATUS_OK, return STATUS_ERROR, "");
+    free(obj);
+    RcuThreadOffline();
+
+    return STATUS_OK;
+}
+
+static void *SwissTestReader(void *data) {
+    uint64_t *lookupCnt = data;
+    uint32_t i = 0;
+
+    while (!benchStop) {
+        RcuReadLock();
+        SwissTestObj *o = SwissTableGet(&table, obj[i].key);
+        if (o && (o->magic != SWISS_TEST_MAGIC || o->key != obj[i].key))
+            readerCorrupted = 1;
+        // The even ones are never deleted
+        if (!(i % 2) && o != &obj[i])
+            readerCorrupted = 1;
+        RcuReadUnlock();
+
+        i = (i + 7) % readerNumOfObj;
+        (*lookupCnt)++;
+    }
+
+    RcuThreadOffline();
+    return NULL;
+}
+
+// Readers without lock while a writer replaces, deletes and inserts
+Status TestSwissTable_3() {
+    pthread_t reader[SWISS_TEST_NUM_OF_READER];
+    uint64_t lookupCnt[SWISS_TEST_NUM_OF_READER], churnCnt = 0;
+
+    benchStop = 0;
+    readerCorrupted = 0;
+    readerNumOfObj = SWISS_TEST_NUM_OF_OBJ;
+    memset(lookupCnt, 0, sizeof(lookupCnt));
+
+    UTLT_Assert(SwissTestObjInit() == STATUS_OK, return STATUS_ERROR, "");
+    UTLT_Assert(SwissTableInitOf(&table, SWISS_TEST_NUM_OF_OBJ, SwissTestObj, key) == STATUS_OK,
+        return STATUS_ERROR, "");
+    for (int i = 0; i < SWISS_TEST_NUM_OF_OBJ; i++)
+        UTLT_Assert(SwissTableSet(&table, &obj[i], NULL) == STATUS_OK, return STATUS_ERROR, "");
+
+    for (int i = 0; i < SWISS_TEST_NUM_OF_READER; i++)
+        UTLT_Assert(pthread_create(&reader[i], NULL, SwissTestReader, &lookupCnt[i]) == 0,
+            return STATUS_ERROR, "Reader thread create failed");
+
+    utime_t start = TimeNow();
+    for (uint32_t i = 1; TimeNow() - start < SWISS_TEST_DURATION_USEC; i = (i + 2) % SWISS_TEST_NUM_OF_OBJ) {
+        // Copy on write, as rules of UPF are updated
+        SwissTestObj *copy = malloc(sizeof(SwissTestObj));
+        UTLT_Assert(copy, break, "");
+        *copy = obj[i];
+        void *old = NULL;
+        UTLT_Assert(SwissTableSet(&table, copy, &old) == STATUS_OK && old == &obj[i], break, "");
+
+        UTLT_Assert(SwissTableDelete(&table, copy->key) == copy, break, "");
+        RcuSynchronize();
+        memset(copy, 0, sizeof(SwissTestObj));
+        free(copy);
+
+        UTLT_Assert(SwissTableSet(&table, &obj[i], NULL) == STATUS_OK, break, "");
+        churnCnt++;
+    }
+    utime_t elapsed = TimeNow() - start;
+    benchStop = 1;
+
+    uint64_t totalLookup = 0;
+    for (int i = 0; i < SWISS_TEST_NUM_OF_READER; i++) {
+        pthread_join(reader[i], NULL);
+        totalLookup += lookupCnt[i];
+    }
+
+    UTLT_Assert(SwissTableSize(&table) == SWISS_TEST_NUM_OF_OBJ, return STATUS_ERROR,
+        "Writer stopped at error");
+    UTLT_Assert(!readerCorrupted, return STATUS_ERROR, "Reader got a wrong or freed object");
+
+    UTLT_Info("[SwissTable benchmark] %d readers + 1 writer: %lu lookup/s, %lu churn/s, %lu rebuild",
+        SWISS_TEST_NUM_OF_READER, totalLookup * USEC_PER_SEC / elapsed, churnCnt * USEC_PER_SEC / elapsed,
+        table.rebuild);
+
+    UTLT_Assert(SwissTableFinal(&table) == STATUS_OK, return STATUS_ERROR, "");
+    free(obj);
+    RcuThreadOffline();
+
+    return STATUS_OK;
+}
+
+// A reader stays in read-side critical section, as a slow batch of the data path
+static void *SwissTestParkedReader(void *data) {
+    RcuReadLock();
+    readerParked = 1;
+    usleep(SWISS_TEST_PARK_USEC);
+    readerParked = 2;
+    RcuReadUnlock();
+
+    RcuThreadOffline();
+    return NULL;
+}
+
+/*
+ * Readers without lock while inserts of new keys into a small full table rebuild it.
+ * The writer does not wait for the parked reader, the old slots are freed after it.
+ */
+Status TestSwissTable_4() {
+    pthread_t reader[SWISS_TEST_NUM_OF_READER], parked;
+    uint64_t lookupCnt[SWISS_TEST_NUM_OF_READER];
+    SwissTestObj spare = { .magic = SWISS_TEST_MAGIC };
+
+    benchStop = 0;
+    readerCorrupted = 0;
+    readerParked = 0;
+    readerNumOfObj = SWISS_TEST_NUM_OF_RULE * 3;
+    memset(lookupCnt, 0, sizeof(lookupCnt));
+
+    UTLT_Assert(SwissTestObjInit() == STATUS_OK, return STATUS_ERROR, "");
+    UTLT_Assert(SwissTableInitOf(&table, readerNumOfObj, SwissTestObj, key) == STATUS_OK,
+        return STATUS_ERROR, "");
+    for (int i = 0; i < readerNumOfObj; i++)
+        UTLT_Assert(SwissTableSet(&table, &obj[i], NULL) == STATUS_OK, return STATUS_ERROR, "");
+
+    for (int i = 0; i < SWISS_TEST_NUM_OF_READER; i++)
+        UTLT_Assert(pthread_create(&reader[i], NULL, SwissTestReader, &lookupCnt[i]) == 0,
+            return STATUS_ERROR, "Reader thread create failed");
+    UTLT_Assert(pthread_create(&parked, NULL, SwissTestParkedReader, NULL) == 0,
+        return STATUS_ERROR, "Reader thread create failed");
+    while (!readerParked)
+        usleep(1000);
+
+    for (uint32_t round = 1; table.rebuild < SWISS_TEST_NUM_OF_REBUILD &&
+                             round <= SWISS_TEST_NUM_OF_REBUILD * 1000; round++) {
+        uint32_t i = (round * 2 + 1) % readerNumOfObj;
+        UTLT_Assert(SwissTableDelete(&table, obj[i].key) == &obj[i], break, "");
+        spare.key = SwissTestKey(SWISS_TEST_NUM_OF_SESSION + round, 1);
+        UTLT_Assert(SwissTableSet(&table, &spare, NULL) == STATUS_OK, break, "");
+        UTLT_Assert(SwissTableDelete(&table, spare.key) == &spare, break, "");
+        UTLT_Assert(SwissTableSet(&table, &obj[i], NULL) == STATUS_OK, break, "");
+        RcuDeferPoll();
+    }
+    int waited = (readerParked == 2);
+    benchStop = 1;
+
+    for (int i = 0; i < SWISS_TEST_NUM_OF_READER; i++)
+        pthread_join(reader[i], NULL);
+    pthread_join(parked, NULL);
+
+    UTLT_Assert(SwissTableSize(&table) == readerNumOfObj, return STATUS_ERROR, "Writer stopped at error");
+    UTLT_Assert(!waited, return STATUS_ERROR, "Rebuild waits for readers");
+    UTLT_Assert(table.rebuild >= SWISS_TEST_NUM_OF_REBUILD, return STATUS_ERROR,
+        "Table is rebuilt %lu times", table.rebuild);
+    UTLT_Assert(!readerCorrupted, return STATUS_ERROR, "Reader got a wrong or freed object");
+
+    UTLT_Assert(SwissTableFinal(&table) == STATUS_OK, return STATUS_ERROR, "");
+    free(obj);
+    RcuThreadOffline();
+
+    return STATUS_OK;
+}
+
+static void SwissTestRuleSet(SwissTable *ruleTable, SwissTestRule *rule, uint32_t session, uint32_t id,
+                             uint32_t farId, uint32_t qerId) {
+    rule->key = SwissTestKey(session, id);
+    rule->session = session;
+    rule->farId = farId;
+    rule->qerId = qerId;
+    rule->far = rule->qer = NULL;
+    SwissTableSet(ruleTable, rule, NULL);
+}
+
+// Sessions with the same rule IDs, whose packets go PDR -> FAR -> QER by ID or by the links
+Status TestSwissTable_5() {
+    SwissTable pdrTable, farTable, qerTable;
+    volatile uintptr_t sink = 0;
+
+    // Each session has PDR 1 and 2 to FAR 1 and 2, and both of them to QER 1
+    SwissTestRule *pdr = calloc(SWISS_TEST_NUM_OF_UE * 2, sizeof(SwissTestRule));
+    SwissTestRule *far = calloc(SWISS_TEST_NUM_OF_UE * 2, sizeof(SwissTestRule));
+    SwissTestRule *qer = calloc(SWISS_TEST_NUM_OF_UE, sizeof(SwissTestRule));
+    UTLT_Assert(pdr && far && qer, return STATUS_ERROR, "SwissTestRule alloc failed");
+    UTLT_Assert(SwissTableInitOf(&pdrTable, SWISS_TEST_NUM_OF_UE * 2, SwissTestRule, key) == STATUS_OK &&
+                SwissTableInitOf(&farTable, SWISS_TEST_NUM_OF_UE * 2, SwissTestRule, key) == STATUS_OK &&
+                SwissTableInitOf(&qerTable, SWISS_TEST_NUM_OF_UE, SwissTestRule, key) == STATUS_OK,
+        return STATUS_ERROR, "SwissTableInit failed");
+
+    for (uint32_t s = 0; s < SWISS_TEST_NUM_OF_UE; s++) {
+        for (uint32_t id = 1; id <= 2; id++) {
+            SwissTestRuleSet(&pdrTable, &pdr[s * 2 + id - 1], s, id, id, 1);
+            SwissTestRuleSet(&farTable, &far[s * 2 + id - 1], s, id, 0, 0);
+        }
+        SwissTestRuleSet(&qerTable, &qer[s], s, 1, 0, 0);
+    }
+    // No session overwrites the rules of another one
+    UTLT_Assert(SwissTableSize(&pdrTable) == SWISS_TEST_NUM_OF_UE * 2 &&
+                SwissTableSize(&farTable) == SWISS_TEST_NUM_OF_UE * 2 &&
+                SwissTableSize(&qerTable) == SWISS_TEST_NUM_OF_UE,
+        return STATUS_ERROR, "Rules of the same ID are overwritten");
+
+    RcuReadLock();
+    for (uint32_t s = 0; s < SWISS_TEST_NUM_OF_UE; s++) {
+        for (uint32_t id = 1; id <= 2; id++) {
+            SwissTestRule *p = SwissTableGet(&pdrTable, SwissTestKey(s, id));
+            UTLT_Assert(p == &pdr[s * 2 + id - 1], RcuReadUnlock(); return STATUS_ERROR,
+                "PDR %u of session %u is not its own", id, s);
+            p->far = SwissTableGet(&farTable, SwissTestKey(s, p->farId));
+            p->qer = SwissTableGet(&qerTable, SwissTestKey(s, p->qerId));
+            UTLT_Assert(p->far == &far[s * 2 + id - 1] && p->qer == &qer[s],
+                RcuReadUnlock(); return STATUS_ERROR, "Rules of session %u are linked to others", s);
+        }
+    }
+    RcuReadUnlock();
+
+    // Packets spread over sessions, found by rule IDs or by the links of PDR
+    utime_t start = TimeNow();
+    for (uint32_t i = 0; i < SWISS_BENCH_NUM_OF_LOOKUP; i++) {
+        uint32_t s = (i * 7919) % SWISS_TEST_NUM_OF_UE;
+        RcuReadLock();
+        SwissTestRule *p = SwissTableGet(&pdrTable, SwissTestKey(s, (i & 1) + 1));
+        SwissTestRule *f = SwissTableGet(&farTable, SwissTestKey(s, p->farId));
+        SwissTestRule *q = SwissTableGet(&qerTable, SwissTestKey(s, p->qerId));
+        sink += f->session + q->session;
+        RcuReadUnlock();
+    }
+    utime_t idTime = TimeNow() - start + 1;
+
+    start = TimeNow();
+    for (uint32_t i = 0; i < SWISS_BENCH_NUM_OF_LOOKUP; i++) {
+        uint32_t s = (i * 7919) % SWISS_TEST_NUM_OF_UE;
+        RcuReadLock();
+        SwissTestRule *p = SwissTableGet(&pdrTable, SwissTestKey(s, (i & 1) + 1));
+        const SwissTestRule *f = RcuDereference(p->far);
+        const SwissTestRule *q = RcuDereference(p->qer);
+        sink += f->session + q->session;
+        RcuReadUnlock();
+    }
+    utime_t linkTime = TimeNow() - start + 1;
+
+    UTLT_Info("[SwissTable benchmark] %d sessions of the same rule IDs: PDR -> FAR -> QER "
+        "by ID %lu packet/s, by link %lu packet/s",
+        SWISS_TEST_NUM_OF_UE,
+        (uint64_t) SWISS_BENCH_NUM_OF_LOOKUP * USEC_PER_SEC / idTime,
+        (uint64_t) SWISS_BENCH_NUM_OF_LOOKUP * USEC_PER_SEC / linkTime);
+
+    // Removing the even sessions leaves the rules of the same IDs in the odd ones
+    for (uint32_t s = 0; s < SWISS_TEST_NUM_OF_UE; s += 2) {
+        for (uint32_t id = 1; id <= 2; id++) {
+            UTLT_Assert(SwissTableDelete(&pdrTable, SwissTestKey(s, id)) == &pdr[s * 2 + id - 1] &&
+                        SwissTableDelete(&farTable, SwissTestKey(s, id)) == &far[s * 2 + id - 1],
+                return STATUS_ERROR, "Rule %u of session %u is not deleted", id, s);
+        }
+        UTLT_Assert(SwissTableDelete(&qerTable, SwissTestKey(s, 1)) == &qer[s], return STATUS_ERROR, "");
+    }
+    RcuReadLock();
+    for (uint32_t s = 0; s < SWISS_TEST_NUM_OF_UE; s++) {
+        SwissTestRule *p = SwissTableGet(&pdrTable, SwissTestKey(s, 1));
+        UTLT_Assert((s % 2) ? (p == &pdr[s * 2] && p->far->session == s && p->qer->session == s) : !p,
+            RcuReadUnlock(); return STATUS_ERROR, "PDR 1 of session %u is wrong after removal", s);
+    }
+    RcuReadUnlock();
+
+    UTLT_Assert(SwissTableFinal(&pdrTable) == STATUS_OK && SwissTableFinal(&farTable) == STATUS_OK &&
+                SwissTableFinal(&qerTable) == STATUS_OK, return STATUS_ERROR, "");
+    free(pdr);
+    free(far);
+    free(qer);
+    RcuThreadOffline();
+
+    return STATUS_OK;
+}
+
+Status SwissTableTest(void *data) {
+    Status status;
+
+    status = TestSwissTable_1();
+    UTLT_Assert(status == STATUS_OK, return status, "TestSwissTable_1 fail");
+
+    // Hash in the benchmark is on Bufblk
+    status = BufblkPoolInit();
+    UTLT_Assert(status == STATUS_OK, return status, "BufblkPoolInit fail");
+
+    status = TestSwissTable_2();
+    UTLT_Assert(status == STATUS_OK, return status, "TestSwissTable_2 fail");
+
+    status = BufblkPoolFinal();
+    UTLT_Assert(status == STATUS_OK, return status, "BufblkPoolFinal fail");
+
+    status = TestSwissTable_3();
+    UTLT_Assert(status == STATUS_OK, return status, "TestSwissTable_3 fail");
+
+    status = TestSwissTable_4();
+    UTLT_Assert(status == STATUS_OK, return status, "TestSwissTable_4 fail");
+
+    status = TestSwissTable_5();
+    UTLT_Assert(status == STATUS_OK, return status, "TestSwissTable_5 fail");
+
+    return STATUS_OK;
+}
@@ -2,11 +2,15 @@
 #include <string.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <fcntl.h>
 
 #include "test_utlt.h"
 #include "utlt_debug.h"
 #include "utlt_buff.h"
 #include "utlt_timer.h"
+#include "utlt_time.h"
+
+#define TEST_TIMER_NUM_OF_BENCH  100000
 
 uint8_t expireCheck[5];
 
@@ -29,13 +33,21 @@ void TestExpireFunc(uintptr_t data, uintptr_t param[]) {
     expireCheck[index]++;
 }
 
+static Status TestTimerRunningCheck(TimerBlkID idArray[], int running[]) {
+    for (int n = 0; n < sizeof(timerEliment) / sizeof(TestTimerEliment); n++)
+        UTLT_Assert(TimerIsRunning(idArray[n]) == running[n], return STATUS_ERROR,
+            "Timer [%d] running error : need %d, not %d", n, running[n], TimerIsRunning(idArray[n]));
+
+    return STATUS_OK;
+}
+
 Status TestTimer_1() {
     int n = 0;
     TimerBlkID idArray[5];
-    TimerBlkID id;
     TimerList timerList;
+    Status status;
 
-    memset((char*)idArray, 0x00, sizeof(timerList));
+    memset((char*)idArray, 0x00, sizeof(idArray));
     memset(expireCheck, 0x00, sizeof(expireCheck));
 
     TimerListInit(&timerList);
@@ -51,37 +63,15 @@ Status TestTimer_1() {
     for(n = 0; n < sizeof(timerEliment) / sizeof(TestTimerEliment); n++)
         TimerStart(idArray[n]);
 
-    id = (TimerBlkID)ListFirst(&timerList.idle);
-    // UTLT_Assert(id == 0, return STATUS_ERROR, "Timer idle list error : need %d, not %d", 0, id);
-
-    id = (TimerBlkID)ListFirst(&timerList.active);
-    UTLT_Assert(id == idArray[0], return STATUS_ERROR, "Timer active list error : need %d, not %d", idArray[0], id);
-    id = (TimerBlkID)ListNext(id);
-    UTLT_Assert(id == idArray[1], return STATUS_ERROR, "Timer active list error : need %d, not %d", idArray[1], id);
-    id = (TimerBlkID)ListNext(id);
-    UTLT_Assert(id == idArray[2], return STATUS_ERROR, "Timer active list error : need %d, not %d", idArray[2], id);
-    id = (TimerBlkID)ListNext(id);
-    UTLT_Assert(id == idArray[3], return STATUS_ERROR, "Timer active list error : need %d, not %d", idArray[3], id);
-    id = (TimerBlkID)ListNext(id);
-    // UTLT_Assert(id == 0, return STATUS_ERROR, "Timer active list error : need %d, not %d", 0, id);
-    
+    status = TestTimerRunningCheck(idArray, (int []) {1, 1, 1, 1});
+    UTLT_Assert(status == STATUS_OK, return status, "");
+
     usleep(40 * 1000);  // Sleep for the specified number of micro-seconds.
     TimerExpireCheck(&timerList, 0);
 
-    id = (TimerBlkID)ListFirst(&timerList.idle);
-    UTLT_Assert(id == idArray[0], return STATUS_ERROR, "Timer idle list error : need %d, not %d", idArray[0], id);
-    id = (TimerBlkID)ListNext(id);
-    // UTLT_Assert(id == 0, return STATUS_ERROR, "Timer idle list error : need %d, not %d", 0, id);
-
-    id = (TimerBlkID)ListFirst(&timerList.active);
-    UTLT_Assert(id == idArray[1], return STATUS_ERROR, "Timer active list error : need %d, not %d", idArray[1], id);
-    id = (TimerBlkID)ListNext(id);
-    UTLT_Assert(id == idArray[2], return STATUS_ERROR, "Timer active list error : need %d, not %d", idArray[2], id);
-    id = (TimerBlkID)ListNext(id);
-    UTLT_Assert(id == idArray[3], return STATUS_ERROR, "Timer active list error : need %d, not %d", idArray[3], id);
-    id = (TimerBlkID)ListNext(id);
-    // UTLT_Assert(id == 0, return STATUS_ERROR, "Timer active list error : need %d, not %d", 0, id);
-    
+    status = TestTimerRunningCheck(idArray, (int []) {0, 1, 1, 1});
+    UTLT_Assert(status == STATUS_OK, return status, "");
+
     UTLT_Assert(expireCheck[0] == 1, return STATUS_ERROR, "Expire check [%d] error : need %d, not %d", 0, 1, expireCheck[0]);
     UTLT_Assert(expireCheck[1] == 0, return STATUS_ERROR, "Expire check [%d] error : need %d, not %d", 1, 0, expireCheck[1]);
     UTLT_Assert(expireCheck[2] == 0, return STATUS_ERROR, "Expire check [%d] error : need %d, not %d", 2, 0, expireCheck[2]);
@@ -90,20 +80,9 @@ Status TestTimer_1() {
     usleep(20 * 1000);  // 40 + 20
     TimerExpireCheck(&timerList, 0);
 
-    id = (TimerBlkID)ListFirst(&timerList.idle);
-    UTLT_Assert(id == idArray[0], return STATUS_ERROR, "Timer idle list error : need %d, not %d", idArray[0], id);
-    id = (TimerBlkID)ListNext(id);
-    // UTLT_Assert(id == 0, return STATUS_ERROR, "Timer idle list error : need %d, not %d", 0, id);
-    
-    id = (TimerBlkID)ListFirst(&timerList.active);
-    UTLT_Assert(id == idArray[2], return STATUS_ERROR, "Timer active list error : need %d, not %d", idArray[2], id);
-    id = (TimerBlkID)ListNext(id);
-    UTLT_Assert(id == idArray[1], return STATUS_ERROR, "Timer active list error : need %d, not %d", idArray[1], id);
-    id = (TimerBlkID)ListNext(id);
-    UTLT_Assert(id == idArray[3], return STATUS_ERROR, "Timer active list error : need %d, not %d", idArray[3], id);
-    id = (TimerBlkID)ListNext(id);
-    // UTLT_Assert(id == 0, return STATUS_ERROR, "Timer active list error : need %d, not %d", 0, id);
-    
+    status = TestTimerRunningCheck(idArray, (int []) {0, 1, 1, 1});
+    UTLT_Assert(status == STATUS_OK, return status, "");
+
     UTLT_Assert(expireCheck[0] == 1, return STATUS_ERROR, "Expire check [%d] error : need %d, not %d", 0, 1, expireCheck[0]);
     UTLT_Assert(expireCheck[1] == 1, return STATUS_ERROR, "Expire check [%d] error : need %d, not %d", 1, 1, expireCheck[1]);
     UTLT_Assert(expireCheck[2] == 0, return STATUS_ERROR, "Expire check [%d] error : need %d, not %d", 2, 0, expireCheck[2]);
@@ -112,20 +91,9 @@ Status TestTimer_1() {
     usleep(20 * 1000);  // 40 + 20 + 20
     TimerExpireCheck(&timerList, 0);
 
-    id = (TimerBlkID)ListFirst(&timerList.idle);
-    UTLT_Assert(id == idArray[0], return STATUS_ERROR, "Timer idle list error : need %d, not %d", idArray[0], id);
-    id = (TimerBlkID)ListNext(id);
-    // UTLT_Assert(id == 0, return STATUS_ERROR, "Timer idle list error : need %d, not %d", 0, id);
-
-    id = (TimerBlkID)ListFirst(&timerList.active);
-    UTLT_Assert(id == idArray[1], return STATUS_ERROR, "Timer active list error : need %d, not %d", idArray[1], id);
-    id = (TimerBlkID)ListNext(id);
-    UTLT_Assert(id == idArray[3], return STATUS_ERROR, "Timer active list error : need %d, not %d", idArray[3], id);
-    id = (TimerBlkID)ListNext(id);
-    UTLT_Assert(id == idArray[2], return STATUS_ERROR, "Timer active list error : need %d, not %d", idArray[2], id);
-    id = (TimerBlkID)ListNext(id);
-    // UTLT_Assert(id == 0, return STATUS_ERROR, "Timer active list error : need %d, not %d", 0, id);
-    
+    status = TestTimerRunningCheck(idArray, (int []) {0, 1, 1, 1});
+    UTLT_Assert(status == STATUS_OK, return status, "");
+
     UTLT_Assert(expireCheck[0] == 1, return STATUS_ERROR, "Expire check [%d] error : need %d, not %d", 0, 1, expireCheck[0]);
     UTLT_Assert(expireCheck[1] == 1, return STATUS_ERROR, "Expire check [%d] error : need %d, not %d", 1, 1, expireCheck[1]);
     UTLT_Assert(expireCheck[2] == 1, return STATUS_ERROR, "Expire check [%d] error : need %d, not %d", 2, 1, expireCheck[2]);
@@ -136,20 +104,9 @@ Status TestTimer_1() {
     usleep(40 * 1000); // 40 + 20 + 20 + 40
     TimerExpireCheck(&timerList, 0);
 
-    id = (TimerBlkID)ListFirst(&timerList.idle);
-    UTLT_Assert(id == idArray[0], return STATUS_ERROR, "Timer idle list error : need %d, not %d", idArray[0], id);
-    id = (TimerBlkID)ListNext(id);
-    UTLT_Assert(id == idArray[1], return STATUS_ERROR, "Timer idle list error : need %d, not %d", idArray[1], id);
-    id = (TimerBlkID)ListNext(id);
-    // UTLT_Assert(id == 0, return STATUS_ERROR, "Timer idle list error : need %d, not %d", 0, id);
-
-    id = (TimerBlkID)ListFirst(&timerList.active);
-    UTLT_Assert(id == idArray[3], return STATUS_ERROR, "Timer active list error : need %d, not %d", idArray[3], id);
-    id = (TimerBlkID)ListNext(id);
-    UTLT_Assert(id == idArray[2], return STATUS_ERROR, "Timer active list error : need %d, not %d", idArray[2], id);
-    id = (TimerBlkID)ListNext(id);
-    // UTLT_Assert(id == 0, return STATUS_ERROR, "Timer active list error : need %d, not %d", 0, id);
-    
+    status = TestTimerRunningCheck(idArray, (int []) {0, 0, 1, 1});
+    UTLT_Assert(status == STATUS_OK, return status, "");
+
     UTLT_Assert(expireCheck[0] == 1, return STATUS_ERROR, "Expire check [%d] error : need %d, not %d", 0, 1, expireCheck[0]);
     UTLT_Assert(expireCheck[1] == 1, return STATUS_ERROR, "Expire check [%d] error : need %d, not %d", 1, 1, expireCheck[1]);
     UTLT_Assert(expireCheck[2] == 1, return STATUS_ERROR, "Expire check [%d] error : need %d, not %d", 2, 1, expireCheck[2]);
@@ -158,20 +115,9 @@ Status TestTimer_1() {
     usleep(15 * 1000); // 40 + 20 + 20 + 40 + 15
     TimerExpireCheck(&timerList, 0);
 
-    id = (TimerBlkID)ListFirst(&timerList.idle);
-    UTLT_Assert(id == idArray[0], return STATUS_ERROR, "Timer idle list error : need %d, not %d", idArray[0], id);
-    id = (TimerBlkID)ListNext(id);
-    UTLT_Assert(id == idArray[1], return STATUS_ERROR, "Timer idle list error : need %d, not %d", idArray[1], id);
-    id = (TimerBlkID)ListNext(id);
-    UTLT_Assert(id == idArray[3], return STATUS_ERROR, "Timer idle list error : need %d, not %d", idArray[3], id);
-    id = (TimerBlkID)ListNext(id);
-    // UTLT_Assert(id == 0, return STATUS_ERROR, "Timer idle list error : need %d, not %d", 0, id);
-
-    id = (TimerBlkID)ListFirst(&timerList.active);
-    UTLT_Assert(id == idArray[2], return STATUS_ERROR, "Timer active list error : need %d, not %d", idArray[2], id);
-    id = (TimerBlkID)ListNext(id);
-    // UTLT_Assert(id == 0, return STATUS_ERROR, "Timer active list error : need %d, not %d", 0, id);
-    
+    status = TestTimerRunningCheck(idArray, (int []) {0, 0, 1, 0});
+    UTLT_Assert(status == STATUS_OK, return status, "");
+
     UTLT_Assert(expireCheck[0] == 1, return STATUS_ERROR, "Expire check [%d] error : need %d, not %d", 0, 1, expireCheck[0]);
     UTLT_Assert(expireCheck[1] == 1, return STATUS_ERROR, "Expire check [%d] error : need %d, not %d", 1, 1, expireCheck[1]);
     UTLT_Assert(expireCheck[2] == 1, return STATUS_ERROR, "Expire check [%d] error : need %d, not %d", 2, 1, expireCheck[2]);
@@ -180,20 +126,9 @@ Status TestTimer_1() {
     usleep(20 * 1000); // 40 + 20 + 20 + 40 + 15 + 20
     TimerExpireCheck(&timerList, 0);
 
-    id = (TimerBlkID)ListFirst(&timerList.idle);
-    UTLT_Assert(id == idArray[0], return STATUS_ERROR, "Timer idle list error : need %d, not %d", idArray[0], id);
-    id = (TimerBlkID)ListNext(id);
-    UTLT_Assert(id == idArray[1], return STATUS_ERROR, "Timer idle list error : need %d, not %d", idArray[1], id);
-    id = (TimerBlkID)ListNext(id);
-    UTLT_Assert(id == idArray[3], return STATUS_ERROR, "Timer idle list error : need %d, not %d", idArray[3], id);
-    id = (TimerBlkID)ListNext(id);
-    // UTLT_Assert(id == 0, return STATUS_ERROR, "Timer idle list error : need %d, not %d", 0, id);
-
-    id = (TimerBlkID)ListFirst(&timerList.active);
-    UTLT_Assert(id == idArray[2], return STATUS_ERROR, "Timer active list error : need %d, not %d", idArray[2], id);
-    id = (TimerBlkID)ListNext(id);
-    // UTLT_Assert(id == 0, return STATUS_ERROR, "Timer active list error : need %d, not %d", 0, id);
-    
+    status = TestTimerRunningCheck(idArray, (int []) {0, 0, 1, 0});
+    UTLT_Assert(status == STATUS_OK, return status, "");
+
     UTLT_Assert(expireCheck[0] == 1, return STATUS_ERROR, "Expire check [%d] error : need %d, not %d", 0, 1, expireCheck[0]);
     UTLT_Assert(expireCheck[1] == 1, return STATUS_ERROR, "Expire check [%d] error : need %d, not %d", 1, 1, expireCheck[1]);
     UTLT_Assert(expireCheck[2] == 2, return STATUS_ERROR, "Expire check [%d] error : need %d, not %d", 2, 2, expireCheck[2]);
@@ -201,12 +136,138 @@ Status TestTimer_1() {
     
     for( n = 0; n < sizeof(timerEliment) / sizeof(TestTimerEliment); n++)
         TimerDelete(idArray[n]);
+    TimerListTerm(&timerList);
 
     UTLT_Assert(TimerGetPoolSize() == MAX_NUM_OF_TIMER, return STATUS_ERROR, "Pool size error : need %d, not %d", MAX_NUM_OF_TIMER, TimerGetPoolSize());
 
     return STATUS_OK;
 }
 
+uint32_t cascadeDuration[] = {5, 63, 64, 65, 130, 300};
+utime_t cascadeExpire[sizeof(cascadeDuration) / sizeof(uint32_t)];
+
+void TestCascadeExpireFunc(uintptr_t data, uintptr_t param[]) {
+    cascadeExpire[param[0]] = TimeNow();
+}
+
+// Timers across wheel levels expire on time, driven by timerfd, and the pool grows
+Status TestTimer_2() {
+    int num = sizeof(cascadeDuration) / sizeof(uint32_t);
+    TimerBlkID idArray[sizeof(cascadeDuration) / sizeof(uint32_t)];
+    TimerList timerList;
+    uint64_t tick;
+
+    memset(cascadeExpire, 0x00, sizeof(cascadeExpire));
+    TimerListInit(&timerList);
+    UTLT_Assert(TimerListGetFd(&timerList) >= 0, return STATUS_ERROR, "timerfd is not created");
+
+    for (int n = 0; n < num; n++) {
+        idArray[n] = TimerCreate(&timerList, TIMER_TYPE_ONCE, cascadeDuration[n], TestCascadeExpireFunc);
+        TimerSet(PARAM1, idArray[n], n);
+    }
+
+    utime_t start = TimeNow();
+    for (int n = 0; n < num; n++)
+        TimerStart(idArray[n]);
+
+    // Blocking read returns at each tick of timerfd
+    int flags = fcntl(TimerListGetFd(&timerList), F_GETFL);
+    fcntl(TimerListGetFd(&timerList), F_SETFL, flags & ~O_NONBLOCK);
+    while (TimerIsRunning(idArray[num - 1])) {
+        UTLT_Assert(read(TimerListGetFd(&timerList), &tick, sizeof(tick)) == sizeof(tick),
+            return STATUS_ERROR, "timerfd read fail");
+        TimerExpireCheck(&timerList, 0);
+    }
+    fcntl(TimerListGetFd(&timerList), F_SETFL, flags);
+
+    for (int n = 0; n < num; n++) {
+        utime_t elapsed = TimeMsec(cascadeExpire[n] - start);
+        UTLT_Assert(elapsed >= cascadeDuration[n] && elapsed <= cascadeDuration[n] + 3 * TIMER_TICK_MSEC,
+            return STATUS_ERROR, "Timer [%d] of %u msec expires at %ld msec", n, cascadeDuration[n], elapsed);
+        TimerDelete(idArray[n]);
+    }
+
+    // Pool grows over MAX_NUM_OF_TIMER
+    TimerBlkID *bench = malloc(sizeof(TimerBlkID) * TEST_TIMER_NUM_OF_BENCH);
+    UTLT_Assert(bench, return STATUS_ERROR, "");
+    for (int n = 0; n < TEST_TIMER_NUM_OF_BENCH; n++) {
+        bench[n] = TimerCreate(&timerList, TIMER_TYPE_ONCE, 1000 + (n * 7919) % 60000, TestExpireFunc);
+        UTLT_Assert(bench[n], return STATUS_ERROR, "Timer [%d] create fail", n);
+    }
+
+    // Start and stop cost should not depend on the number of running timers
+    start = TimeNow();
+    for (int n = 0; n < TEST_TIMER_NUM_OF_BENCH; n++)
+        TimerStart(bench[n]);
+    utime_t startTime = TimeNow() - start + 1;
+
+    start = TimeNow();
+    for (int n = 0; n < TEST_TIMER_NUM_OF_BENCH; n++)
+        TimerStop(bench[n]);
+    utime_t stopTime = TimeNow() - start + 1;
+
+    UTLT_Info("[Timer benchmark] %d timers: start %lu timer/s, stop %lu timer/s",
+              TEST_TIMER_NUM_OF_BENCH,
+              (uint64_t) TEST_TIMER_NUM_OF_BENCH * USEC_PER_SEC / startTime,
+              (uint64_t) TEST_TIMER_NUM_OF_BENCH * USEC_PER_SEC / stopTime);
+
+    for (int n = 0; n < TEST_TIMER_NUM_OF_BENCH; n++)
+        TimerDelete(bench[n]);
+    free(bench);
+    TimerListTerm(&timerList);
+
+    UTLT_Assert(TimerGetPoolSize() >= TEST_TIMER_NUM_OF_BENCH, return STATUS_ERROR,
+        "Pool size error : need %d at least, not %d", TEST_TIMER_NUM_OF_BENCH, TimerGetPoolSize());
+
+    return STATUS_OK;
+}
+
+#define TEST_TIMER_NUM_OF_RESTART 200
+
+static TimerBlkID restartTimer[TEST_TIMER_NUM_OF_RESTART];
+static int restartCount[TEST_TIMER_NUM_OF_RESTART];
+
+// The even timers restart the next one from expireFunc, which needs the lock of the list
+void TestRestartExpireFunc(uintptr_t data, uintptr_t param[]) {
+    int n = param[0];
+
+    restartCount[n]++;
+    if (!(n % 2) && n + 1 < TEST_TIMER_NUM_OF_RESTART)
+        TimerStart(restartTimer[n + 1]);
+}
+
+// expireFunc can use timers of the list, and more timers than a batch expire in one check
+Status TestTimer_3() {
+    TimerList timerList;
+
+    memset(restartCount, 0, sizeof(restartCount));
+    TimerListInit(&timerList);
+
+    for (int n = 0; n < TEST_TIMER_NUM_OF_RESTART; n++) {
+        restartTimer[n] = TimerCreate(&timerList, TIMER_TYPE_ONCE, 20, TestRestartExpireFunc);
+        UTLT_Assert(restartTimer[n], return STATUS_ERROR, "Timer [%d] create fail", n);
+        TimerSet(PARAM1, restartTimer[n], n);
+    }
+
+    // The even ones expire together, each of them restarts the odd one after it
+    for (int n = 0; n < TEST_TIMER_NUM_OF_RESTART; n += 2)
+        TimerStart(restartTimer[n]);
+
+    usleep(TimeMsecToUsec(40));
+    TimerExpireCheck(&timerList, 0);
+    usleep(TimeMsecToUsec(40));
+    TimerExpireCheck(&timerList, 0);
+
+    for (int n = 0; n < TEST_TIMER_NUM_OF_RESTART; n++) {
+        UTLT_Assert(restartCount[n] == 1, return STATUS_ERROR,
+            "Timer [%d] expires %d times", n, restartCount[n]);
+        TimerDelete(restartTimer[n]);
+    }
+    TimerListTerm(&timerList);
+
+    return STATUS_OK;
+}
+
 Status TimerTest(void *data) {
     Status status;
 
@@ -219,6 +280,12 @@ Status TimerTest(void *data) {
     status = TestTimer_1();
     UTLT_Assert(status == STATUS_OK, return status, "TestTimer_1 fail");
 
+    status = TestTimer_2();
+    UTLT_Assert(status == STATUS_OK, return status, "TestTimer_2 fail");
+
+    status = TestTimer_3();
+    UTLT_Assert(status == STATUS_OK, return status, "TestTimer_3 fail");
+
     status = TimerFinal();
     UTLT_Assert(status == STATUS_OK, return status, "TimerFinal fail");
 
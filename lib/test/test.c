@@ -7,14 +7,20 @@
 static TestCase utltTestList[] = { 
     {"3gppTypesTest", _3gppTypesTest, NULL},
     {"BuffTest", BuffTest, NULL},
+    {"ClassifierTest", ClassifierTest, NULL},
     {"DebugTest", DebugTest, NULL},
     {"EventTest", EventTest, NULL},
     {"HashTest", HashTest, NULL},
     {"IndexTest", IndexTest, NULL},
+    {"IpFilterTest", IpFilterTest, NULL},
     {"ListTest", ListTest, NULL},
     {"MqTest", MqTest, NULL},
+    {"NetlinkTest", NetlinkTest, NULL},
     {"NetworkTest", NetworkTest, NULL},
     {"PoolTest", PoolTest, NULL},
+    {"RcuTest", RcuTest, NULL},
+    {"SlotTableTest", SlotTableTest, NULL},
+    {"SwissTableTest", SwissTableTest, NULL},
     {"ThreadTest", ThreadTest, NULL},
     {"TimeTest", TimeTest, NULL},
     {"TimerTest", TimerTest, NULL},
@@ -0,0 +1,244 @@
+#define TRACE_MODULE _udp_bench
+
+/*
+ * udp-bench - packets per second of UDP on loopback, one datagram per syscall
+ * by UdpSendTo and UdpRecvFrom against a batch by UdpBatchSend and UdpBatchRecv
+ *
+ * A sender and a receiver socket run in one thread, bursts of -b datagrams
+ * are sent and then received back. CPU time is taken from getrusage(), so
+ * packets per CPU second is the cost of both syscall paths on one core.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+#include <sys/resource.h>
+
+#include "utlt_debug.h"
+#include "utlt_network.h"
+
+#define UDP_BENCH_MAX_SIZE          1472
+#define UDP_BENCH_SOCK_BUF          (4 * 1024 * 1024)
+
+#define NSEC_PER_USEC               1000ULL
+#define NSEC_PER_SEC                1000000000ULL
+
+typedef struct {
+    const char *name;
+    uint64_t packets;
+    uint64_t lost;
+    uint64_t elapsed;   // nsec
+    uint64_t cpu;       // nsec
+} BenchResult;
+
+static struct {
+    // Options
+    const char  *addr;
+    int         port;
+    const char  *logLevel;
+    int         burst;
+    int         size;
+    uint32_t    duration;   // sec
+
+    Sock        *rx;
+    Sock        *tx;
+    UdpBatch    *rxBatch;
+    UdpBatch    *txBatch;
+    uint8_t     buf[UDP_BENCH_MAX_SIZE];
+} bench;
+
+static uint64_t BenchNow() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static uint64_t BenchCpu() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return ((uint64_t) (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * NSEC_PER_SEC +
+            (uint64_t) (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * NSEC_PER_USEC);
+}
+
+// Return the number of datagrams received of a burst
+static int BenchBurstSingle() {
+    int sent = 0, received = 0;
+
+    for (int i = 0; i < bench.burst; i++)
+        if (UdpSendTo(bench.tx, bench.buf, bench.size) == STATUS_OK)
+            sent++;
+
+    // Loopback has delivered what is sent, so nothing is waited for
+    for (int i = 0; i < sent; i++)
+        if (UdpRecvFrom(bench.rx, bench.buf, sizeof(bench.buf)) > 0)
+            received++;
+
+    return received;
+}
+
+static int BenchBurstBatch() {
+    int received = 0, num;
+
+    for (int i = 0; i < bench.burst; i++)
+        UdpBatchAdd(bench.txBatch, NULL, 0, bench.buf, bench.size, &bench.tx->remoteAddr);
+    int sent = UdpBatchSend(bench.tx, bench.txBatch);
+
+    while (received < sent && (num = UdpBatchRecv(bench.rx, bench.rxBatch)) > 0)
+        received += num;
+
+    return received;
+}
+
+static void BenchRun(BenchResult *result, int (*Burst)()) {
+    uint64_t start = BenchNow(), now = start, cpu = BenchCpu();
+    uint64_t end = start + bench.duration * NSEC_PER_SEC;
+    int received;
+
+    while (now < end) {
+        received = Burst();
+        result->packets += received;
+        result->lost += bench.burst - received;
+        now = BenchNow();
+    }
+
+    result->elapsed = now - start;
+    result->cpu = BenchCpu() - cpu;
+}
+
+static void BenchReport(BenchResult *result, int num) {
+    printf("\n%d datagrams of %d bytes per burst on %s, %u s for each\n\n",
+           bench.burst, bench.size, bench.addr, bench.duration);
+    printf("%-20s %12s %12s %10s %14s\n", "Path", "Packets", "Packets/s", "CPU s", "Packets/CPU s");
+
+    for (int i = 0; i < num; i++) {
+        printf("%-20s %12lu %12.0f %10.3f %14.0f\n", result[i].name, result[i].packets,
+               (double) result[i].packets * NSEC_PER_SEC / result[i].elapsed,
+               (double) result[i].cpu / NSEC_PER_SEC,
+               (result[i].cpu ? (double) result[i].packets * NSEC_PER_SEC / result[i].cpu : 0));
+        if (result[i].lost)
+            printf("%-20s %12lu datagrams are lost\n", "", result[i].lost);
+    }
+}
+
+static void BenchUsage(const char *name) {
+    printf("Usage: %s [options]\n"
+           "  -a addr     Loopback address (default: %s)\n"
+           "  -p port     UDP port of receiver, the sender binds port + 1 (default: %d)\n"
+           "  -b num      Datagrams per burst, at most %d (default: %d)\n"
+           "  -s bytes    UDP payload, at most %d (default: %d)\n"
+           "  -t sec      Seconds to run each path (default: %u)\n"
+           "  -v level    Log level (default: %s)\n"
+           "  -h          Show this help\n",
+           name, bench.addr, bench.port, MAX_NUM_OF_UDP_BATCH, bench.burst,
+           UDP_BENCH_MAX_SIZE, bench.size, bench.duration, bench.logLevel);
+}
+
+static Status BenchParseArgs(int argc, char *argv[]) {
+    int opt;
+
+    bench.addr = "127.0.0.1";
+    bench.port = 9100;
+    bench.logLevel = "warning";
+    bench.burst = MAX_NUM_OF_UDP_BATCH;
+    bench.size = 64;
+    bench.duration = 5;
+
+    while ((opt = getopt(argc, argv, "a:p:b:s:t:v:h")) != -1) {
+        switch (opt) {
+            case 'a':
+                bench.addr = optarg;
+                break;
+            case 'p':
+                bench.port = atoi(optarg);
+                break;
+            case 'b':
+                bench.burst = atoi(optarg);
+                break;
+            case 's':
+                bench.size = atoi(optarg);
+                break;
+            case 't':
+                bench.duration = strtoul(optarg, NULL, 0);
+                break;
+            case 'v':
+                bench.logLevel = optarg;
+                break;
+            case 'h':
+            default:
+                BenchUsage(argv[0]);
+                return STATUS_ERROR;
+        }
+    }
+
+    UTLT_Assert(bench.port > 0 && bench.port < 0xFFFF, return STATUS_ERROR,
+                "Port should be 1 to %d", 0xFFFE);
+    UTLT_Assert(bench.burst > 0 && bench.burst <= MAX_NUM_OF_UDP_BATCH, return STATUS_ERROR,
+                "Datagrams per burst should be 1 to %d", MAX_NUM_OF_UDP_BATCH);
+    UTLT_Assert(bench.size > 0 && bench.size <= UDP_BENCH_MAX_SIZE, return STATUS_ERROR,
+                "UDP payload should be 1 to %d bytes", UDP_BENCH_MAX_SIZE);
+    UTLT_Assert(bench.duration > 0, return STATUS_ERROR, "Seconds to run should be positive");
+
+    return STATUS_OK;
+}
+
+static Status BenchInit() {
+    int bufSize = UDP_BENCH_SOCK_BUF;
+
+    bench.rx = UdpServerCreate(AF_INET, bench.addr, bench.port);
+    UTLT_Assert(bench.rx, return STATUS_ERROR, "Receiver create fail: %s:%d", bench.addr, bench.port);
+    bench.tx = UdpServerCreate(AF_INET, bench.addr, bench.port + 1);
+    UTLT_Assert(bench.tx, return STATUS_ERROR, "Sender create fail: %s:%d", bench.addr, bench.port + 1);
+    UTLT_Assert(UdpSockSetAddr(&bench.tx->remoteAddr, AF_INET, bench.addr, bench.port) == STATUS_OK,
+                return STATUS_ERROR, "Address %s is not IPv4", bench.addr);
+
+    SockSetOpt(bench.rx, SOL_SOCKET, SO_RCVBUF, &bufSize);
+    SockSetOpt(bench.tx, SOL_SOCKET, SO_SNDBUF, &bufSize);
+
+    bench.rxBatch = UdpBatchAlloc(MAX_NUM_OF_UDP_BATCH, UDP_BENCH_MAX_SIZE);
+    UTLT_Assert(bench.rxBatch, return STATUS_ERROR, "Receive batch alloc fail");
+    bench.txBatch = UdpBatchAlloc(bench.burst, 0);
+    UTLT_Assert(bench.txBatch, return STATUS_ERROR, "Send batch alloc fail");
+
+    memset(bench.buf, 0xA5, sizeof(bench.buf));
+
+    return STATUS_OK;
+}
+
+static void BenchTerm() {
+    if (bench.rxBatch)
+        UdpBatchFree(bench.rxBatch);
+    if (bench.txBatch)
+        UdpBatchFree(bench.txBatch);
+    if (bench.rx)
+        UdpFree(bench.rx);
+    if (bench.tx)
+        UdpFree(bench.tx);
+}
+
+int main(int argc, char *argv[]) {
+    BenchResult result[] = {
+        {.name = "sendto/recvfrom"},
+        {.name = "sendmmsg/recvmmsg"},
+    };
+    int status = EXIT_FAILURE;
+
+    if (BenchParseArgs(argc, argv) != STATUS_OK)
+        return EXIT_FAILURE;
+    UTLT_Assert(UTLT_SetLogLevel(bench.logLevel) == STATUS_OK, return EXIT_FAILURE,
+                "Log level %s is not supported", bench.logLevel);
+    UTLT_Assert(SockPoolInit() == STATUS_OK, return EXIT_FAILURE, "SockPoolInit fail");
+    UTLT_Assert(BenchInit() == STATUS_OK, goto term, "Init fail");
+
+    BenchRun(&result[0], BenchBurstSingle);
+    BenchRun(&result[1], BenchBurstBatch);
+    BenchReport(result, sizeof(result) / sizeof(result[0]));
+    status = EXIT_SUCCESS;
+
+term:
+    BenchTerm();
+    SockPoolFinal();
+
+    return status;
+}
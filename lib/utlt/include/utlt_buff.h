@@ -23,10 +23,56 @@ typedef struct _Bufblk {
  * (X) Bufblk bufblk; ...
  ********************************************************************/
 
+#define MAX_NUM_OF_BUFBLK_CLASS 16
+#define MAX_SIZE_OF_BUFBLK      65536   // The largest buffer of BufblkAlloc()
+// The largest UTLT_Malloc(), which keeps the size in front of the buffer
+#define MAX_SIZE_OF_UTLT_MALLOC (MAX_SIZE_OF_BUFBLK - sizeof(uint32_t))
+
+/**
+ * BufblkPoolStat - Statistics of a size class in Bufblk pool
+ *
+ * @size: Capacity of buffers in this class, 0 is the class of Bufblk itself
+ * @numOfSlab, @capacity: Slabs and objects in them, which grow on demand
+ * @available: Objects in the shared free stack, not including thread caches
+ * @highWater: Most objects out of the shared free stack at a time
+ * @alloc, @free: Objects allocated and freed
+ * @hit: Allocations served by thread cache, without touching shared memory
+ * @refill, @flush: Times thread caches take from or give back to the shared free stack
+ * @grow: Slabs added
+ * @fail: Allocations failed, since this class reaches its slab limit or malloc fails
+ *
+ * @alloc, @free and @hit of a running thread are merged when it refills or flushes
+ */
+typedef struct {
+    uint32_t size;
+    uint32_t numOfSlab;
+    uint32_t capacity;
+    uint32_t available;
+    uint32_t highWater;
+    uint64_t alloc;
+    uint64_t free;
+    uint64_t hit;
+    uint64_t refill;
+    uint64_t flush;
+    uint64_t grow;
+    uint64_t fail;
+} BufblkPoolStat;
+
 Status BufblkPoolInit();
 Status BufblkPoolFinal();
 void BufblkPoolCheck(const char *showInfo);
 
+/**
+ * BufblkPoolStats - Get statistics of each size class
+ *
+ * @stat: Array of @num, MAX_NUM_OF_BUFBLK_CLASS is enough
+ * @return: The number of classes filled in @stat
+ */
+int BufblkPoolStats(BufblkPoolStat *stat, int num);
+
+// Log statistics of each size class in use
+void BufblkPoolReport();
+
 Bufblk *BufblkAlloc(uint32_t num, uint32_t size);
 Status BufblkResize(Bufblk *bufblk, uint32_t num, uint32_t size);
 Status BufblkClear(Bufblk *bufblk);
@@ -0,0 +1,78 @@
+#ifndef __UTLT_CLASSIFIER_H__
+#define __UTLT_CLASSIFIER_H__
+
+#include <stdint.h>
+
+#include "utlt_debug.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * Tuple space search classifier for IPv4 5-tuple filters.
+ *
+ * Rules sharing the same (protocol, source mask, destination mask) are put
+ * in one tuple with a hash table keyed by the masked fields, port lists are
+ * checked after the hash hit. A lookup costs one hash probe per tuple, and
+ * tuples are visited by their best rule, so it stops as soon as no tuple can
+ * beat the current match.
+ *
+ * A compiled Classifier is read-only, rebuild it when the rules change.
+ */
+
+#define PortStart(__u32) ((__u32) >> 16)
+#define PortEnd(__u32) ((__u32) & 0xFFFF)
+
+typedef struct {
+    // All in network type, 0 in mask or proto means wildcard
+    uint8_t proto;
+    uint32_t saddr, smask;
+    uint32_t daddr, dmask;
+
+    // Port range list, each one is packed as (start << 16 | end)
+    int sportNum;
+    const uint32_t *sportList;
+    int dportNum;
+    const uint32_t *dportList;
+
+    // Returned by ClassifierLookup when this rule is matched
+    void *data;
+} ClassifierRule;
+
+typedef struct {
+    uint8_t proto;
+    uint32_t saddr, daddr;      // Network type
+    int hasPort;
+    uint16_t sport, dport;      // Host type
+} ClassifierKey;
+
+typedef struct _Classifier Classifier;
+
+/**
+ * ClassifierCompile - Build a classifier from rules
+ *
+ * @rules: rules sorted by priority, the first one is the highest
+ * @num: number of @rules
+ * @return: compiled classifier or NULL if alloc failed, port lists are
+ *          referenced instead of copied, keep them until ClassifierFree
+ */
+Classifier *ClassifierCompile(const ClassifierRule *rules, int num);
+
+void ClassifierFree(Classifier *classifier);
+
+/**
+ * ClassifierLookup - Find the highest priority rule matching @key
+ *
+ * @return: data of the matched rule or NULL if nothing matched
+ */
+void *ClassifierLookup(const Classifier *classifier, const ClassifierKey *key);
+
+int ClassifierNumOfRule(const Classifier *classifier);
+int ClassifierNumOfTuple(const Classifier *classifier);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __UTLT_CLASSIFIER_H__ */
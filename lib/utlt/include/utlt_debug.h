@@ -5,6 +5,7 @@
 extern "C" {
 #endif /* __cplusplus */
 
+#include <stdint.h>
 #include <string.h>
 
 typedef int Status;
@@ -30,6 +31,27 @@ enum LogLevel {
     LOG_TRACE,
 };
 
+/*
+ * After UTLT_LogAsyncStart(), the caller only formats the log and copies it
+ * into the ring of its thread, a writer thread passes it to the logger.
+ * The log is dropped if the ring is full, the caller never waits for the
+ * logger. Panic and fatal logs are always written by the caller.
+ */
+Status UTLT_LogAsyncStart();
+// Logs queued before it are all written when it returns
+Status UTLT_LogAsyncStop();
+
+typedef struct {
+    uint64_t written;   // Written by the writer thread
+    uint64_t dropped;   // Dropped since the ring of the thread is full
+} UTLT_LogStat;
+
+void UTLT_LogGetStat(UTLT_LogStat *stat);
+
+// Where the formatted logs go, NULL sets back the Go logger
+typedef void (*UTLT_LogOutputFunc)(int level, const char *msg);
+void UTLT_SetLogOutput(UTLT_LogOutputFunc func);
+
 enum ReportCaller {
     REPORTCALLER_FALSE = 0,
     REPORTCALLER_TRUE,
@@ -37,22 +59,43 @@ enum ReportCaller {
     REPORTCALLER_MAX,
 };
 
+/*
+ * Log statements more verbose than UTLT_COMPILE_LOG_LEVEL are removed by the
+ * compiler, e.g. -DUTLT_COMPILE_LOG_LEVEL=LOG_INFO drops debug and trace logs.
+ * The others are checked against the level set by UTLT_SetLogLevel() before
+ * their arguments are evaluated.
+ */
+#ifndef UTLT_COMPILE_LOG_LEVEL
+#define UTLT_COMPILE_LOG_LEVEL LOG_TRACE
+#endif
+
+extern int utltLogLevel;
+
+#define UTLT_LogEnabled(level) ((level) <= UTLT_COMPILE_LOG_LEVEL && (level) <= utltLogLevel)
+
 #define __FILENAME__ (strstr(__FILE__, "/gofree5gc/src/upf/") ? strstr(__FILE__, "/gofree5gc/src/upf/") + 11 : __FILE__)
 
 #define UTLT_Panic(fmt, ...) \
-    UTLT_LogPrint(LOG_PANIC, __FILENAME__, __LINE__, __func__, fmt, ## __VA_ARGS__)
+    ((void) (UTLT_LogEnabled(LOG_PANIC) ? \
+        UTLT_LogPrint(LOG_PANIC, __FILENAME__, __LINE__, __func__, fmt, ## __VA_ARGS__) : 0))
 #define UTLT_Fatal(fmt, ...) \
-    UTLT_LogPrint(LOG_FATAL, __FILENAME__, __LINE__, __func__, fmt, ## __VA_ARGS__)
+    ((void) (UTLT_LogEnabled(LOG_FATAL) ? \
+        UTLT_LogPrint(LOG_FATAL, __FILENAME__, __LINE__, __func__, fmt, ## __VA_ARGS__) : 0))
 #define UTLT_Error(fmt, ...) \
-    UTLT_LogPrint(LOG_ERROR, __FILENAME__, __LINE__, __func__, fmt, ## __VA_ARGS__)
+    ((void) (UTLT_LogEnabled(LOG_ERROR) ? \
+        UTLT_LogPrint(LOG_ERROR, __FILENAME__, __LINE__, __func__, fmt, ## __VA_ARGS__) : 0))
 #define UTLT_Warning(fmt, ...) \
-    UTLT_LogPrint(LOG_WARNING, __FILENAME__, __LINE__, __func__, fmt, ## __VA_ARGS__)
+    ((void) (UTLT_LogEnabled(LOG_WARNING) ? \
+        UTLT_LogPrint(LOG_WARNING, __FILENAME__, __LINE__, __func__, fmt, ## __VA_ARGS__) : 0))
 #define UTLT_Info(fmt, ...) \
-    UTLT_LogPrint(LOG_INFO, __FILENAME__, __LINE__, __func__, fmt, ## __VA_ARGS__)
+    ((void) (UTLT_LogEnabled(LOG_INFO) ? \
+        UTLT_LogPrint(LOG_INFO, __FILENAME__, __LINE__, __func__, fmt, ## __VA_ARGS__) : 0))
 #define UTLT_Debug(fmt, ...) \
-    UTLT_LogPrint(LOG_DEBUG, __FILENAME__, __LINE__, __func__, fmt, ## __VA_ARGS__)
+    ((void) (UTLT_LogEnabled(LOG_DEBUG) ? \
+        UTLT_LogPrint(LOG_DEBUG, __FILENAME__, __LINE__, __func__, fmt, ## __VA_ARGS__) : 0))
 #define UTLT_Trace(fmt, ...) \
-    UTLT_LogPrint(LOG_TRACE, __FILENAME__, __LINE__, __func__, fmt, ## __VA_ARGS__)
+    ((void) (UTLT_LogEnabled(LOG_TRACE) ? \
+        UTLT_LogPrint(LOG_TRACE, __FILENAME__, __LINE__, __func__, fmt, ## __VA_ARGS__) : 0))
 
 #define UTLT_Assert(cond, expr, fmt, ...) \
     if (!(cond)) { \
@@ -62,7 +105,8 @@ enum ReportCaller {
 
 #define UTLT_Level_Assert(level, cond, expr, fmt, ...) \
     if (!(cond)) { \
-        UTLT_LogPrint(level, __FILENAME__, __LINE__, __func__, fmt, ## __VA_ARGS__); \
+        if (UTLT_LogEnabled(level)) \
+            UTLT_LogPrint(level, __FILENAME__, __LINE__, __func__, fmt, ## __VA_ARGS__); \
         expr; \
     }
 
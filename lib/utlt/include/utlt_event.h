@@ -31,6 +31,12 @@ typedef struct {
 #define EVTQ_O_BLOCK        0
 #define EVTQ_O_NONBLOCK     O_NONBLOCK
 
+/*
+ * Event queue is an in-process ring, any thread can send events but only
+ * one thread receives them. A blocked receiver sleeps on an eventfd.
+ */
+#define SIZE_OF_EVENT_QUEUE 4096    // Must be power of 2
+
 /**
  * @param  option: either EVTQ_O_BLOCK or EVTQ_O_NONBLOCK.
  * @return eqId or NULL on error.
@@ -51,11 +57,35 @@ Status EventQueueDelete(EvtQId eqId);
  */
 Status EventSend(EvtQId eqId, uintptr_t eventType, int argc, ...);
 
+/**
+ * The same as EventSend(), but never waits for the receiver even if the
+ * queue is EVTQ_O_BLOCK, for senders which must not stall like packet path.
+ *
+ * @return STATUS_OK or STATUS_EAGAIN if the queue is full.
+ */
+Status EventTrySend(EvtQId eqId, uintptr_t eventType, int argc, ...);
+
 /**
  * @return  STATUS_OK or STATUS_EAGAIN if the queue is empty and the oflag O_NONBLOCK was set.
  */
 Status EventRecv(EvtQId eqId, Event *event);
 
+/**
+ * Receive at most @num events at once, it blocks until at least one event
+ * is received unless the oflag O_NONBLOCK was set.
+ *
+ * @return  number of events received, 0 if the queue is empty and the oflag O_NONBLOCK was set, -1 on error.
+ */
+int EventRecvBatch(EvtQId eqId, Event *events, int num);
+
+/**
+ * The same as EventRecvBatch(), but never waits even if the queue is
+ * EVTQ_O_BLOCK, for receivers which have other work before sleeping.
+ *
+ * @return  number of events received, 0 if the queue is empty, -1 on error.
+ */
+int EventTryRecvBatch(EvtQId eqId, Event *events, int num);
+
 TimerBlkID EventTimerCreate(TimerList *timerList, int type, uint32_t duration, uintptr_t event);
 
 #ifdef __cplusplus
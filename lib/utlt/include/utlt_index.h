@@ -1,79 +1,164 @@
 #ifndef __INDEX_H__
 #define __INDEX_H__
 
+#include <stdint.h>
 #include <string.h>
 #include <pthread.h>
 
 #include "utlt_debug.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
 /*****************************************************************************
  * The structure must have variable named "index" when it is in the parameter.
  * Do not modify the variable named "index" after call function "IndexAlloc".
  * How to use the Index can look the test file "testIndex".
+ *
+ * Objects are carved from chunks which are malloc'ed when the pool runs out,
+ * until the capacity given to IndexInit() is reached, so a large capacity
+ * costs nothing before it is used. Chunks are never moved or freed before
+ * IndexTerminate(), so the index of an object is stable for IndexFind().
  *****************************************************************************/
 
-#define IndexDeclare(__name, __type, __cap) \
-    typedef struct { \
-        int qFront, qEnd, qCap; \
-        int arrayForIndex[__cap + 1]; \
-        __type *queueAvail[__cap + 1], pool[__cap + 1]; \
-        pthread_mutex_t lock; \
-    } index##__name##_t; \
-    index##__name##_t __name
+#define MAX_NUM_OF_INDEX_POOL       64      // Pools with thread caches and statistics
+
+/*
+ * Flags of IndexPoolInit(). With INDEX_POOL_HUGEPAGE, address space of the full
+ * capacity is reserved by mmap() at init, on hugepages reserved by the system
+ * if there are enough, otherwise on transparent hugepages. Pages are still
+ * only touched when chunks grow, so resident memory follows the usage.
+ */
+#define INDEX_POOL_HUGEPAGE         0x1
+
+/**
+ * IndexPoolStat - Statistics of an Index or a Pool
+ *
+ * @name: Variable name given to IndexDeclare() or PoolDeclare()
+ * @size: Bytes of an object
+ * @capacity: Most objects it can have
+ * @numOfChunk, @allocated: Chunks and objects in them, which grow on demand
+ * @used: Objects allocated and not freed
+ * @highWater: Most objects used at a time
+ * @memory: Bytes of chunks
+ * @reserved: Bytes of address space reserved by mmap(), 0 if chunks are malloc'ed
+ * @backing: "malloc", "hugetlb" or "thp", where chunks come from
+ * @fail: Allocations failed, since it is full or malloc fails
+ */
+typedef struct {
+    const char *name;
+    uint32_t size;
+    uint32_t capacity;
+    uint32_t numOfChunk;
+    uint32_t allocated;
+    uint32_t used;
+    uint32_t highWater;
+    uint64_t memory;
+    uint64_t reserved;
+    const char *backing;
+    uint64_t fail;
+} IndexPoolStat;
+
+/**
+ * IndexPool - Growable pool of objects in the same type
+ *
+ * @head: Top of free stack, which is index + 1 in low 32 bits and a tag
+ *        in high 32 bits, so a stale pop fails its compare-and-swap
+ * @used: Objects allocated and not freed, those cached by threads are free
+ * @chunk: Array of @maxChunk chunks, NULL if not grown yet
+ * @region, @regionSize: Address space mmap'ed for all chunks, NULL if they are malloc'ed
+ * @cacheCap: Objects cached by a thread, 0 if the pool is too small to cache
+ * @id: Slot in thread caches and statistics, -1 if there is no slot
+ *
+ * @name and @size are set by IndexDeclare(), the others by IndexInit()
+ */
+typedef struct {
+    uint64_t head __attribute__((aligned(64)));
+    uint32_t used __attribute__((aligned(64)));
+    uint32_t highWater;
+
+    const char *name __attribute__((aligned(64)));
+    uint32_t size;
+    uint32_t stride;
+    uint32_t capacity;
+    uint32_t chunkShift;    // Objects per chunk is 1 << chunkShift
+    uint32_t maxChunk;
+    uint32_t numOfChunk;
+    uint32_t allocated;
+    uint32_t cacheCap;
+    uint32_t generation;
+    int id;
+    int initialized;
+    uint32_t flags;
+    uint8_t **chunk;
+    uint8_t *region;
+    size_t regionSize;
+    const char *backing;
+    pthread_mutex_t growLock;
+    uint64_t fail;
+} IndexPool;
+
+/**
+ * IndexPoolInit - Set the capacity of a declared pool, nothing is allocated until it is used
+ *
+ * @flags: 0 or INDEX_POOL_HUGEPAGE
+ */
+Status IndexPoolInit(IndexPool *pool, uint32_t capacity, uint32_t flags);
+Status IndexPoolFinal(IndexPool *pool);
+
+/**
+ * IndexPoolAlloc - Take an object from pool without clearing it
+ *
+ * @index: Filled with the index of object if it is not NULL
+ * @return: The object, or NULL if the pool is full
+ */
+void *IndexPoolAlloc(IndexPool *pool, uint32_t *index);
+Status IndexPoolFree(IndexPool *pool, void *ptr);
+
+// Return the object of @index whether it is in use or not, NULL if it has not been grown
+void *IndexPoolFind(IndexPool *pool, uint32_t index);
+
+/**
+ * IndexPoolStats - Get statistics of each initialized pool
+ *
+ * @stat: Array of @num, MAX_NUM_OF_INDEX_POOL is enough
+ * @return: The number of pools filled in @stat
+ */
+int IndexPoolStats(IndexPoolStat *stat, int num);
+
+// Log statistics of each pool in use
+void IndexPoolReport();
+
+#define IndexDeclare(__name, __type) \
+    IndexPool __name = { .name = #__name, .size = sizeof(__type) }
 
 // The number of available space in this pool
 #define IndexSize(__nameptr) \
-    ((((__nameptr)->qEnd + (__nameptr)->qCap + 1 - (__nameptr)->qFront)) % ((__nameptr)->qCap + 1))
+    ((__nameptr)->capacity - __atomic_load_n(&(__nameptr)->used, __ATOMIC_RELAXED))
 
 // Total space of this pool, including used and unused
-#define IndexCap(__nameptr) ((__nameptr)->qCap)
-
-#define IndexInit(__nameptr, __cap) do { \
-    (__nameptr)->qFront = 0; \
-    (__nameptr)->qEnd = __cap; \
-    (__nameptr)->qCap = __cap; \
-    for (int __i = 0; __i < __cap; __i++) { \
-        (__nameptr)->arrayForIndex[__i] = __i; \
-        (__nameptr)->queueAvail[__i] = &((__nameptr)->pool[__i]); \
-    } \
-    pthread_mutex_init(&(__nameptr)->lock, 0); \
-    UTLT_Trace("Index Init Finish: %d", IndexSize(__nameptr)); \
-} while(0)
+#define IndexCap(__nameptr) ((__nameptr)->capacity)
 
-#define IndexTerminate(__nameptr) pthread_mutex_destroy(&(__nameptr)->lock)
+#define IndexInit(__nameptr, __cap) IndexPoolInit(__nameptr, __cap, 0)
+
+#define IndexTerminate(__nameptr) IndexPoolFinal(__nameptr)
 
 #define IndexAlloc(__nameptr, __assignedPtr) do { \
-    pthread_mutex_lock(&(__nameptr)->lock); \
-    if (IndexSize(__nameptr) > 0) { \
-        (__assignedPtr) = (__nameptr)->queueAvail[(__nameptr)->qFront]; \
-        memset((__assignedPtr), 0, sizeof(*((__nameptr)->queueAvail[(__nameptr)->qFront]))); \
-        (__assignedPtr)->index = (__nameptr)->arrayForIndex[(__nameptr)->qFront]; \
-        (__nameptr)->qFront = ((__nameptr)->qFront + 1) % ((__nameptr)->qCap + 1); \
-        UTLT_Debug("Index alloc successful, total capacity[%d], available[%d]" \
-        , IndexCap(__nameptr), IndexSize(__nameptr)); \
-    } else { \
-        (__assignedPtr) = NULL; \
-        UTLT_Warning("Index Pool is empty"); \
+    uint32_t __index; \
+    (__assignedPtr) = IndexPoolAlloc(__nameptr, &__index); \
+    if (__assignedPtr) { \
+        memset((__assignedPtr), 0, sizeof(*(__assignedPtr))); \
+        (__assignedPtr)->index = __index; \
     } \
-    pthread_mutex_unlock(&(__nameptr)->lock); \
 } while(0)
 
+#define IndexFree(__nameptr, __assignedPtr) IndexPoolFree(__nameptr, __assignedPtr)
 
-#define IndexFree(__nameptr, __assignedPtr) do { \
-    pthread_mutex_lock(&(__nameptr)->lock); \
-    if (IndexSize(__nameptr) < (__nameptr)->qCap) { \
-        (__nameptr)->queueAvail[(__nameptr)->qEnd] = (__assignedPtr); \
-        (__nameptr)->arrayForIndex[(__nameptr)->qEnd] = (__assignedPtr)->index; \
-        (__nameptr)->qEnd = ((__nameptr)->qEnd + 1) % ((__nameptr)->qCap + 1); \
-        UTLT_Debug("Index Free successful, total capacity[%d], available[%d]" \
-        , IndexCap(__nameptr), IndexSize(__nameptr)); \
-    } else { \
-        UTLT_Error("Index Pool is full, it may not belong to this pool"); \
-    } \
-    pthread_mutex_unlock(&(__nameptr)->lock); \
-} while(0)
-
+#define IndexFind(__nameptr, __index) IndexPoolFind(__nameptr, __index)
 
-#define IndexFind(__nameptr, __index) (void *) &(__nameptr)->pool[__index];
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
 
 #endif /* __INDEX_H__ */
@@ -0,0 +1,74 @@
+#ifndef __UTLT_IPFILTER_H__
+#define __UTLT_IPFILTER_H__
+
+#include <stdint.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "utlt_debug.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * Tokenizer of IPFilterRule (RFC 6733) used in SDF filter flow description:
+ *
+ *   permit (in|out) (ip|<proto>) from <addr> [<ports>] to <addr> [<ports>]
+ *
+ *   <addr>  = any | assigned | <IPv4>[/<0-32>] | <IPv6>[/<0-128>]
+ *   <ports> = <port>[-<port>][,<port>[-<port>]]...
+ *
+ * Fields are separated by exactly one space and keywords are case insensitive.
+ * It works on the input string in place and never allocates memory.
+ */
+
+#define MAX_NUM_OF_IPFILTER_PORT 16
+
+#define IPFILTER_DIRECTION_IN   0
+#define IPFILTER_DIRECTION_OUT  1
+
+#define IPFILTER_ADDR_ANY       0
+#define IPFILTER_ADDR_ASSIGNED  1
+#define IPFILTER_ADDR_IPV4      2
+#define IPFILTER_ADDR_IPV6      3
+
+typedef struct {
+    uint8_t type;
+    uint8_t prefixLen;  // 32 or 128 if no mask is given
+    union {
+        struct in_addr ipv4;
+        struct in6_addr ipv6;
+    };
+
+    // Each port range is packed as (start << 16 | end) in host type, start <= end
+    int portNum;
+    uint32_t portList[MAX_NUM_OF_IPFILTER_PORT];
+} IPFilterAddr;
+
+typedef struct {
+    uint8_t direction;
+    uint8_t proto;      // 0 means "ip", any protocol
+    IPFilterAddr src;
+    IPFilterAddr dst;
+} IPFilterRule;
+
+/**
+ * IPFilterRuleParse - Parse a flow description into @rule
+ *
+ * @str: flow description, it does NOT need to end with '\0'
+ * @len: length of @str
+ * @return: STATUS_OK or STATUS_ERROR if @str is not a supported IPFilterRule
+ */
+Status IPFilterRuleParse(IPFilterRule *rule, const char *str, int len);
+
+// Network type IPv4 mask of a prefix length
+static inline uint32_t IPFilterIPv4Mask(uint8_t prefixLen) {
+    return prefixLen ? htonl(0xFFFFFFFFu << (32 - prefixLen)) : 0;
+}
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __UTLT_IPFILTER_H__ */
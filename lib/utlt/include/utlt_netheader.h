@@ -7,8 +7,8 @@
 
 typedef struct {
 ENDIAN2(
-    uint8_t     ihl:4;,
-    uint8_t     version:4;
+    uint8_t     version:4;,
+    uint8_t     ihl:4;
 )
     uint8_t     tos;
     uint16_t    totalLen;
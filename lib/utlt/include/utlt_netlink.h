@@ -0,0 +1,84 @@
+#ifndef __UTLT_NETLINK_H__
+#define __UTLT_NETLINK_H__
+
+#include <stdint.h>
+#include <linux/netlink.h>
+
+#include "utlt_debug.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * Batch of netlink request messages on a socket kept open by the caller.
+ *
+ * Messages are built in place at NetlinkBatchMsgBuf(), queued by
+ * NetlinkBatchMsgPut() and sent by NetlinkBatchFlush() in a single send(),
+ * then the ACK of every message is collected at once. The kernel handles the
+ * messages of one send() in order, so a batch keeps the order of operations.
+ *
+ * It only uses send() and recv() on @fd, so the same code works on a
+ * NETLINK_GENERIC socket and on a stub responder over a socketpair.
+ */
+
+// Room reserved for each message built in the batch buffer
+#define MAX_SIZE_OF_NETLINK_MSG     8192
+#define SIZE_OF_NETLINK_BATCH       (8 * MAX_SIZE_OF_NETLINK_MSG)
+
+typedef struct {
+    int fd;
+    uint32_t seq;           // seq of the next queued message
+    int len;                // bytes queued in buf
+    int numOfMsg;           // messages queued in buf
+
+    // ACK errors of messages flushed before NetlinkBatchFlush() is called
+    int pendingFail;
+    int pendingError;
+
+    // Result of the last NetlinkBatchFlush()
+    int numOfFail;          // number of messages NACKed
+    int error;              // positive errno of the first NACKed message
+    int sockError;          // errno of send() or recv(), kept until the socket is reopened
+
+    char buf[SIZE_OF_NETLINK_BATCH] __attribute__((aligned(NLMSG_ALIGNTO)));
+} NetlinkBatch;
+
+Status NetlinkBatchInit(NetlinkBatch *batch, int fd, uint32_t seq);
+
+// Drop the queued messages, @batch can be reused after NetlinkBatchInit()
+Status NetlinkBatchTerm(NetlinkBatch *batch);
+
+/**
+ * NetlinkBatchMsgBuf - Get the buffer to build the next message
+ *
+ * At least MAX_SIZE_OF_NETLINK_MSG bytes are usable, the queued messages
+ * are flushed first if there is not enough room.
+ * @return: NULL if the socket fails while flushing
+ */
+struct nlmsghdr *NetlinkBatchMsgBuf(NetlinkBatch *batch);
+
+/**
+ * NetlinkBatchMsgPut - Queue the message built at NetlinkBatchMsgBuf()
+ *
+ * nlmsg_seq is overwritten and NLM_F_ACK is always requested
+ */
+Status NetlinkBatchMsgPut(NetlinkBatch *batch, struct nlmsghdr *nlh);
+
+/**
+ * NetlinkBatchFlush - Send the queued messages and wait for all of their ACKs
+ *
+ * @return: STATUS_OK if every message queued since the last flush is ACKed
+ *          without error, numOfFail, error and sockError tell the details
+ */
+Status NetlinkBatchFlush(NetlinkBatch *batch);
+
+static inline int NetlinkBatchNumOfMsg(const NetlinkBatch *batch) {
+    return batch->numOfMsg;
+}
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __UTLT_NETLINK_H__ */
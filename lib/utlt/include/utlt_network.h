@@ -132,11 +132,93 @@ Sock *UdpSockCreate(int domain);
 Status UdpSockSetAddr(SockAddr *sockAddr, int domain, const char *addr, int port);
 Sock *UdpServerCreate(int domain, const char *addr, int port);
 Sock *UdpClientCreate(int domain, const char *addr, int port);
+
+/**
+ * UdpReusePortServerCreate - Create UDP server with SO_REUSEPORT, so that
+ * sockets bound on the same @addr and @port share packets as a group
+ *
+ * @return: Sock pointer or NULL if it fails, e.g. a socket without SO_REUSEPORT has bound it
+ */
+Sock *UdpReusePortServerCreate(int domain, const char *addr, int port);
+
+/**
+ * UdpReusePortSteerByTeid - Steer GTP-U to the sockets in the SO_REUSEPORT group of @sock
+ * by hash of TEID, so packets of a tunnel always go to the same socket in order
+ *
+ * @sock: One of the group
+ * @num: Sockets in the group, indexed by the order they are bound
+ * @tpduIndex: Socket taking all T-PDUs, e.g. the one decapsulated by kernel,
+ *             or -1 to hash T-PDUs as the others
+ * @return: STATUS_OK or STATUS_ERROR if @num is invalid or the filter is not attached
+ *
+ * Other messages are hashed by TEID and source address over the sockets except @tpduIndex,
+ * since echo has no TEID.
+ */
+Status UdpReusePortSteerByTeid(Sock *sock, int num, int tpduIndex);
 #define UdpRecvFrom(__sock, __buffer, __size) \
         SockRecvFrom(__sock, __buffer, __size)
 #define UdpSendTo(__sock, __buffer, __size) \
         SockSendTo(__sock, __buffer, __size)
 
+/*
+ * UDP batch, which moves up to MAX_NUM_OF_UDP_BATCH datagrams in one syscall
+ * by recvmmsg or sendmmsg. Headers and buffers are allocated with the batch
+ * and reused by every call, so there is no allocation per datagram.
+ */
+#define MAX_NUM_OF_UDP_BATCH 64
+
+typedef struct _UdpBatch UdpBatch;
+
+/**
+ * UdpBatchAlloc - Alloc a batch of @size datagrams
+ *
+ * @size: Datagrams at most, no more than MAX_NUM_OF_UDP_BATCH
+ * @bufSize: Receive buffer of each datagram, or 0 if the batch is only used to send
+ * @return: UdpBatch pointer or NULL if alloc fail
+ */
+UdpBatch *UdpBatchAlloc(int size, int bufSize);
+Status UdpBatchFree(UdpBatch *batch);
+
+// Datagrams received or queued in @batch
+int UdpBatchCount(UdpBatch *batch);
+int UdpBatchFull(UdpBatch *batch);
+
+/**
+ * UdpBatchRecv - Receive datagrams of @sock into @batch without blocking
+ *
+ * @return: the number of datagrams, 0 if there is none, or -1 if it fails
+ */
+int UdpBatchRecv(Sock *sock, UdpBatch *batch);
+
+/**
+ * UdpBatchGet - Get the @idx datagram received by UdpBatchRecv()
+ *
+ * @len: Length of the datagram
+ * @from: Sender, or NULL if it is not needed
+ * @return: the datagram in the buffer of @batch
+ */
+uint8_t *UdpBatchGet(UdpBatch *batch, int idx, int *len, SockAddr *from);
+
+/**
+ * UdpBatchAdd - Queue a datagram of @hdr followed by @payload to @to
+ *
+ * Both are referred but not copied, so they shall be kept until UdpBatchSend().
+ * @hdr can be NULL, e.g. @payload is the whole datagram.
+ *
+ * @return: STATUS_OK or STATUS_ERROR if @batch is full
+ */
+Status UdpBatchAdd(UdpBatch *batch, const void *hdr, int hdrLen,
+                   const void *payload, int payloadLen, const SockAddr *to);
+
+/**
+ * UdpBatchSend - Send all datagrams queued in @batch by @sock, and empty it
+ *
+ * A datagram which fails to send is skipped, e.g. its peer is unreachable
+ *
+ * @return: the number of datagrams sent
+ */
+int UdpBatchSend(Sock *sock, UdpBatch *batch);
+
 // Unix Socket (AF_UNIX)
 Sock *UnixSockCreate(int type);
 Status UnixFree(Sock *sock);
@@ -0,0 +1,108 @@
+#ifndef __UTLT_RCU_H__
+#define __UTLT_RCU_H__
+
+#include <stdint.h>
+
+#include "utlt_debug.h"
+#include "utlt_list.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * Epoch based read-copy-update for read-mostly tables.
+ *
+ * Readers wrap their lookup with RcuReadLock()/RcuReadUnlock(), they never
+ * take a lock and never wait for a writer. Writers still serialize with each
+ * other by their own mutex, publish new nodes with the Rcu list helpers and
+ * call RcuSynchronize() after unlinking a node, before reusing or freeing it.
+ * Writers of different tables wait for grace periods in parallel.
+ *
+ * A writer which must not wait hands the free to RcuDefer() instead, and
+ * calls RcuDeferPoll() once after a batch of updates, so the whole batch
+ * shares one grace period.
+ */
+
+// Every thread that ever reads takes one slot until it calls RcuThreadOffline()
+#define MAX_NUM_OF_RCU_READER   256
+
+#define RcuAssignPointer(__ptr, __val) __atomic_store_n(&(__ptr), (__val), __ATOMIC_RELEASE)
+
+#define RcuDereference(__ptr) __atomic_load_n(&(__ptr), __ATOMIC_ACQUIRE)
+
+void RcuReadLock();
+void RcuReadUnlock();
+
+/**
+ * RcuSynchronize - Wait until every read-side critical section running at the call has finished
+ *
+ * It must NOT be called inside a read-side critical section
+ */
+void RcuSynchronize();
+
+/**
+ * RcuThreadOffline - Call the deferred callbacks and give back the reader slot of the calling thread,
+ * used before the thread exits
+ */
+void RcuThreadOffline();
+
+// Number of grace periods waited by RcuSynchronize() and the deferred frees
+uint64_t RcuGracePeriodCount();
+
+typedef void (*RcuCallback)(void *arg);
+
+/**
+ * RcuDefer - Call @func with @arg after the read-side critical sections running at the call
+ *
+ * Callbacks are queued in the calling thread and only called by it, in
+ * RcuDeferPoll() or RcuDeferFlush(). If the queue is full, it flushes first.
+ */
+void RcuDefer(RcuCallback func, void *arg);
+
+/**
+ * RcuDeferPoll - Start one grace period for the callbacks deferred since the last poll,
+ * and call the callbacks whose grace period has passed, without waiting
+ *
+ * @return: number of callbacks still waiting
+ */
+int RcuDeferPoll();
+
+/**
+ * RcuDeferFlush - Wait and call all callbacks deferred by the calling thread
+ *
+ * It must NOT be called inside a read-side critical section
+ */
+void RcuDeferFlush();
+
+/*
+ * List helpers, the writer side should hold its own lock.
+ * The entry removed by ListRemoveRcu() keeps its next pointer, so that
+ * readers on it can still walk off. Do ListHeadInit() or free it only
+ * after RcuSynchronize().
+ */
+#define ListInsertRcu(__newPtr, __namePtr) do { \
+    ListHead *__rcuPrev = (ListHead *) (__namePtr); \
+    ListHead *__rcuNext = __rcuPrev->next; \
+    ((ListHead *) (__newPtr))->next = __rcuNext; \
+    ((ListHead *) (__newPtr))->prev = __rcuPrev; \
+    RcuAssignPointer(__rcuPrev->next, (ListHead *) (__newPtr)); \
+    __rcuNext->prev = (ListHead *) (__newPtr); \
+} while (0)
+
+#define ListRemoveRcu(__entry) do { \
+    ListHead *__rcuEntry = (ListHead *) (__entry); \
+    __rcuEntry->next->prev = __rcuEntry->prev; \
+    RcuAssignPointer(__rcuEntry->prev->next, __rcuEntry->next); \
+} while (0)
+
+#define ListForEachRcu(__nodePtr, __namePtr) \
+    for (__nodePtr = (void *) RcuDereference(((ListHead *) (__namePtr))->next); \
+         (void *) __nodePtr != (void *) (__namePtr); \
+         __nodePtr = (void *) RcuDereference(((ListHead *) (__nodePtr))->next))
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __UTLT_RCU_H__ */
@@ -0,0 +1,119 @@
+#ifndef __UTLT_SLOTTABLE_H__
+#define __UTLT_SLOTTABLE_H__
+
+#include <stdint.h>
+
+#include "utlt_debug.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * Table of objects at the index given by their pool, found by a 64-bit
+ * handle without hashing.
+ *
+ * The handle is a tag of the caller in the top 16 bits, the generation of
+ * the slot in the next 16 bits and the index + 1 in the low 32 bits, so it
+ * is never 0. The generation is bumped when the slot is cleared, so a stale
+ * handle does not find the next object in the same slot until the 16-bit
+ * generation wraps.
+ *
+ * A slot is only written by one thread at a time, which the caller ensures.
+ * SlotTableGet() reads it without lock, call it in RCU read-side critical
+ * section if the object may be freed by another thread.
+ */
+
+#define SLOT_HANDLE_TAG_SHIFT           48
+#define SLOT_HANDLE_GENERATION_SHIFT    32
+#define SlotHandleTag(__handle)         ((uint32_t) ((__handle) >> SLOT_HANDLE_TAG_SHIFT))
+#define SlotHandleGeneration(__handle)  ((uint16_t) ((__handle) >> SLOT_HANDLE_GENERATION_SHIFT))
+#define SlotHandleIndex(__handle)       ((uint32_t) (__handle) - 1)
+
+#define SlotHandleBuild(__tag, __generation, __index) \
+    (((uint64_t) (uint16_t) (__tag) << SLOT_HANDLE_TAG_SHIFT) \
+     | ((uint64_t) (uint16_t) (__generation) << SLOT_HANDLE_GENERATION_SHIFT) \
+     | ((uint64_t) (uint32_t) (__index) + 1))
+
+typedef struct {
+    void            *obj;
+    uint32_t        generation;
+} SlotTableEntry;
+
+/**
+ * SlotTable - Objects by index, found by handle
+ *
+ * @slot: @capacity slots, whose pages are only taken when they are used
+ */
+typedef struct {
+    SlotTableEntry  *slot;
+    uint32_t        capacity;
+} SlotTable;
+
+Status SlotTableInit(SlotTable *table, uint32_t capacity);
+Status SlotTableFinal(SlotTable *table);
+
+/**
+ * SlotTableSet - Put @obj in the empty slot of @index
+ *
+ * @tag: Kept in the top 16 bits of the handle, not checked by SlotTableGet()
+ * @return: The handle of @obj, or 0 if @index is out of range or taken
+ */
+uint64_t SlotTableSet(SlotTable *table, uint32_t index, uint16_t tag, void *obj);
+
+// Empty the slot of @index and bump its generation, return the object in it or NULL
+void *SlotTableClear(SlotTable *table, uint32_t index);
+
+// Return the object of @handle, or NULL if the slot is empty or of another generation
+void *SlotTableGet(SlotTable *table, uint64_t handle);
+
+// Return the object at @index whatever its generation is, @index must be in range
+#define SlotTableAt(__table, __index) \
+    __atomic_load_n(&(__table)->slot[(__index)].obj, __ATOMIC_ACQUIRE)
+
+/*
+ * Open addressing index from a hash to slots of a table, by linear probing.
+ *
+ * An entry keeps the full hash, so the key is only compared with the object
+ * of the slot when the hashes are the same. There are at least twice as many
+ * entries as the capacity, so a probe always ends at an empty entry. Removed
+ * entries are filled by shifting back the entries after them, so no
+ * tombstone is left and probes do not grow with churn.
+ *
+ * It is not thread safe, readers and writers must hold a lock of the caller.
+ */
+
+// Entry of SlotIndex, empty if @slot is 0
+typedef struct {
+    uint32_t        hash;
+    uint32_t        slot;               // Index in the table + 1
+} SlotIndexEntry;
+
+typedef struct {
+    SlotIndexEntry  *entry;
+    uint32_t        mask;               // Entries - 1
+} SlotIndex;
+
+// Return if the object at @index of the table has @key
+typedef int (*SlotIndexEqual)(uint32_t index, const void *key);
+
+// Init the index of at most @capacity entries in use at once
+Status SlotIndexInit(SlotIndex *index, uint32_t capacity);
+Status SlotIndexFinal(SlotIndex *index);
+
+// Return the entry of @key, or the empty entry ending its probe to be filled
+SlotIndexEntry *SlotIndexProbe(SlotIndex *index, uint32_t hash,
+                               SlotIndexEqual equal, const void *key);
+
+// Fill @entry returned by SlotIndexProbe() with the object at @slotIndex
+#define SlotIndexFill(__entry, __hash, __slotIndex) \
+    do { (__entry)->hash = (__hash); (__entry)->slot = (__slotIndex) + 1; } while (0)
+
+// Empty @entry returned by SlotIndexProbe(), the entries after it may be moved
+void SlotIndexRemove(SlotIndex *index, SlotIndexEntry *entry);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __UTLT_SLOTTABLE_H__ */
@@ -0,0 +1,97 @@
+#ifndef __UTLT_SWISSTABLE_H__
+#define __UTLT_SWISSTABLE_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#include "utlt_debug.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * Open addressing hash table of 64-bit keys in the layout of Swiss table.
+ *
+ * Each slot has a control byte, which is empty, deleted or 7 bits of the
+ * hash of its key. Control bytes of a group of slots are compared with the
+ * hash at once, by SSE2 in groups of 16 or 8 bytes in a word without it,
+ * so a lookup usually reads one line of control bytes and the matched slot.
+ *
+ * A slot is only a pointer to the object, which holds its own key at the
+ * offset given to SwissTableInit(). The key is checked on the object, which
+ * the caller reads next anyway.
+ *
+ * SwissTableGet() takes no lock, call it in RCU read-side critical section.
+ * Writers are serialized by the lock of the table. An object deleted or
+ * replaced can still be returned to readers until RcuSynchronize(). The
+ * table is rebuilt in the same size when deleted slots leave no room, and
+ * the old slots are freed by RcuDefer() of the writer after unlock, so
+ * writers must call RcuDeferPoll() or RcuDeferFlush() and must NOT be in
+ * read-side critical section.
+ */
+
+typedef struct _SwissTableData SwissTableData;
+
+/**
+ * SwissTable - Hash table of objects with a 64-bit key
+ *
+ * @data: Control bytes and slots, replaced by RcuAssignPointer() when it is rebuilt
+ * @keyOffset: Offset of the uint64_t key in objects
+ * @capacity: Most objects it can have, at most 7/8 of slots
+ * @size: Objects in it
+ * @growthLeft: Empty slots which can be taken before it is rebuilt
+ * @rebuild: Times rebuilt to clear deleted slots
+ */
+typedef struct {
+    SwissTableData *data;
+    uint32_t keyOffset;
+    uint32_t capacity;
+    uint32_t size;
+    uint32_t growthLeft;
+    uint64_t rebuild;
+    pthread_mutex_t lock;
+} SwissTable;
+
+#define SwissTableKeyOf(__table, __obj) (*(uint64_t *) ((uint8_t *) (__obj) + (__table)->keyOffset))
+
+// Init the table of @capacity objects of @__type, whose key is @__member
+#define SwissTableInitOf(__table, __capacity, __type, __member) \
+    SwissTableInit(__table, __capacity, offsetof(__type, __member))
+
+Status SwissTableInit(SwissTable *table, uint32_t capacity, uint32_t keyOffset);
+Status SwissTableFinal(SwissTable *table);
+
+// Return the object of @key, or NULL. Call it in RCU read-side critical section.
+void *SwissTableGet(SwissTable *table, uint64_t key);
+
+/**
+ * SwissTableSet - Insert @obj, or replace the object of the same key
+ *
+ * @old: Filled with the replaced object or NULL, free it after RcuSynchronize()
+ * @return: STATUS_ERROR if the table is full
+ */
+Status SwissTableSet(SwissTable *table, void *obj, void **old);
+
+// Remove the object of @key and return it, or NULL if it is not there
+void *SwissTableDelete(SwissTable *table, uint64_t key);
+
+/**
+ * SwissTableNext - Walk the objects in slot order
+ *
+ * @pos: 0 at the first call, updated to go on from the returned object
+ * @return: The next object, or NULL at the end
+ *
+ * Call it in RCU read-side critical section or with the table locked.
+ * Objects may be missed or seen twice if it is written during the walk.
+ */
+void *SwissTableNext(SwissTable *table, uint32_t *pos);
+
+#define SwissTableSize(__table) __atomic_load_n(&(__table)->size, __ATOMIC_RELAXED)
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __UTLT_SWISSTABLE_H__ */
@@ -12,6 +12,7 @@
 extern "C" {
 #endif /* __cplusplus */
 
+// Timer blocks are allocated in chunks of MAX_NUM_OF_TIMER, the pool grows on demand
 #define MAX_NUM_OF_TIMER        1024
 
 // paramID for setting timer parameter
@@ -25,9 +26,27 @@ extern "C" {
 #define TIMER_TYPE_PERIOD   0
 #define TIMER_TYPE_ONCE     1
 
+/*
+ * Running timers are kept in a hierarchical timing wheel with 1 msec tick,
+ * so TimerStart and TimerStop are O(1). Level n has TIMER_WHEEL_SIZE slots
+ * of TIMER_WHEEL_SIZE^n msec each, a slot of upper level is cascaded to the
+ * level below when the lower level wraps around. Timers longer than the top
+ * level (about 4.6 hours) are cascaded again until they are due.
+ *
+ * While any timer is running, the timerfd of the list becomes readable every
+ * TIMER_TICK_MSEC, so TimerExpireCheck can be driven by epoll.
+ */
+#define TIMER_WHEEL_BITS        6
+#define TIMER_WHEEL_SIZE        (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_LEVEL       4
+#define TIMER_TICK_MSEC         10
+
 typedef struct _TimerList {
-    ListHead active;
-    ListHead idle;
+    ListHead wheel[TIMER_WHEEL_LEVEL][TIMER_WHEEL_SIZE];
+    uint64_t tick;              // The next msec to be checked
+    uint32_t numOfRunning;
+    int armed;                  // timerfd is ticking
+    int fd;                     // timerfd, -1 if it cannot be created
     pthread_mutex_t lock;
 } TimerList;
 
@@ -40,10 +59,16 @@ Status TimerFinal();
 uint32_t TimerGetPoolSize();
 
 void TimerListInit(TimerList *tmList);
+void TimerListTerm(TimerList *tmList);
+// expireFunc is called without the lock of @tmList on a copy of params, so it can use timers of the list
 Status TimerExpireCheck(TimerList *tmList, uintptr_t data);
 
+// Register it to epoll with EPOLLIN and call TimerExpireCheck when it is readable
+#define TimerListGetFd(__tmList) ((__tmList)->fd)
+
 Status TimerStart(TimerBlkID id);
 Status TimerStop(TimerBlkID id);
+int TimerIsRunning(TimerBlkID id);
 
 TimerBlkID TimerCreate(TimerList *tmList, int type, uint32_t duration, ExpireFunc expireFunc);
 void TimerDelete(TimerBlkID id);
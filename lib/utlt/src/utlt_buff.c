@@ -2,204 +2,470 @@
 
 #include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
 #include <errno.h>
+#include <pthread.h>
 
 #include "utlt_debug.h"
-#include "utlt_pool.h"
-
-#define MAX_NUM_OF_BUFBLK_POOL       256
-
-#define MAX_NUM_OF_BUFBLK_POOL_64    128
-#define MAX_NUM_OF_BUFBLK_POOL_128   128
-#define MAX_NUM_OF_BUFBLK_POOL_256   128
-#define MAX_NUM_OF_BUFBLK_POOL_512   64
-#define MAX_NUM_OF_BUFBLK_POOL_1024  64
-#define MAX_NUM_OF_BUFBLK_POOL_2048  32
-#define MAX_NUM_OF_BUFBLK_POOL_4096  32
-#define MAX_NUM_OF_BUFBLK_POOL_8192  16
-#define MAX_NUM_OF_BUFBLK_POOL_16384 8
-#define MAX_NUM_OF_BUFBLK_POOL_32768 8
-#define MAX_NUM_OF_BUFBLK_POOL_65536 4
-
-#define SIZE_OF_BUF_RESERVED     4
-#define SIZE_OF_BUF_64           64
-#define SIZE_OF_BUF_128          128
-#define SIZE_OF_BUF_256          256
-#define SIZE_OF_BUF_512          512
-#define SIZE_OF_BUF_1024         1024
-#define SIZE_OF_BUF_2048         2048
-#define SIZE_OF_BUF_4096         4096
-#define SIZE_OF_BUF_8192         8192
-#define SIZE_OF_BUF_16384        16384
-#define SIZE_OF_BUF_32768        36728
-#define SIZE_OF_BUF_65536        65536
-
-typedef uint8_t bufPool64_t[SIZE_OF_BUF_64 + SIZE_OF_BUF_RESERVED];
-typedef uint8_t bufPool128_t[SIZE_OF_BUF_128 + SIZE_OF_BUF_RESERVED];
-typedef uint8_t bufPool256_t[SIZE_OF_BUF_256 + SIZE_OF_BUF_RESERVED];
-typedef uint8_t bufPool512_t[SIZE_OF_BUF_512 + SIZE_OF_BUF_RESERVED];
-typedef uint8_t bufPool1024_t[SIZE_OF_BUF_1024 + SIZE_OF_BUF_RESERVED];
-typedef uint8_t bufPool2048_t[SIZE_OF_BUF_2048 + SIZE_OF_BUF_RESERVED];
-typedef uint8_t bufPool4096_t[SIZE_OF_BUF_4096 + SIZE_OF_BUF_RESERVED];
-typedef uint8_t bufPool8192_t[SIZE_OF_BUF_8192 + SIZE_OF_BUF_RESERVED];
-typedef uint8_t bufPool16384_t[SIZE_OF_BUF_16384 + SIZE_OF_BUF_RESERVED];
-typedef uint8_t bufPool32768_t[SIZE_OF_BUF_32768 + SIZE_OF_BUF_RESERVED];
-typedef uint8_t bufPool65536_t[SIZE_OF_BUF_65536 + SIZE_OF_BUF_RESERVED];
-
-PoolDeclare(bufblkPool, Bufblk, MAX_NUM_OF_BUFBLK_POOL);
-
-PoolDeclare(bufPool64, bufPool64_t, MAX_NUM_OF_BUFBLK_POOL_64);
-PoolDeclare(bufPool128, bufPool128_t, MAX_NUM_OF_BUFBLK_POOL_128);
-PoolDeclare(bufPool256, bufPool256_t, MAX_NUM_OF_BUFBLK_POOL_256);
-PoolDeclare(bufPool512, bufPool512_t, MAX_NUM_OF_BUFBLK_POOL_512);
-PoolDeclare(bufPool1024, bufPool1024_t, MAX_NUM_OF_BUFBLK_POOL_1024);
-PoolDeclare(bufPool2048, bufPool2048_t, MAX_NUM_OF_BUFBLK_POOL_2048);
-PoolDeclare(bufPool4096, bufPool4096_t, MAX_NUM_OF_BUFBLK_POOL_4096);
-PoolDeclare(bufPool8192, bufPool8192_t, MAX_NUM_OF_BUFBLK_POOL_8192);
-PoolDeclare(bufPool16384, bufPool16384_t, MAX_NUM_OF_BUFBLK_POOL_16384);
-PoolDeclare(bufPool32768, bufPool32768_t, MAX_NUM_OF_BUFBLK_POOL_32768);
-PoolDeclare(bufPool65536, bufPool65536_t, MAX_NUM_OF_BUFBLK_POOL_65536);
-
-Status SelectBufblkOption(Bufblk *bufblk, int opt);
+
+/*
+ * Buffers are carved from slabs of size classes. Free objects of a class are
+ * kept in a lock-free stack, and each thread caches some of them, so that
+ * most of alloc and free never touch shared memory. A class grows by one slab
+ * when the stack is empty, until it reaches MAX_NUM_OF_BUFBLK_SLAB.
+ */
+
+#define SIZE_OF_BUF_RESERVED        4
+#define SIZE_OF_BUFBLK_SLAB         (256 * 1024)
+#define MAX_NUM_OF_BUFBLK_SLAB      256     // Slabs of a class
+#define MAX_NUM_OF_BUFBLK_CACHE     64      // Objects of a class cached by a thread
+#define SIZE_OF_BUFBLK_CACHE        (512 * 1024)    // Bytes of a class cached by a thread
+
+#define BUFBLK_MAGIC_FREE           0xF4EE
+#define BUFBLK_MAGIC_USED           0xB10C
+
+enum {
+    BUFBLK_CLASS_DESC = 0,  // Bufblk itself
+    BUFBLK_CLASS_BUF,       // The first class of buffers
+};
+
+/**
+ * BufblkObj - Header of each object in slab
+ *
+ * @index: Index in its class
+ * @next: @index + 1 of the next object in free stack, 0 is the end
+ * @cls: Index of class
+ * @magic: BUFBLK_MAGIC_FREE or BUFBLK_MAGIC_USED
+ */
+typedef struct {
+    uint32_t index;
+    uint32_t next;
+    uint16_t cls;
+    uint16_t magic;
+    uint32_t reserved;      // Keep buffers 16-byte aligned
+} BufblkObj;
+
+/**
+ * BufblkClass - Slabs and free stack of objects in the same size
+ *
+ * @head: Top of free stack, which is @index + 1 in low 32 bits and a tag
+ *        in high 32 bits, so a stale pop fails its compare-and-swap
+ * @numOfFree: Objects in free stack, not including thread caches
+ * @stat: @alloc, @free and @hit are merged from thread caches on refill,
+ *        flush and thread exit, the others are updated directly
+ */
+typedef struct {
+    uint64_t head __attribute__((aligned(64)));
+    int32_t numOfFree;
+
+    uint32_t size __attribute__((aligned(64)));
+    uint32_t stride;
+    uint32_t perSlab;
+    uint32_t cacheCap;
+    uint32_t numOfSlab;
+    uint8_t *slab[MAX_NUM_OF_BUFBLK_SLAB];
+    pthread_mutex_t growLock;
+
+    BufblkPoolStat stat;
+} BufblkClass;
+
+typedef struct {
+    uint32_t num;
+    uint64_t alloc;
+    uint64_t free;
+    uint64_t hit;
+    BufblkObj *obj[MAX_NUM_OF_BUFBLK_CACHE];
+} BufblkCacheClass;
+
+typedef struct {
+    uint32_t generation;
+    BufblkCacheClass cls[MAX_NUM_OF_BUFBLK_CLASS];
+} BufblkCache;
+
+// Buffers of GTP-U in 1500 MTU with outer headers, and of jumbo frame have their own classes
+static const uint32_t bufblkClassSize[] = {
+    sizeof(Bufblk), 64, 128, 256, 512, 1024, 1600, 2048, 4096, 8192, 9216, 16384, 32768, MAX_SIZE_OF_BUFBLK,
+};
+#define NUM_OF_BUFBLK_CLASS (sizeof(bufblkClassSize) / sizeof(bufblkClassSize[0]))
+
+static BufblkClass bufblkClass[NUM_OF_BUFBLK_CLASS];
+static int bufblkPoolInitialized = 0;
+static uint32_t bufblkGeneration = 0;   // Thread caches of an old generation are dropped
+
+static pthread_once_t bufblkCacheOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t bufblkCacheKey;
+static __thread BufblkCache *bufblkCacheSelf = NULL;
+
 Status BufAlloc(Bufblk *bufblk, uint32_t num, uint32_t size);
 Status BufFree(Bufblk *bufblk);
 
 int BufIsNotEnough(Bufblk *bufblk, uint32_t num, uint32_t size);
 
-#define BUF_ALLOC 1
-#define BUF_FREE  2
-#define BufblkOptionSelector(__bufblk, __sizeNum, __opt) \
-    switch(__opt) { \
-        case BUF_ALLOC : \
-            PoolAlloc(&bufPool##__sizeNum, (__bufblk)->buf); \
-            UTLT_Assert((__bufblk)->buf, (__bufblk)->size = (__bufblk)->len = 0; return STATUS_ERROR, "bufPool"#__sizeNum" is empty"); \
-            (__bufblk)->size = __sizeNum; \
-            (__bufblk)->len = 0; \
-            UTLT_Trace("Buffer Alloc Size["#__sizeNum"]"); \
-            break; \
-        case BUF_FREE : \
-            PoolFree(&bufPool##__sizeNum, (bufPool##__sizeNum##_t *)(__bufblk)->buf); \
-            (__bufblk)->size = (__bufblk)->len = 0; \
-            UTLT_Trace("Buffer Free Size["#__sizeNum"]"); \
-            break; \
-        default : \
-            (__bufblk)->size = (__bufblk)->len = 0; \
-            UTLT_Assert(0, return STATUS_ERROR, "BufblkOptionSelector Option error"); \
+static inline BufblkObj *BufblkClassObj(BufblkClass *cls, uint32_t index) {
+    return (BufblkObj *) (cls->slab[index / cls->perSlab] + (size_t) (index % cls->perSlab) * cls->stride);
+}
+
+static BufblkObj *BufblkClassPop(BufblkClass *cls) {
+    uint64_t head = __atomic_load_n(&cls->head, __ATOMIC_ACQUIRE), newHead;
+    BufblkObj *obj;
+
+    do {
+        if (!(uint32_t) head)
+            return NULL;
+        // Slabs are never freed before BufblkPoolFinal(), so a stale @next is harmless
+        obj = BufblkClassObj(cls, (uint32_t) head - 1);
+        newHead = (((head >> 32) + 1) << 32) | __atomic_load_n(&obj->next, __ATOMIC_RELAXED);
+    } while (!__atomic_compare_exchange_n(&cls->head, &head, newHead, 1,
+                                          __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE));
+
+    __atomic_fetch_sub(&cls->numOfFree, 1, __ATOMIC_RELAXED);
+    return obj;
+}
+
+// Push @num objects linked from @first to @last
+static void BufblkClassPush(BufblkClass *cls, BufblkObj *first, BufblkObj *last, uint32_t num) {
+    uint64_t head = __atomic_load_n(&cls->head, __ATOMIC_RELAXED), newHead;
+
+    do {
+        __atomic_store_n(&last->next, (uint32_t) head, __ATOMIC_RELAXED);
+        newHead = (((head >> 32) + 1) << 32) | (first->index + 1);
+    } while (!__atomic_compare_exchange_n(&cls->head, &head, newHead, 1,
+                                          __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+    __atomic_fetch_add(&cls->numOfFree, num, __ATOMIC_RELAXED);
+}
+
+static Status BufblkClassGrow(BufblkClass *cls, uint16_t clsIdx) {
+    Status status = STATUS_OK;
+
+    pthread_mutex_lock(&cls->growLock);
+
+    // Another thread may have grown it
+    if ((uint32_t) __atomic_load_n(&cls->head, __ATOMIC_ACQUIRE))
+        goto UNLOCK;
+
+    uint32_t slabIdx = cls->numOfSlab;
+    UTLT_Assert(slabIdx < MAX_NUM_OF_BUFBLK_SLAB, status = STATUS_ERROR; goto UNLOCK,
+        "Bufblk pool of size %u reaches %d slabs", cls->size, MAX_NUM_OF_BUFBLK_SLAB);
+
+    uint8_t *slab = malloc((size_t) cls->perSlab * cls->stride);
+    UTLT_Assert(slab, status = STATUS_ERROR; goto UNLOCK, "Bufblk slab of size %u alloc fail", cls->size);
+
+    uint32_t base = slabIdx * cls->perSlab;
+    for (uint32_t i = 0; i < cls->perSlab; i++) {
+        BufblkObj *obj = (BufblkObj *) (slab + (size_t) i * cls->stride);
+        obj->index = base + i;
+        obj->next = base + i + 2;
+        obj->cls = clsIdx;
+        obj->magic = BUFBLK_MAGIC_FREE;
+    }
+
+    // Publish the slab before its objects can be popped
+    cls->slab[slabIdx] = slab;
+    __atomic_store_n(&cls->numOfSlab, slabIdx + 1, __ATOMIC_RELEASE);
+    __atomic_fetch_add(&cls->stat.capacity, cls->perSlab, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&cls->stat.grow, 1, __ATOMIC_RELAXED);
+
+    BufblkClassPush(cls, (BufblkObj *) slab,
+                    (BufblkObj *) (slab + (size_t) (cls->perSlab - 1) * cls->stride), cls->perSlab);
+
+UNLOCK:
+    pthread_mutex_unlock(&cls->growLock);
+    return status;
+}
+
+static void BufblkCacheMerge(BufblkClass *cls, BufblkCacheClass *cache) {
+    __atomic_fetch_add(&cls->stat.alloc, cache->alloc, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&cls->stat.free, cache->free, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&cls->stat.hit, cache->hit, __ATOMIC_RELAXED);
+    cache->alloc = cache->free = cache->hit = 0;
+
+    // Objects out of free stack, which are used or in thread caches
+    uint32_t out = __atomic_load_n(&cls->stat.capacity, __ATOMIC_RELAXED) -
+                   __atomic_load_n(&cls->numOfFree, __ATOMIC_RELAXED);
+    uint32_t highWater = __atomic_load_n(&cls->stat.highWater, __ATOMIC_RELAXED);
+    while ((int32_t) out > (int32_t) highWater &&
+           !__atomic_compare_exchange_n(&cls->stat.highWater, &highWater, out, 1,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+// Give back @num cached objects from the top of @cache
+static void BufblkCacheFlush(BufblkClass *cls, BufblkCacheClass *cache, uint32_t num) {
+    if (num) {
+        BufblkObj **obj = &cache->obj[cache->num - num];
+        for (uint32_t i = 0; i + 1 < num; i++)
+            obj[i]->next = obj[i + 1]->index + 1;
+        BufblkClassPush(cls, obj[0], obj[num - 1], num);
+        cache->num -= num;
+        __atomic_fetch_add(&cls->stat.flush, 1, __ATOMIC_RELAXED);
+    }
+
+    BufblkCacheMerge(cls, cache);
+}
+
+// Take half of cache capacity from free stack, and return one of them
+static BufblkObj *BufblkCacheRefill(BufblkClass *cls, uint16_t clsIdx, BufblkCacheClass *cache) {
+    // Objects of a new slab may be taken by other threads before this one pops
+    BufblkObj *obj;
+    while (!(obj = BufblkClassPop(cls))) {
+        if (BufblkClassGrow(cls, clsIdx) != STATUS_OK) {
+            __atomic_fetch_add(&cls->stat.fail, 1, __ATOMIC_RELAXED);
+            return NULL;
+        }
+    }
+
+    BufblkObj *more;
+    while (cache->num < cls->cacheCap / 2 && (more = BufblkClassPop(cls)))
+        cache->obj[cache->num++] = more;
+
+    __atomic_fetch_add(&cls->stat.refill, 1, __ATOMIC_RELAXED);
+    BufblkCacheMerge(cls, cache);
+
+    return obj;
+}
+
+// Objects cached by an exiting thread are given back
+static void BufblkCacheRelease(void *data) {
+    BufblkCache *cache = data;
+
+    if (__atomic_load_n(&bufblkPoolInitialized, __ATOMIC_ACQUIRE) &&
+        cache->generation == __atomic_load_n(&bufblkGeneration, __ATOMIC_ACQUIRE)) {
+        for (int i = 0; i < NUM_OF_BUFBLK_CLASS; i++)
+            BufblkCacheFlush(&bufblkClass[i], &cache->cls[i], cache->cls[i].num);
+    }
+
+    free(cache);
+}
+
+static void BufblkCacheKeyCreate() {
+    pthread_key_create(&bufblkCacheKey, BufblkCacheRelease);
+}
+
+static BufblkCache *BufblkCacheGet() {
+    BufblkCache *cache = bufblkCacheSelf;
+    uint32_t generation = __atomic_load_n(&bufblkGeneration, __ATOMIC_ACQUIRE);
+
+    if (cache && cache->generation == generation)
+        return cache;
+
+    if (!cache) {
+        pthread_once(&bufblkCacheOnce, BufblkCacheKeyCreate);
+
+        cache = calloc(1, sizeof(BufblkCache));
+        UTLT_Assert(cache, return NULL, "Bufblk cache of thread alloc fail");
+        bufblkCacheSelf = cache;
+        pthread_setspecific(bufblkCacheKey, cache);
     }
 
-Status SelectBufblkOption(Bufblk *bufblk, int opt) {
-    if (bufblk->size <= 64) {
-        BufblkOptionSelector(bufblk, 64, opt);
-    } else if (bufblk->size <= 128) {
-        BufblkOptionSelector(bufblk, 128, opt); 
-    } else if (bufblk->size <= 256) {
-        BufblkOptionSelector(bufblk, 256, opt);
-    } else if (bufblk->size <= 512) {
-        BufblkOptionSelector(bufblk, 512, opt);
-    } else if (bufblk->size <= 1024) {
-        BufblkOptionSelector(bufblk, 1024, opt);
-    } else if (bufblk->size <= 2048) {
-        BufblkOptionSelector(bufblk, 2048, opt);
-    } else if (bufblk->size <= 4096) {
-        BufblkOptionSelector(bufblk, 4096, opt);
-    } else if (bufblk->size <= 8192) {
-        BufblkOptionSelector(bufblk, 8192, opt);
-    } else if (bufblk->size <= 16384) {
-        BufblkOptionSelector(bufblk, 16384, opt);
-    } else if (bufblk->size <= 32768) {
-        BufblkOptionSelector(bufblk, 32768, opt);
-    } else if (bufblk->size <= 65536) {
-        BufblkOptionSelector(bufblk, 65536, opt);
+    // Objects cached before the last BufblkPoolFinal() are freed with their slabs
+    memset(cache->cls, 0, sizeof(cache->cls));
+    cache->generation = generation;
+
+    return cache;
+}
+
+static void *BufblkClassAlloc(uint16_t clsIdx) {
+    UTLT_Assert(bufblkPoolInitialized, return NULL, "Bufblk pool is not initialized");
+
+    BufblkClass *cls = &bufblkClass[clsIdx];
+    BufblkCache *cache = BufblkCacheGet();
+    UTLT_Assert(cache, return NULL, "");
+
+    BufblkCacheClass *clsCache = &cache->cls[clsIdx];
+    BufblkObj *obj;
+
+    clsCache->alloc++;
+    if (clsCache->num) {
+        clsCache->hit++;
+        obj = clsCache->obj[--clsCache->num];
     } else {
-        UTLT_Error("The size for Buffer block is too big : size[%d]", bufblk->size);
-        bufblk->size = bufblk->len = 0;
-        return STATUS_ERROR;
+        obj = BufblkCacheRefill(cls, clsIdx, clsCache);
+        if (!obj)
+            return NULL;
     }
+
+    obj->magic = BUFBLK_MAGIC_USED;
+    return obj + 1;
+}
+
+static Status BufblkClassFree(void *ptr) {
+    BufblkObj *obj = (BufblkObj *) ptr - 1;
+    UTLT_Assert(obj->magic == BUFBLK_MAGIC_USED && obj->cls < NUM_OF_BUFBLK_CLASS,
+        return STATUS_ERROR, "Buffer %p is not in use, it may not belong to Bufblk pool", ptr);
+
+    BufblkClass *cls = &bufblkClass[obj->cls];
+    BufblkCache *cache = BufblkCacheGet();
+    UTLT_Assert(cache, return STATUS_ERROR, "");
+
+    BufblkCacheClass *clsCache = &cache->cls[obj->cls];
+
+    obj->magic = BUFBLK_MAGIC_FREE;
+    clsCache->free++;
+    if (clsCache->num == cls->cacheCap)
+        BufblkCacheFlush(cls, clsCache, cls->cacheCap / 2);
+    clsCache->obj[clsCache->num++] = obj;
+
     return STATUS_OK;
 }
 
+static int BufblkClassSelect(uint32_t size) {
+    for (int i = BUFBLK_CLASS_BUF; i < NUM_OF_BUFBLK_CLASS; i++)
+        if (size <= bufblkClassSize[i])
+            return i;
+
+    return -1;
+}
+
 Status BufblkPoolInit() {
-    PoolInit(&bufblkPool, MAX_NUM_OF_BUFBLK_POOL);
-    PoolInit(&bufPool64, MAX_NUM_OF_BUFBLK_POOL_64);
-    PoolInit(&bufPool128, MAX_NUM_OF_BUFBLK_POOL_128);
-    PoolInit(&bufPool256, MAX_NUM_OF_BUFBLK_POOL_256);
-    PoolInit(&bufPool512, MAX_NUM_OF_BUFBLK_POOL_512);
-    PoolInit(&bufPool1024, MAX_NUM_OF_BUFBLK_POOL_1024);
-    PoolInit(&bufPool2048, MAX_NUM_OF_BUFBLK_POOL_2048);
-    PoolInit(&bufPool4096, MAX_NUM_OF_BUFBLK_POOL_4096);
-    PoolInit(&bufPool8192, MAX_NUM_OF_BUFBLK_POOL_8192);
-    PoolInit(&bufPool16384, MAX_NUM_OF_BUFBLK_POOL_16384);
-    PoolInit(&bufPool32768, MAX_NUM_OF_BUFBLK_POOL_32768);
-    PoolInit(&bufPool65536, MAX_NUM_OF_BUFBLK_POOL_65536);
+    UTLT_Assert(NUM_OF_BUFBLK_CLASS <= MAX_NUM_OF_BUFBLK_CLASS, return STATUS_ERROR,
+        "Bufblk pool has too many classes");
+
+    pthread_once(&bufblkCacheOnce, BufblkCacheKeyCreate);
+
+    for (int i = 0; i < NUM_OF_BUFBLK_CLASS; i++) {
+        BufblkClass *cls = &bufblkClass[i];
+        memset(cls, 0, sizeof(BufblkClass));
+
+        // Buffers have room for the terminating null of string functions
+        cls->size = bufblkClassSize[i];
+        cls->stride = (sizeof(BufblkObj) + cls->size +
+                       (i == BUFBLK_CLASS_DESC ? 0 : SIZE_OF_BUF_RESERVED) + 15) & ~15U;
+        cls->perSlab = (cls->stride < SIZE_OF_BUFBLK_SLAB ? SIZE_OF_BUFBLK_SLAB / cls->stride : 1);
+        cls->cacheCap = SIZE_OF_BUFBLK_CACHE / cls->stride;
+        if (cls->cacheCap > MAX_NUM_OF_BUFBLK_CACHE)
+            cls->cacheCap = MAX_NUM_OF_BUFBLK_CACHE;
+        if (cls->cacheCap < 2)
+            cls->cacheCap = 2;
+        pthread_mutex_init(&cls->growLock, 0);
+
+        cls->stat.size = (i == BUFBLK_CLASS_DESC ? 0 : cls->size);
+    }
+
+    __atomic_add_fetch(&bufblkGeneration, 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&bufblkPoolInitialized, 1, __ATOMIC_RELEASE);
 
     return STATUS_OK;
 }
 
 Status BufblkPoolFinal() {
-    PoolTerminate(&bufblkPool);
-    PoolTerminate(&bufPool64);
-    PoolTerminate(&bufPool128);
-    PoolTerminate(&bufPool256);
-    PoolTerminate(&bufPool512);
-    PoolTerminate(&bufPool1024);
-    PoolTerminate(&bufPool2048);
-    PoolTerminate(&bufPool4096);
-    PoolTerminate(&bufPool8192);
-    PoolTerminate(&bufPool16384);
-    PoolTerminate(&bufPool32768);
-    PoolTerminate(&bufPool65536);
+    UTLT_Assert(bufblkPoolInitialized, return STATUS_ERROR, "Bufblk pool is not initialized");
+
+    // All buffers are freed, those still used or cached by other threads are gone as well
+    __atomic_store_n(&bufblkPoolInitialized, 0, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&bufblkGeneration, 1, __ATOMIC_RELEASE);
+
+    for (int i = 0; i < NUM_OF_BUFBLK_CLASS; i++) {
+        BufblkClass *cls = &bufblkClass[i];
+        for (uint32_t j = 0; j < cls->numOfSlab; j++)
+            free(cls->slab[j]);
+        cls->numOfSlab = 0;
+        cls->head = 0;
+        pthread_mutex_destroy(&cls->growLock);
+    }
 
     return STATUS_OK;
 }
 
-#define BufferCheck(__sizeNum) \
-    if (PoolSize(&bufPool##__sizeNum) != PoolCap(&bufPool##__sizeNum)) \
-        UTLT_Warning("Memory leak happens in Bufblk"#__sizeNum" , need %d but only %d", \
-            PoolCap(&bufPool##__sizeNum), PoolSize(&bufPool##__sizeNum))
+int BufblkPoolStats(BufblkPoolStat *stat, int num) {
+    UTLT_Assert(stat && num >= 0, return 0, "BufblkPoolStat is NULL");
+    UTLT_Assert(bufblkPoolInitialized, return 0, "Bufblk pool is not initialized");
+
+    // Counters of the caller are up to date, those of other threads are merged later
+    BufblkCache *cache = BufblkCacheGet();
+
+    int i;
+    for (i = 0; i < num && i < NUM_OF_BUFBLK_CLASS; i++) {
+        if (cache)
+            BufblkCacheMerge(&bufblkClass[i], &cache->cls[i]);
+
+        BufblkClass *cls = &bufblkClass[i];
+        stat[i].size = cls->stat.size;
+        stat[i].numOfSlab = __atomic_load_n(&cls->numOfSlab, __ATOMIC_RELAXED);
+        stat[i].capacity = __atomic_load_n(&cls->stat.capacity, __ATOMIC_RELAXED);
+        stat[i].available = __atomic_load_n(&cls->numOfFree, __ATOMIC_RELAXED);
+        stat[i].highWater = __atomic_load_n(&cls->stat.highWater, __ATOMIC_RELAXED);
+        stat[i].alloc = __atomic_load_n(&cls->stat.alloc, __ATOMIC_RELAXED);
+        stat[i].free = __atomic_load_n(&cls->stat.free, __ATOMIC_RELAXED);
+        stat[i].hit = __atomic_load_n(&cls->stat.hit, __ATOMIC_RELAXED);
+        stat[i].refill = __atomic_load_n(&cls->stat.refill, __ATOMIC_RELAXED);
+        stat[i].flush = __atomic_load_n(&cls->stat.flush, __ATOMIC_RELAXED);
+        stat[i].grow = __atomic_load_n(&cls->stat.grow, __ATOMIC_RELAXED);
+        stat[i].fail = __atomic_load_n(&cls->stat.fail, __ATOMIC_RELAXED);
+    }
+
+    return i;
+}
+
+void BufblkPoolReport() {
+    BufblkPoolStat stat[MAX_NUM_OF_BUFBLK_CLASS];
+    int num = BufblkPoolStats(stat, MAX_NUM_OF_BUFBLK_CLASS);
+
+    UTLT_Info("Bufblk pool: %6s %6s %9s %9s %9s %12s %7s %9s %9s %6s",
+        "size", "slabs", "capacity", "available", "highWater",
+        "alloc", "hit(%)", "refill", "flush", "fail");
+    for (int i = 0; i < num; i++) {
+        if (!stat[i].alloc && !stat[i].capacity)
+            continue;
+        UTLT_Info("Bufblk pool: %6u %6u %9u %9u %9u %12lu %7.2f %9lu %9lu %6lu",
+            stat[i].size, stat[i].numOfSlab, stat[i].capacity, stat[i].available, stat[i].highWater,
+            stat[i].alloc, (stat[i].alloc ? 100.0 * stat[i].hit / stat[i].alloc : 0),
+            stat[i].refill, stat[i].flush, stat[i].fail);
+    }
+}
 
 void BufblkPoolCheck(const char *showInfo) {
     UTLT_Debug("Memory leak check start: %s", showInfo);
-
-    UTLT_Assert(PoolSize(&bufblkPool) == PoolCap(&bufblkPool),
-        , "Memory leak happens in BufblkPool, need %d but only %d",
-        PoolCap(&bufblkPool), PoolSize(&bufblkPool));
-
-    BufferCheck(64);
-    BufferCheck(128);
-    BufferCheck(256);
-    BufferCheck(512);
-    BufferCheck(1024);
-    BufferCheck(2048);
-    BufferCheck(4096);
-    BufferCheck(8192);
-    BufferCheck(16384);
-    BufferCheck(32768);
-    BufferCheck(65536);
+    UTLT_Assert(bufblkPoolInitialized, return, "Bufblk pool is not initialized");
+
+    // Objects cached by the caller are given back, other threads shall have exited
+    BufblkCache *cache = BufblkCacheGet();
+    for (int i = 0; i < NUM_OF_BUFBLK_CLASS; i++) {
+        BufblkClass *cls = &bufblkClass[i];
+        if (cache)
+            BufblkCacheFlush(cls, &cache->cls[i], cache->cls[i].num);
+
+        int32_t numOfFree = __atomic_load_n(&cls->numOfFree, __ATOMIC_RELAXED);
+        if (numOfFree != (int32_t) cls->stat.capacity) {
+            if (i == BUFBLK_CLASS_DESC)
+                UTLT_Warning("Memory leak happens in BufblkPool, need %u but only %d",
+                    cls->stat.capacity, numOfFree);
+            else
+                UTLT_Warning("Memory leak happens in Bufblk%u , need %u but only %d",
+                    cls->size, cls->stat.capacity, numOfFree);
+        }
+    }
 
     UTLT_Debug("Memory leak check end");
 }
 
 Bufblk *BufblkAlloc(uint32_t num, uint32_t size) {
     Status status;
-    Bufblk *bufblk = NULL;
-
-    PoolAlloc(&bufblkPool, bufblk);
+    Bufblk *bufblk = BufblkClassAlloc(BUFBLK_CLASS_DESC);
     UTLT_Assert(bufblk, return NULL, "The pool of Buffer is empty");
-    
+
     status = BufAlloc(bufblk, num, size);
-    UTLT_Assert(status == STATUS_OK, 
-                PoolFree(&bufblkPool, bufblk); bufblk = NULL, "");
+    UTLT_Assert(status == STATUS_OK,
+                BufblkClassFree(bufblk); bufblk = NULL, "");
 
     return bufblk;
 }
 
 Status BufAlloc(Bufblk *bufblk, uint32_t num, uint32_t size) {
+    int clsIdx = BufblkClassSelect(num * size);
+    if (clsIdx < 0) {
+        UTLT_Error("The size for Buffer block is too big : size[%u]", num * size);
+        bufblk->buf = NULL;
+        bufblk->size = bufblk->len = 0;
+        return STATUS_ERROR;
+    }
 
-    bufblk->size = num * size;
-    UTLT_Assert(SelectBufblkOption(bufblk, BUF_ALLOC) == STATUS_OK, 
-                return STATUS_ERROR, "");
+    bufblk->buf = BufblkClassAlloc(clsIdx);
+    UTLT_Assert(bufblk->buf, bufblk->size = bufblk->len = 0; return STATUS_ERROR,
+                "bufPool%u is empty", bufblkClassSize[clsIdx]);
+    bufblk->size = bufblkClassSize[clsIdx];
+    bufblk->len = 0;
 
     return STATUS_OK;
 }
@@ -235,9 +501,10 @@ Status BufblkClear(Bufblk *bufblk) {
 Status BufFree(Bufblk *bufblk) {
 
     if (bufblk->buf) {
-        UTLT_Assert(SelectBufblkOption(bufblk, BUF_FREE) == STATUS_OK, 
+        UTLT_Assert(BufblkClassFree(bufblk->buf) == STATUS_OK, 
                     return STATUS_ERROR, "Buffer Pool Free fail");
         bufblk->buf = NULL;
+        bufblk->size = bufblk->len = 0;
     }
 
     return STATUS_OK;
@@ -247,7 +514,8 @@ Status BufblkFree(Bufblk *bufblk) {
     
     UTLT_Assert(BufFree(bufblk) == STATUS_OK, return STATUS_ERROR, 
                 "Buffer Free fail");
-    PoolFree(&bufblkPool, bufblk);
+    UTLT_Assert(BufblkClassFree(bufblk) == STATUS_OK, return STATUS_ERROR,
+                "Bufblk Free fail");
 
     return STATUS_OK;
 }
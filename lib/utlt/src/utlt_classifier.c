@@ -0,0 +1,229 @@
+#include "utlt_classifier.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    uint8_t protoMask;
+    uint32_t smask, dmask;
+
+    int minRank;            // The highest priority rule in this tuple
+    int numOfRule;
+    uint32_t slotMask;
+    int *slot;              // Index of entry + 1, 0 is empty
+} ClassifierTuple;
+
+typedef struct {
+    // Masked key
+    uint8_t proto;
+    uint32_t saddr, daddr;
+
+    int first;              // The highest priority rule with this key
+    int last;
+} ClassifierEntry;
+
+struct _Classifier {
+    int numOfRule;
+    ClassifierRule *rule;   // Sorted by priority, index is the rank
+    int *ruleNext;          // Next rule with the same key in the same tuple, -1 is the end
+    int *ruleTuple;
+
+    int numOfTuple;
+    ClassifierTuple *tuple; // Sorted by minRank
+
+    int numOfEntry;
+    ClassifierEntry *entry;
+
+    int *slot;
+};
+
+static inline uint32_t ClassifierHash(uint8_t proto, uint32_t saddr, uint32_t daddr) {
+    uint32_t h = saddr * 0x9E3779B1u;
+    h ^= daddr + 0x7F4A7C15u + (h << 6) + (h >> 2);
+    h ^= proto + (h << 6) + (h >> 2);
+    return h ^ (h >> 16);
+}
+
+static inline uint32_t ClassifierEffectiveSmask(const ClassifierRule *rule) {
+    return (rule->saddr && rule->smask) ? rule->smask : 0;
+}
+
+static inline uint32_t ClassifierEffectiveDmask(const ClassifierRule *rule) {
+    return (rule->daddr && rule->dmask) ? rule->dmask : 0;
+}
+
+static inline int ClassifierPortMatch(uint16_t port, const uint32_t *list, int len) {
+    for (int i = 0; i < len; i++) {
+        if (PortStart(list[i]) <= port && PortEnd(list[i]) >= port)
+            return 1;
+    }
+    return 0;
+}
+
+static inline int ClassifierRulePortMatch(const ClassifierRule *rule, const ClassifierKey *key) {
+    if (rule->sportNum)
+        if (!key->hasPort || !ClassifierPortMatch(key->sport, rule->sportList, rule->sportNum))
+            return 0;
+    if (rule->dportNum)
+        if (!key->hasPort || !ClassifierPortMatch(key->dport, rule->dportList, rule->dportNum))
+            return 0;
+    return 1;
+}
+
+static int ClassifierTupleFind(Classifier *classifier, uint8_t protoMask, uint32_t smask, uint32_t dmask) {
+    for (int i = 0; i < classifier->numOfTuple; i++) {
+        ClassifierTuple *tuple = &classifier->tuple[i];
+        if (tuple->protoMask == protoMask && tuple->smask == smask && tuple->dmask == dmask)
+            return i;
+    }
+    return -1;
+}
+
+void ClassifierFree(Classifier *classifier) {
+    if (!classifier)
+        return;
+
+    free(classifier->rule);
+    free(classifier->ruleNext);
+    free(classifier->ruleTuple);
+    free(classifier->tuple);
+    free(classifier->entry);
+    free(classifier->slot);
+    free(classifier);
+}
+
+Classifier *ClassifierCompile(const ClassifierRule *rules, int num) {
+    UTLT_Assert(num >= 0 && (rules || !num), return NULL, "Classifier rules should not be NULL");
+
+    Classifier *classifier = calloc(1, sizeof(Classifier));
+    UTLT_Assert(classifier, return NULL, "Classifier alloc failed");
+
+    // Keep at least one element, so that calloc never returns NULL for a valid request
+    int cap = num ? num : 1;
+    classifier->rule = calloc(cap, sizeof(ClassifierRule));
+    classifier->ruleNext = calloc(cap, sizeof(int));
+    classifier->ruleTuple = calloc(cap, sizeof(int));
+    classifier->tuple = calloc(cap, sizeof(ClassifierTuple));
+    classifier->entry = calloc(cap, sizeof(ClassifierEntry));
+    UTLT_Assert(classifier->rule && classifier->ruleNext && classifier->ruleTuple &&
+                classifier->tuple && classifier->entry, goto FAILED, "Classifier alloc failed");
+
+    if (num)
+        memcpy(classifier->rule, rules, sizeof(ClassifierRule) * num);
+    classifier->numOfRule = num;
+
+    // Pass 1: Group rules into tuples, tuples are created in order of their minRank
+    for (int i = 0; i < num; i++) {
+        const ClassifierRule *rule = &classifier->rule[i];
+        uint8_t protoMask = rule->proto ? 0xFF : 0;
+        uint32_t smask = ClassifierEffectiveSmask(rule), dmask = ClassifierEffectiveDmask(rule);
+
+        int t = ClassifierTupleFind(classifier, protoMask, smask, dmask);
+        if (t < 0) {
+            t = classifier->numOfTuple++;
+            classifier->tuple[t].protoMask = protoMask;
+            classifier->tuple[t].smask = smask;
+            classifier->tuple[t].dmask = dmask;
+            classifier->tuple[t].minRank = i;
+        }
+        classifier->tuple[t].numOfRule++;
+        classifier->ruleTuple[i] = t;
+        classifier->ruleNext[i] = -1;
+    }
+
+    // Load factor of each tuple hash is at most 0.5
+    size_t numOfSlot = 0;
+    for (int t = 0; t < classifier->numOfTuple; t++) {
+        uint32_t size = 2;
+        while (size < (uint32_t) classifier->tuple[t].numOfRule * 2)
+            size <<= 1;
+        classifier->tuple[t].slotMask = size - 1;
+        numOfSlot += size;
+    }
+    classifier->slot = calloc(numOfSlot ? numOfSlot : 1, sizeof(int));
+    UTLT_Assert(classifier->slot, goto FAILED, "Classifier slot alloc failed");
+
+    int *slotPtr = classifier->slot;
+    for (int t = 0; t < classifier->numOfTuple; t++) {
+        classifier->tuple[t].slot = slotPtr;
+        slotPtr += classifier->tuple[t].slotMask + 1;
+    }
+
+    // Pass 2: Put rules into the hash of their tuple, rules with the same key are chained by rank
+    for (int i = 0; i < num; i++) {
+        const ClassifierRule *rule = &classifier->rule[i];
+        ClassifierTuple *tuple = &classifier->tuple[classifier->ruleTuple[i]];
+
+        uint8_t proto = rule->proto & tuple->protoMask;
+        uint32_t saddr = rule->saddr & tuple->smask, daddr = rule->daddr & tuple->dmask;
+
+        uint32_t h = ClassifierHash(proto, saddr, daddr) & tuple->slotMask;
+        for (;; h = (h + 1) & tuple->slotMask) {
+            int slot = tuple->slot[h];
+            if (!slot) {
+                ClassifierEntry *entry = &classifier->entry[classifier->numOfEntry++];
+                entry->proto = proto;
+                entry->saddr = saddr;
+                entry->daddr = daddr;
+                entry->first = entry->last = i;
+                tuple->slot[h] = classifier->numOfEntry;
+                break;
+            }
+
+            ClassifierEntry *entry = &classifier->entry[slot - 1];
+            if (entry->proto == proto && entry->saddr == saddr && entry->daddr == daddr) {
+                classifier->ruleNext[entry->last] = i;
+                entry->last = i;
+                break;
+            }
+        }
+    }
+
+    return classifier;
+
+FAILED:
+    ClassifierFree(classifier);
+    return NULL;
+}
+
+void *ClassifierLookup(const Classifier *classifier, const ClassifierKey *key) {
+    if (!classifier)
+        return NULL;
+
+    int best = classifier->numOfRule;
+
+    for (int t = 0; t < classifier->numOfTuple; t++) {
+        const ClassifierTuple *tuple = &classifier->tuple[t];
+        // No rule in this tuple or after can beat the current one
+        if (tuple->minRank >= best)
+            break;
+
+        uint8_t proto = key->proto & tuple->protoMask;
+        uint32_t saddr = key->saddr & tuple->smask, daddr = key->daddr & tuple->dmask;
+
+        uint32_t h = ClassifierHash(proto, saddr, daddr) & tuple->slotMask;
+        for (int slot; (slot = tuple->slot[h]); h = (h + 1) & tuple->slotMask) {
+            const ClassifierEntry *entry = &classifier->entry[slot - 1];
+            if (entry->proto != proto || entry->saddr != saddr || entry->daddr != daddr)
+                continue;
+
+            for (int r = entry->first; r >= 0 && r < best; r = classifier->ruleNext[r]) {
+                if (ClassifierRulePortMatch(&classifier->rule[r], key)) {
+                    best = r;
+                    break;
+                }
+            }
+            break;
+        }
+    }
+
+    return (best < classifier->numOfRule ? classifier->rule[best].data : NULL);
+}
+
+int ClassifierNumOfRule(const Classifier *classifier) {
+    return classifier ? classifier->numOfRule : 0;
+}
+
+int ClassifierNumOfTuple(const Classifier *classifier) {
+    return classifier ? classifier->numOfTuple : 0;
+}
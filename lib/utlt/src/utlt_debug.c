@@ -1,9 +1,13 @@
 #include "utlt_debug.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <errno.h>
 #include <string.h>
+#include <strings.h>
 #include <stdarg.h>
+#include <time.h>
+#include <pthread.h>
 
 #include "logger.h"
 #include "utlt_lib.h"
@@ -13,11 +17,36 @@
 
 unsigned int reportCaller = 0;
 
+// The same as the default level of logrus
+int utltLogLevel = LOG_INFO;
+
+// Level names accepted by logrus.ParseLevel
+static const struct {
+    const char *name;
+    int level;
+} logLevelName[] = {
+    {"panic", LOG_PANIC},
+    {"fatal", LOG_FATAL},
+    {"error", LOG_ERROR},
+    {"warn", LOG_WARNING},
+    {"warning", LOG_WARNING},
+    {"info", LOG_INFO},
+    {"debug", LOG_DEBUG},
+    {"trace", LOG_TRACE},
+};
+
 Status UTLT_SetLogLevel(const char *level) {
-    if (UpfUtilLog_SetLogLevel(UTLT_CStr2GoStr(level)))
-        return STATUS_OK;
-    else
+    if (!UpfUtilLog_SetLogLevel(UTLT_CStr2GoStr(level)))
         return STATUS_ERROR;
+
+    for (int i = 0; i < sizeof(logLevelName) / sizeof(logLevelName[0]); i++) {
+        if (!strcasecmp(level, logLevelName[i].name)) {
+            utltLogLevel = logLevelName[i].level;
+            break;
+        }
+    }
+
+    return STATUS_OK;
 }
 
 Status UTLT_SetReportCaller(unsigned int flag) {
@@ -30,22 +59,271 @@ Status UTLT_SetReportCaller(unsigned int flag) {
     return STATUS_OK;
 }
 
+static void LogOutputGo(int level, const char *msg) {
+    switch(level) {
+        case 0 :
+            UpfUtilLog_Panicln(UTLT_CStr2GoStr(msg));
+            break;
+        case 1 :
+            UpfUtilLog_Fatalln(UTLT_CStr2GoStr(msg));
+            break;
+        case 2 :
+            UpfUtilLog_Errorln(UTLT_CStr2GoStr(msg));
+            break;
+        case 3 :
+            UpfUtilLog_Warningln(UTLT_CStr2GoStr(msg));
+            break;
+        case 4 :
+            UpfUtilLog_Infoln(UTLT_CStr2GoStr(msg));
+            break;
+        case 5 :
+            UpfUtilLog_Debugln(UTLT_CStr2GoStr(msg));
+            break;
+        case 6 :
+            UpfUtilLog_Traceln(UTLT_CStr2GoStr(msg));
+            break;
+    }
+}
+
+static UTLT_LogOutputFunc logOutput = LogOutputGo;
+
+void UTLT_SetLogOutput(UTLT_LogOutputFunc func) {
+    logOutput = (func ? func : LogOutputGo);
+}
+
+/*
+ * Each thread which logs owns a single producer single consumer ring of
+ * records, and the writer thread is the only consumer of all rings.
+ * A record is a LogRecord header followed by the message and '\0', and it
+ * never wraps around the end of ring, the space left at the end is filled
+ * with a padding record instead.
+ */
+#define MAX_NUM_OF_LOG_RING     256
+#define SIZE_OF_LOG_RING        (64 * 1024)
+#define MAX_SIZE_OF_LOG_MSG     4096
+
+#define LOG_RECORD_PAD          -1
+#define LOG_WRITER_IDLE_NSEC    1000000
+
+#define LogRecordSize(__msgLen) (((uint32_t) sizeof(LogRecord) + (__msgLen) + 1 + 7) & ~7u)
+
+typedef struct {
+    uint32_t size;
+    int32_t level;
+} LogRecord;
+
+typedef struct {
+    uint64_t head __attribute__((aligned(64)));    // Written by the owner thread only
+    uint64_t dropped;
+    uint64_t tail __attribute__((aligned(64)));    // Written by the writer thread only
+    int inUse __attribute__((aligned(64)));
+    char buf[SIZE_OF_LOG_RING] __attribute__((aligned(8)));
+} LogRing;
+
+static LogRing *logRingList[MAX_NUM_OF_LOG_RING];
+static int logRingNum = 0;
+static pthread_mutex_t logRingLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t logRingOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t logRingKey;
+static __thread LogRing *logRingSelf = NULL;
+
+static int logAsync = 0;
+static int logWriterStop = 0;
+static pthread_t logWriter;
+static uint64_t logWritten = 0;
+static uint64_t logDroppedReported = 0;
+
+// The ring is given back when its thread exits, records in it are still written
+static void LogRingRelease(void *ring) {
+    __atomic_store_n(&((LogRing *) ring)->inUse, 0, __ATOMIC_RELEASE);
+}
+
+static void LogRingKeyCreate() {
+    pthread_key_create(&logRingKey, LogRingRelease);
+}
+
+static LogRing *LogRingGet() {
+    if (logRingSelf)
+        return logRingSelf;
+
+    pthread_once(&logRingOnce, LogRingKeyCreate);
+
+    pthread_mutex_lock(&logRingLock);
+    for (int i = 0; i < logRingNum; i++) {
+        int unused = 0;
+        if (__atomic_compare_exchange_n(&logRingList[i]->inUse, &unused, 1, 0,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            logRingSelf = logRingList[i];
+            break;
+        }
+    }
+    if (!logRingSelf && logRingNum < MAX_NUM_OF_LOG_RING) {
+        LogRing *ring = calloc(1, sizeof(LogRing));
+        if (ring) {
+            ring->inUse = 1;
+            logRingList[logRingNum] = ring;
+            __atomic_store_n(&logRingNum, logRingNum + 1, __ATOMIC_RELEASE);
+            logRingSelf = ring;
+        }
+    }
+    pthread_mutex_unlock(&logRingLock);
+
+    if (logRingSelf)
+        pthread_setspecific(logRingKey, logRingSelf);
+
+    return logRingSelf;
+}
+
+static Status LogRingPush(int level, const char *msg, uint32_t msgLen) {
+    LogRing *ring = LogRingGet();
+    if (!ring)
+        return STATUS_ERROR;
+
+    if (msgLen >= MAX_SIZE_OF_LOG_MSG)
+        msgLen = MAX_SIZE_OF_LOG_MSG - 1;
+
+    uint32_t size = LogRecordSize(msgLen);
+    uint64_t head = ring->head;
+    uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    uint32_t pos = head % SIZE_OF_LOG_RING;
+    uint32_t pad = (SIZE_OF_LOG_RING - pos < size ? SIZE_OF_LOG_RING - pos : 0);
+
+    if (SIZE_OF_LOG_RING - (head - tail) < pad + size) {
+        __atomic_store_n(&ring->dropped, ring->dropped + 1, __ATOMIC_RELAXED);
+        return STATUS_ERROR;
+    }
+
+    if (pad) {
+        LogRecord *record = (LogRecord *) (ring->buf + pos);
+        record->size = pad;
+        record->level = LOG_RECORD_PAD;
+        pos = 0;
+    }
+
+    LogRecord *record = (LogRecord *) (ring->buf + pos);
+    record->size = size;
+    record->level = level;
+    memcpy(record + 1, msg, msgLen);
+    ((char *) (record + 1))[msgLen] = '\0';
+
+    __atomic_store_n(&ring->head, head + pad + size, __ATOMIC_RELEASE);
+
+    return STATUS_OK;
+}
+
+// @return: number of records written
+static int LogRingDrain() {
+    int num = 0;
+    int ringNum = __atomic_load_n(&logRingNum, __ATOMIC_ACQUIRE);
+
+    for (int i = 0; i < ringNum; i++) {
+        LogRing *ring = logRingList[i];
+        uint64_t tail = ring->tail;
+        uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+        while (tail != head) {
+            LogRecord *record = (LogRecord *) (ring->buf + tail % SIZE_OF_LOG_RING);
+            if (record->level != LOG_RECORD_PAD) {
+                logOutput(record->level, (const char *) (record + 1));
+                num++;
+            }
+            tail += record->size;
+            __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+        }
+    }
+
+    __atomic_fetch_add(&logWritten, num, __ATOMIC_RELAXED);
+    return num;
+}
+
+static uint64_t LogDroppedSum() {
+    uint64_t dropped = 0;
+    int ringNum = __atomic_load_n(&logRingNum, __ATOMIC_ACQUIRE);
+
+    for (int i = 0; i < ringNum; i++)
+        dropped += __atomic_load_n(&logRingList[i]->dropped, __ATOMIC_RELAXED);
+
+    return dropped;
+}
+
+static void *LogWriterThread(void *data) {
+    struct timespec idle = {0, LOG_WRITER_IDLE_NSEC};
+
+    while (!__atomic_load_n(&logWriterStop, __ATOMIC_ACQUIRE)) {
+        if (!LogRingDrain())
+            nanosleep(&idle, NULL);
+
+        uint64_t dropped = LogDroppedSum();
+        if (dropped != logDroppedReported) {
+            char msg[64];
+            snprintf(msg, sizeof(msg), "%lu log records are dropped", dropped - logDroppedReported);
+            logOutput(LOG_WARNING, msg);
+            logDroppedReported = dropped;
+        }
+    }
+
+    return NULL;
+}
+
+Status UTLT_LogAsyncStart() {
+    if (__atomic_load_n(&logAsync, __ATOMIC_ACQUIRE))
+        return STATUS_OK;
+
+    logWriterStop = 0;
+    if (pthread_create(&logWriter, NULL, LogWriterThread, NULL)) {
+        fprintf(stderr, "Log writer thread create error : %s\n", strerror(errno));
+        return STATUS_ERROR;
+    }
+
+    __atomic_store_n(&logAsync, 1, __ATOMIC_RELEASE);
+    return STATUS_OK;
+}
+
+Status UTLT_LogAsyncStop() {
+    if (!__atomic_load_n(&logAsync, __ATOMIC_ACQUIRE))
+        return STATUS_OK;
+
+    __atomic_store_n(&logAsync, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&logWriterStop, 1, __ATOMIC_RELEASE);
+    pthread_join(logWriter, NULL);
+
+    // Records pushed while the writer is stopping
+    LogRingDrain();
+
+    return STATUS_OK;
+}
+
+void UTLT_LogGetStat(UTLT_LogStat *stat) {
+    stat->written = __atomic_load_n(&logWritten, __ATOMIC_RELAXED);
+    stat->dropped = LogDroppedSum();
+}
+
 int UTLT_LogPrint(int level, const char *filename, const int line, 
                   const char *funcname, const char *fmt, ...) {
+    // Dropped before formatting, logger would drop it anyway
+    if (level > utltLogLevel)
+        return STATUS_OK;
+
+    if (level < LOG_PANIC || level > LOG_TRACE) {
+        fprintf(stderr, "The log level %d is out of range.\n", level);
+        return STATUS_ERROR;
+    }
+
     char buffer[MAX_SIZE_OF_BUFFER];
 
-    unsigned int cnt, vspCnt;
+    int cnt, vspCnt;
     va_list vl;
     va_start(vl, fmt);
     vspCnt = vsnprintf(buffer, sizeof(buffer), fmt, vl);
+    va_end(vl);
     if (vspCnt < 0) {
         fprintf(stderr, "vsnprintf in UTLT_LogPrint error : %s\n", strerror(errno));
-        va_end(vl);
         return STATUS_ERROR;
     } else if (vspCnt == 0) {
         return STATUS_OK;
+    } else if (vspCnt >= sizeof(buffer)) {
+        vspCnt = sizeof(buffer) - 1;
     }
-    va_end(vl);
 
     if (reportCaller == REPORTCALLER_TRUE) {
         cnt = snprintf(buffer + vspCnt, sizeof(buffer) - vspCnt, " (%s:%d %s)", filename, line, funcname);
@@ -53,34 +331,16 @@ int UTLT_LogPrint(int level, const char *filename, const int line,
             fprintf(stderr, "sprintf in UTLT_LogPrint error : %s\n", strerror(errno));
             return STATUS_ERROR;
         }
+        vspCnt = (vspCnt + cnt >= sizeof(buffer) ? sizeof(buffer) - 1 : vspCnt + cnt);
     }
 
-    switch(level) {
-        case 0 :
-            UpfUtilLog_Panicln(UTLT_CStr2GoStr(buffer));
-            break;
-        case 1 :
-            UpfUtilLog_Fatalln(UTLT_CStr2GoStr(buffer));
-            break;
-        case 2 :
-            UpfUtilLog_Errorln(UTLT_CStr2GoStr(buffer));
-            break;
-        case 3 :
-            UpfUtilLog_Warningln(UTLT_CStr2GoStr(buffer));
-            break;
-        case 4 :
-            UpfUtilLog_Infoln(UTLT_CStr2GoStr(buffer));
-            break;
-        case 5 :
-            UpfUtilLog_Debugln(UTLT_CStr2GoStr(buffer));
-            break;
-        case 6 :
-            UpfUtilLog_Traceln(UTLT_CStr2GoStr(buffer));
-            break;
-        default :
-            fprintf(stderr, "The log level %d is out of range.\n", level);
-            return STATUS_ERROR;
+    // Panic and fatal logs stop the process, so they are never deferred
+    if (level > LOG_FATAL && __atomic_load_n(&logAsync, __ATOMIC_ACQUIRE)) {
+        LogRingPush(level, buffer, vspCnt);
+        return STATUS_OK;
     }
+
+    logOutput(level, buffer);
     return STATUS_OK;
 }
 
@@ -1,43 +1,137 @@
 #include "utlt_event.h"
 
 #include <stdlib.h>
+#include <errno.h>
+#include <sched.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
 
 #include "utlt_buff.h"
 #include "utlt_timer.h"
 
+/*
+ * Bounded multi-producer single-consumer ring. The seq of each slot tells
+ * its state: equal to the position while it is free for producers, one
+ * more than the position when the event is ready for the consumer.
+ * Producers only write the eventfd while the consumer is sleeping on it.
+ */
 typedef struct {
-    MQId mqId;
-    long msgsize;
+    uint64_t seq;
+    Event event;
+} __attribute__((aligned(32))) EvtQSlot;
+
+typedef struct {
+    uint64_t tail __attribute__((aligned(64)));     // Next position to produce
+    uint64_t head __attribute__((aligned(64)));     // Next position to consume
+    int waiting __attribute__((aligned(64)));       // Consumer is blocked in eventfd
+    int efd;
+    int option;
+    EvtQSlot slot[SIZE_OF_EVENT_QUEUE];
 } EvtQInfo;
 
 EvtQId EventQueueCreate(int option) {
-    EvtQInfo *evtq = UTLT_Malloc(sizeof(EvtQInfo));
-    UTLT_Assert(evtq, return (EvtQId) NULL, "");
-
-    evtq->mqId = MQCreate(O_RDWR | option);
-
-    if (evtq->mqId != (MQId) NULL) {
-        evtq->msgsize = MQGetMsgSize(evtq->mqId);
-        return (EvtQId) evtq;
-    } else {
-        return (EvtQId) NULL;
-    }
+    EvtQInfo *evtq = NULL;
+    UTLT_Assert(!posix_memalign((void **) &evtq, 64, sizeof(EvtQInfo)), return (EvtQId) NULL,
+        "Event queue allocate fail");
+
+    evtq->efd = eventfd(0, EFD_CLOEXEC);
+    UTLT_Assert(evtq->efd >= 0, free(evtq); return (EvtQId) NULL,
+        "eventfd fail: %s", strerror(errno));
+
+    evtq->tail = 0;
+    evtq->head = 0;
+    evtq->waiting = 0;
+    evtq->option = option;
+    for (uint64_t i = 0; i < SIZE_OF_EVENT_QUEUE; i++)
+        evtq->slot[i].seq = i;
+
+    return (EvtQId) evtq;
 }
 
 Status EventQueueDelete(EvtQId eqId) {
     EvtQInfo *evtq = (EvtQInfo*) eqId;
-    Status status;
 
     UTLT_Assert(evtq, return STATUS_ERROR, "");
-    status = MQDelete(evtq->mqId);
+    close(evtq->efd);
 
-    UTLT_Free(evtq);
-    return status;
+    free(evtq);
+    return STATUS_OK;
 }
 
-Status EventSend(EvtQId eqId, uintptr_t eventType, int argc, ...) {
-    EvtQInfo *evtq = (EvtQInfo*) eqId;
-    va_list ap;
+static inline Status EventEnqueue(EvtQInfo *evtq, const Event *event) {
+    uint64_t pos = __atomic_load_n(&evtq->tail, __ATOMIC_RELAXED);
+    EvtQSlot *slot;
+
+    while (1) {
+        slot = &evtq->slot[pos & (SIZE_OF_EVENT_QUEUE - 1)];
+        int64_t diff = (int64_t) (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) - pos);
+
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&evtq->tail, &pos, pos + 1, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        } else if (diff < 0) {
+            return STATUS_EAGAIN;
+        } else {
+            pos = __atomic_load_n(&evtq->tail, __ATOMIC_RELAXED);
+        }
+    }
+
+    slot->event = *event;
+    __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+
+    return STATUS_OK;
+}
+
+static inline int EventDequeue(EvtQInfo *evtq, Event *events, int num) {
+    uint64_t pos = evtq->head;
+    int cnt;
+
+    for (cnt = 0; cnt < num; cnt++, pos++) {
+        EvtQSlot *slot = &evtq->slot[pos & (SIZE_OF_EVENT_QUEUE - 1)];
+        if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != pos + 1)
+            break;
+
+        events[cnt] = slot->event;
+        __atomic_store_n(&slot->seq, pos + SIZE_OF_EVENT_QUEUE, __ATOMIC_RELEASE);
+    }
+    evtq->head = pos;
+
+    return cnt;
+}
+
+static void EventWakeUp(EvtQInfo *evtq) {
+    // Pairs with the fence in EventWait, either the consumer sees the event or we see it waiting
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&evtq->waiting, __ATOMIC_RELAXED) &&
+        __atomic_exchange_n(&evtq->waiting, 0, __ATOMIC_RELAXED)) {
+        uint64_t one = 1;
+        UTLT_Assert(write(evtq->efd, &one, sizeof(one)) == sizeof(one), ,
+            "eventfd write fail: %s", strerror(errno));
+    }
+}
+
+static int EventWait(EvtQInfo *evtq, Event *events, int num) {
+    __atomic_store_n(&evtq->waiting, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    int cnt = EventDequeue(evtq, events, num);
+    if (cnt) {
+        __atomic_store_n(&evtq->waiting, 0, __ATOMIC_RELAXED);
+        return cnt;
+    }
+
+    uint64_t value;
+    if (read(evtq->efd, &value, sizeof(value)) < 0 && errno != EINTR) {
+        UTLT_Error("eventfd read fail: %s", strerror(errno));
+        return -1;
+    }
+
+    return 0;
+}
+
+static Status EventSendV(EvtQInfo *evtq, int nonblock, uintptr_t eventType, int argc, va_list ap) {
     Event event;
     uintptr_t *ptr;
     int i;
@@ -47,22 +141,70 @@ Status EventSend(EvtQId eqId, uintptr_t eventType, int argc, ...) {
     event.type = eventType;
     event.argc = argc;
 
-    va_start(ap, argc);
     ptr = &event.arg0;
     for (i = 0; i < argc; i++) {
         *ptr = va_arg(ap, uintptr_t);
         ptr++;
     }
+
+    while (EventEnqueue(evtq, &event) != STATUS_OK) {
+        if (nonblock || (evtq->option & EVTQ_O_NONBLOCK))
+            return STATUS_EAGAIN;
+        // Full, let the consumer run
+        sched_yield();
+    }
+
+    EventWakeUp(evtq);
+    return STATUS_OK;
+}
+
+Status EventSend(EvtQId eqId, uintptr_t eventType, int argc, ...) {
+    va_list ap;
+
+    va_start(ap, argc);
+    Status status = EventSendV((EvtQInfo*) eqId, 0, eventType, argc, ap);
+    va_end(ap);
+
+    return status;
+}
+
+Status EventTrySend(EvtQId eqId, uintptr_t eventType, int argc, ...) {
+    va_list ap;
+
+    va_start(ap, argc);
+    Status status = EventSendV((EvtQInfo*) eqId, 1, eventType, argc, ap);
     va_end(ap);
 
-    return MQSend(evtq->mqId, (const char*) &event, sizeof(Event));
+    return status;
 }
 
 Status EventRecv(EvtQId eqId, Event *event) {
+    int cnt = EventRecvBatch(eqId, event, 1);
+
+    if (cnt < 0)
+        return STATUS_ERROR;
+    return (cnt ? STATUS_OK : STATUS_EAGAIN);
+}
+
+int EventRecvBatch(EvtQId eqId, Event *events, int num) {
     EvtQInfo *evtq = (EvtQInfo*) eqId;
-    UTLT_Assert(evtq, return STATUS_ERROR, "");
+    UTLT_Assert(evtq && events && num > 0, return -1, "");
+
+    int cnt = EventDequeue(evtq, events, num);
+    while (!cnt && !(evtq->option & EVTQ_O_NONBLOCK)) {
+        cnt = EventWait(evtq, events, num);
+        if (!cnt)
+            cnt = EventDequeue(evtq, events, num);
+    }
+
+    return cnt;
+}
+
+int EventTryRecvBatch(EvtQId eqId, Event *events, int num) {
+    EvtQInfo *evtq = (EvtQInfo*) eqId;
+    UTLT_Assert(evtq && events && num > 0, return -1, "");
 
-    return MQRecv(evtq->mqId, (char*) event, evtq->msgsize);
+    return EventDequeue(evtq, events, num);
 }
 
 void EventTimerExpire(uintptr_t data, uintptr_t param[]) {
@@ -8,7 +8,8 @@
 void *AllocArray(Hash *ht, int max) {
     uint32_t size = sizeof(*ht->array) * (max + 1);
     void *ptr = UTLT_Calloc(1, size);
-    memset(ptr, 0, size);
+    if (ptr)
+        memset(ptr, 0, size);
     return ptr;
 }
 
@@ -115,8 +116,12 @@ static void ExpandArray(Hash *ht) {
     HashEntry **new_array;
     unsigned int new_max;
 
+    // Chains get longer instead once the array is as large as UTLT_Malloc() can be
     new_max = ht->max * 2 + 1;
+    if (sizeof(*ht->array) * (new_max + 1) > MAX_SIZE_OF_UTLT_MALLOC)
+        return;
     new_array = AllocArray(ht, new_max);
+    UTLT_Assert(new_array, return, "Hash array expand failed");
     for (hi = HashFirst(ht); hi; hi = HashNext(hi)) {
         unsigned int i = hi->this->hash & new_max;
         hi->this->next = new_array[i];
@@ -0,0 +1,451 @@
+#include "utlt_index.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include "utlt_debug.h"
+
+/*
+ * Free objects of a pool are kept in a lock-free stack, and each thread caches
+ * some of them, so that most of alloc and free never touch shared memory. Only
+ * growing a chunk takes a lock. Caches are only for pools large enough that
+ * objects cached by other threads do not starve the caller.
+ */
+
+#define SIZE_OF_INDEX_CHUNK         (64 * 1024)
+#define SIZE_OF_INDEX_HUGEPAGE      (2 * 1024 * 1024)
+#define MAX_NUM_OF_INDEX_CACHE      32      // Objects of a pool cached by a thread
+#define INDEX_CACHE_RATIO           64      // A thread caches at most 1/64 of capacity
+
+#define INDEX_MAGIC_FREE            0xF4EE
+#define INDEX_MAGIC_USED            0x1D0C
+
+/**
+ * IndexObj - Header of each object in chunk
+ *
+ * @index: Index in its pool
+ * @next: @index + 1 of the next object in free stack, 0 is the end
+ * @magic: INDEX_MAGIC_FREE or INDEX_MAGIC_USED
+ */
+typedef struct {
+    uint32_t index;
+    uint32_t next;
+    uint16_t magic;
+    uint16_t reserved[3];   // Keep objects 16-byte aligned
+} IndexObj;
+
+typedef struct {
+    IndexPool *pool;
+    uint32_t generation;
+    uint32_t num;
+    IndexObj *obj[MAX_NUM_OF_INDEX_CACHE];
+} IndexCachePool;
+
+typedef struct {
+    IndexCachePool pool[MAX_NUM_OF_INDEX_POOL];
+} IndexCache;
+
+static IndexPool *indexPoolTable[MAX_NUM_OF_INDEX_POOL];
+static pthread_mutex_t indexPoolLock = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t indexPoolGeneration = 0;    // Thread caches of an old generation are dropped
+
+static pthread_once_t indexCacheOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t indexCacheKey;
+static __thread IndexCache *indexCacheSelf = NULL;
+
+static inline IndexObj *IndexPoolObj(IndexPool *pool, uint8_t *chunk, uint32_t index) {
+    return (IndexObj *) (chunk + (size_t) (index & ((1U << pool->chunkShift) - 1)) * pool->stride);
+}
+
+static inline IndexObj *IndexPoolObjByIndex(IndexPool *pool, uint32_t index) {
+    return IndexPoolObj(pool, pool->chunk[index >> pool->chunkShift], index);
+}
+
+static IndexObj *IndexPoolPop(IndexPool *pool) {
+    uint64_t head = __atomic_load_n(&pool->head, __ATOMIC_ACQUIRE), newHead;
+    IndexObj *obj;
+
+    do {
+        if (!(uint32_t) head)
+            return NULL;
+        // Chunks are never freed before IndexPoolFinal(), so a stale @next is harmless
+        obj = IndexPoolObjByIndex(pool, (uint32_t) head - 1);
+        newHead = (((head >> 32) + 1) << 32) | __atomic_load_n(&obj->next, __ATOMIC_RELAXED);
+    } while (!__atomic_compare_exchange_n(&pool->head, &head, newHead, 1,
+                                          __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE));
+
+    return obj;
+}
+
+// Push objects linked from @first to @last
+static void IndexPoolPush(IndexPool *pool, IndexObj *first, IndexObj *last) {
+    uint64_t head = __atomic_load_n(&pool->head, __ATOMIC_RELAXED), newHead;
+
+    do {
+        __atomic_store_n(&last->next, (uint32_t) head, __ATOMIC_RELAXED);
+        newHead = (((head >> 32) + 1) << 32) | (first->index + 1);
+    } while (!__atomic_compare_exchange_n(&pool->head, &head, newHead, 1,
+                                          __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+static Status IndexPoolGrow(IndexPool *pool) {
+    Status status = STATUS_OK;
+    uint32_t head = (uint32_t) __atomic_load_n(&pool->head, __ATOMIC_RELAXED);
+
+    pthread_mutex_lock(&pool->growLock);
+
+    // Another thread has grown it while this one waits for the lock
+    if (!head && (uint32_t) __atomic_load_n(&pool->head, __ATOMIC_ACQUIRE))
+        goto unlock;
+
+    if (pool->numOfChunk == pool->maxChunk) {
+        status = STATUS_ERROR;
+        goto unlock;
+    }
+
+    uint32_t base = pool->numOfChunk << pool->chunkShift;
+    uint32_t num = pool->capacity - base;
+    if (num > (1U << pool->chunkShift))
+        num = 1U << pool->chunkShift;
+
+    uint8_t *chunk = (pool->region ?
+        pool->region + ((size_t) pool->numOfChunk << pool->chunkShift) * pool->stride :
+        malloc((size_t) num * pool->stride));
+    if (!chunk) {
+        UTLT_Error("Chunk %u of %s alloc fail", pool->numOfChunk, pool->name);
+        status = STATUS_ERROR;
+        goto unlock;
+    }
+
+    for (uint32_t i = 0; i < num; i++) {
+        IndexObj *obj = IndexPoolObj(pool, chunk, i);
+        obj->index = base + i;
+        obj->next = (i + 1 < num ? base + i + 2 : 0);
+        obj->magic = INDEX_MAGIC_FREE;
+    }
+
+    // The chunk is visible to IndexPoolFind() before any of its objects is popped
+    __atomic_store_n(&pool->chunk[pool->numOfChunk], chunk, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&pool->numOfChunk, 1, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&pool->allocated, num, __ATOMIC_RELAXED);
+
+    IndexPoolPush(pool, IndexPoolObj(pool, chunk, 0), IndexPoolObj(pool, chunk, num - 1));
+
+unlock:
+    pthread_mutex_unlock(&pool->growLock);
+    return status;
+}
+
+static IndexObj *IndexPoolTake(IndexPool *pool) {
+    // Objects of a new chunk may be taken by other threads before this one pops
+    IndexObj *obj;
+    while (!(obj = IndexPoolPop(pool))) {
+        if (IndexPoolGrow(pool) != STATUS_OK)
+            return NULL;
+    }
+
+    return obj;
+}
+
+// Give back the first @num objects of cache to free stack
+static void IndexCacheFlush(IndexPool *pool, IndexCachePool *cache, uint32_t num) {
+    if (!num)
+        return;
+
+    IndexObj **obj = cache->obj;
+    for (uint32_t i = 0; i + 1 < num; i++)
+        obj[i]->next = obj[i + 1]->index + 1;
+    IndexPoolPush(pool, obj[0], obj[num - 1]);
+
+    cache->num -= num;
+    memmove(obj, obj + num, cache->num * sizeof(IndexObj *));
+}
+
+// Take half of cache capacity from free stack, and return one of them
+static IndexObj *IndexCacheRefill(IndexPool *pool, IndexCachePool *cache) {
+    IndexObj *obj = IndexPoolTake(pool), *more;
+    if (!obj)
+        return NULL;
+
+    // Stored in reverse, so objects are handed out in the order of index
+    uint32_t num = 0;
+    while (num < pool->cacheCap / 2 && (more = IndexPoolPop(pool)))
+        cache->obj[pool->cacheCap / 2 - 1 - num++] = more;
+    if (num < pool->cacheCap / 2)
+        memmove(cache->obj, cache->obj + pool->cacheCap / 2 - num, num * sizeof(IndexObj *));
+    cache->num = num;
+
+    return obj;
+}
+
+// Objects cached by an exiting thread are given back
+static void IndexCacheRelease(void *data) {
+    IndexCache *cache = data;
+
+    pthread_mutex_lock(&indexPoolLock);
+    for (int i = 0; i < MAX_NUM_OF_INDEX_POOL; i++) {
+        IndexPool *pool = indexPoolTable[i];
+        if (pool && cache->pool[i].pool == pool && cache->pool[i].generation == pool->generation)
+            IndexCacheFlush(pool, &cache->pool[i], cache->pool[i].num);
+    }
+    pthread_mutex_unlock(&indexPoolLock);
+
+    free(cache);
+}
+
+static void IndexCacheKeyCreate() {
+    pthread_key_create(&indexCacheKey, IndexCacheRelease);
+}
+
+static IndexCachePool *IndexCacheGet(IndexPool *pool) {
+    if (!pool->cacheCap)
+        return NULL;
+
+    IndexCache *cache = indexCacheSelf;
+    if (!cache) {
+        pthread_once(&indexCacheOnce, IndexCacheKeyCreate);
+
+        cache = calloc(1, sizeof(IndexCache));
+        UTLT_Assert(cache, return NULL, "Index cache of thread alloc fail");
+        indexCacheSelf = cache;
+        pthread_setspecific(indexCacheKey, cache);
+    }
+
+    // Objects cached before the pool is terminated are freed with their chunks
+    IndexCachePool *cachePool = &cache->pool[pool->id];
+    if (cachePool->pool != pool || cachePool->generation != pool->generation) {
+        cachePool->pool = pool;
+        cachePool->generation = pool->generation;
+        cachePool->num = 0;
+    }
+
+    return cachePool;
+}
+
+// Reserve address space of all chunks, on hugepages if the system has enough of them
+static Status IndexPoolReserve(IndexPool *pool) {
+    size_t size = ((size_t) pool->maxChunk << pool->chunkShift) * pool->stride;
+    size = (size + SIZE_OF_INDEX_HUGEPAGE - 1) & ~((size_t) SIZE_OF_INDEX_HUGEPAGE - 1);
+
+    void *region = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (region != MAP_FAILED) {
+        pool->backing = "hugetlb";
+    } else {
+        UTLT_Debug("%s is not on reserved hugepages: %s", pool->name, strerror(errno));
+        region = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        UTLT_Assert(region != MAP_FAILED, return STATUS_ERROR,
+            "Reserve %lu bytes for %s fail: %s", size, pool->name, strerror(errno));
+        if (madvise(region, size, MADV_HUGEPAGE))
+            UTLT_Debug("%s is not on transparent hugepages: %s", pool->name, strerror(errno));
+        pool->backing = "thp";
+    }
+
+    pool->region = region;
+    pool->regionSize = size;
+
+    return STATUS_OK;
+}
+
+Status IndexPoolInit(IndexPool *pool, uint32_t capacity, uint32_t flags) {
+    UTLT_Assert(pool && pool->size, return STATUS_ERROR, "Pool is not declared");
+    UTLT_Assert(capacity, return STATUS_ERROR, "Capacity of %s should be positive", pool->name);
+
+    if (pool->initialized) {
+        UTLT_Warning("%s has been initialized, it is terminated first", pool->name);
+        IndexPoolFinal(pool);
+    }
+
+    const char *name = pool->name;
+    uint32_t size = pool->size;
+    memset(pool, 0, sizeof(IndexPool));
+    pool->name = name;
+    pool->size = size;
+
+    pool->stride = (sizeof(IndexObj) + size + 15) & ~15U;
+    pool->capacity = capacity;
+    while (pool->chunkShift < 31 && ((size_t) pool->stride << (pool->chunkShift + 1)) <= SIZE_OF_INDEX_CHUNK &&
+           (1U << pool->chunkShift) < capacity)
+        pool->chunkShift++;
+    pool->maxChunk = ((capacity - 1) >> pool->chunkShift) + 1;
+
+    pool->chunk = calloc(pool->maxChunk, sizeof(uint8_t *));
+    UTLT_Assert(pool->chunk, return STATUS_ERROR, "Chunk array of %s alloc fail", name);
+
+    pool->flags = flags;
+    pool->backing = "malloc";
+    if (flags & INDEX_POOL_HUGEPAGE) {
+        UTLT_Assert(IndexPoolReserve(pool) == STATUS_OK,
+            free(pool->chunk); pool->chunk = NULL; return STATUS_ERROR, "");
+    }
+    pthread_mutex_init(&pool->growLock, 0);
+
+    pool->cacheCap = capacity / INDEX_CACHE_RATIO;
+    if (pool->cacheCap > MAX_NUM_OF_INDEX_CACHE)
+        pool->cacheCap = MAX_NUM_OF_INDEX_CACHE;
+    if (pool->cacheCap < 2)
+        pool->cacheCap = 0;
+
+    pool->id = -1;
+    pthread_mutex_lock(&indexPoolLock);
+    pool->generation = ++indexPoolGeneration;
+    for (int i = 0; i < MAX_NUM_OF_INDEX_POOL; i++) {
+        if (!indexPoolTable[i]) {
+            indexPoolTable[i] = pool;
+            pool->id = i;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&indexPoolLock);
+
+    if (pool->id < 0) {
+        UTLT_Warning("Too many pools, %s has no thread cache and statistics", name);
+        pool->cacheCap = 0;
+    }
+
+    pool->initialized = 1;
+    UTLT_Trace("%s Init Finish: capacity %u, %u per chunk", name, capacity, 1U << pool->chunkShift);
+
+    return STATUS_OK;
+}
+
+Status IndexPoolFinal(IndexPool *pool) {
+    UTLT_Assert(pool && pool->initialized, return STATUS_ERROR,
+        "%s is not initialized", (pool ? pool->name : "Pool"));
+
+    // All objects are freed, those still used or cached by other threads are gone as well
+    pthread_mutex_lock(&indexPoolLock);
+    if (pool->id >= 0)
+        indexPoolTable[pool->id] = NULL;
+    pool->generation = 0;
+    pool->initialized = 0;
+    pthread_mutex_unlock(&indexPoolLock);
+
+    if (pool->region) {
+        munmap(pool->region, pool->regionSize);
+        pool->region = NULL;
+    } else {
+        for (uint32_t i = 0; i < pool->numOfChunk; i++)
+            free(pool->chunk[i]);
+    }
+    free(pool->chunk);
+    pool->chunk = NULL;
+    pool->numOfChunk = pool->allocated = pool->used = 0;
+    pool->head = 0;
+    pthread_mutex_destroy(&pool->growLock);
+
+    return STATUS_OK;
+}
+
+void *IndexPoolAlloc(IndexPool *pool, uint32_t *index) {
+    UTLT_Assert(pool && pool->initialized, return NULL,
+        "%s is not initialized", (pool ? pool->name : "Pool"));
+
+    IndexCachePool *cache = IndexCacheGet(pool);
+    IndexObj *obj;
+
+    if (cache && cache->num)
+        obj = cache->obj[--cache->num];
+    else
+        obj = (cache ? IndexCacheRefill(pool, cache) : IndexPoolTake(pool));
+
+    if (!obj) {
+        __atomic_fetch_add(&pool->fail, 1, __ATOMIC_RELAXED);
+        UTLT_Warning("%s is empty", pool->name);
+        return NULL;
+    }
+
+    uint32_t used = __atomic_add_fetch(&pool->used, 1, __ATOMIC_RELAXED);
+    uint32_t highWater = __atomic_load_n(&pool->highWater, __ATOMIC_RELAXED);
+    while (used > highWater &&
+           !__atomic_compare_exchange_n(&pool->highWater, &highWater, used, 1,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+    obj->magic = INDEX_MAGIC_USED;
+    if (index)
+        *index = obj->index;
+
+    return obj + 1;
+}
+
+Status IndexPoolFree(IndexPool *pool, void *ptr) {
+    UTLT_Assert(pool && pool->initialized, return STATUS_ERROR,
+        "%s is not initialized", (pool ? pool->name : "Pool"));
+    UTLT_Assert(ptr, return STATUS_ERROR, "Object of %s is NULL", pool->name);
+
+    IndexObj *obj = (IndexObj *) ptr - 1;
+    UTLT_Assert(obj->magic == INDEX_MAGIC_USED && obj->index < pool->capacity &&
+                IndexPoolFind(pool, obj->index) == ptr,
+        return STATUS_ERROR, "Object %p is not in use, it may not belong to %s", ptr, pool->name);
+
+    obj->magic = INDEX_MAGIC_FREE;
+    __atomic_fetch_sub(&pool->used, 1, __ATOMIC_RELAXED);
+
+    IndexCachePool *cache = IndexCacheGet(pool);
+    if (!cache) {
+        IndexPoolPush(pool, obj, obj);
+        return STATUS_OK;
+    }
+
+    if (cache->num == pool->cacheCap)
+        IndexCacheFlush(pool, cache, pool->cacheCap / 2);
+    cache->obj[cache->num++] = obj;
+
+    return STATUS_OK;
+}
+
+void *IndexPoolFind(IndexPool *pool, uint32_t index) {
+    if (index >= pool->capacity)
+        return NULL;
+
+    uint8_t *chunk = __atomic_load_n(&pool->chunk[index >> pool->chunkShift], __ATOMIC_ACQUIRE);
+    return (chunk ? IndexPoolObj(pool, chunk, index) + 1 : NULL);
+}
+
+int IndexPoolStats(IndexPoolStat *stat, int num) {
+    UTLT_Assert(stat && num >= 0, return 0, "IndexPoolStat is NULL");
+
+    int cnt = 0;
+    pthread_mutex_lock(&indexPoolLock);
+    for (int i = 0; i < MAX_NUM_OF_INDEX_POOL && cnt < num; i++) {
+        IndexPool *pool = indexPoolTable[i];
+        if (!pool)
+            continue;
+
+        stat[cnt].name = pool->name;
+        stat[cnt].size = pool->size;
+        stat[cnt].capacity = pool->capacity;
+        stat[cnt].numOfChunk = __atomic_load_n(&pool->numOfChunk, __ATOMIC_ACQUIRE);
+        stat[cnt].allocated = __atomic_load_n(&pool->allocated, __ATOMIC_RELAXED);
+        stat[cnt].used = __atomic_load_n(&pool->used, __ATOMIC_RELAXED);
+        stat[cnt].highWater = __atomic_load_n(&pool->highWater, __ATOMIC_RELAXED);
+        stat[cnt].memory = (uint64_t) stat[cnt].allocated * pool->stride +
+                           (uint64_t) pool->maxChunk * sizeof(uint8_t *);
+        stat[cnt].reserved = pool->regionSize;
+        stat[cnt].backing = pool->backing;
+        stat[cnt].fail = __atomic_load_n(&pool->fail, __ATOMIC_RELAXED);
+        cnt++;
+    }
+    pthread_mutex_unlock(&indexPoolLock);
+
+    return cnt;
+}
+
+void IndexPoolReport() {
+    IndexPoolStat stat[MAX_NUM_OF_INDEX_POOL];
+    int num = IndexPoolStats(stat, MAX_NUM_OF_INDEX_POOL);
+
+    UTLT_Info("Index pool: %-20s %6s %9s %6s %9s %9s %9s %10s %12s %7s %6s",
+        "name", "size", "capacity", "chunks", "allocated", "used", "highWater",
+        "memory", "reserved", "backing", "fail");
+    for (int i = 0; i < num; i++) {
+        UTLT_Info("Index pool: %-20s %6u %9u %6u %9u %9u %9u %10lu %12lu %7s %6lu",
+            stat[i].name, stat[i].size, stat[i].capacity, stat[i].numOfChunk, stat[i].allocated,
+            stat[i].used, stat[i].highWater, stat[i].memory, stat[i].reserved, stat[i].backing,
+            stat[i].fail);
+    }
+}
@@ -0,0 +1,275 @@
+#include "utlt_ipfilter.h"
+
+#include <string.h>
+#include <strings.h>
+
+typedef struct {
+    const char *pos;
+    const char *end;
+} IPFilterCursor;
+
+typedef struct {
+    const char *str;
+    int len;
+} IPFilterToken;
+
+static inline int IPFilterIsDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+static inline int IPFilterTokenIs(const IPFilterToken *tok, const char *keyword) {
+    return tok->len == (int) strlen(keyword) && !strncasecmp(tok->str, keyword, tok->len);
+}
+
+/*
+ * Take the next token which ends with a space or the end of string,
+ * the tokens must be separated by exactly one space
+ */
+static Status IPFilterNextToken(IPFilterCursor *cur, IPFilterToken *tok) {
+    const char *pos = cur->pos;
+
+    while (pos < cur->end && *pos != ' ')
+        pos++;
+
+    tok->str = cur->pos;
+    tok->len = pos - cur->pos;
+    if (!tok->len)
+        return STATUS_ERROR;
+
+    if (pos < cur->end) {
+        // Skip the separator, it is not allowed at the end
+        pos++;
+        if (pos == cur->end)
+            return STATUS_ERROR;
+    }
+    cur->pos = pos;
+
+    return STATUS_OK;
+}
+
+static inline int IPFilterCursorEnd(const IPFilterCursor *cur) {
+    return cur->pos == cur->end;
+}
+
+/*
+ * Parse at most @maxDigit decimal digits from @str, @return the number of
+ * characters consumed, 0 if none or the value is larger than @max
+ */
+static int IPFilterParseNumber(const char *str, int len, int maxDigit, uint32_t max, uint32_t *value) {
+    uint32_t v = 0;
+    int i;
+
+    for (i = 0; i < len && i < maxDigit && IPFilterIsDigit(str[i]); i++)
+        v = v * 10 + (str[i] - '0');
+
+    if (!i || v > max)
+        return 0;
+
+    *value = v;
+    return i;
+}
+
+static Status IPFilterParseProto(const IPFilterToken *tok, uint8_t *proto) {
+    uint32_t value;
+
+    if (IPFilterTokenIs(tok, "ip")) {
+        *proto = 0;
+        return STATUS_OK;
+    }
+
+    if (IPFilterParseNumber(tok->str, tok->len, 3, 0xFF, &value) != tok->len)
+        return STATUS_ERROR;
+
+    *proto = value;
+    return STATUS_OK;
+}
+
+// Dotted decimal with the same rules as inet_pton, no leading zero is allowed
+static Status IPFilterParseIPv4(const char *str, int len, struct in_addr *addr) {
+    uint8_t *octet = (uint8_t *) &addr->s_addr;
+    int i = 0;
+
+    for (int n = 0; n < 4; n++) {
+        uint32_t value;
+        int digit;
+
+        if (n) {
+            if (i >= len || str[i] != '.')
+                return STATUS_ERROR;
+            i++;
+        }
+
+        digit = IPFilterParseNumber(str + i, len - i, 3, 0xFF, &value);
+        if (!digit || (digit > 1 && str[i] == '0'))
+            return STATUS_ERROR;
+
+        octet[n] = value;
+        i += digit;
+    }
+
+    return (i == len ? STATUS_OK : STATUS_ERROR);
+}
+
+static Status IPFilterParseIPv6(const char *str, int len, struct in6_addr *addr) {
+    char buf[INET6_ADDRSTRLEN];
+
+    if (len >= (int) sizeof(buf))
+        return STATUS_ERROR;
+
+    memcpy(buf, str, len);
+    buf[len] = '\0';
+
+    return (inet_pton(AF_INET6, buf, addr) == 1 ? STATUS_OK : STATUS_ERROR);
+}
+
+static Status IPFilterParseAddr(const IPFilterToken *tok, IPFilterAddr *addr) {
+    const char *slash;
+    int addrLen;
+    uint32_t prefixLen;
+
+    if (IPFilterTokenIs(tok, "any")) {
+        addr->type = IPFILTER_ADDR_ANY;
+        return STATUS_OK;
+    }
+    if (IPFilterTokenIs(tok, "assigned")) {
+        addr->type = IPFILTER_ADDR_ASSIGNED;
+        return STATUS_OK;
+    }
+
+    slash = memchr(tok->str, '/', tok->len);
+    addrLen = slash ? slash - tok->str : tok->len;
+
+    if (memchr(tok->str, ':', addrLen)) {
+        addr->type = IPFILTER_ADDR_IPV6;
+        addr->prefixLen = 128;
+        if (IPFilterParseIPv6(tok->str, addrLen, &addr->ipv6) != STATUS_OK)
+            return STATUS_ERROR;
+    } else {
+        addr->type = IPFILTER_ADDR_IPV4;
+        addr->prefixLen = 32;
+        if (IPFilterParseIPv4(tok->str, addrLen, &addr->ipv4) != STATUS_OK)
+            return STATUS_ERROR;
+    }
+
+    if (slash) {
+        int maskLen = tok->len - addrLen - 1;
+        int maxDigit = (addr->type == IPFILTER_ADDR_IPV4 ? 2 : 3);
+
+        if (!maskLen || IPFilterParseNumber(slash + 1, maskLen, maxDigit, addr->prefixLen, &prefixLen) != maskLen)
+            return STATUS_ERROR;
+        addr->prefixLen = prefixLen;
+    }
+
+    return STATUS_OK;
+}
+
+static Status IPFilterParsePorts(const IPFilterToken *tok, IPFilterAddr *addr) {
+    int i = 0;
+
+    while (i < tok->len) {
+        uint32_t start, end;
+        int digit;
+
+        if (addr->portNum == MAX_NUM_OF_IPFILTER_PORT)
+            return STATUS_ERROR;
+
+        digit = IPFilterParseNumber(tok->str + i, tok->len - i, 5, 0xFFFF, &start);
+        if (!digit)
+            return STATUS_ERROR;
+        i += digit;
+        end = start;
+
+        if (i < tok->len && tok->str[i] == '-') {
+            i++;
+            digit = IPFilterParseNumber(tok->str + i, tok->len - i, 5, 0xFFFF, &end);
+            if (!digit)
+                return STATUS_ERROR;
+            i += digit;
+
+            if (start > end) {
+                uint32_t tmp = start;
+                start = end;
+                end = tmp;
+            }
+        }
+
+        addr->portList[addr->portNum++] = (start << 16) | end;
+
+        if (i < tok->len) {
+            // Only one range is allowed between commas, and no comma at the end
+            if (tok->str[i] != ',' || i + 1 == tok->len)
+                return STATUS_ERROR;
+            i++;
+        }
+    }
+
+    return STATUS_OK;
+}
+
+// <addr> [<ports>], @tok is the address and the next token is put in it
+static Status IPFilterParseEndpoint(IPFilterCursor *cur, IPFilterToken *tok, IPFilterAddr *addr) {
+    if (IPFilterParseAddr(tok, addr) != STATUS_OK)
+        return STATUS_ERROR;
+
+    if (IPFilterCursorEnd(cur)) {
+        tok->len = 0;
+        return STATUS_OK;
+    }
+
+    if (IPFilterNextToken(cur, tok) != STATUS_OK)
+        return STATUS_ERROR;
+
+    if (IPFilterIsDigit(tok->str[0])) {
+        if (IPFilterParsePorts(tok, addr) != STATUS_OK)
+            return STATUS_ERROR;
+
+        if (IPFilterCursorEnd(cur))
+            tok->len = 0;
+        else if (IPFilterNextToken(cur, tok) != STATUS_OK)
+            return STATUS_ERROR;
+    }
+
+    return STATUS_OK;
+}
+
+Status IPFilterRuleParse(IPFilterRule *rule, const char *str, int len) {
+    UTLT_Assert(rule && str && len >= 0, return STATUS_ERROR, "IPFilterRule or string should not be NULL");
+
+    IPFilterCursor cur = {str, str + len};
+    IPFilterToken tok;
+
+    memset(rule, 0, sizeof(IPFilterRule));
+
+    if (IPFilterNextToken(&cur, &tok) != STATUS_OK || !IPFilterTokenIs(&tok, "permit"))
+        return STATUS_ERROR;
+
+    if (IPFilterNextToken(&cur, &tok) != STATUS_OK)
+        return STATUS_ERROR;
+    if (IPFilterTokenIs(&tok, "in"))
+        rule->direction = IPFILTER_DIRECTION_IN;
+    else if (IPFilterTokenIs(&tok, "out"))
+        rule->direction = IPFILTER_DIRECTION_OUT;
+    else
+        return STATUS_ERROR;
+
+    if (IPFilterNextToken(&cur, &tok) != STATUS_OK || IPFilterParseProto(&tok, &rule->proto) != STATUS_OK)
+        return STATUS_ERROR;
+
+    if (IPFilterNextToken(&cur, &tok) != STATUS_OK || !IPFilterTokenIs(&tok, "from"))
+        return STATUS_ERROR;
+
+    if (IPFilterNextToken(&cur, &tok) != STATUS_OK ||
+        IPFilterParseEndpoint(&cur, &tok, &rule->src) != STATUS_OK || !IPFilterTokenIs(&tok, "to"))
+        return STATUS_ERROR;
+
+    if (IPFilterNextToken(&cur, &tok) != STATUS_OK ||
+        IPFilterParseEndpoint(&cur, &tok, &rule->dst) != STATUS_OK || tok.len)
+        return STATUS_ERROR;
+
+    // Both addresses must be in the same family
+    if ((rule->src.type == IPFILTER_ADDR_IPV4 && rule->dst.type == IPFILTER_ADDR_IPV6) ||
+        (rule->src.type == IPFILTER_ADDR_IPV6 && rule->dst.type == IPFILTER_ADDR_IPV4))
+        return STATUS_ERROR;
+
+    return STATUS_OK;
+}
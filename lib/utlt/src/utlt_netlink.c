@@ -0,0 +1,144 @@
+#include "utlt_netlink.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+
+Status NetlinkBatchInit(NetlinkBatch *batch, int fd, uint32_t seq) {
+    UTLT_Assert(batch && fd >= 0, return STATUS_ERROR, "NetlinkBatch or socket is invalid");
+
+    batch->fd = fd;
+    batch->seq = seq;
+    batch->len = 0;
+    batch->numOfMsg = 0;
+    batch->pendingFail = 0;
+    batch->pendingError = 0;
+    batch->numOfFail = 0;
+    batch->error = 0;
+    batch->sockError = 0;
+
+    return STATUS_OK;
+}
+
+Status NetlinkBatchTerm(NetlinkBatch *batch) {
+    UTLT_Assert(batch, return STATUS_ERROR, "NetlinkBatch is NULL");
+
+    batch->fd = -1;
+    batch->len = 0;
+    batch->numOfMsg = 0;
+
+    return STATUS_OK;
+}
+
+static Status NetlinkBatchSend(NetlinkBatch *batch) {
+    ssize_t sent;
+
+    do {
+        sent = send(batch->fd, batch->buf, batch->len, 0);
+    } while (sent < 0 && errno == EINTR);
+
+    if (sent != batch->len) {
+        batch->sockError = (sent < 0 ? errno : EMSGSIZE);
+        return STATUS_ERROR;
+    }
+
+    return STATUS_OK;
+}
+
+// Wait until each queued message has its ACK, the replies of other requests are skipped
+static Status NetlinkBatchCollectAck(NetlinkBatch *batch) {
+    // An error ACK echoes the request, so it may be as large as the request itself
+    char buf[MAX_SIZE_OF_NETLINK_MSG + NLMSG_LENGTH(sizeof(struct nlmsgerr))]
+        __attribute__((aligned(NLMSG_ALIGNTO)));
+    uint32_t firstSeq = batch->seq - batch->numOfMsg;
+    int acked = 0;
+
+    while (acked < batch->numOfMsg) {
+        ssize_t len = recv(batch->fd, buf, sizeof(buf), 0);
+        if (len < 0) {
+            if (errno == EINTR)
+                continue;
+            batch->sockError = errno;
+            return STATUS_ERROR;
+        }
+        if (len == 0) {
+            batch->sockError = ECONNRESET;
+            return STATUS_ERROR;
+        }
+
+        int remain = len;
+        for (struct nlmsghdr *nlh = (struct nlmsghdr *) buf; NLMSG_OK(nlh, remain); nlh = NLMSG_NEXT(nlh, remain)) {
+            if (nlh->nlmsg_type != NLMSG_ERROR || nlh->nlmsg_seq - firstSeq >= (uint32_t) batch->numOfMsg)
+                continue;
+
+            if (nlh->nlmsg_len >= NLMSG_LENGTH(sizeof(struct nlmsgerr))) {
+                const struct nlmsgerr *err = NLMSG_DATA(nlh);
+                if (err->error) {
+                    if (!batch->pendingFail)
+                        batch->pendingError = -err->error;
+                    batch->pendingFail++;
+                }
+            }
+            acked++;
+        }
+    }
+
+    return STATUS_OK;
+}
+
+static Status NetlinkBatchTalk(NetlinkBatch *batch) {
+    Status status = (batch->sockError ? STATUS_ERROR : STATUS_OK);
+
+    if (status == STATUS_OK && batch->numOfMsg) {
+        status = NetlinkBatchSend(batch);
+        if (status == STATUS_OK)
+            status = NetlinkBatchCollectAck(batch);
+    }
+
+    // The messages are dropped on socket error, the caller has to redo them on a new socket
+    batch->len = 0;
+    batch->numOfMsg = 0;
+
+    return status;
+}
+
+struct nlmsghdr *NetlinkBatchMsgBuf(NetlinkBatch *batch) {
+    UTLT_Assert(batch, return NULL, "NetlinkBatch is NULL");
+    UTLT_Assert(!batch->sockError, return NULL, "Netlink socket error: %s", strerror(batch->sockError));
+
+    if (SIZE_OF_NETLINK_BATCH - batch->len < MAX_SIZE_OF_NETLINK_MSG) {
+        UTLT_Assert(NetlinkBatchTalk(batch) == STATUS_OK, return NULL,
+            "Netlink batch flush fail: %s", strerror(batch->sockError));
+    }
+
+    return (struct nlmsghdr *) (batch->buf + batch->len);
+}
+
+Status NetlinkBatchMsgPut(NetlinkBatch *batch, struct nlmsghdr *nlh) {
+    UTLT_Assert(batch && nlh, return STATUS_ERROR, "NetlinkBatch or message is NULL");
+    UTLT_Assert((char *) nlh == batch->buf + batch->len, return STATUS_ERROR,
+        "The message is not built at NetlinkBatchMsgBuf");
+    UTLT_Assert(nlh->nlmsg_len >= NLMSG_HDRLEN && nlh->nlmsg_len <= MAX_SIZE_OF_NETLINK_MSG,
+        return STATUS_ERROR, "Netlink message length %u is invalid", nlh->nlmsg_len);
+
+    nlh->nlmsg_seq = batch->seq++;
+    nlh->nlmsg_flags |= NLM_F_ACK;
+
+    batch->len += NLMSG_ALIGN(nlh->nlmsg_len);
+    batch->numOfMsg++;
+
+    return STATUS_OK;
+}
+
+Status NetlinkBatchFlush(NetlinkBatch *batch) {
+    UTLT_Assert(batch, return STATUS_ERROR, "NetlinkBatch is NULL");
+
+    Status status = NetlinkBatchTalk(batch);
+
+    batch->numOfFail = batch->pendingFail;
+    batch->error = batch->pendingError;
+    batch->pendingFail = 0;
+    batch->pendingError = 0;
+
+    return (status == STATUS_OK && !batch->numOfFail ? STATUS_OK : STATUS_ERROR);
+}
@@ -0,0 +1,213 @@
+#include "utlt_rcu.h"
+
+#include <stdlib.h>
+#include <sched.h>
+
+typedef struct {
+    uint64_t epoch;     // Epoch seen at RcuReadLock(), 0 if not in a read-side section
+    int inUse;
+    int nest;           // Only touched by the owner thread
+} __attribute__((aligned(64))) RcuReader;
+
+// Callbacks deferred by one thread, in the order of their grace periods
+#define SIZE_OF_RCU_DEFER_QUEUE 8192
+
+typedef struct {
+    RcuCallback func;
+    void *arg;
+    uint64_t target;    // Epoch its grace period waits for, set by RcuDeferPoll()
+} RcuDeferEntry;
+
+typedef struct {
+    RcuDeferEntry *entry;
+    uint64_t head;      // Next to call
+    uint64_t sealed;    // Entries before it have their grace period started
+    uint64_t tail;      // Next to defer
+} RcuDeferQueue;
+
+static RcuReader rcuReaders[MAX_NUM_OF_RCU_READER];
+static uint64_t rcuEpoch = 1;
+static uint64_t rcuGracePeriod = 0;
+
+static __thread RcuReader *rcuSelf = NULL;
+static __thread RcuDeferQueue rcuDeferQueue;
+
+static RcuReader *RcuReaderRegister() {
+    int logged = 0;
+
+    for (;;) {
+        for (int i = 0; i < MAX_NUM_OF_RCU_READER; i++) {
+            int expected = 0;
+            if (__atomic_compare_exchange_n(&rcuReaders[i].inUse, &expected, 1, 0,
+                                            __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+                rcuReaders[i].nest = 0;
+                __atomic_store_n(&rcuReaders[i].epoch, 0, __ATOMIC_RELAXED);
+                return &rcuReaders[i];
+            }
+        }
+
+        if (!logged) {
+            UTLT_Error("RCU reader slots are exhausted, waiting for RcuThreadOffline");
+            logged = 1;
+        }
+        sched_yield();
+    }
+}
+
+void RcuReadLock() {
+    RcuReader *reader = rcuSelf;
+    if (!reader)
+        reader = rcuSelf = RcuReaderRegister();
+
+    if (reader->nest++ == 0) {
+        // Writers advance the epoch without a lock, acquire makes an epoch newer than
+        // a writer's target also see what that writer unlinked before advancing it
+        __atomic_store_n(&reader->epoch, __atomic_load_n(&rcuEpoch, __ATOMIC_ACQUIRE), __ATOMIC_RELAXED);
+        // Pair with the fence in RcuEpochAdvance: either the writer sees this epoch,
+        // or this reader sees the unlinked pointer
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    }
+}
+
+void RcuReadUnlock() {
+    RcuReader *reader = rcuSelf;
+    UTLT_Assert(reader && reader->nest > 0, return, "RcuReadUnlock without RcuReadLock");
+
+    if (--reader->nest == 0)
+        __atomic_store_n(&reader->epoch, 0, __ATOMIC_RELEASE);
+}
+
+// Start a grace period for everything unlinked before it, which ends when no reader is older than the return
+static uint64_t RcuEpochAdvance() {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    return __atomic_add_fetch(&rcuEpoch, 1, __ATOMIC_SEQ_CST);
+}
+
+// Epoch of the oldest reader in its read-side critical section, or UINT64_MAX if none
+static uint64_t RcuOldestReader() {
+    uint64_t oldest = UINT64_MAX;
+
+    for (int i = 0; i < MAX_NUM_OF_RCU_READER; i++) {
+        if (!__atomic_load_n(&rcuReaders[i].inUse, __ATOMIC_ACQUIRE))
+            continue;
+
+        uint64_t epoch = __atomic_load_n(&rcuReaders[i].epoch, __ATOMIC_ACQUIRE);
+        if (epoch && epoch < oldest)
+            oldest = epoch;
+    }
+
+    return oldest;
+}
+
+static void RcuWait(uint64_t target) {
+    for (int i = 0; i < MAX_NUM_OF_RCU_READER; i++) {
+        if (!__atomic_load_n(&rcuReaders[i].inUse, __ATOMIC_ACQUIRE))
+            continue;
+
+        uint64_t epoch;
+        while ((epoch = __atomic_load_n(&rcuReaders[i].epoch, __ATOMIC_ACQUIRE)) && epoch < target)
+            sched_yield();
+    }
+}
+
+void RcuSynchronize() {
+    UTLT_Assert(!rcuSelf || !rcuSelf->nest, return,
+        "RcuSynchronize inside a read-side critical section will deadlock");
+
+    RcuWait(RcuEpochAdvance());
+    __atomic_add_fetch(&rcuGracePeriod, 1, __ATOMIC_RELAXED);
+}
+
+// Call the deferred callbacks whose grace period has ended before @oldest
+static void RcuDeferCall(RcuDeferQueue *queue, uint64_t oldest) {
+    uint64_t target = 0;
+
+    while (queue->head != queue->sealed) {
+        RcuDeferEntry entry = queue->entry[queue->head % SIZE_OF_RCU_DEFER_QUEUE];
+        if (entry.target > oldest)
+            break;
+
+        if (entry.target != target) {
+            __atomic_add_fetch(&rcuGracePeriod, 1, __ATOMIC_RELAXED);
+            target = entry.target;
+        }
+
+        // The callback may defer again, so the entry is taken out first
+        queue->head++;
+        entry.func(entry.arg);
+    }
+}
+
+static uint64_t RcuDeferSeal(RcuDeferQueue *queue) {
+    if (queue->sealed == queue->tail)
+        return queue->entry[(queue->tail - 1) % SIZE_OF_RCU_DEFER_QUEUE].target;
+
+    uint64_t target = RcuEpochAdvance();
+    for (; queue->sealed != queue->tail; queue->sealed++)
+        queue->entry[queue->sealed % SIZE_OF_RCU_DEFER_QUEUE].target = target;
+
+    return target;
+}
+
+void RcuDefer(RcuCallback func, void *arg) {
+    RcuDeferQueue *queue = &rcuDeferQueue;
+    UTLT_Assert(func, return, "RcuDefer without callback");
+
+    if (!queue->entry) {
+        queue->entry = malloc(sizeof(RcuDeferEntry) * SIZE_OF_RCU_DEFER_QUEUE);
+        UTLT_Assert(queue->entry, RcuSynchronize(); func(arg); return,
+            "RCU defer queue alloc failed, wait for the grace period here");
+    }
+
+    if (queue->tail - queue->head == SIZE_OF_RCU_DEFER_QUEUE)
+        RcuDeferFlush();
+    UTLT_Assert(queue->tail - queue->head < SIZE_OF_RCU_DEFER_QUEUE, return,
+        "RCU defer queue is full in a read-side critical section, %p is leaked", arg);
+
+    RcuDeferEntry *entry = &queue->entry[queue->tail++ % SIZE_OF_RCU_DEFER_QUEUE];
+    entry->func = func;
+    entry->arg = arg;
+    entry->target = 0;
+}
+
+int RcuDeferPoll() {
+    RcuDeferQueue *queue = &rcuDeferQueue;
+    if (queue->head == queue->tail)
+        return 0;
+
+    RcuDeferSeal(queue);
+    RcuDeferCall(queue, RcuOldestReader());
+
+    return queue->tail - queue->head;
+}
+
+void RcuDeferFlush() {
+    RcuDeferQueue *queue = &rcuDeferQueue;
+    UTLT_Assert(!rcuSelf || !rcuSelf->nest, return,
+        "RcuDeferFlush inside a read-side critical section will deadlock");
+
+    while (queue->head != queue->tail) {
+        uint64_t target = RcuDeferSeal(queue);
+        RcuWait(target);
+        RcuDeferCall(queue, target);
+    }
+}
+
+void RcuThreadOffline() {
+    RcuReader *reader = rcuSelf;
+    UTLT_Assert(!reader || !reader->nest, return, "RcuThreadOffline inside a read-side critical section");
+
+    RcuDeferFlush();
+    free(rcuDeferQueue.entry);
+    rcuDeferQueue.entry = NULL;
+
+    if (!reader)
+        return;
+
+    rcuSelf = NULL;
+    __atomic_store_n(&reader->inUse, 0, __ATOMIC_RELEASE);
+}
+
+uint64_t RcuGracePeriodCount() {
+    return __atomic_load_n(&rcuGracePeriod, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,115 @@
+#include "utlt_slottable.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_NUM_OF_SLOT_INDEX_ENTRY (1ULL << 31)
+
+Status SlotTableInit(SlotTable *table, uint32_t capacity) {
+    UTLT_Assert(table && capacity, return STATUS_ERROR, "Slot table or its capacity is 0");
+
+    // Pages are only taken when slots are used, as pools
+    table->slot = calloc(capacity, sizeof(SlotTableEntry));
+    UTLT_Assert(table->slot, return STATUS_ERROR, "Slot table of %u slots alloc failed", capacity);
+    table->capacity = capacity;
+
+    return STATUS_OK;
+}
+
+Status SlotTableFinal(SlotTable *table) {
+    UTLT_Assert(table && table->slot, return STATUS_ERROR, "Slot table is not initialized");
+
+    free(table->slot);
+    memset(table, 0, sizeof(SlotTable));
+
+    return STATUS_OK;
+}
+
+uint64_t SlotTableSet(SlotTable *table, uint32_t index, uint16_t tag, void *obj) {
+    UTLT_Assert(index < table->capacity, return 0, "Slot %u out of range", index);
+    SlotTableEntry *slot = &table->slot[index];
+    UTLT_Assert(!slot->obj, return 0, "Slot %u is taken", index);
+
+    __atomic_store_n(&slot->obj, obj, __ATOMIC_RELEASE);
+
+    return SlotHandleBuild(tag, slot->generation, index);
+}
+
+void *SlotTableClear(SlotTable *table, uint32_t index) {
+    UTLT_Assert(index < table->capacity, return NULL, "Slot %u out of range", index);
+    SlotTableEntry *slot = &table->slot[index];
+    void *obj = slot->obj;
+
+    // Stale handle must not find it, nor the next object in this slot
+    __atomic_store_n(&slot->obj, NULL, __ATOMIC_RELEASE);
+    if (obj)
+        __atomic_store_n(&slot->generation, slot->generation + 1, __ATOMIC_RELAXED);
+
+    return obj;
+}
+
+void *SlotTableGet(SlotTable *table, uint64_t handle) {
+    uint32_t index = SlotHandleIndex(handle);
+    UTLT_Assert(index < table->capacity, return NULL, "Handle 0x%lx out of range", handle);
+
+    // Stale handle is rejected by generation in the slot without touching the object
+    SlotTableEntry *slot = &table->slot[index];
+    void *obj = __atomic_load_n(&slot->obj, __ATOMIC_ACQUIRE);
+    if (!obj || (uint16_t) __atomic_load_n(&slot->generation, __ATOMIC_RELAXED)
+                != SlotHandleGeneration(handle))
+        return NULL;
+
+    return obj;
+}
+
+Status SlotIndexInit(SlotIndex *index, uint32_t capacity) {
+    UTLT_Assert(index && capacity, return STATUS_ERROR, "Slot index or its capacity is 0");
+
+    uint64_t numOfEntry = 2;
+    while (numOfEntry < (uint64_t) capacity * 2)
+        numOfEntry <<= 1;
+    UTLT_Assert(numOfEntry <= MAX_NUM_OF_SLOT_INDEX_ENTRY, return STATUS_ERROR,
+        "Slot index of %u entries is too large", capacity);
+
+    index->entry = calloc(numOfEntry, sizeof(SlotIndexEntry));
+    UTLT_Assert(index->entry, return STATUS_ERROR, "Slot index of %lu entries alloc failed", numOfEntry);
+    index->mask = numOfEntry - 1;
+
+    return STATUS_OK;
+}
+
+Status SlotIndexFinal(SlotIndex *index) {
+    UTLT_Assert(index && index->entry, return STATUS_ERROR, "Slot index is not initialized");
+
+    free(index->entry);
+    memset(index, 0, sizeof(SlotIndex));
+
+    return STATUS_OK;
+}
+
+SlotIndexEntry *SlotIndexProbe(SlotIndex *index, uint32_t hash,
+                               SlotIndexEqual equal, const void *key) {
+    SlotIndexEntry *entry;
+
+    // There are twice as many entries as in use, so an empty one ends the probe
+    for (uint32_t i = hash & index->mask; ; i = (i + 1) & index->mask) {
+        entry = &index->entry[i];
+        if (!entry->slot || (entry->hash == hash && equal(entry->slot - 1, key)))
+            return entry;
+    }
+}
+
+void SlotIndexRemove(SlotIndex *index, SlotIndexEntry *entry) {
+    SlotIndexEntry *e = index->entry;
+    uint32_t mask = index->mask, hole = entry - e, home;
+
+    // Shift back the entries after it which can be found earlier, so no tombstone is left
+    for (uint32_t i = (hole + 1) & mask; e[i].slot; i = (i + 1) & mask) {
+        home = e[i].hash & mask;
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            e[hole] = e[i];
+            hole = i;
+        }
+    }
+    e[hole].slot = 0;
+}
@@ -16,8 +16,8 @@
 #define MAX_NUM_OF_SOCK 1024
 #define MAX_NUM_OF_SOCK_NODE 512
 
-PoolDeclare(sockPool, Sock, MAX_NUM_OF_SOCK);
-PoolDeclare(sockNodePool, SockNode, MAX_NUM_OF_SOCK_NODE);
+PoolDeclare(sockPool, Sock);
+PoolDeclare(sockNodePool, SockNode);
 
 Sock *SocketAlloc();
 
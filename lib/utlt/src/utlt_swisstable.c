@@ -0,0 +1,334 @@
+#include "utlt_swisstable.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <endian.h>
+
+#include "utlt_rcu.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Control bytes of full slots are the low 7 bits of hash, the others have the high bit
+#define SWISS_CTRL_EMPTY            ((uint8_t) 0x80)
+#define SWISS_CTRL_DELETED          ((uint8_t) 0xFE)
+#define SwissCtrlIsFull(__ctrl)     (!((__ctrl) & 0x80))
+
+#define SwissH1(__hash)             ((uint32_t) ((__hash) >> 7))
+#define SwissH2(__hash)             ((uint8_t) ((__hash) & 0x7F))
+
+// At most 7/8 of slots are full, so a probe always ends at an empty slot soon
+#define SwissMaxLoad(__numOfSlot)   ((__numOfSlot) - (__numOfSlot) / 8)
+#define MAX_NUM_OF_SWISS_SLOT       (1ULL << 31)
+
+#ifdef __SSE2__
+
+#define SWISS_GROUP_WIDTH           16
+#define SWISS_MASK_SHIFT            0       // A slot is a bit of the mask
+typedef uint32_t SwissMask;
+
+static inline SwissMask SwissGroupMatch(const uint8_t *ctrl, uint8_t h2) {
+    __m128i group = _mm_loadu_si128((const __m128i *) ctrl);
+    return (SwissMask) _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char) h2)));
+}
+
+static inline SwissMask SwissGroupMatchEmpty(const uint8_t *ctrl) {
+    return SwissGroupMatch(ctrl, SWISS_CTRL_EMPTY);
+}
+
+// Empty or deleted
+static inline SwissMask SwissGroupMatchFree(const uint8_t *ctrl) {
+    return (SwissMask) _mm_movemask_epi8(_mm_loadu_si128((const __m128i *) ctrl));
+}
+
+#define SwissMaskLeading(__mask)    ((uint32_t) __builtin_clz(__mask) - (32 - SWISS_GROUP_WIDTH))
+
+#else
+
+#define SWISS_GROUP_WIDTH           8
+#define SWISS_MASK_SHIFT            3       // A slot is the high bit of a byte of the mask
+typedef uint64_t SwissMask;
+
+#define SWISS_BYTE_LSB              0x0101010101010101ULL
+#define SWISS_BYTE_MSB              0x8080808080808080ULL
+
+static inline uint64_t SwissGroupLoad(const uint8_t *ctrl) {
+    uint64_t group;
+    memcpy(&group, ctrl, sizeof(group));
+    return le64toh(group);
+}
+
+// It may also match a byte after a real match, which is rejected by key
+static inline SwissMask SwissGroupMatch(const uint8_t *ctrl, uint8_t h2) {
+    uint64_t x = SwissGroupLoad(ctrl) ^ (SWISS_BYTE_LSB * h2);
+    return (x - SWISS_BYTE_LSB) & ~x & SWISS_BYTE_MSB;
+}
+
+// Empty has the high bit without bit 1, which deleted has
+static inline SwissMask SwissGroupMatchEmpty(const uint8_t *ctrl) {
+    uint64_t group = SwissGroupLoad(ctrl);
+    return group & ~(group << 6) & SWISS_BYTE_MSB;
+}
+
+static inline SwissMask SwissGroupMatchFree(const uint8_t *ctrl) {
+    return SwissGroupLoad(ctrl) & SWISS_BYTE_MSB;
+}
+
+#define SwissMaskLeading(__mask)    ((uint32_t) __builtin_clzll(__mask) >> SWISS_MASK_SHIFT)
+
+#endif /* __SSE2__ */
+
+#define SwissMaskFirst(__mask)      ((uint32_t) __builtin_ctzll(__mask) >> SWISS_MASK_SHIFT)
+#define SwissMaskNext(__mask)       ((__mask) & ((__mask) - 1))
+
+/*
+ * Groups are read from any slot, so the control bytes after the last slot
+ * mirror the first group. Slots of deleted objects are NULL.
+ */
+struct _SwissTableData {
+    uint32_t mask;          // Slots - 1
+    uint8_t *ctrl;
+    void **slot;
+};
+
+// Mix all bits of key, rule IDs in the low bits are small and keys differ in few bits
+static inline uint64_t SwissHash(uint64_t key) {
+    key ^= key >> 33;
+    key *= 0xFF51AFD7ED558CCDULL;
+    key ^= key >> 33;
+    key *= 0xC4CEB9FE1A85EC53ULL;
+    key ^= key >> 33;
+    return key;
+}
+
+static SwissTableData *SwissTableDataAlloc(uint32_t numOfSlot) {
+    SwissTableData *data = calloc(1, sizeof(SwissTableData));
+    UTLT_Assert(data, return NULL, "Swiss table alloc failed");
+
+    data->mask = numOfSlot - 1;
+    data->ctrl = malloc(numOfSlot + SWISS_GROUP_WIDTH);
+    // Zero pages of slots are only taken when they are written
+    data->slot = calloc(numOfSlot, sizeof(void *));
+    UTLT_Assert(data->ctrl && data->slot, free(data->ctrl); free(data->slot); free(data); return NULL,
+        "Swiss table of %u slots alloc failed", numOfSlot);
+    memset(data->ctrl, SWISS_CTRL_EMPTY, numOfSlot + SWISS_GROUP_WIDTH);
+
+    return data;
+}
+
+static void SwissTableDataFree(SwissTableData *data) {
+    if (data) {
+        free(data->ctrl);
+        free(data->slot);
+        free(data);
+    }
+}
+
+static void SwissTableDataFreeDeferred(void *data) {
+    SwissTableDataFree(data);
+}
+
+// Readers see the slot written before it by the release store
+static inline void SwissCtrlSet(SwissTableData *data, uint32_t i, uint8_t ctrl) {
+    __atomic_store_n(&data->ctrl[i], ctrl, __ATOMIC_RELEASE);
+    if (i < SWISS_GROUP_WIDTH)
+        __atomic_store_n(&data->ctrl[data->mask + 1 + i], ctrl, __ATOMIC_RELEASE);
+}
+
+// Return the slot of @key, or -1 if it is not there
+static int64_t SwissTableFind(SwissTable *table, SwissTableData *data, uint64_t key, uint64_t hash) {
+    uint32_t pos = SwissH1(hash) & data->mask, step = 0;
+    uint8_t h2 = SwissH2(hash);
+
+    for (;;) {
+        const uint8_t *ctrl = data->ctrl + pos;
+        SwissMask match = SwissGroupMatch(ctrl, h2);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        for (; match; match = SwissMaskNext(match)) {
+            uint32_t i = (pos + SwissMaskFirst(match)) & data->mask;
+            void *obj = RcuDereference(data->slot[i]);
+            if (obj && SwissTableKeyOf(table, obj) == key)
+                return i;
+        }
+        if (SwissGroupMatchEmpty(ctrl))
+            return -1;
+
+        // Triangular probing visits every group once, since slots are a power of 2
+        step += SWISS_GROUP_WIDTH;
+        pos = (pos + step) & data->mask;
+    }
+}
+
+// Return the first empty or deleted slot on the probe sequence of @hash
+static uint32_t SwissTableFindFree(SwissTableData *data, uint64_t hash) {
+    uint32_t pos = SwissH1(hash) & data->mask, step = 0;
+
+    for (;;) {
+        SwissMask free = SwissGroupMatchFree(data->ctrl + pos);
+        if (free)
+            return (pos + SwissMaskFirst(free)) & data->mask;
+
+        step += SWISS_GROUP_WIDTH;
+        pos = (pos + step) & data->mask;
+    }
+}
+
+/*
+ * Copy full slots to a new array of the same size without deleted slots. Lock the table before it.
+ * The old array is returned in @old, free it by RcuDefer() after unlock, readers may still be on it.
+ */
+static Status SwissTableRebuild(SwissTable *table, SwissTableData **old) {
+    SwissTableData *from = table->data;
+    SwissTableData *data = SwissTableDataAlloc(from->mask + 1);
+    UTLT_Assert(data, return STATUS_ERROR, "Swiss table rebuild failed");
+
+    for (uint32_t i = 0; i <= from->mask; i++) {
+        if (!SwissCtrlIsFull(from->ctrl[i]))
+            continue;
+        uint64_t hash = SwissHash(SwissTableKeyOf(table, from->slot[i]));
+        uint32_t j = SwissTableFindFree(data, hash);
+        data->slot[j] = from->slot[i];
+        SwissCtrlSet(data, j, SwissH2(hash));
+    }
+
+    table->growthLeft = SwissMaxLoad(from->mask + 1) - table->size;
+    table->rebuild++;
+    RcuAssignPointer(table->data, data);
+    *old = from;
+
+    return STATUS_OK;
+}
+
+Status SwissTableInit(SwissTable *table, uint32_t capacity, uint32_t keyOffset) {
+    UTLT_Assert(table && capacity, return STATUS_ERROR, "Swiss table or its capacity is 0");
+
+    uint64_t numOfSlot = SWISS_GROUP_WIDTH * 2;
+    while (SwissMaxLoad(numOfSlot) < capacity)
+        numOfSlot <<= 1;
+    UTLT_Assert(numOfSlot <= MAX_NUM_OF_SWISS_SLOT, return STATUS_ERROR,
+        "Swiss table of %u objects is too large", capacity);
+
+    memset(table, 0, sizeof(SwissTable));
+    table->data = SwissTableDataAlloc(numOfSlot);
+    UTLT_Assert(table->data, return STATUS_ERROR, "");
+    table->keyOffset = keyOffset;
+    table->capacity = capacity;
+    table->growthLeft = SwissMaxLoad(numOfSlot);
+    pthread_mutex_init(&table->lock, NULL);
+
+    return STATUS_OK;
+}
+
+Status SwissTableFinal(SwissTable *table) {
+    UTLT_Assert(table && table->data, return STATUS_ERROR, "Swiss table is not initialized");
+
+    SwissTableDataFree(table->data);
+    pthread_mutex_destroy(&table->lock);
+    memset(table, 0, sizeof(SwissTable));
+
+    return STATUS_OK;
+}
+
+void *SwissTableGet(SwissTable *table, uint64_t key) {
+    SwissTableData *data = RcuDereference(table->data);
+    int64_t i = SwissTableFind(table, data, key, SwissHash(key));
+
+    return (i < 0 ? NULL : RcuDereference(data->slot[i]));
+}
+
+Status SwissTableSet(SwissTable *table, void *obj, void **old) {
+    UTLT_Assert(table && obj, return STATUS_ERROR, "Swiss table or object is NULL");
+
+    Status status = STATUS_OK;
+    uint64_t key = SwissTableKeyOf(table, obj), hash = SwissHash(key);
+    SwissTableData *retired = NULL;
+
+    if (old)
+        *old = NULL;
+
+    pthread_mutex_lock(&table->lock);
+
+    SwissTableData *data = table->data;
+    int64_t i = SwissTableFind(table, data, key, hash);
+    if (i >= 0) {
+        if (old)
+            *old = data->slot[i];
+        RcuAssignPointer(data->slot[i], obj);
+        goto UNLOCK;
+    }
+
+    UTLT_Assert(table->size < table->capacity, status = STATUS_ERROR; goto UNLOCK,
+        "Swiss table of %u objects is full", table->capacity);
+
+    uint32_t j = SwissTableFindFree(data, hash);
+    if (data->ctrl[j] == SWISS_CTRL_EMPTY && !table->growthLeft) {
+        // Deleted slots have taken the room
+        UTLT_Assert(SwissTableRebuild(table, &retired) == STATUS_OK, status = STATUS_ERROR; goto UNLOCK, "");
+        data = table->data;
+        j = SwissTableFindFree(data, hash);
+    }
+
+    if (data->ctrl[j] == SWISS_CTRL_EMPTY)
+        table->growthLeft--;
+    RcuAssignPointer(data->slot[j], obj);
+    SwissCtrlSet(data, j, SwissH2(hash));
+    __atomic_store_n(&table->size, table->size + 1, __ATOMIC_RELAXED);
+
+UNLOCK:
+    pthread_mutex_unlock(&table->lock);
+
+    // Other writers do not wait for the grace period of a rebuild
+    if (retired)
+        RcuDefer(SwissTableDataFreeDeferred, retired);
+
+    return status;
+}
+
+void *SwissTableDelete(SwissTable *table, uint64_t key) {
+    UTLT_Assert(table, return NULL, "Swiss table is NULL");
+
+    void *obj = NULL;
+
+    pthread_mutex_lock(&table->lock);
+
+    SwissTableData *data = table->data;
+    int64_t i = SwissTableFind(table, data, key, SwissHash(key));
+    if (i < 0)
+        goto UNLOCK;
+
+    obj = data->slot[i];
+
+    // No probe has passed the slot if no group of full slots covers it, so it can be empty again
+    SwissMask emptyBefore = SwissGroupMatchEmpty(data->ctrl + ((i - SWISS_GROUP_WIDTH) & data->mask));
+    SwissMask emptyAfter = SwissGroupMatchEmpty(data->ctrl + i);
+    if (emptyBefore && emptyAfter &&
+        SwissMaskFirst(emptyAfter) + SwissMaskLeading(emptyBefore) < SWISS_GROUP_WIDTH) {
+        SwissCtrlSet(data, i, SWISS_CTRL_EMPTY);
+        table->growthLeft++;
+    } else {
+        SwissCtrlSet(data, i, SWISS_CTRL_DELETED);
+    }
+    RcuAssignPointer(data->slot[i], NULL);
+    __atomic_store_n(&table->size, table->size - 1, __ATOMIC_RELAXED);
+
+UNLOCK:
+    pthread_mutex_unlock(&table->lock);
+
+    return obj;
+}
+
+void *SwissTableNext(SwissTable *table, uint32_t *pos) {
+    SwissTableData *data = RcuDereference(table->data);
+
+    for (uint64_t i = *pos; i <= data->mask; i++) {
+        void *obj = RcuDereference(data->slot[i]);
+        if (obj) {
+            *pos = i + 1;
+            return obj;
+        }
+    }
+    *pos = data->mask + 1;
+
+    return NULL;
+}
@@ -19,8 +19,9 @@ Status TestInit() {
 }
 
 Status TestTerminate() {
+    TestNode *it, *nextIt = NULL;
 
-    for (TestNode *it = ListFirst(&testSelf.node); it != NULL; it = ListNext(it)) {
+    ListForEachSafe(it, nextIt, &testSelf.node) {
         ListRemove(it);
         free(it);
     }
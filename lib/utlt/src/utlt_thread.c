@@ -8,7 +8,7 @@ struct ThreadInfo {
     sem_t *semaphore;
 };
 
-PoolDeclare(threadPool, Thread, MAX_NUM_OF_THREAD);
+PoolDeclare(threadPool, Thread);
 
 static struct ThreadInfo threadStopCheck;
 
@@ -2,110 +2,303 @@
 
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
 
 #include "utlt_debug.h"
-#include "utlt_pool.h"
 
-static int TimerCmpFunc(ListHead *pnode1, ListHead *pnode2);
+#define TIMER_WHEEL_MASK        (TIMER_WHEEL_SIZE - 1)
+#define TIMER_WHEEL_MAX_TICK    ((uint64_t) 1 << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVEL))
 
 typedef struct _TimerBlk {
     ListHead        node;
     TimerList       *timerList;
-    
+
     int             type;
     int             isRunning;
-    uint32_t        expireTime;
+    uint64_t        expireTime;
     uint32_t        duration;
-    
+
     ExpireFunc      expireFunc;
     uintptr_t       param[6];
 } TimerBlk;
 
-PoolDeclare(timerPool, TimerBlk, MAX_NUM_OF_TIMER);
+typedef struct _TimerChunk {
+    struct _TimerChunk *next;
+    TimerBlk        blk[MAX_NUM_OF_TIMER];
+} TimerChunk;
+
+static struct {
+    TimerChunk      *chunk;
+    TimerBlk        *freeList;  // Linked by node.next
+    uint32_t        cap;
+    uint32_t        size;
+    pthread_mutex_t lock;
+} timerPool;
+
+static uint64_t TimerNowMsec() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Call with timerPool.lock held
+static Status TimerPoolGrow() {
+    TimerChunk *chunk = malloc(sizeof(TimerChunk));
+    UTLT_Assert(chunk, return STATUS_ERROR, "Timer pool grows to %u fail", timerPool.cap + MAX_NUM_OF_TIMER);
+
+    for (int i = MAX_NUM_OF_TIMER - 1; i >= 0; i--) {
+        chunk->blk[i].node.next = (ListHead *) timerPool.freeList;
+        timerPool.freeList = &chunk->blk[i];
+    }
+    chunk->next = timerPool.chunk;
+    timerPool.chunk = chunk;
+    timerPool.cap += MAX_NUM_OF_TIMER;
+    timerPool.size += MAX_NUM_OF_TIMER;
 
-static int TimerCmpFunc(ListHead *pnode1, ListHead *pnode2) {
-    TimerBlk *tm1 = (TimerBlk *)pnode1;
-    TimerBlk *tm2 = (TimerBlk *)pnode2;
+    if (timerPool.cap > MAX_NUM_OF_TIMER)
+        UTLT_Debug("Timer pool grows to %u", timerPool.cap);
 
-    return (tm1->expireTime < tm2->expireTime ? -1 : 1);
+    return STATUS_OK;
+}
+
+static TimerBlk *TimerBlkAlloc() {
+    TimerBlk *tm = NULL;
+
+    pthread_mutex_lock(&timerPool.lock);
+    if (timerPool.freeList || TimerPoolGrow() == STATUS_OK) {
+        tm = timerPool.freeList;
+        timerPool.freeList = (TimerBlk *) tm->node.next;
+        timerPool.size--;
+    }
+    pthread_mutex_unlock(&timerPool.lock);
+
+    return tm;
+}
+
+static void TimerBlkFree(TimerBlk *tm) {
+    pthread_mutex_lock(&timerPool.lock);
+    tm->node.next = (ListHead *) timerPool.freeList;
+    timerPool.freeList = tm;
+    timerPool.size++;
+    pthread_mutex_unlock(&timerPool.lock);
 }
 
 Status TimerPoolInit() {
-    PoolInit(&timerPool, MAX_NUM_OF_TIMER);
+    memset(&timerPool, 0, sizeof(timerPool));
+    pthread_mutex_init(&timerPool.lock, 0);
 
-    return STATUS_OK;
+    pthread_mutex_lock(&timerPool.lock);
+    Status status = TimerPoolGrow();
+    pthread_mutex_unlock(&timerPool.lock);
+
+    return status;
 }
 
 Status TimerFinal() {
-    if (PoolCap(&timerPool) != PoolSize(&timerPool))
+    if (timerPool.cap != timerPool.size)
         UTLT_Error("%d not freed in timerPool[%d]",
-                    PoolCap(&timerPool) - PoolSize(&timerPool),
-                    PoolCap(&timerPool));
-    
-    PoolTerminate(&timerPool);
+                    timerPool.cap - timerPool.size, timerPool.cap);
+
+    while (timerPool.chunk) {
+        TimerChunk *next = timerPool.chunk->next;
+        free(timerPool.chunk);
+        timerPool.chunk = next;
+    }
+    timerPool.freeList = NULL;
+    timerPool.cap = timerPool.size = 0;
+    pthread_mutex_destroy(&timerPool.lock);
 
     return STATUS_OK;
 }
 
 uint32_t TimerGetPoolSize() {
     // The number of available space in this pool
-    return PoolSize(&timerPool);
+    return timerPool.size;
+}
+
+// Start or stop ticking of timerfd, call with tmList->lock held
+static void TimerListArm(TimerList *tmList, int armed) {
+    struct itimerspec its = {0};
+
+    if (tmList->fd < 0 || tmList->armed == armed)
+        return;
+
+    if (armed) {
+        its.it_interval.tv_nsec = TIMER_TICK_MSEC * 1000000;
+        its.it_value = its.it_interval;
+    }
+    UTLT_Assert(timerfd_settime(tmList->fd, 0, &its, NULL) == 0, return,
+        "timerfd_settime fail: %s", strerror(errno));
+
+    tmList->armed = armed;
 }
 
 void TimerListInit(TimerList *tmList) {
     memset(tmList, 0x00, sizeof(TimerList));
-    ListHeadInit(&tmList->active);
-    ListHeadInit(&tmList->idle);
+    for (int level = 0; level < TIMER_WHEEL_LEVEL; level++)
+        for (int i = 0; i < TIMER_WHEEL_SIZE; i++)
+            ListHeadInit(&tmList->wheel[level][i]);
+    tmList->tick = TimerNowMsec();
     pthread_mutex_init(&tmList->lock, 0);
+
+    tmList->fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    UTLT_Assert(tmList->fd >= 0, , "timerfd_create fail: %s", strerror(errno));
+
+    return;
+}
+
+void TimerListTerm(TimerList *tmList) {
+    if (tmList->fd >= 0)
+        close(tmList->fd);
+    tmList->fd = -1;
+    pthread_mutex_destroy(&tmList->lock);
+
     return;
 }
 
-// Check expire time and update active and idle list
+// Put the running timer into the slot of its expire time, call with tmList->lock held
+static void TimerWheelAdd(TimerList *tmList, TimerBlk *tm) {
+    uint64_t expire = tm->expireTime;
+    ListHead *slot;
+    int level = 0;
+
+    if (expire < tmList->tick) {
+        // Overdue, it is expired at the next tick checked
+        expire = tmList->tick;
+    } else if (expire - tmList->tick >= TIMER_WHEEL_MAX_TICK) {
+        // It is cascaded again from the top level when the slot is reached
+        expire = tmList->tick + TIMER_WHEEL_MAX_TICK - 1;
+    }
+
+    while (level < TIMER_WHEEL_LEVEL - 1 &&
+           expire - tmList->tick >= ((uint64_t) 1 << (TIMER_WHEEL_BITS * (level + 1))))
+        level++;
+
+    slot = &tmList->wheel[level][(expire >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK];
+    ListInsert(tm, slot);
+}
+
+// Move the timers of the slot to lower levels and return the slot index
+static int TimerWheelCascade(TimerList *tmList, int level) {
+    int index = (tmList->tick >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK;
+    ListHead *slot = &tmList->wheel[level][index];
+    TimerBlk *tm, *next;
+
+    ListForEachSafe(tm, next, slot) {
+        ListRemove(tm);
+        TimerWheelAdd(tmList, tm);
+    }
+
+    return index;
+}
+
+// Expired timers are called out of tmList->lock in batches of this
+#define TIMER_EXPIRE_BATCH      64
+
+typedef struct {
+    ExpireFunc      expireFunc;
+    uintptr_t       param[6];
+} TimerExpired;
+
+static void TimerExpiredCall(TimerList *tmList, uintptr_t data, TimerExpired *expired, int num) {
+    // expireFunc may wait for a thread which is waiting for the lock, like a full event queue
+    pthread_mutex_unlock(&tmList->lock);
+    for (int i = 0; i < num; i++)
+        expired[i].expireFunc(data, expired[i].param);
+    pthread_mutex_lock(&tmList->lock);
+}
+
+// Check expire time and call expireFunc of each expired timer
 Status TimerExpireCheck(TimerList *tmList, uintptr_t data) {
+    uint64_t expiration;
+    ListHead expired;
+    TimerBlk *tm;
+    TimerExpired batch[TIMER_EXPIRE_BATCH];
+    int numOfBatch = 0;
+
+    // Consume the tick of timerfd, it is not an error if the check is not driven by it
+    if (tmList->fd >= 0)
+        while (read(tmList->fd, &expiration, sizeof(expiration)) < 0 && errno == EINTR);
+
     pthread_mutex_lock(&tmList->lock);
-    uint32_t curTime = TimeMsec(TimeNow());
-    TimerBlk *tm = ListFirst(&(tmList->active));
-
-    while (tm != (TimerBlk *)&tmList->active) {
-        if (tm->expireTime < curTime) {
-            tm->expireFunc(data, tm->param);
-            
-            if (tm->isRunning) {
-                ListRemove(tm);
-
-                if (tm->type == TIMER_TYPE_PERIOD) {
-                    tm->expireTime = curTime + tm->duration;
-                    
-                    ListInsertSorted(tm, &(tmList->active), TimerCmpFunc);
-                } else {
-                    ListInsertSorted(tm, &(tmList->idle), TimerCmpFunc);
-                    
-                    tm->isRunning = 0;
-                }
+    uint64_t curTime = TimerNowMsec();
+
+    if (!tmList->numOfRunning) {
+        tmList->tick = curTime + 1;
+        TimerListArm(tmList, 0);
+    }
+
+    while (tmList->tick <= curTime) {
+        int index = tmList->tick & TIMER_WHEEL_MASK;
+        for (int level = 1; !index && level < TIMER_WHEEL_LEVEL; level++)
+            index = TimerWheelCascade(tmList, level);
+
+        ListHeadInit(&expired);
+        ListHead *slot = &tmList->wheel[0][tmList->tick & TIMER_WHEEL_MASK];
+        if (ListFirst(slot) != slot) {
+            // Take the whole slot, so timers restarted by expireFunc stay in the wheel
+            expired.next = slot->next;
+            expired.prev = slot->prev;
+            expired.next->prev = &expired;
+            expired.prev->next = &expired;
+            ListHeadInit(slot);
+        }
+        tmList->tick++;
+
+        while ((tm = ListFirst(&expired)) != (TimerBlk *) &expired) {
+            ListRemove(tm);
+
+            if (tm->type == TIMER_TYPE_PERIOD) {
+                tm->expireTime = curTime + (tm->duration ? tm->duration : 1);
+                TimerWheelAdd(tmList, tm);
+            } else {
+                tm->isRunning = 0;
+                tmList->numOfRunning--;
+            }
+
+            // Copied, since the timer may be deleted once the lock is released
+            batch[numOfBatch].expireFunc = tm->expireFunc;
+            memcpy(batch[numOfBatch].param, tm->param, sizeof(tm->param));
+            if (++numOfBatch == TIMER_EXPIRE_BATCH) {
+                // Others stay in the local list, which no other thread can see
+                TimerExpiredCall(tmList, data, batch, numOfBatch);
+                numOfBatch = 0;
             }
-            tm = ListFirst(&(tmList->active));
-        } else {
-            break;
         }
     }
     pthread_mutex_unlock(&tmList->lock);
+
+    for (int i = 0; i < numOfBatch; i++)
+        batch[i].expireFunc(data, batch[i].param);
+
     return STATUS_OK;
 }
 
 Status TimerStart(TimerBlkID id) {
-
     TimerBlk *tm = (TimerBlk *)id;
-    pthread_mutex_lock(&tm->timerList->lock);
-    uint32_t curTime = TimeMsec(TimeNow());
+    TimerList *tmList = tm->timerList;
 
-     ListRemove(tm);
+    pthread_mutex_lock(&tmList->lock);
+    uint64_t curTime = TimerNowMsec();
 
-    tm->expireTime = curTime + tm->duration;
+    if (tm->isRunning) {
+        ListRemove(tm);
+    } else {
+        if (!tmList->numOfRunning++) {
+            // Nothing was running, so the ticks in between have nothing to check
+            tmList->tick = curTime;
+            TimerListArm(tmList, 1);
+        }
+        tm->isRunning = 1;
+    }
 
-    ListInsertSorted(tm, &(tm->timerList->active), TimerCmpFunc);
-    
-    tm->isRunning = 1;
-    pthread_mutex_unlock(&tm->timerList->lock);
+    tm->expireTime = curTime + tm->duration;
+    TimerWheelAdd(tmList, tm);
+    pthread_mutex_unlock(&tmList->lock);
 
     return STATUS_OK;
 }
@@ -116,45 +309,45 @@ Status TimerStop(TimerBlkID id) {
     pthread_mutex_lock(&tm->timerList->lock);
     if (tm->isRunning) {
         ListRemove(tm);
-
-        ListInsertSorted(tm, &(tm->timerList->idle), TimerCmpFunc);
-
         tm->isRunning = 0;
+        tm->timerList->numOfRunning--;
     }
     pthread_mutex_unlock(&tm->timerList->lock);
 
     return STATUS_OK;
 }
 
+int TimerIsRunning(TimerBlkID id) {
+    TimerBlk *tm = (TimerBlk *)id;
+
+    pthread_mutex_lock(&tm->timerList->lock);
+    int isRunning = tm->isRunning;
+    pthread_mutex_unlock(&tm->timerList->lock);
+
+    return isRunning;
+}
+
 TimerBlkID TimerCreate(TimerList *tmList, int type, uint32_t duration, ExpireFunc expireFunc) {
-    TimerBlk *tm = NULL;
-    
-    PoolAlloc(&timerPool, tm);
+    TimerBlk *tm = TimerBlkAlloc();
     UTLT_Assert(tm, return (TimerBlkID)NULL, "The pool of timer create is empty");
-    
+
     memset((char*)tm, 0x00, sizeof(TimerBlk));
+    ListHeadInit(&tm->node);
 
-    pthread_mutex_lock(&tmList->lock);
     tm->timerList = tmList;
-
-    ListInsertSorted(tm, &(tm->timerList->idle), TimerCmpFunc);
-
     tm->type = type;
     tm->duration = duration;
     tm->expireFunc = expireFunc;
-    pthread_mutex_unlock(&tmList->lock);
 
     return (TimerBlkID)tm;
 }
 
 void TimerDelete(TimerBlkID id) {
     TimerBlk *tm = (TimerBlk *)id;
-    pthread_mutex_lock(&tm->timerList->lock);
 
-    ListRemove(tm);
-    pthread_mutex_unlock(&tm->timerList->lock);
-    PoolFree(&timerPool, tm);
-    
+    TimerStop(id);
+    TimerBlkFree(tm);
+
     return;
 }
 
@@ -163,6 +356,6 @@ Status TimerSet(int paramID, TimerBlkID id, uintptr_t param) {
 
     UTLT_Assert(paramID >= 0 && paramID < 6, return STATUS_ERROR, "Wrong paramID for setting timer parameter");
     tm->param[paramID] = param;
-    
+
     return STATUS_OK;
 }
@@ -1,6 +1,26 @@
+#define _GNU_SOURCE    // recvmmsg and sendmmsg
+
 #include "utlt_network.h"
 
+#include <stdlib.h>
+#include <errno.h>
+#include <linux/filter.h>
+
 #include "utlt_debug.h"
+#include "utlt_netheader.h"
+
+#define UDP_STEER_HASH_MULTIPLIER   0x9E3779B1  // Spread TEIDs allocated in sequence
+
+struct _UdpBatch {
+    int size;
+    int num;
+    int bufSize;
+    uint8_t *buf;
+
+    struct mmsghdr msg[MAX_NUM_OF_UDP_BATCH];
+    struct iovec iov[MAX_NUM_OF_UDP_BATCH][2];     // Header and payload to send
+    SockAddr addr[MAX_NUM_OF_UDP_BATCH];
+};
 
 Sock *UdpSockCreate(int domain) {
     Sock *sock = SockCreate(domain, SOCK_DGRAM, 0);
@@ -72,3 +92,196 @@ Sock *UdpClientCreate(int domain, const char *addr, int port) {
 
     return sock;
 }
+
+Sock *UdpReusePortServerCreate(int domain, const char *addr, int port) {
+    Sock *sock = UdpSockCreate(domain);
+    UTLT_Assert(sock, return NULL, "UDP SockCreate fail");
+
+    UTLT_Assert(UdpSockSetAddr(&sock->localAddr, domain, addr, port) == STATUS_OK,
+        goto FREESOCK, "");
+
+    int opt = 1;
+    UTLT_Assert(SockSetOpt(sock, SOL_SOCKET, SO_REUSEADDR, &opt) == 0 &&
+                SockSetOpt(sock, SOL_SOCKET, SO_REUSEPORT, &opt) == 0,
+        goto FREESOCK, "Set SO_REUSEPORT fail : %s", strerror(errno));
+
+    UTLT_Assert(SockBind(sock, &sock->localAddr) == STATUS_OK, goto FREESOCK, "UDP SockBind fail");
+
+    return sock;
+
+FREESOCK:
+    SockFree(sock);
+
+    return NULL;
+}
+
+Status UdpReusePortSteerByTeid(Sock *sock, int num, int tpduIndex) {
+    UTLT_Assert(sock, return STATUS_ERROR, "Socket is NULL");
+    UTLT_Assert(num > 0 && tpduIndex < num, return STATUS_ERROR,
+        "T-PDU socket %d is not in the group of %d", tpduIndex, num);
+
+    // Kernel picks the only one
+    if (num == 1)
+        return STATUS_OK;
+
+    /*
+     * The program sees UDP payload, and it returns the index of socket.
+     * TEIDs are hashed over @range sockets and the index of T-PDU socket is skipped.
+     */
+    uint32_t range = (tpduIndex < 0 ? num : num - 1);
+    uint32_t skip = (tpduIndex < 0 ? num : tpduIndex);
+    struct sock_filter code[] = {
+        BPF_STMT(BPF_LD | BPF_W | BPF_LEN, 0),
+        BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, GTPV1_HEADER_LEN, 1, 0),
+        BPF_STMT(BPF_RET | BPF_K, 0),
+        BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 1),                      // Message type
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, GTPV1_T_PDU, 0, 2),
+        // T-PDU
+        (tpduIndex < 0 ? (struct sock_filter) BPF_STMT(BPF_LD | BPF_W | BPF_ABS, 4)
+                       : (struct sock_filter) BPF_STMT(BPF_RET | BPF_K, tpduIndex)),
+        BPF_STMT(BPF_JMP | BPF_JA, 4),
+        // Others
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, 4),                      // TEID
+        BPF_STMT(BPF_MISC | BPF_TAX, 0),
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, SKF_NET_OFF + 12),       // Source address
+        BPF_STMT(BPF_ALU | BPF_XOR | BPF_X, 0),
+        // Hash
+        BPF_STMT(BPF_ALU | BPF_MUL | BPF_K, UDP_STEER_HASH_MULTIPLIER),
+        BPF_STMT(BPF_ALU | BPF_RSH | BPF_K, 16),
+        BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, range),
+        BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, skip, 0, 1),
+        BPF_STMT(BPF_ALU | BPF_ADD | BPF_K, 1),
+        BPF_STMT(BPF_RET | BPF_A, 0),
+    };
+    struct sock_fprog prog = {
+        .len = sizeof(code) / sizeof(code[0]),
+        .filter = code,
+    };
+
+    UTLT_Assert(setsockopt(sock->fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)) == 0,
+        return STATUS_ERROR, "Attach SO_REUSEPORT filter fail : %s", strerror(errno));
+
+    return STATUS_OK;
+}
+
+UdpBatch *UdpBatchAlloc(int size, int bufSize) {
+    UTLT_Assert(size > 0 && size <= MAX_NUM_OF_UDP_BATCH && bufSize >= 0, return NULL,
+        "UDP batch of %d datagrams is invalid", size);
+
+    UdpBatch *batch = calloc(1, sizeof(UdpBatch));
+    UTLT_Assert(batch, return NULL, "UDP batch alloc fail");
+
+    batch->size = size;
+    batch->bufSize = bufSize;
+    if (bufSize) {
+        batch->buf = malloc((size_t) size * bufSize);
+        UTLT_Assert(batch->buf, free(batch); return NULL, "UDP batch buffer alloc fail");
+    }
+
+    for (int i = 0; i < size; i++) {
+        batch->msg[i].msg_hdr.msg_name = &batch->addr[i].ss;
+        batch->msg[i].msg_hdr.msg_iov = batch->iov[i];
+    }
+
+    return batch;
+}
+
+Status UdpBatchFree(UdpBatch *batch) {
+    UTLT_Assert(batch, return STATUS_ERROR, "UDP batch is NULL");
+
+    free(batch->buf);
+    free(batch);
+
+    return STATUS_OK;
+}
+
+int UdpBatchCount(UdpBatch *batch) {
+    return batch->num;
+}
+
+int UdpBatchFull(UdpBatch *batch) {
+    return batch->num == batch->size;
+}
+
+int UdpBatchRecv(Sock *sock, UdpBatch *batch) {
+    UTLT_Assert(sock && batch && batch->buf, return -1, "UDP batch is not for receiving");
+
+    for (int i = 0; i < batch->size; i++) {
+        batch->iov[i][0].iov_base = batch->buf + (size_t) i * batch->bufSize;
+        batch->iov[i][0].iov_len = batch->bufSize;
+        batch->msg[i].msg_hdr.msg_namelen = sizeof(batch->addr[i].ss);
+        batch->msg[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    int num;
+    do {
+        num = recvmmsg(sock->fd, batch->msg, batch->size, MSG_DONTWAIT | sock->rflag, NULL);
+    } while (num < 0 && errno == EINTR);
+
+    if (num < 0) {
+        batch->num = 0;
+        UTLT_Assert(errno == EAGAIN || errno == EWOULDBLOCK, return -1,
+            "recvmmsg fail : %s", strerror(errno));
+        return 0;
+    }
+
+    batch->num = num;
+    return num;
+}
+
+uint8_t *UdpBatchGet(UdpBatch *batch, int idx, int *len, SockAddr *from) {
+    UTLT_Assert(idx >= 0 && idx < batch->num, return NULL,
+        "Datagram %d is not in UDP batch of %d", idx, batch->num);
+
+    *len = batch->msg[idx].msg_len;
+    if (from)
+        memcpy(from, &batch->addr[idx], sizeof(SockAddr));
+
+    return batch->iov[idx][0].iov_base;
+}
+
+Status UdpBatchAdd(UdpBatch *batch, const void *hdr, int hdrLen,
+                   const void *payload, int payloadLen, const SockAddr *to) {
+    UTLT_Assert(batch && to, return STATUS_ERROR, "UDP batch or address is NULL");
+    UTLT_Assert(batch->num < batch->size, return STATUS_ERROR, "UDP batch is full");
+
+    int idx = batch->num, iovlen = 0;
+    struct iovec *iov = batch->iov[idx];
+
+    if (hdr && hdrLen > 0) {
+        iov[iovlen].iov_base = (void *) hdr;
+        iov[iovlen++].iov_len = hdrLen;
+    }
+    if (payload && payloadLen > 0) {
+        iov[iovlen].iov_base = (void *) payload;
+        iov[iovlen++].iov_len = payloadLen;
+    }
+
+    memcpy(&batch->addr[idx], to, sizeof(SockAddr));
+    batch->msg[idx].msg_hdr.msg_namelen = SockAddrLen(to);
+    batch->msg[idx].msg_hdr.msg_iovlen = iovlen;
+    batch->num++;
+
+    return STATUS_OK;
+}
+
+int UdpBatchSend(Sock *sock, UdpBatch *batch) {
+    UTLT_Assert(sock && batch, return 0, "Socket or UDP batch is NULL");
+
+    int sent = 0, done = 0, num;
+    while (done < batch->num) {
+        num = sendmmsg(sock->fd, &batch->msg[done], batch->num - done, sock->wflag);
+        if (num < 0) {
+            if (errno == EINTR)
+                continue;
+            UTLT_Debug("sendmmsg fail : %s", strerror(errno));
+            num = 1;
+        } else {
+            sent += num;
+        }
+        done += num;
+    }
+
+    batch->num = 0;
+    return sent;
+}
@@ -43,20 +43,17 @@ void UpfDispatcher(const Event *event) {
     }
     case UPF_EVENT_N4_MESSAGE: {
         Status status;
-        Bufblk *bufBlk = NULL;
         Bufblk *recvBufBlk = (Bufblk *)event->arg0;
         PfcpNode *upf = (PfcpNode *)event->arg1;
-        PfcpMessage *pfcpMessage = NULL;
+        PfcpMessage message;
+        PfcpMessage *pfcpMessage = &message;
         PfcpXact *xact = NULL;
         UpfSession *session = NULL;
 
         UTLT_Assert(recvBufBlk, return, "recv buffer no data");
-        bufBlk = BufblkAlloc(1, sizeof(PfcpMessage));
-        UTLT_Assert(bufBlk, goto freeRecvBuf, "create buffer error");
-        pfcpMessage = bufBlk->buf;
-        UTLT_Assert(pfcpMessage, goto freeBuf, "pfcpMessage assigned error");
 
-        status = PfcpParseMessage(pfcpMessage, recvBufBlk);
+        // IE values point into recvBufBlk, which is freed after the message is handled
+        status = PfcpParseMessageInPlace(pfcpMessage, recvBufBlk);
         UTLT_Assert(status == STATUS_OK, goto freeBuf, "PfcpParseMessage error");
 
         if (pfcpMessage->header.seidP) {
@@ -139,11 +136,16 @@ void UpfDispatcher(const Event *event) {
         }
         freeBuf:
         PfcpStructFree(pfcpMessage);
-        BufblkFree(bufBlk);
-        freeRecvBuf:
         BufblkFree(recvBufBlk);
         break;
     }
+    case UPF_EVENT_SESSION_RELEASE: {
+        // Association is released, sessions of the node owned by this worker are cleared
+        PfcpNode *node = (PfcpNode *)event->arg0;
+        UTLT_Assert(UpfSessionRemoveByNode(node) == STATUS_OK, ,
+                    "Session release error");
+        break;
+    }
     case UPF_EVENT_N4_T3_RESPONSE:
     case UPF_EVENT_N4_T3_HOLDING:
         {
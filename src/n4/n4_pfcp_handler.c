@@ -11,7 +11,9 @@
 #include "pfcp_message.h"
 #include "pfcp_xact.h"
 #include "pfcp_convert.h"
+#include "n4_pfcp_handler.h"
 #include "n4_pfcp_build.h"
+#include "n4_worker.h"
 #include "up/up_path.h"
 
 #include "updk/rule.h"
@@ -234,10 +236,13 @@ Status UpfN4HandleCreatePdr(UpfSession *session, CreatePDR *createPdr) {
     memset(&upfPdr, 0, sizeof(UpfPDR));
 
     uint16_t pdrID = ntohs(*((uint16_t*) createPdr->pDRID.value));
-    UTLT_Assert(UpfPDRFindByID(pdrID, &upfPdr), return STATUS_ERROR, "PDR ID[%u] does exist in UPF Context", pdrID);
+    UTLT_Assert(UpfPDRFindByID(session->upfSeid, pdrID, NULL), return STATUS_ERROR, "PDR ID[%u] does exist in UPF Context", pdrID);
 
     UTLT_Assert(_ConvertCreatePDRTlvToRule(&upfPdr, createPdr) == STATUS_OK,
         return STATUS_ERROR, "Convert PDR TLV To Rule is failed");
+    // Rule IDs are only unique in the session
+    upfPdr.flags.seid = 1;
+    upfPdr.seid = session->upfSeid;
 
     // Using UPDK API
     UTLT_Assert(Gtpv1TunnelCreatePDR(&upfPdr) == 0, return STATUS_ERROR,
@@ -355,10 +360,13 @@ Status UpfN4HandleCreateFar(UpfSession *session, CreateFAR *createFar) {
     memset(&upfFar, 0, sizeof(UpfFAR));
 
     uint32_t farID = ntohl(*((uint32_t*) createFar->fARID.value));
-    UTLT_Assert(UpfFARFindByID(farID, &upfFar), return STATUS_ERROR, "FAR ID[%u] does exist in UPF Context", farID);
+    UTLT_Assert(UpfFARFindByID(session->upfSeid, farID, NULL), return STATUS_ERROR, "FAR ID[%u] does exist in UPF Context", farID);
 
     UTLT_Assert(_ConvertCreateFARTlvToRule(&upfFar, createFar) == STATUS_OK,
         return STATUS_ERROR, "Convert FAR TLV To Rule is failed");
+    // Rule IDs are only unique in the session
+    upfFar.flags.seid = 1;
+    upfFar.seid = session->upfSeid;
 
     // Using UPDK API
     UTLT_Assert(Gtpv1TunnelCreateFAR(&upfFar) == 0, return STATUS_ERROR,
@@ -483,10 +491,13 @@ Status UpfN4HandleCreateQer(UpfSession *session, CreateQER *createQer) {
     memset(&upfQer, 0, sizeof(UpfQER));
 
     uint32_t qerID = ntohl(*((uint32_t *) createQer->qERID.value));
-    UTLT_Assert(UpfQERFindByID(qerID, &upfQer), return STATUS_ERROR, "QER ID[%u] does exist in UPF Context", qerID);
+    UTLT_Assert(UpfQERFindByID(session->upfSeid, qerID, NULL), return STATUS_ERROR, "QER ID[%u] does exist in UPF Context", qerID);
 
     UTLT_Assert(_ConvertCreateQERTlvToRule(&upfQer, createQer) == STATUS_OK,
         return STATUS_ERROR, "Convert Create QER TLV To Rule is failed");
+    // Rule IDs are only unique in the session
+    upfQer.flags.seid = 1;
+    upfQer.seid = session->upfSeid;
 
     // Using UPDK API
     UTLT_Assert(Gtpv1TunnelCreateQER(&upfQer) == 0, return STATUS_ERROR,
@@ -705,7 +716,7 @@ Status UpfN4HandleUpdatePdr(UpfSession *session, UpdatePDR *updatePdr) {
     memset(&upfPdr, 0, sizeof(UpfPDR));
 
     uint16_t pdrID = ntohs(*((uint16_t *)updatePdr->pDRID.value));
-    UTLT_Assert(!UpfPDRFindByID(pdrID, &upfPdr), return STATUS_ERROR, "PDR ID[%u] does NOT exist in UPF Context", pdrID);
+    UTLT_Assert(!UpfPDRFindByID(session->upfSeid, pdrID, &upfPdr), return STATUS_ERROR, "PDR ID[%u] does NOT exist in UPF Context", pdrID);
 
     UTLT_Assert(_ConvertUpdatePDRTlvToRule(&upfPdr, updatePdr) == STATUS_OK,
         return STATUS_ERROR, "Convert PDR TLV To Rule is failed");
@@ -821,14 +832,16 @@ Status UpfN4HandleUpdateFar(UpfSession *session, UpdateFAR *updateFar) {
     memset(&upfFar, 0, sizeof(UpfFAR));
 
     uint32_t farID = ntohl(*((uint32_t *)updateFar->fARID.value));
-    UTLT_Assert(!UpfFARFindByID(farID, &upfFar), return STATUS_ERROR, "FAR ID[%u] does NOT exist in UPF Context", farID);
+    UTLT_Assert(!UpfFARFindByID(session->upfSeid, farID, &upfFar), return STATUS_ERROR, "FAR ID[%u] does NOT exist in UPF Context", farID);
 
     UTLT_Assert(_ConvertUpdateFARTlvToRule(&upfFar, updateFar) == STATUS_OK,
         return STATUS_ERROR, "Convert FAR TLV To Rule is failed");
+    upfFar.flags.seid = 1;
+    upfFar.seid = session->upfSeid;
 
     // Get old apply action to check its changing
     uint8_t oldAction;
-    UTLT_Assert(HowToHandleThisPacket(farID, &oldAction) == STATUS_OK, return STATUS_ERROR, "Can NOT find origin FAR action");
+    UTLT_Assert(HowToHandleThisPacket(session->upfSeid, farID, &oldAction) == STATUS_OK, return STATUS_ERROR, "Can NOT find origin FAR action");
 
     // Using UPDK API
     UTLT_Assert(Gtpv1TunnelUpdateFAR(&upfFar) == 0, return STATUS_ERROR,
@@ -840,13 +853,15 @@ Status UpfN4HandleUpdateFar(UpfSession *session, UpdateFAR *updateFar) {
 
     // Buffered packet handle
     if ((oldAction & PFCP_FAR_APPLY_ACTION_BUFF)) {
-        Sock *sock = &Self()->upSock;
+        // N4 workers run in parallel, so the peer is set on a copy of upSock
+        Sock upSock = Self()->upSock;
+        Sock *sock = &upSock;
 
         UpfBufPacket *bufPacket;
         if (upfFar.applyAction & PFCP_FAR_APPLY_ACTION_DROP) {
             UpfPDRNode *node, *nextNode = NULL;
             ListForEachSafe(node, nextNode, &session->pdrList) {
-                UTLT_Assert((bufPacket = UpfBufPacketFindByPdrId(node->pdr.pdrId)), continue, "");
+                UTLT_Assert((bufPacket = UpfBufPacketFindByPdrId(session->upfSeid, node->pdr.pdrId)), continue, "");
                 UpfBufPacketRemove(bufPacket);
             }
         } else if (upfFar.applyAction & PFCP_FAR_APPLY_ACTION_FORW) {
@@ -980,10 +995,12 @@ Status UpfN4HandleUpdateQer(UpfSession *session, UpdateQER *updateQer) {
     memset(&upfQer, 0, sizeof(UpfQER));
 
     uint32_t qerID = ntohl(*((uint32_t *)updateQer->qERID.value));
-    UTLT_Assert(!UpfQERFindByID(qerID, &upfQer), return STATUS_ERROR, "QER ID[%u] does NOT exist in UPF Context", qerID);
+    UTLT_Assert(!UpfQERFindByID(session->upfSeid, qerID, &upfQer), return STATUS_ERROR, "QER ID[%u] does NOT exist in UPF Context", qerID);
 
     UTLT_Assert(_ConvertUpdateQERTlvToRule(&upfQer, updateQer) == STATUS_OK,
         return STATUS_ERROR, "Convert Update QER TLV To Rule is failed");
+    upfQer.flags.seid = 1;
+    upfQer.seid = session->upfSeid;
 
     // Using UPDK API
     UTLT_Assert(Gtpv1TunnelUpdateQER(&upfQer) == 0, return STATUS_ERROR,
@@ -1015,7 +1032,7 @@ Status UpfN4HandleRemovePdr(UpfSession *session, uint16_t nPDRID) {
     UpfPDR upfPdr;
     memset(&upfPdr, 0, sizeof(UpfPDR));
 
-    UTLT_Assert(!UpfPDRFindByID(pdrID, &upfPdr), return STATUS_ERROR, "PDR ID[%u] does NOT exist in UPF Context", pdrID);    
+    UTLT_Assert(!UpfPDRFindByID(session->upfSeid, pdrID, &upfPdr), return STATUS_ERROR, "PDR ID[%u] does NOT exist in UPF Context", pdrID);    
 
     UTLT_Assert(_ConvertRemovePDRTlvToRule(&upfPdr, nPDRID) == STATUS_OK,
             return STATUS_ERROR, "Convert PDR TLV To Rule is failed");
@@ -1025,7 +1042,7 @@ Status UpfN4HandleRemovePdr(UpfSession *session, uint16_t nPDRID) {
         "Gtpv1TunnelRemovePDR failed");
     
     // Remove Buffering packet
-    UpfBufPacket *packetStorage = UpfBufPacketFindByPdrId(pdrID);
+    UpfBufPacket *packetStorage = UpfBufPacketFindByPdrId(session->upfSeid, pdrID);
     if (packetStorage)
         UpfBufPacketRemove(packetStorage);
 
@@ -1054,10 +1071,12 @@ Status UpfN4HandleRemoveFar(UpfSession *session, uint32_t nFARID) {
     UpfFAR upfFar;
     memset(&upfFar, 0, sizeof(UpfFAR));
 
-    UTLT_Assert(!UpfFARFindByID(farID, &upfFar), return STATUS_ERROR, "FAR ID[%u] does NOT exist in UPF Context", farID);
+    UTLT_Assert(!UpfFARFindByID(session->upfSeid, farID, &upfFar), return STATUS_ERROR, "FAR ID[%u] does NOT exist in UPF Context", farID);
 
     UTLT_Assert(_ConvertRemoveFARTlvToRule(&upfFar, nFARID) == STATUS_OK,
         return STATUS_ERROR, "Convert FAR TLV To Rule is failed");
+    upfFar.flags.seid = 1;
+    upfFar.seid = session->upfSeid;
 
     // Using UPDK API
     UTLT_Assert(Gtpv1TunnelRemoveFAR(&upfFar) == 0, return STATUS_ERROR,
@@ -1088,10 +1107,12 @@ Status UpfN4HandleRemoveQer(UpfSession *session, uint32_t nQERID) {
     UpfQER upfQer;
     memset(&upfQer, 0, sizeof(UpfQER));
 
-    UTLT_Assert(!UpfQERFindByID(qerID, &upfQer), return STATUS_ERROR, "QER ID[%u] does NOT exist in UPF Context", qerID);
+    UTLT_Assert(!UpfQERFindByID(session->upfSeid, qerID, &upfQer), return STATUS_ERROR, "QER ID[%u] does NOT exist in UPF Context", qerID);
 
     UTLT_Assert(_ConvertRemoveQERTlvToRule(&upfQer, nQERID) == STATUS_OK,
         return STATUS_ERROR, "Convert Remove QER TLV To Rule is failed");
+    upfQer.flags.seid = 1;
+    upfQer.seid = session->upfSeid;
 
     // Using UPDK API
     UTLT_Assert(Gtpv1TunnelRemoveQER(&upfQer) == 0, return STATUS_ERROR,
@@ -1116,6 +1137,9 @@ Status UpfN4HandleSessionEstablishmentRequest(UpfSession *session, PfcpXact *pfc
     //UTLT_Assert(pfcpXact->gtpXact, return,
     // "GTP Xact of pfcpXact error");
 
+    // All rules of the request are applied to the device at once
+    Gtpv1TunnelTransactionBegin();
+
     for (int i = 0; i < sizeof(request->createFAR) / sizeof(CreateFAR); i++) {
         if (request->createFAR[i].presence) {
             status = UpfN4HandleCreateFar(session, &request->createFAR[i]);
@@ -1152,6 +1176,9 @@ Status UpfN4HandleSessionEstablishmentRequest(UpfSession *session, PfcpXact *pfc
         }
     }
 
+    UTLT_Assert(Gtpv1TunnelTransactionCommit() == 0, cause = PFCP_CAUSE_REQUEST_REJECTED,
+                "Apply rules error");
+
     PfcpHeader header;
     Bufblk *bufBlk = NULL;
     PfcpFSeid *smfFSeid = NULL;
@@ -1186,14 +1213,9 @@ Status UpfN4HandleSessionEstablishmentRequest(UpfSession *session, PfcpXact *pfc
     return STATUS_OK;
 }
 
-Status UpfN4HandleSessionModificationRequest(UpfSession *session, PfcpXact *xact,
-                                             PFCPSessionModificationRequest *request) {
-    UTLT_Assert(session, return STATUS_ERROR, "Session error");
-    UTLT_Assert(xact, return STATUS_ERROR, "xact error");
-
+static Status UpfN4HandleSessionModificationRules(UpfSession *session,
+                                                  PFCPSessionModificationRequest *request) {
     Status status;
-    PfcpHeader header;
-    Bufblk *bufBlk;
 
     /* Create FAR */
     for (int i = 0; i < sizeof(request->createFAR) / sizeof(CreateFAR); i++) {
@@ -1294,6 +1316,26 @@ Status UpfN4HandleSessionModificationRequest(UpfSession *session, PfcpXact *xact
         }
     }
 
+    return STATUS_OK;
+}
+
+Status UpfN4HandleSessionModificationRequest(UpfSession *session, PfcpXact *xact,
+                                             PFCPSessionModificationRequest *request) {
+    UTLT_Assert(session, return STATUS_ERROR, "Session error");
+    UTLT_Assert(xact, return STATUS_ERROR, "xact error");
+
+    Status status;
+    PfcpHeader header;
+    Bufblk *bufBlk;
+
+    Gtpv1TunnelTransactionBegin();
+    status = UpfN4HandleSessionModificationRules(session, request);
+    // Commit even if a rule fails, the rules before it are applied
+    UTLT_Assert(Gtpv1TunnelTransactionCommit() == 0, status = STATUS_ERROR,
+                "Modification: Apply rules error");
+    UTLT_Assert(status == STATUS_OK, return STATUS_ERROR,
+                "Modification: Handle rules error");
+
     /* Send Session Modification Response */
     memset(&header, 0, sizeof(PfcpHeader));
     header.type = PFCP_SESSION_MODIFICATION_RESPONSE;
@@ -1326,7 +1368,11 @@ Status UpfN4HandleSessionDeletionRequest(UpfSession *session, PfcpXact *xact,
     Bufblk *bufBlk = NULL;
 
     /* delete session */
-    UTLT_Assert(UpfSessionRemove(session) == STATUS_OK, return STATUS_ERROR,
+    Gtpv1TunnelTransactionBegin();
+    status = UpfSessionRemove(session);
+    UTLT_Assert(Gtpv1TunnelTransactionCommit() == 0, status = STATUS_ERROR,
+        "Remove rules of session failed");
+    UTLT_Assert(status == STATUS_OK, return STATUS_ERROR,
         "UpfSessionRemove failed");
 
     /* Send Session Deletion Response */
@@ -1438,18 +1484,10 @@ Status UpfN4HandleAssociationReleaseRequest(PfcpXact *xact,
     UTLT_Assert(request->nodeID.presence, return STATUS_ERROR,
                 "Request missing nodeId");
 
-    // Clear all session releated to this node
-    HashIndex *sessionHashIdx = NULL;
-    UpfSession *session = NULL;
-
-    for (sessionHashIdx = UpfSessionFirst(); sessionHashIdx;
-         sessionHashIdx = UpfSessionNext(sessionHashIdx)) {
-        session = UpfSessionThis(sessionHashIdx);
-        // Clear transaction node
-        if (session->pfcpNode == xact->gnode) {
-            UpfSessionRemove(session);
-        }
-    }
+    // Clear all session releated to this node, each N4 worker clears its own
+    UTLT_Assert(UpfN4WorkerBroadcast(UPF_EVENT_SESSION_RELEASE,
+                                     (uintptr_t) xact->gnode) == STATUS_OK, ,
+                "Session release send to N4 workers error");
     // TODO: Check if I need to remove gnode in transaction
 
     // Build Response
@@ -5,6 +5,7 @@
 #include "utlt_buff.h"
 #include "utlt_debug.h"
 #include "n4_pfcp_handler.h"
+#include "n4_worker.h"
 #include "upf_context.h"
 #include "pfcp_path.h"
 
@@ -91,10 +92,8 @@ static int _pfcpReceiveCB(Sock *sock, void *data) {
 
     UTLT_Assert(upf, BufblkFree(bufBlk); return STATUS_ERROR, "PFCP node not found");
 
-    //event.type = UPF_EVENT_N4_MESSAGE;
-    //event.arg0 = (uintptr_t)bufBlk;
-    //event.arg1 = (uintptr_t)upf;
-    status = EventSend(Self()->eventQ, UPF_EVENT_N4_MESSAGE, 2, bufBlk, upf);
+    // Session messages go to the N4 worker owning the session
+    status = UpfN4MessageSend(bufBlk, upf);
     if (status != STATUS_OK) {
         UTLT_Error("UPF EventSend error");
         BufblkFree(bufBlk);
@@ -0,0 +1,204 @@
+#define TRACE_MODULE _n4_worker
+
+#include "n4_worker.h"
+
+#include <string.h>
+#include <unistd.h>
+#include <endian.h>
+
+#include "utlt_thread.h"
+#include "utlt_rcu.h"
+
+#include "pfcp_message.h"
+#include "pfcp_xact.h"
+
+#include "upf_context.h"
+#include "n4_dispatcher.h"
+
+typedef struct _UpfN4Worker {
+    int             id;
+    EvtQId          eventQ;
+    ThreadID        thread;
+    ListHead        sessionList;    // Sessions owned by this worker
+} UpfN4Worker;
+
+static UpfN4Worker n4Worker[MAX_NUM_OF_N4_WORKER];
+static int n4WorkerNum = 0;
+static __thread UpfN4Worker *n4WorkerSelf = NULL;
+
+static void UpfN4WorkerThread(ThreadID id, void *data) {
+    UpfN4Worker *worker = data;
+    Event event[MAX_NUM_OF_EVENT_BATCH];
+    int num, stop = 0;
+
+    n4WorkerSelf = worker;
+    UTLT_Assert(PfcpXactThreadInit(worker->eventQ) == STATUS_OK, ,
+                "N4 worker[%d] PFCP xact init error", worker->id);
+
+    while (!stop) {
+        num = EventTryRecvBatch(worker->eventQ, event, MAX_NUM_OF_EVENT_BATCH);
+        if (!num) {
+            // Nothing else to do, so rules freed by the last events are freed before sleeping
+            RcuDeferFlush();
+            // Blocks until there is at least one event
+            num = EventRecvBatch(worker->eventQ, event, MAX_NUM_OF_EVENT_BATCH);
+        }
+        UTLT_Assert(num >= 0, break, "N4 worker[%d] event receive fail", worker->id);
+
+        for (int i = 0; i < num && !stop; i++) {
+            if (event[i].type == UPF_EVENT_N4_WORKER_STOP)
+                stop = 1;
+            else
+                UpfDispatcher(&event[i]);
+        }
+
+        // Rules freed by the whole batch share one grace period, which other workers do not wait for
+        RcuDeferPoll();
+    }
+
+    PfcpXactThreadTerm();
+    RcuThreadOffline();
+    n4WorkerSelf = NULL;
+
+    sem_post(((Thread *)id)->semaphore);
+    UTLT_Trace("N4 worker[%d] terminated", worker->id);
+
+    return;
+}
+
+Status UpfN4WorkerInit(int num) {
+    UTLT_Assert(!n4WorkerNum, return STATUS_ERROR, "N4 workers have been started");
+
+    if (num <= 0)
+        num = sysconf(_SC_NPROCESSORS_ONLN);
+    if (num <= 0)
+        num = 1;
+    if (num > MAX_NUM_OF_N4_WORKER) {
+        UTLT_Warning("N4 worker number %d is more than %d", num, MAX_NUM_OF_N4_WORKER);
+        num = MAX_NUM_OF_N4_WORKER;
+    }
+
+    for (int i = 0; i < num; i++) {
+        UpfN4Worker *worker = &n4Worker[i];
+
+        memset(worker, 0, sizeof(UpfN4Worker));
+        worker->id = i;
+        ListHeadInit(&worker->sessionList);
+
+        worker->eventQ = EventQueueCreate(EVTQ_O_BLOCK);
+        UTLT_Assert(worker->eventQ, goto err, "N4 worker[%d] event queue create error", i);
+
+        UTLT_Assert(ThreadCreate(&worker->thread, UpfN4WorkerThread, worker) == STATUS_OK,
+                    EventQueueDelete(worker->eventQ); goto err,
+                    "N4 worker[%d] thread create error", i);
+
+        n4WorkerNum = i + 1;
+    }
+
+    UTLT_Info("%d N4 workers started", n4WorkerNum);
+
+    return STATUS_OK;
+
+err:
+    UpfN4WorkerTerm();
+    return STATUS_ERROR;
+}
+
+Status UpfN4WorkerTerm() {
+    Status status = STATUS_OK;
+    int num = n4WorkerNum;
+
+    // Route nothing to the workers from now on
+    n4WorkerNum = 0;
+
+    for (int i = 0; i < num; i++) {
+        UpfN4Worker *worker = &n4Worker[i];
+
+        UTLT_Assert(EventSend(worker->eventQ, UPF_EVENT_N4_WORKER_STOP, 0) == STATUS_OK,
+                    status = STATUS_ERROR; continue, "N4 worker[%d] stop error", i);
+        UTLT_Assert(ThreadDelete(worker->thread) == STATUS_OK,
+                    status = STATUS_ERROR, "N4 worker[%d] thread delete error", i);
+        UTLT_Assert(EventQueueDelete(worker->eventQ) == STATUS_OK,
+                    status = STATUS_ERROR, "N4 worker[%d] event queue delete error", i);
+    }
+
+    return status;
+}
+
+int UpfN4WorkerNum() {
+    return n4WorkerNum;
+}
+
+int UpfN4WorkerSelf() {
+    return (n4WorkerSelf ? n4WorkerSelf->id : -1);
+}
+
+ListHead *UpfN4WorkerSessionList() {
+    return (n4WorkerSelf ? &n4WorkerSelf->sessionList : NULL);
+}
+
+EvtQId UpfN4WorkerQueue(uint64_t seid) {
+    if (!seid || !n4WorkerNum)
+        return Self()->eventQ;
+
+    return n4Worker[UpfSeidWorker(seid) % n4WorkerNum].eventQ;
+}
+
+// Worker handling the received message, or -1 for the node lane
+static int UpfN4MessageWorker(Bufblk *bufBlk) {
+    PfcpHeader *header = (PfcpHeader *)bufBlk->buf;
+    uint8_t *ie, *end;
+    uint64_t seid;
+
+    if (!n4WorkerNum || bufBlk->len < PFCP_HEADER_LEN || !header->seidP)
+        return -1;
+
+    seid = be64toh(header->seid);
+    if (seid)
+        return UpfSeidWorker(seid) % n4WorkerNum;
+
+    // Only establishment request comes without SEID, the others are rejected by the node lane
+    if (header->type != PFCP_SESSION_ESTABLISHMENT_REQUEST)
+        return -1;
+
+    // Walk the top level IEs for CP F-SEID
+    ie = (uint8_t *)bufBlk->buf + PFCP_HEADER_LEN;
+    end = (uint8_t *)bufBlk->buf + bufBlk->len;
+    while (ie + 4 <= end) {
+        uint16_t type = (ie[0] << 8) | ie[1];
+        uint16_t length = (ie[2] << 8) | ie[3];
+
+        if (ie + 4 + length > end)
+            break;
+
+        if (type == PFCP_FSEID_TYPE && length >= 1 + sizeof(seid)) {
+            memcpy(&seid, ie + 5, sizeof(seid));
+            // Spread sequential SEID of SMF over workers
+            return (uint32_t)((be64toh(seid) * 0x9E3779B97F4A7C15ULL) >> 32) % n4WorkerNum;
+        }
+
+        ie += 4 + length;
+    }
+
+    return 0;
+}
+
+Status UpfN4MessageSend(Bufblk *bufBlk, PfcpNode *node) {
+    UTLT_Assert(bufBlk && node, return STATUS_ERROR, "");
+
+    int id = UpfN4MessageWorker(bufBlk);
+    EvtQId eventQ = (id < 0 ? Self()->eventQ : n4Worker[id].eventQ);
+
+    return EventSend(eventQ, UPF_EVENT_N4_MESSAGE, 2, bufBlk, node);
+}
+
+Status UpfN4WorkerBroadcast(uintptr_t eventType, uintptr_t arg0) {
+    Status status = STATUS_OK;
+
+    for (int i = 0; i < n4WorkerNum; i++) {
+        UTLT_Assert(EventSend(n4Worker[i].eventQ, eventType, 1, arg0) == STATUS_OK,
+                    status = STATUS_ERROR, "N4 worker[%d] event send error", i);
+    }
+
+    return status;
+}
@@ -0,0 +1,63 @@
+#ifndef __N4_WORKER_H__
+#define __N4_WORKER_H__
+
+#include <stdint.h>
+
+#include "utlt_debug.h"
+#include "utlt_list.h"
+#include "utlt_buff.h"
+#include "utlt_event.h"
+#include "utlt_slottable.h"
+
+#include "pfcp_node.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * N4 messages of a session are handled by the worker owning the session, the
+ * others (heartbeat, association) by the UPF event queue, the node lane.
+ *
+ * The owner is in the top 16 bits of UP SEID, so messages of a session are
+ * routed by SEID without lookup. Establishment requests without SEID are
+ * routed by CP F-SEID, so their retransmissions reach the same worker.
+ *
+ * The next 16 bits are the generation of the session slot, and the low 32
+ * bits are the index of the session + 1, as the handle of SlotTable.
+ */
+#define MAX_NUM_OF_N4_WORKER        16
+#define MAX_NUM_OF_EVENT_BATCH      32
+
+#define UpfSeidWorker(__seid)       SlotHandleTag(__seid)
+#define UpfSeidIndex(__seid)        SlotHandleIndex(__seid)
+
+/**
+ * Start @num workers, or one per CPU if @num is 0.
+ */
+Status UpfN4WorkerInit(int num);
+Status UpfN4WorkerTerm();
+int UpfN4WorkerNum();
+
+// ID of the calling worker, or -1 if it is not a worker
+int UpfN4WorkerSelf();
+// Sessions owned by the calling worker, or NULL if it is not a worker
+ListHead *UpfN4WorkerSessionList();
+
+// Queue of the worker owning @seid, or the node lane if @seid is 0
+EvtQId UpfN4WorkerQueue(uint64_t seid);
+
+/**
+ * Send a received N4 message to the lane handling it.
+ * The lane frees @bufBlk after handling it.
+ */
+Status UpfN4MessageSend(Bufblk *bufBlk, PfcpNode *node);
+
+// Send the event to every worker
+Status UpfN4WorkerBroadcast(uintptr_t eventType, uintptr_t arg0);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __N4_WORKER_H__ */
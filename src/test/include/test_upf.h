@@ -0,0 +1,18 @@
+#ifndef __TEST_UPF_H__
+#define __TEST_UPF_H__
+
+#include "utlt_test.h"
+#include "utlt_debug.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+Status InmemTest(void *data);
+Status N4HandlerTest(void *data);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __TEST_UPF_H__ */
@@ -0,0 +1,76 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "test_upf.h"
+#include "utlt_debug.h"
+
+#include "pfcp_types.h"
+
+#include "updk/rule.h"
+#include "inmem_context.h"
+
+#define INMEM_TEST_FAR_ID   1
+
+static void InmemTestFarSet(UPDK_FAR *far, uint64_t seid, uint8_t applyAction) {
+    memset(far, 0, sizeof(UPDK_FAR));
+    far->flags.seid = 1;
+    far->seid = seid;
+    far->flags.farId = 1;
+    far->farId = INMEM_TEST_FAR_ID;
+    far->flags.applyAction = 1;
+    far->applyAction = applyAction;
+}
+
+// The same FAR ID under two SEIDs are two rules, and a FAR without SEID is rejected
+Status TestInmem_1() {
+    const uint64_t seid[] = {0x1, 0x2};
+    const uint8_t applyAction[] = {PFCP_FAR_APPLY_ACTION_FORW, PFCP_FAR_APPLY_ACTION_DROP};
+    UPDK_FAR far;
+    InmemCounter counter;
+
+    for (int i = 0; i < 2; i++) {
+        InmemTestFarSet(&far, seid[i], applyAction[i]);
+        UTLT_Assert(Gtpv1TunnelCreateFAR(&far) == 0, return STATUS_ERROR,
+            "FAR of SEID[0x%lx] is not created", seid[i]);
+    }
+    for (int i = 0; i < 2; i++) {
+        UTLT_Assert(InmemFARGet(seid[i], INMEM_TEST_FAR_ID, &far) == 0 &&
+                    far.applyAction == applyAction[i],
+            return STATUS_ERROR, "FAR of SEID[0x%lx] is wrong", seid[i]);
+    }
+
+    InmemTestFarSet(&far, 0, PFCP_FAR_APPLY_ACTION_FORW);
+    far.flags.seid = 0;
+    UTLT_Assert(Gtpv1TunnelCreateFAR(&far) != 0 && Gtpv1TunnelUpdateFAR(&far) != 0 &&
+                Gtpv1TunnelRemoveFAR(&far) != 0,
+        return STATUS_ERROR, "FAR without SEID is accepted");
+
+    InmemTestFarSet(&far, seid[0], applyAction[0]);
+    UTLT_Assert(Gtpv1TunnelRemoveFAR(&far) == 0, return STATUS_ERROR, "");
+    UTLT_Assert(InmemFARGet(seid[0], INMEM_TEST_FAR_ID, &far) != 0 &&
+                InmemFARGet(seid[1], INMEM_TEST_FAR_ID, &far) == 0,
+        return STATUS_ERROR, "FAR of the wrong SEID is removed");
+
+    InmemCounterGet(&counter);
+    UTLT_Assert(counter.rule[INMEM_RULE_FAR].num == 1 && counter.rule[INMEM_RULE_FAR].create == 2 &&
+                counter.rule[INMEM_RULE_FAR].fail == 0,
+        return STATUS_ERROR, "FAR: %lu left, %lu created, %lu failed", counter.rule[INMEM_RULE_FAR].num,
+        counter.rule[INMEM_RULE_FAR].create, counter.rule[INMEM_RULE_FAR].fail);
+
+    return STATUS_OK;
+}
+
+Status InmemTest(void *data) {
+    Status status;
+
+    status = InmemDeviceInit();
+    UTLT_Assert(status == STATUS_OK, return status, "InmemDeviceInit fail");
+
+    status = TestInmem_1();
+    UTLT_Assert(status == STATUS_OK, return status, "TestInmem_1 fail");
+
+    status = InmemDeviceTerm();
+    UTLT_Assert(status == STATUS_OK, return status, "InmemDeviceTerm fail");
+
+    return STATUS_OK;
+}
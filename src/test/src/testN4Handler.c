@@ -0,0 +1,191 @@
+#include <stdio.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+#include "test_upf.h"
+#include "utlt_debug.h"
+#include "utlt_buff.h"
+#include "utlt_thread.h"
+#include "utlt_timer.h"
+#include "utlt_network.h"
+#include "utlt_rcu.h"
+
+#include "pfcp_types.h"
+#include "pfcp_message.h"
+
+#include "upf_context.h"
+#include "n4/n4_pfcp_handler.h"
+#include "updk/init.h"
+#include "inmem_context.h"
+
+#define N4_TEST_NUM_OF_SESSION  2
+#define N4_TEST_RULE_ID         1
+
+#define N4TestSetIe(__ie, __value, __len) do { \
+    (__ie).presence = 1; \
+    (__ie).len = (__len); \
+    (__ie).value = (void *) &(__value); \
+} while (0)
+
+static Status N4TestInit() {
+    UTLT_Assert(BufblkPoolInit() == STATUS_OK, return STATUS_ERROR, "");
+    UTLT_Assert(ThreadInit() == STATUS_OK, return STATUS_ERROR, "");
+    UTLT_Assert(TimerPoolInit() == STATUS_OK, return STATUS_ERROR, "");
+    UTLT_Assert(SockPoolInit() == STATUS_OK, return STATUS_ERROR, "");
+    UTLT_Assert(UpfContextInit() == STATUS_OK, return STATUS_ERROR, "");
+    UTLT_Assert(UpfResourceInit() == STATUS_OK, return STATUS_ERROR, "");
+    UTLT_Assert(Gtpv1EnvInit(Self()->envParams) == 0, return STATUS_ERROR, "");
+
+    return STATUS_OK;
+}
+
+static Status N4TestTerm() {
+    UTLT_Assert(UpfResourceTerminate() == STATUS_OK, return STATUS_ERROR, "");
+    UTLT_Assert(Gtpv1EnvTerm(Self()->envParams) == 0, return STATUS_ERROR, "");
+    UTLT_Assert(UpfContextTerminate() == STATUS_OK, return STATUS_ERROR, "");
+    UTLT_Assert(SockPoolFinal() == STATUS_OK, return STATUS_ERROR, "");
+    UTLT_Assert(TimerFinal() == STATUS_OK, return STATUS_ERROR, "");
+    UTLT_Assert(ThreadFinal() == STATUS_OK, return STATUS_ERROR, "");
+    UTLT_Assert(BufblkPoolFinal() == STATUS_OK, return STATUS_ERROR, "");
+    RcuThreadOffline();
+
+    return STATUS_OK;
+}
+
+/*
+ * Create the downlink FAR, QER and PDR of the session, all of N4_TEST_RULE_ID
+ * as SMF allocates them, with the apply action and gate status of the session
+ */
+static Status N4TestCreateRules(UpfSession *session, uint8_t applyAction, uint8_t gateStatus) {
+    uint16_t pdrId = htons(N4_TEST_RULE_ID);
+    uint32_t ruleId = htonl(N4_TEST_RULE_ID);
+    uint32_t precedence = htonl(32);
+    uint8_t sourceInterface = PFCP_SRC_INTF_CORE;
+    uint8_t destinationInterface = PFCP_FAR_DEST_INTF_ACCESS;
+    PfcpUeIpAddr ueIp = {.v4 = 1, .sd = PFCP_UE_IP_ADDR_DESITINATION, .addr4 = session->ueIpv4.addr4};
+    CreateFAR createFar;
+    CreateQER createQer;
+    CreatePDR createPdr;
+
+    memset(&createFar, 0, sizeof(CreateFAR));
+    createFar.presence = 1;
+    N4TestSetIe(createFar.fARID, ruleId, sizeof(uint32_t));
+    N4TestSetIe(createFar.applyAction, applyAction, sizeof(uint8_t));
+    createFar.forwardingParameters.presence = 1;
+    N4TestSetIe(createFar.forwardingParameters.destinationInterface, destinationInterface, sizeof(uint8_t));
+    UTLT_Assert(UpfN4HandleCreateFar(session, &createFar) == STATUS_OK, return STATUS_ERROR,
+        "FAR of session %u is not created", session->index);
+
+    memset(&createQer, 0, sizeof(CreateQER));
+    createQer.presence = 1;
+    N4TestSetIe(createQer.qERID, ruleId, sizeof(uint32_t));
+    N4TestSetIe(createQer.gateStatus, gateStatus, sizeof(uint8_t));
+    UTLT_Assert(UpfN4HandleCreateQer(session, &createQer) == STATUS_OK, return STATUS_ERROR,
+        "QER of session %u is not created", session->index);
+
+    memset(&createPdr, 0, sizeof(CreatePDR));
+    createPdr.presence = 1;
+    N4TestSetIe(createPdr.pDRID, pdrId, sizeof(uint16_t));
+    N4TestSetIe(createPdr.precedence, precedence, sizeof(uint32_t));
+    createPdr.pDI.presence = 1;
+    N4TestSetIe(createPdr.pDI.sourceInterface, sourceInterface, sizeof(uint8_t));
+    N4TestSetIe(createPdr.pDI.uEIPAddress, ueIp, PFCP_UE_IP_ADDR_IPV4_LEN);
+    N4TestSetIe(createPdr.fARID, ruleId, sizeof(uint32_t));
+    N4TestSetIe(createPdr.qERID[0], ruleId, sizeof(uint32_t));
+    UTLT_Assert(UpfN4HandleCreatePdr(session, &createPdr) == STATUS_OK, return STATUS_ERROR,
+        "PDR of session %u is not created", session->index);
+
+    return STATUS_OK;
+}
+
+// Sessions with the same rule IDs keep their own rules in UPF and in the device
+Status TestN4Handler_1() {
+    UpfSession *session[N4_TEST_NUM_OF_SESSION];
+    const uint8_t applyAction[N4_TEST_NUM_OF_SESSION] = {PFCP_FAR_APPLY_ACTION_FORW, PFCP_FAR_APPLY_ACTION_DROP};
+    const uint8_t gateStatus[N4_TEST_NUM_OF_SESSION] = {0, 0x5};
+    uint8_t dnn[] = "internet";
+    PfcpUeIpAddr ueIp = {.v4 = 1};
+    UpfFAR upfFar;
+    UPDK_FAR far;
+    UPDK_QER qer;
+    UPDK_PDR pdr;
+    InmemCounter counter;
+    uint8_t action;
+
+    for (int i = 0; i < N4_TEST_NUM_OF_SESSION; i++) {
+        inet_pton(AF_INET, (i ? "60.0.0.2" : "60.0.0.1"), &ueIp.addr4);
+        session[i] = UpfSessionAdd(&ueIp, dnn, PFCP_PDN_TYPE_IPV4);
+        UTLT_Assert(session[i], return STATUS_ERROR, "Session %d is not added", i);
+        UTLT_Assert(N4TestCreateRules(session[i], applyAction[i], gateStatus[i]) == STATUS_OK,
+            return STATUS_ERROR, "");
+    }
+
+    for (int i = 0; i < N4_TEST_NUM_OF_SESSION; i++) {
+        uint64_t seid = session[i]->upfSeid;
+
+        UTLT_Assert(InmemFARGet(seid, N4_TEST_RULE_ID, &far) == 0 && far.applyAction == applyAction[i],
+            return STATUS_ERROR, "FAR of session %d is wrong in device", i);
+        UTLT_Assert(InmemQERGet(seid, N4_TEST_RULE_ID, &qer) == 0 && qer.gateStatus == gateStatus[i],
+            return STATUS_ERROR, "QER of session %d is wrong in device", i);
+        UTLT_Assert(InmemPDRGet(seid, N4_TEST_RULE_ID, &pdr) == 0 && pdr.farId == N4_TEST_RULE_ID,
+            return STATUS_ERROR, "PDR of session %d is wrong in device", i);
+
+        UTLT_Assert(UpfFARFindByID(seid, N4_TEST_RULE_ID, &upfFar) == 0 &&
+                    upfFar.applyAction == applyAction[i] && upfFar.seid == seid,
+            return STATUS_ERROR, "FAR of session %d is wrong in UPF", i);
+        UTLT_Assert(HowToHandleThisPacket(seid, N4_TEST_RULE_ID, &action) == STATUS_OK &&
+                    action == applyAction[i], return STATUS_ERROR, "");
+    }
+
+    // Update and remove rules of one session, the other one is not touched
+    uint32_t ruleId = htonl(N4_TEST_RULE_ID);
+    uint8_t forward = PFCP_FAR_APPLY_ACTION_FORW | PFCP_FAR_APPLY_ACTION_NOCP;
+    UpdateFAR updateFar;
+    memset(&updateFar, 0, sizeof(UpdateFAR));
+    updateFar.presence = 1;
+    N4TestSetIe(updateFar.fARID, ruleId, sizeof(uint32_t));
+    N4TestSetIe(updateFar.applyAction, forward, sizeof(uint8_t));
+    UTLT_Assert(UpfN4HandleUpdateFar(session[1], &updateFar) == STATUS_OK, return STATUS_ERROR, "");
+    UTLT_Assert(InmemFARGet(session[1]->upfSeid, N4_TEST_RULE_ID, &far) == 0 && far.applyAction == forward,
+        return STATUS_ERROR, "FAR of session 1 is not updated in device");
+    UTLT_Assert(InmemFARGet(session[0]->upfSeid, N4_TEST_RULE_ID, &far) == 0 && far.applyAction == applyAction[0],
+        return STATUS_ERROR, "FAR of session 0 is updated in device");
+
+    UTLT_Assert(UpfN4HandleRemoveQer(session[0], ruleId) == STATUS_OK, return STATUS_ERROR, "");
+    UTLT_Assert(InmemQERGet(session[0]->upfSeid, N4_TEST_RULE_ID, &qer) != 0 &&
+                InmemQERGet(session[1]->upfSeid, N4_TEST_RULE_ID, &qer) == 0,
+        return STATUS_ERROR, "QER of the wrong session is removed from device");
+    UTLT_Assert(UpfN4HandleRemoveFar(session[1], ruleId) == STATUS_OK, return STATUS_ERROR, "");
+    UTLT_Assert(InmemFARGet(session[1]->upfSeid, N4_TEST_RULE_ID, &far) != 0 &&
+                InmemFARGet(session[0]->upfSeid, N4_TEST_RULE_ID, &far) == 0,
+        return STATUS_ERROR, "FAR of the wrong session is removed from device");
+
+    // Rules left are removed from the device with their sessions
+    for (int i = 0; i < N4_TEST_NUM_OF_SESSION; i++)
+        UTLT_Assert(UpfSessionRemove(session[i]) == STATUS_OK, return STATUS_ERROR, "");
+
+    InmemCounterGet(&counter);
+    for (int kind = 0; kind < INMEM_RULE_MAX; kind++) {
+        UTLT_Assert(counter.rule[kind].num == 0 && counter.rule[kind].fail == 0 &&
+                    counter.rule[kind].create == N4_TEST_NUM_OF_SESSION,
+            return STATUS_ERROR, "Rule %d: %lu left, %lu created, %lu failed in device", kind,
+            counter.rule[kind].num, counter.rule[kind].create, counter.rule[kind].fail);
+    }
+
+    return STATUS_OK;
+}
+
+Status N4HandlerTest(void *data) {
+    Status status;
+
+    status = N4TestInit();
+    UTLT_Assert(status == STATUS_OK, return status, "N4TestInit fail");
+
+    status = TestN4Handler_1();
+    UTLT_Assert(status == STATUS_OK, return status, "TestN4Handler_1 fail");
+
+    status = N4TestTerm();
+    UTLT_Assert(status == STATUS_OK, return status, "N4TestTerm fail");
+
+    return STATUS_OK;
+}
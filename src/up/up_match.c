@@ -3,26 +3,27 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <limits.h>
-#include <regex.h>
 #include <pthread.h>
 
 #include "utlt_debug.h"
 #include "utlt_pool.h"
 #include "utlt_list.h"
 #include "utlt_hash.h"
+#include "utlt_rcu.h"
+#include "utlt_classifier.h"
+#include "utlt_ipfilter.h"
 #include "utlt_3gppTypes.h"
 #include "utlt_netheader.h"
 #include "pfcp_types.h"
 #include "upf_context.h"
 #include "up/up_path.h"
+#include "n4/n4_worker.h"
 
 #include "updk/rule_pdr.h"
 
 #define MAX_SIZE_OF_PACKET 1600
 
-#define MAX_NUM_OF_MATCH_RULE (MAX_POOL_OF_BEARER * 2)
-
-PoolDeclare(MatchRuleNodePool, MatchRuleNode, MAX_NUM_OF_MATCH_RULE);
+PoolDeclare(MatchRuleNodePool, MatchRuleNode);
 
 #define MAX_NUM_OF_H_LIST       (8192)
 Hash *MatchHash; // Only use its key
@@ -34,24 +35,33 @@ static inline uint32_t MHash32(uint32_t input) {
     return rt;
 }
 
+/*
+ * Rules with the same TEID (UL) or the same UE IPv4 (DL) are put in one group,
+ * and each group is compiled into a tuple space classifier for the packet path.
+ *
+ * Lookups walk the hash lists and read the classifier under RcuReadLock() only,
+ * so packet classification never waits for rule installation.
+ * The locks below only serialize writers.
+ */
+typedef struct {
+    ListHead node;
+    uint32_t key;
+
+    ListHead ruleList;          // MatchRuleNode sorted by precedence, writer only
+    int numOfRule;
+
+    Classifier *classifier;     // Replaced by RcuAssignPointer()
+} MatchRuleGroup;
+
 ListHead IPv4HList[MAX_NUM_OF_H_LIST];
 pthread_mutex_t IPv4HListLock;
 
 ListHead TEIDHList[MAX_NUM_OF_H_LIST];
 pthread_mutex_t TEIDHListLock;
 
-#define IPv4_HList_Thread_Safe(expr) \
-    pthread_mutex_lock(&IPv4HListLock); \
-    expr; \
-    pthread_mutex_unlock(&IPv4HListLock)
-
-#define TEID_HList_Thread_Safe(expr) \
-    pthread_mutex_lock(&TEIDHListLock); \
-    expr; \
-    pthread_mutex_unlock(&TEIDHListLock)
-
-Status MatchInit() {
-    PoolInit(&MatchRuleNodePool, MAX_NUM_OF_MATCH_RULE);
+Status MatchInit(uint32_t capacity, uint32_t flags) {
+    UTLT_Assert(IndexPoolInit(&MatchRuleNodePool, capacity, flags) == STATUS_OK,
+        return STATUS_ERROR, "MatchRuleNodePool init failed");
 
     MatchHash = HashMake();
     UTLT_Assert(MatchHash, return STATUS_ERROR, "Hash used in match rule alloc failed");
@@ -67,9 +77,23 @@ Status MatchInit() {
     return STATUS_OK;
 }
 
+static void MatchRuleGroupFreeAll(ListHead *hList) {
+    MatchRuleGroup *group, *nextGroup = NULL;
+    for (int i = 0; i < MAX_NUM_OF_H_LIST; i++) {
+        ListForEachSafe(group, nextGroup, &hList[i]) {
+            ListRemove(group);
+            ClassifierFree(group->classifier);
+            free(group);
+        }
+    }
+}
+
 Status MatchTerm() {
     PoolTerminate(&MatchRuleNodePool);
 
+    MatchRuleGroupFreeAll(IPv4HList);
+    MatchRuleGroupFreeAll(TEIDHList);
+
     pthread_mutex_destroy(&IPv4HListLock);
     pthread_mutex_destroy(&TEIDHListLock);
     HashDestroy(MatchHash);
@@ -80,33 +104,31 @@ Status MatchTerm() {
 MatchRuleNode *MatchRuleNodeAlloc() {
     MatchRuleNode *rt = NULL;
 
-    rt = calloc(1, sizeof(MatchRuleNode));
-    // PoolAlloc(&MatchRuleNodePool, rt);
+    PoolAlloc(&MatchRuleNodePool, rt);
     UTLT_Assert(rt, return NULL, "MatchRuleNodePool is empty");
 
-    //memset(rt, 0, sizeof(MatchRuleNode));
+    memset(rt, 0, sizeof(MatchRuleNode));
     ListHeadInit(&rt->node);
 
     return rt;
 }
 
 void MatchRuleDelete(MatchRuleNode *node) {
-    if (node->sport_list)
-        free(node->sport_list);
-    if (node->dport_list)
-        free(node->dport_list);
-
     ListRemove(node);
 }
 
+static void MatchRuleNodeFreeDeferred(void *node) {
+    PoolFree(&MatchRuleNodePool, node);
+}
+
+// Classifiers compiled before may still return it to packet lookups, so it goes back to the pool by RcuDefer()
 Status MatchRuleNodeFree(MatchRuleNode *node) {
     if (!node)
         return STATUS_OK;
     
     MatchRuleDelete(node);
 
-    free(node);
-    // PoolFree(&MatchRuleNodePool, node);
+    RcuDefer(MatchRuleNodeFreeDeferred, node);
 
     return STATUS_OK;
 }
@@ -120,52 +142,160 @@ static inline ListHead *GetLastSmallPrecedenceFromList(ListHead *entry, MatchRul
     return it;
 }
 
-static Status MatchRuleRegisterToGTPU(MatchRuleNode *matchRule) {
-    TEID_HList_Thread_Safe(
-        ListHead *entry = GetLastSmallPrecedenceFromList(&TEIDHList[MHash32(matchRule->teid) % MAX_NUM_OF_H_LIST], matchRule);
-        ListInsert(matchRule, entry);
-    );
-    
-    return STATUS_OK;
+// Writer only, hold the lock of its hash list
+static MatchRuleGroup *MatchRuleGroupFind(ListHead *entry, uint32_t key) {
+    MatchRuleGroup *group, *nextGroup = NULL;
+    ListForEachSafe(group, nextGroup, entry) {
+        if (group->key == key)
+            return group;
+    }
+    return NULL;
 }
 
-static Status MatchRuleRegisterToIPv4(MatchRuleNode *matchRule) {
-    IPv4_HList_Thread_Safe(
-        ListHead *entry = GetLastSmallPrecedenceFromList(&IPv4HList[MHash32(matchRule->daddr) % MAX_NUM_OF_H_LIST], matchRule);
-        ListInsert(matchRule, entry);
-    );
-    
-    return STATUS_OK;
+// Reader only, call it in read-side critical section
+static inline MatchRuleNode *MatchRuleGroupClassify(ListHead *hList, uint32_t key, const ClassifierKey *pktKey) {
+    MatchRuleGroup *group;
+    ListForEachRcu(group, &hList[MHash32(key) % MAX_NUM_OF_H_LIST]) {
+        if (group->key == key)
+            return ClassifierLookup(RcuDereference(group->classifier), pktKey);
+    }
+    return NULL;
+}
+
+static void ClassifierFreeDeferred(void *classifier) {
+    ClassifierFree(classifier);
+}
+
+static Classifier *MatchRuleGroupCompile(MatchRuleGroup *group) {
+    ClassifierRule *rules = calloc(group->numOfRule ? group->numOfRule : 1, sizeof(ClassifierRule));
+    UTLT_Assert(rules, return NULL, "ClassifierRule alloc failed");
+
+    int idx = 0;
+    MatchRuleNode *matchRule, *nextMatchRule = NULL;
+    ListForEachSafe(matchRule, nextMatchRule, &group->ruleList) {
+        ClassifierRule *rule = &rules[idx++];
+        rule->proto = matchRule->proto;
+        rule->saddr = matchRule->saddr;
+        rule->smask = matchRule->smask;
+        rule->daddr = matchRule->daddr;
+        rule->dmask = matchRule->dmask;
+        rule->sportNum = matchRule->sport_num;
+        rule->sportList = matchRule->sport_list;
+        rule->dportNum = matchRule->dport_num;
+        rule->dportList = matchRule->dport_list;
+        rule->data = matchRule;
+    }
+
+    Classifier *classifier = ClassifierCompile(rules, idx);
+    free(rules);
+
+    return classifier;
+}
+
+static Status MatchRuleRegisterToHList(ListHead *hList, pthread_mutex_t *lock, uint32_t key, MatchRuleNode *matchRule) {
+    Status status = STATUS_OK;
+    Classifier *oldClassifier = NULL;
+    ListHead *entry = &hList[MHash32(key) % MAX_NUM_OF_H_LIST];
+
+    pthread_mutex_lock(lock);
+
+    MatchRuleGroup *group = MatchRuleGroupFind(entry, key);
+    int isNewGroup = !group;
+    if (isNewGroup) {
+        group = calloc(1, sizeof(MatchRuleGroup));
+        UTLT_Assert(group, status = STATUS_ERROR; goto UNLOCK, "MatchRuleGroup alloc failed");
+        ListHeadInit(&group->node);
+        ListHeadInit(&group->ruleList);
+        group->key = key;
+    }
+
+    ListInsert(matchRule, GetLastSmallPrecedenceFromList(&group->ruleList, matchRule));
+    group->numOfRule++;
+
+    Classifier *classifier = MatchRuleGroupCompile(group);
+    if (!classifier) {
+        ListRemove(matchRule);
+        group->numOfRule--;
+        if (isNewGroup)
+            free(group);
+        UTLT_Error("Match rule classifier compile failed");
+        status = STATUS_ERROR;
+        goto UNLOCK;
+    }
+
+    oldClassifier = group->classifier;
+    RcuAssignPointer(group->classifier, classifier);
+    if (isNewGroup)
+        ListInsertRcu(group, entry);
+
+UNLOCK:
+    pthread_mutex_unlock(lock);
+
+    if (oldClassifier)
+        RcuDefer(ClassifierFreeDeferred, oldClassifier);
+
+    return status;
 }
 
 Status MatchRuleRegister(MatchRuleNode *matchRule) {
     UTLT_Assert(matchRule, return STATUS_ERROR, "MatchRuleNode should not be NULL")
 
     if (matchRule->teid)
-        return MatchRuleRegisterToGTPU(matchRule);
+        return MatchRuleRegisterToHList(TEIDHList, &TEIDHListLock, matchRule->teid, matchRule);
     else
-        return MatchRuleRegisterToIPv4(matchRule);
+        return MatchRuleRegisterToHList(IPv4HList, &IPv4HListLock, matchRule->daddr, matchRule);
 }
 
-static Status MatchRuleDeregisterToGTPU(MatchRuleNode *matchRule) {
-    TEID_HList_Thread_Safe(
-        ListRemove(matchRule);
-    );
-    return STATUS_OK;
-}
+static Status MatchRuleDeregisterToHList(ListHead *hList, pthread_mutex_t *lock, uint32_t key, MatchRuleNode *matchRule) {
+    Classifier *oldClassifier = NULL;
+    MatchRuleGroup *oldGroup = NULL;
+    ListHead *entry = &hList[MHash32(key) % MAX_NUM_OF_H_LIST];
+
+    pthread_mutex_lock(lock);
+
+    MatchRuleGroup *group = MatchRuleGroupFind(entry, key);
+    // Not registered
+    if (!group || matchRule->node.next == &matchRule->node) {
+        pthread_mutex_unlock(lock);
+        return STATUS_OK;
+    }
+
+    ListRemove(matchRule);
+    group->numOfRule--;
+
+    oldClassifier = group->classifier;
+    if (group->numOfRule) {
+        Classifier *classifier = MatchRuleGroupCompile(group);
+        // The old one still points to the removed rule, so it can NOT be kept
+        UTLT_Assert(classifier, , "Match rule classifier compile failed, rules with key[%u] are inactive", key);
+        RcuAssignPointer(group->classifier, classifier);
+    } else {
+        ListRemoveRcu(group);
+        oldGroup = group;
+    }
+
+    pthread_mutex_unlock(lock);
+
+    RcuDefer(ClassifierFreeDeferred, oldClassifier);
+    if (oldGroup)
+        RcuDefer(free, oldGroup);
 
-static Status MatchRuleDeregisterToIPv4(MatchRuleNode *matchRule) {
-    IPv4_HList_Thread_Safe(
-        ListRemove(matchRule);
-    );
     return STATUS_OK;
 }
 
+/**
+ * MatchRuleDeregister - Remove the rule from packet lookups without waiting for them
+ *
+ * Lookups running at the call may still see it, so free @matchRule by
+ * MatchRuleNodeFree() and its PDR by RcuDefer() instead of reusing them.
+ */
 Status MatchRuleDeregister(MatchRuleNode *matchRule) {
+    UTLT_Assert(matchRule, return STATUS_ERROR, "MatchRuleNode should not be NULL");
+
     if (matchRule->teid)
-        return MatchRuleDeregisterToGTPU(matchRule);
+        return MatchRuleDeregisterToHList(TEIDHList, &TEIDHListLock, matchRule->teid, matchRule);
     else
-        return MatchRuleDeregisterToIPv4(matchRule);
+        return MatchRuleDeregisterToHList(IPv4HList, &IPv4HListLock, matchRule->daddr, matchRule);
 }
 
 /**
@@ -240,153 +370,88 @@ static int GTPUHeaderLen(uint8_t *pkt, uint16_t pktlen, uint16_t hdrlen) {
     return rt_len;
 }
 
-static inline int ProtocolMatch(uint8_t targetProto, uint8_t matchProto) {
-    return targetProto == matchProto;
-}
-
 static inline int IPv4Match(uint32_t targetIP, uint32_t matchIP, uint32_t matchMask) {
     return !((targetIP ^ matchIP) & matchMask);
 }
 
-static int PortMatch(uint16_t port, uint32_t *matchList, int len) {
-    if (!len)
-        return 1;
-    
-    for (int i = 0; i < len; i++) {
-        if (PortStart(matchList[i]) <= port && PortEnd(matchList[i]) >= port)
-            return 1;
-    }
+/**
+ * PacketClassifierKeyFill - Extract the fields which classifier needs from L3 packet
+ *
+ * @pkt: packet pointer which layer should upper or equal than L3 header
+ * @pktlen: total length of @pkt
+ * @hdrlen: Header length from @pkt to L3 header
+ * @key: output
+ * @return: 1 or 0 if packet is too short
+ */
+static inline int PacketClassifierKeyFill(uint8_t *pkt, uint16_t pktlen, uint32_t hdrlen, ClassifierKey *key) {
+    if (!PacketLenIsEnough(hdrlen + sizeof(IPv4Header), pktlen))
+        return 0;
+    IPv4Header *iph = (IPv4Header *) ((uint8_t *) pkt + hdrlen);
 
-    return 0;
-}
+    key->proto = iph->proto;
+    key->saddr = iph->saddr;
+    key->daddr = iph->daddr;
 
-static inline int PacketNonGTPUMatch(uint8_t *pkt, uint16_t pktlen, uint32_t hdrlen, MatchRuleNode *matchRule) {
-    UTLT_Assert(PacketLenIsEnough(hdrlen + sizeof(IPv4Header), pktlen), return STATUS_ERROR,
-        "Packet length is not enough");
-    IPv4Header *iph = (IPv4Header *) ((uint8_t *) pkt + hdrlen);
+    key->hasPort = PacketLenIsEnough(hdrlen + sizeof(IPv4Header) + sizeof(UDPHeader), pktlen);
+    if (key->hasPort) {
+        UDPHeader *udpHdr = (UDPHeader *) ((uint8_t *) iph + sizeof(IPv4Header));
+        key->sport = ntohs(udpHdr->source);
+        key->dport = ntohs(udpHdr->dest);
+    }
 
-    UDPHeader *udpHdr = (PacketLenIsEnough(hdrlen + sizeof(IPv4Header) + sizeof(UDPHeader), pktlen) ?
-        (UDPHeader *) ((uint8_t *) iph + sizeof(IPv4Header)) : NULL);
-
-    if (matchRule->proto)
-        if (!ProtocolMatch(iph->proto, matchRule->proto))
-            return 0;
-    if (matchRule->saddr && matchRule->smask)
-        if (!IPv4Match(iph->saddr, matchRule->saddr, matchRule->smask))
-            return 0;
-    if (matchRule->daddr && matchRule->dmask)
-        if (!IPv4Match(iph->daddr, matchRule->daddr, matchRule->dmask))
-            return 0;
-    if (matchRule->sport_num)
-        if (!udpHdr || !PortMatch(ntohs(udpHdr->source), matchRule->sport_list, matchRule->sport_num))
-            return 0;
-    if (matchRule->dport_num)
-        if (!udpHdr || !PortMatch(ntohs(udpHdr->dest), matchRule->dport_list, matchRule->dport_num))
-            return 0;
     return 1;
 }
 
-Status FindPDRByTEID(uint8_t *pkt, uint16_t pktlen, uint32_t hdrlen, void *pdrBuf) {
-    UTLT_Assert(PacketLenIsEnough(hdrlen + sizeof(Gtpv1Header), pktlen), return STATUS_ERROR,
+const UPDK_PDRView *FindPDRByTEID(uint8_t *pkt, uint16_t pktlen, uint32_t hdrlen) {
+    UTLT_Assert(PacketLenIsEnough(hdrlen + sizeof(Gtpv1Header), pktlen), return NULL,
         "Packet length is not enough");
-    
-    Status status = STATUS_ERROR;
 
     Gtpv1Header *gtpHdr = (Gtpv1Header *) (pkt + hdrlen);
     uint32_t teid = ntohl(gtpHdr->_teid);
 
     int gtpuLen = GTPUHeaderLen((uint8_t *) gtpHdr, pktlen - hdrlen, 0);
-    UTLT_Assert(gtpuLen >= 0, return STATUS_ERROR, "GTP-U packet format failed");
+    UTLT_Assert(gtpuLen >= 0, return NULL, "GTP-U packet format failed");
 
-    MatchRuleNode *matchRule, *nextMatchRule = NULL;
-    TEID_HList_Thread_Safe(
-        ListHead *entry = &TEIDHList[MHash32(teid) % MAX_NUM_OF_H_LIST];
-        ListForEachSafe(matchRule, nextMatchRule, entry) {
-            if (matchRule->teid != teid) {
-                continue;
-            }
+    ClassifierKey key;
+    UTLT_Assert(PacketClassifierKeyFill(pkt, pktlen, hdrlen + gtpuLen, &key), return NULL,
+        "Inner packet length is not enough");
 
-            if (!PacketNonGTPUMatch((uint8_t *) gtpHdr, pktlen, gtpuLen, matchRule))
-                continue;
-
-            memcpy(pdrBuf, matchRule->pdr, sizeof(UPDK_PDR));
-            status = STATUS_OK;
-            break;
-        }
-    );
+    MatchRuleNode *matchRule = MatchRuleGroupClassify(TEIDHList, teid, &key);
 
-    return status;
+    return (matchRule ? &matchRule->pdrView : NULL);
 }
 
-Status FindPDRByUEIP(uint8_t *pkt, uint16_t pktlen, uint32_t hdrlen, void *pdrBuf) {
-    UTLT_Assert(PacketLenIsEnough(hdrlen + sizeof(IPv4Header), pktlen), return STATUS_ERROR,
+const UPDK_PDRView *FindPDRByUEIP(uint8_t *pkt, uint16_t pktlen, uint32_t hdrlen) {
+    ClassifierKey key;
+    UTLT_Assert(PacketClassifierKeyFill(pkt, pktlen, hdrlen, &key), return NULL,
         "Packet length is not enough");
 
-    Status status = STATUS_ERROR;
-
-    IPv4Header *iph = (IPv4Header *) ((uint8_t *) pkt + hdrlen);
-    MatchRuleNode *matchRule, *nextMatchRule = NULL;
-    IPv4_HList_Thread_Safe(
-        ListHead *entry = &IPv4HList[MHash32(iph->daddr) % MAX_NUM_OF_H_LIST];
-        ListForEachSafe(matchRule, nextMatchRule, entry) {
-            if (!PacketNonGTPUMatch(pkt, pktlen, hdrlen, matchRule))
-                continue;
-
-            memcpy(pdrBuf, matchRule->pdr, sizeof(UPDK_PDR));
-            status = STATUS_OK;
-            break;
-        }
-    );
-
-    return status;
-}
-
-static int PacketInGTPUHandle(uint8_t *pkt, uint16_t pktlen, uint16_t hdrlen, uint32_t remoteIP, uint16_t _remotePort, MatchRuleNode *matchRule) {
-    UTLT_Assert(PacketLenIsEnough(hdrlen + sizeof(Gtpv1Header), pktlen), return STATUS_ERROR,
-        "Packet length is not enough");
-
-    Sock *sock = &Self()->upSock;
-    sock->remoteAddr._family= AF_INET;
-    sock->remoteAddr.s4.sin_addr.s_addr = remoteIP;
-    sock->remoteAddr._port = _remotePort;
-
-    Status status = STATUS_OK;
-    Gtpv1Header *gtpHdr = (Gtpv1Header *) (pkt + hdrlen);
-    switch (gtpHdr->type) {
-        case GTPV1_T_PDU: // Should be the first to speed up UP packet matching
-            status = FindPDRByTEID(pkt, pktlen, sizeof(IPv4Header) + sizeof(UDPHeader), matchRule);
-            return (status == STATUS_OK ? 0 : -1);
-        case GTPV1_ECHO_REQUEST:
-            status = GtpHandleEchoRequest(sock, gtpHdr);
-            break;
-        case GTPV1_ECHO_RESPONSE:
-            status = GtpHandleEchoResponse(gtpHdr);
-            break;
-        case GTPV1_ERROR_INDICATION:
-            // TODO: Implement it if we need it
-            break;
-        case GTPV1_END_MARK:
-            // TODO : Need to deal with the UE packet that does not have tunnel yet
-            status = GtpHandleEndMark(sock, gtpHdr);
-            break;
-        default :
-            UTLT_Debug("This type[%d] of GTPv1 header does not implement yet", gtpHdr->type);
+    MatchRuleNode *matchRule = MatchRuleGroupClassify(IPv4HList, key.daddr, &key);
+    // Rules without destination are grouped in key 0
+    if (key.daddr) {
+        MatchRuleNode *anyDstRule = MatchRuleGroupClassify(IPv4HList, 0, &key);
+        if (anyDstRule && (!matchRule || anyDstRule->precedence < matchRule->precedence))
+            matchRule = anyDstRule;
     }
 
-    return (status == STATUS_OK ? 1 : -1);
+    return (matchRule ? &matchRule->pdrView : NULL);
 }
 
-static int PacketInBufferHandle(uint8_t *pkt, uint16_t pktlen, UPDK_PDR *matchedPDR) {
+/*
+ * Call it in the RCU read-side critical section where @matchedPDR is found,
+ * so the FAR linked to it is still there. Nothing here waits for N4 workers,
+ * which may be waiting for a grace period.
+ */
+static int PacketInBufferHandle(uint8_t *pkt, uint16_t pktlen, const UPDK_PDRView *matchedPDR) {
     Status status;
-    uint8_t action;
-    uint32_t farId = ((UPDK_PDR *) matchedPDR)->farId;
-    
-    UTLT_Assert(HowToHandleThisPacket(farId, &action) == STATUS_OK, return -1,
-        "FAR[%u] does not existed", farId);
+    const UPDK_FAR *far = RcuDereference(matchedPDR->far);
+
+    UTLT_Assert(far, return -1, "FAR[%u] does not existed", matchedPDR->farId);
+    uint8_t action = far->applyAction;
 
     if (action & PFCP_FAR_APPLY_ACTION_BUFF) {
-        uint32_t pdrId = ((UPDK_PDR *) matchedPDR)->pdrId;
-        UpfBufPacket *packetStorage = UpfBufPacketFindByPdrId(pdrId);
+        uint32_t pdrId = matchedPDR->pdrId;
+        UpfBufPacket *packetStorage = UpfBufPacketFindByPdrId(matchedPDR->seid, pdrId);
         UTLT_Assert(packetStorage, return -1, "Cannot find matching PDR ID buffer slot");
 
         // protect data write with spinlock
@@ -398,25 +463,30 @@ static int PacketInBufferHandle(uint8_t *pkt, uint16_t pktlen, UPDK_PDR *matched
             // if packetBuffer null, allocate space
             // reuse the pktbuf, so don't free it
             packetStorage->packetBuffer = BufblkAlloc(1, MAX_SIZE_OF_PACKET);
-            UTLT_Assert(packetStorage->packetBuffer, return -1, "UpfBufPacket alloc failed");
+            UTLT_Assert(packetStorage->packetBuffer, status = STATUS_ERROR; goto UNLOCK,
+                        "UpfBufPacket alloc failed");
         }
 
         // if packetBuffer not null, just add packet followed
         status = BufblkBytes(packetStorage->packetBuffer, (const char *) pkt, pktlen);
-        UTLT_Assert(status == STATUS_OK, return -1,
+        UTLT_Assert(status == STATUS_OK, goto UNLOCK,
                     "block add behand old buffer error");
 
+UNLOCK:
+        // The caller is in read-side critical section, so the lock must not be left held
         while (pthread_spin_unlock(&Self()->buffLock)) {
             // if unlock failed, keep trying
             UTLT_Error("spin unlock error");
         }
+        if (status != STATUS_OK)
+            return -1;
 
         if (action & PFCP_FAR_APPLY_ACTION_NOCP) {
             // If NOCP, Send event to notify SMF
             uint64_t seid = ((UpfSession*) packetStorage->sessionPtr)->upfSeid;
             UTLT_Debug("buffer NOCP to SMF: SEID: %u, PDRID: %u", seid, pdrId);
-            status = EventSend(Self()->eventQ, UPF_EVENT_SESSION_REPORT, 2,
-                            seid, pdrId);
+            status = EventTrySend(UpfN4WorkerQueue(seid), UPF_EVENT_SESSION_REPORT, 2,
+                                  seid, pdrId);
             UTLT_Assert(status == STATUS_OK, ,
                         "DL data message event send to N4 failed");
         }
@@ -427,9 +497,54 @@ static int PacketInBufferHandle(uint8_t *pkt, uint16_t pktlen, UPDK_PDR *matched
     return 0;
 }
 
+static int PacketInGTPUHandle(uint8_t *pkt, uint16_t pktlen, uint16_t hdrlen, uint32_t remoteIP, uint16_t _remotePort, UPDK_PDRView *matchedPDR) {
+    UTLT_Assert(PacketLenIsEnough(hdrlen + sizeof(Gtpv1Header), pktlen), return STATUS_ERROR,
+        "Packet length is not enough");
+
+    // Receivers of UPDK may run in parallel, so the peer is set on a copy of upSock
+    Sock upSock = Self()->upSock;
+    Sock *sock = &upSock;
+    sock->remoteAddr._family= AF_INET;
+    sock->remoteAddr.s4.sin_addr.s_addr = remoteIP;
+    sock->remoteAddr._port = _remotePort;
+
+    Status status = STATUS_OK;
+    int handled = -1;
+    const UPDK_PDRView *pdrView;
+    Gtpv1Header *gtpHdr = (Gtpv1Header *) (pkt + hdrlen);
+    switch (gtpHdr->type) {
+        case GTPV1_T_PDU: // Should be the first to speed up UP packet matching
+            RcuReadLock();
+            pdrView = FindPDRByTEID(pkt, pktlen, hdrlen);
+            if (pdrView) {
+                *matchedPDR = *pdrView;
+                handled = PacketInBufferHandle(pkt, pktlen, pdrView);
+            }
+            RcuReadUnlock();
+            return handled;
+        case GTPV1_ECHO_REQUEST:
+            status = GtpHandleEchoRequest(sock, gtpHdr);
+            break;
+        case GTPV1_ECHO_RESPONSE:
+            status = GtpHandleEchoResponse(gtpHdr);
+            break;
+        case GTPV1_ERROR_INDICATION:
+            // TODO: Implement it if we need it
+            break;
+        case GTPV1_END_MARK:
+            // TODO : Need to deal with the UE packet that does not have tunnel yet
+            status = GtpHandleEndMark(sock, gtpHdr);
+            break;
+        default :
+            UTLT_Debug("This type[%d] of GTPv1 header does not implement yet", gtpHdr->type);
+    }
+
+    return (status == STATUS_OK ? 1 : -1);
+}
+
 int PacketInWithL3(uint8_t *pkt, uint16_t pktlen, void *matchedPDR) {
     UTLT_Assert(pkt && pktlen >= 0, goto MATCHFAILED, "Packet and its length should not be NULL and 0");
-    UTLT_Assert(matchedPDR, goto MATCHFAILED, "The space to store UPDK_PDR should not be NULL");
+    UTLT_Assert(matchedPDR, goto MATCHFAILED, "The space to store UPDK_PDRView should not be NULL");
 
     int status;
 
@@ -442,13 +557,18 @@ int PacketInWithL3(uint8_t *pkt, uint16_t pktlen, void *matchedPDR) {
     if (status) { // GTP-U Packet
         status = PacketInGTPUHandle(pkt, pktlen, sizeof(IPv4Header) + sizeof(UDPHeader), iph->saddr, udpHdr->source, matchedPDR);
         UTLT_Level_Assert(LOG_DEBUG, status != -1, goto MATCHFAILED, "Packet match with GTP-U header failed");
-        if (status) return 1; // Non T-PDU packet
     } else { // General L3 Packet
-        status = FindPDRByUEIP(pkt, pktlen, 0, matchedPDR);
-        UTLT_Level_Assert(LOG_DEBUG, status == STATUS_OK, goto MATCHFAILED, "Packet match with L3/L4 header failed");
+        RcuReadLock();
+        const UPDK_PDRView *pdrView = FindPDRByUEIP(pkt, pktlen, 0);
+        if (pdrView) {
+            *((UPDK_PDRView *) matchedPDR) = *pdrView;
+            status = PacketInBufferHandle(pkt, pktlen, pdrView);
+        }
+        RcuReadUnlock();
+        UTLT_Level_Assert(LOG_DEBUG, pdrView, goto MATCHFAILED, "Packet match with L3/L4 header failed");
     }
 
-    return PacketInBufferHandle(pkt, pktlen, matchedPDR);
+    return status;
 
 MATCHFAILED:
     return -1;
@@ -457,66 +577,60 @@ MATCHFAILED:
 int PacketInWithGTPU(uint8_t *pkt, uint16_t pktlen, uint32_t remoteIP, uint16_t _remotePort, void *matchedPDR) {
     UTLT_Assert(pkt && pktlen >= 0, goto MATCHFAILED, "Packet and its length should not be NULL and 0");
     UTLT_Assert(remoteIP && _remotePort, goto MATCHFAILED, "Remote IP and port should not be 0");
-    UTLT_Assert(matchedPDR, goto MATCHFAILED, "The space to store UPDK_PDR should not be NULL");
+    UTLT_Assert(matchedPDR, goto MATCHFAILED, "The space to store UPDK_PDRView should not be NULL");
 
     UTLT_Level_Assert(LOG_DEBUG, CheckGTPUVersion(pkt, pktlen, 0) == 1, goto MATCHFAILED, "Packet GTP version error");
 
     int status = PacketInGTPUHandle(pkt, pktlen, 0, remoteIP, _remotePort, matchedPDR);
     UTLT_Level_Assert(LOG_DEBUG, status != -1, goto MATCHFAILED, "Packet match with GTP-U header failed");
-    if (status) return 1; // Non T-PDU packet
 
-    return PacketInBufferHandle(pkt, pktlen, matchedPDR);
+    return status;
 
 MATCHFAILED:
     return -1;
 }
 
-// Copy from libgtp5gnl
-static inline uint32_t *port_list_create(char *port_list) {
-    uint32_t *ret = calloc(0xff, sizeof(uint32_t));
-    uint32_t port1, port2, cnt = 0;
-
-    char *tok_ptr = strtok(port_list, ","), *chr_ptr;
-    while (tok_ptr != NULL)  {
-        chr_ptr = strchr(tok_ptr, '-');
-        if (chr_ptr) {
-            *chr_ptr = '\0'; port1 = atoi(tok_ptr); port2 = atoi(chr_ptr + 1);
-            if (port1 <= port2)
-                ret[++cnt] = port1 + (port2 << 16);
+static Status MatchRuleIPFilterAddrApply(const IPFilterAddr *filterAddr, const char *name,
+                                         uint32_t *addr, uint32_t *mask, int *portNum, uint32_t *portList) {
+    uint32_t filterMask;
+
+    switch (filterAddr->type) {
+        case IPFILTER_ADDR_ANY:
+            break;
+        case IPFILTER_ADDR_ASSIGNED:
+            // UE IP in PDI has been filled if there is one
+            break;
+        case IPFILTER_ADDR_IPV4:
+            filterMask = IPFilterIPv4Mask(filterAddr->prefixLen);
+            if (!*addr) {
+                *addr = filterAddr->ipv4.s_addr;
+                *mask = filterMask;
+            }
             else
-                ret[++cnt] = port2 + (port1 << 16);
-        }
-        else {
-            port1 = atoi(tok_ptr);
-            ret[++cnt] = port1 + (port1 << 16);
-        }
-        tok_ptr = strtok(NULL, ",");
+                UTLT_Assert(IPv4Match(*addr, filterAddr->ipv4.s_addr, filterMask), return STATUS_ERROR,
+                    "SDF filter description %s ip["IPv4To4uFormatString"] with mask["IPv4To4uFormatString"] is conflict to UE IP["IPv4To4uFormatString"]",
+                    name, IPv4To4uFormatArg(filterAddr->ipv4.s_addr), IPv4To4uFormatArg(filterMask), IPv4To4uFormatArg(*addr));
+            break;
+        default:
+            UTLT_Error("SDF filter description %s ip do NOT support IPv6 yet", name);
+            return STATUS_ERROR;
     }
-    ret[0] = cnt;
 
-    return ret;
-}
+    *portNum = filterAddr->portNum;
+    memcpy(portList, filterAddr->portList, sizeof(uint32_t) * filterAddr->portNum);
 
-// Copy from libgtp5gnl
-static inline uint32_t decimal_to_netmask(uint32_t mask) {
-    uint32_t ret = 0, one_block;
-    for (int i = 0; i < 4 && mask > 0; i++, mask -= 8) {
-        one_block = (mask >= 8 ? 8 : mask);
-        ret += (((1 << one_block) - 1) << (8 - one_block)) << (i * 8);
-    }
-    return ret;
+    return STATUS_OK;
 }
 
 Status MatchRuleCompile(UPDK_PDR *pdr, MatchRuleNode *matchRule) {
     UTLT_Assert(pdr && matchRule, return STATUS_ERROR, "PDR or MatchRuleNode should not be NULL");
 
-    uint32_t ipv4NetType;
-
     // Clean up MatchRuleNode
     MatchRuleDelete(matchRule);
     memset(matchRule, 0, sizeof(MatchRuleNode));
 
     matchRule->precedence = pdr->precedence;
+    UPDK_PDRViewFill(&matchRule->pdrView, pdr);
     
     if (pdr->flags.pdi) {
         UPDK_PDI *pdi = &pdr->pdi;
@@ -567,146 +681,21 @@ Status MatchRuleCompile(UPDK_PDR *pdr, MatchRuleNode *matchRule) {
             UPDK_SDFFilter *sdfFilter = &pdi->sdfFilter;
 
             if (sdfFilter->flags.fd && sdfFilter->lenOfFlowDescription) {
-                char *ruleStr = sdfFilter->flowDescription;
-                ruleStr[sdfFilter->lenOfFlowDescription] = 0;
-
-                // Copy from libgtp5gnl
-                char reg_act[] = "(permit)";
-                char reg_direction[] = "(in|out)";
-                char reg_proto[] = "(ip|[0-9]{1,3})";
-                char reg_src_ip_mask[] = "(any|assigned|[0-9]{1,3}\\.[0-9]{1,3}\\.[0-9]{1,3}\\.[0-9]{1,3}(/[0-9]{1,2})?)";
-                char reg_dest_ip_mask[] = "(any|assigned|[0-9]{1,3}\\.[0-9]{1,3}\\.[0-9]{1,3}\\.[0-9]{1,3}(/[0-9]{1,2})?)";
-                char reg_port[] = "([ ][0-9]{1,5}([,-][0-9]{1,5})*)?";
-
-                char reg[0xfff];
-                sprintf(reg, "^%s %s %s from %s%s to %s%s$", reg_act, reg_direction, reg_proto,
-                    reg_src_ip_mask, reg_port,
-                    reg_dest_ip_mask, reg_port);
-
-                regex_t preg;
-                regmatch_t pmatch[0x10];
-                int nmatch = sizeof(pmatch) / sizeof(regmatch_t);
-                int cflags = REG_EXTENDED | REG_ICASE;
-
-                UTLT_Assert(!regcomp(&preg, reg, cflags), return STATUS_ERROR,
-                    "Regex string for SDF filter description format error");
-
-                UTLT_Assert(!regexec(&preg, ruleStr, nmatch, pmatch, 0), return STATUS_ERROR,
-                    "SDF filter description format error");
-
-                int len;
-                char buf[0xff];
-
-                // Get Action
-                len = pmatch[1].rm_eo - pmatch[1].rm_so;
-                strncpy(buf, ruleStr + pmatch[1].rm_so, len); buf[len] = '\0';
-                UTLT_Assert(!strcmp(buf, "permit"), return STATUS_ERROR,
-                    "SDF filter description action only support 'permit', not support '%s'", buf);
-                
-                // Get Direction
-                len = pmatch[2].rm_eo - pmatch[2].rm_so;
-                strncpy(buf, ruleStr + pmatch[2].rm_so, len); buf[len] = '\0';
-                if (strcmp(buf, "in") == 0) {
-                    // TODO: Handle something here if need
-                }
-                else if (strcmp(buf, "out") == 0) {
-                    // TODO: Handle something here if need
-                }
-                else {
-                    UTLT_Error("SDF filter description direction not support '%s'", buf);
-                    return STATUS_ERROR;
-                }
-
-                // Get Protocol
-                len = pmatch[3].rm_eo - pmatch[3].rm_so;
-                strncpy(buf, ruleStr + pmatch[3].rm_so, len); buf[len] = '\0';
-                if (strcmp(buf, "ip") == 0)
-                    matchRule->proto = 0;
-                else {
-                    int tmp = atoi(buf);
-                    UTLT_Assert(tmp <= 0xff, return STATUS_ERROR,
-                        "SDF filter description protocol[%s] not support", buf);
-
-                    // TODO: Need to check if any value in this field
-                    matchRule->proto = tmp;
-                }
-
-                // Get SRC Mask
-                len = pmatch[5].rm_eo - pmatch[5].rm_so;
-                if (len) {
-                    strncpy(buf, ruleStr + pmatch[5].rm_so + 1, len - 1); buf[len - 1] = '\0';
-                    int smask = atoi(buf);
-                    UTLT_Assert(smask <= 32 && smask > 0, return STATUS_ERROR,
-                        "SDF filter description SRC mask[%s] is invalid", smask);
-
-                    // TODO: Need to check if any value in this field
-                    matchRule->smask = decimal_to_netmask(smask);
-                }
-
-                // Get SRC IP
-                len = pmatch[4].rm_eo - pmatch[4].rm_so - len;
-                strncpy(buf, ruleStr + pmatch[4].rm_so, len); buf[len] = '\0';
-                // TODO: Need to check if any value in this field
-                if (strcmp(buf, "assigned") == 0) {
-                    UTLT_Error("SDF filter description src ip do NOT use assigned");
-                    return STATUS_ERROR;
-                }
-                else {
-                    UTLT_Assert(inet_pton(AF_INET, buf, &ipv4NetType) == 1, return STATUS_ERROR,
-                        "SDF filter description src ip[%s] is invalid", buf);
-                    if (!matchRule->saddr)
-                        matchRule->saddr = ipv4NetType;
-                    else
-                        UTLT_Assert(IPv4Match(matchRule->saddr, ipv4NetType, matchRule->smask), return STATUS_ERROR,
-                                "SDF filter description src ip["IPv4To4uFormatString"] with mask["IPv4To4uFormatString"] is conflict to UE IP["IPv4To4uFormatString"]",
-                                IPv4To4uFormatArg(ipv4NetType), IPv4To4uFormatArg(matchRule->smask), IPv4To4uFormatArg(matchRule->saddr));
-                }
-
-                // Get SRC Port
-                len = pmatch[6].rm_eo - pmatch[6].rm_so;
-                if (len) {
-                    strncpy(buf, ruleStr + pmatch[6].rm_so + 1, len - 1); buf[len - 1] = '\0';
-                    matchRule->sport_list = port_list_create(buf);
-                }
-
-                // Get Dest Mask
-                len = pmatch[9].rm_eo - pmatch[9].rm_so;
-                if (len) {
-                    strncpy(buf, ruleStr + pmatch[9].rm_so + 1, len - 1); buf[len - 1] = '\0';
-                    int dmask = atoi(buf);
-                    UTLT_Assert(dmask <= 32 && dmask > 0, return STATUS_ERROR,
-		                "SDF filter description Dest mask[%s] is invalid", dmask);
-                    
-                    // TODO: Need to check if any value in this field
-                    matchRule->dmask = decimal_to_netmask(dmask);
-                }
-
-                // Get Dest IP
-                len = pmatch[8].rm_eo - pmatch[8].rm_so - len;
-                strncpy(buf, ruleStr + pmatch[8].rm_so, len); buf[len] = '\0';
-                // TODO: Need to check if any value in this field
-                if (strcmp(buf, "assigned") == 0) {
-                    UTLT_Error("SDF filter description dest ip do NOT use assigned");
-                    return STATUS_ERROR;
-                }
-                else {
-                    UTLT_Assert(inet_pton(AF_INET, buf, &ipv4NetType) == 1, return STATUS_ERROR,
-                        "SDF filter description dest ip[%s] is invalid", buf);
-                    if (!matchRule->daddr)
-                        matchRule->daddr = ipv4NetType;
-                    else
-                        UTLT_Assert(IPv4Match(matchRule->daddr, ipv4NetType, matchRule->dmask), return STATUS_ERROR,
-                                "SDF filter description dest ip["IPv4To4uFormatString"] with mask["IPv4To4uFormatString"] is conflict to UE IP["IPv4To4uFormatString"]",
-                                IPv4To4uFormatArg(ipv4NetType), IPv4To4uFormatArg(matchRule->dmask), IPv4To4uFormatArg(matchRule->daddr));
-                }
-
-                // Get Dest Port
-                len = pmatch[10].rm_eo - pmatch[10].rm_so;
-                if (len) {
-                    strncpy(buf, ruleStr + pmatch[10].rm_so + 1, len - 1); buf[len - 1] = '\0';
-                    matchRule->dport_list = port_list_create(buf);
-                }
+                IPFilterRule ipFilter;
+
+                UTLT_Assert(IPFilterRuleParse(&ipFilter, sdfFilter->flowDescription, sdfFilter->lenOfFlowDescription) == STATUS_OK,
+                    return STATUS_ERROR, "SDF filter description[%.*s] format error",
+                    sdfFilter->lenOfFlowDescription, sdfFilter->flowDescription);
+
+                // TODO: Handle direction if need
+                matchRule->proto = ipFilter.proto;
 
+                UTLT_Assert(MatchRuleIPFilterAddrApply(&ipFilter.src, "src", &matchRule->saddr, &matchRule->smask,
+                    &matchRule->sport_num, matchRule->sport_list) == STATUS_OK, return STATUS_ERROR,
+                    "SDF filter description src part is invalid");
+                UTLT_Assert(MatchRuleIPFilterAddrApply(&ipFilter.dst, "dest", &matchRule->daddr, &matchRule->dmask,
+                    &matchRule->dport_num, matchRule->dport_list) == STATUS_OK, return STATUS_ERROR,
+                    "SDF filter description dest part is invalid");
             }
 
             // TODO: Add if need other part
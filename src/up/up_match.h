@@ -5,10 +5,12 @@
 
 #include "utlt_debug.h"
 #include "utlt_list.h"
+#include "utlt_classifier.h"
+#include "utlt_ipfilter.h"
 #include "updk/rule_pdr.h"
 
 typedef struct {
-    ListHead node;
+    ListHead node;  // In the rule list of its TEID or UE IP group
 
     // GTP-U
     uint32_t precedence;
@@ -19,20 +21,21 @@ typedef struct {
     uint32_t saddr, smask;
     uint32_t daddr, dmask;
 
-    // L4 header
+    // L4 header, each port range is packed as (start << 16 | end)
     int sport_num;
-    uint32_t *sport_list;
+    uint32_t sport_list[MAX_NUM_OF_IPFILTER_PORT];
     int dport_num;
-    uint32_t *dport_list;
+    uint32_t dport_list[MAX_NUM_OF_IPFILTER_PORT];
 
-    // Result Only pointer, no any alloc
+    // Result of matching, copied from PDR when compiling
+    UPDK_PDRView pdrView;
+
+    // Cold part, only used by control plane, no any alloc
     UPDK_PDR *pdr;
 } MatchRuleNode;
 
-#define PortStart(__u32) ((__u32) >> 16)
-#define PortEnd(__u32) ((__u32) & 0xFFFF)
-
-Status MatchInit();
+// Match rules are taken on demand up to @capacity, @flags is for IndexPoolInit()
+Status MatchInit(uint32_t capacity, uint32_t flags);
 
 Status MatchTerm();
 
@@ -46,16 +49,31 @@ Status MatchRuleRegister(MatchRuleNode *matchRule);
 
 Status MatchRuleDeregister(MatchRuleNode *matchRule);
 
-Status FindPDRByTEID(uint8_t *pkt, uint16_t pktlen, uint32_t hdrlen, void *pdrBuf);
+/**
+ * FindPDRByTEID - Find the PDR matching a GTP-U packet
+ *
+ * Call it in RCU read-side critical section
+ *
+ * @pkt: packet pointer
+ * @pktlen: total length of @pkt
+ * @hdrlen: offset of GTP-U header in @pkt
+ * @return: view of the matched PDR which is valid until RcuReadUnlock, or NULL if do NOT match any rule
+ */
+const UPDK_PDRView *FindPDRByTEID(uint8_t *pkt, uint16_t pktlen, uint32_t hdrlen);
 
-Status FindPDRByUEIP(uint8_t *pkt, uint16_t pktlen, uint32_t hdrlen, void *pdrBuf);
+/**
+ * FindPDRByUEIP - Find the PDR matching a L3 packet, the same as FindPDRByTEID
+ *
+ * @hdrlen: offset of L3 header in @pkt
+ */
+const UPDK_PDRView *FindPDRByUEIP(uint8_t *pkt, uint16_t pktlen, uint32_t hdrlen);
 
 /**
  * PacketInWithL3 - Find the matched rule, handle the L3 packet and return the rule
  * 
  * @pkt: L3 packet pointer 
  * @pktlen: Total length of @pkt
- * @matchedPDR: A allocated space used to store matched rule
+ * @matchedPDR: A allocated UPDK_PDRView used to store matched rule
  * @return: 1 if packet is handled by UPF, 0 if find any matched rule or -1 if do NOT match any rule
  */
 int PacketInWithL3(uint8_t *pkt, uint16_t pktlen, void *matchedPDR);
@@ -67,7 +85,7 @@ int PacketInWithL3(uint8_t *pkt, uint16_t pktlen, void *matchedPDR);
  * @pktlen: Total length of @pkt
  * @remoteIP: Sender IPv4 address with network type
  * @_remotePort: Sender port with network type 
- * @matchedPDR: A allocated space used to store matched rule
+ * @matchedPDR: A allocated UPDK_PDRView used to store matched rule
  * @return: 1 if packet is handled by UPF, 0 if find any matched rule or -1 if do NOT match any rule
  */
 int PacketInWithGTPU(uint8_t *pkt, uint16_t pktlen, uint32_t remoteIP, uint16_t _remotePort, void *matchedPDR);
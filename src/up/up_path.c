@@ -92,40 +92,34 @@ Status GtpHandleEchoRequest(Sock *sock, void *data) {
 
     Status status = STATUS_OK;
 
-    // Build the Echo Response packet
-    Gtpv1Header gtpRespHrd = {
-        .flags = 0x30 + (gtpHdr->flags & 0x03),
-        .type = GTPV1_ECHO_RESPONSE,
-    };
-
-    Bufblk *optPkt = BufblkAlloc(1, 0x40);
-    if (gtpRespHrd.flags & 0x03) {
+    // Build the Echo Response packet on stack, which is header, optional header and Recovery IE
+    uint8_t pkt[GTPV1_HEADER_LEN + GTPV1_OPT_HEADER_LEN + 2];
+    int len = GTPV1_HEADER_LEN;
+
+    Gtpv1Header *gtpRespHrd = (Gtpv1Header *) pkt;
+    gtpRespHrd->flags = 0x30 + (gtpHdr->flags & 0x03);
+    gtpRespHrd->type = GTPV1_ECHO_RESPONSE;
+    gtpRespHrd->_teid = 0;
+
+    if (gtpRespHrd->flags & 0x03) {
         Gtpv1OptHeader *opthrd = (void *)((uint8_t *) data + GTPV1_HEADER_LEN);
         Gtpv1OptHeader gtpOptHrd = {
-            ._seqNum = (gtpRespHrd.flags & 0x02) ? htons(ntohs(opthrd->_seqNum)) : 0,
-            .nPdnNum = (gtpRespHrd.flags & 0x01) ? opthrd->nPdnNum : 0,
+            ._seqNum = (gtpRespHrd->flags & 0x02) ? opthrd->_seqNum : 0,
+            .nPdnNum = (gtpRespHrd->flags & 0x01) ? opthrd->nPdnNum : 0,
         };
-        BufblkBytes(optPkt, (void *) &gtpOptHrd, sizeof(gtpOptHrd));
+        memcpy(pkt + len, &gtpOptHrd, sizeof(gtpOptHrd));
+        len += sizeof(gtpOptHrd);
     }
 
     /* Recover IE */
-    uint8_t recoverType = 14, recoverCnt = 0;
-    BufblkBytes(optPkt, (void *) &recoverType, 1);
-    BufblkBytes(optPkt, (void *) &recoverCnt, 1);
-
-    gtpRespHrd._length = htons(optPkt->len);
+    pkt[len++] = 14;
+    pkt[len++] = 0;
 
-    Bufblk *pkt = BufblkAlloc(1, 0x40);
-    BufblkBytes(pkt, (void *) &gtpRespHrd, GTPV1_HEADER_LEN);
-    BufblkBuf(pkt, optPkt);
+    gtpRespHrd->_length = htons(len - GTPV1_HEADER_LEN);
 
-    BufblkFree(optPkt);
-
-    UTLT_Assert(UdpSendTo(sock, pkt->buf, pkt->len) == STATUS_OK, status = STATUS_ERROR,
+    UTLT_Assert(UdpSendTo(sock, pkt, len) == STATUS_OK, status = STATUS_ERROR,
                 "GTP Send fail");
 
-    BufblkFree(pkt);
-
     return status;
 }
 
@@ -166,6 +160,21 @@ FREEBUFBLK:
     return status;
 }
 
+/*
+ * Packets are buffered back to back, so the length of each one is got from its IP header.
+ * The rest is taken as one packet if it is not IP.
+ */
+static int UpBufPacketLen(const uint8_t *pkt, int len) {
+    int pktLen = len;
+
+    if (len >= 20 && (pkt[0] >> 4) == 4)
+        pktLen = ntohs(((IPv4Header *) pkt)->totalLen);
+    else if (len >= 40 && (pkt[0] >> 4) == 6)
+        pktLen = 40 + ((pkt[4] << 8) | pkt[5]);
+
+    return (pktLen > 0 && pktLen <= len ? pktLen : len);
+}
+
 Status UpSendPacketByPdrFar(UpfPDR *pdr, UpfFAR *far, Sock *sock) {
     UTLT_Assert(pdr, return STATUS_ERROR, "PDR error");
     UTLT_Assert(far, return STATUS_ERROR, "FAR error");
@@ -178,38 +187,55 @@ Status UpSendPacketByPdrFar(UpfPDR *pdr, UpfFAR *far, Sock *sock) {
     UPDK_OuterHeaderCreation *outerHeaderCreation = &far->forwardingParameters.outerHeaderCreation;
 
     if (outerHeaderCreation->description & UPDK_OUTER_HEADER_CREATION_DESCRIPTION_GTPU_UDP_IPV4) {
-        Gtpv1Header gtpHdr = {
-            .flags = 0x30,
-            .type = GTPV1_T_PDU,
-            ._teid = ntohl(outerHeaderCreation->teid),
-        };
-
         uint16_t pdrId = pdr->pdrId;
-        UpfBufPacket *bufStorage = UpfBufPacketFindByPdrId(pdrId);
-        if (bufStorage->packetBuffer) {
-            UTLT_Assert(!pthread_spin_lock(&Self()->buffLock),
-                        return STATUS_ERROR, "spin lock buffLock error");
-
-            Bufblk *sendBuf = BufblkAlloc(1, 0x40);
-            gtpHdr._length = htons(bufStorage->packetBuffer->len);
-            BufblkBytes(sendBuf, (void*)&gtpHdr, GTPV1_HEADER_LEN);
-            BufblkBuf(sendBuf, bufStorage->packetBuffer);
-
-            status = UdpSendTo(sock, sendBuf->buf, sendBuf->len);
-            UTLT_Assert(status == STATUS_OK, return status, "UdpSendTo failed");
-            BufblkClear(sendBuf);
-
-            while (pthread_spin_unlock(&Self()->buffLock)) {
-                // if unlock failed, keep trying
-                UTLT_Error("spin unlock error");
-            }
-            status = BufblkFree(bufStorage->packetBuffer);
-        } else {
+        UpfBufPacket *bufStorage = UpfBufPacketFindByPdrId(pdr->seid, pdrId);
+        UTLT_Assert(bufStorage, return STATUS_ERROR, "Cannot find buffer of PDR ID[%u]", pdrId);
+
+        // Take the buffer away, so the data path buffers new packets in another one
+        UTLT_Assert(!pthread_spin_lock(&Self()->buffLock),
+                    return STATUS_ERROR, "spin lock buffLock error");
+        Bufblk *packetBuffer = bufStorage->packetBuffer;
+        bufStorage->packetBuffer = NULL;
+        while (pthread_spin_unlock(&Self()->buffLock)) {
+            // if unlock failed, keep trying
+            UTLT_Error("spin unlock error");
+        }
+
+        if (!packetBuffer) {
             UTLT_Debug("bufStorage is NULL");
+            return STATUS_OK;
         }
-        UTLT_Assert(status == STATUS_OK, return status,
+
+        // Each buffered packet is sent in its own GTP-U, up to MAX_NUM_OF_UDP_BATCH in one syscall
+        Gtpv1Header gtpHdr[MAX_NUM_OF_UDP_BATCH];
+        UdpBatch *batch = UdpBatchAlloc(MAX_NUM_OF_UDP_BATCH, 0);
+        UTLT_Assert(batch, BufblkFree(packetBuffer); return STATUS_ERROR, "UdpBatchAlloc failed");
+
+        uint8_t *pkt = packetBuffer->buf;
+        int remain = packetBuffer->len, pktLen, num = 0, sent = 0;
+        while (remain > 0) {
+            pktLen = UpBufPacketLen(pkt, remain);
+
+            Gtpv1Header *hdr = &gtpHdr[UdpBatchCount(batch)];
+            hdr->flags = 0x30;
+            hdr->type = GTPV1_T_PDU;
+            hdr->_length = htons(pktLen);
+            hdr->_teid = htonl(outerHeaderCreation->teid);
+            UdpBatchAdd(batch, hdr, GTPV1_HEADER_LEN, pkt, pktLen, &sock->remoteAddr);
+            num++;
+
+            pkt += pktLen;
+            remain -= pktLen;
+            if (UdpBatchFull(batch) || remain <= 0)
+                sent += UdpBatchSend(sock, batch);
+        }
+
+        UdpBatchFree(batch);
+        UTLT_Assert(sent == num, status = STATUS_ERROR,
+                    "%d of %d buffered packets of PDR ID[%u] send failed", num - sent, num, pdrId);
+
+        UTLT_Assert(BufblkFree(packetBuffer) == STATUS_OK, status = STATUS_ERROR,
                     "Free packet buffer failed");
-        bufStorage->packetBuffer = NULL;
     } else {
         UTLT_Warning("outer header creatation not implement: "
                      "GTP-IPV6, IPV4, IPV6");
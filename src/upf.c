@@ -5,9 +5,11 @@
 #include "upf_init.h"
 #include "utlt_debug.h"
 #include "utlt_event.h"
+#include "utlt_rcu.h"
 #include "utlt_network.h"
 #include "upf_context.h"
 #include "n4/n4_dispatcher.h"
+#include "n4/n4_worker.h"
 
 static Status parseArgs(int argc, char *argv[]);
 static Status checkPermission();
@@ -70,20 +72,24 @@ static Status checkPermission() {
 }
 
 
+// Node lane, session messages are handled by N4 workers
 static void eventConsumer() {
-    Status status;
-    Event event;
+    Event event[MAX_NUM_OF_EVENT_BATCH];
+    int num;
 
     while (1) {
-        status = EventRecv(Self()->eventQ, &event);
-        if (status != STATUS_OK) {
-            if (status == STATUS_EAGAIN) {
-                continue;
-            } else {
-                UTLT_Assert(0, break, "Event receive fail");
-            }
+        num = EventTryRecvBatch(Self()->eventQ, event, MAX_NUM_OF_EVENT_BATCH);
+        if (!num) {
+            RcuDeferFlush();
+            // Blocks until there is at least one event
+            num = EventRecvBatch(Self()->eventQ, event, MAX_NUM_OF_EVENT_BATCH);
         }
+        UTLT_Assert(num >= 0, break, "Event receive fail");
 
-        UpfDispatcher(&event);
+        for (int i = 0; i < num; i++)
+            UpfDispatcher(&event[i]);
+
+        // The same as N4 workers, for sessions removed in the node lane
+        RcuDeferPoll();
     }
 }
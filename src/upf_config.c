@@ -1,5 +1,7 @@
 #include "upf_config.h"
 
+#include <stdlib.h>
+#include <stdint.h>
 #include <arpa/inet.h>
 
 #include "upf_context.h"
@@ -7,6 +9,7 @@
 #include "updk/env.h"
 
 static int SetProtocolIter(YamlIter *protoList, YamlIter *protoIter);
+static Status ReadCapacity(const char *key, const char *value, uint32_t *capacity);
 // static Status ReadAddrList(YamlIter *protoIter, const char **hostname, int *num);
 static void DeleteYamlDocument();
 
@@ -89,6 +92,50 @@ Status UpfConfigParse() {
                         // Always fail here
                         UTLT_Assert(UTLT_SetReportCaller(REPORTCALLER_MAX) == STATUS_OK, return STATUS_ERROR, "ReportCaller is invalid");
                     }
+                } else if (!strcmp(upfKey, "n4Worker")) {
+                    const char *n4Worker = YamlIterGet(&upfIter, GET_VALUE);
+                    UTLT_Assert(n4Worker && atoi(n4Worker) >= 0, return STATUS_ERROR,
+                        "n4Worker is invalid");
+                    Self()->n4WorkerNum = atoi(n4Worker);
+                } else if (!strcmp(upfKey, "updkReceiver")) {
+                    const char *updkReceiver = YamlIterGet(&upfIter, GET_VALUE);
+                    UTLT_Assert(updkReceiver && atoi(updkReceiver) >= 0, return STATUS_ERROR,
+                        "updkReceiver is invalid");
+                    Self()->envParams->virtualDevice->receiverNum = atoi(updkReceiver);
+                } else if (!strcmp(upfKey, "pool")) {
+                    YamlIter poolIter;
+                    YamlIterChild(&upfIter, &poolIter);
+                    while (YamlIterNext(&poolIter)) {
+                        const char *poolKey = YamlIterGet(&poolIter, GET_KEY);
+                        const char *value = YamlIterGet(&poolIter, GET_VALUE);
+                        UTLT_Assert(poolKey, return STATUS_ERROR, "The poolKey is NULL");
+
+                        if (!strcmp(poolKey, "session")) {
+                            UTLT_Assert(ReadCapacity(poolKey, value, &Self()->sessionCap) == STATUS_OK,
+                                return STATUS_ERROR, "");
+                        } else if (!strcmp(poolKey, "pdr")) {
+                            UTLT_Assert(ReadCapacity(poolKey, value, &Self()->pdrCap) == STATUS_OK,
+                                return STATUS_ERROR, "");
+                        } else if (!strcmp(poolKey, "far")) {
+                            UTLT_Assert(ReadCapacity(poolKey, value, &Self()->farCap) == STATUS_OK,
+                                return STATUS_ERROR, "");
+                        } else if (!strcmp(poolKey, "qer")) {
+                            UTLT_Assert(ReadCapacity(poolKey, value, &Self()->qerCap) == STATUS_OK,
+                                return STATUS_ERROR, "");
+                        } else if (!strcmp(poolKey, "matchRule")) {
+                            UTLT_Assert(ReadCapacity(poolKey, value, &Self()->matchRuleCap) == STATUS_OK,
+                                return STATUS_ERROR, "");
+                        } else if (!strcmp(poolKey, "pfcpXact")) {
+                            UTLT_Assert(ReadCapacity(poolKey, value, &Self()->pfcpXactCap) == STATUS_OK,
+                                return STATUS_ERROR, "");
+                        } else if (!strcmp(poolKey, "hugePage")) {
+                            UTLT_Assert(value && (!strcmp(value, "true") || !strcmp(value, "false")),
+                                return STATUS_ERROR, "hugePage of pool should be true or false");
+                            Self()->hugePage = !strcmp(value, "true");
+                        } else {
+                            UTLT_Warning("Unknown key \"%s\" of pool", poolKey);
+                        }
+                    }
                 } else if (!strcmp(upfKey, "gtpu")) {
                     YamlIter gtpuList, gtpuIter;
                     YamlIterChild(&upfIter, &gtpuList);
@@ -251,6 +298,19 @@ static int SetProtocolIter(YamlIter *protoList, YamlIter *protoIter) {
     return 0;
 }
 
+static Status ReadCapacity(const char *key, const char *value, uint32_t *capacity) {
+    char *end;
+
+    UTLT_Assert(value, return STATUS_ERROR, "Capacity of %s is empty", key);
+    unsigned long num = strtoul(value, &end, 0);
+    UTLT_Assert(!*end && num > 0 && num <= INT32_MAX, return STATUS_ERROR,
+        "Capacity of %s should be 1 to %d, not %s", key, INT32_MAX, value);
+
+    *capacity = num;
+
+    return STATUS_OK;
+}
+
 /* static Status ReadAddrList(YamlIter *protoIter, const char **hostname, int *num) {
     YamlIter hostnameIter;
     YamlIterChild(protoIter, &hostnameIter);
@@ -14,6 +14,8 @@
 #include "utlt_pool.h"
 #include "utlt_index.h"
 #include "utlt_hash.h"
+#include "utlt_rcu.h"
+#include "utlt_swisstable.h"
 #include "utlt_network.h"
 #include "utlt_netheader.h"
 
@@ -22,6 +24,7 @@
 #include "pfcp_xact.h"
 
 #include "up/up_match.h"
+#include "n4/n4_worker.h"
 
 #include "updk/env.h"
 #include "updk/init.h"
@@ -32,44 +35,40 @@
 
 #define MAX_NUM_OF_SUBNET       16
 
-IndexDeclare(upfSessionPool, UpfSession, MAX_POOL_OF_SESS);
+IndexDeclare(upfSessionPool, UpfSession);
 
-#define MAX_NUM_OF_UPF_PDR_NODE (MAX_POOL_OF_BEARER * 2)
-#define MAX_NUM_OF_UPF_FAR_NODE MAX_NUM_OF_UPF_PDR_NODE
-#define MAX_NUM_OF_UPF_QER_NODE (MAX_POOL_OF_SESS * 2)
-#define MAX_NUM_OF_UPF_BAR_NODE (MAX_POOL_OF_UE)
-#define MAX_NUM_OF_UPF_URR_NODE (MAX_POOL_OF_UE)
+// Defaults of capacities, which can be set by config
+#define DEFAULT_NUM_OF_UPF_SESSION  MAX_POOL_OF_SESS
+#define DEFAULT_NUM_OF_UPF_PDR_NODE (MAX_POOL_OF_BEARER * 2)
+#define DEFAULT_NUM_OF_UPF_FAR_NODE DEFAULT_NUM_OF_UPF_PDR_NODE
+#define DEFAULT_NUM_OF_UPF_QER_NODE (MAX_POOL_OF_SESS * 2)
+#define DEFAULT_NUM_OF_MATCH_RULE   DEFAULT_NUM_OF_UPF_PDR_NODE
+#define MAX_NUM_OF_UPF_BAR_NODE     (MAX_POOL_OF_UE)
+#define MAX_NUM_OF_UPF_URR_NODE     (MAX_POOL_OF_UE)
 
-IndexDeclare(upfPDRNodePool, UpfPDRNode, MAX_NUM_OF_UPF_PDR_NODE);
-IndexDeclare(upfFARNodePool, UpfFARNode, MAX_NUM_OF_UPF_FAR_NODE);
-IndexDeclare(upfQERNodePool, UpfQERNode, MAX_NUM_OF_UPF_QER_NODE);
-IndexDeclare(upfBARNodePool, UpfBARNode, MAX_NUM_OF_UPF_BAR_NODE);
-IndexDeclare(upfURRNodePool, UpfURRNode, MAX_NUM_OF_UPF_URR_NODE);
+IndexDeclare(upfPDRNodePool, UpfPDRNode);
+IndexDeclare(upfFARNodePool, UpfFARNode);
+IndexDeclare(upfQERNodePool, UpfQERNode);
+IndexDeclare(upfBARNodePool, UpfBARNode);
+IndexDeclare(upfURRNodePool, UpfURRNode);
 
 /**
- * PDRHash - Store PDRs with Hash struct
+ * PDRTable - Store PDRs of all sessions by UpfRuleKey(), since rule IDs are only unique in a session
+ *
+ * Lookups take no lock in RCU read-side critical section. A node is never
+ * written after it is in the table, it is replaced by a new one and freed
+ * by RcuDefer(). Rules of a session are only written by its owner.
  */
-Hash *PDRHash;
-pthread_mutex_t PDRHashLock;
-Hash *FARHash;
-pthread_mutex_t FARHashLock;
-Hash *QERHash;
-pthread_mutex_t QERHashLock;
-Hash *BARHash;
-pthread_mutex_t BARHashLock;
-Hash *URRHash;
-pthread_mutex_t URRHashLock;
-
-#define Rule_Thread_Safe(__ruleType, expr) \
-    pthread_mutex_lock(&__ruleType##HashLock); \
-    expr; \
-    pthread_mutex_unlock(&__ruleType##HashLock)
-
-#define PDR_Thread_Safe(expr) Rule_Thread_Safe(PDR, expr)
-#define FAR_Thread_Safe(expr) Rule_Thread_Safe(FAR, expr)
-#define QER_Thread_Safe(expr) Rule_Thread_Safe(QER, expr)
-#define BAR_Thread_Safe(expr) Rule_Thread_Safe(BAR, expr)
-#define URR_Thread_Safe(expr) Rule_Thread_Safe(URR, expr)
+SwissTable PDRTable;
+SwissTable FARTable;
+SwissTable QERTable;
+SwissTable BARTable;
+SwissTable URRTable;
+
+// Session index in high 32 bits and rule ID in low 32 bits
+#define UpfRuleKey(__sessIndex, __id) (((uint64_t) (uint32_t) (__sessIndex) << 32) | (uint32_t) (__id))
+#define UpfRuleKeyId(__key) ((uint32_t) (__key))
+#define UpfRuleKeySessIndex(__key) ((uint32_t) ((__key) >> 32))
 
 static UpfContext self;
 static _Bool upfContextInitialized = 0;
@@ -78,10 +77,11 @@ UpfContext *Self() {
     return &self;
 }
 
-#define RuleInit(__ruleType) do { \
-    IndexInit(&upf##__ruleType##NodePool, MAX_NUM_OF_UPF_##__ruleType##_NODE); \
-    __ruleType##Hash = HashMake(); \
-    pthread_mutex_init(&__ruleType##HashLock, 0); \
+#define RuleInit(__ruleType, __cap, __flags) do { \
+    UTLT_Assert(IndexPoolInit(&upf##__ruleType##NodePool, __cap, __flags) == STATUS_OK, \
+        return STATUS_ERROR, "upf"#__ruleType"NodePool init failed"); \
+    UTLT_Assert(SwissTableInitOf(&__ruleType##Table, __cap, Upf##__ruleType##Node, key) == STATUS_OK, \
+        return STATUS_ERROR, #__ruleType"Table init failed"); \
 } while (0)
 
 Status UpfContextInit() {
@@ -127,23 +127,18 @@ Status UpfContextInit() {
     self.gtpv1Port = GTPV1_U_UDP_PORT;
     self.pfcpPort = PFCP_UDP_PORT;
     strcpy(self.envParams->virtualDevice->deviceID, self.gtpDevNamePrefix);
-
-    // Init Resource
-    IndexInit(&upfSessionPool, MAX_POOL_OF_SESS);
-    RuleInit(PDR);
-    RuleInit(FAR);
-    RuleInit(QER);
-    RuleInit(BAR);
-    RuleInit(URR);
-    MatchInit();
+    self.sessionCap = DEFAULT_NUM_OF_UPF_SESSION;
+    self.pdrCap = DEFAULT_NUM_OF_UPF_PDR_NODE;
+    self.farCap = DEFAULT_NUM_OF_UPF_FAR_NODE;
+    self.qerCap = DEFAULT_NUM_OF_UPF_QER_NODE;
+    self.matchRuleCap = DEFAULT_NUM_OF_MATCH_RULE;
 
     PfcpNodeInit(); // init pfcp node for upfN4List (it will used pfcp node)
     TimerListInit(&self.timerServiceList);
 
     // TODO: Read from config
     strncpy(self.buffSockPath, "/tmp/free5gc_unix_sock", MAX_SOCK_PATH_LEN);
-    self.sessionHash = HashMake();
-    self.bufPacketHash = HashMake();
+    pthread_mutex_init(&self.sessionLock, 0);
     // spin lock protect write data instead of mutex protect code block
     int ret = pthread_spin_init(&self.buffLock, PTHREAD_PROCESS_PRIVATE);
     UTLT_Assert(ret == 0, , "buffLock cannot create: %s", strerror(ret));
@@ -153,10 +148,35 @@ Status UpfContextInit() {
     return STATUS_OK;
 }
 
+Status UpfResourceInit() {
+    uint32_t flags = (self.hugePage ? INDEX_POOL_HUGEPAGE : 0);
+
+    UTLT_Assert(IndexPoolInit(&upfSessionPool, self.sessionCap, flags) == STATUS_OK,
+        return STATUS_ERROR, "upfSessionPool init failed");
+    RuleInit(PDR, self.pdrCap, flags);
+    RuleInit(FAR, self.farCap, flags);
+    RuleInit(QER, self.qerCap, flags);
+    RuleInit(BAR, MAX_NUM_OF_UPF_BAR_NODE, 0);
+    RuleInit(URR, MAX_NUM_OF_UPF_URR_NODE, 0);
+    UTLT_Assert(MatchInit(self.matchRuleCap, flags) == STATUS_OK, return STATUS_ERROR, "");
+    UTLT_Assert(SwissTableInitOf(&self.bufPacketTable, self.pdrCap, UpfBufPacket, key) == STATUS_OK,
+        return STATUS_ERROR, "bufPacketTable init failed");
+
+    UTLT_Assert(SlotTableInit(&self.sessionTable, self.sessionCap) == STATUS_OK,
+        return STATUS_ERROR, "Session table init failed");
+    UTLT_Assert(SlotIndexInit(&self.sessionIpIndex, self.sessionCap) == STATUS_OK,
+        return STATUS_ERROR, "Session UE IP index init failed");
+
+    UTLT_Info("Capacity of %u sessions, %u PDRs, %u FARs, %u QERs and %u match rules%s",
+        self.sessionCap, self.pdrCap, self.farCap, self.qerCap, self.matchRuleCap,
+        (self.hugePage ? " on hugepages" : ""));
+
+    return STATUS_OK;
+}
+
 #define RuleTerminate(__ruleType) do { \
-    pthread_mutex_destroy(&__ruleType##HashLock); \
+    SwissTableFinal(&__ruleType##Table); \
     IndexTerminate(&upf##__ruleType##NodePool); \
-    HashDestroy(__ruleType##Hash); \
 } while (0)
 
 // TODO : Need to Remove List Members iterativelyatively
@@ -168,20 +188,10 @@ Status UpfContextTerminate() {
 
     int ret = pthread_spin_destroy(&self.buffLock);
     UTLT_Assert(ret == 0, , "buffLock cannot destroy: %s", strerror(ret));
-    UTLT_Assert(self.bufPacketHash, , "Buffer Hash Table missing?!");
-    HashDestroy(self.bufPacketHash);
 
-    UTLT_Assert(self.sessionHash, , "Session Hash Table missing?!");
-    HashDestroy(self.sessionHash);
+    pthread_mutex_destroy(&self.sessionLock);
 
-    // Terminate resource
-    MatchTerm();
-    IndexTerminate(&upfSessionPool);
-    RuleTerminate(PDR);
-    RuleTerminate(FAR);
-    RuleTerminate(QER);
-    RuleTerminate(BAR);
-    RuleTerminate(URR);
+    TimerListTerm(&self.timerServiceList);
 
     PfcpRemoveAllNodes(&self.upfN4List);
     PfcpNodeTerminate();
@@ -192,18 +202,34 @@ Status UpfContextTerminate() {
     // SockNodeListFree(&self.pfcpIPv6List);
     FreeVirtualDevice(self.envParams->virtualDevice);
 
-    UpfBufPacketRemoveAll();
-
     upfContextInitialized = 0;
 
     return status;
 }
 
+Status UpfResourceTerminate() {
+    // Frees deferred by this thread must be done before their pools are gone
+    RcuDeferFlush();
+    UpfBufPacketRemoveAll();
+    SwissTableFinal(&self.bufPacketTable);
+    SlotIndexFinal(&self.sessionIpIndex);
+    SlotTableFinal(&self.sessionTable);
+    MatchTerm();
+    IndexTerminate(&upfSessionPool);
+    RuleTerminate(PDR);
+    RuleTerminate(FAR);
+    RuleTerminate(QER);
+    RuleTerminate(BAR);
+    RuleTerminate(URR);
+
+    return STATUS_OK;
+}
+
 #define RuleNodeAlloc(__ruleType) \
 Upf##__ruleType##Node *Upf##__ruleType##NodeAlloc() { \
     Upf##__ruleType##Node *node = NULL; \
     IndexAlloc(&upf##__ruleType##NodePool, node); \
-    ListHeadInit(&node->node); \
+    if (node) ListHeadInit(&node->node); \
     return node; \
 }
 
@@ -224,20 +250,40 @@ RuleNodeFree(QER);
 RuleNodeFree(BAR);
 RuleNodeFree(URR);
 
+// Callback of RcuDefer(), for the node which readers may still be on
+#define RuleNodeFreeDeferred(__ruleType) \
+static void Upf##__ruleType##NodeFreeDeferred(void *node) { \
+    Upf##__ruleType##NodeFree(node); \
+}
+
+RuleNodeFreeDeferred(PDR);
+RuleNodeFreeDeferred(FAR);
+RuleNodeFreeDeferred(QER);
+
 #define UPF_RULE_ID(__ruleName) __ruleName ## Id
 
-// Do the thread safe to upper layer function
-#define RuleNodeHashSet(__ruleType, __id, __ptr) HashSet(__ruleType##Hash, &(__id), sizeof(__id), (__ptr))
-#define RuleNodeHashGet(__ruleType, __id) HashGet(__ruleType##Hash, &(__id), sizeof(__id))
+/*
+ * Find the node of the session for writers. The table data may be rebuilt by
+ * other sessions, but the node is only freed by the owner of the session.
+ */
+static void *RuleTableGet(SwissTable *table, uint64_t key) {
+    RcuReadLock();
+    void *node = SwissTableGet(table, key);
+    RcuReadUnlock();
+
+    return node;
+}
+
+#define RuleNodeGet(__ruleType, __sessPtr, __id) \
+    RuleTableGet(&__ruleType##Table, UpfRuleKey((__sessPtr)->index, __id))
 
 #define RuleFindByID(__ruleType, __ruleName, __keyType) \
-int Upf##__ruleType##FindByID(__keyType id, void *ruleBuf) { \
-    __ruleType##_Thread_Safe( \
-        Upf##__ruleType##Node *node = RuleNodeHashGet(__ruleType, id); \
-    ); \
-    if (!node) return -1; \
-    memcpy(ruleBuf, &node->__ruleName, sizeof(Upf##__ruleType)); \
-    return 0; \
+int Upf##__ruleType##FindByID(uint64_t seid, __keyType id, void *ruleBuf) { \
+    RcuReadLock(); \
+    Upf##__ruleType##Node *node = SwissTableGet(&__ruleType##Table, UpfRuleKey(UpfSeidIndex(seid), id)); \
+    if (node && ruleBuf) memcpy(ruleBuf, &node->__ruleName, sizeof(Upf##__ruleType)); \
+    RcuReadUnlock(); \
+    return (node ? 0 : -1); \
 }
 
 RuleFindByID(PDR, pdr, uint16_t);
@@ -248,26 +294,30 @@ RuleFindByID(BAR, bar, uint32_t);
 RuleFindByID(URR, urr, uint32_t);
 */
 
-Status HowToHandleThisPacket(uint32_t farID, uint8_t *action) {
+Status HowToHandleThisPacket(uint64_t seid, uint32_t farID, uint8_t *action) {
     Status status = STATUS_OK;
-    FAR_Thread_Safe(
-        UpfFARNode *node = RuleNodeHashGet(FAR, farID);
-        if (!node)
-            status = STATUS_ERROR;
-        else
-            *action = node->far.applyAction;
-    );
+
+    RcuReadLock();
+    UpfFARNode *node = SwissTableGet(&FARTable, UpfRuleKey(UpfSeidIndex(seid), farID));
+    if (!node)
+        status = STATUS_ERROR;
+    else
+        *action = node->far.applyAction;
+    RcuReadUnlock();
+
     return status;
 }
 
 #define RuleDump(__ruleType, __ruleName, __keyType) \
 void Upf##__ruleType##Dump() { \
-    __ruleType##_Thread_Safe( \
-        for (HashIndex *hi = HashFirst(__ruleType ## Hash); hi; hi = HashNext(hi)) { \
-            const __keyType *key = HashThisKey(hi); \
-            UTLT_Info(#__ruleType" ID[%u] does exist", *key); \
-        } \
-     ); \
+    uint32_t pos = 0; \
+    RcuReadLock(); \
+    for (Upf##__ruleType##Node *node = SwissTableNext(&__ruleType##Table, &pos); node; \
+         node = SwissTableNext(&__ruleType##Table, &pos)) { \
+        UTLT_Info(#__ruleType" ID[%u] of session[%u] does exist", \
+            UpfRuleKeyId(node->key), UpfRuleKeySessIndex(node->key)); \
+    } \
+    RcuReadUnlock(); \
 }
 
 RuleDump(PDR, pdr, uint16_t);
@@ -278,39 +328,101 @@ RuleDump(BAR, bar, uint32_t);
 RuleDump(URR, urr, uint32_t);
 */
 
+// Readers may still be on the node, free it by RcuDefer()
+#define RuleDeletionFromSession(__ruleType, __nodePtr) do { \
+    SwissTableDelete(&__ruleType##Table, (__nodePtr)->key); \
+    ListRemove(__nodePtr); \
+} while (0)
+
+// Link FAR and QER of the session to the view of the PDR, so packets are handled without IDs
+static void UpfPDRLink(UpfSession *sess, UpfPDRNode *ruleNode) {
+    if (!ruleNode->matchRule)
+        return;
+
+    UPDK_PDRView *view = &ruleNode->matchRule->pdrView;
+    UpfFARNode *farNode = (view->flags.farId ? RuleNodeGet(FAR, sess, view->farId) : NULL);
+    UpfQERNode *qerNode = (view->flags.qerId && view->qerId[0] ?
+                           RuleNodeGet(QER, sess, view->qerId[0]) : NULL);
+
+    RcuAssignPointer(view->far, (farNode ? &farNode->far : NULL));
+    RcuAssignPointer(view->qer, (qerNode ? &qerNode->qer : NULL));
+}
+
+// Relink all PDRs of the session after its FARs or QERs are changed, before freeing the old ones
+static void UpfSessionPDRLink(UpfSession *sess) {
+    UpfPDRNode *ruleNode, *nextNode = NULL;
+
+    ListForEachSafe(ruleNode, nextNode, &sess->pdrList) {
+        UpfPDRLink(sess, ruleNode);
+    }
+}
+
+static void UpfPDRDeletionFromSession(UpfSession *sess, UpfPDRNode *ruleNode) {
+    RuleDeletionFromSession(PDR, ruleNode);
+
+    if (ruleNode->matchRule) {
+        MatchRuleDeregister(ruleNode->matchRule);
+        MatchRuleNodeFree(ruleNode->matchRule);
+        ruleNode->matchRule = NULL;
+    }
+}
+
 UpfPDRNode *UpfPDRRegisterToSession(UpfSession *sess, UpfPDR *rule) {
     UTLT_Assert(sess && rule, return NULL, "Session or UpfPDR should not be NULL");
     UTLT_Assert(rule->flags.pdrId, return NULL, "PDR ID should be set");
 
+    UpfPDRNode *oldNode = NULL;
+    UpfPDRNode *ruleNode = UpfPDRNodeAlloc();
+    UTLT_Assert(ruleNode, return NULL, "UpfPDRNodeAlloc failed");
+
     MatchRuleNode *newMatchRule = MatchRuleNodeAlloc();
-    UTLT_Assert(newMatchRule, return NULL, "MatchRuleNodeAlloc failed");
+    UTLT_Assert(newMatchRule, goto FREERULENODE, "MatchRuleNodeAlloc failed");
 
-    UTLT_Assert(MatchRuleCompile(rule, newMatchRule) == STATUS_OK, goto FREEMATCHRULENODE,
-        "MatchRuleCompile failed");
+    // An existing PDR is replaced by the new node, so readers never see it half written
+    ruleNode->key = UpfRuleKey(sess->index, rule->pdrId);
+    memcpy(&ruleNode->pdr, rule, sizeof(UpfPDR));
+    ruleNode->pdr.flags.seid = 1;
+    ruleNode->pdr.seid = sess->upfSeid;
 
-    PDR_Thread_Safe(
-        UpfPDRNode *ruleNode = RuleNodeHashGet(PDR, rule->pdrId);
-        if (!ruleNode) {
-            ruleNode = UpfPDRNodeAlloc();
-            UTLT_Assert(ruleNode, goto FREEMATCHRULENODE, "UpfPDENodeAlloc failed");
+    UTLT_Assert(MatchRuleCompile(&ruleNode->pdr, newMatchRule) == STATUS_OK, goto FREEMATCHRULENODE,
+        "MatchRuleCompile failed");
+    ruleNode->matchRule = newMatchRule;
+    newMatchRule->pdr = &ruleNode->pdr;
+    UpfPDRLink(sess, ruleNode);
+
+    UTLT_Assert(SwissTableSet(&PDRTable, ruleNode, (void **) &oldNode) == STATUS_OK,
+        goto FREEMATCHRULENODE, "PDR ID[%u] can NOT be added to PDRTable", rule->pdrId);
+    ListInsert(ruleNode, &sess->pdrList);
+
+    // The new rule is registered before the old one leaves, so packets of the PDR always match
+    UTLT_Assert(MatchRuleRegister(newMatchRule) == STATUS_OK, goto ROLLBACK,
+        "MatchRuleRegister of PDR ID[%u] failed", rule->pdrId);
+
+    if (oldNode) {
+        ListRemove(oldNode);
+        MatchRuleDeregister(oldNode->matchRule);
+        MatchRuleNodeFree(oldNode->matchRule);
+        RcuDefer(UpfPDRNodeFreeDeferred, oldNode);
+    }
 
-            ListInsert(ruleNode, &sess->pdrList);
-        } else {
-            MatchRuleDeregister(ruleNode->matchRule);
-            MatchRuleNodeFree(ruleNode->matchRule);
-        }
-        memcpy(&ruleNode->pdr, rule, sizeof(UpfPDR));
-        ruleNode->matchRule = newMatchRule;
-        newMatchRule->pdr = &ruleNode->pdr;
-        RuleNodeHashSet(PDR, ruleNode->pdr.pdrId, ruleNode);
-    );
+    return ruleNode;
 
-    MatchRuleRegister(newMatchRule);
+ROLLBACK:
+    // Put the old PDR back, replacing the key in place always has room
+    ListRemove(ruleNode);
+    if (oldNode)
+        SwissTableSet(&PDRTable, oldNode, NULL);
+    else
+        SwissTableDelete(&PDRTable, ruleNode->key);
+    MatchRuleNodeFree(newMatchRule);
+    RcuDefer(UpfPDRNodeFreeDeferred, ruleNode);
 
-    return ruleNode;
+    return NULL;
 
 FREEMATCHRULENODE:
     MatchRuleNodeFree(newMatchRule);
+FREERULENODE:
+    UpfPDRNodeFree(ruleNode);
 
     return NULL;
 }
@@ -319,16 +431,22 @@ FREEMATCHRULENODE:
 Upf##__ruleType##Node *Upf##__ruleType##RegisterToSession(UpfSession *sess, Upf##__ruleType *rule) { \
     UTLT_Assert(sess && rule, return NULL, "Session or Upf"#__ruleType" should not be NULL"); \
     UTLT_Assert(rule->flags.UPF_RULE_ID(__ruleName), return NULL, #__ruleType" ID should be set"); \
-    __ruleType##_Thread_Safe( \
-        Upf##__ruleType##Node *ruleNode = RuleNodeHashGet(__ruleType, rule->UPF_RULE_ID(__ruleName)); \
-        if (!ruleNode) { \
-            ruleNode = Upf##__ruleType##NodeAlloc(); \
-            UTLT_Assert(ruleNode, return NULL, "Upf"#__ruleType"NodeAlloc failed"); \
-            ListInsert(ruleNode, &sess->__ruleName##List); \
-        } \
-        memcpy(&ruleNode->__ruleName, rule, sizeof(Upf##__ruleType)); \
-        RuleNodeHashSet(__ruleType, ruleNode->__ruleName.UPF_RULE_ID(__ruleName), ruleNode); \
-    ); \
+    Upf##__ruleType##Node *oldNode = NULL; \
+    Upf##__ruleType##Node *ruleNode = Upf##__ruleType##NodeAlloc(); \
+    UTLT_Assert(ruleNode, return NULL, "Upf"#__ruleType"NodeAlloc failed"); \
+    ruleNode->key = UpfRuleKey(sess->index, rule->UPF_RULE_ID(__ruleName)); \
+    memcpy(&ruleNode->__ruleName, rule, sizeof(Upf##__ruleType)); \
+    ruleNode->__ruleName.flags.seid = 1; \
+    ruleNode->__ruleName.seid = sess->upfSeid; \
+    UTLT_Assert(SwissTableSet(&__ruleType##Table, ruleNode, (void **) &oldNode) == STATUS_OK, \
+        Upf##__ruleType##NodeFree(ruleNode); return NULL, \
+        #__ruleType" ID[%u] can NOT be added to "#__ruleType"Table", rule->UPF_RULE_ID(__ruleName)); \
+    ListInsert(ruleNode, &sess->__ruleName##List); \
+    UpfSessionPDRLink(sess); \
+    if (oldNode) { \
+        ListRemove(oldNode); \
+        RcuDefer(Upf##__ruleType##NodeFreeDeferred, oldNode); \
+    } \
     return ruleNode; \
 }
 
@@ -339,91 +457,69 @@ RuleRegisterToSession(BAR, bar);
 RuleRegisterToSession(URR, urr);
 */
 
-// Do the thread safe to upper layer function
-#define RuleDeletionFromSession(__ruleType, __ruleName, __sessPtr, __nodePtr) do { \
-    RuleNodeHashSet(__ruleType, (__nodePtr)->__ruleName.UPF_RULE_ID(__ruleName), NULL); \
-    ListRemove(__nodePtr); \
-} while (0)
-
-
-static void UpfPDRDeregisterToSessionByNodeNoSafe(UpfSession *sess, UpfPDRNode *ruleNode) {
-    if (ruleNode->matchRule) {
-        MatchRuleDeregister(ruleNode->matchRule);
-        MatchRuleNodeFree(ruleNode->matchRule);
-    }
-
-    RuleDeletionFromSession(PDR, pdr, sess, ruleNode);
-    UpfPDRNodeFree(ruleNode);
-}
-
-static void UpfPDRDeregisterToSessionByNode(UpfSession *sess, UpfPDRNode *ruleNode) {
-    PDR_Thread_Safe(
-        UpfPDRDeregisterToSessionByNodeNoSafe(sess, ruleNode);
-    );
-}
-
 Status UpfPDRDeregisterToSessionByID(UpfSession *sess, uint16_t id) {
     UTLT_Assert(sess, return STATUS_ERROR, "Session should not be NULL");
 
-    PDR_Thread_Safe(
-        UpfPDRNode *ruleNode = RuleNodeHashGet(PDR, id);
-        UTLT_Assert(ruleNode, return STATUS_ERROR, "PDR ID[%u] does NOT exist", id);
+    UpfPDRNode *ruleNode = RuleNodeGet(PDR, sess, id);
+    UTLT_Assert(ruleNode, return STATUS_ERROR, "PDR ID[%u] does NOT exist", id);
 
-        UpfPDRDeregisterToSessionByNodeNoSafe(sess, ruleNode);
-    );
+    UpfPDRDeletionFromSession(sess, ruleNode);
+    RcuDefer(UpfPDRNodeFreeDeferred, ruleNode);
 
     return STATUS_OK;
 }
 
-#define RuleDeregisterToSessionByID(__ruleType, __ruleName, __keyType) \
+#define RuleDeregisterToSessionByID(__ruleType, __keyType) \
 Status Upf##__ruleType##DeregisterToSessionByID(UpfSession *sess, __keyType id) { \
     UTLT_Assert(sess, return STATUS_ERROR, "Session should not be NULL"); \
-    __ruleType##_Thread_Safe( \
-        Upf##__ruleType##Node *ruleNode = RuleNodeHashGet(__ruleType, id); \
-        UTLT_Assert(ruleNode, return STATUS_ERROR, #__ruleType" ID[%u] does NOT exist", id); \
-        RuleDeletionFromSession(__ruleType, __ruleName, sess, ruleNode); \
-    ); \
-    Upf##__ruleType##NodeFree(ruleNode); \
+    Upf##__ruleType##Node *ruleNode = RuleNodeGet(__ruleType, sess, id); \
+    UTLT_Assert(ruleNode, return STATUS_ERROR, #__ruleType" ID[%u] does NOT exist", id); \
+    RuleDeletionFromSession(__ruleType, ruleNode); \
+    UpfSessionPDRLink(sess); \
+    RcuDefer(Upf##__ruleType##NodeFreeDeferred, ruleNode); \
     return STATUS_OK; \
 }
 
-RuleDeregisterToSessionByID(FAR, far, uint32_t);
-RuleDeregisterToSessionByID(QER, qer, uint32_t);
+RuleDeregisterToSessionByID(FAR, uint32_t);
+RuleDeregisterToSessionByID(QER, uint32_t);
 /* TODO: Not support yet
-RuleDeregisterToSessionByID(BAR, bar, uint32_t);
-RuleDeregisterToSessionByID(URR, urr, uint32_t);
+RuleDeregisterToSessionByID(BAR, uint32_t);
+RuleDeregisterToSessionByID(URR, uint32_t);
 */
 
 #define UPF_RULE_LIST(__ruleName) __ruleName ## List
 
 void UpfPDRListDeletionAndFreeWithGTPv1Tunnel(UpfSession *sess) {
-    UpfPDRNode *ruleNode;
-    UpfPDRNode *nextNode;
-    ruleNode = ListFirst(&(sess)->pdrList);
-    while (ruleNode != (UpfPDRNode *) &(sess)->pdrList) {
-        nextNode = (UpfPDRNode *) ListNext(ruleNode);
+    UpfPDRNode *ruleNode, *nextNode = NULL;
+
+    ListForEachSafe(ruleNode, nextNode, &sess->pdrList) {
         UTLT_Assert(!Gtpv1TunnelRemovePDR(&ruleNode->pdr), ,
             "Remove PDR[%u] failed", ruleNode->pdr.pdrId);
 
-        UpfPDRDeregisterToSessionByNode(sess, ruleNode);
-        ruleNode = nextNode;
+        UpfPDRDeletionFromSession(sess, ruleNode);
+        RcuDefer(UpfPDRNodeFreeDeferred, ruleNode);
     }
 }
 
-// Do the thread safe to upper layer function
+// The nodes are freed by RcuDefer() after PDRs are relinked without them
 #define RuleListDeletionAndFreeWithGTPv1Tunnel(__ruleType, __ruleName) \
 void Upf##__ruleType##ListDeletionAndFreeWithGTPv1Tunnel(UpfSession *sess) { \
-    Upf##__ruleType##Node *ruleNode; \
-    Upf##__ruleType##Node *nextNode; \
-    ruleNode = ListFirst(&(sess)->UPF_RULE_LIST(__ruleName)); \
-    while (ruleNode != (Upf##__ruleType##Node *) &(sess)->UPF_RULE_LIST(__ruleName)) { \
-        nextNode = (Upf##__ruleType##Node *)ListNext(ruleNode); \
+    ListHead freeList; \
+    Upf##__ruleType##Node *ruleNode, *nextNode = NULL; \
+    ListHeadInit(&freeList); \
+    ListForEachSafe(ruleNode, nextNode, &(sess)->UPF_RULE_LIST(__ruleName)) { \
         UTLT_Assert(!Gtpv1TunnelRemove##__ruleType(&ruleNode->__ruleName), , \
             "Remove "#__ruleType"[%u] failed", ruleNode->__ruleName.UPF_RULE_ID(__ruleName)); \
-        RuleDeletionFromSession(__ruleType, __ruleName, (sess), ruleNode); \
-        IndexFree(&upf##__ruleType##NodePool, ruleNode); \
-        ruleNode = nextNode; \
-    }  \
+        RuleDeletionFromSession(__ruleType, ruleNode); \
+        ListInsert(ruleNode, &freeList); \
+    } \
+    if (ListFirst(&freeList) == (void *) &freeList) \
+        return; \
+    UpfSessionPDRLink(sess); \
+    ListForEachSafe(ruleNode, nextNode, &freeList) { \
+        ListRemove(ruleNode); \
+        RcuDefer(Upf##__ruleType##NodeFreeDeferred, ruleNode); \
+    } \
 }
 
 RuleListDeletionAndFreeWithGTPv1Tunnel(FAR, far);
@@ -433,102 +529,167 @@ RuleListDeletionAndFreeWithGTPv1Tunnel(URR, urr);
 RuleListDeletionAndFreeWithGTPv1Tunnel(BAR, bar);
 */
 
-HashIndex *UpfBufPacketFirst() {
-    UTLT_Assert(self.bufPacketHash, return NULL, "");
-    return HashFirst(self.bufPacketHash);
-}
+UpfBufPacket *UpfBufPacketFindByPdrId(uint64_t seid, uint16_t pdrId) {
+    RcuReadLock();
+    UpfBufPacket *bufPacket = SwissTableGet(&self.bufPacketTable,
+                                            UpfRuleKey(UpfSeidIndex(seid), pdrId));
+    RcuReadUnlock();
 
-HashIndex *UpfBufPacketNext(HashIndex *hashIdx) {
-    UTLT_Assert(hashIdx, return NULL, "");
-    return HashNext(hashIdx);
+    return bufPacket;
 }
 
-UpfBufPacket *UpfBufPacketThis(HashIndex *hashIdx) {
-    UTLT_Assert(hashIdx, return NULL, "");
-    return (UpfBufPacket *)HashThisVal(hashIdx);
+static void UpfBufPacketFree(UpfBufPacket *bufPacket) {
+    if (bufPacket->packetBuffer) {
+        UTLT_Assert(BufblkFree(bufPacket->packetBuffer) == STATUS_OK, ,
+                    "packet in bufPacket free error");
+    }
+    UTLT_Assert(UTLT_Free(bufPacket) == STATUS_OK, , "bufPacket free error");
 }
 
-UpfBufPacket *UpfBufPacketFindByPdrId(uint16_t pdrId) {
-    return (UpfBufPacket*)HashGet(self.bufPacketHash,
-                                  &pdrId, sizeof(uint16_t));
+// Callback of RcuDefer(), packet path may still be on the buffer
+static void UpfBufPacketFreeDeferred(void *bufPacket) {
+    UpfBufPacketFree(bufPacket);
 }
 
-UpfBufPacket *UpfBufPacketAdd(const UpfSession * const session,
+UpfBufPacket *UpfBufPacketAdd(UpfSession * const session,
                               const uint16_t pdrId) {
     UTLT_Assert(session, return NULL, "No session");
     UTLT_Assert(pdrId, return NULL, "PDR ID cannot be 0");
 
+    UpfBufPacket *oldBufPacket = NULL;
     UpfBufPacket *newBufPacket = UTLT_Malloc(sizeof(UpfBufPacket));
     UTLT_Assert(newBufPacket, return NULL, "Allocate new slot error");
+    ListHeadInit(&newBufPacket->node);
+    newBufPacket->key = UpfRuleKey(session->index, pdrId);
     newBufPacket->sessionPtr = session;
     newBufPacket->pdrId = pdrId;
     newBufPacket->packetBuffer = NULL;
 
-    HashSet(self.bufPacketHash, &newBufPacket->pdrId,
-            sizeof(uint16_t), newBufPacket);
+    UTLT_Assert(SwissTableSet(&self.bufPacketTable, newBufPacket,
+                              (void **) &oldBufPacket) == STATUS_OK,
+                UTLT_Free(newBufPacket); return NULL,
+                "Buffer of PDR ID[%u] can NOT be added to bufPacketTable", pdrId);
+    ListInsert(newBufPacket, &session->bufPacketList);
+
+    if (oldBufPacket) {
+        ListRemove(oldBufPacket);
+        RcuDefer(UpfBufPacketFreeDeferred, oldBufPacket);
+    }
 
-    //ListAppend(&Self()->bufPacketList, newBufPacket);
     return newBufPacket;
 }
 
 Status UpfBufPacketRemove(UpfBufPacket *bufPacket) {
     UTLT_Assert(bufPacket, return STATUS_ERROR,
                 "Input bufPacket error");
-    Status status;
 
-    bufPacket->sessionPtr = NULL;
-    //bufPacket->pdrId = 0;
-    if (bufPacket->packetBuffer) {
-        status = BufblkFree(bufPacket->packetBuffer);
-        UTLT_Assert(status == STATUS_OK, return STATUS_ERROR,
-                    "packet in bufPacket free error");
-    }
-
-    HashSet(self.bufPacketHash, &bufPacket->pdrId,
-            sizeof(uint16_t), NULL);
-    //ListRemove(&Self()->bufPacketList, bufPacket);
-    status = UTLT_Free(bufPacket);
-    UTLT_Assert(status == STATUS_OK, return STATUS_ERROR,
-                "bufPacket free error");
+    // Packet path may still be on it, free it by RcuDefer()
+    SwissTableDelete(&self.bufPacketTable, bufPacket->key);
+    ListRemove(bufPacket);
+    RcuDefer(UpfBufPacketFreeDeferred, bufPacket);
 
     return STATUS_OK;
 }
 
+static void UpfBufPacketRemoveBySession(UpfSession *session) {
+    UpfBufPacket *bufPacket, *nextBufPacket = NULL;
+
+    ListForEachSafe(bufPacket, nextBufPacket, &session->bufPacketList) {
+        SwissTableDelete(&self.bufPacketTable, bufPacket->key);
+        ListRemove(bufPacket);
+        RcuDefer(UpfBufPacketFreeDeferred, bufPacket);
+    }
+}
+
 Status UpfBufPacketRemoveAll() {
-    HashIndex *hashIdx = NULL;
     UpfBufPacket *bufPacket = NULL;
+    uint32_t pos = 0;
 
-    for (hashIdx = UpfBufPacketFirst(); hashIdx;
-         hashIdx = UpfBufPacketNext(hashIdx)) {
-        bufPacket = UpfBufPacketThis(hashIdx);
-        UpfBufPacketRemove(bufPacket);
+    // Only called in termination, no one is on them
+    while ((bufPacket = SwissTableNext(&self.bufPacketTable, &pos))) {
+        SwissTableDelete(&self.bufPacketTable, bufPacket->key);
+        ListRemove(bufPacket);
+        UpfBufPacketFree(bufPacket);
     }
 
     return STATUS_OK;
 }
 
-HashIndex *UpfSessionFirst() {
-    UTLT_Assert(self.sessionHash, return NULL, "");
-    return HashFirst(self.sessionHash);
+// The UE IP of IPv4 session is the key of sessionIpIndex, the others are keyed by IPv6
+static const uint8_t *SessionUeIpKey(const UpfSession *session, int *len) {
+    if (session->pdn.paa.pdnType == PFCP_PDN_TYPE_IPV4) {
+        *len = 4;
+        return (const uint8_t *)&session->ueIpv4.addr4;
+    }
+    *len = IPV6_LEN;
+    return (const uint8_t *)&session->ueIpv6.addr6;
 }
 
-HashIndex *UpfSessionNext(HashIndex *hashIdx) {
-    UTLT_Assert(hashIdx, return NULL, "");
-    return HashNext(hashIdx);
+static uint32_t SessionUeIpHash(const uint8_t *ip, int ipLen, const uint8_t *dnn) {
+    uint32_t hash = 2166136261U;
+
+    // FNV-1a, then the high bits are mixed into the low bits taken by the mask of sessionIpIndex
+    for (int i = 0; i < ipLen; i++)
+        hash = (hash ^ ip[i]) * 16777619U;
+    for (int i = 0; i < MAX_DNN_LEN && dnn[i]; i++)
+        hash = (hash ^ dnn[i]) * 16777619U;
+    hash ^= hash >> 16;
+    hash *= 0x85EBCA6BU;
+    hash ^= hash >> 13;
+
+    return hash;
+}
+
+// UE IP + DNN looked up in sessionIpIndex
+typedef struct {
+    const uint8_t   *ip;
+    int             ipLen;
+    const uint8_t   *dnn;
+} SessionUeIpLookup;
+
+static int SessionUeIpEqual(uint32_t idx, const void *key) {
+    const SessionUeIpLookup *lookup = key;
+    const UpfSession *session = SlotTableAt(&self.sessionTable, idx);
+    int len;
+    const uint8_t *ip = SessionUeIpKey(session, &len);
+
+    return len == lookup->ipLen && memcmp(ip, lookup->ip, len) == 0 &&
+           strncmp((const char *)session->pdn.dnn, (const char *)lookup->dnn, MAX_DNN_LEN) == 0;
+}
+
+// Find the entry of UE IP + DNN, or the empty entry ending its probe. Lock sessionLock before it.
+static SlotIndexEntry *SessionIpIndexProbe(const uint8_t *ip, int ipLen,
+                                           const uint8_t *dnn, uint32_t hash) {
+    SessionUeIpLookup lookup = { ip, ipLen, dnn };
+
+    return SlotIndexProbe(&self.sessionIpIndex, hash, SessionUeIpEqual, &lookup);
 }
 
-UpfSession *UpfSessionThis(HashIndex *hashIdx) {
-    UTLT_Assert(hashIdx, return NULL, "");
-    return (UpfSession *)HashThisVal(hashIdx);
+static void SessionIpIndexAdd(UpfSession *session) {
+    int ipLen;
+    const uint8_t *ip = SessionUeIpKey(session, &ipLen);
+    uint32_t hash = SessionUeIpHash(ip, ipLen, session->pdn.dnn);
+
+    pthread_mutex_lock(&self.sessionLock);
+    SlotIndexEntry *entry = SessionIpIndexProbe(ip, ipLen, session->pdn.dnn, hash);
+    if (entry->slot)
+        UTLT_Warning("Session %u of the same UE IP and DNN %s is replaced by session %u",
+                     entry->slot - 1, session->pdn.dnn, session->index);
+    SlotIndexFill(entry, hash, session->index);
+    pthread_mutex_unlock(&self.sessionLock);
 }
 
-void SessionHashKeygen(uint8_t *out, int *outLen, uint8_t *imsi,
-                       int imsiLen, uint8_t *dnn) {
-    memcpy(out, imsi, imsiLen);
-    strncpy((char *)(out + imsiLen), (char*)dnn, MAX_DNN_LEN + 1);
-    *outLen = imsiLen + strlen((char *)(out + imsiLen));
+static void SessionIpIndexRemove(UpfSession *session) {
+    int ipLen;
+    const uint8_t *ip = SessionUeIpKey(session, &ipLen);
 
-    return;
+    pthread_mutex_lock(&self.sessionLock);
+    SlotIndexEntry *entry = SessionIpIndexProbe(ip, ipLen, session->pdn.dnn,
+                                                SessionUeIpHash(ip, ipLen, session->pdn.dnn));
+    // It is not there if a session of the same key has replaced it
+    if (entry->slot == (uint32_t) session->index + 1)
+        SlotIndexRemove(&self.sessionIpIndex, entry);
+    pthread_mutex_unlock(&self.sessionLock);
 }
 
 UpfSession *UpfSessionAdd(PfcpUeIpAddr *ueIp, uint8_t *dnn,
@@ -540,21 +701,6 @@ UpfSession *UpfSessionAdd(PfcpUeIpAddr *ueIp, uint8_t *dnn,
 
     //session->gtpNode = NULL;
 
-    if (self.pfcpAddr) {
-        session->upfSeid =
-          ((uint64_t)self.pfcpAddr->s4.sin_addr.s_addr << 32)
-          | session->index;
-    } else if (self.pfcpAddr6) {
-        uint32_t *ptr =
-          (uint32_t *)self.pfcpAddr6->s6.sin6_addr.s6_addr;
-        session->upfSeid =
-          (((uint64_t)(*ptr)) << 32) | session->index;
-        // TODO: check if correct
-    }
-    session->upfSeid = htobe64(session->upfSeid);
-    //UTLT_Info()
-    session->upfSeid = 0; // TODO: check why
-
     /* IMSI DNN Hash */
     /* DNN */
     strncpy((char*)session->pdn.dnn, (char*)dnn, MAX_DNN_LEN + 1);
@@ -565,6 +711,7 @@ UpfSession *UpfSessionAdd(PfcpUeIpAddr *ueIp, uint8_t *dnn,
     ListHeadInit(&session->qerList);
     ListHeadInit(&session->barList);
     ListHeadInit(&session->urrList);
+    ListHeadInit(&session->bufPacketList);
 
     session->pdn.paa.pdnType = pdnType;
     if (pdnType == PFCP_PDN_TYPE_IPV4) {
@@ -588,34 +735,44 @@ UpfSession *UpfSessionAdd(PfcpUeIpAddr *ueIp, uint8_t *dnn,
         // session->pdn.paa.dualStack.addr4 = session->ueIpv4->addr4;
         // session->pdn.paa.dualStack.addr6 = session->ueIpv6->addr6;
     } else {
+        IndexFree(&upfSessionPool, session);
         UTLT_Assert(0, return NULL, "UnSupported PDN Type(%d)", pdnType);
     }
 
-    /* Generate Hash Key: IP + DNN */
-    if (pdnType == PFCP_PDN_TYPE_IPV4) {
-        SessionHashKeygen(session->hashKey,
-                          &session->hashKeylen,
-                          (uint8_t *)&session->ueIpv4.addr4, 4, dnn);
-    } else {
-        SessionHashKeygen(session->hashKey,
-                          &session->hashKeylen,
-                          (uint8_t *)&session->ueIpv6.addr6,
-                          IPV6_LEN, dnn);
+    // The slot is only written by the N4 worker owning the session
+    int worker = UpfN4WorkerSelf();
+    session->upfSeid = SlotTableSet(&self.sessionTable, session->index,
+                                    worker < 0 ? 0 : worker, session);
+    if (!session->upfSeid) {
+        IndexFree(&upfSessionPool, session);
+        UTLT_Assert(0, return NULL, "Session %u is still in the session table", session->index);
     }
 
-    HashSet(self.sessionHash, session->hashKey,
-            session->hashKeylen, session);
+    SessionIpIndexAdd(session);
+
+    ListHeadInit(&session->node);
+    ListHead *workerSessionList = UpfN4WorkerSessionList();
+    if (workerSessionList) {
+        ListInsert(session, workerSessionList);
+    }
 
     return session;
 }
 
+static void UpfSessionFreeDeferred(void *session) {
+    IndexFree(&upfSessionPool, session);
+}
+
 Status UpfSessionRemove(UpfSession *session) {
-    UTLT_Assert(self.sessionHash, return STATUS_ERROR,
-                "sessionHash error");
     UTLT_Assert(session, return STATUS_ERROR, "session error");
 
-    HashSet(self.sessionHash, session->hashKey,
-            session->hashKeylen, NULL);
+    UTLT_Assert(SlotTableAt(&self.sessionTable, session->index) == session, return STATUS_ERROR,
+                "Session %d has been removed", session->index);
+
+    SessionIpIndexRemove(session);
+    // Stale SEID must not find it, nor the next session in this slot
+    SlotTableClear(&self.sessionTable, session->index);
+    ListRemove(session);
 
     // if (session->ueIpv4) {
     //     UpfUeIPFree(session->ueIpv4);
@@ -624,18 +781,7 @@ Status UpfSessionRemove(UpfSession *session) {
     //     UpfUeIPFree(session->ueIpv6);
     // }
 
-    uint16_t pdrId;
-    UpfPDRNode *ruleNode, *nextNode;
-    ruleNode = ListFirst(&(session)->pdrList);
-    while (ruleNode != (UpfPDRNode *)&(session)->pdrList) {
-        nextNode = (UpfPDRNode *)ListNext(ruleNode);
-        pdrId = ruleNode->pdr.pdrId;
-        UpfBufPacket *tmpBufPacket = UpfBufPacketFindByPdrId(pdrId);
-        if (tmpBufPacket != NULL) {
-            UpfBufPacketRemove(tmpBufPacket);
-        }
-        ruleNode = nextNode;
-    }
+    UpfBufPacketRemoveBySession(session);
 
     UpfPDRListDeletionAndFreeWithGTPv1Tunnel(session);
     UpfFARListDeletionAndFreeWithGTPv1Tunnel(session);
@@ -646,19 +792,39 @@ Status UpfSessionRemove(UpfSession *session) {
     UpfURRListDeletionAndFreeWithGTPv1Tunnel(session);
     */
 
-    IndexFree(&upfSessionPool, session);
+    session->upfSeid = 0;
+    // Buffers of packet path may still point to it, so its index is reused after them
+    RcuDefer(UpfSessionFreeDeferred, session);
 
     return STATUS_OK;
 }
 
 Status UpfSessionRemoveAll() {
-    HashIndex *hashIdx = NULL;
     UpfSession *session = NULL;
 
-    for (hashIdx = UpfSessionFirst(); hashIdx;
-         hashIdx = UpfSessionNext(hashIdx)) {
-        session = UpfSessionThis(hashIdx);
-        UpfSessionRemove(session);
+    if (!self.sessionTable.slot)
+        return STATUS_OK;
+
+    // Chunks of the pool grow in order, so no session is after the first index not grown
+    for (uint32_t idx = 0; idx < self.sessionCap && UpfSessionFind(idx); idx++) {
+        session = SlotTableAt(&self.sessionTable, idx);
+        if (session)
+            UpfSessionRemove(session);
+    }
+
+    return STATUS_OK;
+}
+
+Status UpfSessionRemoveByNode(PfcpNode *node) {
+    ListHead *list = UpfN4WorkerSessionList();
+    UpfSession *session, *nextSession = NULL;
+
+    UTLT_Assert(list, return STATUS_ERROR, "Sessions are only owned by N4 workers");
+
+    ListForEachSafe(session, nextSession, list) {
+        if (session->pfcpNode == node) {
+            UpfSessionRemove(session);
+        }
     }
 
     return STATUS_OK;
@@ -670,7 +836,35 @@ UpfSession *UpfSessionFind(uint32_t idx) {
 }
 
 UpfSession *UpfSessionFindBySeid(uint64_t seid) {
-    return UpfSessionFind((seid-1) & 0xFFFFFFFF);
+    UpfSession *session = SlotTableGet(&self.sessionTable, seid);
+    if (!session)
+        return NULL;
+
+    // The worker in SEID must be the owner too
+    return (session->upfSeid == seid ? session : NULL);
+}
+
+UpfSession *UpfSessionFindByUeIp(PfcpUeIpAddr *ueIp, uint8_t *dnn, uint8_t pdnType) {
+    const uint8_t *ip;
+    int ipLen;
+    UpfSession *session = NULL;
+
+    UTLT_Assert(ueIp && dnn, return NULL, "UE IP or DNN is NULL");
+    if (pdnType == PFCP_PDN_TYPE_IPV4) {
+        ip = (const uint8_t *)&ueIp->addr4;
+        ipLen = 4;
+    } else {
+        ip = (const uint8_t *)&ueIp->addr6;
+        ipLen = IPV6_LEN;
+    }
+
+    pthread_mutex_lock(&self.sessionLock);
+    SlotIndexEntry *entry = SessionIpIndexProbe(ip, ipLen, dnn, SessionUeIpHash(ip, ipLen, dnn));
+    if (entry->slot)
+        session = SlotTableAt(&self.sessionTable, entry->slot - 1);
+    pthread_mutex_unlock(&self.sessionLock);
+
+    return session;
 }
 
 UpfSession *UpfSessionAddByMessage(PfcpMessage *message) {
@@ -719,7 +913,6 @@ UpfSession *UpfSessionAddByMessage(PfcpMessage *message) {
     UTLT_Assert(session, return NULL, "session add error");
 
     session->smfSeid = be64toh(((PfcpFSeid *) request->cPFSEID.value)->seid);
-    session->upfSeid = session->index+1;
     UTLT_Trace("UPF Establishment UPF SEID: %lu", session->upfSeid);
 
     return session;
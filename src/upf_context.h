@@ -12,6 +12,8 @@
 #include "utlt_thread.h"
 #include "utlt_network.h"
 #include "utlt_hash.h"
+#include "utlt_swisstable.h"
+#include "utlt_slottable.h"
 #include "utlt_3gppTypes.h"
 #include "utlt_timer.h"
 
@@ -35,6 +37,7 @@ typedef struct _UpfDev       UpfDev;
 typedef struct gtp5g_pdr     UpfPdr;
 typedef struct gtp5g_far     UpfFar;
 typedef struct _UpfBufPacket UpfBufPacket;
+typedef struct _UpfSession   UpfSession;
 
 // Rule structure dependent on UPDK
 typedef UPDK_PDR UpfPDR;
@@ -51,6 +54,8 @@ typedef enum _UpfEvent {
     UPF_EVENT_SESSION_REPORT,
     UPF_EVENT_N4_T3_RESPONSE,
     UPF_EVENT_N4_T3_HOLDING,
+    UPF_EVENT_SESSION_RELEASE,
+    UPF_EVENT_N4_WORKER_STOP,
 
     UPF_EVENT_TOP,
 
@@ -75,13 +80,6 @@ typedef struct {
     SockAddr        *pfcpAddr;           // IPv4 Address
     SockAddr        *pfcpAddr6;          // IPv6 Address
 
-    /* Use Array or Hash for better performance
-     * Because max size of the list is 65536 due to the max of PDR ID
-     * We can use array for O(1) search instead of O(N) search in list
-     * Trade off of speed and memory size
-     */
-    //ListNode        bufPacketList;       // save pdrId and buffer here
-
     // DNS
 #define MAX_NUM_OF_DNS          2
     const char      *dns[MAX_NUM_OF_DNS];
@@ -99,16 +97,31 @@ typedef struct {
 
     uint32_t        recoveryTime;       // UTC time
     TimerList       timerServiceList;
+    Sock            timerSock;          // timerfd of timerServiceList
 
     // Add some self library structure here
     int             epfd;               // Epoll fd
     EvtQId          eventQ;             // Event queue communicate between UP and CP
+    int             n4WorkerNum;        // Default : 0, one N4 worker per CPU
+
+    // Capacities of pools, whose memory is only taken when they are used
+    uint32_t        sessionCap;         // Default : MAX_POOL_OF_SESS
+    uint32_t        pdrCap;             // Default : MAX_POOL_OF_BEARER * 2
+    uint32_t        farCap;             // Default : MAX_POOL_OF_BEARER * 2
+    uint32_t        qerCap;             // Default : MAX_POOL_OF_SESS * 2
+    uint32_t        matchRuleCap;       // Default : MAX_POOL_OF_BEARER * 2
+    uint32_t        pfcpXactCap;        // Default : 0, the default of PFCP library
+    _Bool           hugePage;           // Default : 0, reserve pools of sessions and rules on hugepages
     ThreadID        pktRecvThread;      // Receive packet thread
 
-    // Session : hash(IMSI+DNN)
-    Hash            *sessionHash;
-    // Save buffer packet here
-    Hash            *bufPacketHash;
+    // Session : table of sessionCap slots found by UP-SEID
+    SlotTable       sessionTable;
+    // Session : index of sessionTable by UE IP + DNN
+    SlotIndex       sessionIpIndex;
+    // Save buffer packet here, by session index and PDR ID
+    SwissTable      bufPacketTable;
+    // Protect sessionIpIndex written by all N4 workers
+    pthread_mutex_t sessionLock;
     // Use spin lock to protect data write
     pthread_spinlock_t buffLock;
     // TODO: read from config
@@ -131,6 +144,7 @@ typedef struct _UpfUeIp {
 } UpfUeIp;
 
 typedef struct _UpfSession {
+    ListHead        node;               // Node of the N4 worker owning it
     int             index;
 
     uint64_t        upfSeid;
@@ -146,10 +160,6 @@ typedef struct _UpfSession {
     //ECgi          eCgi; // For LTE E-UTRA Cell ID
     //NCgi          nCgi; // For 5GC NR Cell ID
 
-    /* Hashed key: hash(IMSI+DNN) */
-    uint8_t         hashKey[MAX_IMSI_LEN+MAX_DNN_LEN];
-    int             hashKeylen;
-
     /* GTP, PFCP context */
     //SockNode        *gtpNode;
     PfcpNode        *pfcpNode;
@@ -161,12 +171,15 @@ typedef struct _UpfSession {
     ListHead        barList;
     ListHead        urrList;
 
+    ListHead        bufPacketList;
+
 } UpfSession;
 
 // Used for buffering, Index type for each PDR
 typedef struct _UpfBufPacket {
-    //ListHead        node;
+    ListHead        node;               // Node of bufPacketList of the session
     int             index;
+    uint64_t        key;                // Session index and PDR ID, key of bufPacketTable
 
     // If sessionPtr == NULL, this PDR don't exist
     // TS 29.244 5.2.1 shows that PDR won't cross session
@@ -178,6 +191,7 @@ typedef struct _UpfBufPacket {
 typedef struct {
     ListHead node;
     int index;
+    uint64_t key;               // Session index and rule ID, key of the rule table
 
     UpfPDR pdr;
 
@@ -187,6 +201,7 @@ typedef struct {
 typedef struct {
     ListHead node;
     int index;
+    uint64_t key;
 
     UpfFAR far;
 } UpfFARNode;
@@ -194,6 +209,7 @@ typedef struct {
 typedef struct {
     ListHead node;
     int index;
+    uint64_t key;
 
     UpfQER qer;
 } UpfQERNode;
@@ -201,6 +217,7 @@ typedef struct {
 typedef struct {
     ListHead node;
     int index;
+    uint64_t key;
 
     // UpfBAR bar;
 } UpfBARNode;
@@ -208,6 +225,7 @@ typedef struct {
 typedef struct {
     ListHead node;
     int index;
+    uint64_t key;
 
     // UpfURR urr;
 } UpfURRNode;
@@ -215,6 +233,9 @@ typedef struct {
 UpfContext *Self();
 Status UpfContextInit();
 Status UpfContextTerminate();
+// Pools of sessions and rules, which are sized by config
+Status UpfResourceInit();
+Status UpfResourceTerminate();
 
 // Rules
 UpfPDRNode *UpfPDRNodeAlloc();
@@ -229,15 +250,20 @@ void UpfQERNodeFree(UpfQERNode *node);
 void UpfBARNodeFree(UpfBARNode *node);
 void UpfURRNodeFree(UpfURRNode *node);
 
-int UpfPDRFindByID(uint16_t id, void *ruleBuf);
-int UpfFARFindByID(uint32_t id, void *ruleBuf);
-int UpfQERFindByID(uint32_t id, void *ruleBuf);
 /*
-int UpfBARFindByID(uint32_t id, void *ruleBuf);
-int UpfURRFindByID(uint32_t id, void *ruleBuf);
+ * Copy the rule of the session with UP F-SEID @seid to @ruleBuf, or only check
+ * if it exists when @ruleBuf is NULL. They take no lock, so the packet path
+ * can call them at any rate.
+ */
+int UpfPDRFindByID(uint64_t seid, uint16_t id, void *ruleBuf);
+int UpfFARFindByID(uint64_t seid, uint32_t id, void *ruleBuf);
+int UpfQERFindByID(uint64_t seid, uint32_t id, void *ruleBuf);
+/*
+int UpfBARFindByID(uint64_t seid, uint32_t id, void *ruleBuf);
+int UpfURRFindByID(uint64_t seid, uint32_t id, void *ruleBuf);
 */
 
-Status HowToHandleThisPacket(uint32_t farID, uint8_t *action);
+Status HowToHandleThisPacket(uint64_t seid, uint32_t farID, uint8_t *action);
 
 void UpfPDRDump();
 void UpfFARDump();
@@ -264,25 +290,24 @@ Status UpfURRDeregisterToSessionByID(UpfSession *sess, uint32_t id);
 */
 
 // BufPacket
-HashIndex *UpfBufPacketFirst();
-HashIndex *UpfBufPacketNext(HashIndex *hashIdx);
-UpfBufPacket *UpfBufPacketThis(HashIndex *hashIdx);
-UpfBufPacket *UpfBufPacketFindByPdrId(uint16_t pdrId);
-UpfBufPacket *UpfBufPacketAdd(const UpfSession * const session,
+// Packet path holds RCU read-side critical section while using the returned one
+UpfBufPacket *UpfBufPacketFindByPdrId(uint64_t seid, uint16_t pdrId);
+UpfBufPacket *UpfBufPacketAdd(UpfSession * const session,
                               const uint16_t pdrId);
 Status UpfBufPacketRemove(UpfBufPacket *bufPacket);
 Status UpfBufPacketRemoveAll();
 
 // Session
-HashIndex *UpfSessionFirst();
-HashIndex *UpfSessionNext(HashIndex *hashIdx);
-UpfSession *UpfSessionThis(HashIndex *hashIdx);
-void SessionHashKeygen(uint8_t *out, int *outLen, uint8_t *imsi, int imsiLen, uint8_t *dnn);
 UpfSession *UpfSessionAdd(PfcpUeIpAddr *ueIp, uint8_t *dnn, uint8_t pdnType);
 Status UpfSessionRemove(UpfSession *session);
 Status UpfSessionRemoveAll();
+// Remove sessions of @node owned by the calling N4 worker
+Status UpfSessionRemoveByNode(PfcpNode *node);
 UpfSession *UpfSessionFind(uint32_t idx);
+// Return NULL if @seid is out of range or its session has been removed
 UpfSession *UpfSessionFindBySeid(uint64_t seid);
+// The UE IP of IPv4 session is @ueIp->addr4, the others are @ueIp->addr6
+UpfSession *UpfSessionFindByUeIp(PfcpUeIpAddr *ueIp, uint8_t *dnn, uint8_t pdnType);
 UpfSession *UpfSessionAddByMessage(PfcpMessage *message);
 UpfSession *UpfSessionFindByPdrTeid(uint32_t teid);
 
@@ -10,6 +10,7 @@
 #include "utlt_lib.h"
 #include "utlt_debug.h"
 #include "utlt_buff.h"
+#include "utlt_index.h"
 #include "utlt_thread.h"
 #include "utlt_timer.h"
 #include "utlt_network.h"
@@ -17,6 +18,7 @@
 #include "upf_config.h"
 #include "up/up_path.h"
 #include "n4/n4_pfcp_path.h"
+#include "n4/n4_worker.h"
 #include "pfcp_xact.h"
 
 #include "updk/env.h"
@@ -26,6 +28,8 @@ static Status SignalRegister(void *data);
 
 static Status ConfigHandle(void *data);
 
+static Status MemoryReport(void *data);
+
 static Status EpollInit(void *data);
 static Status EpollTerm(void *data);
 
@@ -38,6 +42,10 @@ static Status PacketRecvThreadTerm(void *data);
 static Status Gtpv1Init(void *data);
 static Status Gtpv1Term(void *data);
 
+static Status PfcpXactPoolInit(void *data);
+static Status PfcpXactPoolTerm(void *data);
+static Status N4WorkerInit(void *data);
+static Status N4WorkerTerm(void *data);
 static Status PfcpInit(void *data);
 static Status PfcpTerm(void *data);
 
@@ -46,6 +54,13 @@ void PacketReceiverThread(ThreadID id, void *data);
 static char configFilePath[MAX_FILE_PATH_STRLEN] = "./config/upfcfg.yaml";
 
 UpfOps UpfOpsList[] = {
+    {
+        .name = "Library - Async Log",
+        .init = UTLT_LogAsyncStart,
+        .initData = NULL,
+        .term = UTLT_LogAsyncStop,
+        .termData = NULL,
+    },
     {
         .name = "Library - Bufblk Pool",
         .init = BufblkPoolInit,
@@ -95,6 +110,13 @@ UpfOps UpfOpsList[] = {
         .term = NULL,
         .termData = NULL,
     },
+    {
+        .name = "UPF - Resource",
+        .init = UpfResourceInit,
+        .initData = NULL,
+        .term = UpfResourceTerminate,
+        .termData = NULL,
+    },
     {
         .name = "UPF - Epoll",
         .init = EpollInit,
@@ -123,6 +145,20 @@ UpfOps UpfOpsList[] = {
         .term = Gtpv1Term,
         .termData = NULL,
     },
+    {
+        .name = "UPF - PFCP Xact",
+        .init = PfcpXactPoolInit,
+        .initData = NULL,
+        .term = PfcpXactPoolTerm,
+        .termData = NULL,
+    },
+    {
+        .name = "UPF - N4 Worker",
+        .init = N4WorkerInit,
+        .initData = NULL,
+        .term = N4WorkerTerm,
+        .termData = NULL,
+    },
     {
         .name = "UPF - PFCP",
         .init = PfcpInit,
@@ -130,6 +166,13 @@ UpfOps UpfOpsList[] = {
         .term = PfcpTerm,
         .termData = NULL,
     },
+    {
+        .name = "UPF - Memory Report",
+        .init = MemoryReport,
+        .initData = NULL,
+        .term = NULL,
+        .termData = NULL,
+    },
     // TODO: This part will be abstract as GtpEnvInit
     /*
     {
@@ -219,10 +262,49 @@ static Status ConfigHandle(void *data) {
     return STATUS_OK;
 }
 
+// Pools only take memory when they grow, so resident memory at startup is what they have used
+static Status MemoryReport(void *data) {
+    IndexPoolStat stat[MAX_NUM_OF_INDEX_POOL];
+    int num = IndexPoolStats(stat, MAX_NUM_OF_INDEX_POOL);
+    uint64_t memory = 0, reserved = 0;
+    unsigned long size = 0, resident = 0;
+
+    for (int i = 0; i < num; i++) {
+        memory += stat[i].memory;
+        reserved += stat[i].reserved;
+    }
+
+    FILE *statm = fopen("/proc/self/statm", "r");
+    if (statm) {
+        if (fscanf(statm, "%lu %lu", &size, &resident) != 2)
+            size = resident = 0;
+        fclose(statm);
+    }
+
+    IndexPoolReport();
+    BufblkPoolReport();
+    UTLT_Info("Memory: %lu KB resident of %lu KB virtual, pools use %lu KB and reserve %lu KB",
+        resident * getpagesize() / 1024, size * getpagesize() / 1024, memory / 1024, reserved / 1024);
+
+    return STATUS_OK;
+}
+
+static Status TimerExpireHandler(Sock *sock, void *data) {
+    return TimerExpireCheck(&Self()->timerServiceList, Self()->eventQ);
+}
+
 static Status EpollInit(void *data) {
     UTLT_Assert((Self()->epfd = EpollCreate()) >= 0,
         return STATUS_ERROR, "");
-    
+
+    // Timers are checked when the timerfd ticks instead of polling
+    Self()->timerSock.fd = TimerListGetFd(&Self()->timerServiceList);
+    UTLT_Assert(Self()->timerSock.fd >= 0, return STATUS_ERROR, "Timer list has no timerfd");
+    Self()->timerSock.handler = TimerExpireHandler;
+    SockSetEpollMode(&Self()->timerSock, EPOLLIN);
+    UTLT_Assert(EpollRegisterEvent(Self()->epfd, &Self()->timerSock) == STATUS_OK,
+        return STATUS_ERROR, "");
+
     return STATUS_OK;
 }
 
@@ -268,9 +350,6 @@ void PacketReceiverThread(ThreadID id, void *data) {
     int nfds;
     Sock *sockPtr;
     struct epoll_event events[MAX_NUM_OF_EVENT];
-    utime_t prev, now; // For timer checking purpose
-
-    prev = TimeNow();
 
     while (!ThreadStop()) {
         nfds = EpollWait(Self()->epfd, events, 300);
@@ -282,16 +361,6 @@ void PacketReceiverThread(ThreadID id, void *data) {
             // TODO : Log may show which socket
             UTLT_Assert(status == STATUS_OK, , "Error handling UP socket");
         }
-
-        // Check if timer expired
-        now = TimeNow();
-        if (now - prev > 10) {
-            TimerExpireCheck(
-                    &Self()->timerServiceList, Self()->eventQ);
-
-            prev = now;
-        }
-
     }
 
     sem_post(((Thread *)id)->semaphore);
@@ -303,6 +372,11 @@ void PacketReceiverThread(ThreadID id, void *data) {
 static Status Gtpv1Init(void *data) {
     Self()->upSock.fd = Gtpv1EnvInit(Self()->envParams);
     UTLT_Assert(Self()->upSock.fd != -1, return STATUS_OK, "");
+    if (!Self()->upSock.fd) {
+        // The device does not pass buffered packets up by UDP
+        Self()->upSock.fd = -1;
+        return STATUS_OK;
+    }
 
     socklen_t addrlen = 0;
     UTLT_Assert(getsockname(Self()->upSock.fd, &Self()->upSock.localAddr.sa, &addrlen) == 0,
@@ -333,24 +407,50 @@ static Status Gtpv1Term(void *data) {
     return status;
 }
 
+// Xacts held by N4 workers are freed when they stop, so the pool outlives them
+static Status PfcpXactPoolInit(void *data) {
+    UTLT_Assert(PfcpXactInit(&Self()->timerServiceList, UPF_EVENT_N4_T3_RESPONSE,
+                    UPF_EVENT_N4_T3_HOLDING, Self()->pfcpXactCap) == STATUS_OK,
+        return STATUS_ERROR, "");
+
+    return STATUS_OK;
+}
+
+static Status PfcpXactPoolTerm(void *data) {
+    // Xacts of N4 nodes are deleted with them
+    UTLT_Assert(PfcpRemoveAllNodes(&Self()->upfN4List) == STATUS_OK,
+        return STATUS_ERROR, "");
+    UTLT_Assert(PfcpXactTerminate() == STATUS_OK,
+        return STATUS_ERROR, "");
+
+    return STATUS_OK;
+}
+
+static Status N4WorkerInit(void *data) {
+    // Started before PFCP server, so no session message is handled by the node lane
+    UTLT_Assert(UpfN4WorkerInit(Self()->n4WorkerNum) == STATUS_OK,
+        return STATUS_ERROR, "");
+
+    return STATUS_OK;
+}
+
+static Status N4WorkerTerm(void *data) {
+    UTLT_Assert(UpfN4WorkerTerm() == STATUS_OK,
+        return STATUS_ERROR, "");
+
+    return STATUS_OK;
+}
+
 static Status PfcpInit(void *data) {
     Status status = STATUS_OK;
     UTLT_Assert(PfcpServerInit() == STATUS_OK,
         status |= STATUS_ERROR, "");
 
-    // init pfcp xact context
-    UTLT_Assert(PfcpXactInit(&Self()->timerServiceList,
-                    UPF_EVENT_N4_T3_RESPONSE, UPF_EVENT_N4_T3_HOLDING) == STATUS_OK,
-        status |= STATUS_ERROR, "");
-
     return status;
 }
 
 static Status PfcpTerm(void *data) {
     Status status = STATUS_OK;
-    UTLT_Assert(PfcpXactTerminate() == STATUS_OK,
-        status |= STATUS_ERROR, "");
-
     UTLT_Assert(PfcpServerTerminate() == STATUS_OK,
         status |= STATUS_ERROR, "");
 
@@ -0,0 +1,412 @@
+#define _GNU_SOURCE    // recvmmsg and sendmmsg
+#define TRACE_MODULE _gtpu_bench
+
+/*
+ * gtpu-bench - a stand-in gNB or DN loading the data path of UPF
+ *
+ * In "ran" mode it sends uplink GTP-U of each session to N3 of UPF and counts
+ * downlink GTP-U, and in "dn" mode it counts uplink packets at the DN address
+ * and sends downlink packets to each UE. Packets per second of both ways are
+ * reported after -t seconds.
+ *
+ * Sessions are those of pfcp-bench with -p 2 and -k: session i has UE IP
+ * 60.0.0.0 + i + 1, uplink TEID i * 4 + 1 and downlink TEID i * 4 + 2 to the
+ * local address of pfcp-bench, so run both at the address of gNB. See
+ * veth_bench.sh to run them on veth pairs with any UPDK backend.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include "utlt_debug.h"
+#include "utlt_netheader.h"
+#include "utlt_3gppTypes.h"
+
+#define GTPU_BENCH_PORT             9000    // UDP port of inner packets
+#define GTPU_BENCH_BATCH            32
+#define GTPU_BENCH_MAX_SIZE         1400
+#define GTPU_BENCH_UE_IP_BASE       0x3c000000  // 60.0.0.0/8, the same as pfcp-bench
+#define GTPU_BENCH_MAX_RULE         4           // TEIDs per session of pfcp-bench
+#define GTPU_BENCH_SOCK_BUF         (4 * 1024 * 1024)
+#define GTPU_BENCH_DRAIN_MSEC       500     // Wait for packets in flight after sending
+
+#define NSEC_PER_MSEC               1000000ULL
+#define NSEC_PER_SEC                1000000000ULL
+
+#define GTPV1_FLAGS                 0x30    // Version 1, GTP
+
+enum {
+    GTPU_BENCH_RAN = 0,
+    GTPU_BENCH_DN,
+};
+
+typedef struct {
+    uint8_t data[GTPU_BENCH_MAX_SIZE + GTPV1_HEADER_LEN + sizeof(IPv4Header) + sizeof(UDPHeader)];
+} BenchPacket;
+
+typedef struct {
+    uint64_t packets;
+    uint64_t bytes;
+} BenchCounter;
+
+static struct {
+    // Options
+    int         mode;
+    const char  *upfAddr;
+    const char  *localAddr;
+    const char  *dnAddr;
+    const char  *logLevel;
+    uint32_t    numOfSession;
+    uint32_t    size;           // UDP payload of inner packets
+    uint64_t    rate;
+    uint32_t    duration;       // sec
+
+    int         fd;
+    struct sockaddr_in upf;
+    struct in_addr localIp;
+    struct in_addr dnIp;
+    uint32_t    nextSession;
+
+    BenchPacket txPacket[GTPU_BENCH_BATCH];
+    BenchPacket rxPacket[GTPU_BENCH_BATCH];
+    struct mmsghdr txMsg[GTPU_BENCH_BATCH];
+    struct mmsghdr rxMsg[GTPU_BENCH_BATCH];
+    struct iovec txIov[GTPU_BENCH_BATCH];
+    struct iovec rxIov[GTPU_BENCH_BATCH];
+    struct sockaddr_in txAddr[GTPU_BENCH_BATCH];
+
+    BenchCounter sent;
+    BenchCounter received;
+    uint64_t    sendFail;
+    uint64_t    unexpected;
+} bench;
+
+static uint64_t BenchNow() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static uint16_t BenchIpChecksum(const IPv4Header *ip) {
+    const uint16_t *word = (const uint16_t *) ip;
+    uint32_t sum = 0;
+
+    for (size_t i = 0; i < sizeof(IPv4Header) / sizeof(uint16_t); i++)
+        sum += word[i];
+    sum = (sum & 0xffff) + (sum >> 16);
+    sum += sum >> 16;
+
+    return ~sum;
+}
+
+// Uplink T-PDU carrying UDP from the UE of @session to the DN address
+static uint16_t BenchBuildUplink(uint8_t *pkt, uint32_t session) {
+    Gtpv1Header *gtpHdr = (Gtpv1Header *) pkt;
+    IPv4Header *ip = (IPv4Header *) (pkt + GTPV1_HEADER_LEN);
+    UDPHeader *udp = (UDPHeader *) (ip + 1);
+    uint16_t ipLen = sizeof(IPv4Header) + sizeof(UDPHeader) + bench.size;
+
+    gtpHdr->flags = GTPV1_FLAGS;
+    gtpHdr->type = GTPV1_T_PDU;
+    gtpHdr->_length = htons(ipLen);
+    gtpHdr->_teid = htonl(session * GTPU_BENCH_MAX_RULE + 1);
+
+    memset(ip, 0, sizeof(IPv4Header));
+    ip->version = 4;
+    ip->ihl = sizeof(IPv4Header) / 4;
+    ip->totalLen = htons(ipLen);
+    ip->ttl = 64;
+    ip->proto = IPPROTO_UDP;
+    ip->saddr = htonl(GTPU_BENCH_UE_IP_BASE + session + 1);
+    ip->daddr = bench.dnIp.s_addr;
+    ip->check = BenchIpChecksum(ip);
+
+    udp->source = htons(GTPU_BENCH_PORT);
+    udp->dest = htons(GTPU_BENCH_PORT);
+    udp->len = htons(sizeof(UDPHeader) + bench.size);
+    udp->check = 0;
+
+    return GTPV1_HEADER_LEN + ipLen;
+}
+
+static void BenchSend(uint32_t num) {
+    for (uint32_t i = 0; i < num; i++) {
+        uint32_t session = bench.nextSession;
+        bench.nextSession = (bench.nextSession + 1) % bench.numOfSession;
+
+        if (bench.mode == GTPU_BENCH_RAN) {
+            bench.txIov[i].iov_len = BenchBuildUplink(bench.txPacket[i].data, session);
+            bench.txAddr[i] = bench.upf;
+        } else {
+            bench.txIov[i].iov_len = bench.size;
+            bench.txAddr[i].sin_family = AF_INET;
+            bench.txAddr[i].sin_addr.s_addr = htonl(GTPU_BENCH_UE_IP_BASE + session + 1);
+            bench.txAddr[i].sin_port = htons(GTPU_BENCH_PORT);
+        }
+    }
+
+    int sent = sendmmsg(bench.fd, bench.txMsg, num, MSG_DONTWAIT);
+    if (sent < 0) {
+        // Socket buffer is full, the rate is above what the path takes
+        bench.sendFail += num;
+        return;
+    }
+
+    bench.sent.packets += sent;
+    for (int i = 0; i < sent; i++)
+        bench.sent.bytes += bench.txIov[i].iov_len;
+    bench.sendFail += num - sent;
+}
+
+// Only downlink T-PDU of the sessions is expected in ran mode
+static int BenchCheck(const uint8_t *pkt, uint32_t len) {
+    if (bench.mode == GTPU_BENCH_DN)
+        return 1;
+
+    const Gtpv1Header *gtpHdr = (const Gtpv1Header *) pkt;
+    if (len < GTPV1_HEADER_LEN || (gtpHdr->flags & 0xE0) != 0x20 || gtpHdr->type != GTPV1_T_PDU)
+        return 0;
+
+    uint32_t teid = ntohl(gtpHdr->_teid);
+    return (teid % GTPU_BENCH_MAX_RULE == 2 && teid / GTPU_BENCH_MAX_RULE < bench.numOfSession);
+}
+
+// Return the number of received packets
+static int BenchReceive() {
+    int num = recvmmsg(bench.fd, bench.rxMsg, GTPU_BENCH_BATCH, MSG_DONTWAIT, NULL);
+    if (num <= 0)
+        return 0;
+
+    for (int i = 0; i < num; i++) {
+        if (BenchCheck(bench.rxPacket[i].data, bench.rxMsg[i].msg_len)) {
+            bench.received.packets++;
+            bench.received.bytes += bench.rxMsg[i].msg_len;
+        } else {
+            bench.unexpected++;
+        }
+    }
+
+    return num;
+}
+
+static void BenchRun(uint64_t *elapsed) {
+    struct pollfd pfd = {.fd = bench.fd, .events = POLLIN};
+    uint64_t start = BenchNow(), now = start, lastReport = start;
+    uint64_t end = start + bench.duration * NSEC_PER_SEC;
+    BenchCounter lastSent = bench.sent, lastReceived = bench.received;
+
+    while (now < end) {
+        uint32_t num = GTPU_BENCH_BATCH;
+        if (bench.rate) {
+            uint64_t allowed = bench.rate * (now - start) / NSEC_PER_SEC;
+            uint64_t done = bench.sent.packets + bench.sendFail;
+            num = (allowed > done ? (allowed - done < num ? allowed - done : num) : 0);
+        }
+        if (num)
+            BenchSend(num);
+
+        int received = 0, got;
+        for (int i = 0; i < 4 && (got = BenchReceive()) > 0; i++)
+            received += got;
+
+        // Wait for packets or the next slot of the rate
+        if (!num && !received)
+            poll(&pfd, 1, 1);
+
+        now = BenchNow();
+        if (now - lastReport >= NSEC_PER_SEC) {
+            printf("[%4.0f s] sent %10.0f pkt/s, received %10.0f pkt/s\n",
+                   (double) (now - start) / NSEC_PER_SEC,
+                   (double) (bench.sent.packets - lastSent.packets) * NSEC_PER_SEC / (now - lastReport),
+                   (double) (bench.received.packets - lastReceived.packets) * NSEC_PER_SEC / (now - lastReport));
+            fflush(stdout);
+            lastSent = bench.sent;
+            lastReceived = bench.received;
+            lastReport = now;
+        }
+    }
+    *elapsed = now - start;
+
+    // Packets in flight of the peer are still counted
+    end = now + GTPU_BENCH_DRAIN_MSEC * NSEC_PER_MSEC;
+    while (BenchNow() < end) {
+        if (poll(&pfd, 1, GTPU_BENCH_DRAIN_MSEC) > 0)
+            while (BenchReceive() > 0);
+    }
+}
+
+static void BenchReportLine(const char *name, const BenchCounter *counter, uint64_t elapsed) {
+    printf("%-22s %12lu %12.0f %10.1f\n", name, counter->packets,
+           (double) counter->packets * NSEC_PER_SEC / elapsed,
+           (double) counter->bytes * 8 * NSEC_PER_SEC / elapsed / 1000000);
+}
+
+static void BenchReport(uint64_t elapsed) {
+    int ran = (bench.mode == GTPU_BENCH_RAN);
+
+    printf("\n%s at %s, %u sessions, %u bytes UDP payload, %.3f s\n\n",
+           (ran ? "gNB" : "DN"), bench.localAddr, bench.numOfSession, bench.size,
+           (double) elapsed / NSEC_PER_SEC);
+    printf("%-22s %12s %12s %10s\n", "Direction", "Packets", "Packets/s", "Mbit/s");
+    BenchReportLine((ran ? "Uplink sent" : "Downlink sent"), &bench.sent, elapsed);
+    BenchReportLine((ran ? "Downlink received" : "Uplink received"), &bench.received, elapsed);
+
+    if (bench.sendFail)
+        printf("\n%lu packets are not sent since socket buffer is full\n", bench.sendFail);
+    if (bench.unexpected)
+        printf("\n%lu unexpected packets are dropped\n", bench.unexpected);
+}
+
+static void BenchUsage(const char *name) {
+    printf("Usage: %s [options]\n"
+           "  -m mode     ran to send uplink GTP-U, or dn to send downlink IP (default: ran)\n"
+           "  -u addr     N3 address of UPF in ran mode (default: %s)\n"
+           "  -l addr     Local address, gNB binds GTP-U port %d and DN binds port %d (default: %s)\n"
+           "  -d addr     DN address of uplink packets in ran mode (default: %s)\n"
+           "  -s num      Sessions established by pfcp-bench (default: %u)\n"
+           "  -b bytes    UDP payload of inner packets, at most %d (default: %u)\n"
+           "  -r rate     Packets per second, 0 as fast as possible (default: %lu)\n"
+           "  -t sec      Seconds to send (default: %u)\n"
+           "  -v level    Log level (default: %s)\n"
+           "  -h          Show this help\n",
+           name, bench.upfAddr, GTPV1_U_UDP_PORT, GTPU_BENCH_PORT, bench.localAddr, bench.dnAddr,
+           bench.numOfSession, GTPU_BENCH_MAX_SIZE, bench.size, bench.rate, bench.duration, bench.logLevel);
+}
+
+static Status BenchParseArgs(int argc, char *argv[]) {
+    int opt;
+
+    bench.mode = GTPU_BENCH_RAN;
+    bench.upfAddr = "127.0.0.8";
+    bench.localAddr = "127.0.0.1";
+    bench.dnAddr = "127.0.0.1";
+    bench.logLevel = "warning";
+    bench.numOfSession = 16;
+    bench.size = 64;
+    bench.rate = 0;
+    bench.duration = 10;
+
+    while ((opt = getopt(argc, argv, "m:u:l:d:s:b:r:t:v:h")) != -1) {
+        switch (opt) {
+            case 'm':
+                if (!strcmp(optarg, "ran")) {
+                    bench.mode = GTPU_BENCH_RAN;
+                } else if (!strcmp(optarg, "dn")) {
+                    bench.mode = GTPU_BENCH_DN;
+                } else {
+                    UTLT_Error("Mode should be ran or dn, not %s", optarg);
+                    return STATUS_ERROR;
+                }
+                break;
+            case 'u':
+                bench.upfAddr = optarg;
+                break;
+            case 'l':
+                bench.localAddr = optarg;
+                break;
+            case 'd':
+                bench.dnAddr = optarg;
+                break;
+            case 's':
+                bench.numOfSession = strtoul(optarg, NULL, 0);
+                break;
+            case 'b':
+                bench.size = strtoul(optarg, NULL, 0);
+                break;
+            case 'r':
+                bench.rate = strtoull(optarg, NULL, 0);
+                break;
+            case 't':
+                bench.duration = strtoul(optarg, NULL, 0);
+                break;
+            case 'v':
+                bench.logLevel = optarg;
+                break;
+            case 'h':
+            default:
+                BenchUsage(argv[0]);
+                return STATUS_ERROR;
+        }
+    }
+
+    UTLT_Assert(bench.numOfSession > 0 && bench.numOfSession < 0xFFFF, return STATUS_ERROR,
+                "Sessions should be 1 to %u", 0xFFFE);
+    UTLT_Assert(bench.size >= sizeof(uint32_t) && bench.size <= GTPU_BENCH_MAX_SIZE, return STATUS_ERROR,
+                "UDP payload should be %zu to %d bytes", sizeof(uint32_t), GTPU_BENCH_MAX_SIZE);
+    UTLT_Assert(bench.duration > 0, return STATUS_ERROR, "Seconds to send should be positive");
+
+    return STATUS_OK;
+}
+
+static Status BenchInit() {
+    struct sockaddr_in local = {.sin_family = AF_INET};
+    int bufSize = GTPU_BENCH_SOCK_BUF;
+
+    UTLT_Assert(inet_pton(AF_INET, bench.localAddr, &bench.localIp) == 1, return STATUS_ERROR,
+                "Local address %s is not IPv4", bench.localAddr);
+    UTLT_Assert(inet_pton(AF_INET, bench.dnAddr, &bench.dnIp) == 1, return STATUS_ERROR,
+                "DN address %s is not IPv4", bench.dnAddr);
+    bench.upf.sin_family = AF_INET;
+    bench.upf.sin_port = htons(GTPV1_U_UDP_PORT);
+    UTLT_Assert(inet_pton(AF_INET, bench.upfAddr, &bench.upf.sin_addr) == 1, return STATUS_ERROR,
+                "UPF address %s is not IPv4", bench.upfAddr);
+
+    bench.fd = socket(AF_INET, SOCK_DGRAM, 0);
+    UTLT_Assert(bench.fd >= 0, return STATUS_ERROR, "Socket create fail: %s", strerror(errno));
+    setsockopt(bench.fd, SOL_SOCKET, SO_RCVBUF, &bufSize, sizeof(bufSize));
+    setsockopt(bench.fd, SOL_SOCKET, SO_SNDBUF, &bufSize, sizeof(bufSize));
+
+    local.sin_addr = bench.localIp;
+    local.sin_port = htons(bench.mode == GTPU_BENCH_RAN ? GTPV1_U_UDP_PORT : GTPU_BENCH_PORT);
+    UTLT_Assert(bind(bench.fd, (struct sockaddr *) &local, sizeof(local)) == 0, return STATUS_ERROR,
+                "Bind %s:%d fail: %s", bench.localAddr, ntohs(local.sin_port), strerror(errno));
+
+    // Payload of DN mode is sent as it is, so it is filled once
+    for (int i = 0; i < GTPU_BENCH_BATCH; i++) {
+        memset(bench.txPacket[i].data, 0xA5, sizeof(bench.txPacket[i].data));
+
+        bench.txIov[i].iov_base = bench.txPacket[i].data;
+        bench.txMsg[i].msg_hdr.msg_name = &bench.txAddr[i];
+        bench.txMsg[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+        bench.txMsg[i].msg_hdr.msg_iov = &bench.txIov[i];
+        bench.txMsg[i].msg_hdr.msg_iovlen = 1;
+
+        bench.rxIov[i].iov_base = bench.rxPacket[i].data;
+        bench.rxIov[i].iov_len = sizeof(bench.rxPacket[i].data);
+        bench.rxMsg[i].msg_hdr.msg_iov = &bench.rxIov[i];
+        bench.rxMsg[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    return STATUS_OK;
+}
+
+int main(int argc, char *argv[]) {
+    uint64_t elapsed = 0;
+
+    bench.fd = -1;
+    if (BenchParseArgs(argc, argv) != STATUS_OK)
+        return EXIT_FAILURE;
+    UTLT_Assert(UTLT_SetLogLevel(bench.logLevel) == STATUS_OK, return EXIT_FAILURE,
+                "Log level %s is not supported", bench.logLevel);
+    UTLT_Assert(BenchInit() == STATUS_OK, goto term, "Init fail");
+
+    BenchRun(&elapsed);
+    BenchReport(elapsed);
+
+    close(bench.fd);
+    return EXIT_SUCCESS;
+
+term:
+    if (bench.fd >= 0)
+        close(bench.fd);
+
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,89 @@
+#!/bin/bash
+# Load the data path of UPF by gtpu-bench on veth pairs:
+#
+#   [ran] ran0 10.100.0.2 --- n3 10.100.0.1 [upf] n6 10.200.0.1 --- dn0 10.200.0.2 [dn]
+#
+# UPF runs in namespace "upf" with the UPDK module it is built with, so the
+# same run measures "xdp" and "kernel" (gtp5g, which shall be loaded). Sessions
+# are set up by pfcp-bench in namespace "ran", which is also gNB.
+#
+# Usage: sudo ./veth_bench.sh [bin dir] [sessions] [seconds] [payload bytes] [packets/s] [UPDK receivers]
+
+BIN_DIR=$(realpath ${1:-$(dirname $0)/../../build/bin})
+SESSION=${2:-4}
+SECOND=${3:-10}
+SIZE=${4:-64}
+RATE=${5:-0}
+RECEIVER=${6:-0}
+
+WORK_DIR=$(mktemp -d)
+EXEC_RAN="ip netns exec ran"
+EXEC_UPF="ip netns exec upf"
+EXEC_DN="ip netns exec dn"
+
+cleanup() {
+    ${EXEC_UPF} pkill -INT free5gc-upfd
+    sleep 1
+    ip netns del ran 2>/dev/null
+    ip netns del upf 2>/dev/null
+    ip netns del dn 2>/dev/null
+}
+trap cleanup EXIT
+
+for ns in ran upf dn; do
+    ip netns add ${ns}
+    ip netns exec ${ns} ip link set lo up
+done
+
+ip link add ran0 netns ran type veth peer name n3 netns upf
+ip link add dn0 netns dn type veth peer name n6 netns upf
+
+${EXEC_RAN} ip addr add 10.100.0.2/24 dev ran0
+${EXEC_RAN} ip link set ran0 up
+${EXEC_UPF} ip addr add 10.100.0.1/24 dev n3
+${EXEC_UPF} ip addr add 10.200.0.1/24 dev n6
+${EXEC_UPF} ip link set n3 up
+${EXEC_UPF} ip link set n6 up
+${EXEC_UPF} sysctl -qw net.ipv4.ip_forward=1
+${EXEC_DN} ip addr add 10.200.0.2/24 dev dn0
+${EXEC_DN} ip link set dn0 up
+${EXEC_DN} ip route add 60.0.0.0/16 via 10.200.0.1
+
+cat > ${WORK_DIR}/upfcfg.yaml <<CFG
+info:
+  version: 1.0.0
+  description: UPF configuration of veth_bench.sh
+
+configuration:
+  debugLevel: info
+  ReportCaller: false
+  updkReceiver: ${RECEIVER}
+
+  pfcp:
+    - addr: 10.100.0.1
+
+  gtpu:
+    - addr: 10.100.0.1
+
+  dnn_list:
+    - dnn: internet
+      cidr: 60.0.0.0/16
+      natifname: n6
+CFG
+
+${EXEC_UPF} ${BIN_DIR}/free5gc-upfd -f ${WORK_DIR}/upfcfg.yaml > ${WORK_DIR}/upf.log 2>&1 &
+sleep 2
+
+# Each session is established and then its downlink is forwarded to gNB
+${EXEC_RAN} ${BIN_DIR}/pfcp-bench -u 10.100.0.1 -l 10.100.0.2 -s ${SESSION} -n $((SESSION * 2)) \
+    -m 0:1:1:0 -p 2 -w 8 -k || exit 1
+
+${EXEC_DN} ${BIN_DIR}/gtpu-bench -m dn -l 10.200.0.2 -s ${SESSION} -b ${SIZE} -r ${RATE} -t ${SECOND} \
+    > ${WORK_DIR}/dn.log &
+${EXEC_RAN} ${BIN_DIR}/gtpu-bench -m ran -u 10.100.0.1 -l 10.100.0.2 -d 10.200.0.2 -s ${SESSION} \
+    -b ${SIZE} -r ${RATE} -t ${SECOND}
+wait %2 2>/dev/null
+cat ${WORK_DIR}/dn.log
+
+echo
+echo "Logs of UPF are in ${WORK_DIR}/upf.log"
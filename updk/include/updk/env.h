@@ -30,7 +30,7 @@ typedef struct {
  * 
  * @pkt: L3 packet pointer receiving from UP interface
  * @pktlen: Total length of @pkt
- * @bufPDR: An allocated space to get the matched UPDK_PDR
+ * @bufPDR: An allocated UPDK_PDRView to get the matched PDR
  * @return: 1 if packet is passed by UPF, 0 if packet is matched any rule or -1 if packet is mismatched
  */
 typedef int (*L3PacketInHandlerCB)(uint8_t *pkt, uint16_t pktlen, void *bufPDR);
@@ -42,7 +42,7 @@ typedef int (*L3PacketInHandlerCB)(uint8_t *pkt, uint16_t pktlen, void *bufPDR);
  * @pktlen: Total length of @pkt
  * @remoteIP: Sender IPv4 address with network type
  * @_remotePort: Sender port with network type 
- * @bufPDR: An allocated space to get the matched UPDK_PDR
+ * @bufPDR: An allocated UPDK_PDRView to get the matched PDR
  * @return: 1 if packet is passed by UPF, 0 if packet is matched any rule or -1 if packet is mismatched
  */
 typedef int (*GTPUPacketInHandlerCB)(uint8_t *pkt, uint16_t pktlen, uint32_t remoteIP, uint16_t _remotePort, void *bufPDR);
@@ -50,20 +50,22 @@ typedef int (*GTPUPacketInHandlerCB)(uint8_t *pkt, uint16_t pktlen, uint32_t rem
 /**
  * GetRule16CB - Callback function for getting rule which ID is uint16_t
  * 
+ * @seid: UP F-SEID of the session, rule IDs are only unique in a session
  * @id: Rule ID which is uint16_t
  * @ruleBuf: An allocated space to get the designated rule
  * @return: 0 or -1 if UPF cannot find the designated rule
  */
-typedef int (*GetRule16CB)(uint16_t id, void *ruleBuf);
+typedef int (*GetRule16CB)(uint64_t seid, uint16_t id, void *ruleBuf);
 
 /**
  * GetRule32CB - Callback function for getting rule which ID is uint32_t
  * 
+ * @seid: UP F-SEID of the session, rule IDs are only unique in a session
  * @id: Rule ID which is uint32_t
  * @ruleBuf: An allocated space to get the designated rule
  * @return: 0 or -1 if UPF cannot find the designated rule
  */
-typedef int (*GetRule32CB)(uint32_t id, void *ruleBuf);
+typedef int (*GetRule32CB)(uint64_t seid, uint32_t id, void *ruleBuf);
 
 /**
  * VirtualPort - Structure for Interface in Device, like switch port
@@ -83,6 +85,7 @@ typedef struct {
  *
  * @deviceID: tuntap name or NULL if it is DPDK
  * @virtualPortList: the first node for linked-list
+ * @receiverNum: threads receiving packets from device, 0 is one per CPU
  * @EventCB.packetIn: function pointer when packet in or NULL if do not handle this event
  * @EventCB.getPDR: function pointer uesd to get PDR by ID
  * @EventCB.getFAR: function pointer uesd to get FAR by ID
@@ -95,6 +98,8 @@ typedef struct {
 
     struct list_head virtualPortList;
 
+    int receiverNum;
+
     struct {
         // TODO: param and return value of the function pointer have not finished yet
         L3PacketInHandlerCB PacketInL3;
@@ -168,6 +173,15 @@ void FreeVirtualDevice(VirtualDevice *dev);
  */
 void VirtualDeviceAddPort(VirtualDevice *dev, VirtualPort *port);
 
+/**
+ * VirtualDeviceReceiverNum - Get the number of receiver threads of VirtualDevice
+ * 
+ * @dev: VirtualDevice pointer whose receiverNum is 0 for one per CPU
+ * @max: The most threads the device supports
+ * @return: a number between 1 and @max
+ */
+int VirtualDeviceReceiverNum(VirtualDevice *dev, int max);
+
 /**
  * VirtualDeviceForEachVirtualPort - iterate VirtualPort over a VirtualDevice
  * @port:	the &VirtualPort to use as a loop cursor
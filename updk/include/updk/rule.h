@@ -11,6 +11,24 @@
  * in there, like "device.c" under "updk/src/kernel/include"
  */
 
+/**
+ * Gtpv1TunnelTransactionBegin - UPF receives a PFCP request which creates, updates or removes rules
+ *
+ * The rule functions called on the same thread until Gtpv1TunnelTransactionCommit
+ * may be applied to the device together. Their return value only tells whether
+ * the rule is accepted, the device may still reject it at commit.
+ *
+ * @return: 0 or -1 if one of part is failed
+ */
+int Gtpv1TunnelTransactionBegin();
+
+/**
+ * Gtpv1TunnelTransactionCommit - UPF finishes all rules in the PFCP request
+ *
+ * @return: 0 or -1 if one of rules since Gtpv1TunnelTransactionBegin is failed
+ */
+int Gtpv1TunnelTransactionCommit();
+
 /**
  * Gtpv1TunnelCreatePDR - UPF receive CreatePDR in PFCP and it will call this function
  * 
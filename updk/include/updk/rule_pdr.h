@@ -2,8 +2,12 @@
 #define __UPDK_RULE_PDR_H__
 
 #include <stdint.h>
+#include <stddef.h>
 #include <arpa/inet.h>
 
+#include "updk/rule_far.h"
+#include "updk/rule_qer.h"
+
 /**
  * These IEs is save as TV type (Tag and Value). Tag is to defined if
  * this IE is existed and Value is to store this IE.
@@ -257,4 +261,60 @@ typedef struct {
     char     deactivatePredefinedRules[0x40];
 } UPDK_PDR;
 
+/**
+ * UPDK_PDRView - Fields of UPDK_PDR used to handle a matched packet
+ *
+ * It is filled when the PDR is installed, so handling a packet does NOT
+ * touch or copy the PFCP-derived fields like PDI.
+ *
+ * @flags.*: 1 or 0 if the IE under PDR is not existed
+ * @far: FAR of @farId in the same session, NULL if it is not installed
+ * @qer: QER of @qerId[0] in the same session, NULL if it is not installed
+ * @others: The same as UPDK_PDR
+ *
+ * @far and @qer are linked by UPF, so a packet is handled without finding
+ * rules by ID. They are only valid in the RCU read-side critical section
+ * where the view is got, even on a copy of the view.
+ */
+typedef struct {
+    struct {
+        uint8_t outerHeaderRemoval:1;
+        uint8_t farId:1;
+        uint8_t urrId:1;
+        uint8_t qerId:1;
+        uint8_t spare:4;
+    } flags;
+
+    uint8_t  outerHeaderRemoval;
+    uint16_t pdrId;
+    uint32_t precedence;
+    uint32_t farId;
+    uint32_t urrId;
+    uint32_t qerId[4];
+    uint64_t seid;
+
+    const UPDK_FAR *far;
+    const UPDK_QER *qer;
+} UPDK_PDRView;
+
+static inline void UPDK_PDRViewFill(UPDK_PDRView *view, const UPDK_PDR *pdr) {
+    view->flags.outerHeaderRemoval = pdr->flags.outerHeaderRemoval;
+    view->flags.farId = pdr->flags.farId;
+    view->flags.urrId = pdr->flags.urrId;
+    view->flags.qerId = pdr->flags.qerId;
+    view->flags.spare = 0;
+
+    view->outerHeaderRemoval = pdr->outerHeaderRemoval;
+    view->pdrId = pdr->pdrId;
+    view->precedence = pdr->precedence;
+    view->farId = pdr->farId;
+    view->urrId = pdr->urrId;
+    for (int i = 0; i < sizeof(view->qerId) / sizeof(uint32_t); i++)
+        view->qerId[i] = pdr->qerId[i];
+    view->seid = pdr->seid;
+
+    view->far = NULL;
+    view->qer = NULL;
+}
+
 #endif /* __UPDK_RULE_PDR_H__ */
\ No newline at end of file
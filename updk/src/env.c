@@ -1,6 +1,7 @@
 #include "updk/env.h"
 
 #include <stdlib.h>
+#include <unistd.h>
 
 #include "linux/list.h"
 
@@ -44,6 +45,17 @@ void VirtualDeviceAddPort(VirtualDevice *dev, VirtualPort *port) {
     list_add_tail((struct list_head *) port, (struct list_head *) &dev->virtualPortList);
 }
 
+int VirtualDeviceReceiverNum(VirtualDevice *dev, int max) {
+    int num = dev->receiverNum;
+
+    if (num <= 0)
+        num = sysconf(_SC_NPROCESSORS_ONLN);
+    if (num > max)
+        num = max;
+
+    return (num > 0 ? num : 1);
+}
+
 DNN *AllocDNN() {
     DNN *rt = calloc(1, sizeof(DNN));
     if (rt)
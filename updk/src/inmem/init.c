@@ -0,0 +1,32 @@
+#include "updk/init.h"
+
+/*
+ * These functions shall be customized by kinds of device.
+ * You can create a directory and put all customized function
+ * in there, like "device.c" under "updk/src/kernel/".
+ */
+
+#include "utlt_debug.h"
+
+#include "updk/env.h"
+#include "inmem_context.h"
+
+int Gtpv1EnvInit(EnvParams *env) {
+    UTLT_Assert(env, return -1, "EnvParams is NULL");
+    UTLT_Assert(env->virtualDevice, return -1, "VirtualDevice is NULL");
+
+    UTLT_Assert(InmemDeviceInit() == STATUS_OK, return -1, "InmemDeviceInit failed");
+
+    UTLT_Warning("In-memory UPDK device: rules are kept in user space but no packet is forwarded");
+
+    // No UDP socket for buffering
+    return 0;
+}
+
+int Gtpv1EnvTerm(EnvParams *env) {
+    UTLT_Assert(env, return -1, "EnvParams is NULL");
+
+    UTLT_Assert(InmemDeviceTerm() == STATUS_OK, return -1, "InmemDeviceTerm failed");
+
+    return 0;
+}
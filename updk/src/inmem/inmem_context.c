@@ -0,0 +1,237 @@
+#include "inmem_context.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#define INMEM_TABLE_MIN_BUCKET      1024
+
+typedef struct _InmemEntry {
+    struct _InmemEntry *next;
+    uint64_t        seid;
+    uint32_t        id;
+    uint8_t         rule[];
+} InmemEntry;
+
+// Chained hash table, it doubles when entries are more than buckets
+typedef struct {
+    InmemEntry      **bucket;
+    uint32_t        numOfBucket;
+    size_t          sizeOfRule;
+} InmemTable;
+
+static struct {
+    InmemTable      table[INMEM_RULE_MAX];
+    InmemCounter    counter;
+    pthread_mutex_t lock;
+} inmemDevice;
+
+static const char *inmemRuleName[INMEM_RULE_MAX] = {"PDR", "FAR", "QER"};
+
+static uint32_t InmemHash(uint64_t seid, uint32_t id) {
+    uint64_t key = (seid * 0x9E3779B97F4A7C15ULL) ^ id;
+    return (uint32_t) ((key * 0x9E3779B97F4A7C15ULL) >> 32);
+}
+
+static Status InmemTableInit(InmemTable *table, size_t sizeOfRule) {
+    table->bucket = calloc(INMEM_TABLE_MIN_BUCKET, sizeof(InmemEntry *));
+    UTLT_Assert(table->bucket, return STATUS_ERROR, "No space to alloc in-memory table");
+    table->numOfBucket = INMEM_TABLE_MIN_BUCKET;
+    table->sizeOfRule = sizeOfRule;
+
+    return STATUS_OK;
+}
+
+static void InmemTableTerm(InmemTable *table) {
+    for (uint32_t i = 0; table->bucket && i < table->numOfBucket; i++) {
+        InmemEntry *entry = table->bucket[i], *next;
+        for (; entry; entry = next) {
+            next = entry->next;
+            free(entry);
+        }
+    }
+    free(table->bucket);
+    memset(table, 0, sizeof(InmemTable));
+}
+
+// Return the link pointing to the entry, or to the NULL at the end of its chain
+static InmemEntry **InmemTableFind(InmemTable *table, uint64_t seid, uint32_t id) {
+    InmemEntry **link = &table->bucket[InmemHash(seid, id) & (table->numOfBucket - 1)];
+
+    while (*link && ((*link)->seid != seid || (*link)->id != id))
+        link = &(*link)->next;
+
+    return link;
+}
+
+// Keep the old table if there is no space, it still works with longer chains
+static void InmemTableGrow(InmemTable *table) {
+    uint32_t numOfBucket = table->numOfBucket * 2;
+    InmemEntry **bucket = calloc(numOfBucket, sizeof(InmemEntry *));
+    UTLT_Assert(bucket, return, "No space to grow in-memory table to %u", numOfBucket);
+
+    for (uint32_t i = 0; i < table->numOfBucket; i++) {
+        InmemEntry *entry = table->bucket[i], *next;
+        for (; entry; entry = next) {
+            next = entry->next;
+            InmemEntry **head = &bucket[InmemHash(entry->seid, entry->id) & (numOfBucket - 1)];
+            entry->next = *head;
+            *head = entry;
+        }
+    }
+
+    free(table->bucket);
+    table->bucket = bucket;
+    table->numOfBucket = numOfBucket;
+}
+
+Status InmemDeviceInit() {
+    static const size_t sizeOfRule[INMEM_RULE_MAX] = {
+        sizeof(UPDK_PDR), sizeof(UPDK_FAR), sizeof(UPDK_QER),
+    };
+
+    memset(&inmemDevice, 0, sizeof(inmemDevice));
+    pthread_mutex_init(&inmemDevice.lock, 0);
+
+    for (int kind = 0; kind < INMEM_RULE_MAX; kind++) {
+        UTLT_Assert(InmemTableInit(&inmemDevice.table[kind], sizeOfRule[kind]) == STATUS_OK,
+                    InmemDeviceTerm(); return STATUS_ERROR,
+                    "In-memory %s table init fail", inmemRuleName[kind]);
+    }
+
+    return STATUS_OK;
+}
+
+Status InmemDeviceTerm() {
+    InmemCounter *counter = &inmemDevice.counter;
+
+    UTLT_Info("In-memory device: %lu transactions", counter->transaction);
+    for (int kind = 0; kind < INMEM_RULE_MAX; kind++) {
+        InmemRuleCounter *rule = &counter->rule[kind];
+        UTLT_Info("In-memory device %s: %lu left, %lu created, %lu updated, %lu removed, %lu failed",
+                  inmemRuleName[kind], rule->num, rule->create, rule->update, rule->remove, rule->fail);
+        InmemTableTerm(&inmemDevice.table[kind]);
+    }
+    pthread_mutex_destroy(&inmemDevice.lock);
+
+    return STATUS_OK;
+}
+
+int InmemRuleCreate(int kind, uint64_t seid, uint32_t id, const void *rule) {
+    InmemTable *table = &inmemDevice.table[kind];
+    InmemRuleCounter *counter = &inmemDevice.counter.rule[kind];
+    InmemEntry **link, *entry;
+    int ret = -1;
+
+    pthread_mutex_lock(&inmemDevice.lock);
+    link = InmemTableFind(table, seid, id);
+    UTLT_Assert(!*link, goto out, "%s ID[%u] of SEID[0x%lx] does exist in device",
+                inmemRuleName[kind], id, seid);
+
+    entry = malloc(sizeof(InmemEntry) + table->sizeOfRule);
+    UTLT_Assert(entry, goto out, "No space to alloc %s ID[%u]", inmemRuleName[kind], id);
+    entry->next = NULL;
+    entry->seid = seid;
+    entry->id = id;
+    memcpy(entry->rule, rule, table->sizeOfRule);
+    *link = entry;
+
+    counter->create++;
+    if (++counter->num > table->numOfBucket)
+        InmemTableGrow(table);
+    ret = 0;
+
+out:
+    if (ret)
+        counter->fail++;
+    pthread_mutex_unlock(&inmemDevice.lock);
+
+    return ret;
+}
+
+int InmemRuleUpdate(int kind, uint64_t seid, uint32_t id, const void *rule) {
+    InmemTable *table = &inmemDevice.table[kind];
+    InmemRuleCounter *counter = &inmemDevice.counter.rule[kind];
+    InmemEntry *entry;
+    int ret = -1;
+
+    pthread_mutex_lock(&inmemDevice.lock);
+    entry = *InmemTableFind(table, seid, id);
+    UTLT_Assert(entry, goto out, "%s ID[%u] of SEID[0x%lx] does NOT exist in device",
+                inmemRuleName[kind], id, seid);
+
+    // UPF passes the whole rule with the updated IEs
+    memcpy(entry->rule, rule, table->sizeOfRule);
+    counter->update++;
+    ret = 0;
+
+out:
+    if (ret)
+        counter->fail++;
+    pthread_mutex_unlock(&inmemDevice.lock);
+
+    return ret;
+}
+
+int InmemRuleRemove(int kind, uint64_t seid, uint32_t id) {
+    InmemTable *table = &inmemDevice.table[kind];
+    InmemRuleCounter *counter = &inmemDevice.counter.rule[kind];
+    InmemEntry **link, *entry;
+    int ret = -1;
+
+    pthread_mutex_lock(&inmemDevice.lock);
+    link = InmemTableFind(table, seid, id);
+    entry = *link;
+    UTLT_Assert(entry, goto out, "%s ID[%u] of SEID[0x%lx] does NOT exist in device",
+                inmemRuleName[kind], id, seid);
+
+    *link = entry->next;
+    free(entry);
+    counter->num--;
+    counter->remove++;
+    ret = 0;
+
+out:
+    if (ret)
+        counter->fail++;
+    pthread_mutex_unlock(&inmemDevice.lock);
+
+    return ret;
+}
+
+void InmemTransactionCount() {
+    pthread_mutex_lock(&inmemDevice.lock);
+    inmemDevice.counter.transaction++;
+    pthread_mutex_unlock(&inmemDevice.lock);
+}
+
+void InmemCounterGet(InmemCounter *counter) {
+    pthread_mutex_lock(&inmemDevice.lock);
+    memcpy(counter, &inmemDevice.counter, sizeof(InmemCounter));
+    pthread_mutex_unlock(&inmemDevice.lock);
+}
+
+static int InmemRuleGet(int kind, uint64_t seid, uint32_t id, void *rule) {
+    InmemTable *table = &inmemDevice.table[kind];
+    InmemEntry *entry;
+
+    pthread_mutex_lock(&inmemDevice.lock);
+    entry = *InmemTableFind(table, seid, id);
+    if (entry)
+        memcpy(rule, entry->rule, table->sizeOfRule);
+    pthread_mutex_unlock(&inmemDevice.lock);
+
+    return (entry ? 0 : -1);
+}
+
+int InmemPDRGet(uint64_t seid, uint16_t pdrId, UPDK_PDR *pdr) {
+    return InmemRuleGet(INMEM_RULE_PDR, seid, pdrId, pdr);
+}
+
+int InmemFARGet(uint64_t seid, uint32_t farId, UPDK_FAR *far) {
+    return InmemRuleGet(INMEM_RULE_FAR, seid, farId, far);
+}
+
+int InmemQERGet(uint64_t seid, uint32_t qerId, UPDK_QER *qer) {
+    return InmemRuleGet(INMEM_RULE_QER, seid, qerId, qer);
+}
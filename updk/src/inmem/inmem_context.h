@@ -0,0 +1,88 @@
+#ifndef __INMEM_CONTEXT_H__
+#define __INMEM_CONTEXT_H__
+
+/*
+ * This file would be included when the UP part runs with the in-memory
+ * device, otherwise it will not be used.
+ *
+ * The device keeps a copy of every rule in tables of user space and counts
+ * the rule operations, so UPF control plane can run without gtp5g and root,
+ * e.g. for N4 benchmarks and profiling. No packet is forwarded.
+ */
+
+#include <stdint.h>
+
+#include "utlt_debug.h"
+
+#include "updk/rule_pdr.h"
+#include "updk/rule_far.h"
+#include "updk/rule_qer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+enum {
+    INMEM_RULE_PDR = 0,
+    INMEM_RULE_FAR,
+    INMEM_RULE_QER,
+
+    INMEM_RULE_MAX,
+};
+
+/**
+ * InmemRuleCounter - Counters of one kind of rule
+ *
+ * @num: Rules in the table now
+ * @create, @update, @remove: Accepted operations
+ * @fail: Rejected operations, e.g. creating an existed rule
+ */
+typedef struct {
+    uint64_t num;
+    uint64_t create;
+    uint64_t update;
+    uint64_t remove;
+    uint64_t fail;
+} InmemRuleCounter;
+
+/**
+ * InmemCounter - Counters of the in-memory device
+ *
+ * @rule: Counters indexed by INMEM_RULE_*
+ * @transaction: Committed transactions, one per PFCP request with rules
+ */
+typedef struct {
+    InmemRuleCounter rule[INMEM_RULE_MAX];
+    uint64_t transaction;
+} InmemCounter;
+
+Status InmemDeviceInit();
+Status InmemDeviceTerm();
+
+// Rules are keyed by SEID and rule ID
+int InmemRuleCreate(int kind, uint64_t seid, uint32_t id, const void *rule);
+int InmemRuleUpdate(int kind, uint64_t seid, uint32_t id, const void *rule);
+int InmemRuleRemove(int kind, uint64_t seid, uint32_t id);
+void InmemTransactionCount();
+
+/**
+ * InmemCounterGet - Take a snapshot of counters
+ *
+ * @counter: An allocated space to get counters
+ */
+void InmemCounterGet(InmemCounter *counter);
+
+/**
+ * InmemPDRGet, InmemFARGet, InmemQERGet - Copy the rule in the table
+ *
+ * @return: 0 or -1 if the rule does not exist
+ */
+int InmemPDRGet(uint64_t seid, uint16_t pdrId, UPDK_PDR *pdr);
+int InmemFARGet(uint64_t seid, uint32_t farId, UPDK_FAR *far);
+int InmemQERGet(uint64_t seid, uint32_t qerId, UPDK_QER *qer);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __INMEM_CONTEXT_H__ */
@@ -0,0 +1,106 @@
+#include "updk/rule.h"
+
+#include "utlt_debug.h"
+
+#include "inmem_context.h"
+
+/*
+ * Rules are applied to the tables of inmem_context.c at once, so the
+ * transaction only counts PFCP requests and commit never fails.
+ */
+
+/*
+ * Rule IDs are only unique in a session, so rules are rejected without SEID
+ * rather than sharing one ID space of all sessions.
+ */
+
+int Gtpv1TunnelTransactionBegin() {
+    return 0;
+}
+
+int Gtpv1TunnelTransactionCommit() {
+    InmemTransactionCount();
+
+    return 0;
+}
+
+int Gtpv1TunnelCreatePDR(UPDK_PDR *pdr) {
+    UTLT_Assert(pdr, return -1, "PDR is NULL");
+    UTLT_Assert(pdr->flags.pdrId, return -1, "PDR ID is missing");
+    UTLT_Assert(pdr->flags.seid, return -1, "SEID of PDR[%u] is missing", pdr->pdrId);
+    UTLT_Debug("In-memory create PDR: %u", pdr->pdrId);
+
+    return InmemRuleCreate(INMEM_RULE_PDR, pdr->seid, pdr->pdrId, pdr);
+}
+
+int Gtpv1TunnelUpdatePDR(UPDK_PDR *pdr) {
+    UTLT_Assert(pdr, return -1, "PDR is NULL");
+    UTLT_Assert(pdr->flags.pdrId, return -1, "PDR ID is missing");
+    UTLT_Assert(pdr->flags.seid, return -1, "SEID of PDR[%u] is missing", pdr->pdrId);
+    UTLT_Debug("In-memory update PDR: %u", pdr->pdrId);
+
+    return InmemRuleUpdate(INMEM_RULE_PDR, pdr->seid, pdr->pdrId, pdr);
+}
+
+int Gtpv1TunnelRemovePDR(UPDK_PDR *pdr) {
+    UTLT_Assert(pdr, return -1, "PDR is NULL");
+    UTLT_Assert(pdr->flags.pdrId, return -1, "PDR ID is missing");
+    UTLT_Assert(pdr->flags.seid, return -1, "SEID of PDR[%u] is missing", pdr->pdrId);
+    UTLT_Debug("In-memory remove PDR: %u", pdr->pdrId);
+
+    return InmemRuleRemove(INMEM_RULE_PDR, pdr->seid, pdr->pdrId);
+}
+
+int Gtpv1TunnelCreateFAR(UPDK_FAR *far) {
+    UTLT_Assert(far, return -1, "FAR is NULL");
+    UTLT_Assert(far->flags.farId, return -1, "FAR ID is missing");
+    UTLT_Assert(far->flags.seid, return -1, "SEID of FAR[%u] is missing", far->farId);
+    UTLT_Debug("In-memory create FAR: %u", far->farId);
+
+    return InmemRuleCreate(INMEM_RULE_FAR, far->seid, far->farId, far);
+}
+
+int Gtpv1TunnelUpdateFAR(UPDK_FAR *far) {
+    UTLT_Assert(far, return -1, "FAR is NULL");
+    UTLT_Assert(far->flags.farId, return -1, "FAR ID is missing");
+    UTLT_Assert(far->flags.seid, return -1, "SEID of FAR[%u] is missing", far->farId);
+    UTLT_Debug("In-memory update FAR: %u", far->farId);
+
+    return InmemRuleUpdate(INMEM_RULE_FAR, far->seid, far->farId, far);
+}
+
+int Gtpv1TunnelRemoveFAR(UPDK_FAR *far) {
+    UTLT_Assert(far, return -1, "FAR is NULL");
+    UTLT_Assert(far->flags.farId, return -1, "FAR ID is missing");
+    UTLT_Assert(far->flags.seid, return -1, "SEID of FAR[%u] is missing", far->farId);
+    UTLT_Debug("In-memory remove FAR: %u", far->farId);
+
+    return InmemRuleRemove(INMEM_RULE_FAR, far->seid, far->farId);
+}
+
+int Gtpv1TunnelCreateQER(UPDK_QER *qer) {
+    UTLT_Assert(qer, return -1, "QER is NULL");
+    UTLT_Assert(qer->flags.qerId, return -1, "QER ID is missing");
+    UTLT_Assert(qer->flags.seid, return -1, "SEID of QER[%u] is missing", qer->qerId);
+    UTLT_Debug("In-memory create QER: %u", qer->qerId);
+
+    return InmemRuleCreate(INMEM_RULE_QER, qer->seid, qer->qerId, qer);
+}
+
+int Gtpv1TunnelUpdateQER(UPDK_QER *qer) {
+    UTLT_Assert(qer, return -1, "QER is NULL");
+    UTLT_Assert(qer->flags.qerId, return -1, "QER ID is missing");
+    UTLT_Assert(qer->flags.seid, return -1, "SEID of QER[%u] is missing", qer->qerId);
+    UTLT_Debug("In-memory update QER: %u", qer->qerId);
+
+    return InmemRuleUpdate(INMEM_RULE_QER, qer->seid, qer->qerId, qer);
+}
+
+int Gtpv1TunnelRemoveQER(UPDK_QER *qer) {
+    UTLT_Assert(qer, return -1, "QER is NULL");
+    UTLT_Assert(qer->flags.qerId, return -1, "QER ID is missing");
+    UTLT_Assert(qer->flags.seid, return -1, "SEID of QER[%u] is missing", qer->qerId);
+    UTLT_Debug("In-memory remove QER: %u", qer->qerId);
+
+    return InmemRuleRemove(INMEM_RULE_QER, qer->seid, qer->qerId);
+}
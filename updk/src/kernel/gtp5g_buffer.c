@@ -24,13 +24,13 @@ Status UPDKBufferHandler(Sock *sock, void *data) {
     UTLT_Assert(readNum >= 0, goto ERROR_AND_FREE, "Buffer receive fail");
 
     // Buffering packet only, packet should pass by UPF
-    UPDK_PDR updkPDR;
+    UPDK_PDRView updkPDR;
     int packetInStatus = Gtp5gSelf()->PacketInL3(pktbuf->buf, pktbuf->len, &updkPDR);
     UTLT_Assert(packetInStatus > 0, goto ERROR_AND_FREE, "Find Rule for buffering test failed");
 
     /* TODO: Only for debug or demo, get related FAR and QER from UPF
     UPDK_FAR updkFAR;
-    if (!updkPDR.flags.farId || Gtp5gSelf()->GetFARByID(updkPDR.farId, &updkFAR) < 0) {
+    if (!updkPDR.flags.farId || Gtp5gSelf()->GetFARByID(updkPDR.seid, updkPDR.farId, &updkFAR) < 0) {
         UTLT_Error("From GetFARByID, found PDR #%u, but cannot get FAR #%u from UPF", updkPDR.pdrId, updkPDR.farId);
     } else {
         UTLT_Info("From GetFARByID, found PDR #%u, and found FAR #%u in UPF", updkPDR.pdrId, updkPDR.farId);
@@ -39,7 +39,7 @@ Status UPDKBufferHandler(Sock *sock, void *data) {
     UPDK_QER updkQER;
     if (updkPDR.flags.qerId) {
         for (int i = 0; i < sizeof(updkPDR.qerId) / sizeof(uint32_t) && updkPDR.qerId[i]; i++) {
-            if (Gtp5gSelf()->GetQERByID(updkPDR.qerId[i], &updkQER) < 0) {
+            if (Gtp5gSelf()->GetQERByID(updkPDR.seid, updkPDR.qerId[i], &updkQER) < 0) {
                 UTLT_Error("From GetQERByID, found PDR #%u, but cannot get QER #%u from UPF", updkPDR.pdrId, updkPDR.qerId[i]);
             } else {
                 UTLT_Info("From GetQERByID, found PDR #%u, and found QER #%u in UPF", updkPDR.pdrId, updkPDR.qerId[i]);
@@ -64,7 +64,8 @@ Status BufferServerInit() {
     Gtp5gSelf()->unixSock = BufferServerCreate(SOCK_DGRAM, Gtp5gSelf()->unixPath, UPDKBufferHandler, NULL);
     UTLT_Assert(Gtp5gSelf()->unixSock, return STATUS_ERROR, "UnixServerCreate failed");
 
-    UTLT_Assert(EpollRegisterEvent(Gtp5gSelf()->epfd, Gtp5gSelf()->unixSock) == STATUS_OK,
+    // gtp5g sends buffered packets to one path, so they go to the first receiver
+    UTLT_Assert(EpollRegisterEvent(Gtp5gSelf()->receiver[0].epfd, Gtp5gSelf()->unixSock) == STATUS_OK,
         goto UNIXSOCKFREE, "UPDK epoll register error");
 
     return STATUS_OK;
@@ -78,7 +79,7 @@ UNIXSOCKFREE:
 Status BufferServerTerm() {
     Status status = STATUS_OK;
 
-    UTLT_Assert(EpollDeregisterEvent(Gtp5gSelf()->epfd, Gtp5gSelf()->unixSock) == STATUS_OK, status = STATUS_ERROR,
+    UTLT_Assert(EpollDeregisterEvent(Gtp5gSelf()->receiver[0].epfd, Gtp5gSelf()->unixSock) == STATUS_OK, status = STATUS_ERROR,
         "UPDK epoll deregister error");
 
     UTLT_Assert(UnixFree(Gtp5gSelf()->unixSock) == STATUS_OK, status = STATUS_ERROR, "Unix Socket free failed");
@@ -19,6 +19,7 @@
 #include "utlt_list.h"
 #include "utlt_buff.h"
 #include "utlt_network.h"
+#include "utlt_rcu.h"
 #include "gtp_link.h"
 #include "gtp_path.h"
 #include "libgtp5gnl/gtp5gnl.h"
@@ -34,6 +35,7 @@ Gtp5gDevice *Gtp5gSelf() {
 }
 
 void UpdkPacketReceiverThread(ThreadID id, void *data) {
+    Gtp5gReceiver *receiver = data;
     Status status;
 
     int nfds;
@@ -41,7 +43,7 @@ void UpdkPacketReceiverThread(ThreadID id, void *data) {
     struct epoll_event events[MAX_NUM_OF_EVENT];
 
     while (!ThreadStop()) {
-        nfds = EpollWait(gtp5gDevice.epfd, events, 2000);
+        nfds = EpollWait(receiver->epfd, events, 2000);
         UTLT_Assert(nfds >= 0, break, "Epoll Wait error : %s", strerror(errno));
 
         for (int i = 0; i < nfds; i++) {
@@ -52,27 +54,32 @@ void UpdkPacketReceiverThread(ThreadID id, void *data) {
         }
     }
 
+    RcuThreadOffline();
+
     sem_post(((Thread *)id)->semaphore);
-    UTLT_Trace("Packet receiver thread terminated");
+    UTLT_Trace("Packet receiver thread %d terminated", receiver->id);
 
     return;
 }
 
 Status UPDKGtpHandler(Sock *sock, void *data) {
-    UTLT_Assert(sock, return STATUS_ERROR, "GTP socket not found");
+    UTLT_Assert(sock && data, return STATUS_ERROR, "GTP socket or its batch not found");
     Status status = STATUS_OK;
 
-    Bufblk *pktbuf = BufblkAlloc(1, MAX_OF_GTPV1_PACKET_SIZE);
-    int readNum = GtpRecv(sock, pktbuf);
-    UTLT_Assert(readNum >= 0, status = STATUS_ERROR; goto FREEBUFBLK, "GTP receive fail");
+    UdpBatch *batch = data;
+    int readNum = GtpRecvBatch(sock, batch);
+    UTLT_Assert(readNum >= 0, return STATUS_ERROR, "GTP receive fail");
 
     // All rules are set to kernel space, packet should pass by UPF
-    UPDK_PDR updkPDR;
-    int packetInStatus = Gtp5gSelf()->PacketInGTPU(pktbuf->buf, pktbuf->len, sock->remoteAddr.s4.sin_addr.s_addr, sock->remoteAddr._port, &updkPDR);
-    UTLT_Level_Assert(LOG_DEBUG, packetInStatus > 0, status = STATUS_ERROR, "Find Rule for buffering test failed");
-
-FREEBUFBLK:
-    UTLT_Assert(BufblkFree(pktbuf) == STATUS_OK, , "Bufblk free fail");
+    UPDK_PDRView updkPDR;
+    SockAddr from;
+    uint8_t *pkt;
+    int len, packetInStatus;
+    for (int i = 0; i < readNum; i++) {
+        pkt = UdpBatchGet(batch, i, &len, &from);
+        packetInStatus = Gtp5gSelf()->PacketInGTPU(pkt, len, from.s4.sin_addr.s_addr, from._port, &updkPDR);
+        UTLT_Level_Assert(LOG_DEBUG, packetInStatus > 0, status = STATUS_ERROR, "Find Rule for buffering test failed");
+    }
 
     return status;
 }
@@ -91,16 +98,31 @@ Status Gtp5gDeviceInit(VirtualDevice *dev) {
     gtp5gDevice.GetFARByID = dev->eventCB.getFAR;
     gtp5gDevice.GetQERByID = dev->eventCB.getQER;
 
-    gtp5gDevice.epfd = EpollCreate();
-    UTLT_Assert(gtp5gDevice.epfd >= 0, return STATUS_ERROR, "Epoll for gtp5g device create failed");
+    gtp5gDevice.numOfReceiver = VirtualDeviceReceiverNum(dev, GTP5G_MAX_RECEIVER);
+    for (int i = 0; i < gtp5gDevice.numOfReceiver; i++) {
+        Gtp5gReceiver *receiver = &gtp5gDevice.receiver[i];
+        receiver->id = i;
+
+        receiver->batch = UdpBatchAlloc(MAX_NUM_OF_UDP_BATCH, MAX_OF_GTPV1_PACKET_SIZE);
+        UTLT_Assert(receiver->batch, goto FREERECEIVER, "UDP batch of receiver %d alloc failed", i);
 
-    UTLT_Assert(ThreadCreate(&gtp5gDevice.PacketRecvThread, UpdkPacketReceiverThread, NULL) == STATUS_OK,
-        goto FREEEPOLL, "UPDK receiver thread create failed");
+        receiver->epfd = EpollCreate();
+        UTLT_Assert(receiver->epfd >= 0, goto FREERECEIVER, "Epoll for gtp5g device create failed");
+
+        UTLT_Assert(ThreadCreate(&receiver->thread, UpdkPacketReceiverThread, receiver) == STATUS_OK,
+            close(receiver->epfd); goto FREERECEIVER, "UPDK receiver thread %d create failed", i);
+    }
 
     return STATUS_OK;
 
-FREEEPOLL:
-    close(gtp5gDevice.epfd);
+FREERECEIVER:
+    for (int i = 0; i < gtp5gDevice.numOfReceiver && gtp5gDevice.receiver[i].batch; i++) {
+        if (gtp5gDevice.receiver[i].thread) {
+            ThreadDelete(gtp5gDevice.receiver[i].thread);
+            close(gtp5gDevice.receiver[i].epfd);
+        }
+        UdpBatchFree(gtp5gDevice.receiver[i].batch);
+    }
 
     return STATUS_ERROR;
 }
@@ -110,8 +132,17 @@ Status Gtp5gDeviceTerm() {
 
     UTLT_Assert(BufferServerTerm() == STATUS_OK, status = STATUS_ERROR, "BufferServerTerm fail");
 
-    UTLT_Assert(EpollDeregisterEvent(gtp5gDevice.epfd, gtp5gDevice.sock) == STATUS_OK, status = STATUS_ERROR,
-        "UPDK epoll deregister error");
+    for (int i = 0; i < gtp5gDevice.numOfReceiver; i++) {
+        Gtp5gReceiver *receiver = &gtp5gDevice.receiver[i];
+
+        UTLT_Assert(EpollDeregisterEvent(receiver->epfd, receiver->sock) == STATUS_OK, status = STATUS_ERROR,
+            "UPDK epoll deregister error");
+
+        // The first socket is freed after gtp5g device
+        if (i)
+            UTLT_Assert(UdpFree(receiver->sock) == STATUS_OK, status = STATUS_ERROR,
+                        "UDP server socket free fail : IP[%s]", gtp5gDevice.port->ipStr);
+    }
 
     UTLT_Assert(gtp_dev_destroy(gtp5gDevice.ifname) >= 0, status = STATUS_ERROR,
                 "gtp5g device named %s destroy fail", gtp5gDevice.ifname);
@@ -119,10 +150,13 @@ Status Gtp5gDeviceTerm() {
     UTLT_Assert(UdpFree(gtp5gDevice.sock) == STATUS_OK, status = STATUS_ERROR,
                 "UDP server socket free fail : IP[%s]", gtp5gDevice.port->ipStr);
 
-    UTLT_Assert(ThreadDelete(gtp5gDevice.PacketRecvThread) == STATUS_OK, status = STATUS_ERROR,
-        "UPDK receiver thread delete failed");
+    for (int i = 0; i < gtp5gDevice.numOfReceiver; i++) {
+        UTLT_Assert(ThreadDelete(gtp5gDevice.receiver[i].thread) == STATUS_OK, status = STATUS_ERROR,
+            "UPDK receiver thread %d delete failed", i);
 
-    close(gtp5gDevice.epfd);
+        close(gtp5gDevice.receiver[i].epfd);
+        UdpBatchFree(gtp5gDevice.receiver[i].batch);
+    }
 
     free(gtp5gDevice.port);
 
@@ -131,16 +165,56 @@ Status Gtp5gDeviceTerm() {
     return status;
 }
 
+/*
+ * Add sockets of the other receivers to SO_REUSEPORT group of gtp5g socket.
+ * gtp5g only decapsulates on its own socket, so all T-PDUs are steered to it.
+ */
+static Status Gtp5gReceiverAdd(VirtualPort *port) {
+    int num = gtp5gDevice.numOfReceiver;
+
+    // Steer before the others join, so no T-PDU goes around gtp5g
+    UTLT_Assert(UdpReusePortSteerByTeid(gtp5gDevice.sock, num, 0) == STATUS_OK,
+        return STATUS_ERROR, "Steer GTP-U by TEID failed");
+
+    for (int i = 1; i < num; i++) {
+        Gtp5gReceiver *receiver = &gtp5gDevice.receiver[i];
+
+        receiver->sock = UdpReusePortServerCreate(AF_INET, port->ipStr, GTP_V1_PORT);
+        UTLT_Assert(receiver->sock, goto FREESOCK,
+                    "UDP server create fail for receiver %d: IP[%s] port[%d]", i, port->ipStr, GTP_V1_PORT);
+
+        UTLT_Assert(SockRegister(receiver->sock, UPDKGtpHandler, receiver->batch) == STATUS_OK,
+            UdpFree(receiver->sock); receiver->sock = NULL; goto FREESOCK, "SockRegister failed");
+
+        UTLT_Assert(EpollRegisterEvent(receiver->epfd, receiver->sock) == STATUS_OK,
+            UdpFree(receiver->sock); receiver->sock = NULL; goto FREESOCK, "UPDK epoll register error");
+    }
+
+    return STATUS_OK;
+
+FREESOCK:
+    for (int i = 1; i < num && gtp5gDevice.receiver[i].sock; i++) {
+        EpollDeregisterEvent(gtp5gDevice.receiver[i].epfd, gtp5gDevice.receiver[i].sock);
+        UdpFree(gtp5gDevice.receiver[i].sock);
+        gtp5gDevice.receiver[i].sock = NULL;
+    }
+
+    return STATUS_ERROR;
+}
+
 Status Gtp5gDeviceAdd(VirtualDevice *dev, VirtualPort *port) {
     UTLT_Assert(dev && port, return STATUS_ERROR,
         "VirtualDevice or VirtualPort shall not be NULL");
 
     Status status;
 
-    // Create UDP socket
-    gtp5gDevice.sock = UdpServerCreate(AF_INET, port->ipStr, GTP_V1_PORT);
+    // Create UDP socket, which leads SO_REUSEPORT group if there are more receivers
+    gtp5gDevice.sock = (gtp5gDevice.numOfReceiver > 1 ?
+        UdpReusePortServerCreate(AF_INET, port->ipStr, GTP_V1_PORT) :
+        UdpServerCreate(AF_INET, port->ipStr, GTP_V1_PORT));
     UTLT_Assert(gtp5gDevice.sock, return STATUS_ERROR, 
                 "UDP server create fail for gtp5g: IP[%s] port[%d]", port->ipStr, GTP_V1_PORT);
+    gtp5gDevice.receiver[0].sock = gtp5gDevice.sock;
 
     // Create gtp5g interface
     status = gtp_dev_create(-1, dev->deviceID, gtp5gDevice.sock->fd);
@@ -161,12 +235,14 @@ Status Gtp5gDeviceAdd(VirtualDevice *dev, VirtualPort *port) {
     UTLT_Assert(status == 0, goto FREEGTP5GINT,
         "Set MTU %d on %s failed", ifr.ifr_mtu, dev->deviceID);
 
-    UTLT_Assert(SockRegister(gtp5gDevice.sock, UPDKGtpHandler, NULL) == STATUS_OK,
+    UTLT_Assert(SockRegister(gtp5gDevice.sock, UPDKGtpHandler, gtp5gDevice.receiver[0].batch) == STATUS_OK,
         return STATUS_ERROR, "SockRegister failed");
 
-    UTLT_Assert(EpollRegisterEvent(gtp5gDevice.epfd, gtp5gDevice.sock) == STATUS_OK,
+    UTLT_Assert(EpollRegisterEvent(gtp5gDevice.receiver[0].epfd, gtp5gDevice.sock) == STATUS_OK,
         goto FREEGTP5GINT, "UPDK epoll register error");
 
+    UTLT_Assert(Gtp5gReceiverAdd(port) == STATUS_OK, goto FREEGTP5GINT, "Gtp5gReceiverAdd failed");
+
     UTLT_Assert(BufferServerInit() == STATUS_OK, goto FREEGTP5GINT, "BufferServerInit failed");
 
     return STATUS_OK;
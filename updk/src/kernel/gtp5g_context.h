@@ -19,6 +19,25 @@
 #include "updk/env.h"
 
 #define UNIX_SOCK_BUFFERING_PATH "/tmp/free5gc_unix_sock"
+#define GTP5G_MAX_RECEIVER 16
+
+/**
+ * Gtp5gReceiver - Structure for a thread receiving packets passed up by gtp5g
+ *
+ * @id: Index in Gtp5gDevice, also the index of @sock in SO_REUSEPORT group
+ * @sock: UDP socket of GTP-U, the first one is decapsulated by gtp5g and takes all T-PDUs,
+ *        the others take echo, end marker and error indication steered by TEID
+ * @epfd: Epoll fd of @sock, the first one also has the unix socket of buffering
+ * @thread: Thread waiting on @epfd
+ * @batch: Datagrams received from @sock in one syscall
+ */
+typedef struct {
+    int id;
+    Sock *sock;
+    int epfd;
+    ThreadID thread;
+    UdpBatch *batch;
+} Gtp5gReceiver;
 
 /**
  * Gtp5gDevice - Structure for store info after gtp5g device created
@@ -30,8 +49,7 @@
  * @PacketInGTPU:  Function pointer to handle GTP-U packet in getting from VirtualDevice
  * @GetPDRByID: Function pointer to get PDR by ID getting from VirtualDevice
  * @GetFARByID: Function pointer to get FAR by ID getting from VirtualDevice
- * @PacketRecvThread: Thread for receiving all packet from kernel
- * @epfd: Epoll fd created in @PacketRecvThread 
+ * @receiver: Threads for receiving packets from kernel, @sock is the one of the first
  * @unixPath: Absolute path for named pipe for buffering
  * @unixSock: Sock for buffering
  */
@@ -49,8 +67,8 @@ typedef struct { // TODO: Need to change name to context and split these member
     GetRule32CB GetFARByID;
     GetRule32CB GetQERByID;
 
-    ThreadID PacketRecvThread;
-    int epfd;
+    Gtp5gReceiver receiver[GTP5G_MAX_RECEIVER];
+    int numOfReceiver;
 
     // Buffering
     char unixPath[MAX_FILE_PATH_STRLEN];
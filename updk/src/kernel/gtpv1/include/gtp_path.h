@@ -19,6 +19,7 @@ Status GtpTunCreate(Gtpv1TunDevNode *node, SockHandler handler, void *data);
 Status GtpTunFree(Gtpv1TunDevNode *node);
 
 int GtpRecv(Sock *sock, Bufblk *pktbuf);
+int GtpRecvBatch(Sock *sock, UdpBatch *batch);
 Status GtpSend(Sock *sock, Bufblk *pktbuf);
 
 Status GtpEpollRegister(int epfd, Sock *sock);
@@ -5,6 +5,17 @@
 
 #include "libgtp5gnl/gtp5gnl.h"
 
+/*
+ * Rule operations between Begin and Commit on the same thread are sent to
+ * gtp5g in one netlink batch, the result of them is returned by Commit.
+ * Transactions can be nested, only the outermost Commit sends the batch.
+ */
+void GtpTunnelTransactionBegin();
+Status GtpTunnelTransactionCommit();
+
+// Close the gtp5g netlink socket kept by the calling thread
+Status GtpTunnelChannelClose();
+
 Status GtpTunnelAddQer(const char *ifname, struct gtp5g_qer *qer);
 Status GtpTunnelModQer(const char *ifname, struct gtp5g_qer *qer);
 Status GtpTunnelDelQer(const char *ifname, uint32_t id);
@@ -12,7 +12,7 @@
 
 #define MAX_NUM_OF_GTPDEV 64
 
-PoolDeclare(gtpv1DevPool, Gtpv1TunDevNode, MAX_NUM_OF_GTPDEV);
+PoolDeclare(gtpv1DevPool, Gtpv1TunDevNode);
 
 Status GtpLinkCreate(Gtpv1TunDevNode *node) {
     UTLT_Assert(node, return STATUS_ERROR, "GTPv1 tunnel node is NULL");
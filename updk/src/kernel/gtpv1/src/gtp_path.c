@@ -89,6 +89,15 @@ int GtpRecv(Sock *sock, Bufblk *pktbuf) {
     return pktbuf->len;
 }
 
+int GtpRecvBatch(Sock *sock, UdpBatch *batch) {
+    UTLT_Assert(sock && batch, return -1, "Socket or batch pointer is NULL");
+
+    int readNum = UdpBatchRecv(sock, batch);
+    UTLT_Assert(readNum >= 0, return readNum, "GtpRecvBatch fail");
+
+    return readNum;
+}
+
 Status GtpSend(Sock *sock, Bufblk *pktbuf) {
     UTLT_Assert(sock && pktbuf, return STATUS_ERROR,
                 "Socket or pktbuf pointer is NULL");
@@ -1,8 +1,13 @@
 #include "gtp_tunnel.h"
 
 #include "utlt_debug.h"
+#include "utlt_netlink.h"
 
+#include <time.h>
+#include <stdlib.h>
+#include <string.h>
 #include <net/if.h>
+#include <sys/socket.h>
 #include <libmnl/libmnl.h>
 #include <linux/genetlink.h>
 
@@ -10,269 +15,327 @@
 #include "libgtp5gnl/gtp5g.h"
 #include "libgtp5gnl/gtp5gnl.h"
 
-Status GtpTunnelAddQer(const char *ifname, struct gtp5g_qer *qer) {
-    Status status;
+/*
+ * Each thread keeps its own gtp5g netlink socket, the family lookup is done
+ * only when it is opened. Rule operations are queued into the batch of the
+ * socket and sent right away, unless a transaction is running on the thread,
+ * then they are sent together and ACKed once by GtpTunnelTransactionCommit().
+ */
+typedef struct {
     NetlinkInfo info;
+    struct gtp5g_dev *dev;
+    char ifname[MAX_IFNAME_STRLEN];
+    NetlinkBatch batch;
+} GtpTunnelChannel;
 
-    UTLT_Assert(qer, return STATUS_ERROR, "QER is NULL");
+static __thread GtpTunnelChannel *gtpTunnelChannel = NULL;
+static __thread int gtpTunnelTxDepth = 0;
+static __thread Status gtpTunnelTxStatus = STATUS_OK;
+
+static GtpTunnelChannel *GtpTunnelChannelOpen(const char *ifname) {
+    UTLT_Assert(strlen(ifname) < MAX_IFNAME_STRLEN, return NULL, "Interface name %s is too long", ifname);
+
+    GtpTunnelChannel *channel = malloc(sizeof(GtpTunnelChannel));
+    UTLT_Assert(channel, return NULL, "GtpTunnelChannel malloc fail");
+
+    UTLT_Assert(NetlinkSockOpen(&channel->info, ifname, "gtp5g") == STATUS_OK,
+        goto FREE, "NetlinkSockOpen fail");
 
-    status = NetlinkSockOpen(&info, ifname, "gtp5g");
-    UTLT_Assert(status == STATUS_OK, return STATUS_ERROR, "NetlinkSockOpen fail");
+    // Only the header of the request is echoed in an error ACK
+    int one = 1;
+    setsockopt(mnl_socket_get_fd(channel->info.nl), SOL_NETLINK, NETLINK_CAP_ACK, &one, sizeof(one));
 
-    struct gtp5g_dev *dev = gtp5g_dev_alloc();
-    gtp5g_dev_set_ifidx(dev, info.ifidx);
+    channel->dev = gtp5g_dev_alloc();
+    UTLT_Assert(channel->dev, goto CLOSE, "gtp5g_dev_alloc fail");
+    gtp5g_dev_set_ifidx(channel->dev, channel->info.ifidx);
 
-    UTLT_Assert(!gtp5g_add_qer(info.genl_id, info.nl, dev, qer), status = STATUS_ERROR,
-        "GtpTunnelAddQer Fail: QER id[%u]", *gtp5g_qer_get_id(qer));
+    strcpy(channel->ifname, ifname);
+    NetlinkBatchInit(&channel->batch, mnl_socket_get_fd(channel->info.nl), time(NULL));
 
-    gtp5g_dev_free(dev);
-    NetlinkSockClose(&info);
+    return channel;
+
+CLOSE:
+    NetlinkSockClose(&channel->info);
+FREE:
+    free(channel);
+    return NULL;
+}
+
+static Status GtpTunnelChannelFlush(GtpTunnelChannel *channel) {
+    Status status = NetlinkBatchFlush(&channel->batch);
+
+    if (status != STATUS_OK) {
+        if (channel->batch.numOfFail)
+            UTLT_Error("gtp5g rejects %d rules: %s", channel->batch.numOfFail, strerror(channel->batch.error));
+        if (channel->batch.sockError) {
+            UTLT_Error("gtp5g netlink socket fail: %s", strerror(channel->batch.sockError));
+            GtpTunnelChannelClose();
+        }
+    }
 
     return status;
 }
 
-Status GtpTunnelModQer(const char *ifname, struct gtp5g_qer *qer) {
-    Status status;
-    NetlinkInfo info;
+static GtpTunnelChannel *GtpTunnelChannelGet(const char *ifname) {
+    if (gtpTunnelChannel && strcmp(gtpTunnelChannel->ifname, ifname))
+        GtpTunnelChannelClose();
 
-    UTLT_Assert(qer, return STATUS_ERROR, "QER is NULL");
+    if (!gtpTunnelChannel)
+        gtpTunnelChannel = GtpTunnelChannelOpen(ifname);
+
+    return gtpTunnelChannel;
+}
+
+static char *GtpTunnelMsgBuf(const char *ifname, GtpTunnelChannel **channel) {
+    *channel = GtpTunnelChannelGet(ifname);
+    UTLT_Assert(*channel, gtpTunnelTxStatus = STATUS_ERROR; return NULL, "GtpTunnelChannelGet fail");
+
+    struct nlmsghdr *nlh = NetlinkBatchMsgBuf(&(*channel)->batch);
+    if (!nlh) {
+        gtpTunnelTxStatus = STATUS_ERROR;
+        GtpTunnelChannelClose();
+    }
+
+    return (char *) nlh;
+}
+
+static Status GtpTunnelMsgPut(GtpTunnelChannel *channel, struct nlmsghdr *nlh) {
+    // The message may fail to be built, the transaction fails as well
+    UTLT_Assert(nlh && NetlinkBatchMsgPut(&channel->batch, nlh) == STATUS_OK,
+        gtpTunnelTxStatus = STATUS_ERROR; return STATUS_ERROR, "gtp5g message build fail");
+
+    return (gtpTunnelTxDepth ? STATUS_OK : GtpTunnelChannelFlush(channel));
+}
 
-    status = NetlinkSockOpen(&info, ifname, "gtp5g");
-    UTLT_Assert(status == STATUS_OK, return STATUS_ERROR, "NetlinkSockOpen fail");
+// Results of Find are read right away, so the queued rules are sent before it
+static GtpTunnelChannel *GtpTunnelChannelSync(const char *ifname) {
+    GtpTunnelChannel *channel = GtpTunnelChannelGet(ifname);
+    UTLT_Assert(channel, return NULL, "GtpTunnelChannelGet fail");
 
-    struct gtp5g_dev *dev = gtp5g_dev_alloc();
-    gtp5g_dev_set_ifidx(dev, info.ifidx);
+    if (NetlinkBatchNumOfMsg(&channel->batch) && GtpTunnelChannelFlush(channel) != STATUS_OK)
+        gtpTunnelTxStatus = STATUS_ERROR;
 
-    UTLT_Assert(!gtp5g_mod_qer(info.genl_id, info.nl, dev, qer), status = STATUS_ERROR,
-        "GtpTunnelModQer Fail: QER id[%u]", *gtp5g_qer_get_id(qer));
+    // It is closed if the socket fails
+    return gtpTunnelChannel;
+}
+
+void GtpTunnelTransactionBegin() {
+    if (!gtpTunnelTxDepth++)
+        gtpTunnelTxStatus = STATUS_OK;
+}
+
+Status GtpTunnelTransactionCommit() {
+    UTLT_Assert(gtpTunnelTxDepth > 0, return STATUS_ERROR, "No transaction is running");
+
+    if (--gtpTunnelTxDepth)
+        return STATUS_OK;
+
+    Status status = gtpTunnelTxStatus;
+    if (gtpTunnelChannel && GtpTunnelChannelFlush(gtpTunnelChannel) != STATUS_OK)
+        status = STATUS_ERROR;
 
-    gtp5g_dev_free(dev);
-    NetlinkSockClose(&info);
+    gtpTunnelTxStatus = STATUS_OK;
+    return status;
+}
+
+Status GtpTunnelChannelClose() {
+    GtpTunnelChannel *channel = gtpTunnelChannel;
+    if (!channel)
+        return STATUS_OK;
+
+    gtpTunnelChannel = NULL;
+
+    Status status = NetlinkBatchFlush(&channel->batch);
+    NetlinkBatchTerm(&channel->batch);
+    gtp5g_dev_free(channel->dev);
+    NetlinkSockClose(&channel->info);
+    free(channel);
 
     return status;
 }
 
+Status GtpTunnelAddQer(const char *ifname, struct gtp5g_qer *qer) {
+    GtpTunnelChannel *channel;
+
+    UTLT_Assert(qer, return STATUS_ERROR, "QER is NULL");
+
+    char *buf = GtpTunnelMsgBuf(ifname, &channel);
+    UTLT_Assert(buf, return STATUS_ERROR, "GtpTunnelMsgBuf fail");
+
+    UTLT_Assert(GtpTunnelMsgPut(channel, gtp5g_add_qer_nlmsg(buf, channel->info.genl_id, 0, channel->dev, qer)) == STATUS_OK,
+        return STATUS_ERROR, "GtpTunnelAddQer Fail: QER id[%u]", *gtp5g_qer_get_id(qer));
+
+    return STATUS_OK;
+}
+
+Status GtpTunnelModQer(const char *ifname, struct gtp5g_qer *qer) {
+    GtpTunnelChannel *channel;
+
+    UTLT_Assert(qer, return STATUS_ERROR, "QER is NULL");
+
+    char *buf = GtpTunnelMsgBuf(ifname, &channel);
+    UTLT_Assert(buf, return STATUS_ERROR, "GtpTunnelMsgBuf fail");
+
+    UTLT_Assert(GtpTunnelMsgPut(channel, gtp5g_mod_qer_nlmsg(buf, channel->info.genl_id, 0, channel->dev, qer)) == STATUS_OK,
+        return STATUS_ERROR, "GtpTunnelModQer Fail: QER id[%u]", *gtp5g_qer_get_id(qer));
+
+    return STATUS_OK;
+}
+
 Status GtpTunnelDelQer(const char *ifname, uint32_t id) {
     Status status;
-    NetlinkInfo info;
-
-    status = NetlinkSockOpen(&info, ifname, "gtp5g");
-    UTLT_Assert(status == STATUS_OK, return STATUS_ERROR, "NetlinkSockOpen fail");
+    GtpTunnelChannel *channel;
 
-    struct gtp5g_dev *dev = gtp5g_dev_alloc();
-    gtp5g_dev_set_ifidx(dev, info.ifidx);
+    char *buf = GtpTunnelMsgBuf(ifname, &channel);
+    UTLT_Assert(buf, return STATUS_ERROR, "GtpTunnelMsgBuf fail");
 
     struct gtp5g_qer *qer = gtp5g_qer_alloc();
     gtp5g_qer_set_id(qer, id);
-    
-    UTLT_Assert(!gtp5g_del_qer(info.genl_id, info.nl, dev, qer), status = STATUS_ERROR,
-        "GtpTunnelDelqer fail: QER id[%u]", id);
+
+    status = GtpTunnelMsgPut(channel, gtp5g_del_qer_nlmsg(buf, channel->info.genl_id, 0, channel->dev, qer));
+    UTLT_Assert(status == STATUS_OK, , "GtpTunnelDelqer fail: QER id[%u]", id);
 
     gtp5g_qer_free(qer);
-    gtp5g_dev_free(dev);
-    NetlinkSockClose(&info);
 
     return status;
 }
 
 struct gtp5g_qer *GtpTunnelFindQerById(const char *ifname, uint32_t id) {
-    Status status;
-    NetlinkInfo info;
-
-    status = NetlinkSockOpen(&info, ifname, "gtp5g");
-    UTLT_Assert(status == STATUS_OK, return NULL, "NetlinkSockOpen fail");
-
-    struct gtp5g_dev *dev = gtp5g_dev_alloc();
-    gtp5g_dev_set_ifidx(dev, info.ifidx);
+    GtpTunnelChannel *channel = GtpTunnelChannelSync(ifname);
+    UTLT_Assert(channel, return NULL, "GtpTunnelChannelSync fail");
 
     struct gtp5g_qer *qer = gtp5g_qer_alloc();
     gtp5g_qer_set_id(qer, id);
-    
+
     struct gtp5g_qer *rt_qer;
-    UTLT_Assert((rt_qer = gtp5g_qer_find_by_id(info.genl_id, info.nl, dev, qer)), , 
+    UTLT_Assert((rt_qer = gtp5g_qer_find_by_id(channel->info.genl_id, channel->info.nl, channel->dev, qer)), ,
         "GtpTunnelFindQerById fail: QER id[%u]", id);
 
     gtp5g_qer_free(qer);
-    gtp5g_dev_free(dev);
-    NetlinkSockClose(&info);
 
     return rt_qer;
 }
 
 Status GtpTunnelAddPdr(const char *ifname, struct gtp5g_pdr *pdr) {
-    Status status;
-    NetlinkInfo info;
+    GtpTunnelChannel *channel;
 
     UTLT_Assert(pdr, return STATUS_ERROR, "PDR is NULL");
 
-    status = NetlinkSockOpen(&info, ifname, "gtp5g");
-    UTLT_Assert(status == STATUS_OK, return STATUS_ERROR, "NetlinkSockOpen fail");
-
-    struct gtp5g_dev *dev = gtp5g_dev_alloc();
-    gtp5g_dev_set_ifidx(dev, info.ifidx);
+    char *buf = GtpTunnelMsgBuf(ifname, &channel);
+    UTLT_Assert(buf, return STATUS_ERROR, "GtpTunnelMsgBuf fail");
 
-    UTLT_Assert(!gtp5g_add_pdr(info.genl_id, info.nl, dev, pdr), status = STATUS_ERROR,
-        "GtpTunnelAddPdr Fail: PDR id[%u]", *gtp5g_pdr_get_id(pdr));
+    UTLT_Assert(GtpTunnelMsgPut(channel, gtp5g_add_pdr_nlmsg(buf, channel->info.genl_id, 0, channel->dev, pdr)) == STATUS_OK,
+        return STATUS_ERROR, "GtpTunnelAddPdr Fail: PDR id[%u]", *gtp5g_pdr_get_id(pdr));
 
-    gtp5g_dev_free(dev);
-    NetlinkSockClose(&info);
-
-    return status;
+    return STATUS_OK;
 }
 
 Status GtpTunnelModPdr(const char *ifname, struct gtp5g_pdr *pdr) {
-    Status status;
-    NetlinkInfo info;
+    GtpTunnelChannel *channel;
 
     UTLT_Assert(pdr, return STATUS_ERROR, "PDR is NULL");
 
-    status = NetlinkSockOpen(&info, ifname, "gtp5g");
-    UTLT_Assert(status == STATUS_OK, return STATUS_ERROR, "NetlinkSockOpen fail");
-
-    struct gtp5g_dev *dev = gtp5g_dev_alloc();
-    gtp5g_dev_set_ifidx(dev, info.ifidx);
-
-    UTLT_Assert(!gtp5g_mod_pdr(info.genl_id, info.nl, dev, pdr), status = STATUS_ERROR,
-        "GtpTunnelModPdr Fail: PDR id[%u]", *gtp5g_pdr_get_id(pdr));
+    char *buf = GtpTunnelMsgBuf(ifname, &channel);
+    UTLT_Assert(buf, return STATUS_ERROR, "GtpTunnelMsgBuf fail");
 
-    gtp5g_dev_free(dev);
-    NetlinkSockClose(&info);
+    UTLT_Assert(GtpTunnelMsgPut(channel, gtp5g_mod_pdr_nlmsg(buf, channel->info.genl_id, 0, channel->dev, pdr)) == STATUS_OK,
+        return STATUS_ERROR, "GtpTunnelModPdr Fail: PDR id[%u]", *gtp5g_pdr_get_id(pdr));
 
-    return status;
+    return STATUS_OK;
 }
 
 Status GtpTunnelDelPdr(const char *ifname, uint16_t id) {
     Status status;
-    NetlinkInfo info;
+    GtpTunnelChannel *channel;
 
-    status = NetlinkSockOpen(&info, ifname, "gtp5g");
-    UTLT_Assert(status == STATUS_OK, return STATUS_ERROR, "NetlinkSockOpen fail");
-
-    struct gtp5g_dev *dev = gtp5g_dev_alloc();
-    gtp5g_dev_set_ifidx(dev, info.ifidx);
+    char *buf = GtpTunnelMsgBuf(ifname, &channel);
+    UTLT_Assert(buf, return STATUS_ERROR, "GtpTunnelMsgBuf fail");
 
     struct gtp5g_pdr *pdr = gtp5g_pdr_alloc();
     gtp5g_pdr_set_id(pdr, id);
-    
-    UTLT_Assert(!gtp5g_del_pdr(info.genl_id, info.nl, dev, pdr), status = STATUS_ERROR,
-        "GtpTunnelDelPdr fail: PDR id[%u]", id);
+
+    status = GtpTunnelMsgPut(channel, gtp5g_del_pdr_nlmsg(buf, channel->info.genl_id, 0, channel->dev, pdr));
+    UTLT_Assert(status == STATUS_OK, , "GtpTunnelDelPdr fail: PDR id[%u]", id);
 
     gtp5g_pdr_free(pdr);
-    gtp5g_dev_free(dev);
-    NetlinkSockClose(&info);
 
     return status;
 }
 
 struct gtp5g_pdr *GtpTunnelFindPdrById(const char *ifname, uint16_t id) {
-    Status status;
-    NetlinkInfo info;
-
-    status = NetlinkSockOpen(&info, ifname, "gtp5g");
-    UTLT_Assert(status == STATUS_OK, return NULL, "NetlinkSockOpen fail");
-
-    struct gtp5g_dev *dev = gtp5g_dev_alloc();
-    gtp5g_dev_set_ifidx(dev, info.ifidx);
+    GtpTunnelChannel *channel = GtpTunnelChannelSync(ifname);
+    UTLT_Assert(channel, return NULL, "GtpTunnelChannelSync fail");
 
     struct gtp5g_pdr *pdr = gtp5g_pdr_alloc();
     gtp5g_pdr_set_id(pdr, id);
-    
+
     struct gtp5g_pdr *rt_pdr;
-    UTLT_Assert((rt_pdr = gtp5g_pdr_find_by_id(info.genl_id, info.nl, dev, pdr)), , 
+    UTLT_Assert((rt_pdr = gtp5g_pdr_find_by_id(channel->info.genl_id, channel->info.nl, channel->dev, pdr)), ,
         "GtpTunnelFindPdrById fail: PDR id[%u]", id);
 
     gtp5g_pdr_free(pdr);
-    gtp5g_dev_free(dev);
-    NetlinkSockClose(&info);
 
     return rt_pdr;
 }
 
 Status GtpTunnelAddFar(const char *ifname, struct gtp5g_far *far) {
-    Status status;
-    NetlinkInfo info;
+    GtpTunnelChannel *channel;
 
     UTLT_Assert(far, return STATUS_ERROR, "FAR is NULL");
 
-    status = NetlinkSockOpen(&info, ifname, "gtp5g");
-    UTLT_Assert(status == STATUS_OK, return STATUS_ERROR, "NetlinkSockOpen fail");
+    char *buf = GtpTunnelMsgBuf(ifname, &channel);
+    UTLT_Assert(buf, return STATUS_ERROR, "GtpTunnelMsgBuf fail");
 
-    struct gtp5g_dev *dev = gtp5g_dev_alloc();
-    gtp5g_dev_set_ifidx(dev, info.ifidx);
+    UTLT_Assert(GtpTunnelMsgPut(channel, gtp5g_add_far_nlmsg(buf, channel->info.genl_id, 0, channel->dev, far)) == STATUS_OK,
+        return STATUS_ERROR, "GtpTunnelAddFar fail: FAR id[%u]", *gtp5g_far_get_id(far));
 
-    UTLT_Assert(!gtp5g_add_far(info.genl_id, info.nl, dev, far), status = STATUS_ERROR,
-        "GtpTunnelAddFar fail: FAR id[%u]", *gtp5g_far_get_id(far));
-
-    gtp5g_dev_free(dev);
-    NetlinkSockClose(&info);
-
-    return status;
+    return STATUS_OK;
 }
 
 Status GtpTunnelModFar(const char *ifname, struct gtp5g_far *far) {
-    Status status;
-    NetlinkInfo info;
+    GtpTunnelChannel *channel;
 
     UTLT_Assert(far, return STATUS_ERROR, "FAR is NULL");
 
-    status = NetlinkSockOpen(&info, ifname, "gtp5g");
-    UTLT_Assert(status == STATUS_OK, return STATUS_ERROR, "NetlinkSockOpen fail");
-
-    struct gtp5g_dev *dev = gtp5g_dev_alloc();
-    gtp5g_dev_set_ifidx(dev, info.ifidx);
+    char *buf = GtpTunnelMsgBuf(ifname, &channel);
+    UTLT_Assert(buf, return STATUS_ERROR, "GtpTunnelMsgBuf fail");
 
-    UTLT_Assert(!gtp5g_mod_far(info.genl_id, info.nl, dev, far), status = STATUS_ERROR,
-        "GtpTunnelModFar fail: FAR id[%u]", *gtp5g_far_get_id(far));
+    UTLT_Assert(GtpTunnelMsgPut(channel, gtp5g_mod_far_nlmsg(buf, channel->info.genl_id, 0, channel->dev, far)) == STATUS_OK,
+        return STATUS_ERROR, "GtpTunnelModFar fail: FAR id[%u]", *gtp5g_far_get_id(far));
 
-    gtp5g_dev_free(dev);
-    NetlinkSockClose(&info);
-
-    return status;
+    return STATUS_OK;
 }
 
 Status GtpTunnelDelFar(const char *ifname, uint32_t id) {
     Status status;
-    NetlinkInfo info;
+    GtpTunnelChannel *channel;
 
-    status = NetlinkSockOpen(&info, ifname, "gtp5g");
-    UTLT_Assert(status == STATUS_OK, return STATUS_ERROR, "NetlinkSockOpen fail");
-
-    struct gtp5g_dev *dev = gtp5g_dev_alloc();
-    gtp5g_dev_set_ifidx(dev, info.ifidx);
+    char *buf = GtpTunnelMsgBuf(ifname, &channel);
+    UTLT_Assert(buf, return STATUS_ERROR, "GtpTunnelMsgBuf fail");
 
     struct gtp5g_far *far = gtp5g_far_alloc();
     gtp5g_far_set_id(far, id);
 
-    UTLT_Assert(!gtp5g_del_far(info.genl_id, info.nl, dev, far), status = STATUS_ERROR,
-        "GtpTunnelDelFar fail: FAR id[%u]", id);
+    status = GtpTunnelMsgPut(channel, gtp5g_del_far_nlmsg(buf, channel->info.genl_id, 0, channel->dev, far));
+    UTLT_Assert(status == STATUS_OK, , "GtpTunnelDelFar fail: FAR id[%u]", id);
 
     gtp5g_far_free(far);
-    gtp5g_dev_free(dev);
-    NetlinkSockClose(&info);
 
     return status;
 }
 
 struct gtp5g_far *GtpTunnelFindFarById(const char *ifname, uint32_t id) {
-    Status status;
-    NetlinkInfo info;
-
-    status = NetlinkSockOpen(&info, ifname, "gtp5g");
-    UTLT_Assert(status == STATUS_OK, return NULL, "NetlinkSockOpen fail");
-
-    struct gtp5g_dev *dev = gtp5g_dev_alloc();
-    gtp5g_dev_set_ifidx(dev, info.ifidx);
+    GtpTunnelChannel *channel = GtpTunnelChannelSync(ifname);
+    UTLT_Assert(channel, return NULL, "GtpTunnelChannelSync fail");
 
     struct gtp5g_far *far = gtp5g_far_alloc();
     gtp5g_far_set_id(far, id);
 
     struct gtp5g_far *rt_far;
-    UTLT_Assert((rt_far = gtp5g_far_find_by_id(info.genl_id, info.nl, dev, far)), ,
+    UTLT_Assert((rt_far = gtp5g_far_find_by_id(channel->info.genl_id, channel->info.nl, channel->dev, far)), ,
         "GtpTunnelFindFarById fail: FAR id[%u]", id);
 
     gtp5g_far_free(far);
-    gtp5g_dev_free(dev);
-    NetlinkSockClose(&info);
 
     return rt_far;
 }
@@ -13,6 +13,7 @@
 #include "utlt_list.h"
 #include "utlt_buff.h"
 #include "knet_route.h"
+#include "gtp_tunnel.h"
 
 #include "updk/env.h"
 #include "gtp5g_context.h"
@@ -93,6 +94,7 @@ int Gtpv1EnvTerm(EnvParams *env) {
             "Delete routing rule to device %s failed: %s/%u", ifname, dnn->ipStr, dnn->subnetPrefix);
     }
 
+    status |= GtpTunnelChannelClose();
     status |= Gtp5gDeviceTerm();
 
     return (status == STATUS_OK ? 0 : -1);
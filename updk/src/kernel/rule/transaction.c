@@ -0,0 +1,21 @@
+#include "updk/rule.h"
+
+#include "utlt_debug.h"
+#include "gtp_tunnel.h"
+
+/*
+ * gtp5g receives all rules of one PFCP request in a single netlink batch,
+ * the ACKs of them are collected once at commit
+ */
+int Gtpv1TunnelTransactionBegin() {
+    GtpTunnelTransactionBegin();
+
+    return 0;
+}
+
+int Gtpv1TunnelTransactionCommit() {
+    UTLT_Assert(GtpTunnelTransactionCommit() == STATUS_OK, return -1,
+        "Apply rules to gtp5g failed");
+
+    return 0;
+}
@@ -39,6 +39,19 @@ int gtp5g_del_pdr(int genl_id, struct mnl_socket *nl, struct gtp5g_dev *dev, str
 int gtp5g_del_far(int genl_id, struct mnl_socket *nl, struct gtp5g_dev *dev, struct gtp5g_far *far);
 int gtp5g_del_qer(int genl_id, struct mnl_socket *nl, struct gtp5g_dev *dev, struct gtp5g_qer *qer);
 
+/* Build the message only, so that several of them can be sent in one batch */
+struct nlmsghdr *gtp5g_add_pdr_nlmsg(char *buf, int genl_id, uint32_t seq, struct gtp5g_dev *dev, struct gtp5g_pdr *pdr);
+struct nlmsghdr *gtp5g_add_far_nlmsg(char *buf, int genl_id, uint32_t seq, struct gtp5g_dev *dev, struct gtp5g_far *far);
+struct nlmsghdr *gtp5g_add_qer_nlmsg(char *buf, int genl_id, uint32_t seq, struct gtp5g_dev *dev, struct gtp5g_qer *qer);
+
+struct nlmsghdr *gtp5g_mod_pdr_nlmsg(char *buf, int genl_id, uint32_t seq, struct gtp5g_dev *dev, struct gtp5g_pdr *pdr);
+struct nlmsghdr *gtp5g_mod_far_nlmsg(char *buf, int genl_id, uint32_t seq, struct gtp5g_dev *dev, struct gtp5g_far *far);
+struct nlmsghdr *gtp5g_mod_qer_nlmsg(char *buf, int genl_id, uint32_t seq, struct gtp5g_dev *dev, struct gtp5g_qer *qer);
+
+struct nlmsghdr *gtp5g_del_pdr_nlmsg(char *buf, int genl_id, uint32_t seq, struct gtp5g_dev *dev, struct gtp5g_pdr *pdr);
+struct nlmsghdr *gtp5g_del_far_nlmsg(char *buf, int genl_id, uint32_t seq, struct gtp5g_dev *dev, struct gtp5g_far *far);
+struct nlmsghdr *gtp5g_del_qer_nlmsg(char *buf, int genl_id, uint32_t seq, struct gtp5g_dev *dev, struct gtp5g_qer *qer);
+
 int gtp5g_list_pdr(int genl_id, struct mnl_socket *nl);
 int gtp5g_list_far(int genl_id, struct mnl_socket *nl);
 int gtp5g_list_qer(int genl_id, struct mnl_socket *nl);
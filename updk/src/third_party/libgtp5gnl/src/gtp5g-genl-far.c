@@ -85,21 +85,34 @@ static void gtp5g_build_far_payload(struct nlmsghdr *nlh, struct gtp5g_dev *dev,
     }
 }
 
-int gtp5g_add_far(int genl_id, struct mnl_socket *nl, struct gtp5g_dev *dev, struct gtp5g_far *far)
+struct nlmsghdr *gtp5g_add_far_nlmsg(char *buf, int genl_id, uint32_t seq,
+                                     struct gtp5g_dev *dev, struct gtp5g_far *far)
 {
     struct nlmsghdr *nlh;
-    char buf[MNL_SOCKET_BUFFER_SIZE];
-    uint32_t seq = time(NULL);
 
     if (!dev) {
         fprintf(stderr, "5G GTP device is NULL\n");
-        return -1;
+        return NULL;
     }
 
-    nlh = genl_nlmsg_build_hdr(buf, genl_id, NLM_F_EXCL | NLM_F_ACK, ++seq,
+    nlh = genl_nlmsg_build_hdr(buf, genl_id, NLM_F_EXCL | NLM_F_ACK, seq,
                                GTP5G_CMD_ADD_FAR);
     gtp5g_build_far_payload(nlh, dev, far);
 
+    return nlh;
+}
+EXPORT_SYMBOL(gtp5g_add_far_nlmsg);
+
+int gtp5g_add_far(int genl_id, struct mnl_socket *nl, struct gtp5g_dev *dev, struct gtp5g_far *far)
+{
+    struct nlmsghdr *nlh;
+    char buf[MNL_SOCKET_BUFFER_SIZE];
+    uint32_t seq = time(NULL);
+
+    nlh = gtp5g_add_far_nlmsg(buf, genl_id, ++seq, dev, far);
+    if (!nlh)
+        return -1;
+
     if (genl_socket_talk(nl, nlh, seq, NULL, NULL) < 0) {
         perror("genl_socket_talk");
         return -1;
@@ -109,21 +122,34 @@ int gtp5g_add_far(int genl_id, struct mnl_socket *nl, struct gtp5g_dev *dev, str
 }
 EXPORT_SYMBOL(gtp5g_add_far);
 
-int gtp5g_mod_far(int genl_id, struct mnl_socket *nl, struct gtp5g_dev *dev, struct gtp5g_far *far)
+struct nlmsghdr *gtp5g_mod_far_nlmsg(char *buf, int genl_id, uint32_t seq,
+                                     struct gtp5g_dev *dev, struct gtp5g_far *far)
 {
     struct nlmsghdr *nlh;
-    char buf[MNL_SOCKET_BUFFER_SIZE];
-    uint32_t seq = time(NULL);
 
     if (!dev) {
         fprintf(stderr, "5G GTP device is NULL\n");
-        return -1;
+        return NULL;
     }
 
-    nlh = genl_nlmsg_build_hdr(buf, genl_id, NLM_F_REPLACE | NLM_F_ACK, ++seq,
+    nlh = genl_nlmsg_build_hdr(buf, genl_id, NLM_F_REPLACE | NLM_F_ACK, seq,
                                GTP5G_CMD_ADD_FAR);
     gtp5g_build_far_payload(nlh, dev, far);
 
+    return nlh;
+}
+EXPORT_SYMBOL(gtp5g_mod_far_nlmsg);
+
+int gtp5g_mod_far(int genl_id, struct mnl_socket *nl, struct gtp5g_dev *dev, struct gtp5g_far *far)
+{
+    struct nlmsghdr *nlh;
+    char buf[MNL_SOCKET_BUFFER_SIZE];
+    uint32_t seq = time(NULL);
+
+    nlh = gtp5g_mod_far_nlmsg(buf, genl_id, ++seq, dev, far);
+    if (!nlh)
+        return -1;
+
     if (genl_socket_talk(nl, nlh, seq, NULL, NULL) < 0) {
         perror("genl_socket_talk");
         return -1;
@@ -134,21 +160,34 @@ int gtp5g_mod_far(int genl_id, struct mnl_socket *nl, struct gtp5g_dev *dev, str
 EXPORT_SYMBOL(gtp5g_mod_far);
 
 
-int gtp5g_del_far(int genl_id, struct mnl_socket *nl, struct gtp5g_dev *dev, struct gtp5g_far *far)
+struct nlmsghdr *gtp5g_del_far_nlmsg(char *buf, int genl_id, uint32_t seq,
+                                     struct gtp5g_dev *dev, struct gtp5g_far *far)
 {
-    char buf[MNL_SOCKET_BUFFER_SIZE];
     struct nlmsghdr *nlh;
-    uint32_t seq = time(NULL);
 
     if (!dev) {
         fprintf(stderr, "5G GTP device is NULL\n");
-        return -1;
+        return NULL;
     }
 
-    nlh = genl_nlmsg_build_hdr(buf, genl_id, NLM_F_ACK, ++seq,
+    nlh = genl_nlmsg_build_hdr(buf, genl_id, NLM_F_ACK, seq,
                                GTP5G_CMD_DEL_FAR);
     gtp5g_build_far_payload(nlh, dev, far);
 
+    return nlh;
+}
+EXPORT_SYMBOL(gtp5g_del_far_nlmsg);
+
+int gtp5g_del_far(int genl_id, struct mnl_socket *nl, struct gtp5g_dev *dev, struct gtp5g_far *far)
+{
+    struct nlmsghdr *nlh;
+    char buf[MNL_SOCKET_BUFFER_SIZE];
+    uint32_t seq = time(NULL);
+
+    nlh = gtp5g_del_far_nlmsg(buf, genl_id, ++seq, dev, far);
+    if (!nlh)
+        return -1;
+
     if (genl_socket_talk(nl, nlh, seq, NULL, NULL) < 0) {
         perror("genl_socket_talk");
         return -1;
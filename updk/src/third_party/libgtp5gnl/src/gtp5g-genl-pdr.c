@@ -137,28 +137,40 @@ static void gtp5g_build_pdr_payload(struct nlmsghdr *nlh, struct gtp5g_dev *dev,
     }
 }
 
-int gtp5g_add_pdr(int genl_id, struct mnl_socket *nl, struct gtp5g_dev *dev, struct gtp5g_pdr *pdr)
+struct nlmsghdr *gtp5g_add_pdr_nlmsg(char *buf, int genl_id, uint32_t seq,
+                                     struct gtp5g_dev *dev, struct gtp5g_pdr *pdr)
 {
     struct nlmsghdr *nlh;
-    char buf[MNL_SOCKET_BUFFER_SIZE];
-    uint32_t seq = time(NULL);
 
     if (!dev) {
         fprintf(stderr, "5G GTP device is NULL\n");
-        return -1;
+        return NULL;
     }
 
-    nlh = genl_nlmsg_build_hdr(buf, genl_id, NLM_F_EXCL | NLM_F_ACK, ++seq,
-                               GTP5G_CMD_ADD_PDR);
-
     // Add mandatory IEs here
     if (!pdr->precedence) {
-        perror("Add PDR must have precedence");
-        return -1;
+        fprintf(stderr, "Add PDR must have precedence\n");
+        return NULL;
     }
 
+    nlh = genl_nlmsg_build_hdr(buf, genl_id, NLM_F_EXCL | NLM_F_ACK, seq,
+                               GTP5G_CMD_ADD_PDR);
     gtp5g_build_pdr_payload(nlh, dev, pdr);
 
+    return nlh;
+}
+EXPORT_SYMBOL(gtp5g_add_pdr_nlmsg);
+
+int gtp5g_add_pdr(int genl_id, struct mnl_socket *nl, struct gtp5g_dev *dev, struct gtp5g_pdr *pdr)
+{
+    struct nlmsghdr *nlh;
+    char buf[MNL_SOCKET_BUFFER_SIZE];
+    uint32_t seq = time(NULL);
+
+    nlh = gtp5g_add_pdr_nlmsg(buf, genl_id, ++seq, dev, pdr);
+    if (!nlh)
+        return -1;
+
     if (genl_socket_talk(nl, nlh, seq, NULL, NULL) < 0) {
         perror("genl_socket_talk");
         return -1;
@@ -168,21 +180,34 @@ int gtp5g_add_pdr(int genl_id, struct mnl_socket *nl, struct gtp5g_dev *dev, str
 }
 EXPORT_SYMBOL(gtp5g_add_pdr);
 
-int gtp5g_mod_pdr(int genl_id, struct mnl_socket *nl, struct gtp5g_dev *dev, struct gtp5g_pdr *pdr)
+struct nlmsghdr *gtp5g_mod_pdr_nlmsg(char *buf, int genl_id, uint32_t seq,
+                                     struct gtp5g_dev *dev, struct gtp5g_pdr *pdr)
 {
     struct nlmsghdr *nlh;
-    char buf[MNL_SOCKET_BUFFER_SIZE];
-    uint32_t seq = time(NULL);
 
     if (!dev) {
         fprintf(stderr, "5G GTP device is NULL\n");
-        return -1;
+        return NULL;
     }
 
-    nlh = genl_nlmsg_build_hdr(buf, genl_id, NLM_F_REPLACE | NLM_F_ACK, ++seq,
+    nlh = genl_nlmsg_build_hdr(buf, genl_id, NLM_F_REPLACE | NLM_F_ACK, seq,
                                GTP5G_CMD_ADD_PDR);
     gtp5g_build_pdr_payload(nlh, dev, pdr);
 
+    return nlh;
+}
+EXPORT_SYMBOL(gtp5g_mod_pdr_nlmsg);
+
+int gtp5g_mod_pdr(int genl_id, struct mnl_socket *nl, struct gtp5g_dev *dev, struct gtp5g_pdr *pdr)
+{
+    struct nlmsghdr *nlh;
+    char buf[MNL_SOCKET_BUFFER_SIZE];
+    uint32_t seq = time(NULL);
+
+    nlh = gtp5g_mod_pdr_nlmsg(buf, genl_id, ++seq, dev, pdr);
+    if (!nlh)
+        return -1;
+
     if (genl_socket_talk(nl, nlh, seq, NULL, NULL) < 0) {
         perror("genl_socket_talk");
         return -1;
@@ -192,21 +217,34 @@ int gtp5g_mod_pdr(int genl_id, struct mnl_socket *nl, struct gtp5g_dev *dev, str
 }
 EXPORT_SYMBOL(gtp5g_mod_pdr);
 
-int gtp5g_del_pdr(int genl_id, struct mnl_socket *nl, struct gtp5g_dev *dev, struct gtp5g_pdr *pdr)
+struct nlmsghdr *gtp5g_del_pdr_nlmsg(char *buf, int genl_id, uint32_t seq,
+                                     struct gtp5g_dev *dev, struct gtp5g_pdr *pdr)
 {
-    char buf[MNL_SOCKET_BUFFER_SIZE];
     struct nlmsghdr *nlh;
-    uint32_t seq = time(NULL);
-    
+
     if (!dev) {
         fprintf(stderr, "5G GTP device is NULL\n");
-        return -1;
+        return NULL;
     }
 
-    nlh = genl_nlmsg_build_hdr(buf, genl_id, NLM_F_ACK, ++seq,
+    nlh = genl_nlmsg_build_hdr(buf, genl_id, NLM_F_ACK, seq,
                                GTP5G_CMD_DEL_PDR);
     gtp5g_build_pdr_payload(nlh, dev, pdr);
 
+    return nlh;
+}
+EXPORT_SYMBOL(gtp5g_del_pdr_nlmsg);
+
+int gtp5g_del_pdr(int genl_id, struct mnl_socket *nl, struct gtp5g_dev *dev, struct gtp5g_pdr *pdr)
+{
+    struct nlmsghdr *nlh;
+    char buf[MNL_SOCKET_BUFFER_SIZE];
+    uint32_t seq = time(NULL);
+
+    nlh = gtp5g_del_pdr_nlmsg(buf, genl_id, ++seq, dev, pdr);
+    if (!nlh)
+        return -1;
+
     if (genl_socket_talk(nl, nlh, seq, NULL, NULL) < 0) {
         perror("genl_socket_talk");
         return -1;
@@ -85,29 +85,34 @@ static void gtp5g_build_qer_payload(struct nlmsghdr *nlh, struct gtp5g_dev *dev,
     mnl_attr_put_u8(nlh, GTP5G_QER_RCSR, qer->rcsr);
 }
 
-int gtp5g_add_qer(int genl_id, struct mnl_socket *nl, struct gtp5g_dev *dev, struct gtp5g_qer *qer)
+struct nlmsghdr *gtp5g_add_qer_nlmsg(char *buf, int genl_id, uint32_t seq,
+                                     struct gtp5g_dev *dev, struct gtp5g_qer *qer)
 {
     struct nlmsghdr *nlh;
-    char buf[MNL_SOCKET_BUFFER_SIZE];
-    uint32_t seq = time(NULL);
 
     if (!dev) {
         fprintf(stderr, "5G GTP device is NULL\n");
-        return -1;
+        return NULL;
     }
 
-    nlh = genl_nlmsg_build_hdr(buf, 
-								genl_id, 
-								NLM_F_EXCL | NLM_F_ACK, 
-								++seq,
-                               	GTP5G_CMD_ADD_QER);
-	if (!nlh) {
-        fprintf(stderr, "%s Netlink Msg header is NULL\n", __func__);
-        return -1;
-	}
-
+    nlh = genl_nlmsg_build_hdr(buf, genl_id, NLM_F_EXCL | NLM_F_ACK, seq,
+                               GTP5G_CMD_ADD_QER);
     gtp5g_build_qer_payload(nlh, dev, qer);
 
+    return nlh;
+}
+EXPORT_SYMBOL(gtp5g_add_qer_nlmsg);
+
+int gtp5g_add_qer(int genl_id, struct mnl_socket *nl, struct gtp5g_dev *dev, struct gtp5g_qer *qer)
+{
+    struct nlmsghdr *nlh;
+    char buf[MNL_SOCKET_BUFFER_SIZE];
+    uint32_t seq = time(NULL);
+
+    nlh = gtp5g_add_qer_nlmsg(buf, genl_id, ++seq, dev, qer);
+    if (!nlh)
+        return -1;
+
     if (genl_socket_talk(nl, nlh, seq, NULL, NULL) < 0) {
         perror("genl_socket_talk");
         return -1;
@@ -117,25 +122,34 @@ int gtp5g_add_qer(int genl_id, struct mnl_socket *nl, struct gtp5g_dev *dev, str
 }
 EXPORT_SYMBOL(gtp5g_add_qer);
 
-int gtp5g_mod_qer(int genl_id, struct mnl_socket *nl, struct gtp5g_dev *dev, struct gtp5g_qer *qer)
+struct nlmsghdr *gtp5g_mod_qer_nlmsg(char *buf, int genl_id, uint32_t seq,
+                                     struct gtp5g_dev *dev, struct gtp5g_qer *qer)
 {
     struct nlmsghdr *nlh;
-    char buf[MNL_SOCKET_BUFFER_SIZE];
-    uint32_t seq = time(NULL);
 
     if (!dev) {
         fprintf(stderr, "5G GTP device is NULL\n");
-        return -1;
+        return NULL;
     }
 
-    nlh = genl_nlmsg_build_hdr(buf, 
-								genl_id, 
-								NLM_F_REPLACE | NLM_F_ACK, 
-								++seq,
-                               	GTP5G_CMD_ADD_QER);
-
+    nlh = genl_nlmsg_build_hdr(buf, genl_id, NLM_F_REPLACE | NLM_F_ACK, seq,
+                               GTP5G_CMD_ADD_QER);
     gtp5g_build_qer_payload(nlh, dev, qer);
 
+    return nlh;
+}
+EXPORT_SYMBOL(gtp5g_mod_qer_nlmsg);
+
+int gtp5g_mod_qer(int genl_id, struct mnl_socket *nl, struct gtp5g_dev *dev, struct gtp5g_qer *qer)
+{
+    struct nlmsghdr *nlh;
+    char buf[MNL_SOCKET_BUFFER_SIZE];
+    uint32_t seq = time(NULL);
+
+    nlh = gtp5g_mod_qer_nlmsg(buf, genl_id, ++seq, dev, qer);
+    if (!nlh)
+        return -1;
+
     if (genl_socket_talk(nl, nlh, seq, NULL, NULL) < 0) {
         perror("genl_socket_talk");
         return -1;
@@ -146,25 +160,34 @@ int gtp5g_mod_qer(int genl_id, struct mnl_socket *nl, struct gtp5g_dev *dev, str
 EXPORT_SYMBOL(gtp5g_mod_qer);
 
 
-int gtp5g_del_qer(int genl_id, struct mnl_socket *nl, struct gtp5g_dev *dev, struct gtp5g_qer *qer)
+struct nlmsghdr *gtp5g_del_qer_nlmsg(char *buf, int genl_id, uint32_t seq,
+                                     struct gtp5g_dev *dev, struct gtp5g_qer *qer)
 {
-    char buf[MNL_SOCKET_BUFFER_SIZE];
     struct nlmsghdr *nlh;
-    uint32_t seq = time(NULL);
 
     if (!dev) {
         fprintf(stderr, "5G GTP device is NULL\n");
-        return -1;
+        return NULL;
     }
 
-    nlh = genl_nlmsg_build_hdr(buf, 
-								genl_id, 
-								NLM_F_ACK, 
-								++seq,
-                               	GTP5G_CMD_DEL_QER);
-
+    nlh = genl_nlmsg_build_hdr(buf, genl_id, NLM_F_ACK, seq,
+                               GTP5G_CMD_DEL_QER);
     gtp5g_build_qer_payload(nlh, dev, qer);
 
+    return nlh;
+}
+EXPORT_SYMBOL(gtp5g_del_qer_nlmsg);
+
+int gtp5g_del_qer(int genl_id, struct mnl_socket *nl, struct gtp5g_dev *dev, struct gtp5g_qer *qer)
+{
+    struct nlmsghdr *nlh;
+    char buf[MNL_SOCKET_BUFFER_SIZE];
+    uint32_t seq = time(NULL);
+
+    nlh = gtp5g_del_qer_nlmsg(buf, genl_id, ++seq, dev, qer);
+    if (!nlh)
+        return -1;
+
     if (genl_socket_talk(nl, nlh, seq, NULL, NULL) < 0) {
         perror("genl_socket_talk");
         return -1;
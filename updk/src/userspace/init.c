@@ -0,0 +1,64 @@
+#include "updk/init.h"
+
+/*
+ * These functions shall be customized by kinds of device.
+ * You can create a directory and put all customized function
+ * in there, like "device.c" under "updk/src/kernel/".
+ */
+
+#include <string.h>
+
+#include "utlt_debug.h"
+
+#include "updk/env.h"
+#include "userspace_context.h"
+
+int Gtpv1EnvInit(EnvParams *env) {
+    UTLT_Assert(env, return -1, "EnvParams is NULL");
+
+    VirtualDevice *dev = env->virtualDevice;
+    UTLT_Assert(dev, return -1, "VirtualDevice is NULL");
+
+    int vPortCnt = 0;
+    const char *ip = NULL;
+    VirtualPort *port;
+    VirtualDeviceForEachVirtualPort(port, dev) {
+        UTLT_Debug("Get VirtualPort Info in VirtualDevice: %s", port->ipStr);
+        if (!vPortCnt)
+            ip = port->ipStr;
+        vPortCnt++;
+    }
+
+    UTLT_Assert(vPortCnt, return -1, "GTP-U address should not be 0");
+
+    // Multi-interface should set address in 0.0.0.0
+    if (vPortCnt > 1) {
+        UTLT_Debug("Detect multi-interface, set address to 0.0.0.0");
+        ip = "0.0.0.0";
+    }
+
+    UTLT_Assert(UserspaceDeviceInit(dev, ip) == STATUS_OK,
+            return -1, "UserspaceDeviceInit failed");
+
+    // Set Routing to TUN device
+    DNN *dnn;
+    EnvParamsForEachDNN(dnn, env) {
+        UTLT_Assert(UserspaceAddRoute(dnn->ipStr, dnn->subnetPrefix) == STATUS_OK,
+            UserspaceDeviceTerm(); return -1,
+            "Add routing rule to device %s failed: %s/%u", UserspaceSelf()->ifname, dnn->ipStr, dnn->subnetPrefix);
+    }
+
+    UTLT_Info("Userspace UPDK device %s forwards N3 on %s by %d receivers",
+              UserspaceSelf()->ifname, ip, UserspaceSelf()->numOfReceiver);
+
+    // UPF sends buffered packets and echo responses by N3 socket
+    return UserspaceSelf()->receiver[0].sock->fd;
+}
+
+int Gtpv1EnvTerm(EnvParams *env) {
+    UTLT_Assert(env, return -1, "EnvParams is NULL");
+
+    UTLT_Assert(UserspaceDeviceTerm() == STATUS_OK, return -1, "UserspaceDeviceTerm failed");
+
+    return 0;
+}
@@ -0,0 +1,226 @@
+#include "userspace_context.h"
+
+/*
+ * This file would be included when the UP part runs in user space,
+ * otherwise it will not be used.
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <net/if.h>
+#include <net/route.h>
+#include <arpa/inet.h>
+#include <sys/ioctl.h>
+#include <linux/if_tun.h>
+
+#include "utlt_lib.h"
+#include "utlt_3gppTypes.h"
+
+#define USERSPACE_TUN_PATH  "/dev/net/tun"
+#define USERSPACE_TUN_MTU   1500
+
+static UserspaceDevice userspaceDevice;
+
+UserspaceDevice *UserspaceSelf() {
+    return &userspaceDevice;
+}
+
+// Interface names cannot be longer than IFNAMSIZ - 1, so a longer one is rejected instead of truncated
+static Status UserspaceIfNameCopy(char *dst, const char *ifname) {
+    size_t len = strnlen(ifname, IFNAMSIZ);
+    UTLT_Assert(len < IFNAMSIZ, return STATUS_ERROR, "Interface name %s is too long", ifname);
+
+    memcpy(dst, ifname, len);
+    dst[len] = '\0';
+
+    return STATUS_OK;
+}
+
+// Open a queue of TUN device @ifname, the first one creates it
+static int UserspaceTunOpen(const char *ifname, int multiQueue) {
+    struct ifreq ifr;
+
+    int tunFd = open(USERSPACE_TUN_PATH, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    UTLT_Assert(tunFd >= 0, return -1,
+        "Open %s failed: %s", USERSPACE_TUN_PATH, strerror(errno));
+
+    // Packets are plain IP without packet information header
+    memset(&ifr, 0, sizeof(ifr));
+    ifr.ifr_flags = IFF_TUN | IFF_NO_PI | (multiQueue ? IFF_MULTI_QUEUE : 0);
+    UTLT_Assert(UserspaceIfNameCopy(ifr.ifr_name, ifname) == STATUS_OK, close(tunFd); return -1, "");
+    UTLT_Assert(ioctl(tunFd, TUNSETIFF, &ifr) == 0, close(tunFd); return -1,
+        "TUN device %s create failed: %s", ifname, strerror(errno));
+    strcpy(userspaceDevice.ifname, ifr.ifr_name);
+
+    return tunFd;
+}
+
+static Status UserspaceTunUp(const char *ifname) {
+    struct ifreq ifr;
+    Status status = STATUS_ERROR;
+
+    int ioctlSock = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+    UTLT_Assert(ioctlSock >= 0, return STATUS_ERROR, "Socket for ioctl create failed: %s", strerror(errno));
+
+    memset(&ifr, 0, sizeof(ifr));
+    UTLT_Assert(UserspaceIfNameCopy(ifr.ifr_name, ifname) == STATUS_OK, goto CLOSEIOCTL, "");
+    ifr.ifr_mtu = USERSPACE_TUN_MTU;
+    UTLT_Assert(ioctl(ioctlSock, SIOCSIFMTU, &ifr) == 0, goto CLOSEIOCTL,
+        "Set MTU %d on %s failed: %s", USERSPACE_TUN_MTU, ifname, strerror(errno));
+
+    UTLT_Assert(ioctl(ioctlSock, SIOCGIFFLAGS, &ifr) == 0, goto CLOSEIOCTL,
+        "Get flags of %s failed: %s", ifname, strerror(errno));
+    ifr.ifr_flags |= IFF_UP | IFF_RUNNING;
+    UTLT_Assert(ioctl(ioctlSock, SIOCSIFFLAGS, &ifr) == 0, goto CLOSEIOCTL,
+        "Set %s up failed: %s", ifname, strerror(errno));
+
+    status = STATUS_OK;
+
+CLOSEIOCTL:
+    close(ioctlSock);
+
+    return status;
+}
+
+// Free sockets and TUN queues of receivers, the threads shall be stopped
+static void UserspaceReceiverFree() {
+    for (int i = 0; i < userspaceDevice.numOfReceiver; i++) {
+        UserspaceReceiver *receiver = &userspaceDevice.receiver[i];
+
+        if (receiver->sock)
+            UTLT_Assert(UdpFree(receiver->sock) == STATUS_OK, , "UDP server socket free fail");
+        receiver->sock = NULL;
+
+        // Routes to TUN device are removed with the last queue
+        if (receiver->tunFd >= 0)
+            close(receiver->tunFd);
+        receiver->tunFd = -1;
+    }
+}
+
+Status UserspaceDeviceInit(VirtualDevice *dev, const char *ip) {
+    UTLT_Assert(dev && ip, return STATUS_ERROR,
+        "VirtualDevice and address shall not be NULL");
+
+    memset(&userspaceDevice, 0, sizeof(UserspaceDevice));
+
+    userspaceDevice.PacketInL3 = dev->eventCB.PacketInL3;
+    userspaceDevice.PacketInGTPU = dev->eventCB.PacketInGTPU;
+    userspaceDevice.GetFARByID = dev->eventCB.getFAR;
+    userspaceDevice.GetQERByID = dev->eventCB.getQER;
+
+    int num = VirtualDeviceReceiverNum(dev, USERSPACE_MAX_RECEIVER);
+    userspaceDevice.numOfReceiver = num;
+    for (int i = 0; i < num; i++) {
+        userspaceDevice.receiver[i].id = i;
+        userspaceDevice.receiver[i].tunFd = -1;
+    }
+
+    // Sockets join SO_REUSEPORT group in order, so the index of receiver is the one in group
+    for (int i = 0; i < num; i++) {
+        UserspaceReceiver *receiver = &userspaceDevice.receiver[i];
+
+        receiver->tunFd = UserspaceTunOpen(dev->deviceID, num > 1);
+        UTLT_Assert(receiver->tunFd >= 0, goto FREERECEIVER, "TUN device for N6 create failed");
+
+        receiver->sock = (num > 1 ? UdpReusePortServerCreate(AF_INET, ip, GTPV1_U_UDP_PORT) :
+                                    UdpServerCreate(AF_INET, ip, GTPV1_U_UDP_PORT));
+        UTLT_Assert(receiver->sock, goto FREERECEIVER,
+            "UDP server create fail for N3: IP[%s] port[%d]", ip, GTPV1_U_UDP_PORT);
+    }
+
+    UTLT_Assert(UserspaceTunUp(userspaceDevice.ifname) == STATUS_OK, goto FREERECEIVER,
+        "TUN device %s set up failed", userspaceDevice.ifname);
+
+    UTLT_Assert(UdpReusePortSteerByTeid(userspaceDevice.receiver[0].sock, num, -1) == STATUS_OK,
+        goto FREERECEIVER, "Steer N3 by TEID failed");
+
+    for (int i = 0; i < num; i++) {
+        UserspaceReceiver *receiver = &userspaceDevice.receiver[i];
+
+        UTLT_Assert(ThreadCreate(&receiver->thread, UserspaceRecvThread, receiver) == STATUS_OK,
+            goto STOPRECEIVER, "Userspace receiver thread %d create failed", i);
+    }
+
+    return STATUS_OK;
+
+STOPRECEIVER:
+    for (int i = 0; i < num && userspaceDevice.receiver[i].thread; i++)
+        ThreadDelete(userspaceDevice.receiver[i].thread);
+FREERECEIVER:
+    UserspaceReceiverFree();
+
+    return STATUS_ERROR;
+}
+
+Status UserspaceDeviceTerm() {
+    Status status = STATUS_OK;
+    UserspaceCounter counter;
+
+    memset(&counter, 0, sizeof(counter));
+    for (int i = 0; i < userspaceDevice.numOfReceiver; i++) {
+        UserspaceReceiver *receiver = &userspaceDevice.receiver[i];
+
+        UTLT_Assert(ThreadDelete(receiver->thread) == STATUS_OK, status = STATUS_ERROR,
+            "Userspace receiver thread %d delete failed", i);
+
+        if (userspaceDevice.numOfReceiver > 1)
+            UTLT_Info("Userspace receiver %d: uplink %lu received, downlink %lu received",
+                      i, receiver->counter.rx[USERSPACE_N3], receiver->counter.rx[USERSPACE_N6]);
+
+        for (int dir = USERSPACE_N3; dir <= USERSPACE_N6; dir++) {
+            counter.rx[dir] += receiver->counter.rx[dir];
+            counter.tx[dir] += receiver->counter.tx[dir];
+        }
+        counter.noRule += receiver->counter.noRule;
+        counter.drop += receiver->counter.drop;
+        counter.error += receiver->counter.error;
+        counter.toUpf += receiver->counter.toUpf;
+    }
+
+    UTLT_Info("Userspace device: uplink %lu received %lu forwarded, downlink %lu received %lu forwarded",
+              counter.rx[USERSPACE_N3], counter.tx[USERSPACE_N6],
+              counter.rx[USERSPACE_N6], counter.tx[USERSPACE_N3]);
+    UTLT_Info("Userspace device: %lu no rule, %lu dropped, %lu send error, %lu to UPF",
+              counter.noRule, counter.drop, counter.error, counter.toUpf);
+
+    UserspaceReceiverFree();
+
+    return status;
+}
+
+Status UserspaceAddRoute(const char *ip, uint8_t prefix) {
+    struct rtentry route;
+    struct sockaddr_in *addr;
+    Status status = STATUS_OK;
+
+    UTLT_Assert(prefix <= 32, return STATUS_ERROR, "Prefix %u of %s is not IPv4", prefix, ip);
+
+    uint32_t mask = (prefix ? htonl(0xffffffff << (32 - prefix)) : 0);
+
+    memset(&route, 0, sizeof(route));
+    addr = (struct sockaddr_in *) &route.rt_genmask;
+    addr->sin_family = AF_INET;
+    addr->sin_addr.s_addr = mask;
+
+    // Host bits of destination shall be 0
+    addr = (struct sockaddr_in *) &route.rt_dst;
+    addr->sin_family = AF_INET;
+    UTLT_Assert(inet_pton(AF_INET, ip, &addr->sin_addr) == 1, return STATUS_ERROR,
+        "Route %s is not IPv4", ip);
+    addr->sin_addr.s_addr &= mask;
+
+    route.rt_flags = RTF_UP;
+    route.rt_dev = userspaceDevice.ifname;
+
+    int ioctlSock = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+    UTLT_Assert(ioctlSock >= 0, return STATUS_ERROR, "Socket for ioctl create failed: %s", strerror(errno));
+
+    UTLT_Assert(ioctl(ioctlSock, SIOCADDRT, &route) == 0 || errno == EEXIST, status = STATUS_ERROR,
+        "Add route %s/%u to %s failed: %s", ip, prefix, userspaceDevice.ifname, strerror(errno));
+    close(ioctlSock);
+
+    return status;
+}
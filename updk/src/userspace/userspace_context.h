@@ -0,0 +1,126 @@
+#ifndef __USERSPACE_CONTEXT_H__
+#define __USERSPACE_CONTEXT_H__
+
+/*
+ * This file would be included when the UP part runs in user space,
+ * otherwise it will not be used.
+ *
+ * N3 is a UDP socket on GTP-U port and N6 is a TUN device routing the
+ * subnets of DNN. A receiver thread takes packets of both in batches by
+ * recvmmsg and read, matches them by the callbacks of UPF, applies FAR and
+ * QER gate, then sends GTP-U by sendmmsg or writes IP packets to TUN.
+ *
+ * With more receivers, each one has its own N3 socket in a SO_REUSEPORT
+ * group steered by TEID and its own queue of a multi-queue TUN device, which
+ * kernel chooses by flow, so packets of a flow stay in order on one thread.
+ */
+
+#include <stdint.h>
+
+#include "utlt_debug.h"
+#include "utlt_network.h"
+#include "utlt_thread.h"
+
+#include "updk/env.h"
+
+#define USERSPACE_BATCH             32
+// Room for GTP-U header with PDU session container, so encapsulation is done in place
+#define USERSPACE_HEADROOM          16
+#define USERSPACE_MAX_PACKET_SIZE   2048
+#define USERSPACE_MAX_RECEIVER      16
+
+/**
+ * UserspaceCounter - Counters of packets
+ *
+ * @rx: Packets received from N3 (uplink) and N6 (downlink)
+ * @tx: Packets forwarded to N3 and N6
+ * @noRule: Packets matching no PDR
+ * @drop: Packets dropped by FAR, QER gate or unsupported forwarding
+ * @error: Packets failed to send
+ * @toUpf: Packets handled by UPF, e.g. echo and buffering
+ */
+typedef struct {
+    uint64_t rx[2];
+    uint64_t tx[2];
+    uint64_t noRule;
+    uint64_t drop;
+    uint64_t error;
+    uint64_t toUpf;
+} UserspaceCounter;
+
+enum {
+    USERSPACE_N3 = 0,
+    USERSPACE_N6,
+};
+
+/**
+ * UserspaceReceiver - A receiver thread with its own N3 socket and TUN queue
+ *
+ * @id: Index in UserspaceDevice, also the index of @sock in SO_REUSEPORT group
+ * @sock: UDP socket of N3
+ * @tunFd: fd of TUN device, or a queue of it if there are more receivers
+ * @thread: Thread receiving packets of @sock and @tunFd
+ * @counter: Only updated by @thread
+ */
+typedef struct {
+    int id;
+    Sock *sock;
+    int tunFd;
+    ThreadID thread;
+
+    UserspaceCounter counter;
+} UserspaceReceiver;
+
+/**
+ * UserspaceDevice - Structure for the TUN device and N3 sockets
+ *
+ * @ifname: Name of TUN device
+ * @receiver: Receivers, the socket of the first one is also used by UPF
+ * @PacketInL3, @PacketInGTPU, @GetFARByID, @GetQERByID: Methods from EnvParams
+ */
+typedef struct {
+    char ifname[MAX_IFNAME_STRLEN];
+
+    UserspaceReceiver receiver[USERSPACE_MAX_RECEIVER];
+    int numOfReceiver;
+
+    L3PacketInHandlerCB PacketInL3;
+    GTPUPacketInHandlerCB PacketInGTPU;
+    GetRule32CB GetFARByID;
+    GetRule32CB GetQERByID;
+} UserspaceDevice;
+
+/**
+ * UserspaceSelf - Get the real UserspaceDevice pointer
+ *
+ * @return: real UserspaceDevice pointer in userspace_context.c
+ */
+UserspaceDevice *UserspaceSelf();
+
+/**
+ * UserspaceDeviceInit - Create TUN device and N3 sockets on @ip for receivers of @dev
+ *
+ * @dev: VirtualDevice pointer for setting UserspaceDevice
+ * @ip: Address of N3
+ * @return: STATUS_OK or STATUS_ERROR if one of initialization part is failed
+ */
+Status UserspaceDeviceInit(VirtualDevice *dev, const char *ip);
+
+/**
+ * UserspaceDeviceTerm - Stop receivers and free TUN device and N3 sockets
+ *
+ * @return: STATUS_OK or STATUS_ERROR if one of termination part is failed
+ */
+Status UserspaceDeviceTerm();
+
+/**
+ * UserspaceAddRoute - Route @ip/@prefix to TUN device
+ *
+ * @return: STATUS_OK or STATUS_ERROR if route is not added
+ */
+Status UserspaceAddRoute(const char *ip, uint8_t prefix);
+
+// Receiver thread of userspace_path.c, @data is its UserspaceReceiver
+void UserspaceRecvThread(ThreadID id, void *data);
+
+#endif /* __USERSPACE_CONTEXT_H__ */
@@ -0,0 +1,306 @@
+#define _GNU_SOURCE    // recvmmsg and sendmmsg
+
+#include "userspace_context.h"
+
+/*
+ * This file would be included when the UP part runs in user space,
+ * otherwise it will not be used.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include "utlt_netheader.h"
+#include "utlt_3gppTypes.h"
+#include "utlt_rcu.h"
+
+#include "updk/rule_pdr.h"
+#include "updk/rule_far.h"
+#include "updk/rule_qer.h"
+
+#define USERSPACE_POLL_MSEC         300
+
+#define GTPV1_FLAGS                 0x30    // Version 1, GTP
+#define GTPV1_FLAGS_E               0x04
+#define GTPV1_FLAGS_OPT             0x07
+#define GTPV1_EXT_PDU_SESSION       0x85
+#define GTPV1_PDU_SESSION_LEN       8       // Optional field and PDU session container
+
+// QER gate values of 29.244 8.2.7
+#define QER_GATE_OPEN               0
+#define QERULGate(__gateStatus)     (((__gateStatus) & 0x0C) >> 2)
+#define QERDLGate(__gateStatus)     ((__gateStatus) & 0x03)
+
+typedef struct {
+    struct mmsghdr msg[USERSPACE_BATCH];
+    struct iovec iov[USERSPACE_BATCH];
+    struct sockaddr_in addr[USERSPACE_BATCH];
+} UserspaceBatch;
+
+typedef struct {
+    uint8_t data[USERSPACE_HEADROOM + USERSPACE_MAX_PACKET_SIZE];
+} UserspacePacket;
+
+/*
+ * Buffers of a receiver thread. N3 and N6 are received in turn to the same
+ * packets, GTP-U is built in place and sent from them.
+ */
+typedef struct {
+    UserspaceReceiver *receiver;
+
+    UserspacePacket rxPacket[USERSPACE_BATCH];
+    UserspaceBatch rxBatch;
+    UserspaceBatch txBatch;
+    int txNum;
+} UserspaceWork;
+
+static void UserspaceTxFlush(UserspaceWork *work) {
+    UserspaceCounter *counter = &work->receiver->counter;
+    UserspaceBatch *txBatch = &work->txBatch;
+    int sent = 0, num;
+
+    while (sent < work->txNum) {
+        num = sendmmsg(work->receiver->sock->fd, &txBatch->msg[sent], work->txNum - sent, 0);
+        if (num < 0) {
+            if (errno == EINTR)
+                continue;
+            // Drop the first one and go on, e.g. the peer is unreachable
+            UTLT_Debug("sendmmsg failed: %s", strerror(errno));
+            counter->error++;
+            num = 1;
+        } else {
+            counter->tx[USERSPACE_N3] += num;
+        }
+        sent += num;
+    }
+
+    work->txNum = 0;
+}
+
+/*
+ * Put GTP-U header in front of @payload, which has the headroom of
+ * USERSPACE_HEADROOM at least, and queue it to N3
+ */
+static void UserspaceGtpuSend(UserspaceWork *work, uint8_t *payload, uint16_t len,
+                              const UPDK_OuterHeaderCreation *ohc, const UPDK_QER *qer) {
+    int withQfi = (qer && qer->flags.qosFlowIdentifier);
+    uint16_t hdrLen = GTPV1_HEADER_LEN + (withQfi ? GTPV1_PDU_SESSION_LEN : 0);
+    uint8_t *hdr = payload - hdrLen;
+    Gtpv1Header *gtpHdr = (Gtpv1Header *) hdr;
+
+    gtpHdr->flags = GTPV1_FLAGS | (withQfi ? GTPV1_FLAGS_E : 0);
+    gtpHdr->type = GTPV1_T_PDU;
+    gtpHdr->_length = htons(len + hdrLen - GTPV1_HEADER_LEN);
+    gtpHdr->_teid = htonl(ohc->teid);
+
+    if (withQfi) {
+        uint8_t *ext = hdr + GTPV1_HEADER_LEN;
+        ext[0] = ext[1] = ext[2] = 0;           // Sequence number and N-PDU number
+        ext[3] = GTPV1_EXT_PDU_SESSION;
+        ext[4] = 1;                             // Length in 4 octets
+        ext[5] = 0;                             // PDU type of DL PDU session information
+        ext[6] = qer->qosFlowIdentifier & 0x3F;
+        ext[7] = 0;                             // No next extension header
+    }
+
+    UserspaceBatch *txBatch = &work->txBatch;
+    int txNum = work->txNum;
+    struct sockaddr_in *addr = &txBatch->addr[txNum];
+    addr->sin_family = AF_INET;
+    addr->sin_addr = ohc->ipv4;
+    addr->sin_port = htons(ohc->port ? ohc->port : GTPV1_U_UDP_PORT);
+
+    txBatch->iov[txNum].iov_base = hdr;
+    txBatch->iov[txNum].iov_len = len + hdrLen;
+    txBatch->msg[txNum].msg_hdr.msg_name = addr;
+    txBatch->msg[txNum].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+    txBatch->msg[txNum].msg_hdr.msg_iov = &txBatch->iov[txNum];
+    txBatch->msg[txNum].msg_hdr.msg_iovlen = 1;
+
+    if (++work->txNum == USERSPACE_BATCH)
+        UserspaceTxFlush(work);
+}
+
+/*
+ * Apply FAR to the inner packet @payload: to N3 if outer header creation
+ * is set, to N6 if the destination is core, otherwise drop it.
+ */
+static void UserspaceForward(UserspaceWork *work, uint8_t *payload, uint16_t len,
+                             const UPDK_PDRView *pdr, int uplink) {
+    UserspaceCounter *counter = &work->receiver->counter;
+
+    // Rules linked by UPF, which are kept until the batch leaves RCU read-side critical section
+    const UPDK_FAR *far = pdr->far;
+    if (!far || !(far->applyAction & UPDK_FAR_APPLY_ACTION_FORW)) {
+        // Buffered packets have been taken by UPF, so the left are dropped
+        counter->drop++;
+        return;
+    }
+
+    // Only the first QER is applied, the same as gtp5g
+    const UPDK_QER *qer = pdr->qer;
+    if (qer && qer->flags.gateStatus &&
+        (uplink ? QERULGate(qer->gateStatus) : QERDLGate(qer->gateStatus)) != QER_GATE_OPEN) {
+        counter->drop++;
+        return;
+    }
+
+    const UPDK_ForwardingParameters *param = &far->forwardingParameters;
+    if (far->flags.forwardingParameters && param->flags.outerHeaderCreation) {
+        if (!(param->outerHeaderCreation.description & UPDK_OUTER_HEADER_CREATION_DESCRIPTION_GTPU_UDP_IPV4)) {
+            UTLT_Debug("Outer header creation %u is not supported", param->outerHeaderCreation.description);
+            counter->drop++;
+            return;
+        }
+        UserspaceGtpuSend(work, payload, len, &param->outerHeaderCreation, qer);
+    } else if (uplink) {
+        if (write(work->receiver->tunFd, payload, len) == len)
+            counter->tx[USERSPACE_N6]++;
+        else
+            counter->error++;
+    } else {
+        counter->drop++;
+    }
+}
+
+// Return the length of GTP-U header in @pkt, or -1 if it is broken
+static int UserspaceGtpuHeaderLen(const uint8_t *pkt, uint16_t pktlen) {
+    int len = GTPV1_HEADER_LEN + ((pkt[0] & GTPV1_FLAGS_OPT) ? GTPV1_OPT_HEADER_LEN : 0);
+
+    if (len > pktlen)
+        return -1;
+
+    if (pkt[0] & GTPV1_FLAGS_E) {
+        // The last octet of each header is the type of next extension header
+        while (pkt[len - 1]) {
+            if (len >= pktlen || !pkt[len])
+                return -1;
+            len += pkt[len] * 4;
+            if (len > pktlen)
+                return -1;
+        }
+    }
+
+    return len;
+}
+
+static void UserspaceN3Receive(UserspaceWork *work) {
+    UserspaceDevice *dev = UserspaceSelf();
+    UserspaceReceiver *receiver = work->receiver;
+    UserspaceBatch *rxBatch = &work->rxBatch;
+    UPDK_PDRView pdr;
+    int num;
+
+    for (int i = 0; i < USERSPACE_BATCH; i++) {
+        rxBatch->iov[i].iov_base = work->rxPacket[i].data + USERSPACE_HEADROOM;
+        rxBatch->iov[i].iov_len = USERSPACE_MAX_PACKET_SIZE;
+        rxBatch->msg[i].msg_hdr.msg_name = &rxBatch->addr[i];
+        rxBatch->msg[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+        rxBatch->msg[i].msg_hdr.msg_iov = &rxBatch->iov[i];
+        rxBatch->msg[i].msg_hdr.msg_iovlen = 1;
+        rxBatch->msg[i].msg_hdr.msg_control = NULL;
+        rxBatch->msg[i].msg_hdr.msg_controllen = 0;
+    }
+
+    num = recvmmsg(receiver->sock->fd, rxBatch->msg, USERSPACE_BATCH, MSG_DONTWAIT, NULL);
+    if (num <= 0)
+        return;
+    receiver->counter.rx[USERSPACE_N3] += num;
+
+    RcuReadLock();
+    for (int i = 0; i < num; i++) {
+        uint8_t *pkt = rxBatch->iov[i].iov_base;
+        uint16_t pktlen = rxBatch->msg[i].msg_len;
+
+        // Echo, end marker, buffering and error are handled by UPF
+        int status = dev->PacketInGTPU(pkt, pktlen, rxBatch->addr[i].sin_addr.s_addr,
+                                       rxBatch->addr[i].sin_port, &pdr);
+        if (status) {
+            if (status > 0)
+                receiver->counter.toUpf++;
+            else
+                receiver->counter.noRule++;
+            continue;
+        }
+
+        int hdrLen = UserspaceGtpuHeaderLen(pkt, pktlen);
+        if (hdrLen < 0) {
+            receiver->counter.drop++;
+            continue;
+        }
+
+        UserspaceForward(work, pkt + hdrLen, pktlen - hdrLen, &pdr, 1);
+    }
+    RcuReadUnlock();
+}
+
+static void UserspaceN6Receive(UserspaceWork *work) {
+    UserspaceDevice *dev = UserspaceSelf();
+    UserspaceReceiver *receiver = work->receiver;
+    UPDK_PDRView pdr;
+
+    // TUN has no batch read, so read until it is empty or the batch is full
+    RcuReadLock();
+    for (int i = 0; i < USERSPACE_BATCH; i++) {
+        uint8_t *pkt = work->rxPacket[i].data + USERSPACE_HEADROOM;
+        ssize_t pktlen = read(receiver->tunFd, pkt, USERSPACE_MAX_PACKET_SIZE);
+        if (pktlen <= 0)
+            break;
+        receiver->counter.rx[USERSPACE_N6]++;
+
+        int status = dev->PacketInL3(pkt, pktlen, &pdr);
+        if (status) {
+            if (status > 0)
+                receiver->counter.toUpf++;
+            else
+                receiver->counter.noRule++;
+            continue;
+        }
+
+        UserspaceForward(work, pkt, pktlen, &pdr, 0);
+    }
+    RcuReadUnlock();
+}
+
+void UserspaceRecvThread(ThreadID id, void *data) {
+    UserspaceReceiver *receiver = data;
+    struct pollfd pfd[2] = {
+        [USERSPACE_N3] = {.fd = receiver->sock->fd, .events = POLLIN},
+        [USERSPACE_N6] = {.fd = receiver->tunFd, .events = POLLIN},
+    };
+
+    UserspaceWork *work = calloc(1, sizeof(UserspaceWork));
+    UTLT_Assert(work, goto STOP, "Userspace receiver %d buffer alloc failed", receiver->id);
+    work->receiver = receiver;
+
+    while (!ThreadStop()) {
+        int nfds = poll(pfd, 2, USERSPACE_POLL_MSEC);
+        UTLT_Assert(nfds >= 0 || errno == EINTR, break, "Poll error : %s", strerror(errno));
+        if (nfds <= 0)
+            continue;
+
+        // Rules may be changed by UPF between batches
+        if (pfd[USERSPACE_N3].revents & POLLIN) {
+            UserspaceN3Receive(work);
+            UserspaceTxFlush(work);
+        }
+        if (pfd[USERSPACE_N6].revents & POLLIN) {
+            UserspaceN6Receive(work);
+            UserspaceTxFlush(work);
+        }
+    }
+
+    free(work);
+    RcuThreadOffline();
+
+STOP:
+    sem_post(((Thread *)id)->semaphore);
+    UTLT_Trace("Userspace receiver thread %d terminated", receiver->id);
+
+    return;
+}
@@ -0,0 +1,60 @@
+#include "updk/init.h"
+
+/*
+ * These functions shall be customized by kinds of device.
+ * You can create a directory and put all customized function
+ * in there, like "device.c" under "updk/src/kernel/".
+ */
+
+#include <string.h>
+
+#include "utlt_debug.h"
+
+#include "updk/env.h"
+#include "xdp_context.h"
+
+int Gtpv1EnvInit(EnvParams *env) {
+    UTLT_Assert(env, return -1, "EnvParams is NULL");
+
+    VirtualDevice *dev = env->virtualDevice;
+    UTLT_Assert(dev, return -1, "VirtualDevice is NULL");
+
+    int vPortCnt = 0;
+    const char *ip = NULL;
+    VirtualPort *port;
+    VirtualDeviceForEachVirtualPort(port, dev) {
+        UTLT_Debug("Get VirtualPort Info in VirtualDevice: %s", port->ipStr);
+        if (!vPortCnt)
+            ip = port->ipStr;
+        vPortCnt++;
+    }
+
+    UTLT_Assert(vPortCnt == 1, return -1, "XDP device needs one GTP-U address, not %d", vPortCnt);
+
+    UTLT_Assert(XdpDeviceInit(dev, ip) == STATUS_OK,
+            return -1, "XdpDeviceInit failed");
+
+    // DNN subnets are steered on the netdev of natifname, which is N6
+    DNN *dnn;
+    EnvParamsForEachDNN(dnn, env) {
+        UTLT_Assert(dnn->natifname[0], return -1,
+            "natifname of DNN %s is needed as N6 of XDP device", dnn->name);
+        UTLT_Assert(XdpDeviceAddN6(dnn->natifname, dnn->ipStr, dnn->subnetPrefix) == STATUS_OK,
+            return -1, "Add N6 of DNN %s to XDP device failed: %s/%u", dnn->name, dnn->ipStr, dnn->subnetPrefix);
+    }
+
+    UTLT_Assert(XdpDeviceStart() == STATUS_OK, return -1, "XdpDeviceStart failed");
+
+    UTLT_Info("XDP UPDK device forwards N3 on %s", ip);
+
+    // UPF sends buffered packets and echo responses by N3 socket
+    return XdpSelf()->sock->fd;
+}
+
+int Gtpv1EnvTerm(EnvParams *env) {
+    UTLT_Assert(env, return -1, "EnvParams is NULL");
+
+    UTLT_Assert(XdpDeviceTerm() == STATUS_OK, return -1, "XdpDeviceTerm failed");
+
+    return 0;
+}
@@ -0,0 +1,89 @@
+#include "updk/rule.h"
+
+#include "utlt_debug.h"
+
+/*
+ * UPF keeps the rules and matches packets for this device by the callbacks
+ * in EnvParams, so rules are only checked here and take effect at once.
+ * See xdp_path.c.
+ */
+
+int Gtpv1TunnelTransactionBegin() {
+    return 0;
+}
+
+int Gtpv1TunnelTransactionCommit() {
+    return 0;
+}
+
+int Gtpv1TunnelCreatePDR(UPDK_PDR *pdr) {
+    UTLT_Assert(pdr, return -1, "PDR is NULL");
+    UTLT_Assert(pdr->flags.pdrId, return -1, "PDR ID is missing");
+    UTLT_Debug("XDP create PDR: %u", pdr->pdrId);
+
+    return 0;
+}
+
+int Gtpv1TunnelUpdatePDR(UPDK_PDR *pdr) {
+    UTLT_Assert(pdr, return -1, "PDR is NULL");
+    UTLT_Assert(pdr->flags.pdrId, return -1, "PDR ID is missing");
+    UTLT_Debug("XDP update PDR: %u", pdr->pdrId);
+
+    return 0;
+}
+
+int Gtpv1TunnelRemovePDR(UPDK_PDR *pdr) {
+    UTLT_Assert(pdr, return -1, "PDR is NULL");
+    UTLT_Assert(pdr->flags.pdrId, return -1, "PDR ID is missing");
+    UTLT_Debug("XDP remove PDR: %u", pdr->pdrId);
+
+    return 0;
+}
+
+int Gtpv1TunnelCreateFAR(UPDK_FAR *far) {
+    UTLT_Assert(far, return -1, "FAR is NULL");
+    UTLT_Assert(far->flags.farId, return -1, "FAR ID is missing");
+    UTLT_Debug("XDP create FAR: %u", far->farId);
+
+    return 0;
+}
+
+int Gtpv1TunnelUpdateFAR(UPDK_FAR *far) {
+    UTLT_Assert(far, return -1, "FAR is NULL");
+    UTLT_Assert(far->flags.farId, return -1, "FAR ID is missing");
+    UTLT_Debug("XDP update FAR: %u", far->farId);
+
+    return 0;
+}
+
+int Gtpv1TunnelRemoveFAR(UPDK_FAR *far) {
+    UTLT_Assert(far, return -1, "FAR is NULL");
+    UTLT_Assert(far->flags.farId, return -1, "FAR ID is missing");
+    UTLT_Debug("XDP remove FAR: %u", far->farId);
+
+    return 0;
+}
+
+int Gtpv1TunnelCreateQER(UPDK_QER *qer) {
+    UTLT_Assert(qer, return -1, "QER is NULL");
+    UTLT_Assert(qer->flags.qerId, return -1, "QER ID is missing");
+    UTLT_Debug("XDP create QER: %u", qer->qerId);
+
+    return 0;
+}
+
+int Gtpv1TunnelUpdateQER(UPDK_QER *qer) {
+    UTLT_Assert(qer, return -1, "QER is NULL");
+    UTLT_Assert(qer->flags.qerId, return -1, "QER ID is missing");
+    UTLT_Debug("XDP update QER: %u", qer->qerId);
+
+    return 0;
+}
+
+int Gtpv1TunnelRemoveQER(UPDK_QER *qer) {
+    UTLT_Assert(qer, return -1, "QER is NULL");
+    UTLT_Assert(qer->flags.qerId, return -1, "QER ID is missing");
+    UTLT_Debug("XDP remove QER: %u", qer->qerId);
+
+    return 0;
+}
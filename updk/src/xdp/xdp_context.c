@@ -0,0 +1,346 @@
+#include "xdp_context.h"
+
+/*
+ * This file would be included when the UP part runs on AF_XDP,
+ * otherwise it will not be used.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <ifaddrs.h>
+#include <net/if.h>
+#include <arpa/inet.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <linux/if_xdp.h>
+#include <linux/if_link.h>
+
+#include "utlt_3gppTypes.h"
+
+#ifndef AF_XDP
+#define AF_XDP  44
+#endif
+#ifndef SOL_XDP
+#define SOL_XDP 283
+#endif
+
+static XdpDevice xdpDevice;
+
+XdpDevice *XdpSelf() {
+    return &xdpDevice;
+}
+
+static XdpPort *XdpPortGet(const char *ifname) {
+    for (int i = 0; i < xdpDevice.numOfPort; i++) {
+        if (!strcmp(xdpDevice.port[i].ifname, ifname))
+            return &xdpDevice.port[i];
+    }
+
+    UTLT_Assert(xdpDevice.numOfPort < XDP_MAX_PORT, return NULL,
+        "XDP device supports %d ports at most", XDP_MAX_PORT);
+    // Netdev names are shorter than IFNAMSIZ, so they are copied to ifreq and arpreq as a whole
+    UTLT_Assert(strnlen(ifname, IFNAMSIZ) < IFNAMSIZ, return NULL, "ifname %s is too long", ifname);
+
+    XdpPort *port = &xdpDevice.port[xdpDevice.numOfPort];
+    memset(port, 0, sizeof(XdpPort));
+    strcpy(port->ifname, ifname);
+    port->xskFd = port->mapFd = port->progFd = port->linkFd = -1;
+
+    port->ifindex = if_nametoindex(ifname);
+    UTLT_Assert(port->ifindex, return NULL, "netdev %s does not exist", ifname);
+
+    struct ifreq ifr;
+    int ioctlSock = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+    UTLT_Assert(ioctlSock >= 0, return NULL, "Socket for ioctl create failed: %s", strerror(errno));
+    memset(&ifr, 0, sizeof(ifr));
+    memcpy(ifr.ifr_name, port->ifname, IFNAMSIZ);
+    int ret = ioctl(ioctlSock, SIOCGIFHWADDR, &ifr);
+    close(ioctlSock);
+    UTLT_Assert(ret == 0, return NULL, "Get MAC of %s failed: %s", ifname, strerror(errno));
+    memcpy(port->mac, ifr.ifr_hwaddr.sa_data, ETH_ALEN);
+
+    xdpDevice.numOfPort++;
+
+    return port;
+}
+
+Status XdpDeviceInit(VirtualDevice *dev, const char *ip) {
+    struct ifaddrs *ifaddr, *ifa;
+    struct in_addr addr;
+
+    UTLT_Assert(dev && ip, return STATUS_ERROR,
+        "VirtualDevice and address shall not be NULL");
+    UTLT_Assert(inet_pton(AF_INET, ip, &addr) == 1 && addr.s_addr != INADDR_ANY, return STATUS_ERROR,
+        "XDP device needs one IPv4 address of N3, not %s", ip);
+
+    memset(&xdpDevice, 0, sizeof(XdpDevice));
+    xdpDevice.rawFd = -1;
+    xdpDevice.n3Addr = addr.s_addr;
+
+    xdpDevice.PacketInL3 = dev->eventCB.PacketInL3;
+    xdpDevice.PacketInGTPU = dev->eventCB.PacketInGTPU;
+    xdpDevice.GetFARByID = dev->eventCB.getFAR;
+    xdpDevice.GetQERByID = dev->eventCB.getQER;
+
+    UTLT_Assert(getifaddrs(&ifaddr) == 0, return STATUS_ERROR, "getifaddrs failed: %s", strerror(errno));
+    for (ifa = ifaddr; ifa; ifa = ifa->ifa_next) {
+        if (ifa->ifa_addr && ifa->ifa_addr->sa_family == AF_INET &&
+            ((struct sockaddr_in *) ifa->ifa_addr)->sin_addr.s_addr == addr.s_addr)
+            break;
+    }
+    if (ifa)
+        xdpDevice.n3 = XdpPortGet(ifa->ifa_name);
+    freeifaddrs(ifaddr);
+
+    UTLT_Assert(ifa, return STATUS_ERROR, "No netdev has the N3 address %s", ip);
+    UTLT_Assert(xdpDevice.n3, return STATUS_ERROR, "N3 port of %s add failed", ip);
+    xdpDevice.n3->role |= XDP_PORT_N3;
+
+    return STATUS_OK;
+}
+
+Status XdpDeviceAddN6(const char *ifname, const char *ip, uint8_t prefix) {
+    struct in_addr addr;
+
+    UTLT_Assert(ifname && ifname[0], return STATUS_ERROR, "ifname of N6 shall not be empty");
+    UTLT_Assert(prefix <= 32 && inet_pton(AF_INET, ip, &addr) == 1, return STATUS_ERROR,
+        "Subnet %s/%u is not IPv4", ip, prefix);
+
+    XdpPort *port = XdpPortGet(ifname);
+    UTLT_Assert(port, return STATUS_ERROR, "N6 port %s add failed", ifname);
+    UTLT_Assert(port->numOfSubnet < XDP_MAX_SUBNET, return STATUS_ERROR,
+        "XDP port %s supports %d subnets at most", ifname, XDP_MAX_SUBNET);
+
+    uint32_t mask = (prefix ? htonl(0xffffffff << (32 - prefix)) : 0);
+    port->subnet[port->numOfSubnet] = addr.s_addr & mask;
+    port->mask[port->numOfSubnet] = mask;
+    port->numOfSubnet++;
+    port->role |= XDP_PORT_N6;
+
+    return STATUS_OK;
+}
+
+static Status XdpRingMap(XdpRing *ring, int fd, const struct xdp_ring_offset *off,
+                         size_t entrySize, off_t pgoff) {
+    ring->mapLen = off->desc + XDP_RING_SIZE * entrySize;
+    ring->map = mmap(NULL, ring->mapLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, pgoff);
+    UTLT_Assert(ring->map != MAP_FAILED, ring->map = NULL; return STATUS_ERROR,
+        "AF_XDP ring mmap failed: %s", strerror(errno));
+
+    ring->producer = (uint32_t *) ((uint8_t *) ring->map + off->producer);
+    ring->consumer = (uint32_t *) ((uint8_t *) ring->map + off->consumer);
+    ring->flags = (uint32_t *) ((uint8_t *) ring->map + off->flags);
+    ring->desc = (uint8_t *) ring->map + off->desc;
+    ring->mask = XDP_RING_SIZE - 1;
+
+    return STATUS_OK;
+}
+
+static void XdpRingUnmap(XdpRing *ring) {
+    if (ring->map)
+        munmap(ring->map, ring->mapLen);
+    memset(ring, 0, sizeof(XdpRing));
+}
+
+static void XdpSocketClose(XdpPort *port) {
+    XdpRingUnmap(&port->rx);
+    XdpRingUnmap(&port->tx);
+    XdpRingUnmap(&port->fill);
+    XdpRingUnmap(&port->comp);
+    if (port->xskFd >= 0)
+        close(port->xskFd);
+    port->xskFd = -1;
+    port->txPending = 0;
+}
+
+/*
+ * The first socket registers UMEM, and the others share it with their own
+ * fill and completion rings, since they are on other netdevs
+ */
+static Status XdpSocketOpen(XdpPort *port, int umemFd) {
+    int ringSize = XDP_RING_SIZE;
+    struct xdp_mmap_offsets off;
+    socklen_t optlen = sizeof(off);
+    struct sockaddr_xdp sxdp;
+
+    port->xskFd = socket(AF_XDP, SOCK_RAW | SOCK_CLOEXEC, 0);
+    UTLT_Assert(port->xskFd >= 0, return STATUS_ERROR, "AF_XDP socket create failed: %s", strerror(errno));
+
+    if (umemFd < 0) {
+        struct xdp_umem_reg reg = {
+            .addr = (uintptr_t) xdpDevice.umem,
+            .len = xdpDevice.umemLen,
+            .chunk_size = XDP_FRAME_SIZE,
+            .headroom = 0,
+        };
+        UTLT_Assert(setsockopt(port->xskFd, SOL_XDP, XDP_UMEM_REG, &reg, sizeof(reg)) == 0, goto FAIL,
+            "UMEM register failed: %s", strerror(errno));
+    }
+
+    UTLT_Assert(setsockopt(port->xskFd, SOL_XDP, XDP_UMEM_FILL_RING, &ringSize, sizeof(ringSize)) == 0 &&
+                setsockopt(port->xskFd, SOL_XDP, XDP_UMEM_COMPLETION_RING, &ringSize, sizeof(ringSize)) == 0 &&
+                setsockopt(port->xskFd, SOL_XDP, XDP_RX_RING, &ringSize, sizeof(ringSize)) == 0 &&
+                setsockopt(port->xskFd, SOL_XDP, XDP_TX_RING, &ringSize, sizeof(ringSize)) == 0,
+                goto FAIL, "AF_XDP rings of %s set failed: %s", port->ifname, strerror(errno));
+
+    UTLT_Assert(getsockopt(port->xskFd, SOL_XDP, XDP_MMAP_OFFSETS, &off, &optlen) == 0, goto FAIL,
+        "AF_XDP ring offsets get failed: %s", strerror(errno));
+    UTLT_Assert(XdpRingMap(&port->rx, port->xskFd, &off.rx, sizeof(struct xdp_desc), XDP_PGOFF_RX_RING) == STATUS_OK &&
+                XdpRingMap(&port->tx, port->xskFd, &off.tx, sizeof(struct xdp_desc), XDP_PGOFF_TX_RING) == STATUS_OK &&
+                XdpRingMap(&port->fill, port->xskFd, &off.fr, sizeof(uint64_t), XDP_UMEM_PGOFF_FILL_RING) == STATUS_OK &&
+                XdpRingMap(&port->comp, port->xskFd, &off.cr, sizeof(uint64_t), XDP_UMEM_PGOFF_COMPLETION_RING) == STATUS_OK,
+                goto FAIL, "AF_XDP rings of %s map failed", port->ifname);
+
+    // All entries of fill and TX rings are free at first
+    port->fill.cached = *port->fill.producer;
+    port->tx.cached = *port->tx.producer;
+
+    memset(&sxdp, 0, sizeof(sxdp));
+    sxdp.sxdp_family = AF_XDP;
+    sxdp.sxdp_ifindex = port->ifindex;
+    sxdp.sxdp_queue_id = 0;
+    if (umemFd < 0) {
+        sxdp.sxdp_flags = (xdpDevice.zeroCopy ? XDP_ZEROCOPY : XDP_COPY) | XDP_USE_NEED_WAKEUP;
+    } else {
+        // Mode is taken from the socket of UMEM
+        sxdp.sxdp_flags = XDP_SHARED_UMEM;
+        sxdp.sxdp_shared_umem_fd = umemFd;
+    }
+    // Failure of zero-copy is expected on most netdevs, and copy mode is tried later
+    UTLT_Level_Assert((xdpDevice.zeroCopy ? LOG_DEBUG : LOG_ERROR),
+        bind(port->xskFd, (struct sockaddr *) &sxdp, sizeof(sxdp)) == 0, goto FAIL,
+        "AF_XDP socket bind to %s queue 0 in %s mode failed: %s", port->ifname,
+        (xdpDevice.zeroCopy ? "zero-copy" : "copy"), strerror(errno));
+
+    return STATUS_OK;
+
+FAIL:
+    XdpSocketClose(port);
+    return STATUS_ERROR;
+}
+
+static Status XdpSocketOpenAll() {
+    for (int i = 0; i < xdpDevice.numOfPort; i++) {
+        if (XdpSocketOpen(&xdpDevice.port[i], (i ? xdpDevice.port[0].xskFd : -1)) != STATUS_OK) {
+            for (int j = 0; j < i; j++)
+                XdpSocketClose(&xdpDevice.port[j]);
+            return STATUS_ERROR;
+        }
+    }
+
+    return STATUS_OK;
+}
+
+// Frames circulate through fill, RX, TX and completion rings, so each port takes twice of ring size
+static Status XdpUmemCreate() {
+    xdpDevice.numOfFrame = xdpDevice.numOfPort * XDP_RING_SIZE * 2;
+    xdpDevice.umemLen = (size_t) xdpDevice.numOfFrame * XDP_FRAME_SIZE;
+
+    xdpDevice.umem = mmap(NULL, xdpDevice.umemLen, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    UTLT_Assert(xdpDevice.umem != MAP_FAILED, xdpDevice.umem = NULL; return STATUS_ERROR,
+        "UMEM of %zu bytes alloc failed: %s", xdpDevice.umemLen, strerror(errno));
+
+    xdpDevice.freeFrame = malloc(xdpDevice.numOfFrame * sizeof(uint64_t));
+    UTLT_Assert(xdpDevice.freeFrame, return STATUS_ERROR, "No space to alloc frame stack");
+    for (uint32_t i = 0; i < xdpDevice.numOfFrame; i++)
+        xdpDevice.freeFrame[i] = (uint64_t) i * XDP_FRAME_SIZE;
+    xdpDevice.numOfFreeFrame = xdpDevice.numOfFrame;
+
+    return STATUS_OK;
+}
+
+static void XdpUmemFree() {
+    if (xdpDevice.umem)
+        munmap(xdpDevice.umem, xdpDevice.umemLen);
+    free(xdpDevice.freeFrame);
+    xdpDevice.umem = NULL;
+    xdpDevice.freeFrame = NULL;
+}
+
+Status XdpDeviceStart() {
+    char ip[INET_ADDRSTRLEN];
+
+    UTLT_Assert(xdpDevice.n3, return STATUS_ERROR, "XDP device has no N3 port");
+    UTLT_Assert(xdpDevice.numOfPort > 1 || (xdpDevice.n3->role & XDP_PORT_N6), return STATUS_ERROR,
+        "XDP device has no N6 port");
+
+    UTLT_Assert(XdpUmemCreate() == STATUS_OK, goto FAIL, "");
+
+    // Zero-copy needs the support of driver, copy mode works on any netdev
+    xdpDevice.zeroCopy = 1;
+    if (XdpSocketOpenAll() != STATUS_OK) {
+        UTLT_Info("AF_XDP zero-copy is not supported, use copy mode");
+        xdpDevice.zeroCopy = 0;
+        UTLT_Assert(XdpSocketOpenAll() == STATUS_OK, goto FAIL, "AF_XDP sockets open failed");
+    }
+
+    for (int i = 0; i < xdpDevice.numOfPort; i++)
+        UTLT_Assert(XdpProgAttach(&xdpDevice.port[i], xdpDevice.n3Addr) == STATUS_OK, goto FAIL,
+            "XDP program attach to %s failed", xdpDevice.port[i].ifname);
+
+    inet_ntop(AF_INET, &xdpDevice.n3Addr, ip, sizeof(ip));
+    xdpDevice.sock = UdpServerCreate(AF_INET, ip, GTPV1_U_UDP_PORT);
+    UTLT_Assert(xdpDevice.sock, goto FAIL,
+        "UDP server create fail for N3: IP[%s] port[%d]", ip, GTPV1_U_UDP_PORT);
+
+    xdpDevice.rawFd = socket(AF_INET, SOCK_RAW | SOCK_CLOEXEC, IPPROTO_RAW);
+    UTLT_Assert(xdpDevice.rawFd >= 0, goto FAIL, "Raw socket for N6 create failed: %s", strerror(errno));
+
+    UTLT_Assert(ThreadCreate(&xdpDevice.recvThread, XdpRecvThread, NULL) == STATUS_OK,
+        goto FAIL, "XDP worker thread create failed");
+
+    for (int i = 0; i < xdpDevice.numOfPort; i++) {
+        XdpPort *port = &xdpDevice.port[i];
+        UTLT_Info("XDP port %s:%s%s in %s XDP and %s mode", port->ifname,
+                  (port->role & XDP_PORT_N3 ? " N3" : ""), (port->role & XDP_PORT_N6 ? " N6" : ""),
+                  (port->xdpMode & XDP_FLAGS_DRV_MODE ? "native" : "generic"),
+                  (xdpDevice.zeroCopy ? "zero-copy" : "copy"));
+    }
+
+    return STATUS_OK;
+
+FAIL:
+    if (xdpDevice.rawFd >= 0)
+        close(xdpDevice.rawFd);
+    xdpDevice.rawFd = -1;
+    if (xdpDevice.sock)
+        UdpFree(xdpDevice.sock);
+    xdpDevice.sock = NULL;
+    for (int i = 0; i < xdpDevice.numOfPort; i++) {
+        XdpProgDetach(&xdpDevice.port[i]);
+        XdpSocketClose(&xdpDevice.port[i]);
+    }
+    XdpUmemFree();
+
+    return STATUS_ERROR;
+}
+
+Status XdpDeviceTerm() {
+    Status status = STATUS_OK;
+    XdpCounter *counter = &xdpDevice.counter;
+
+    UTLT_Assert(ThreadDelete(xdpDevice.recvThread) == STATUS_OK, status = STATUS_ERROR,
+        "XDP worker thread delete failed");
+
+    UTLT_Info("XDP device: uplink %lu received %lu forwarded, downlink %lu received %lu forwarded",
+              counter->rx[XDP_N3], counter->tx[XDP_N6], counter->rx[XDP_N6], counter->tx[XDP_N3]);
+    UTLT_Info("XDP device: %lu no rule, %lu dropped, %lu send error, %lu to UPF, %lu by kernel",
+              counter->noRule, counter->drop, counter->error, counter->toUpf, counter->slowPath);
+
+    for (int i = 0; i < xdpDevice.numOfPort; i++) {
+        XdpProgDetach(&xdpDevice.port[i]);
+        XdpSocketClose(&xdpDevice.port[i]);
+    }
+    XdpUmemFree();
+
+    UTLT_Assert(UdpFree(xdpDevice.sock) == STATUS_OK, status = STATUS_ERROR,
+        "UDP server socket free fail");
+    close(xdpDevice.rawFd);
+    xdpDevice.rawFd = -1;
+
+    return status;
+}
@@ -0,0 +1,215 @@
+#ifndef __XDP_CONTEXT_H__
+#define __XDP_CONTEXT_H__
+
+/*
+ * This file would be included when the UP part runs on AF_XDP,
+ * otherwise it will not be used.
+ *
+ * Each port is a netdev with an XDP program, which steers GTP-U to the N3
+ * address and IPv4 to the subnets of DNN into an AF_XDP socket, and passes
+ * the others to kernel. All sockets share one UMEM, so a frame received on
+ * one port is decapsulated or encapsulated in place and sent on the other
+ * without copy. A worker thread matches packets by the callbacks of UPF and
+ * applies FAR and QER gate, the same as the userspace device.
+ */
+
+#include <stdint.h>
+#include <net/ethernet.h>
+#include <netinet/in.h>
+
+#include "utlt_debug.h"
+#include "utlt_network.h"
+#include "utlt_thread.h"
+
+#include "updk/env.h"
+
+#define XDP_MAX_PORT                4
+#define XDP_MAX_SUBNET              8       // DNN subnets steered on a port
+#define XDP_FRAME_SIZE              2048
+#define XDP_RING_SIZE               1024
+#define XDP_BATCH                   64
+#define XDP_NEIGH_SIZE              4096    // Power of 2
+
+// Role of port
+#define XDP_PORT_N3                 0x1
+#define XDP_PORT_N6                 0x2
+
+enum {
+    XDP_N3 = 0,
+    XDP_N6,
+};
+
+/**
+ * XdpCounter - Counters of packets
+ *
+ * @rx: Packets received from N3 (uplink) and N6 (downlink)
+ * @tx: Packets forwarded to N3 and N6
+ * @noRule: Packets matching no PDR
+ * @drop: Packets dropped by FAR, QER gate, unsupported forwarding or broken header
+ * @error: Packets failed to send, e.g. TX ring is full
+ * @toUpf: Packets handled by UPF, e.g. echo and buffering
+ * @slowPath: Forwarded packets sent by kernel, since next hop is unknown
+ */
+typedef struct {
+    uint64_t rx[2];
+    uint64_t tx[2];
+    uint64_t noRule;
+    uint64_t drop;
+    uint64_t error;
+    uint64_t toUpf;
+    uint64_t slowPath;
+} XdpCounter;
+
+/**
+ * XdpRing - Ring shared with kernel
+ *
+ * @producer, @consumer, @flags: Pointers in mmap area
+ * @desc: struct xdp_desc of RX/TX or uint64_t address of fill/completion
+ * @cached: Local producer of fill/TX, or local consumer of RX/completion
+ */
+typedef struct {
+    uint32_t *producer;
+    uint32_t *consumer;
+    uint32_t *flags;
+    void *desc;
+    uint32_t mask;
+    uint32_t cached;
+
+    void *map;
+    size_t mapLen;
+} XdpRing;
+
+/**
+ * XdpPort - Structure for a netdev with its AF_XDP socket and XDP program
+ *
+ * @ifname, @ifindex, @mac: netdev bound on queue 0
+ * @role: XDP_PORT_N3, XDP_PORT_N6 or both
+ * @subnet, @mask: DNN subnets in network order, steered if @role has XDP_PORT_N6
+ * @xskFd: AF_XDP socket
+ * @rx, @tx, @fill, @comp: Rings of @xskFd
+ * @txPending: Descriptors in @tx not sent to kernel yet
+ * @mapFd, @progFd, @linkFd: XSKMAP, XDP program and its link on @ifindex
+ * @xdpMode: XDP_FLAGS_DRV_MODE or XDP_FLAGS_SKB_MODE
+ */
+typedef struct {
+    char ifname[MAX_IFNAME_STRLEN];
+    int ifindex;
+    uint8_t mac[ETH_ALEN];
+    int role;
+
+    int numOfSubnet;
+    uint32_t subnet[XDP_MAX_SUBNET];
+    uint32_t mask[XDP_MAX_SUBNET];
+
+    int xskFd;
+    XdpRing rx;
+    XdpRing tx;
+    XdpRing fill;
+    XdpRing comp;
+    uint32_t txPending;
+
+    int mapFd;
+    int progFd;
+    int linkFd;
+    uint32_t xdpMode;
+} XdpPort;
+
+/**
+ * XdpNeigh - Next hop learned from source of received frames or ARP table
+ *
+ * @port: Index of XdpPort plus 1, 0 if the entry is empty
+ */
+typedef struct {
+    uint32_t ip;
+    uint8_t mac[ETH_ALEN];
+    uint8_t port;
+} XdpNeigh;
+
+/**
+ * XdpDevice - Structure for the ports and their shared UMEM
+ *
+ * @port: Ports, @n3 is one of them
+ * @n3Addr: GTP-U address of N3 in network order
+ * @umem: Frames of XDP_FRAME_SIZE shared by all ports
+ * @freeFrame: Stack of frames owned by user space
+ * @zeroCopy: Sockets are bound in XDP_ZEROCOPY, otherwise XDP_COPY, both with XDP_USE_NEED_WAKEUP
+ * @sock: UDP socket of N3 for UPF and slow path
+ * @rawFd: Raw IP socket for slow path of N6
+ * @neigh: Next hops, only used by @recvThread
+ * @PacketInL3, @PacketInGTPU, @GetFARByID, @GetQERByID: Methods from EnvParams
+ * @recvThread: Thread receiving and sending packets of all ports
+ * @counter: Only updated by @recvThread
+ */
+typedef struct {
+    XdpPort port[XDP_MAX_PORT];
+    int numOfPort;
+    XdpPort *n3;
+    uint32_t n3Addr;
+
+    uint8_t *umem;
+    size_t umemLen;
+    uint64_t *freeFrame;
+    uint32_t numOfFreeFrame;
+    uint32_t numOfFrame;
+    int zeroCopy;
+
+    Sock *sock;
+    int rawFd;
+
+    XdpNeigh neigh[XDP_NEIGH_SIZE];
+
+    L3PacketInHandlerCB PacketInL3;
+    GTPUPacketInHandlerCB PacketInGTPU;
+    GetRule32CB GetFARByID;
+    GetRule32CB GetQERByID;
+
+    ThreadID recvThread;
+
+    XdpCounter counter;
+} XdpDevice;
+
+/**
+ * XdpSelf - Get the real XdpDevice pointer
+ *
+ * @return: real XdpDevice pointer in xdp_context.c
+ */
+XdpDevice *XdpSelf();
+
+/**
+ * XdpDeviceInit - Reset XdpDevice and add the port owning @ip as N3
+ *
+ * @dev: VirtualDevice pointer for setting XdpDevice
+ * @ip: Address of N3, which shall be on a local netdev
+ * @return: STATUS_OK or STATUS_ERROR if no netdev has @ip
+ */
+Status XdpDeviceInit(VirtualDevice *dev, const char *ip);
+
+/**
+ * XdpDeviceAddN6 - Steer @ip/@prefix of DNN on netdev @ifname as N6
+ *
+ * @return: STATUS_OK or STATUS_ERROR if there are too many ports or subnets
+ */
+Status XdpDeviceAddN6(const char *ifname, const char *ip, uint8_t prefix);
+
+/**
+ * XdpDeviceStart - Open sockets, attach XDP programs and start the worker
+ *
+ * @return: STATUS_OK or STATUS_ERROR if one of the ports fails
+ */
+Status XdpDeviceStart();
+
+/**
+ * XdpDeviceTerm - Stop the worker, detach XDP programs and free sockets
+ *
+ * @return: STATUS_OK or STATUS_ERROR if one of termination part is failed
+ */
+Status XdpDeviceTerm();
+
+// XDP programs of xdp_prog.c
+Status XdpProgAttach(XdpPort *port, uint32_t n3Addr);
+void XdpProgDetach(XdpPort *port);
+
+// Worker thread of xdp_path.c
+void XdpRecvThread(ThreadID id, void *data);
+
+#endif /* __XDP_CONTEXT_H__ */
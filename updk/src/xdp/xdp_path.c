@@ -0,0 +1,521 @@
+#include "xdp_context.h"
+
+/*
+ * This file would be included when the UP part runs on AF_XDP,
+ * otherwise it will not be used.
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <net/if_arp.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <linux/if_xdp.h>
+
+#include "utlt_netheader.h"
+#include "utlt_3gppTypes.h"
+#include "utlt_rcu.h"
+
+#include "updk/rule_pdr.h"
+#include "updk/rule_far.h"
+#include "updk/rule_qer.h"
+
+#define XDP_POLL_MSEC               300
+#define XDP_TX_KICK_MAX             (XDP_RING_SIZE / 32)    // Copy mode sends 32 frames per kick
+#define XDP_IP_TTL                  64
+#define XDP_OUTER_HEADER_LEN        (ETH_HLEN + sizeof(IPv4Header) + sizeof(UDPHeader))
+
+#define GTPV1_FLAGS                 0x30    // Version 1, GTP
+#define GTPV1_FLAGS_E               0x04
+#define GTPV1_FLAGS_OPT             0x07
+#define GTPV1_EXT_PDU_SESSION       0x85
+#define GTPV1_PDU_SESSION_LEN       8       // Optional field and PDU session container
+
+// QER gate values of 29.244 8.2.7
+#define QER_GATE_OPEN               0
+#define QERULGate(__gateStatus)     (((__gateStatus) & 0x0C) >> 2)
+#define QERDLGate(__gateStatus)     ((__gateStatus) & 0x03)
+
+static uint16_t xdpIpId;
+
+/*
+ * Rings are single producer and single consumer shared with kernel,
+ * so only the index of the other side is loaded with acquire
+ */
+static inline uint32_t XdpRingConsumable(XdpRing *ring, uint32_t max) {
+    uint32_t num = __atomic_load_n(ring->producer, __ATOMIC_ACQUIRE) - ring->cached;
+    return (num < max ? num : max);
+}
+
+static inline void XdpRingConsume(XdpRing *ring, uint32_t num) {
+    ring->cached += num;
+    __atomic_store_n(ring->consumer, ring->cached, __ATOMIC_RELEASE);
+}
+
+static inline uint32_t XdpRingProducible(XdpRing *ring, uint32_t max) {
+    uint32_t num = XDP_RING_SIZE - (ring->cached - __atomic_load_n(ring->consumer, __ATOMIC_ACQUIRE));
+    return (num < max ? num : max);
+}
+
+static inline void XdpRingProduce(XdpRing *ring) {
+    __atomic_store_n(ring->producer, ring->cached, __ATOMIC_RELEASE);
+}
+
+static inline int XdpRingNeedWakeup(XdpRing *ring) {
+    return __atomic_load_n(ring->flags, __ATOMIC_RELAXED) & XDP_RING_NEED_WAKEUP;
+}
+
+// Address in descriptors may have the offset of data, frames are aligned to XDP_FRAME_SIZE
+static inline void XdpFrameFree(uint64_t addr) {
+    XdpDevice *dev = XdpSelf();
+    dev->freeFrame[dev->numOfFreeFrame++] = addr & ~((uint64_t) XDP_FRAME_SIZE - 1);
+}
+
+static void XdpPortComplete(XdpPort *port) {
+    uint32_t num = XdpRingConsumable(&port->comp, XDP_RING_SIZE);
+    const uint64_t *addr = port->comp.desc;
+
+    for (uint32_t i = 0; i < num; i++)
+        XdpFrameFree(addr[(port->comp.cached + i) & port->comp.mask]);
+    if (num)
+        XdpRingConsume(&port->comp, num);
+}
+
+static void XdpPortFill(XdpPort *port) {
+    XdpDevice *dev = XdpSelf();
+    uint32_t num = XdpRingProducible(&port->fill, dev->numOfFreeFrame);
+    uint64_t *addr = port->fill.desc;
+
+    for (uint32_t i = 0; i < num; i++)
+        addr[port->fill.cached++ & port->fill.mask] = dev->freeFrame[--dev->numOfFreeFrame];
+    if (num)
+        XdpRingProduce(&port->fill);
+
+    // Driver in zero-copy mode may sleep after the fill ring is empty
+    if (XdpRingNeedWakeup(&port->fill))
+        recvfrom(port->xskFd, NULL, 0, MSG_DONTWAIT, NULL, NULL);
+}
+
+// Return 1 if the frame of @data is queued, or 0 and the caller shall free it
+static int XdpTxQueue(XdpPort *port, uint8_t *data, uint32_t len, int dir) {
+    XdpDevice *dev = XdpSelf();
+
+    if (!XdpRingProducible(&port->tx, 1)) {
+        dev->counter.error++;
+        return 0;
+    }
+
+    struct xdp_desc *desc = &((struct xdp_desc *) port->tx.desc)[port->tx.cached++ & port->tx.mask];
+    desc->addr = data - dev->umem;
+    desc->len = len;
+    desc->options = 0;
+    port->txPending++;
+    dev->counter.tx[dir]++;
+
+    return 1;
+}
+
+static void XdpPortTxSubmit(XdpPort *port) {
+    if (!port->txPending)
+        return;
+
+    XdpRingProduce(&port->tx);
+    port->txPending = 0;
+
+    // Kernel sends a part of ring for each kick, EAGAIN if there are more
+    for (int i = 0; i < XDP_TX_KICK_MAX && XdpRingNeedWakeup(&port->tx) &&
+                    __atomic_load_n(port->tx.consumer, __ATOMIC_ACQUIRE) != port->tx.cached; i++) {
+        if (sendto(port->xskFd, NULL, 0, MSG_DONTWAIT, NULL, 0) < 0 &&
+            errno != EAGAIN && errno != EBUSY && errno != ENOBUFS) {
+            UTLT_Debug("AF_XDP kick of %s failed: %s", port->ifname, strerror(errno));
+            break;
+        }
+    }
+}
+
+static XdpNeigh *XdpNeighSlot(uint32_t ip) {
+    return &XdpSelf()->neigh[((ip * 2654435761U) >> 16) & (XDP_NEIGH_SIZE - 1)];
+}
+
+static void XdpNeighLearn(XdpPort *port, uint32_t ip, const uint8_t *mac) {
+    XdpNeigh *neigh = XdpNeighSlot(ip);
+    uint8_t index = port - XdpSelf()->port + 1;
+
+    if (neigh->ip != ip || neigh->port != index || memcmp(neigh->mac, mac, ETH_ALEN)) {
+        neigh->ip = ip;
+        neigh->port = index;
+        memcpy(neigh->mac, mac, ETH_ALEN);
+    }
+}
+
+/*
+ * Next hop is learned from the source of received frames, e.g. gNB on N3
+ * and the router to DN on N6, or taken from ARP table of kernel
+ */
+static const uint8_t *XdpNeighLookup(XdpPort *port, uint32_t ip) {
+    XdpNeigh *neigh = XdpNeighSlot(ip);
+    struct arpreq req;
+    struct sockaddr_in *addr = (struct sockaddr_in *) &req.arp_pa;
+
+    if (neigh->ip == ip && neigh->port == port - XdpSelf()->port + 1)
+        return neigh->mac;
+
+    // Kernel resolves it when the packets of slow path are sent
+    memset(&req, 0, sizeof(req));
+    addr->sin_family = AF_INET;
+    addr->sin_addr.s_addr = ip;
+    memcpy(req.arp_dev, port->ifname, sizeof(req.arp_dev));
+    if (ioctl(XdpSelf()->sock->fd, SIOCGARP, &req) < 0 || !(req.arp_flags & ATF_COM))
+        return NULL;
+
+    XdpNeighLearn(port, ip, (const uint8_t *) req.arp_ha.sa_data);
+
+    return neigh->mac;
+}
+
+static uint16_t XdpIpChecksum(const IPv4Header *ip) {
+    const uint16_t *word = (const uint16_t *) ip;
+    uint32_t sum = 0;
+
+    for (size_t i = 0; i < sizeof(IPv4Header) / sizeof(uint16_t); i++)
+        sum += word[i];
+    sum = (sum & 0xffff) + (sum >> 16);
+    sum += sum >> 16;
+
+    return ~sum;
+}
+
+/*
+ * Put Ethernet, IPv4, UDP and GTP-U headers in front of @payload in the
+ * headroom of frame @addr, and queue it to N3
+ */
+static int XdpGtpuSend(uint64_t addr, uint8_t *payload, uint16_t len,
+                       const UPDK_OuterHeaderCreation *ohc, const UPDK_QER *qer) {
+    XdpDevice *dev = XdpSelf();
+    int withQfi = (qer && qer->flags.qosFlowIdentifier);
+    uint16_t hdrLen = GTPV1_HEADER_LEN + (withQfi ? GTPV1_PDU_SESSION_LEN : 0);
+    uint8_t *hdr = payload - hdrLen;
+    uint8_t *outer = hdr - XDP_OUTER_HEADER_LEN;
+    Gtpv1Header *gtpHdr = (Gtpv1Header *) hdr;
+
+    if (outer < dev->umem + (addr & ~((uint64_t) XDP_FRAME_SIZE - 1))) {
+        dev->counter.drop++;
+        return 0;
+    }
+
+    gtpHdr->flags = GTPV1_FLAGS | (withQfi ? GTPV1_FLAGS_E : 0);
+    gtpHdr->type = GTPV1_T_PDU;
+    gtpHdr->_length = htons(len + hdrLen - GTPV1_HEADER_LEN);
+    gtpHdr->_teid = htonl(ohc->teid);
+
+    if (withQfi) {
+        uint8_t *ext = hdr + GTPV1_HEADER_LEN;
+        ext[0] = ext[1] = ext[2] = 0;           // Sequence number and N-PDU number
+        ext[3] = GTPV1_EXT_PDU_SESSION;
+        ext[4] = 1;                             // Length in 4 octets
+        ext[5] = 0;                             // PDU type of DL PDU session information
+        ext[6] = qer->qosFlowIdentifier & 0x3F;
+        ext[7] = 0;                             // No next extension header
+    }
+
+    uint16_t port = htons(ohc->port ? ohc->port : GTPV1_U_UDP_PORT);
+    const uint8_t *mac = XdpNeighLookup(dev->n3, ohc->ipv4.s_addr);
+    if (!mac) {
+        struct sockaddr_in sin = {.sin_family = AF_INET, .sin_addr = ohc->ipv4, .sin_port = port};
+        if (sendto(dev->sock->fd, hdr, len + hdrLen, MSG_DONTWAIT, (struct sockaddr *) &sin, sizeof(sin)) < 0) {
+            dev->counter.error++;
+        } else {
+            dev->counter.tx[XDP_N3]++;
+            dev->counter.slowPath++;
+        }
+        return 0;
+    }
+
+    struct ether_header *eth = (struct ether_header *) outer;
+    memcpy(eth->ether_dhost, mac, ETH_ALEN);
+    memcpy(eth->ether_shost, dev->n3->mac, ETH_ALEN);
+    eth->ether_type = htons(ETHERTYPE_IP);
+
+    IPv4Header *ip = (IPv4Header *) (outer + ETH_HLEN);
+    ip->version = 4;
+    ip->ihl = sizeof(IPv4Header) / 4;
+    ip->tos = 0;
+    ip->totalLen = htons(sizeof(IPv4Header) + sizeof(UDPHeader) + hdrLen + len);
+    ip->id = htons(xdpIpId++);
+    ip->fragOff = 0;
+    ip->ttl = XDP_IP_TTL;
+    ip->proto = IPPROTO_UDP;
+    ip->check = 0;
+    ip->saddr = dev->n3Addr;
+    ip->daddr = ohc->ipv4.s_addr;
+    ip->check = XdpIpChecksum(ip);
+
+    // Checksum of UDP is optional in IPv4
+    UDPHeader *udp = (UDPHeader *) (ip + 1);
+    udp->source = htons(GTPV1_U_UDP_PORT);
+    udp->dest = port;
+    udp->len = htons(sizeof(UDPHeader) + hdrLen + len);
+    udp->check = 0;
+
+    return XdpTxQueue(dev->n3, outer, XDP_OUTER_HEADER_LEN + hdrLen + len, XDP_N3);
+}
+
+// N6 port of the DNN whose subnet has the UE address, or the first N6 port
+static XdpPort *XdpN6PortGet(uint32_t ueAddr) {
+    XdpDevice *dev = XdpSelf();
+    XdpPort *found = NULL;
+
+    for (int i = 0; i < dev->numOfPort; i++) {
+        XdpPort *port = &dev->port[i];
+        if (!(port->role & XDP_PORT_N6))
+            continue;
+        for (int j = 0; j < port->numOfSubnet; j++) {
+            if ((ueAddr & port->mask[j]) == port->subnet[j])
+                return port;
+        }
+        if (!found)
+            found = port;
+    }
+
+    return found;
+}
+
+// Route the decapsulated IPv4 packet @payload to N6, as kernel does after gtp5g
+static int XdpN6Send(uint8_t *payload, uint16_t len) {
+    XdpDevice *dev = XdpSelf();
+    IPv4Header *ip = (IPv4Header *) payload;
+
+    if (len < sizeof(IPv4Header) || ip->version != 4 || ip->ttl <= 1) {
+        dev->counter.drop++;
+        return 0;
+    }
+
+    XdpPort *port = XdpN6PortGet(ip->saddr);
+    const uint8_t *mac = XdpNeighLookup(port, ip->daddr);
+    if (!mac) {
+        struct sockaddr_in sin = {.sin_family = AF_INET, .sin_addr.s_addr = ip->daddr};
+        if (sendto(dev->rawFd, payload, len, MSG_DONTWAIT, (struct sockaddr *) &sin, sizeof(sin)) < 0) {
+            dev->counter.error++;
+        } else {
+            dev->counter.tx[XDP_N6]++;
+            dev->counter.slowPath++;
+        }
+        return 0;
+    }
+
+    // Decrease TTL and update checksum incrementally, see ip_decrease_ttl of Linux
+    uint32_t check = ip->check + htons(0x0100);
+    ip->check = check + (check >= 0xFFFF);
+    ip->ttl--;
+
+    struct ether_header *eth = (struct ether_header *) (payload - ETH_HLEN);
+    memcpy(eth->ether_dhost, mac, ETH_ALEN);
+    memcpy(eth->ether_shost, port->mac, ETH_ALEN);
+    eth->ether_type = htons(ETHERTYPE_IP);
+
+    return XdpTxQueue(port, (uint8_t *) eth, len + ETH_HLEN, XDP_N6);
+}
+
+/*
+ * Apply FAR to the inner packet @payload in frame @addr: to N3 if outer
+ * header creation is set, to N6 if the destination is core, otherwise drop it
+ */
+static int XdpForward(uint64_t addr, uint8_t *payload, uint16_t len, const UPDK_PDRView *pdr,
+                      int uplink) {
+    XdpCounter *counter = &XdpSelf()->counter;
+
+    // Rules linked by UPF, which are kept until the batch leaves RCU read-side critical section
+    const UPDK_FAR *far = pdr->far;
+    if (!far || !(far->applyAction & UPDK_FAR_APPLY_ACTION_FORW)) {
+        // Buffered packets have been taken by UPF, so the left are dropped
+        counter->drop++;
+        return 0;
+    }
+
+    // Only the first QER is applied, the same as gtp5g
+    const UPDK_QER *qer = pdr->qer;
+    if (qer && qer->flags.gateStatus &&
+        (uplink ? QERULGate(qer->gateStatus) : QERDLGate(qer->gateStatus)) != QER_GATE_OPEN) {
+        counter->drop++;
+        return 0;
+    }
+
+    const UPDK_ForwardingParameters *param = &far->forwardingParameters;
+    if (far->flags.forwardingParameters && param->flags.outerHeaderCreation) {
+        if (!(param->outerHeaderCreation.description & UPDK_OUTER_HEADER_CREATION_DESCRIPTION_GTPU_UDP_IPV4)) {
+            UTLT_Debug("Outer header creation %u is not supported", param->outerHeaderCreation.description);
+            counter->drop++;
+            return 0;
+        }
+        return XdpGtpuSend(addr, payload, len, &param->outerHeaderCreation, qer);
+    } else if (uplink) {
+        return XdpN6Send(payload, len);
+    }
+
+    counter->drop++;
+    return 0;
+}
+
+// Return the length of GTP-U header in @pkt, or -1 if it is broken
+static int XdpGtpuHeaderLen(const uint8_t *pkt, uint16_t pktlen) {
+    int len = GTPV1_HEADER_LEN + ((pkt[0] & GTPV1_FLAGS_OPT) ? GTPV1_OPT_HEADER_LEN : 0);
+
+    if (len > pktlen)
+        return -1;
+
+    if (pkt[0] & GTPV1_FLAGS_E) {
+        // The last octet of each header is the type of next extension header
+        while (pkt[len - 1]) {
+            if (len >= pktlen || !pkt[len])
+                return -1;
+            len += pkt[len] * 4;
+            if (len > pktlen)
+                return -1;
+        }
+    }
+
+    return len;
+}
+
+static int XdpN3Receive(uint64_t addr, IPv4Header *ip, uint16_t ipLen) {
+    XdpDevice *dev = XdpSelf();
+    UDPHeader *udp = (UDPHeader *) ((uint8_t *) ip + ip->ihl * 4);
+    uint16_t udpLen = ntohs(udp->len);
+    UPDK_PDRView pdr;
+
+    dev->counter.rx[XDP_N3]++;
+    if (udpLen < sizeof(UDPHeader) + GTPV1_HEADER_LEN || udpLen > ipLen - ip->ihl * 4) {
+        dev->counter.drop++;
+        return 0;
+    }
+
+    uint8_t *pkt = (uint8_t *) (udp + 1);
+    uint16_t pktlen = udpLen - sizeof(UDPHeader);
+
+    // Echo, end marker, buffering and error are handled by UPF
+    int status = dev->PacketInGTPU(pkt, pktlen, ip->saddr, udp->source, &pdr);
+    if (status) {
+        if (status > 0)
+            dev->counter.toUpf++;
+        else
+            dev->counter.noRule++;
+        return 0;
+    }
+
+    int hdrLen = XdpGtpuHeaderLen(pkt, pktlen);
+    if (hdrLen < 0) {
+        dev->counter.drop++;
+        return 0;
+    }
+
+    return XdpForward(addr, pkt + hdrLen, pktlen - hdrLen, &pdr, 1);
+}
+
+static int XdpN6Receive(uint64_t addr, IPv4Header *ip, uint16_t ipLen) {
+    XdpDevice *dev = XdpSelf();
+    UPDK_PDRView pdr;
+
+    dev->counter.rx[XDP_N6]++;
+    int status = dev->PacketInL3((uint8_t *) ip, ipLen, &pdr);
+    if (status) {
+        if (status > 0)
+            dev->counter.toUpf++;
+        else
+            dev->counter.noRule++;
+        return 0;
+    }
+
+    return XdpForward(addr, (uint8_t *) ip, ipLen, &pdr, 0);
+}
+
+// Return 1 if the frame is queued to TX, or 0 and the caller shall free it
+static int XdpPacketHandle(XdpPort *port, uint64_t addr, uint32_t len) {
+    XdpDevice *dev = XdpSelf();
+    struct ether_header *eth = (struct ether_header *) (dev->umem + addr);
+    IPv4Header *ip = (IPv4Header *) (eth + 1);
+
+    // Others are passed to kernel by XDP program, so they are not expected
+    if (len < ETH_HLEN + sizeof(IPv4Header) || eth->ether_type != htons(ETHERTYPE_IP) ||
+        ip->version != 4 || ip->ihl * 4 < sizeof(IPv4Header)) {
+        dev->counter.drop++;
+        return 0;
+    }
+
+    // Ethernet may pad short frames
+    uint16_t ipLen = ntohs(ip->totalLen);
+    if (ipLen < ip->ihl * 4 || ipLen > len - ETH_HLEN) {
+        dev->counter.drop++;
+        return 0;
+    }
+
+    XdpNeighLearn(port, ip->saddr, eth->ether_shost);
+
+    UDPHeader *udp = (UDPHeader *) ((uint8_t *) ip + ip->ihl * 4);
+    if ((port->role & XDP_PORT_N3) && ip->daddr == dev->n3Addr && ip->proto == IPPROTO_UDP &&
+        ipLen >= ip->ihl * 4 + sizeof(UDPHeader) && udp->dest == htons(GTPV1_U_UDP_PORT))
+        return XdpN3Receive(addr, ip, ipLen);
+    if (port->role & XDP_PORT_N6)
+        return XdpN6Receive(addr, ip, ipLen);
+
+    dev->counter.drop++;
+    return 0;
+}
+
+static uint32_t XdpPortReceive(XdpPort *port) {
+    uint32_t num = XdpRingConsumable(&port->rx, XDP_BATCH);
+    const struct xdp_desc *desc = port->rx.desc;
+
+    RcuReadLock();
+    for (uint32_t i = 0; i < num; i++) {
+        const struct xdp_desc *rx = &desc[(port->rx.cached + i) & port->rx.mask];
+        if (!XdpPacketHandle(port, rx->addr, rx->len))
+            XdpFrameFree(rx->addr);
+    }
+    RcuReadUnlock();
+    if (num)
+        XdpRingConsume(&port->rx, num);
+
+    return num;
+}
+
+void XdpRecvThread(ThreadID id, void *data) {
+    XdpDevice *dev = XdpSelf();
+    struct pollfd pfd[XDP_MAX_PORT];
+
+    for (int i = 0; i < dev->numOfPort; i++) {
+        pfd[i].fd = dev->port[i].xskFd;
+        pfd[i].events = POLLIN;
+    }
+
+    while (!ThreadStop()) {
+        uint32_t received = 0;
+
+        for (int i = 0; i < dev->numOfPort; i++) {
+            XdpPortComplete(&dev->port[i]);
+            XdpPortFill(&dev->port[i]);
+        }
+
+        // Rules may be changed by UPF between batches
+        for (int i = 0; i < dev->numOfPort; i++)
+            received += XdpPortReceive(&dev->port[i]);
+
+        for (int i = 0; i < dev->numOfPort; i++)
+            XdpPortTxSubmit(&dev->port[i]);
+
+        // Busy polling while packets come, and sleep if it is idle
+        if (received)
+            continue;
+
+        int nfds = poll(pfd, dev->numOfPort, XDP_POLL_MSEC);
+        UTLT_Assert(nfds >= 0 || errno == EINTR, break, "Poll error : %s", strerror(errno));
+    }
+
+    RcuThreadOffline();
+    sem_post(((Thread *)id)->semaphore);
+    UTLT_Trace("XDP worker thread terminated");
+
+    return;
+}
@@ -0,0 +1,270 @@
+#include "xdp_context.h"
+
+/*
+ * This file would be included when the UP part runs on AF_XDP,
+ * otherwise it will not be used.
+ *
+ * The XDP program is small and depends on the config, so it is generated
+ * here in BPF instructions and loaded by bpf(2), without clang or libbpf.
+ * It is like:
+ *
+ *     if (eth is IPv4 && ip is UDP without options && dport is GTP-U &&
+ *         daddr is N3 address)                     // XDP_PORT_N3
+ *         return bpf_redirect_map(&xsks, rx_queue_index, XDP_PASS);
+ *     if ((daddr & mask[i]) == subnet[i])          // XDP_PORT_N6
+ *         return bpf_redirect_map(&xsks, rx_queue_index, XDP_PASS);
+ *     return XDP_PASS;
+ */
+
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/syscall.h>
+#include <linux/bpf.h>
+#include <linux/if_link.h>
+
+#include "utlt_3gppTypes.h"
+
+#define XDP_PROG_MAX_INSN           128
+#define XDP_PROG_LOG_SIZE           4096
+
+// Offsets in frame, IPv4 header has no options
+#define XDP_OFF_ETH_PROTO           12
+#define XDP_OFF_IP_VERSION          14
+#define XDP_OFF_IP_PROTO            23
+#define XDP_OFF_IP_DADDR            30
+#define XDP_OFF_IP_END              34
+#define XDP_OFF_UDP_DPORT           36
+#define XDP_OFF_UDP_END             42
+
+// Registers of BPF
+enum {
+    R0 = 0, R1, R2, R3, R4, R5, R6,
+};
+
+// Jump targets, resolved when the program is done
+enum {
+    XDP_LABEL_NONE = 0,
+    XDP_LABEL_N6,
+    XDP_LABEL_PASS,
+    XDP_LABEL_REDIRECT,
+
+    XDP_LABEL_MAX,
+};
+
+typedef struct {
+    struct bpf_insn insn[XDP_PROG_MAX_INSN];
+    int label[XDP_PROG_MAX_INSN];       // Target of the jump at the same index
+    int labelAt[XDP_LABEL_MAX];
+    int num;
+} XdpProg;
+
+static char xdpProgLog[XDP_PROG_LOG_SIZE];
+
+static int XdpBpf(int cmd, union bpf_attr *attr) {
+    return syscall(__NR_bpf, cmd, attr, sizeof(union bpf_attr));
+}
+
+static void XdpEmit(XdpProg *prog, uint8_t code, uint8_t dst, uint8_t src, int16_t off, int32_t imm, int label) {
+    if (prog->num >= XDP_PROG_MAX_INSN) {
+        prog->num++;
+        return;
+    }
+
+    struct bpf_insn *insn = &prog->insn[prog->num];
+    memset(insn, 0, sizeof(struct bpf_insn));
+    insn->code = code;
+    insn->dst_reg = dst;
+    insn->src_reg = src;
+    insn->off = off;
+    insn->imm = imm;
+    prog->label[prog->num++] = label;
+}
+
+static void XdpLabel(XdpProg *prog, int label) {
+    prog->labelAt[label] = prog->num;
+}
+
+// Load @size bytes at @off of packet @src to @dst
+static void XdpEmitLoad(XdpProg *prog, uint8_t size, uint8_t dst, uint8_t src, int16_t off) {
+    XdpEmit(prog, BPF_LDX | size | BPF_MEM, dst, src, off, 0, XDP_LABEL_NONE);
+}
+
+// Go to @label if 32 bits of @reg are not @imm
+static void XdpEmitJne(XdpProg *prog, uint8_t reg, int32_t imm, int label) {
+    XdpEmit(prog, BPF_JMP32 | BPF_JNE | BPF_K, reg, 0, 0, imm, label);
+}
+
+// Go to @label if @len bytes of packet in R2 are beyond data_end in R3
+static void XdpEmitBoundCheck(XdpProg *prog, int32_t len, int label) {
+    XdpEmit(prog, BPF_ALU64 | BPF_MOV | BPF_X, R4, R2, 0, 0, XDP_LABEL_NONE);
+    XdpEmit(prog, BPF_ALU64 | BPF_ADD | BPF_K, R4, 0, 0, len, XDP_LABEL_NONE);
+    XdpEmit(prog, BPF_JMP | BPF_JGT | BPF_X, R4, R3, 0, 0, label);
+}
+
+static void XdpEmitReturn(XdpProg *prog, int32_t action) {
+    XdpEmit(prog, BPF_ALU64 | BPF_MOV | BPF_K, R0, 0, 0, action, XDP_LABEL_NONE);
+    XdpEmit(prog, BPF_JMP | BPF_EXIT, 0, 0, 0, 0, XDP_LABEL_NONE);
+}
+
+static Status XdpProgBuild(XdpProg *prog, const XdpPort *port, uint32_t n3Addr) {
+    memset(prog, 0, sizeof(XdpProg));
+
+    // R6 = ctx, R2 = data, R3 = data_end
+    XdpEmit(prog, BPF_ALU64 | BPF_MOV | BPF_X, R6, R1, 0, 0, XDP_LABEL_NONE);
+    XdpEmitLoad(prog, BPF_W, R2, R1, offsetof(struct xdp_md, data));
+    XdpEmitLoad(prog, BPF_W, R3, R1, offsetof(struct xdp_md, data_end));
+    XdpEmitBoundCheck(prog, XDP_OFF_IP_END, XDP_LABEL_PASS);
+    XdpEmitLoad(prog, BPF_H, R5, R2, XDP_OFF_ETH_PROTO);
+    XdpEmitJne(prog, R5, htons(ETHERTYPE_IP), XDP_LABEL_PASS);
+
+    if (port->role & XDP_PORT_N3) {
+        XdpEmitLoad(prog, BPF_B, R5, R2, XDP_OFF_IP_VERSION);
+        XdpEmitJne(prog, R5, 0x45, XDP_LABEL_N6);
+        XdpEmitLoad(prog, BPF_B, R5, R2, XDP_OFF_IP_PROTO);
+        XdpEmitJne(prog, R5, IPPROTO_UDP, XDP_LABEL_N6);
+        XdpEmitLoad(prog, BPF_W, R5, R2, XDP_OFF_IP_DADDR);
+        XdpEmitJne(prog, R5, (int32_t) n3Addr, XDP_LABEL_N6);
+        XdpEmitBoundCheck(prog, XDP_OFF_UDP_END, XDP_LABEL_N6);
+        XdpEmitLoad(prog, BPF_H, R5, R2, XDP_OFF_UDP_DPORT);
+        XdpEmitJne(prog, R5, htons(GTPV1_U_UDP_PORT), XDP_LABEL_N6);
+        XdpEmit(prog, BPF_JMP | BPF_JA, 0, 0, 0, 0, XDP_LABEL_REDIRECT);
+    }
+
+    XdpLabel(prog, XDP_LABEL_N6);
+    if (port->role & XDP_PORT_N6) {
+        XdpEmitLoad(prog, BPF_W, R5, R2, XDP_OFF_IP_DADDR);
+        for (int i = 0; i < port->numOfSubnet; i++) {
+            XdpEmit(prog, BPF_ALU | BPF_MOV | BPF_X, R4, R5, 0, 0, XDP_LABEL_NONE);
+            XdpEmit(prog, BPF_ALU | BPF_AND | BPF_K, R4, 0, 0, (int32_t) port->mask[i], XDP_LABEL_NONE);
+            XdpEmit(prog, BPF_JMP32 | BPF_JEQ | BPF_K, R4, 0, 0, (int32_t) port->subnet[i], XDP_LABEL_REDIRECT);
+        }
+    }
+
+    XdpLabel(prog, XDP_LABEL_PASS);
+    XdpEmitReturn(prog, XDP_PASS);
+
+    // Packets on the queue without socket are passed by the flags of bpf_redirect_map
+    XdpLabel(prog, XDP_LABEL_REDIRECT);
+    XdpEmitLoad(prog, BPF_W, R2, R6, offsetof(struct xdp_md, rx_queue_index));
+    XdpEmit(prog, BPF_LD | BPF_DW | BPF_IMM, R1, BPF_PSEUDO_MAP_FD, 0, port->mapFd, XDP_LABEL_NONE);
+    XdpEmit(prog, 0, 0, 0, 0, 0, XDP_LABEL_NONE);
+    XdpEmit(prog, BPF_ALU64 | BPF_MOV | BPF_K, R3, 0, 0, XDP_PASS, XDP_LABEL_NONE);
+    XdpEmit(prog, BPF_JMP | BPF_CALL, 0, 0, 0, BPF_FUNC_redirect_map, XDP_LABEL_NONE);
+    XdpEmit(prog, BPF_JMP | BPF_EXIT, 0, 0, 0, 0, XDP_LABEL_NONE);
+
+    UTLT_Assert(prog->num <= XDP_PROG_MAX_INSN, return STATUS_ERROR,
+        "XDP program of %s needs %d instructions, more than %d", port->ifname, prog->num, XDP_PROG_MAX_INSN);
+
+    for (int i = 0; i < prog->num; i++) {
+        if (prog->label[i] != XDP_LABEL_NONE)
+            prog->insn[i].off = prog->labelAt[prog->label[i]] - (i + 1);
+    }
+
+    return STATUS_OK;
+}
+
+static int XdpMapCreate() {
+    union bpf_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.map_type = BPF_MAP_TYPE_XSKMAP;
+    attr.key_size = sizeof(uint32_t);
+    attr.value_size = sizeof(int);
+    attr.max_entries = 1;       // Only queue 0 is bound
+
+    return XdpBpf(BPF_MAP_CREATE, &attr);
+}
+
+static int XdpMapUpdate(int mapFd, uint32_t key, int value) {
+    union bpf_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.map_fd = mapFd;
+    attr.key = (uintptr_t) &key;
+    attr.value = (uintptr_t) &value;
+    attr.flags = BPF_ANY;
+
+    return XdpBpf(BPF_MAP_UPDATE_ELEM, &attr);
+}
+
+// Log of verifier is only taken for the failed program, since it may be longer than the buffer
+static int XdpProgLoad(const XdpProg *prog, int withLog) {
+    union bpf_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.prog_type = BPF_PROG_TYPE_XDP;
+    attr.insns = (uintptr_t) prog->insn;
+    attr.insn_cnt = prog->num;
+    attr.license = (uintptr_t) "GPL";
+    if (withLog) {
+        attr.log_buf = (uintptr_t) xdpProgLog;
+        attr.log_size = sizeof(xdpProgLog);
+        attr.log_level = 1;
+        xdpProgLog[0] = '\0';
+    }
+
+    return XdpBpf(BPF_PROG_LOAD, &attr);
+}
+
+// The link detaches the program when it is closed, even if UPF crashes
+static int XdpLinkCreate(int progFd, int ifindex, uint32_t xdpMode) {
+    union bpf_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.link_create.prog_fd = progFd;
+    attr.link_create.target_ifindex = ifindex;
+    attr.link_create.attach_type = BPF_XDP;
+    attr.link_create.flags = xdpMode;
+
+    return XdpBpf(BPF_LINK_CREATE, &attr);
+}
+
+Status XdpProgAttach(XdpPort *port, uint32_t n3Addr) {
+    XdpProg prog;
+
+    port->mapFd = port->progFd = port->linkFd = -1;
+
+    port->mapFd = XdpMapCreate();
+    UTLT_Assert(port->mapFd >= 0, goto FAIL, "XSKMAP of %s create failed: %s", port->ifname, strerror(errno));
+    UTLT_Assert(XdpMapUpdate(port->mapFd, 0, port->xskFd) == 0, goto FAIL,
+        "Add AF_XDP socket of %s to XSKMAP failed: %s", port->ifname, strerror(errno));
+
+    UTLT_Assert(XdpProgBuild(&prog, port, n3Addr) == STATUS_OK, goto FAIL, "");
+    port->progFd = XdpProgLoad(&prog, 0);
+    if (port->progFd < 0) {
+        UTLT_Error("XDP program of %s load failed: %s", port->ifname, strerror(errno));
+        port->progFd = XdpProgLoad(&prog, 1);
+        UTLT_Error("Verifier log of %s:\n%s", port->ifname, xdpProgLog);
+        goto FAIL;
+    }
+
+    // Native XDP is preferred, generic XDP works on any netdev
+    port->xdpMode = XDP_FLAGS_DRV_MODE;
+    port->linkFd = XdpLinkCreate(port->progFd, port->ifindex, port->xdpMode);
+    if (port->linkFd < 0) {
+        UTLT_Debug("Native XDP on %s failed: %s, try generic XDP", port->ifname, strerror(errno));
+        port->xdpMode = XDP_FLAGS_SKB_MODE;
+        port->linkFd = XdpLinkCreate(port->progFd, port->ifindex, port->xdpMode);
+    }
+    UTLT_Assert(port->linkFd >= 0, goto FAIL, "XDP program attach to %s failed: %s",
+        port->ifname, strerror(errno));
+
+    return STATUS_OK;
+
+FAIL:
+    XdpProgDetach(port);
+    return STATUS_ERROR;
+}
+
+void XdpProgDetach(XdpPort *port) {
+    if (port->linkFd >= 0)
+        close(port->linkFd);
+    if (port->progFd >= 0)
+        close(port->progFd);
+    if (port->mapFd >= 0)
+        close(port->mapFd);
+    port->mapFd = port->progFd = port->linkFd = -1;
+}